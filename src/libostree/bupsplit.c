@@ -93,28 +93,242 @@ bupsplit_sum (uint8_t *buf, size_t ofs, size_t len)
   return rollsum_digest (&r);
 }
 
-int
-bupsplit_find_ofs (const unsigned char *buf, int len, int *bits)
+/* The split search below uses a reduced representation of the rollsum
+ * state.  s1 is the window byte sum plus BUP_WINDOWSIZE *
+ * ROLLSUM_CHAR_OFFSET, which is at most 64 * (255 + 31) and therefore
+ * always fits exactly in 16 bits.  The split condition and the trailing
+ * one-bits of the digest only ever look at s1 and the low 16 bits of
+ * s2, so tracking both as uint16_t gives bit-identical results to the
+ * 32-bit Rollsum above.  That in turn lets the vector kernels process
+ * eight or sixteen positions per step in 16-bit lanes.
+ *
+ * The byte leaving the window at position i is simply buf[i - WINDOW]
+ * (or 0 while the window is still filling), so no circular window
+ * buffer is needed when scanning a contiguous buffer.
+ */
+
+static int
+found_split (uint16_t s1, uint16_t s2, int count, int *bits)
 {
-  Rollsum r;
+  if (bits)
+    {
+      uint32_t rsum = ((uint32_t)s1 << 16) | s2;
+      rsum >>= BUP_BLOBBITS;
+      for (*bits = BUP_BLOBBITS; (rsum >>= 1) & 1; (*bits)++)
+        ;
+    }
+  return count + 1;
+}
+
+/* Scan positions [start, end), updating the s1/s2 state; returns the
+ * 1-based split offset, or 0 if no split was found.
+ */
+static int
+find_ofs_scalar (const unsigned char *buf, int start, int end, uint16_t *s1p, uint16_t *s2p,
+                 int *bits)
+{
+  uint16_t s1 = *s1p, s2 = *s2p;
   int count;
 
-  rollsum_init (&r);
-  for (count = 0; count < len; count++)
+  for (count = start; count < end; count++)
     {
-      rollsum_roll (&r, buf[count]);
-      if ((r.s2 & (BUP_BLOBSIZE - 1)) == ((~0) & (BUP_BLOBSIZE - 1)))
-        {
-          if (bits)
-            {
-              unsigned rsum = rollsum_digest (&r);
-              *bits = BUP_BLOBBITS;
-              rsum >>= BUP_BLOBBITS;
-              for (*bits = BUP_BLOBBITS; (rsum >>= 1) & 1; (*bits)++)
-                ;
-            }
-          return count + 1;
-        }
+      uint16_t drop = count >= BUP_WINDOWSIZE ? buf[count - BUP_WINDOWSIZE] : 0;
+      s1 += buf[count] - drop;
+      s2 += s1 - (uint16_t)(BUP_WINDOWSIZE * (drop + ROLLSUM_CHAR_OFFSET));
+      if ((s2 & (BUP_BLOBSIZE - 1)) == ((~0) & (BUP_BLOBSIZE - 1)))
+        return found_split (s1, s2, count, bits);
     }
+
+  *s1p = s1;
+  *s2p = s2;
   return 0;
 }
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define BUPSPLIT_HAVE_X86_SIMD 1
+
+#include <immintrin.h>
+
+static int
+find_ofs_sse2 (const unsigned char *buf, int len, int *bits)
+{
+  uint16_t s1 = BUP_WINDOWSIZE * ROLLSUM_CHAR_OFFSET;
+  uint16_t s2 = (uint16_t)(BUP_WINDOWSIZE * (BUP_WINDOWSIZE - 1) * ROLLSUM_CHAR_OFFSET);
+  int head = len < BUP_WINDOWSIZE ? len : BUP_WINDOWSIZE;
+  int ret, count;
+
+  ret = find_ofs_scalar (buf, 0, head, &s1, &s2, bits);
+  if (ret)
+    return ret;
+
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i voffset = _mm_set1_epi16 (BUP_WINDOWSIZE * ROLLSUM_CHAR_OFFSET);
+  const __m128i vmask = _mm_set1_epi16 (BUP_BLOBSIZE - 1);
+
+  for (count = head; count + 8 <= len; count += 8)
+    {
+      __m128i add
+          = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)(buf + count)), zero);
+      __m128i drop = _mm_unpacklo_epi8 (
+          _mm_loadl_epi64 ((const __m128i *)(buf + count - BUP_WINDOWSIZE)), zero);
+
+      /* Inclusive prefix sum of the per-position deltas gives all eight
+       * s1 values at once; a second prefix sum over the s2 increments
+       * gives all eight s2 values.
+       */
+      __m128i d = _mm_sub_epi16 (add, drop);
+      d = _mm_add_epi16 (d, _mm_slli_si128 (d, 2));
+      d = _mm_add_epi16 (d, _mm_slli_si128 (d, 4));
+      d = _mm_add_epi16 (d, _mm_slli_si128 (d, 8));
+      __m128i vs1 = _mm_add_epi16 (_mm_set1_epi16 ((short)s1), d);
+
+      __m128i a = _mm_sub_epi16 (
+          vs1, _mm_add_epi16 (_mm_slli_epi16 (drop, BUP_WINDOWBITS - 1), voffset));
+      a = _mm_add_epi16 (a, _mm_slli_si128 (a, 2));
+      a = _mm_add_epi16 (a, _mm_slli_si128 (a, 4));
+      a = _mm_add_epi16 (a, _mm_slli_si128 (a, 8));
+      __m128i vs2 = _mm_add_epi16 (_mm_set1_epi16 ((short)s2), a);
+
+      __m128i hit = _mm_cmpeq_epi16 (_mm_and_si128 (vs2, vmask), vmask);
+      if (_mm_movemask_epi8 (hit) != 0)
+        return find_ofs_scalar (buf, count, len, &s1, &s2, bits);
+
+      s1 = (uint16_t)_mm_extract_epi16 (vs1, 7);
+      s2 = (uint16_t)_mm_extract_epi16 (vs2, 7);
+    }
+
+  return find_ofs_scalar (buf, count, len, &s1, &s2, bits);
+}
+
+__attribute__ ((target ("avx2"))) static int
+find_ofs_avx2 (const unsigned char *buf, int len, int *bits)
+{
+  uint16_t s1 = BUP_WINDOWSIZE * ROLLSUM_CHAR_OFFSET;
+  uint16_t s2 = (uint16_t)(BUP_WINDOWSIZE * (BUP_WINDOWSIZE - 1) * ROLLSUM_CHAR_OFFSET);
+  int head = len < BUP_WINDOWSIZE ? len : BUP_WINDOWSIZE;
+  int ret, count;
+
+  ret = find_ofs_scalar (buf, 0, head, &s1, &s2, bits);
+  if (ret)
+    return ret;
+
+  const __m256i voffset = _mm256_set1_epi16 (BUP_WINDOWSIZE * ROLLSUM_CHAR_OFFSET);
+  const __m256i vmask = _mm256_set1_epi16 (BUP_BLOBSIZE - 1);
+
+  for (count = head; count + 16 <= len; count += 16)
+    {
+      __m256i add
+          = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *)(buf + count)));
+      __m256i drop = _mm256_cvtepu8_epi16 (
+          _mm_loadu_si128 ((const __m128i *)(buf + count - BUP_WINDOWSIZE)));
+
+      /* As in the SSE2 kernel, but _mm256_slli_si256 only shifts within
+       * each 128-bit half, so the low half's running total has to be
+       * carried into the high half explicitly.
+       */
+      __m256i d = _mm256_sub_epi16 (add, drop);
+      d = _mm256_add_epi16 (d, _mm256_slli_si256 (d, 2));
+      d = _mm256_add_epi16 (d, _mm256_slli_si256 (d, 4));
+      d = _mm256_add_epi16 (d, _mm256_slli_si256 (d, 8));
+      {
+        __m128i lo = _mm256_castsi256_si128 (d);
+        __m128i tot = _mm_shufflehi_epi16 (lo, _MM_SHUFFLE (3, 3, 3, 3));
+        tot = _mm_unpackhi_epi64 (tot, tot);
+        d = _mm256_add_epi16 (d, _mm256_inserti128_si256 (_mm256_setzero_si256 (), tot, 1));
+      }
+      __m256i vs1 = _mm256_add_epi16 (_mm256_set1_epi16 ((short)s1), d);
+
+      __m256i a = _mm256_sub_epi16 (
+          vs1, _mm256_add_epi16 (_mm256_slli_epi16 (drop, BUP_WINDOWBITS - 1), voffset));
+      a = _mm256_add_epi16 (a, _mm256_slli_si256 (a, 2));
+      a = _mm256_add_epi16 (a, _mm256_slli_si256 (a, 4));
+      a = _mm256_add_epi16 (a, _mm256_slli_si256 (a, 8));
+      {
+        __m128i lo = _mm256_castsi256_si128 (a);
+        __m128i tot = _mm_shufflehi_epi16 (lo, _MM_SHUFFLE (3, 3, 3, 3));
+        tot = _mm_unpackhi_epi64 (tot, tot);
+        a = _mm256_add_epi16 (a, _mm256_inserti128_si256 (_mm256_setzero_si256 (), tot, 1));
+      }
+      __m256i vs2 = _mm256_add_epi16 (_mm256_set1_epi16 ((short)s2), a);
+
+      __m256i hit = _mm256_cmpeq_epi16 (_mm256_and_si256 (vs2, vmask), vmask);
+      if (_mm256_movemask_epi8 (hit) != 0)
+        return find_ofs_scalar (buf, count, len, &s1, &s2, bits);
+
+      s1 = (uint16_t)_mm256_extract_epi16 (vs1, 15);
+      s2 = (uint16_t)_mm256_extract_epi16 (vs2, 15);
+    }
+
+  return find_ofs_scalar (buf, count, len, &s1, &s2, bits);
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define BUPSPLIT_HAVE_NEON 1
+
+#include <arm_neon.h>
+
+static int
+find_ofs_neon (const unsigned char *buf, int len, int *bits)
+{
+  uint16_t s1 = BUP_WINDOWSIZE * ROLLSUM_CHAR_OFFSET;
+  uint16_t s2 = (uint16_t)(BUP_WINDOWSIZE * (BUP_WINDOWSIZE - 1) * ROLLSUM_CHAR_OFFSET);
+  int head = len < BUP_WINDOWSIZE ? len : BUP_WINDOWSIZE;
+  int ret, count;
+
+  ret = find_ofs_scalar (buf, 0, head, &s1, &s2, bits);
+  if (ret)
+    return ret;
+
+  const uint16x8_t zero = vdupq_n_u16 (0);
+  const uint16x8_t voffset = vdupq_n_u16 (BUP_WINDOWSIZE * ROLLSUM_CHAR_OFFSET);
+  const uint16x8_t vmask = vdupq_n_u16 (BUP_BLOBSIZE - 1);
+
+  for (count = head; count + 8 <= len; count += 8)
+    {
+      uint16x8_t add = vmovl_u8 (vld1_u8 (buf + count));
+      uint16x8_t drop = vmovl_u8 (vld1_u8 (buf + count - BUP_WINDOWSIZE));
+
+      uint16x8_t d = vsubq_u16 (add, drop);
+      d = vaddq_u16 (d, vextq_u16 (zero, d, 7));
+      d = vaddq_u16 (d, vextq_u16 (zero, d, 6));
+      d = vaddq_u16 (d, vextq_u16 (zero, d, 4));
+      uint16x8_t vs1 = vaddq_u16 (vdupq_n_u16 (s1), d);
+
+      uint16x8_t a = vsubq_u16 (
+          vs1, vaddq_u16 (vshlq_n_u16 (drop, BUP_WINDOWBITS - 1), voffset));
+      a = vaddq_u16 (a, vextq_u16 (zero, a, 7));
+      a = vaddq_u16 (a, vextq_u16 (zero, a, 6));
+      a = vaddq_u16 (a, vextq_u16 (zero, a, 4));
+      uint16x8_t vs2 = vaddq_u16 (vdupq_n_u16 (s2), a);
+
+      uint16x8_t hit = vceqq_u16 (vandq_u16 (vs2, vmask), vmask);
+      if (vmaxvq_u16 (hit) != 0)
+        return find_ofs_scalar (buf, count, len, &s1, &s2, bits);
+
+      s1 = vgetq_lane_u16 (vs1, 7);
+      s2 = vgetq_lane_u16 (vs2, 7);
+    }
+
+  return find_ofs_scalar (buf, count, len, &s1, &s2, bits);
+}
+
+#endif
+
+int
+bupsplit_find_ofs (const unsigned char *buf, int len, int *bits)
+{
+#if defined(BUPSPLIT_HAVE_X86_SIMD)
+  /* Benign race: concurrent first callers resolve to the same value. */
+  static int (*impl) (const unsigned char *, int, int *) = NULL;
+  if (impl == NULL)
+    impl = __builtin_cpu_supports ("avx2") ? find_ofs_avx2 : find_ofs_sse2;
+  return impl (buf, len, bits);
+#elif defined(BUPSPLIT_HAVE_NEON)
+  return find_ofs_neon (buf, len, bits);
+#else
+  uint16_t s1 = BUP_WINDOWSIZE * ROLLSUM_CHAR_OFFSET;
+  uint16_t s2 = (uint16_t)(BUP_WINDOWSIZE * (BUP_WINDOWSIZE - 1) * ROLLSUM_CHAR_OFFSET);
+
+  return find_ofs_scalar (buf, 0, len, &s1, &s2, bits);
+#endif
+}
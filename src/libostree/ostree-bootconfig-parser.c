@@ -17,6 +17,7 @@
 
 #include "config.h"
 
+#include "ostree-bootconfig-parser-private.h"
 #include "ostree-bootconfig-parser.h"
 #include "otutil.h"
 
@@ -28,6 +29,10 @@ struct _OstreeBootconfigParser
   const char *separators;
 
   GHashTable *options;
+  /* Keys in insertion order, borrowed from @options, so that serialization
+   * is deterministic.  Uses g_hash_table_insert() ownership semantics: a
+   * re-inserted key keeps the original key allocation alive. */
+  GPtrArray *keys;
 
   /* Additional initrds; the primary initrd is in options. */
   char **overlay_initrds;
@@ -37,6 +42,16 @@ typedef GObjectClass OstreeBootconfigParserClass;
 
 G_DEFINE_TYPE (OstreeBootconfigParser, ostree_bootconfig_parser, G_TYPE_OBJECT)
 
+/* Insert @key/@value (both owned by the callee) while keeping the ordered
+ * key vector in sync. */
+static void
+bootconfig_insert (OstreeBootconfigParser *self, char *key, char *value)
+{
+  if (!g_hash_table_contains (self->options, key))
+    g_ptr_array_add (self->keys, key);
+  g_hash_table_insert (self->options, key, value);
+}
+
 /**
  * ostree_bootconfig_parser_clone:
  * @self: Bootconfig to clone
@@ -48,66 +63,59 @@ ostree_bootconfig_parser_clone (OstreeBootconfigParser *self)
 {
   OstreeBootconfigParser *parser = ostree_bootconfig_parser_new ();
 
-  GLNX_HASH_TABLE_FOREACH_KV (self->options, const char *, k, const char *, v)
-    g_hash_table_replace (parser->options, g_strdup (k), g_strdup (v));
+  for (guint i = 0; i < self->keys->len; i++)
+    {
+      const char *k = self->keys->pdata[i];
+      bootconfig_insert (parser, g_strdup (k), g_strdup (g_hash_table_lookup (self->options, k)));
+    }
 
   parser->overlay_initrds = g_strdupv (self->overlay_initrds);
 
   return parser;
 }
 
-/**
- * ostree_bootconfig_parser_parse_at:
- * @self: Parser
- * @dfd: Directory fd
- * @path: File path
- * @cancellable: Cancellable
- * @error: Error
- *
- * Initialize a bootconfig from the given file.
- */
-gboolean
-ostree_bootconfig_parser_parse_at (OstreeBootconfigParser *self, int dfd, const char *path,
-                                   GCancellable *cancellable, GError **error)
+/* Initialize a bootconfig from in-memory file contents; shared with the
+ * sysroot deployment state cache. */
+void
+_ostree_bootconfig_parser_parse_data (OstreeBootconfigParser *self, const char *contents)
 {
   g_assert (!self->parsed);
 
-  g_autofree char *contents = glnx_file_get_contents_utf8_at (dfd, path, NULL, cancellable, error);
-  if (!contents)
-    return FALSE;
-
   g_autoptr (GPtrArray) overlay_initrds = NULL;
 
-  g_auto (GStrv) lines = g_strsplit (contents, "\n", -1);
-  for (char **iter = lines; *iter; iter++)
+  /* A single pass, tokenizing each line directly out of @contents rather
+   * than building intermediate per-line string vectors; sysroot load runs
+   * this for every deployment. */
+  for (const char *line = contents; *line;)
     {
-      const char *line = *iter;
+      const char *eol = strchr (line, '\n');
+      const size_t line_len = eol ? (size_t)(eol - line) : strlen (line);
+      const char *next = eol ? eol + 1 : line + line_len;
 
-      if (g_ascii_isalpha (*line))
+      if (line_len > 0 && g_ascii_isalpha (*line))
         {
-          char **items = NULL;
-          items = g_strsplit_set (line, self->separators, 2);
-          if (g_strv_length (items) == 2 && items[0][0] != '\0')
+          /* The key runs until the first separator; the rest of the line,
+           * including any further separators, is the value. */
+          size_t keylen = 0;
+          while (keylen < line_len && strchr (self->separators, line[keylen]) == NULL)
+            keylen++;
+          if (keylen > 0 && keylen < line_len)
             {
-              if (g_str_equal (items[0], "initrd")
+              char *value = g_strndup (line + keylen + 1, line_len - keylen - 1);
+              if (keylen == strlen ("initrd") && strncmp (line, "initrd", keylen) == 0
                   && g_hash_table_contains (self->options, "initrd"))
                 {
                   if (!overlay_initrds)
                     overlay_initrds = g_ptr_array_new_with_free_func (g_free);
-                  g_ptr_array_add (overlay_initrds, items[1]);
-                  g_free (items[0]);
+                  g_ptr_array_add (overlay_initrds, value);
                 }
               else
                 {
-                  g_hash_table_insert (self->options, items[0], items[1]);
+                  bootconfig_insert (self, g_strndup (line, keylen), value);
                 }
-              g_free (items); /* Free container; we stole the elements */
-            }
-          else
-            {
-              g_strfreev (items);
             }
         }
+      line = next;
     }
 
   if (overlay_initrds)
@@ -117,6 +125,27 @@ ostree_bootconfig_parser_parse_at (OstreeBootconfigParser *self, int dfd, const
     }
 
   self->parsed = TRUE;
+}
+
+/**
+ * ostree_bootconfig_parser_parse_at:
+ * @self: Parser
+ * @dfd: Directory fd
+ * @path: File path
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Initialize a bootconfig from the given file.
+ */
+gboolean
+ostree_bootconfig_parser_parse_at (OstreeBootconfigParser *self, int dfd, const char *path,
+                                   GCancellable *cancellable, GError **error)
+{
+  g_autofree char *contents = glnx_file_get_contents_utf8_at (dfd, path, NULL, cancellable, error);
+  if (!contents)
+    return FALSE;
+
+  _ostree_bootconfig_parser_parse_data (self, contents);
 
   return TRUE;
 }
@@ -140,7 +169,7 @@ ostree_bootconfig_parser_parse (OstreeBootconfigParser *self, GFile *path,
 void
 ostree_bootconfig_parser_set (OstreeBootconfigParser *self, const char *key, const char *value)
 {
-  g_hash_table_replace (self->options, g_strdup (key), g_strdup (value));
+  bootconfig_insert (self, g_strdup (key), g_strdup (value));
 }
 
 /**
@@ -202,9 +231,10 @@ write_key (OstreeBootconfigParser *self, GString *buf, const char *key, const ch
   g_string_append_c (buf, '\n');
 }
 
-gboolean
-ostree_bootconfig_parser_write_at (OstreeBootconfigParser *self, int dfd, const char *path,
-                                   GCancellable *cancellable, GError **error)
+/* Render the bootconfig in its file format; the reverse of
+ * _ostree_bootconfig_parser_parse_data(). */
+char *
+_ostree_bootconfig_parser_to_string (OstreeBootconfigParser *self)
 {
   /* Write the fields in a deterministic order, following what is used
    * in the bootconfig example of the BootLoaderspec document:
@@ -212,7 +242,7 @@ ostree_bootconfig_parser_write_at (OstreeBootconfigParser *self, int dfd, const
    */
   const char *fields[] = { "title", "version", "options", "devicetree", "linux", "initrd" };
   g_autoptr (GHashTable) keys_written = g_hash_table_new (g_str_hash, g_str_equal);
-  g_autoptr (GString) buf = g_string_new ("");
+  g_autoptr (GString) buf = g_string_sized_new (512);
 
   for (guint i = 0; i < G_N_ELEMENTS (fields); i++)
     {
@@ -234,15 +264,25 @@ ostree_bootconfig_parser_write_at (OstreeBootconfigParser *self, int dfd, const
         write_key (self, buf, "initrd", *it);
     }
 
-  /* Write unknown fields */
-  GLNX_HASH_TABLE_FOREACH_KV (self->options, const char *, k, const char *, v)
+  /* Write unknown fields, in insertion order so the output is stable */
+  for (guint i = 0; i < self->keys->len; i++)
     {
+      const char *k = self->keys->pdata[i];
       if (g_hash_table_lookup (keys_written, k))
         continue;
-      write_key (self, buf, k, v);
+      write_key (self, buf, k, g_hash_table_lookup (self->options, k));
     }
 
-  if (!glnx_file_replace_contents_at (dfd, path, (guint8 *)buf->str, buf->len,
+  return g_string_free (g_steal_pointer (&buf), FALSE);
+}
+
+gboolean
+ostree_bootconfig_parser_write_at (OstreeBootconfigParser *self, int dfd, const char *path,
+                                   GCancellable *cancellable, GError **error)
+{
+  g_autofree char *contents = _ostree_bootconfig_parser_to_string (self);
+
+  if (!glnx_file_replace_contents_at (dfd, path, (guint8 *)contents, strlen (contents),
                                       GLNX_FILE_REPLACE_NODATASYNC, cancellable, error))
     return FALSE;
 
@@ -263,6 +303,7 @@ ostree_bootconfig_parser_finalize (GObject *object)
   OstreeBootconfigParser *self = OSTREE_BOOTCONFIG_PARSER (object);
 
   g_strfreev (self->overlay_initrds);
+  g_ptr_array_unref (self->keys);
   g_hash_table_unref (self->options);
 
   G_OBJECT_CLASS (ostree_bootconfig_parser_parent_class)->finalize (object);
@@ -272,6 +313,8 @@ static void
 ostree_bootconfig_parser_init (OstreeBootconfigParser *self)
 {
   self->options = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  /* Elements are borrowed from self->options */
+  self->keys = g_ptr_array_new ();
 }
 
 void
@@ -422,16 +422,23 @@ _ostree_bootloader_grub2_write_config (OstreeBootloader *bootloader, int bootver
       return FALSE;
     }
 
-  /* Now let's fdatasync() for the new file */
-  {
-    glnx_autofd int new_config_fd = -1;
-    if (!glnx_openat_rdonly (AT_FDCWD, gs_file_get_path_cached (new_config_path), TRUE,
-                             &new_config_fd, error))
-      return FALSE;
+  /* On EFI we rename over the live grub.cfg just below, so the new contents
+   * must hit stable storage first.  The BIOS config is staged in the new
+   * loader.N directory and only published by the loader symlink swap after a
+   * full filesystem barrier on /boot (see full_system_sync() and
+   * swap_bootloader() in ostree-sysroot-deploy.c), so it needs no sync of
+   * its own.
+   */
+  if (self->is_efi)
+    {
+      glnx_autofd int new_config_fd = -1;
+      if (!glnx_openat_rdonly (AT_FDCWD, gs_file_get_path_cached (new_config_path), TRUE,
+                               &new_config_fd, error))
+        return FALSE;
 
-    if (fdatasync (new_config_fd) < 0)
-      return glnx_throw_errno_prefix (error, "fdatasync");
-  }
+      if (fdatasync (new_config_fd) < 0)
+        return glnx_throw_errno_prefix (error, "fdatasync");
+    }
 
   if (self->is_efi)
     {
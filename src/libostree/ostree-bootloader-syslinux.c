@@ -204,10 +204,15 @@ _ostree_bootloader_syslinux_write_config (OstreeBootloader *bootloader, int boot
                                           cancellable, error))
     return FALSE;
 
+  /* No per-file sync: the config is staged in the new loader.N directory and
+   * only published by the loader symlink swap, which happens after a full
+   * filesystem barrier on /boot; see full_system_sync() and
+   * swap_bootloader() in ostree-sysroot-deploy.c.
+   */
   g_autofree char *new_config_contents = _ostree_sysroot_join_lines (new_lines);
   if (!glnx_file_replace_contents_at (self->sysroot->sysroot_fd, new_config_path,
                                       (guint8 *)new_config_contents, strlen (new_config_contents),
-                                      GLNX_FILE_REPLACE_DATASYNC_NEW, cancellable, error))
+                                      GLNX_FILE_REPLACE_NODATASYNC, cancellable, error))
     return FALSE;
 
   return TRUE;
@@ -43,6 +43,8 @@ static void ostree_chain_input_stream_get_property (GObject *object, guint prop_
 static void ostree_chain_input_stream_finalize (GObject *object);
 static gssize ostree_chain_input_stream_read (GInputStream *stream, void *buffer, gsize count,
                                               GCancellable *cancellable, GError **error);
+static gssize ostree_chain_input_stream_skip (GInputStream *stream, gsize count,
+                                              GCancellable *cancellable, GError **error);
 static gboolean ostree_chain_input_stream_close (GInputStream *stream, GCancellable *cancellable,
                                                  GError **error);
 
@@ -57,6 +59,7 @@ ostree_chain_input_stream_class_init (OstreeChainInputStreamClass *klass)
   gobject_class->finalize = ostree_chain_input_stream_finalize;
 
   stream_class->read_fn = ostree_chain_input_stream_read;
+  stream_class->skip = ostree_chain_input_stream_skip;
   stream_class->close_fn = ostree_chain_input_stream_close;
 
   /*
@@ -140,25 +143,74 @@ ostree_chain_input_stream_read (GInputStream *stream, void *buffer, gsize count,
                                 GCancellable *cancellable, GError **error)
 {
   OstreeChainInputStream *self = (OstreeChainInputStream *)stream;
-  GInputStream *child;
-  gssize res = -1;
+  gsize total = 0;
 
   if (g_cancellable_set_error_if_cancelled (cancellable, error))
     return -1;
 
-  if (self->priv->index >= self->priv->streams->len)
-    return 0;
+  /* Keep filling the caller's buffer across segment boundaries; the first
+   * segments are typically small headers, and returning a short read at
+   * each seam defeats callers doing large aligned reads.
+   */
+  while (total < count && self->priv->index < self->priv->streams->len)
+    {
+      GInputStream *child = self->priv->streams->pdata[self->priv->index];
+      gssize res
+          = g_input_stream_read (child, (guint8 *)buffer + total, count - total, cancellable, error);
+      if (res < 0)
+        {
+          /* Data already copied out of a previous segment must be reported;
+           * the error will surface again on the next read.
+           */
+          if (total > 0)
+            {
+              g_clear_error (error);
+              return total;
+            }
+          return -1;
+        }
+      if (res == 0)
+        self->priv->index++;
+      else
+        total += res;
+    }
+
+  return total;
+}
+
+static gssize
+ostree_chain_input_stream_skip (GInputStream *stream, gsize count, GCancellable *cancellable,
+                                GError **error)
+{
+  OstreeChainInputStream *self = (OstreeChainInputStream *)stream;
+  gsize total = 0;
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return -1;
 
-  res = 0;
-  while (res == 0 && self->priv->index < self->priv->streams->len)
+  /* Delegate to the children rather than falling back to GInputStream's
+   * generic read-and-discard loop; seekable segments then skip in place.
+   */
+  while (total < count && self->priv->index < self->priv->streams->len)
     {
-      child = self->priv->streams->pdata[self->priv->index];
-      res = g_input_stream_read (child, buffer, count, cancellable, error);
+      GInputStream *child = self->priv->streams->pdata[self->priv->index];
+      gssize res = g_input_stream_skip (child, count - total, cancellable, error);
+      if (res < 0)
+        {
+          if (total > 0)
+            {
+              g_clear_error (error);
+              return total;
+            }
+          return -1;
+        }
       if (res == 0)
         self->priv->index++;
+      else
+        total += res;
     }
 
-  return res;
+  return total;
 }
 
 static gboolean
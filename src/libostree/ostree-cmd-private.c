@@ -50,6 +50,11 @@ ostree_cmd__private__ (void)
     _ostree_repo_static_delta_dump,   _ostree_repo_static_delta_query_exists,
     _ostree_repo_static_delta_delete, _ostree_repo_verify_bindings,
     _ostree_sysroot_finalize_staged,  _ostree_sysroot_boot_complete,
+    _ostree_repo_pack_create,         _ostree_repo_pack_refs,
+    _ostree_repo_chunked_create,      _ostree_repo_checkout_at_fanout,
+    _ostree_repo_physical_order_objects, _ostree_repo_advise_object_read,
+    _ostree_repo_static_delta_fsck,      _ostree_repo_migrate_fanout,
+    _ostree_repo_defrag,
   };
 
   return &table;
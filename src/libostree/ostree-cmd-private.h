@@ -46,6 +46,27 @@ typedef struct
                                       GError **error);
   gboolean (*ostree_boot_complete) (OstreeSysroot *sysroot, GCancellable *cancellable,
                                     GError **error);
+  gboolean (*ostree_repo_pack_create) (OstreeRepo *repo, GPtrArray *objects, guint *out_n_packed,
+                                       GCancellable *cancellable, GError **error);
+  gboolean (*ostree_repo_pack_refs) (OstreeRepo *repo, GCancellable *cancellable, GError **error);
+  gboolean (*ostree_repo_chunked_create) (OstreeRepo *repo, GPtrArray *objects, guint64 min_size,
+                                          guint *out_n_chunked, GCancellable *cancellable,
+                                          GError **error);
+  gboolean (*ostree_repo_checkout_at_fanout) (OstreeRepo *repo,
+                                              OstreeRepoCheckoutAtOptions *options,
+                                              int destination_dfd,
+                                              const char *const *destination_paths,
+                                              const char *commit, GCancellable *cancellable,
+                                              GError **error);
+  void (*ostree_repo_physical_order_objects) (OstreeRepo *repo, GPtrArray *objects);
+  void (*ostree_repo_advise_object_read) (OstreeRepo *repo, OstreeObjectType objtype,
+                                          const char *checksum);
+  gboolean (*ostree_static_delta_fsck) (OstreeRepo *repo, const char *delta_id, guint n_threads,
+                                        GCancellable *cancellable, GError **error);
+  gboolean (*ostree_repo_migrate_fanout) (OstreeRepo *repo, guint *out_n_migrated,
+                                          GCancellable *cancellable, GError **error);
+  gboolean (*ostree_repo_defrag) (OstreeRepo *repo, guint *out_n_rewritten,
+                                  GCancellable *cancellable, GError **error);
 } OstreeCmdPrivateVTable;
 
 /* Note this not really "public", we just export the symbol, but not the header */
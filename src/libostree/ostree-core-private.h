@@ -145,12 +145,20 @@ gboolean _ostree_parse_delta_name (const char *delta_name, char **out_from, char
 void _ostree_loose_path (char *buf, const char *checksum, OstreeObjectType objtype,
                          OstreeRepoMode repo_mode);
 
+void _ostree_loose_path_with_fanout (char *buf, const char *checksum, OstreeObjectType objtype,
+                                     OstreeRepoMode repo_mode, gboolean deep_fanout);
+
 gboolean _ostree_validate_structureof_metadata (OstreeObjectType objtype, GVariant *commit,
                                                 GError **error);
 
 gboolean _ostree_verify_metadata_object (OstreeObjectType objtype, const char *expected_checksum,
                                          GVariant *metadata, GError **error);
 
+gboolean _ostree_verify_metadata_object_with_digest (OstreeObjectType objtype,
+                                                     const char *expected_checksum,
+                                                     GVariant *metadata, GBytes *sha256_digest,
+                                                     GError **error);
+
 #define _OSTREE_METADATA_GPGSIGS_NAME "ostree.gpgsigs"
 #define _OSTREE_METADATA_GPGSIGS_TYPE G_VARIANT_TYPE ("aay")
 
@@ -177,4 +185,37 @@ gboolean _ostree_raw_file_to_archive_stream (GInputStream *input, GFileInfo *fil
 gboolean _ostree_compare_timestamps (const char *current_rev, guint64 current_ts,
                                      const char *new_rev, guint64 new_ts, GError **error);
 
+/* Borrowing iterator over a serialized dirtree variant: entry names and
+ * checksums are returned as pointers into the variant's data, with no
+ * per-child copies or GVariant instances.  The caller must keep the
+ * dirtree variant alive for the lifetime of the returned pointers.
+ */
+typedef struct
+{
+  /* <private> */
+  const guint8 *base;
+  gsize data_end;
+  const guint8 *offsets;
+  guint offset_size;
+  guint n;
+  guint i;
+  gsize prev_end;
+} OtDirtreeArrayIter;
+
+typedef struct
+{
+  /* <private> */
+  OtDirtreeArrayIter files;
+  OtDirtreeArrayIter dirs;
+} OtDirtreeIter;
+
+gboolean _ostree_dirtree_iter_init (OtDirtreeIter *iter, GVariant *dirtree, GError **error);
+
+gboolean _ostree_dirtree_iter_next_file (OtDirtreeIter *iter, const char **out_name,
+                                         const guint8 **out_csum, GError **error);
+
+gboolean _ostree_dirtree_iter_next_dir (OtDirtreeIter *iter, const char **out_name,
+                                        const guint8 **out_tree_csum, const guint8 **out_meta_csum,
+                                        GError **error);
+
 G_END_DECLS
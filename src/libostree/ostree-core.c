@@ -32,8 +32,14 @@
 #include <gio/gunixinputstream.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 
+/* The standardized version of BTRFS_IOC_CLONE */
+#ifndef FICLONE
+#define FICLONE _IOW (0x94, 9, int)
+#endif
+
 /* Generic ABI checks */
 G_STATIC_ASSERT (OSTREE_REPO_MODE_BARE == 0);
 G_STATIC_ASSERT (OSTREE_REPO_MODE_ARCHIVE_Z2 == 1);
@@ -716,6 +722,62 @@ break_symhardlink (int dfd, const char *path, struct stat *stbuf, GLnxFileCopyFl
   return TRUE;
 }
 
+/* Break a regular-file hardlink via a reflink clone.  On filesystems with
+ * reflink support (btrfs, XFS) this shares the extents of the original
+ * object, making the "copy" O(metadata) regardless of file size; later
+ * writes allocate only the touched ranges via copy-on-write.  If the
+ * filesystem doesn't support FICLONE we return successfully with
+ * *out_did_clone = %FALSE and the caller falls back to a full copy.
+ */
+static gboolean
+break_hardlink_reflink (int dfd, const char *path, const struct stat *stbuf, gboolean skip_xattrs,
+                        gboolean *out_did_clone, GCancellable *cancellable, GError **error)
+{
+  *out_did_clone = FALSE;
+
+  glnx_autofd int src_fd = -1;
+  if (!glnx_openat_rdonly (dfd, path, FALSE, &src_fd, error))
+    return FALSE;
+
+  g_auto (GLnxTmpfile) tmpf = {
+    0,
+  };
+  if (!glnx_open_tmpfile_linkable_at (dfd, ".", O_WRONLY | O_CLOEXEC, &tmpf, error))
+    return FALSE;
+
+  if (ioctl (tmpf.fd, FICLONE, src_fd) != 0)
+    return TRUE; /* No reflink support; note early return */
+
+  /* Mirror what glnx_file_copy_at() carries over on the plain copy path:
+   * ownership, permissions, xattrs and timestamps.
+   */
+  if (fchown (tmpf.fd, stbuf->st_uid, stbuf->st_gid) != 0)
+    return glnx_throw_errno_prefix (error, "fchown");
+  if (fchmod (tmpf.fd, stbuf->st_mode & ALLPERMS) != 0)
+    return glnx_throw_errno_prefix (error, "fchmod");
+
+  if (!skip_xattrs)
+    {
+      g_autoptr (GVariant) xattrs = NULL;
+      if (!glnx_fd_get_all_xattrs (src_fd, &xattrs, cancellable, error))
+        return FALSE;
+      if (!glnx_fd_set_all_xattrs (tmpf.fd, xattrs, cancellable, error))
+        return FALSE;
+    }
+
+  {
+    struct timespec ts[2] = { stbuf->st_atim, stbuf->st_mtim };
+    if (futimens (tmpf.fd, ts) != 0)
+      return glnx_throw_errno_prefix (error, "futimens");
+  }
+
+  if (!glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, dfd, path, error))
+    return FALSE;
+
+  *out_did_clone = TRUE;
+  return TRUE;
+}
+
 /**
  * ostree_break_hardlink:
  * @dfd: Directory fd
@@ -729,6 +791,8 @@ break_symhardlink (int dfd, const char *path, struct stat *stbuf, GLnxFileCopyFl
  *
  * This function performs full copying, including e.g. extended
  * attributes and permissions of both regular files and symbolic links.
+ * On filesystems supporting reflinks the content copy is performed as
+ * an `FICLONE`, sharing extents with the original object.
  *
  * If the file is not hardlinked, this function does nothing and
  * returns successfully.
@@ -755,12 +819,24 @@ ostree_break_hardlink (int dfd, const char *path, gboolean skip_xattrs, GCancell
   const GLnxFileCopyFlags copyflags = skip_xattrs ? GLNX_FILE_COPY_NOXATTRS : 0;
 
   if (S_ISREG (stbuf.st_mode))
-    /* Note it's now completely safe to copy a file to itself,
-     * as glnx_file_copy_at() is documented to do an O_TMPFILE + rename()
-     * with GLNX_FILE_COPY_OVERWRITE.
-     */
-    return glnx_file_copy_at (dfd, path, &stbuf, dfd, path, copyflags | GLNX_FILE_COPY_OVERWRITE,
-                              cancellable, error);
+    {
+      /* Prefer a reflink clone; rofiles-fuse copyup of large files is the
+       * hot caller here, and cloning makes it constant-time where the
+       * filesystem allows.
+       */
+      gboolean did_clone = FALSE;
+      if (!break_hardlink_reflink (dfd, path, &stbuf, skip_xattrs, &did_clone, cancellable, error))
+        return FALSE;
+      if (did_clone)
+        return TRUE;
+
+      /* Note it's now completely safe to copy a file to itself,
+       * as glnx_file_copy_at() is documented to do an O_TMPFILE + rename()
+       * with GLNX_FILE_COPY_OVERWRITE.
+       */
+      return glnx_file_copy_at (dfd, path, &stbuf, dfd, path, copyflags | GLNX_FILE_COPY_OVERWRITE,
+                                cancellable, error);
+    }
   else if (S_ISLNK (stbuf.st_mode))
     return break_symhardlink (dfd, path, &stbuf, copyflags, cancellable, error);
   else
@@ -1579,13 +1655,39 @@ ostree_checksum_bytes_peek_validate (GVariant *bytes, GError **error)
  */
 void
 _ostree_loose_path (char *buf, const char *checksum, OstreeObjectType objtype, OstreeRepoMode mode)
+{
+  _ostree_loose_path_with_fanout (buf, checksum, objtype, mode, FALSE);
+}
+
+/*
+ * _ostree_loose_path_with_fanout:
+ *
+ * Like _ostree_loose_path(), but when @deep_fanout is %TRUE use a
+ * two-level fanout (`xx/yy/`) keyed by the first two checksum bytes.
+ * With a single 256-way fanout, repositories with millions of objects
+ * end up with tens of thousands of entries per fanout directory and
+ * directory operations degrade; the second level caps each directory at
+ * a manageable size.  See the `core.deep-fanout` repository option.
+ */
+void
+_ostree_loose_path_with_fanout (char *buf, const char *checksum, OstreeObjectType objtype,
+                                OstreeRepoMode mode, gboolean deep_fanout)
 {
   *buf = checksum[0];
   buf++;
   *buf = checksum[1];
   buf++;
-  snprintf (buf, _OSTREE_LOOSE_PATH_MAX - 2, "/%s.%s%s", checksum + 2,
-            ostree_object_type_to_string (objtype),
+  if (deep_fanout)
+    {
+      *buf = '/';
+      buf++;
+      *buf = checksum[2];
+      buf++;
+      *buf = checksum[3];
+      buf++;
+    }
+  snprintf (buf, _OSTREE_LOOSE_PATH_MAX - (deep_fanout ? 5 : 2), "/%s.%s%s",
+            checksum + (deep_fanout ? 4 : 2), ostree_object_type_to_string (objtype),
             (!OSTREE_OBJECT_TYPE_IS_META (objtype) && mode == OSTREE_REPO_MODE_ARCHIVE) ? "z" : "");
 }
 
@@ -2086,21 +2188,35 @@ _ostree_validate_structureof_metadata (OstreeObjectType objtype, GVariant *metad
  * and its "structure" or the additional schema we impose on GVariants such
  * as ensuring the "ay" checksum entries are of length 32.  Another important
  * one is checking for path traversal in dirtree objects.
+ *
+ * If @sha256_digest is non-%NULL, it must be the SHA-256 of @metadata's
+ * serialized bytes (e.g. computed while they streamed off the network), and
+ * we compare it directly instead of re-hashing the variant.
  */
 gboolean
-_ostree_verify_metadata_object (OstreeObjectType objtype, const char *expected_checksum,
-                                GVariant *metadata, GError **error)
+_ostree_verify_metadata_object_with_digest (OstreeObjectType objtype,
+                                            const char *expected_checksum, GVariant *metadata,
+                                            GBytes *sha256_digest, GError **error)
 {
   g_assert (expected_checksum);
 
-  g_auto (OtChecksum) hasher = {
-    0,
-  };
-  ot_checksum_init (&hasher);
-  ot_checksum_update (&hasher, g_variant_get_data (metadata), g_variant_get_size (metadata));
-
   char actual_checksum[OSTREE_SHA256_STRING_LEN + 1];
-  ot_checksum_get_hexdigest (&hasher, actual_checksum, sizeof (actual_checksum));
+  if (sha256_digest != NULL)
+    {
+      gsize digest_len;
+      const guchar *digest = g_bytes_get_data (sha256_digest, &digest_len);
+      g_assert_cmpuint (digest_len, ==, OSTREE_SHA256_DIGEST_LEN);
+      ostree_checksum_inplace_from_bytes (digest, actual_checksum);
+    }
+  else
+    {
+      g_auto (OtChecksum) hasher = {
+        0,
+      };
+      ot_checksum_init (&hasher);
+      ot_checksum_update (&hasher, g_variant_get_data (metadata), g_variant_get_size (metadata));
+      ot_checksum_get_hexdigest (&hasher, actual_checksum, sizeof (actual_checksum));
+    }
   if (!_ostree_compare_object_checksum (objtype, expected_checksum, actual_checksum, error))
     return FALSE;
 
@@ -2116,6 +2232,14 @@ _ostree_verify_metadata_object (OstreeObjectType objtype, const char *expected_c
   return TRUE;
 }
 
+gboolean
+_ostree_verify_metadata_object (OstreeObjectType objtype, const char *expected_checksum,
+                                GVariant *metadata, GError **error)
+{
+  return _ostree_verify_metadata_object_with_digest (objtype, expected_checksum, metadata, NULL,
+                                                     error);
+}
+
 /**
  * ostree_validate_structureof_commit:
  * @commit: A commit object, %OSTREE_OBJECT_TYPE_COMMIT
@@ -2222,6 +2346,207 @@ ostree_validate_structureof_dirtree (GVariant *dirtree, GError **error)
   return TRUE;
 }
 
+/* The borrowing dirtree iterator below walks the serialized form of a
+ * dirtree directly: entry names and checksums are returned as pointers
+ * into the variant's (usually mmap'ed) data, so iterating a tree makes
+ * no per-child allocations at all.  The framing rules here mirror the
+ * GVariant serialization spec for `(a(say)a(sayay))`; note that all
+ * members have alignment 1, so there is never any padding to skip.
+ * Anything that doesn't parse cleanly is rejected, which is strictly
+ * stricter than the GVariant API (which substitutes default values for
+ * malformed framing).
+ */
+
+static inline guint
+dirtree_offset_size (gsize size)
+{
+  if (size <= G_MAXUINT8)
+    return 1;
+  if (size <= G_MAXUINT16)
+    return 2;
+  if (size <= G_MAXUINT32)
+    return 4;
+  return 8;
+}
+
+static inline gsize
+dirtree_read_offset (const guint8 *p, guint offset_size)
+{
+  switch (offset_size)
+    {
+    case 1:
+      return p[0];
+    case 2:
+      {
+        guint16 v;
+        memcpy (&v, p, sizeof (v));
+        return GUINT16_FROM_LE (v);
+      }
+    case 4:
+      {
+        guint32 v;
+        memcpy (&v, p, sizeof (v));
+        return GUINT32_FROM_LE (v);
+      }
+    default:
+      {
+        guint64 v;
+        memcpy (&v, p, sizeof (v));
+        return (gsize)GUINT64_FROM_LE (v);
+      }
+    }
+}
+
+/* Set up iteration over one of the two entry arrays; @base/@size bound
+ * its serialization.  Variable-width elements mean the element count is
+ * recovered from the framing offsets at the end of the array.
+ */
+static gboolean
+dirtree_array_iter_init (OtDirtreeArrayIter *arr, const guint8 *base, gsize size, GError **error)
+{
+  arr->base = base;
+  arr->i = 0;
+  arr->prev_end = 0;
+
+  if (size == 0)
+    {
+      arr->n = 0;
+      return TRUE;
+    }
+
+  arr->offset_size = dirtree_offset_size (size);
+  if (size < arr->offset_size)
+    return glnx_throw (error, "Truncated entry array");
+  arr->data_end = dirtree_read_offset (base + size - arr->offset_size, arr->offset_size);
+  const gsize offsets_size = size - arr->data_end;
+  if (arr->data_end > size - arr->offset_size || (offsets_size % arr->offset_size) != 0)
+    return glnx_throw (error, "Corrupt entry array framing");
+  arr->n = offsets_size / arr->offset_size;
+  arr->offsets = base + arr->data_end;
+  return TRUE;
+}
+
+/* Parse the next `(say)` or `(sayay)` entry, returning borrowed pointers.
+ * @out_csum/@out_csum2 receive exactly %OSTREE_SHA256_DIGEST_LEN bytes;
+ * pass @out_csum2 as %NULL for the files array.  At the end of the array,
+ * returns %TRUE with *@out_name set to %NULL.
+ */
+static gboolean
+dirtree_array_iter_next (OtDirtreeArrayIter *arr, const char **out_name, const guint8 **out_csum,
+                         const guint8 **out_csum2, GError **error)
+{
+  if (arr->i == arr->n)
+    {
+      *out_name = NULL;
+      return TRUE;
+    }
+
+  const gsize start = arr->prev_end;
+  const gsize end = dirtree_read_offset (arr->offsets + arr->i * arr->offset_size, arr->offset_size);
+  if (end < start || end > arr->data_end)
+    return glnx_throw (error, "Corrupt entry array framing");
+
+  const gsize tuple_size = end - start;
+  const guint tuple_offset_size = dirtree_offset_size (tuple_size);
+  const guint n_offsets = (out_csum2 != NULL) ? 2 : 1;
+  const gsize min_size = 1 + OSTREE_SHA256_DIGEST_LEN * n_offsets + tuple_offset_size * n_offsets;
+  if (tuple_size < min_size)
+    return glnx_throw (error, "Truncated entry");
+
+  const guint8 *tuple = arr->base + start;
+  const gsize members_end = tuple_size - tuple_offset_size * n_offsets;
+
+  /* The framing offsets are stored in reverse member order, so the
+   * string's end offset is the last one.
+   */
+  const gsize name_end
+      = dirtree_read_offset (tuple + tuple_size - tuple_offset_size, tuple_offset_size);
+  if (name_end < 1 || name_end > members_end || tuple[name_end - 1] != '\0'
+      || strlen ((const char *)tuple) != name_end - 1)
+    return glnx_throw (error, "Invalid entry name");
+
+  if (out_csum2 == NULL)
+    {
+      if (members_end - name_end != OSTREE_SHA256_DIGEST_LEN)
+        return glnx_throw (error, "Invalid entry checksum length");
+      *out_csum = tuple + name_end;
+    }
+  else
+    {
+      const gsize csum_end
+          = dirtree_read_offset (tuple + tuple_size - 2 * tuple_offset_size, tuple_offset_size);
+      if (csum_end < name_end || csum_end > members_end
+          || csum_end - name_end != OSTREE_SHA256_DIGEST_LEN
+          || members_end - csum_end != OSTREE_SHA256_DIGEST_LEN)
+        return glnx_throw (error, "Invalid entry checksum length");
+      *out_csum = tuple + name_end;
+      *out_csum2 = tuple + csum_end;
+    }
+
+  *out_name = (const char *)tuple;
+  arr->prev_end = end;
+  arr->i++;
+  return TRUE;
+}
+
+/* Initialize a borrowing iterator over @dirtree, which must be a
+ * serialized %OSTREE_OBJECT_TYPE_DIR_TREE variant.  The iterator only
+ * borrows from @dirtree; the caller must keep its ref alive while
+ * iterating.
+ */
+gboolean
+_ostree_dirtree_iter_init (OtDirtreeIter *iter, GVariant *dirtree, GError **error)
+{
+  const guint8 *data = g_variant_get_data (dirtree);
+  const gsize size = g_variant_get_size (dirtree);
+
+  if (size == 0)
+    {
+      /* GVariant treats unparseable serializations as the default (empty) value */
+      memset (iter, 0, sizeof (*iter));
+      return TRUE;
+    }
+
+  const guint offset_size = dirtree_offset_size (size);
+  if (size < offset_size)
+    return glnx_throw (error, "Invalid dirtree: truncated");
+  const gsize files_end = dirtree_read_offset (data + size - offset_size, offset_size);
+  if (files_end > size - offset_size)
+    return glnx_throw (error, "Invalid dirtree: corrupt framing");
+
+  if (!dirtree_array_iter_init (&iter->files, data, files_end, error))
+    return glnx_prefix_error (error, "Invalid dirtree");
+  if (!dirtree_array_iter_init (&iter->dirs, data + files_end, size - offset_size - files_end,
+                                error))
+    return glnx_prefix_error (error, "Invalid dirtree");
+  return TRUE;
+}
+
+/* Fetch the next file entry; *@out_name is %NULL at the end of the array.
+ * @out_csum points to %OSTREE_SHA256_DIGEST_LEN borrowed bytes.
+ */
+gboolean
+_ostree_dirtree_iter_next_file (OtDirtreeIter *iter, const char **out_name,
+                                const guint8 **out_csum, GError **error)
+{
+  if (!dirtree_array_iter_next (&iter->files, out_name, out_csum, NULL, error))
+    return glnx_prefix_error (error, "Invalid dirtree file entry %u", iter->files.i);
+  return TRUE;
+}
+
+/* As _ostree_dirtree_iter_next_file(), but over the subdirectory array,
+ * returning both the tree and meta checksums.
+ */
+gboolean
+_ostree_dirtree_iter_next_dir (OtDirtreeIter *iter, const char **out_name,
+                               const guint8 **out_tree_csum, const guint8 **out_meta_csum,
+                               GError **error)
+{
+  if (!dirtree_array_iter_next (&iter->dirs, out_name, out_tree_csum, out_meta_csum, error))
+    return glnx_prefix_error (error, "Invalid dirtree dir entry %u", iter->dirs.i);
+  return TRUE;
+}
+
 /* This bit mirrors similar code in commit_loose_regfile_object() for the
  * bare-user-only mode. It's opt-in though for all pulls.
  */
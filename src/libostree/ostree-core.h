@@ -302,6 +302,35 @@ typedef enum
  * Since: 2018.6
  */
 #define OSTREE_COMMIT_META_KEY_COLLECTION_BINDING "ostree.collection-binding"
+/**
+ * OSTREE_COMMIT_META_KEY_CHANGELOG_STATS:
+ *
+ * GVariant type `(uuutt)`: number of files added, changed and removed
+ * relative to the parent commit, followed by content bytes added and
+ * removed; all values are big endian.  This is stored as *detached*
+ * commit metadata (see ostree_repo_read_commit_detached_metadata()) so
+ * it does not affect the commit checksum.  Tools rendering history can
+ * read this one small variant instead of diffing the full trees of each
+ * commit pair.
+ *
+ * Since: 2023.6
+ */
+#define OSTREE_COMMIT_META_KEY_CHANGELOG_STATS "ostree.changelog-stats"
+/**
+ * OSTREE_COMMIT_META_KEY_INLINE_CONTENT:
+ *
+ * GVariant type `a(ayay)`: for each entry, the first `ay` is a content
+ * object checksum and the second is that object's canonical object
+ * stream (as returned by ostree_repo_load_object_stream()).  Small
+ * content objects can be embedded here at commit time (see the
+ * `core.inline-content-max-bytes` repository option); `ostree_repo_pull()`
+ * imports them directly from the detached metadata instead of issuing
+ * one HTTP request per object.  This is stored as *detached* commit
+ * metadata so the commit checksum and object format are unaffected.
+ *
+ * Since: 2023.6
+ */
+#define OSTREE_COMMIT_META_KEY_INLINE_CONTENT "ostree.inline-content"
 
 _OSTREE_PUBLIC
 const GVariantType *ostree_metadata_variant_type (OstreeObjectType objtype);
@@ -168,6 +168,199 @@ diff_add_dir_recurse (GFile *d, GPtrArray *added, GCancellable *cancellable, GEr
   return TRUE;
 }
 
+/* Work queue for parallel diffs; see the diff_threads option.  Directory
+ * pairs are dispatched as jobs onto a thread pool; each job diffs one
+ * directory's immediate entries into private result arrays and dispatches
+ * its subdirectories in turn.  The per-job results are spliced back into
+ * the caller's arrays in path order once everything has completed, so the
+ * output is deterministic regardless of scheduling.
+ */
+typedef struct _DiffWorkQueue DiffWorkQueue;
+
+typedef struct
+{
+  DiffWorkQueue *queue; /* unowned */
+  char *path;           /* of @a; orders results at drain time */
+  GFile *a;
+  GFile *b;
+  GPtrArray *modified;
+  GPtrArray *removed;
+  GPtrArray *added;
+} DiffWorkItem;
+
+struct _DiffWorkQueue
+{
+  OstreeDiffFlags flags;
+  OstreeDiffDirsOptions *options; /* unowned */
+  OtThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  guint outstanding;
+  GError *caught_error; /* first worker error wins */
+  GPtrArray *items;     /* DiffWorkItem*; protected by lock */
+  GCancellable *cancellable;
+};
+
+static gboolean diff_dirs_internal (DiffWorkQueue *queue, OstreeDiffFlags flags, GFile *a, GFile *b,
+                                    GPtrArray *modified, GPtrArray *removed, GPtrArray *added,
+                                    OstreeDiffDirsOptions *options, GCancellable *cancellable,
+                                    GError **error);
+
+static void
+diff_work_item_free (gpointer data)
+{
+  DiffWorkItem *item = data;
+  g_object_unref (item->a);
+  g_object_unref (item->b);
+  g_ptr_array_unref (item->modified);
+  g_ptr_array_unref (item->removed);
+  g_ptr_array_unref (item->added);
+  g_free (item->path);
+  g_free (item);
+}
+
+static void
+diff_queue_worker (gpointer data, gpointer user_data)
+{
+  DiffWorkItem *item = data;
+  DiffWorkQueue *queue = item->queue;
+  g_autoptr (GError) local_error = NULL;
+
+  /* Don't bother starting new subtrees once something failed */
+  g_mutex_lock (&queue->lock);
+  const gboolean had_error = queue->caught_error != NULL;
+  g_mutex_unlock (&queue->lock);
+
+  if (!had_error)
+    (void)diff_dirs_internal (queue, queue->flags, item->a, item->b, item->modified, item->removed,
+                              item->added, queue->options, queue->cancellable, &local_error);
+
+  g_mutex_lock (&queue->lock);
+  if (local_error != NULL && queue->caught_error == NULL)
+    queue->caught_error = g_steal_pointer (&local_error);
+  g_assert_cmpuint (queue->outstanding, >, 0);
+  queue->outstanding--;
+  g_cond_signal (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+}
+
+static void
+diff_queue_push (DiffWorkQueue *queue, GFile *a, GFile *b)
+{
+  DiffWorkItem *item = g_new0 (DiffWorkItem, 1);
+  item->queue = queue;
+  item->path = g_file_get_path (a);
+  item->a = g_object_ref (a);
+  item->b = g_object_ref (b);
+  item->modified = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_diff_item_unref);
+  item->removed = g_ptr_array_new_with_free_func (g_object_unref);
+  item->added = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_mutex_lock (&queue->lock);
+  queue->outstanding++;
+  g_ptr_array_add (queue->items, item);
+  g_mutex_unlock (&queue->lock);
+  ot_thread_pool_push (queue->pool, item);
+}
+
+static int
+diff_work_item_compare (gconstpointer ap, gconstpointer bp)
+{
+  const DiffWorkItem *a = *((DiffWorkItem **)ap);
+  const DiffWorkItem *b = *((DiffWorkItem **)bp);
+  return g_strcmp0 (a->path, b->path);
+}
+
+/* Move all elements of @src to the end of @dest, transferring ownership */
+static void
+diff_splice_results (GPtrArray *dest, GPtrArray *src)
+{
+  g_ptr_array_set_free_func (src, NULL);
+  for (guint i = 0; i < src->len; i++)
+    g_ptr_array_add (dest, src->pdata[i]);
+  g_ptr_array_set_size (src, 0);
+}
+
+/* Wait for all dispatched directory pairs to complete; on success splice
+ * their results into the caller's arrays, and otherwise propagate the first
+ * error any worker hit.
+ */
+static gboolean
+diff_queue_drain (DiffWorkQueue *queue, GPtrArray *modified, GPtrArray *removed, GPtrArray *added,
+                  GError **error)
+{
+  g_mutex_lock (&queue->lock);
+  while (queue->outstanding > 0)
+    g_cond_wait (&queue->cond, &queue->lock);
+  g_autoptr (GError) caught_error = g_steal_pointer (&queue->caught_error);
+  g_mutex_unlock (&queue->lock);
+
+  if (caught_error)
+    {
+      g_propagate_error (error, g_steal_pointer (&caught_error));
+      return FALSE;
+    }
+
+  /* Workers dispatch nested subtrees themselves, so the items completed in
+   * scheduling order; sort by path to keep the output deterministic.
+   */
+  g_ptr_array_sort (queue->items, diff_work_item_compare);
+  for (guint i = 0; i < queue->items->len; i++)
+    {
+      DiffWorkItem *item = queue->items->pdata[i];
+      diff_splice_results (modified, item->modified);
+      diff_splice_results (removed, item->removed);
+      diff_splice_results (added, item->added);
+    }
+  return TRUE;
+}
+
+static void
+diff_queue_free (DiffWorkQueue *queue)
+{
+  if (queue == NULL)
+    return;
+  g_mutex_lock (&queue->lock);
+  while (queue->outstanding > 0)
+    g_cond_wait (&queue->cond, &queue->lock);
+  g_mutex_unlock (&queue->lock);
+  ot_thread_pool_free (queue->pool);
+  g_clear_error (&queue->caught_error);
+  g_ptr_array_unref (queue->items);
+  g_cond_clear (&queue->cond);
+  g_mutex_clear (&queue->lock);
+  g_free (queue);
+}
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (DiffWorkQueue, diff_queue_free)
+
+/* Look up the dirtree checksum recorded for subdirectory @name in @dir's own
+ * tree object, without resolving (and hence loading the variants of) the
+ * child itself.  Returns %NULL if @dir is not a resolved repository
+ * directory or @name is not a subdirectory entry.
+ */
+static char *
+lookup_subdir_contents_checksum (GFile *dir, const char *name)
+{
+  if (!OSTREE_IS_REPO_FILE (dir))
+    return NULL;
+
+  OstreeRepoFile *repof = (OstreeRepoFile *)dir;
+  if (ostree_repo_file_tree_get_contents (repof) == NULL)
+    return NULL;
+
+  gboolean is_dir = FALSE;
+  g_autoptr (GVariant) subdirs = NULL;
+  int i = ostree_repo_file_tree_find_child (repof, name, &is_dir, &subdirs);
+  if (i < 0 || !is_dir)
+    return NULL;
+
+  g_autoptr (GVariant) contents_csum_v = NULL;
+  g_variant_get_child (subdirs, i, "(&s@ay@ay)", NULL, &contents_csum_v, NULL);
+  if (g_variant_n_children (contents_csum_v) != OSTREE_SHA256_DIGEST_LEN)
+    return NULL;
+  return ostree_checksum_from_bytes_v (contents_csum_v);
+}
+
 /**
  * ostree_diff_dirs:
  * @flags: Flags
@@ -190,27 +383,10 @@ ostree_diff_dirs (OstreeDiffFlags flags, GFile *a, GFile *b, GPtrArray *modified
                                         error);
 }
 
-/**
- * ostree_diff_dirs_with_options:
- * @flags: Flags
- * @a: First directory path, or %NULL
- * @b: First directory path
- * @modified: (element-type OstreeDiffItem): Modified files
- * @removed: (element-type Gio.File): Removed files
- * @added: (element-type Gio.File): Added files
- * @cancellable: Cancellable
- * @options: (allow-none): Options
- * @error: Error
- *
- * Compute the difference between directory @a and @b as 3 separate
- * sets of #OstreeDiffItem in @modified, @removed, and @added.
- *
- * Since: 2017.4
- */
-gboolean
-ostree_diff_dirs_with_options (OstreeDiffFlags flags, GFile *a, GFile *b, GPtrArray *modified,
-                               GPtrArray *removed, GPtrArray *added, OstreeDiffDirsOptions *options,
-                               GCancellable *cancellable, GError **error)
+static gboolean
+diff_dirs_internal (DiffWorkQueue *queue, OstreeDiffFlags flags, GFile *a, GFile *b,
+                    GPtrArray *modified, GPtrArray *removed, GPtrArray *added,
+                    OstreeDiffDirsOptions *options, GCancellable *cancellable, GError **error)
 {
   gboolean ret = FALSE;
   GError *temp_error = NULL;
@@ -219,10 +395,6 @@ ostree_diff_dirs_with_options (OstreeDiffFlags flags, GFile *a, GFile *b, GPtrAr
   g_autoptr (GFile) child_b = NULL;
   g_autoptr (GFileInfo) child_a_info = NULL;
   g_autoptr (GFileInfo) child_b_info = NULL;
-  OstreeDiffDirsOptions default_opts = OSTREE_DIFF_DIRS_OPTIONS_INIT;
-
-  if (!options)
-    options = &default_opts;
 
   /* If we're diffing versus a repo, and either of them have xattrs disabled,
    * then disable for both.
@@ -344,8 +516,18 @@ ostree_diff_dirs_with_options (OstreeDiffFlags flags, GFile *a, GFile *b, GPtrAr
 
               if (child_a_type == G_FILE_TYPE_DIRECTORY)
                 {
-                  if (!ostree_diff_dirs_with_options (flags, child_a, child_b, modified, removed,
-                                                      added, options, cancellable, error))
+                  /* If both parents record the same dirtree checksum for this
+                   * entry, the subtrees are identical; skip them without
+                   * loading any of their tree variants.
+                   */
+                  g_autofree char *sub_a_checksum = lookup_subdir_contents_checksum (a, name);
+                  g_autofree char *sub_b_checksum = lookup_subdir_contents_checksum (b, name);
+                  if (sub_a_checksum != NULL && g_strcmp0 (sub_a_checksum, sub_b_checksum) == 0)
+                    ;
+                  else if (queue != NULL)
+                    diff_queue_push (queue, child_a, child_b);
+                  else if (!diff_dirs_internal (NULL, flags, child_a, child_b, modified, removed,
+                                                added, options, cancellable, error))
                     goto out;
                 }
             }
@@ -413,6 +595,62 @@ out:
   return ret;
 }
 
+/**
+ * ostree_diff_dirs_with_options:
+ * @flags: Flags
+ * @a: First directory path, or %NULL
+ * @b: First directory path
+ * @modified: (element-type OstreeDiffItem): Modified files
+ * @removed: (element-type Gio.File): Removed files
+ * @added: (element-type Gio.File): Added files
+ * @cancellable: Cancellable
+ * @options: (allow-none): Options
+ * @error: Error
+ *
+ * Compute the difference between directory @a and @b as 3 separate
+ * sets of #OstreeDiffItem in @modified, @removed, and @added.
+ *
+ * Since: 2017.4
+ */
+gboolean
+ostree_diff_dirs_with_options (OstreeDiffFlags flags, GFile *a, GFile *b, GPtrArray *modified,
+                               GPtrArray *removed, GPtrArray *added, OstreeDiffDirsOptions *options,
+                               GCancellable *cancellable, GError **error)
+{
+  OstreeDiffDirsOptions default_opts = OSTREE_DIFF_DIRS_OPTIONS_INIT;
+
+  if (!options)
+    options = &default_opts;
+
+  int n_threads = options->diff_threads;
+  if (n_threads < 0)
+    n_threads = g_get_num_processors ();
+  if (n_threads <= 1 || a == NULL)
+    return diff_dirs_internal (NULL, flags, a, b, modified, removed, added, options, cancellable,
+                               error);
+
+  /* Comparing files is independent work, so subtrees can be diffed
+   * concurrently; repository reads are safe from multiple threads, and
+   * local files are only read.  Results land in per-job arrays, so the
+   * shared output arrays are only touched at drain time.
+   */
+  g_autoptr (DiffWorkQueue) queue = g_new0 (DiffWorkQueue, 1);
+  queue->flags = flags;
+  queue->options = options;
+  queue->cancellable = cancellable;
+  g_mutex_init (&queue->lock);
+  g_cond_init (&queue->cond);
+  queue->items = g_ptr_array_new_with_free_func (diff_work_item_free);
+  queue->pool = ot_thread_pool_new ("diff", diff_queue_worker, NULL, n_threads);
+
+  /* diff_queue_free waits out any jobs dispatched before the failure */
+  if (!diff_dirs_internal (queue, flags, a, b, modified, removed, added, options, cancellable,
+                           error))
+    return FALSE;
+
+  return diff_queue_drain (queue, modified, removed, added, error);
+}
+
 static void
 print_diff_item (char prefix, GFile *base, GFile *file)
 {
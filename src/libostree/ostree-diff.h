@@ -81,7 +81,9 @@ typedef struct
   OstreeRepoDevInoCache *devino_to_csum_cache;
 
   gboolean unused_bools[7];
-  int unused_ints[6];
+  int diff_threads; /* Since: 2023.6; number of worker threads, 0 or 1 is serial, -1 is one per
+                       processor */
+  int unused_ints[5];
   /* 4 byte hole on 64 bit */
   gpointer unused_ptrs[7];
 } OstreeDiffDirsOptions;
@@ -62,6 +62,7 @@ static int update_timeout_cb (CURLM *multi, long timeout_ms, void *userp);
 static void request_unref (FetcherRequest *req);
 static void initiate_next_curl_request (FetcherRequest *req, GTask *task);
 static void destroy_and_unref_source (GSource *source);
+static void update_recv_speed_limits (OstreeFetcher *self);
 
 struct OstreeFetcher
 {
@@ -80,11 +81,13 @@ struct OstreeFetcher
 
   GMainContext *mainctx;
   CURLM *multi;
+  CURLSH *share; /* (unowned) process-lifetime, see fetcher_share_for_remote() */
   GSource *timer_event;
   int curl_running;
   GHashTable *outstanding_requests; /* Set<GTask> */
   GHashTable *sockets;              /* Set<SockInfo> */
 
+  guint64 max_bytes_per_sec; /* Aggregate receive-rate cap; 0 = unlimited */
   guint64 bytes_transferred;
 };
 
@@ -98,10 +101,15 @@ struct FetcherRequest
   char *filename;
   guint64 current_size;
   guint64 max_size;
+  char *partial_name;     /* staging file for resumable requests, or NULL */
+  guint64 resume_offset;  /* bytes already present in the staging file */
+  gboolean resume_checked; /* whether we verified the server honored the range */
   OstreeFetcherRequestFlags flags;
   struct curl_slist *req_headers;
   char *if_none_match;       /* request ETag */
   guint64 if_modified_since; /* seconds since the epoch */
+  guint64 range_start;       /* only used if range_length > 0 */
+  guint64 range_length;      /* 0 = fetch the whole file */
   gboolean is_membuf;
   GError *caught_write_error;
   GLnxTmpfile tmpf;
@@ -110,6 +118,8 @@ struct FetcherRequest
                                 don’t propagate as an error */
   char *out_etag;            /* response ETag */
   guint64 out_last_modified; /* response Last-Modified, seconds since the epoch */
+  OtChecksum digest;         /* streaming SHA-256 of the received bytes (tmpfile requests) */
+  gboolean digest_active;    /* FALSE once the hash can't represent the whole file (resume) */
 
   CURL *easy;
   char error[CURL_ERROR_SIZE];
@@ -196,7 +206,20 @@ _ostree_fetcher_finalize (GObject *object)
 static void
 _ostree_fetcher_constructed (GObject *object)
 {
-  // OstreeFetcher *self = OSTREE_FETCHER (object);
+  OstreeFetcher *self = OSTREE_FETCHER (object);
+
+  if ((self->config_flags & OSTREE_FETCHER_FLAGS_MULTIPLEXING) > 0
+      && !(self->config_flags & OSTREE_FETCHER_FLAGS_DISABLE_HTTP2))
+    {
+      /* In multiplexing mode the pull engine queues many small requests at
+       * once; raise the per-connection stream limit so they share the few
+       * connections allowed by CURLMOPT_MAX_TOTAL_CONNECTIONS instead of
+       * queueing behind it.
+       */
+#if CURL_AT_LEAST_VERSION(7, 67, 0)
+      curl_multi_setopt (self->multi, CURLMOPT_MAX_CONCURRENT_STREAMS, 128L);
+#endif
+    }
 
   G_OBJECT_CLASS (_ostree_fetcher_parent_class)->constructed (object);
 }
@@ -241,12 +264,73 @@ _ostree_fetcher_init (OstreeFetcher *self)
 #endif
 }
 
+/* Process-wide pool of curl share handles, one per remote, attached to every
+ * easy handle created for that remote.  Sharing CURL_LOCK_DATA_SSL_SESSION
+ * keeps TLS session tickets alive across fetcher instances, so repeated pulls
+ * in a long-running process resume sessions instead of paying a full
+ * handshake each time; DNS results are shared for the same reason.  libcurl
+ * has no API to serialize session tickets, so the cache is process-lifetime
+ * only.  Entries are intentionally never freed: a share must outlive every
+ * easy handle attached to it, and the pool is bounded by the remote count.
+ */
+typedef struct
+{
+  CURLSH *share;
+  GMutex locks[CURL_LOCK_DATA_LAST];
+} FetcherShare;
+
+static GMutex fetcher_share_pool_lock;
+static GHashTable *fetcher_share_pool; /* remote name → FetcherShare */
+
+static void
+fetcher_share_lock_cb (CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+  FetcherShare *share = userptr;
+  g_mutex_lock (&share->locks[data]);
+}
+
+static void
+fetcher_share_unlock_cb (CURL *handle, curl_lock_data data, void *userptr)
+{
+  FetcherShare *share = userptr;
+  g_mutex_unlock (&share->locks[data]);
+}
+
+static CURLSH *
+fetcher_share_for_remote (const char *remote_name)
+{
+  g_mutex_lock (&fetcher_share_pool_lock);
+  if (fetcher_share_pool == NULL)
+    fetcher_share_pool = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  /* Anonymous fetchers (URL pulls) all share one entry */
+  const char *key = remote_name ?: "";
+  FetcherShare *share = g_hash_table_lookup (fetcher_share_pool, key);
+  if (share == NULL)
+    {
+      share = g_new0 (FetcherShare, 1);
+      for (guint i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        g_mutex_init (&share->locks[i]);
+      share->share = curl_share_init ();
+      g_assert (share->share);
+      curl_share_setopt (share->share, CURLSHOPT_LOCKFUNC, fetcher_share_lock_cb);
+      curl_share_setopt (share->share, CURLSHOPT_UNLOCKFUNC, fetcher_share_unlock_cb);
+      curl_share_setopt (share->share, CURLSHOPT_USERDATA, share);
+      curl_share_setopt (share->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+      curl_share_setopt (share->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+      g_hash_table_replace (fetcher_share_pool, g_strdup (key), share);
+    }
+  CURLSH *ret = share->share;
+  g_mutex_unlock (&fetcher_share_pool_lock);
+  return ret;
+}
+
 OstreeFetcher *
 _ostree_fetcher_new (int tmpdir_dfd, const char *remote_name, OstreeFetcherConfigFlags flags)
 {
   OstreeFetcher *fetcher = g_object_new (OSTREE_TYPE_FETCHER, "config-flags", flags, NULL);
   fetcher->remote_name = g_strdup (remote_name);
   fetcher->tmpdir_dfd = tmpdir_dfd;
+  fetcher->share = fetcher_share_for_remote (remote_name);
   return fetcher;
 }
 
@@ -273,8 +357,26 @@ ensure_tmpfile (FetcherRequest *req, GError **error)
 {
   if (!req->tmpf.initialized)
     {
-      if (!_ostree_fetcher_tmpf_from_flags (req->flags, req->fetcher->tmpdir_dfd, &req->tmpf,
-                                            error))
+      if (req->partial_name != NULL)
+        {
+          /* Resumable requests stage into a named file in the tmpdir so the
+           * bytes survive a pull restart; positioned at the end, matching the
+           * offset we asked the server to resume from.
+           */
+          glnx_autofd int fd = openat (req->fetcher->tmpdir_dfd, req->partial_name,
+                                       O_CREAT | O_RDWR | O_CLOEXEC | O_NOFOLLOW, 0644);
+          if (fd < 0)
+            return glnx_throw_errno_prefix (error, "openat(%s)", req->partial_name);
+          if (lseek (fd, 0, SEEK_END) < 0)
+            return glnx_throw_errno_prefix (error, "lseek(%s)", req->partial_name);
+          req->tmpf.initialized = TRUE;
+          req->tmpf.anonymous = FALSE;
+          req->tmpf.src_dfd = req->fetcher->tmpdir_dfd;
+          req->tmpf.fd = glnx_steal_fd (&fd);
+          req->tmpf.path = g_strdup (req->partial_name);
+        }
+      else if (!_ostree_fetcher_tmpf_from_flags (req->flags, req->fetcher->tmpdir_dfd, &req->tmpf,
+                                                 error))
         return FALSE;
     }
   return TRUE;
@@ -311,6 +413,8 @@ check_multi_info (OstreeFetcher *fetcher)
 
       req = g_task_get_task_data (task);
 
+      ot_tracepoint2 (fetcher_request_done, eff_url, (int)curlres);
+
       if (req->caught_write_error)
         g_task_return_error (task, g_steal_pointer (&req->caught_write_error));
       else if (curlres != CURLE_OK)
@@ -334,6 +438,16 @@ check_multi_info (OstreeFetcher *fetcher)
         {
           curl_easy_getinfo (easy, CURLINFO_RESPONSE_CODE, &response);
 
+          if (!is_file && response == 416 && req->resume_offset > 0)
+            {
+              /* A range starting at EOF cannot be satisfied: the previous
+               * attempt had already fetched the entire object, so treat the
+               * staging file as complete (its checksum is verified by the
+               * caller either way).
+               */
+              response = 200;
+            }
+
           if (!is_file && response == 304
               && (req->if_none_match != NULL || req->if_modified_since > 0))
             {
@@ -403,6 +517,8 @@ check_multi_info (OstreeFetcher *fetcher)
       else
         {
           g_hash_table_remove (fetcher->outstanding_requests, task);
+          if (fetcher->max_bytes_per_sec > 0)
+            update_recv_speed_limits (fetcher);
           if (g_hash_table_size (fetcher->outstanding_requests) == 0)
             {
               g_clear_pointer (&fetcher->mainctx, g_main_context_unref);
@@ -564,11 +680,36 @@ write_cb (void *ptr, size_t size, size_t nmemb, void *data)
       if (!ensure_tmpfile (req, &req->caught_write_error))
         return -1;
       g_assert (req->tmpf.fd >= 0);
+      if (req->resume_offset > 0 && !req->resume_checked)
+        {
+          /* If the server ignored our range request and replied 200, it's
+           * sending the object from the start; drop the stale partial bytes
+           * rather than appending a second copy after them.
+           */
+          long response = 0;
+          curl_easy_getinfo (req->easy, CURLINFO_RESPONSE_CODE, &response);
+          if (response == 200)
+            {
+              if (ftruncate (req->tmpf.fd, 0) < 0 || lseek (req->tmpf.fd, 0, SEEK_SET) < 0)
+                {
+                  glnx_set_error_from_errno (&req->caught_write_error);
+                  return -1;
+                }
+              req->resume_offset = 0;
+              /* The file starts over from byte zero, so the hash (freshly
+               * initialized, no bytes seen yet) covers it after all.
+               */
+              req->digest_active = TRUE;
+            }
+          req->resume_checked = TRUE;
+        }
       if (glnx_loop_write (req->tmpf.fd, ptr, realsize) < 0)
         {
           glnx_set_error_from_errno (&req->caught_write_error);
           return -1;
         }
+      if (req->digest_active)
+        ot_checksum_update (&req->digest, ptr, realsize);
     }
 
   req->current_size += realsize;
@@ -633,11 +774,23 @@ request_unref (FetcherRequest *req)
   g_ptr_array_unref (req->mirrorlist);
   g_free (req->filename);
   g_clear_error (&req->caught_write_error);
+  if (req->partial_name != NULL && req->tmpf.initialized)
+    {
+      /* The result was never consumed, i.e. the transfer failed or was
+       * interrupted.  Keep the staging file so the next pull can resume it;
+       * disarm the unlink that glnx_tmpfile_clear() would otherwise do.
+       */
+      glnx_close_fd (&req->tmpf.fd);
+      g_clear_pointer (&req->tmpf.path, g_free);
+      req->tmpf.initialized = FALSE;
+    }
+  g_free (req->partial_name);
   glnx_tmpfile_clear (&req->tmpf);
   if (req->output_buf)
     g_string_free (req->output_buf, TRUE);
   g_free (req->if_none_match);
   g_free (req->out_etag);
+  ot_checksum_clear (&req->digest);
   g_clear_pointer (&req->req_headers, curl_slist_free_all);
   curl_easy_cleanup (req->easy);
 
@@ -709,6 +862,52 @@ _ostree_fetcher_set_extra_user_agent (OstreeFetcher *self, const char *extra_use
     }
 }
 
+void
+_ostree_fetcher_set_max_conns_per_host (OstreeFetcher *self, guint max_conns)
+{
+  if (max_conns == 0)
+    return;
+#if CURL_AT_LEAST_VERSION(7, 30, 0)
+  curl_multi_setopt (self->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)max_conns);
+  /* Also lift the total-connection cap set in _ostree_fetcher_init() if the
+   * per-host budget exceeds it; otherwise the latter silently wins.
+   */
+  curl_multi_setopt (self->multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)MAX (max_conns, 8));
+#endif
+}
+
+/* Re-divide the receive-rate budget evenly across all in-flight easy
+ * handles.  libcurl only supports a per-handle cap
+ * (CURLOPT_MAX_RECV_SPEED_LARGE), so each active transfer gets an equal
+ * share; the shares are recomputed whenever a request starts or finishes,
+ * keeping the aggregate at max_bytes_per_sec without reducing concurrency.
+ */
+static void
+update_recv_speed_limits (OstreeFetcher *self)
+{
+  curl_off_t per_handle = 0;
+
+  if (self->max_bytes_per_sec > 0)
+    {
+      const guint n_active = MAX (g_hash_table_size (self->outstanding_requests), 1);
+      per_handle = (curl_off_t)MAX (self->max_bytes_per_sec / n_active, 1);
+    }
+
+  GLNX_HASH_TABLE_FOREACH (self->outstanding_requests, GTask *, task)
+    {
+      FetcherRequest *req = g_task_get_task_data (task);
+      if (req->easy != NULL)
+        curl_easy_setopt (req->easy, CURLOPT_MAX_RECV_SPEED_LARGE, per_handle);
+    }
+}
+
+void
+_ostree_fetcher_set_max_bytes_per_sec (OstreeFetcher *self, guint64 bytes_per_sec)
+{
+  self->max_bytes_per_sec = bytes_per_sec;
+  update_recv_speed_limits (self);
+}
+
 /* Re-bind all of the outstanding curl items to our new main context */
 static void
 adopt_steal_mainctx (OstreeFetcher *self, GMainContext *mainctx)
@@ -743,17 +942,36 @@ initiate_next_curl_request (FetcherRequest *req, GTask *task)
 
   g_assert_cmpint (req->idx, <, req->mirrorlist->len);
 
+  if (!req->is_membuf)
+    {
+      /* (Re)start the streaming hash for this attempt.  It can only stand in
+       * for the file if no bytes bypassed it: a resumed transfer appends to
+       * bytes we never saw, and a failed earlier mirror attempt may have
+       * already written into the tmpfile.
+       */
+      ot_checksum_clear (&req->digest);
+      ot_checksum_init (&req->digest);
+      req->digest_active
+          = (req->resume_offset == 0 && req->current_size == 0 && !req->tmpf.initialized);
+    }
+
   GUri *baseuri = req->mirrorlist->pdata[req->idx];
   {
     g_autofree char *uri = request_get_uri (req, baseuri);
     rc = curl_easy_setopt (req->easy, CURLOPT_URL, uri);
     g_assert_cmpint (rc, ==, CURLM_OK);
+    ot_tracepoint1 (fetcher_request_start, uri);
   }
 
   rc = curl_easy_setopt (req->easy, CURLOPT_USERAGENT,
                          self->custom_user_agent ?: OSTREE_FETCHER_USERAGENT_STRING);
   g_assert_cmpint (rc, ==, CURLM_OK);
 
+  /* Resume TLS sessions (and reuse DNS results) cached by previous fetchers
+   * for this remote */
+  rc = curl_easy_setopt (req->easy, CURLOPT_SHARE, self->share);
+  g_assert_cmpint (rc, ==, CURLM_OK);
+
   /* Set caching request headers */
   if (req->if_none_match != NULL)
     {
@@ -770,6 +988,21 @@ initiate_next_curl_request (FetcherRequest *req, GTask *task)
       req->req_headers = curl_slist_append (req->req_headers, mod_date);
     }
 
+  if (req->range_length > 0)
+    {
+      g_autofree char *range
+          = g_strdup_printf ("%" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT, req->range_start,
+                             req->range_start + req->range_length - 1);
+      rc = curl_easy_setopt (req->easy, CURLOPT_RANGE, range);
+      g_assert_cmpint (rc, ==, CURLM_OK);
+    }
+  else if (req->resume_offset > 0)
+    {
+      rc = curl_easy_setopt (req->easy, CURLOPT_RESUME_FROM_LARGE,
+                             (curl_off_t)req->resume_offset);
+      g_assert_cmpint (rc, ==, CURLM_OK);
+    }
+
   /* Append a copy of @extra_headers to @req_headers, as the former could change
    * between requests or while a request is in flight */
   for (const struct curl_slist *l = self->extra_headers; l != NULL; l = l->next)
@@ -876,6 +1109,18 @@ initiate_next_curl_request (FetcherRequest *req, GTask *task)
       /* wait for pipe connection to confirm */
       rc = curl_easy_setopt (req->easy, CURLOPT_PIPEWAIT, 1L);
       g_assert_cmpint (rc, ==, CURLM_OK);
+#endif
+#if CURL_AT_LEAST_VERSION(7, 46, 0)
+      if ((self->config_flags & OSTREE_FETCHER_FLAGS_MULTIPLEXING) > 0)
+        {
+          /* Weight metadata streams above content so the object graph walk
+           * isn't starved behind bulk payload when many streams share a
+           * connection.  Lower GTask priority values are more important.
+           */
+          long weight = (g_task_get_priority (task) < OSTREE_FETCHER_DEFAULT_PRIORITY) ? 256 : 32;
+          rc = curl_easy_setopt (req->easy, CURLOPT_STREAM_WEIGHT, weight);
+          g_assert_cmpint (rc, ==, CURLM_OK);
+        }
 #endif
     }
 
@@ -923,6 +1168,18 @@ initiate_next_curl_request (FetcherRequest *req, GTask *task)
   rc = curl_easy_setopt (req->easy, CURLOPT_PROGRESSDATA, task);
   g_assert_cmpint (rc, ==, CURLM_OK);
 
+  /* Freshly (re)created handle; give it its share of the rate budget.
+   * update_recv_speed_limits() recomputes everyone's share when the set
+   * of outstanding requests changes.
+   */
+  if (self->max_bytes_per_sec > 0)
+    {
+      const guint n_active = MAX (g_hash_table_size (self->outstanding_requests), 1);
+      rc = curl_easy_setopt (req->easy, CURLOPT_MAX_RECV_SPEED_LARGE,
+                             (curl_off_t)MAX (self->max_bytes_per_sec / n_active, 1));
+      g_assert_cmpint (rc, ==, CURLM_OK);
+    }
+
   CURLMcode multi_rc = curl_multi_add_handle (self->multi, req->easy);
   g_assert (multi_rc == CURLM_OK);
 }
@@ -930,7 +1187,8 @@ initiate_next_curl_request (FetcherRequest *req, GTask *task)
 static void
 _ostree_fetcher_request_async (OstreeFetcher *self, GPtrArray *mirrorlist, const char *filename,
                                OstreeFetcherRequestFlags flags, const char *if_none_match,
-                               guint64 if_modified_since, gboolean is_membuf, guint64 max_size,
+                               guint64 if_modified_since, guint64 range_start,
+                               guint64 range_length, gboolean is_membuf, guint64 max_size,
                                int priority, GCancellable *cancellable,
                                GAsyncReadyCallback callback, gpointer user_data)
 {
@@ -961,12 +1219,31 @@ _ostree_fetcher_request_async (OstreeFetcher *self, GPtrArray *mirrorlist, const
   req->flags = flags;
   req->if_none_match = g_strdup (if_none_match);
   req->if_modified_since = if_modified_since;
+  req->range_start = range_start;
+  req->range_length = range_length;
   req->is_membuf = is_membuf;
   /* We'll allocate the tmpfile on demand, so we handle
    * file I/O errors just in the write func.
    */
   if (req->is_membuf)
     req->output_buf = g_string_new ("");
+  else if ((flags & OSTREE_FETCHER_REQUEST_RESUMABLE) > 0 && filename != NULL
+           && range_length == 0)
+    {
+      /* Key the staging file off the request path; for objects and delta
+       * parts that embeds the content checksum, so equal names imply equal
+       * bytes and a leftover partial from an interrupted pull can be
+       * extended rather than refetched.
+       */
+      g_autofree char *name_hash
+          = g_compute_checksum_for_string (G_CHECKSUM_SHA256, filename, -1);
+      req->partial_name = g_strconcat ("partial-", name_hash, NULL);
+
+      struct stat stbuf;
+      if (fstatat (self->tmpdir_dfd, req->partial_name, &stbuf, AT_SYMLINK_NOFOLLOW) == 0
+          && S_ISREG (stbuf.st_mode))
+        req->resume_offset = stbuf.st_size;
+    }
 
   task = g_task_new (self, cancellable, callback, user_data);
   /* We'll use the GTask priority for our own priority queue. */
@@ -977,6 +1254,8 @@ _ostree_fetcher_request_async (OstreeFetcher *self, GPtrArray *mirrorlist, const
   initiate_next_curl_request (req, task);
 
   g_hash_table_add (self->outstanding_requests, g_steal_pointer (&task));
+  if (self->max_bytes_per_sec > 0)
+    update_recv_speed_limits (self);
 }
 
 void
@@ -987,7 +1266,7 @@ _ostree_fetcher_request_to_tmpfile (OstreeFetcher *self, GPtrArray *mirrorlist,
                                     GAsyncReadyCallback callback, gpointer user_data)
 {
   _ostree_fetcher_request_async (self, mirrorlist, filename, flags, if_none_match,
-                                 if_modified_since, FALSE, max_size, priority, cancellable,
+                                 if_modified_since, 0, 0, FALSE, max_size, priority, cancellable,
                                  callback, user_data);
 }
 
@@ -995,7 +1274,7 @@ gboolean
 _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncResult *result,
                                            GLnxTmpfile *out_tmpf, gboolean *out_not_modified,
                                            char **out_etag, guint64 *out_last_modified,
-                                           GError **error)
+                                           GBytes **out_sha256_digest, GError **error)
 {
   g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
   g_return_val_if_fail (g_async_result_is_tagged (result, _ostree_fetcher_request_async), FALSE);
@@ -1016,6 +1295,16 @@ _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncResult *re
     *out_etag = g_steal_pointer (&req->out_etag);
   if (out_last_modified != NULL)
     *out_last_modified = req->out_last_modified;
+  if (out_sha256_digest != NULL)
+    {
+      *out_sha256_digest = NULL;
+      if (req->digest_active && !req->out_not_modified)
+        {
+          guint8 digest[_OSTREE_SHA256_DIGEST_LEN];
+          ot_checksum_get_digest (&req->digest, digest, sizeof (digest));
+          *out_sha256_digest = g_bytes_new (digest, sizeof (digest));
+        }
+    }
 
   return TRUE;
 }
@@ -1028,7 +1317,20 @@ _ostree_fetcher_request_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist, c
                                    gpointer user_data)
 {
   _ostree_fetcher_request_async (self, mirrorlist, filename, flags, if_none_match,
-                                 if_modified_since, TRUE, max_size, priority, cancellable, callback,
+                                 if_modified_since, 0, 0, TRUE, max_size, priority, cancellable,
+                                 callback, user_data);
+}
+
+void
+_ostree_fetcher_request_range_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist,
+                                         const char *filename, OstreeFetcherRequestFlags flags,
+                                         guint64 range_start, guint64 range_length,
+                                         guint64 max_size, int priority, GCancellable *cancellable,
+                                         GAsyncReadyCallback callback, gpointer user_data)
+{
+  g_assert (range_length > 0);
+  _ostree_fetcher_request_async (self, mirrorlist, filename, flags, NULL, 0, range_start,
+                                 range_length, TRUE, max_size, priority, cancellable, callback,
                                  user_data);
 }
 
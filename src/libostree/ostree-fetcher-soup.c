@@ -94,6 +94,8 @@ typedef struct
   OstreeFetcherRequestFlags flags;
   char *if_none_match;       /* request ETag */
   guint64 if_modified_since; /* seconds since the epoch */
+  guint64 range_start;       /* only used if range_length > 0 */
+  guint64 range_length;      /* 0 = fetch the whole file */
   GInputStream *request_body;
   GLnxTmpfile tmpf;
   GOutputStream *out_stream;
@@ -101,6 +103,7 @@ typedef struct
                                 don’t propagate as an error */
   char *out_etag;            /* response ETag */
   guint64 out_last_modified; /* response Last-Modified, seconds since the epoch */
+  OtChecksum digest;         /* streaming SHA-256 of the received bytes (tmpfile requests) */
 
   guint64 max_size;
   guint64 current_size;
@@ -208,6 +211,7 @@ pending_uri_unref (OstreeFetcherPendingURI *pending)
   g_free (pending->if_none_match);
   glnx_tmpfile_clear (&pending->tmpf);
   g_clear_object (&pending->out_stream);
+  ot_checksum_clear (&pending->digest);
   g_free (pending->out_etag);
   g_free (pending);
 }
@@ -375,6 +379,14 @@ session_thread_set_extra_user_agent_cb (ThreadClosure *thread_closure, gpointer
     }
 }
 
+static void
+session_thread_set_max_conns_cb (ThreadClosure *thread_closure, gpointer data)
+{
+  guint max_conns = GPOINTER_TO_UINT (data);
+  if (max_conns > 0)
+    g_object_set (thread_closure->session, "max-conns-per-host", (gint)max_conns, NULL);
+}
+
 static void on_request_sent (GObject *object, GAsyncResult *result, gpointer user_data);
 
 static void
@@ -430,6 +442,14 @@ create_pending_soup_request (OstreeFetcherPendingURI *pending, GError **error)
       g_autofree char *mod_date = g_date_time_format (date_time, "%a, %d %b %Y %H:%M:%S %Z");
       soup_message_headers_append (msg->request_headers, "If-Modified-Since", mod_date);
     }
+
+  if (SOUP_IS_REQUEST_HTTP (pending->request) && pending->range_length > 0)
+    {
+      glnx_unref_object SoupMessage *msg
+          = soup_request_http_get_message ((SoupRequestHTTP *)pending->request);
+      soup_message_headers_set_range (msg->request_headers, pending->range_start,
+                                      pending->range_start + pending->range_length - 1);
+    }
 }
 
 static void
@@ -768,6 +788,25 @@ _ostree_fetcher_set_extra_user_agent (OstreeFetcher *self, const char *extra_use
                            g_strdup (extra_user_agent), (GDestroyNotify)g_free);
 }
 
+void
+_ostree_fetcher_set_max_conns_per_host (OstreeFetcher *self, guint max_conns)
+{
+  g_return_if_fail (OSTREE_IS_FETCHER (self));
+
+  session_thread_idle_add (self->thread_closure, session_thread_set_max_conns_cb,
+                           GUINT_TO_POINTER (max_conns), NULL);
+}
+
+void
+_ostree_fetcher_set_max_bytes_per_sec (OstreeFetcher *self, guint64 bytes_per_sec)
+{
+  g_return_if_fail (OSTREE_IS_FETCHER (self));
+
+  if (bytes_per_sec > 0)
+    g_warning ("This version of OSTree was compiled with the libsoup fetcher backend, "
+               "which does not support rate limiting");
+}
+
 static gboolean
 finish_stream (OstreeFetcherPendingURI *pending, GCancellable *cancellable, GError **error)
 {
@@ -893,6 +932,11 @@ on_stream_read (GObject *object, GAsyncResult *result, gpointer user_data)
                                                 &pending->tmpf, &local_error))
             goto out;
           pending->out_stream = g_unix_output_stream_new (pending->tmpf.fd, FALSE);
+          /* Hash the bytes as they arrive so completion only compares digests;
+           * a retried request gets a fresh tmpfile, so restart the hash too.
+           */
+          ot_checksum_clear (&pending->digest);
+          ot_checksum_init (&pending->digest);
         }
       else
         {
@@ -955,6 +999,9 @@ on_stream_read (GObject *object, GAsyncResult *result, gpointer user_data)
 
       pending->current_size += bytes_read;
 
+      if (!pending->is_membuf)
+        ot_checksum_update_bytes (&pending->digest, bytes);
+
       /* We do this instead of _write_bytes_async() as that's not
        * guaranteed to do a complete write.
        */
@@ -1119,7 +1166,8 @@ out:
 static void
 _ostree_fetcher_request_async (OstreeFetcher *self, GPtrArray *mirrorlist, const char *filename,
                                OstreeFetcherRequestFlags flags, const char *if_none_match,
-                               guint64 if_modified_since, gboolean is_membuf, guint64 max_size,
+                               guint64 if_modified_since, guint64 range_start,
+                               guint64 range_length, gboolean is_membuf, guint64 max_size,
                                int priority, GCancellable *cancellable,
                                GAsyncReadyCallback callback, gpointer user_data)
 {
@@ -1139,6 +1187,8 @@ _ostree_fetcher_request_async (OstreeFetcher *self, GPtrArray *mirrorlist, const
   pending->flags = flags;
   pending->if_none_match = g_strdup (if_none_match);
   pending->if_modified_since = if_modified_since;
+  pending->range_start = range_start;
+  pending->range_length = range_length;
   pending->max_size = max_size;
   pending->is_membuf = is_membuf;
 
@@ -1161,7 +1211,7 @@ _ostree_fetcher_request_to_tmpfile (OstreeFetcher *self, GPtrArray *mirrorlist,
                                     GAsyncReadyCallback callback, gpointer user_data)
 {
   _ostree_fetcher_request_async (self, mirrorlist, filename, flags, if_none_match,
-                                 if_modified_since, FALSE, max_size, priority, cancellable,
+                                 if_modified_since, 0, 0, FALSE, max_size, priority, cancellable,
                                  callback, user_data);
 }
 
@@ -1169,7 +1219,7 @@ gboolean
 _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncResult *result,
                                            GLnxTmpfile *out_tmpf, gboolean *out_not_modified,
                                            char **out_etag, guint64 *out_last_modified,
-                                           GError **error)
+                                           GBytes **out_sha256_digest, GError **error)
 {
   GTask *task;
   OstreeFetcherPendingURI *pending;
@@ -1195,6 +1245,21 @@ _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncResult *re
     *out_etag = g_steal_pointer (&pending->out_etag);
   if (out_last_modified != NULL)
     *out_last_modified = pending->out_last_modified;
+  if (out_sha256_digest != NULL)
+    {
+      *out_sha256_digest = NULL;
+      /* The NUL termination byte is appended after hashing, and a 304 means we
+       * never saw the body; otherwise every byte in the tmpfile went through
+       * the hash.
+       */
+      if (pending->digest.initialized && !pending->out_not_modified
+          && (pending->flags & OSTREE_FETCHER_REQUEST_NUL_TERMINATION) == 0)
+        {
+          guint8 digest[_OSTREE_SHA256_DIGEST_LEN];
+          ot_checksum_get_digest (&pending->digest, digest, sizeof (digest));
+          *out_sha256_digest = g_bytes_new (digest, sizeof (digest));
+        }
+    }
 
   return TRUE;
 }
@@ -1207,7 +1272,20 @@ _ostree_fetcher_request_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist, c
                                    gpointer user_data)
 {
   _ostree_fetcher_request_async (self, mirrorlist, filename, flags, if_none_match,
-                                 if_modified_since, TRUE, max_size, priority, cancellable, callback,
+                                 if_modified_since, 0, 0, TRUE, max_size, priority, cancellable,
+                                 callback, user_data);
+}
+
+void
+_ostree_fetcher_request_range_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist,
+                                         const char *filename, OstreeFetcherRequestFlags flags,
+                                         guint64 range_start, guint64 range_length,
+                                         guint64 max_size, int priority, GCancellable *cancellable,
+                                         GAsyncReadyCallback callback, gpointer user_data)
+{
+  g_assert (range_length > 0);
+  _ostree_fetcher_request_async (self, mirrorlist, filename, flags, NULL, 0, range_start,
+                                 range_length, TRUE, max_size, priority, cancellable, callback,
                                  user_data);
 }
 
@@ -35,6 +35,16 @@
 #include "ostree-fetcher.h"
 #include "ostree-repo-private.h"
 #include "ostree-tls-cert-interaction-private.h"
+#include "otutil.h"
+
+/* Adaptive concurrency: rather than pushing every queued request at the
+ * session at once, we gate dispatch behind a window that does AIMD on the
+ * observed time-to-first-response.  The window grows by one request per
+ * completion while latency stays near the best we've seen (filling the pipe
+ * on high-BDP links) and halves when latency spikes well above it, which is
+ * our bufferbloat signal on congested links.
+ */
+#define FETCHER_AIMD_WINDOW_MIN 4
 
 typedef struct
 {
@@ -52,6 +62,8 @@ typedef struct
   OstreeFetcherRequestFlags flags;
   char *if_none_match;       /* request ETag */
   guint64 if_modified_since; /* seconds since the epoch */
+  guint64 range_start;       /* only used if range_length > 0 */
+  guint64 range_length;      /* 0 = fetch the whole file */
   GInputStream *response_body;
   GLnxTmpfile tmpf;
   GOutputStream *out_stream;
@@ -59,10 +71,14 @@ typedef struct
                                 don’t propagate as an error */
   char *out_etag;            /* response ETag */
   guint64 out_last_modified; /* response Last-Modified, seconds since the epoch */
+  OtChecksum digest;         /* streaming SHA-256 of the received bytes (tmpfile requests) */
 
   guint64 max_size;
   guint64 current_size;
   goffset content_length;
+
+  gint64 dispatch_time_usec; /* when the request actually went on the wire; 0 = still queued */
+  gint64 latency_usec;       /* time until the response headers arrived */
 } FetcherRequest;
 
 struct OstreeFetcher
@@ -80,6 +96,13 @@ struct OstreeFetcher
   GTlsDatabase *tls_database;
   GVariant *extra_headers;
   char *user_agent;
+  guint max_conns_per_host; /* 0 = use the built-in default */
+
+  /* Adaptive concurrency state; see fetcher_update_window() */
+  GQueue pending_requests; /* owned GTask */
+  guint n_inflight;
+  guint window;
+  gint64 latency_floor_usec;
 
   guint64 bytes_transferred;
 };
@@ -92,10 +115,14 @@ enum
 
 G_DEFINE_TYPE (OstreeFetcher, _ostree_fetcher, G_TYPE_OBJECT)
 
+static void fetcher_request_completed (OstreeFetcher *self, FetcherRequest *request);
+
 static void
 fetcher_request_free (FetcherRequest *request)
 {
   g_debug ("Freeing request for %s", request->filename);
+  if (request->dispatch_time_usec > 0)
+    fetcher_request_completed (request->fetcher, request);
   g_clear_pointer (&request->mirrorlist, g_ptr_array_unref);
   g_clear_pointer (&request->filename, g_free);
   g_clear_object (&request->message);
@@ -106,6 +133,7 @@ fetcher_request_free (FetcherRequest *request)
   g_clear_object (&request->response_body);
   glnx_tmpfile_clear (&request->tmpf);
   g_clear_object (&request->out_stream);
+  ot_checksum_clear (&request->digest);
   g_clear_pointer (&request->out_etag, g_free);
   g_free (request);
 }
@@ -160,6 +188,11 @@ create_request_message (FetcherRequest *request)
                                    "If-Modified-Since", mod_date);
     }
 
+  if (request->range_length > 0)
+    soup_message_headers_set_range (soup_message_get_request_headers (request->message),
+                                    request->range_start,
+                                    request->range_start + request->range_length - 1);
+
   if ((request->fetcher->config_flags & OSTREE_FETCHER_FLAGS_TLS_PERMISSIVE) != 0)
     g_signal_connect (request->message, "accept-certificate",
                       G_CALLBACK (_message_accept_cert_loose), NULL);
@@ -243,6 +276,8 @@ _ostree_fetcher_finalize (GObject *object)
   g_clear_object (&self->tls_database);
   g_clear_pointer (&self->extra_headers, g_variant_unref);
   g_clear_pointer (&self->user_agent, g_free);
+  g_queue_foreach (&self->pending_requests, (GFunc)g_object_unref, NULL);
+  g_queue_clear (&self->pending_requests);
 
   G_OBJECT_CLASS (_ostree_fetcher_parent_class)->finalize (object);
 }
@@ -280,6 +315,8 @@ static void
 _ostree_fetcher_init (OstreeFetcher *self)
 {
   self->sessions = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_queue_init (&self->pending_requests);
+  self->window = FETCHER_AIMD_WINDOW_MIN;
 }
 
 OstreeFetcher *
@@ -372,6 +409,27 @@ _ostree_fetcher_set_extra_user_agent (OstreeFetcher *self, const char *extra_use
     self->user_agent = g_strdup_printf ("%s %s", OSTREE_FETCHER_USERAGENT_STRING, extra_user_agent);
 }
 
+void
+_ostree_fetcher_set_max_conns_per_host (OstreeFetcher *self, guint max_conns)
+{
+  g_return_if_fail (OSTREE_IS_FETCHER (self));
+
+  /* Takes effect for sessions created after this call; the pull code
+   * configures the fetcher before issuing any requests.
+   */
+  self->max_conns_per_host = max_conns;
+}
+
+void
+_ostree_fetcher_set_max_bytes_per_sec (OstreeFetcher *self, guint64 bytes_per_sec)
+{
+  g_return_if_fail (OSTREE_IS_FETCHER (self));
+
+  if (bytes_per_sec > 0)
+    g_warning ("This version of OSTree was compiled with the libsoup3 fetcher backend, "
+               "which does not support rate limiting");
+}
+
 static gboolean
 finish_stream (FetcherRequest *request, GCancellable *cancellable, GError **error)
 {
@@ -455,6 +513,11 @@ on_stream_read (GObject *object, GAsyncResult *result, gpointer user_data)
               return;
             }
           request->out_stream = g_unix_output_stream_new (request->tmpf.fd, FALSE);
+          /* Hash the bytes as they arrive so completion only compares digests;
+           * a retried request gets a fresh tmpfile, so restart the hash too.
+           */
+          ot_checksum_clear (&request->digest);
+          ot_checksum_init (&request->digest);
         }
       else
         {
@@ -525,6 +588,9 @@ on_stream_read (GObject *object, GAsyncResult *result, gpointer user_data)
 
       request->current_size += bytes_read;
 
+      if (!request->is_membuf)
+        ot_checksum_update_bytes (&request->digest, bytes);
+
       /* We do this instead of _write_bytes_async() as that's not
        * guaranteed to do a complete write.
        */
@@ -544,6 +610,9 @@ on_request_sent (GObject *object, GAsyncResult *result, gpointer user_data)
   FetcherRequest *request = g_task_get_task_data (task);
   GError *local_error = NULL;
 
+  if (request->latency_usec == 0 && request->dispatch_time_usec > 0)
+    request->latency_usec = g_get_monotonic_time () - request->dispatch_time_usec;
+
   if (request->file)
     request->response_body
         = (GInputStream *)g_file_read_finish ((GFile *)object, result, &local_error);
@@ -649,9 +718,11 @@ static SoupSession *
 create_soup_session (OstreeFetcher *self)
 {
   const char *user_agent = self->user_agent ?: OSTREE_FETCHER_USERAGENT_STRING;
-  SoupSession *session = soup_session_new_with_options (
-      "user-agent", user_agent, "timeout", 60, "idle-timeout", 60, "max-conns-per-host",
-      _OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS, NULL);
+  int max_conns = self->max_conns_per_host > 0 ? (int)self->max_conns_per_host
+                                               : _OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS;
+  SoupSession *session
+      = soup_session_new_with_options ("user-agent", user_agent, "timeout", 60, "idle-timeout", 60,
+                                       "max-conns-per-host", max_conns, NULL);
 
   /* SoupContentDecoder is included in the session by default. Remove it
    * if gzip compression isn't in use.
@@ -691,10 +762,69 @@ on_session_finalized (gpointer data, GObject *object)
   (void)g_hash_table_foreach_remove (sessions, match_value, object);
 }
 
+static guint
+fetcher_window_max (OstreeFetcher *self)
+{
+  if (self->max_conns_per_host > 0)
+    return self->max_conns_per_host;
+  if ((self->config_flags & OSTREE_FETCHER_FLAGS_MULTIPLEXING) > 0)
+    return _OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS_MULTIPLEXED;
+  return _OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS;
+}
+
+static void
+fetcher_update_window (OstreeFetcher *self, gint64 latency_usec)
+{
+  if (self->latency_floor_usec == 0 || latency_usec < self->latency_floor_usec)
+    self->latency_floor_usec = latency_usec;
+
+  if (latency_usec > 2 * self->latency_floor_usec)
+    self->window = MAX (self->window / 2, FETCHER_AIMD_WINDOW_MIN);
+  else if (self->window < fetcher_window_max (self))
+    self->window++;
+}
+
+static gboolean
+dispatch_in_context (gpointer user_data)
+{
+  GTask *task = user_data;
+  initiate_task_request (g_object_ref (task));
+  return G_SOURCE_REMOVE;
+}
+
+static void
+fetcher_dispatch_pending (OstreeFetcher *self)
+{
+  while (self->n_inflight < self->window && !g_queue_is_empty (&self->pending_requests))
+    {
+      GTask *task = g_queue_pop_head (&self->pending_requests);
+      FetcherRequest *request = g_task_get_task_data (task);
+
+      self->n_inflight++;
+      request->dispatch_time_usec = g_get_monotonic_time ();
+      /* The session is tied to the request's main context; dispatch from
+       * there in case a completion in another context drained the window.
+       */
+      g_main_context_invoke_full (request->mainctx, g_task_get_priority (task), dispatch_in_context,
+                                  task, g_object_unref);
+    }
+}
+
+static void
+fetcher_request_completed (OstreeFetcher *self, FetcherRequest *request)
+{
+  g_assert_cmpuint (self->n_inflight, >, 0);
+  self->n_inflight--;
+  if (request->latency_usec > 0)
+    fetcher_update_window (self, request->latency_usec);
+  fetcher_dispatch_pending (self);
+}
+
 static void
 _ostree_fetcher_request_async (OstreeFetcher *self, GPtrArray *mirrorlist, const char *filename,
                                OstreeFetcherRequestFlags flags, const char *if_none_match,
-                               guint64 if_modified_since, gboolean is_membuf, guint64 max_size,
+                               guint64 if_modified_since, guint64 range_start,
+                               guint64 range_length, gboolean is_membuf, guint64 max_size,
                                int priority, GCancellable *cancellable,
                                GAsyncReadyCallback callback, gpointer user_data)
 {
@@ -708,6 +838,8 @@ _ostree_fetcher_request_async (OstreeFetcher *self, GPtrArray *mirrorlist, const
   request->flags = flags;
   request->if_none_match = g_strdup (if_none_match);
   request->if_modified_since = if_modified_since;
+  request->range_start = range_start;
+  request->range_length = range_length;
   request->max_size = max_size;
   request->is_membuf = is_membuf;
   request->fetcher = self;
@@ -744,7 +876,8 @@ _ostree_fetcher_request_async (OstreeFetcher *self, GPtrArray *mirrorlist, const
   /* We'll use the GTask priority for our own priority queue. */
   g_task_set_priority (task, priority);
 
-  initiate_task_request (g_object_ref (task));
+  g_queue_push_tail (&self->pending_requests, g_object_ref (task));
+  fetcher_dispatch_pending (self);
 }
 
 void
@@ -755,7 +888,7 @@ _ostree_fetcher_request_to_tmpfile (OstreeFetcher *self, GPtrArray *mirrorlist,
                                     GAsyncReadyCallback callback, gpointer user_data)
 {
   _ostree_fetcher_request_async (self, mirrorlist, filename, flags, if_none_match,
-                                 if_modified_since, FALSE, max_size, priority, cancellable,
+                                 if_modified_since, 0, 0, FALSE, max_size, priority, cancellable,
                                  callback, user_data);
 }
 
@@ -763,7 +896,7 @@ gboolean
 _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncResult *result,
                                            GLnxTmpfile *out_tmpf, gboolean *out_not_modified,
                                            char **out_etag, guint64 *out_last_modified,
-                                           GError **error)
+                                           GBytes **out_sha256_digest, GError **error)
 {
   g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
   g_return_val_if_fail (g_async_result_is_tagged (result, _ostree_fetcher_request_async), FALSE);
@@ -784,6 +917,21 @@ _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncResult *re
     *out_etag = g_steal_pointer (&request->out_etag);
   if (out_last_modified != NULL)
     *out_last_modified = request->out_last_modified;
+  if (out_sha256_digest != NULL)
+    {
+      *out_sha256_digest = NULL;
+      /* The NUL termination byte is appended after hashing, and a 304 means we
+       * never saw the body; otherwise every byte in the tmpfile went through
+       * the hash.
+       */
+      if (request->digest.initialized && !request->out_not_modified
+          && (request->flags & OSTREE_FETCHER_REQUEST_NUL_TERMINATION) == 0)
+        {
+          guint8 digest[_OSTREE_SHA256_DIGEST_LEN];
+          ot_checksum_get_digest (&request->digest, digest, sizeof (digest));
+          *out_sha256_digest = g_bytes_new (digest, sizeof (digest));
+        }
+    }
 
   return TRUE;
 }
@@ -796,7 +944,20 @@ _ostree_fetcher_request_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist, c
                                    gpointer user_data)
 {
   _ostree_fetcher_request_async (self, mirrorlist, filename, flags, if_none_match,
-                                 if_modified_since, TRUE, max_size, priority, cancellable, callback,
+                                 if_modified_since, 0, 0, TRUE, max_size, priority, cancellable,
+                                 callback, user_data);
+}
+
+void
+_ostree_fetcher_request_range_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist,
+                                         const char *filename, OstreeFetcherRequestFlags flags,
+                                         guint64 range_start, guint64 range_length,
+                                         guint64 max_size, int priority, GCancellable *cancellable,
+                                         GAsyncReadyCallback callback, gpointer user_data)
+{
+  g_assert (range_length > 0);
+  _ostree_fetcher_request_async (self, mirrorlist, filename, flags, NULL, 0, range_start,
+                                 range_length, TRUE, max_size, priority, cancellable, callback,
                                  user_data);
 }
 
@@ -147,6 +147,109 @@ _ostree_fetcher_mirrored_request_to_membuf (OstreeFetcher *fetcher, GPtrArray *m
   return FALSE;
 }
 
+/* Cap on the probe fetch used by _ostree_fetcher_mirrorlist_probe_fastest();
+ * "config" is a few hundred bytes, the cap just bounds a misbehaving server.
+ */
+#define MIRROR_PROBE_MAX_SIZE (64 * 1024)
+
+typedef struct
+{
+  guint n_outstanding;
+  int winner; /* index of the first mirror to respond, or -1 */
+  GMainContext *main_context; /* (owned) */
+} MirrorProbeData;
+
+typedef struct
+{
+  MirrorProbeData *probe;
+  guint index;
+} MirrorProbeRequest;
+
+static void
+probe_mirror_on_complete (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  MirrorProbeRequest *req = user_data;
+  MirrorProbeData *data = req->probe;
+  g_autoptr (GBytes) buf = NULL;
+  g_autoptr (GError) local_error = NULL;
+
+  if (_ostree_fetcher_request_to_membuf_finish ((OstreeFetcher *)object, result, &buf, NULL, NULL,
+                                                NULL, &local_error)
+      && data->winner < 0)
+    data->winner = req->index;
+  data->n_outstanding--;
+  g_main_context_wakeup (data->main_context);
+  g_free (req);
+}
+
+/* Race a small fetch of the repo "config" file from the first @n_probe
+ * entries of @mirrorlist concurrently and move the first mirror to respond
+ * to the front of @mirrorlist, preserving the relative order of the rest so
+ * the sequential fallback chain is unchanged.  Purely best-effort: if no
+ * probe succeeds the list is left as-is, and losing requests are cancelled
+ * as soon as a winner is known.
+ */
+void
+_ostree_fetcher_mirrorlist_probe_fastest (OstreeFetcher *fetcher, GPtrArray *mirrorlist,
+                                          guint n_probe, GCancellable *cancellable)
+{
+  if (mirrorlist->len < 2 || n_probe < 2 || g_cancellable_is_cancelled (cancellable))
+    return;
+
+  const guint n = MIN (n_probe, mirrorlist->len);
+
+  g_autoptr (GMainContext) mainctx = g_main_context_new ();
+  g_main_context_push_thread_default (mainctx);
+
+  /* A private cancellable so losers can be aborted once a winner responds */
+  g_autoptr (GCancellable) probe_cancellable = g_cancellable_new ();
+
+  /* Single-entry mirrorlists per probe, borrowing the URIs from @mirrorlist;
+   * they must stay alive until every callback has run.
+   */
+  g_autoptr (GPtrArray) sub_lists = g_ptr_array_new_with_free_func ((GDestroyNotify)g_ptr_array_unref);
+
+  MirrorProbeData data = { .n_outstanding = n, .winner = -1 };
+  data.main_context = g_main_context_ref (mainctx);
+
+  for (guint i = 0; i < n; i++)
+    {
+      GPtrArray *sub = g_ptr_array_new ();
+      g_ptr_array_add (sub, mirrorlist->pdata[i]);
+      g_ptr_array_add (sub_lists, sub);
+
+      MirrorProbeRequest *req = g_new0 (MirrorProbeRequest, 1);
+      req->probe = &data;
+      req->index = i;
+      _ostree_fetcher_request_to_membuf (fetcher, sub, "config", 0, NULL, 0,
+                                         MIRROR_PROBE_MAX_SIZE, OSTREE_FETCHER_DEFAULT_PRIORITY,
+                                         probe_cancellable, probe_mirror_on_complete, req);
+    }
+
+  while (data.winner < 0 && data.n_outstanding > 0)
+    {
+      g_main_context_iteration (mainctx, TRUE);
+      if (g_cancellable_is_cancelled (cancellable))
+        g_cancellable_cancel (probe_cancellable);
+    }
+
+  /* Stop the losers, then drain their callbacks so nothing dangles */
+  g_cancellable_cancel (probe_cancellable);
+  while (data.n_outstanding > 0)
+    g_main_context_iteration (mainctx, TRUE);
+
+  g_main_context_pop_thread_default (mainctx);
+  g_main_context_unref (data.main_context);
+
+  if (data.winner > 0)
+    {
+      g_debug ("mirror probe: promoting mirror %d to front", data.winner);
+      gpointer winner_uri = mirrorlist->pdata[data.winner];
+      memmove (&mirrorlist->pdata[1], &mirrorlist->pdata[0], data.winner * sizeof (gpointer));
+      mirrorlist->pdata[0] = winner_uri;
+    }
+}
+
 /* Helper for callers who just want to fetch single one-off URIs */
 gboolean
 _ostree_fetcher_request_uri_to_membuf (OstreeFetcher *fetcher, OstreeFetcherURI *uri,
@@ -54,6 +54,12 @@ gboolean _ostree_fetcher_mirrored_request_to_membuf (
     guint n_network_retries, GBytes **out_contents, gboolean *out_not_modified, char **out_etag,
     guint64 *out_last_modified, guint64 max_size, GCancellable *cancellable, GError **error);
 
+/* Number of leading mirrors raced by _ostree_fetcher_mirrorlist_probe_fastest() */
+#define OSTREE_FETCHER_MIRROR_PROBE_N 5
+
+void _ostree_fetcher_mirrorlist_probe_fastest (OstreeFetcher *fetcher, GPtrArray *mirrorlist,
+                                               guint n_probe, GCancellable *cancellable);
+
 gboolean _ostree_fetcher_request_uri_to_membuf (
     OstreeFetcher *fetcher, OstreeFetcherURI *uri, OstreeFetcherRequestFlags flags,
     const char *if_none_match, guint64 if_modified_since, guint n_network_retries,
@@ -55,6 +55,7 @@ typedef enum
   OSTREE_FETCHER_FLAGS_TLS_PERMISSIVE = (1 << 0),
   OSTREE_FETCHER_FLAGS_TRANSFER_GZIP = (1 << 1),
   OSTREE_FETCHER_FLAGS_DISABLE_HTTP2 = (1 << 2),
+  OSTREE_FETCHER_FLAGS_MULTIPLEXING = (1 << 3),
 } OstreeFetcherConfigFlags;
 
 typedef enum
@@ -62,6 +63,12 @@ typedef enum
   OSTREE_FETCHER_REQUEST_NUL_TERMINATION = (1 << 0),
   OSTREE_FETCHER_REQUEST_OPTIONAL_CONTENT = (1 << 1),
   OSTREE_FETCHER_REQUEST_LINKABLE = (1 << 2),
+  /* Stage the download in a named file keyed by the request path so an
+   * interrupted transfer can be resumed with a byte-range request on the
+   * next attempt.  Only meaningful for requests to a tmpfile whose content
+   * is verified by checksum after download; currently implemented by the
+   * curl backend. */
+  OSTREE_FETCHER_REQUEST_RESUMABLE = (1 << 3),
 } OstreeFetcherRequestFlags;
 
 void _ostree_fetcher_uri_free (OstreeFetcherURI *uri);
@@ -103,6 +110,10 @@ void _ostree_fetcher_set_extra_headers (OstreeFetcher *self, GVariant *extra_hea
 
 void _ostree_fetcher_set_extra_user_agent (OstreeFetcher *self, const char *extra_user_agent);
 
+void _ostree_fetcher_set_max_conns_per_host (OstreeFetcher *self, guint max_conns);
+
+void _ostree_fetcher_set_max_bytes_per_sec (OstreeFetcher *self, guint64 bytes_per_sec);
+
 guint64 _ostree_fetcher_bytes_transferred (OstreeFetcher *self);
 
 void _ostree_fetcher_request_to_tmpfile (OstreeFetcher *self, GPtrArray *mirrorlist,
@@ -111,10 +122,16 @@ void _ostree_fetcher_request_to_tmpfile (OstreeFetcher *self, GPtrArray *mirrorl
                                          guint64 max_size, int priority, GCancellable *cancellable,
                                          GAsyncReadyCallback callback, gpointer user_data);
 
+/* @out_sha256_digest is the SHA-256 of the downloaded bytes, computed as they
+ * arrived, or %NULL if the backend couldn't account for every byte (e.g. a
+ * resumed transfer); callers verifying content must then hash the tmpfile
+ * themselves.
+ */
 gboolean _ostree_fetcher_request_to_tmpfile_finish (OstreeFetcher *self, GAsyncResult *result,
                                                     GLnxTmpfile *out_tmpf,
                                                     gboolean *out_not_modified, char **out_etag,
-                                                    guint64 *out_last_modified, GError **error);
+                                                    guint64 *out_last_modified,
+                                                    GBytes **out_sha256_digest, GError **error);
 
 void _ostree_fetcher_request_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist,
                                         const char *filename, OstreeFetcherRequestFlags flags,
@@ -122,6 +139,13 @@ void _ostree_fetcher_request_to_membuf (OstreeFetcher *self, GPtrArray *mirrorli
                                         guint64 max_size, int priority, GCancellable *cancellable,
                                         GAsyncReadyCallback callback, gpointer user_data);
 
+void _ostree_fetcher_request_range_to_membuf (OstreeFetcher *self, GPtrArray *mirrorlist,
+                                              const char *filename, OstreeFetcherRequestFlags flags,
+                                              guint64 range_start, guint64 range_length,
+                                              guint64 max_size, int priority,
+                                              GCancellable *cancellable,
+                                              GAsyncReadyCallback callback, gpointer user_data);
+
 gboolean _ostree_fetcher_request_to_membuf_finish (OstreeFetcher *self, GAsyncResult *result,
                                                    GBytes **out_buf, gboolean *out_not_modified,
                                                    char **out_etag, guint64 *out_last_modified,
@@ -261,9 +261,10 @@ out:
   return ret;
 }
 
-OstreeGpgVerifyResult *
-_ostree_gpg_verifier_check_signature (OstreeGpgVerifier *self, GBytes *signed_data,
-                                      GBytes *signatures, GCancellable *cancellable, GError **error)
+static OstreeGpgVerifyResult *
+gpg_verifier_check_signature_internal (OstreeGpgVerifier *self, const char *home_dir,
+                                       GBytes *signed_data, GBytes *signatures,
+                                       GCancellable *cancellable, GError **error)
 {
   GLNX_AUTO_PREFIX_ERROR ("GPG", error);
   gpgme_error_t gpg_error = 0;
@@ -277,7 +278,8 @@ _ostree_gpg_verifier_check_signature (OstreeGpgVerifier *self, GBytes *signed_da
   /* GPGME has no API for using multiple keyrings (aka, gpg --keyring),
    * so we concatenate all the keyring files into one pubring.gpg in a
    * temporary directory, then tell GPGME to use that directory as the
-   * home directory. */
+   * home directory.  When the caller hands us an already-assembled home
+   * directory we just point the context at it and skip the key import. */
 
   if (g_cancellable_set_error_if_cancelled (cancellable, error))
     goto out;
@@ -286,11 +288,26 @@ _ostree_gpg_verifier_check_signature (OstreeGpgVerifier *self, GBytes *signed_da
   if (result == NULL)
     goto out;
 
-  if (!ot_gpgme_ctx_tmp_home_dir (result->context, &tmp_dir, &target_stream, cancellable, error))
-    goto out;
+  if (home_dir != NULL)
+    {
+      gpg_error
+          = gpgme_ctx_set_engine_info (result->context, GPGME_PROTOCOL_OpenPGP, NULL, home_dir);
+      if (gpg_error != GPG_ERR_NO_ERROR)
+        {
+          ot_gpgme_throw (gpg_error, error, "gpgme_ctx_set_engine_info");
+          goto out;
+        }
+    }
+  else
+    {
+      if (!ot_gpgme_ctx_tmp_home_dir (result->context, &tmp_dir, &target_stream, cancellable,
+                                      error))
+        goto out;
 
-  if (!_ostree_gpg_verifier_import_keys (self, result->context, target_stream, cancellable, error))
-    goto out;
+      if (!_ostree_gpg_verifier_import_keys (self, result->context, target_stream, cancellable,
+                                             error))
+        goto out;
+    }
 
   /* Both the signed data and signature GBytes instances will outlive the
    * gpgme_data_t structs, so we can safely reuse the GBytes memory buffer
@@ -332,8 +349,11 @@ out:
       /* Keep the temporary directory around for the life of the result
        * object so its GPGME context remains valid.  It may yet have to
        * extract user details from signing keys and will need to access
-       * the fabricated pubring.gpg keyring. */
-      g_object_weak_ref (G_OBJECT (result), verify_result_finalized_cb, g_strdup (tmp_dir));
+       * the fabricated pubring.gpg keyring.  (A caller-provided home
+       * directory is owned by the caller, who must keep it alive for the
+       * life of the result instead.) */
+      if (tmp_dir != NULL)
+        g_object_weak_ref (G_OBJECT (result), verify_result_finalized_cb, g_strdup (tmp_dir));
     }
   else
     {
@@ -348,6 +368,124 @@ out:
   return result;
 }
 
+OstreeGpgVerifyResult *
+_ostree_gpg_verifier_check_signature (OstreeGpgVerifier *self, GBytes *signed_data,
+                                      GBytes *signatures, GCancellable *cancellable, GError **error)
+{
+  return gpg_verifier_check_signature_internal (self, NULL, signed_data, signatures, cancellable,
+                                                error);
+}
+
+/* Like _ostree_gpg_verifier_check_signature(), but verify against the keys in
+ * @home_dir as previously assembled by _ostree_gpg_verifier_prepare_home_dir()
+ * instead of importing this verifier's key sources from scratch.  The caller
+ * must keep @home_dir alive for the life of the returned result.
+ */
+OstreeGpgVerifyResult *
+_ostree_gpg_verifier_check_signature_with_home_dir (OstreeGpgVerifier *self, const char *home_dir,
+                                                    GBytes *signed_data, GBytes *signatures,
+                                                    GCancellable *cancellable, GError **error)
+{
+  return gpg_verifier_check_signature_internal (self, home_dir, signed_data, signatures,
+                                                cancellable, error);
+}
+
+/* Assemble a GPG home directory holding all of this verifier's key sources,
+ * exactly as _ostree_gpg_verifier_check_signature() would, and return its
+ * path.  Importing the keys spawns gpg and dominates the cost of a single
+ * verification, so callers verifying many signatures against the same trust
+ * set should build the directory once and pass it to
+ * _ostree_gpg_verifier_check_signature_with_home_dir().  The caller owns the
+ * directory and must eventually kill its GPG agent and delete it.
+ */
+char *
+_ostree_gpg_verifier_prepare_home_dir (OstreeGpgVerifier *self, GCancellable *cancellable,
+                                       GError **error)
+{
+  GLNX_AUTO_PREFIX_ERROR ("GPG", error);
+
+  g_auto (gpgme_ctx_t) context = ot_gpgme_new_ctx (NULL, error);
+  if (context == NULL)
+    return NULL;
+
+  g_autofree char *tmp_dir = NULL;
+  g_autoptr (GOutputStream) pubring_stream = NULL;
+  if (!ot_gpgme_ctx_tmp_home_dir (context, &tmp_dir, &pubring_stream, cancellable, error))
+    return NULL;
+
+  if (!_ostree_gpg_verifier_import_keys (self, context, pubring_stream, cancellable, error))
+    {
+      ot_gpgme_kill_agent (tmp_dir);
+      (void)glnx_shutil_rm_rf_at (AT_FDCWD, tmp_dir, NULL, NULL);
+      return NULL;
+    }
+
+  return g_steal_pointer (&tmp_dir);
+}
+
+/* Hash every keyring source added to the verifier so far, in registration
+ * order.  Two verifiers with equal digests would import identical key
+ * material; the pull code uses this to key its persistent verified-commit
+ * cache.  Keyring files that don't exist are skipped, matching the import
+ * behavior above.
+ */
+char *
+_ostree_gpg_verifier_keyring_digest (OstreeGpgVerifier *self, GCancellable *cancellable,
+                                     GError **error)
+{
+  g_autoptr (GChecksum) checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+  for (GList *link = self->keyrings; link != NULL; link = link->next)
+    {
+      GFile *keyring_file = link->data;
+      g_autofree char *contents = NULL;
+      gsize len = 0;
+      GError *local_error = NULL;
+
+      if (!g_file_load_contents (keyring_file, cancellable, &contents, &len, NULL, &local_error))
+        {
+          if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+            {
+              g_clear_error (&local_error);
+              continue;
+            }
+          g_propagate_error (error, local_error);
+          return NULL;
+        }
+
+      g_checksum_update (checksum, (const guchar *)contents, len);
+    }
+
+  for (guint i = 0; i < self->keyring_data->len; i++)
+    {
+      GBytes *keyringd = self->keyring_data->pdata[i];
+      gsize len;
+      const guint8 *buf = g_bytes_get_data (keyringd, &len);
+      g_checksum_update (checksum, buf, len);
+    }
+
+  if (self->key_ascii_files)
+    {
+      for (guint i = 0; i < self->key_ascii_files->len; i++)
+        {
+          const char *path = self->key_ascii_files->pdata[i];
+          glnx_autofd int fd = -1;
+          gsize len;
+
+          if (!glnx_openat_rdonly (AT_FDCWD, path, TRUE, &fd, error))
+            return NULL;
+          g_autoptr (GBytes) data = glnx_fd_readall_bytes (fd, cancellable, error);
+          if (!data)
+            return NULL;
+
+          const guint8 *buf = g_bytes_get_data (data, &len);
+          g_checksum_update (checksum, buf, len);
+        }
+    }
+
+  return g_strdup (g_checksum_get_string (checksum));
+}
+
 /* Given @path which should contain a GPG keyring file, add it
  * to the list of trusted keys.
  */
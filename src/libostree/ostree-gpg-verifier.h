@@ -48,6 +48,16 @@ OstreeGpgVerifyResult *_ostree_gpg_verifier_check_signature (OstreeGpgVerifier *
                                                              GCancellable *cancellable,
                                                              GError **error);
 
+OstreeGpgVerifyResult *_ostree_gpg_verifier_check_signature_with_home_dir (
+    OstreeGpgVerifier *self, const char *home_dir, GBytes *signed_data, GBytes *signatures,
+    GCancellable *cancellable, GError **error);
+
+char *_ostree_gpg_verifier_prepare_home_dir (OstreeGpgVerifier *self, GCancellable *cancellable,
+                                             GError **error);
+
+char *_ostree_gpg_verifier_keyring_digest (OstreeGpgVerifier *self, GCancellable *cancellable,
+                                           GError **error);
+
 gboolean _ostree_gpg_verifier_list_keys (OstreeGpgVerifier *self, const char *const *key_ids,
                                          GPtrArray **out_keys, GCancellable *cancellable,
                                          GError **error);
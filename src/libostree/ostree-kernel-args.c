@@ -417,6 +417,33 @@ ostree_kernel_args_delete (OstreeKernelArgs *kargs, const char *arg, GError **er
   return TRUE;
 }
 
+/* Like ostree_kernel_args_append(), but takes ownership of @arg, saving a
+ * copy for callers that already hold a fresh allocation. */
+static void
+kernel_args_append_take (OstreeKernelArgs *kargs, char *arg)
+{
+  gboolean existed = TRUE;
+  GPtrArray *entries = NULL;
+  const char *val = split_keyeq (arg);
+
+  entries = g_hash_table_lookup (kargs->table, arg);
+  if (!entries)
+    {
+      entries = g_ptr_array_new_with_free_func (kernel_args_entry_free_from_table);
+      existed = FALSE;
+    }
+
+  OstreeKernelArgsEntry *entry = _ostree_kernel_args_entry_new ();
+  _ostree_kernel_args_entry_set_key (entry, arg);
+  _ostree_kernel_args_entry_set_value (entry, g_strdup (val));
+
+  g_ptr_array_add (entries, entry);
+  g_ptr_array_add (kargs->order, entry);
+
+  if (!existed)
+    g_hash_table_replace (kargs->table, arg, entries);
+}
+
 /**
  * ostree_kernel_args_replace_take:
  * @kargs: a OstreeKernelArgs instance
@@ -499,27 +526,7 @@ ostree_kernel_args_replace (OstreeKernelArgs *kargs, const char *arg)
 void
 ostree_kernel_args_append (OstreeKernelArgs *kargs, const char *arg)
 {
-  gboolean existed = TRUE;
-  GPtrArray *entries = NULL;
-  char *duped = g_strdup (arg);
-  const char *val = split_keyeq (duped);
-
-  entries = g_hash_table_lookup (kargs->table, duped);
-  if (!entries)
-    {
-      entries = g_ptr_array_new_with_free_func (kernel_args_entry_free_from_table);
-      existed = FALSE;
-    }
-
-  OstreeKernelArgsEntry *entry = _ostree_kernel_args_entry_new ();
-  _ostree_kernel_args_entry_set_key (entry, duped);
-  _ostree_kernel_args_entry_set_value (entry, g_strdup (val));
-
-  g_ptr_array_add (entries, entry);
-  g_ptr_array_add (kargs->order, entry);
-
-  if (!existed)
-    g_hash_table_replace (kargs->table, duped, entries);
+  kernel_args_append_take (kargs, g_strdup (arg));
 }
 
 /**
@@ -638,19 +645,20 @@ ostree_kernel_args_append_proc_cmdline (OstreeKernelArgs *kargs, GCancellable *c
 void
 ostree_kernel_args_parse_append (OstreeKernelArgs *kargs, const char *options)
 {
-  char **args = NULL;
-  char **iter;
-
   if (!options)
     return;
 
-  args = g_strsplit (options, " ", -1);
-  for (iter = args; *iter; iter++)
+  /* A single pass over @options; each argument is duped once and handed
+   * straight to the table rather than going through an intermediate string
+   * vector.  Runs of whitespace produce no (empty) arguments. */
+  for (const char *p = options; *p;)
     {
-      char *arg = *iter;
-      ostree_kernel_args_append (kargs, arg);
+      const char *end = strchr (p, ' ');
+      const size_t len = end ? (size_t)(end - p) : strlen (p);
+      if (len > 0)
+        kernel_args_append_take (kargs, g_strndup (p, len));
+      p = end ? end + 1 : p + len;
     }
-  g_strfreev (args);
 }
 
 /**
@@ -728,29 +736,41 @@ ostree_kernel_args_to_strv (OstreeKernelArgs *kargs)
 char *
 ostree_kernel_args_to_string (OstreeKernelArgs *kargs)
 {
-  GString *buf = g_string_new ("");
-  gboolean first = TRUE;
-  guint i;
-
-  for (i = 0; i < kargs->order->len; i++)
+  /* Compute the final length first, then write once into an exactly-sized
+   * buffer; deployment finalization serializes kargs repeatedly. */
+  gsize len = 0;
+  for (guint i = 0; i < kargs->order->len; i++)
     {
       const char *key = _ostree_kernel_args_get_key_index (kargs, i);
       const char *value = _ostree_kernel_args_get_value_index (kargs, i);
 
-      if (first)
-        first = FALSE;
-      else
-        g_string_append_c (buf, ' ');
+      if (len > 0)
+        len++; /* separating space */
+      len += strlen (key);
+      if (value != NULL)
+        len += 1 + strlen (value);
+    }
+
+  char *ret = g_malloc (len + 1);
+  char *p = ret;
+  for (guint i = 0; i < kargs->order->len; i++)
+    {
+      const char *key = _ostree_kernel_args_get_key_index (kargs, i);
+      const char *value = _ostree_kernel_args_get_value_index (kargs, i);
 
-      g_string_append (buf, key);
+      if (p != ret)
+        *p++ = ' ';
+      p = g_stpcpy (p, key);
       if (value != NULL)
         {
-          g_string_append_c (buf, '=');
-          g_string_append (buf, value);
+          *p++ = '=';
+          p = g_stpcpy (p, value);
         }
     }
+  *p = '\0';
+  g_assert_cmpuint ((gsize)(p - ret), ==, len);
 
-  return g_string_free (buf, FALSE);
+  return ret;
 }
 
 /**
@@ -55,6 +55,7 @@ struct _OstreeLzmaCompressor
   GVariant *params;
   lzma_stream lstream;
   gboolean initialized;
+  gboolean multithreaded;
 };
 
 G_DEFINE_TYPE_WITH_CODE (OstreeLzmaCompressor, _ostree_lzma_compressor, G_TYPE_OBJECT,
@@ -81,7 +82,7 @@ _ostree_lzma_compressor_set_property (GObject *object, guint prop_id, const GVal
   switch (prop_id)
     {
     case PROP_PARAMS:
-      self->params = g_value_get_variant (value);
+      self->params = g_value_dup_variant (value);
       break;
 
     default:
@@ -147,6 +148,7 @@ _ostree_lzma_compressor_reset (GConverter *converter)
       lzma_end (&self->lstream);
       self->lstream = tmp;
       self->initialized = FALSE;
+      self->multithreaded = FALSE;
     }
 }
 
@@ -167,7 +169,38 @@ _ostree_lzma_compressor_convert (GConverter *converter, const void *inbuf, gsize
 
   if (!self->initialized)
     {
-      res = lzma_easy_encoder (&self->lstream, 8, LZMA_CHECK_CRC64);
+      guint32 threads = 0;
+
+      if (self->params != NULL)
+        (void)g_variant_lookup (self->params, "threads", "u", &threads);
+
+      res = LZMA_PROG_ERROR;
+#if LZMA_VERSION >= 50020000
+      if (threads > 1)
+        {
+          /* The multi-threaded encoder splits the input into
+           * independently compressed blocks; the result is still a
+           * standard .xz stream that any single-threaded decoder
+           * (including our lzma_stream_decoder()-based decompressor)
+           * can read.
+           */
+          lzma_mt mt_options = {
+            .threads = threads,
+            .preset = 8,
+            .check = LZMA_CHECK_CRC64,
+          };
+          res = lzma_stream_encoder_mt (&self->lstream, &mt_options);
+        }
+#endif
+      /* Fall back to the single-threaded encoder if multi-threading
+       * wasn't requested, isn't available in this liblzma, or failed to
+       * initialize (e.g. not enough memory for the requested thread
+       * count).
+       */
+      if (res != LZMA_OK)
+        res = lzma_easy_encoder (&self->lstream, 8, LZMA_CHECK_CRC64);
+      else
+        self->multithreaded = TRUE;
       if (res != LZMA_OK)
         goto out;
       self->initialized = TRUE;
@@ -183,7 +216,8 @@ _ostree_lzma_compressor_convert (GConverter *converter, const void *inbuf, gsize
   if (flags & G_CONVERTER_INPUT_AT_END)
     action = LZMA_FINISH;
   else if (flags & G_CONVERTER_FLUSH)
-    action = LZMA_SYNC_FLUSH;
+    /* The multi-threaded encoder doesn't support LZMA_SYNC_FLUSH */
+    action = self->multithreaded ? LZMA_FULL_FLUSH : LZMA_SYNC_FLUSH;
 
   res = lzma_code (&self->lstream, action);
   if (res != LZMA_OK && res != LZMA_STREAM_END)
@@ -97,6 +97,14 @@ struct OstreeMutableTree
 
   /* const char* filename -> OstreeMutableTree* subtree */
   GHashTable *subdirs;
+
+  /* Arena backing the filename and checksum strings in the hash tables
+   * above, created on first insertion.  Committing trees with millions of
+   * entries otherwise spends measurable time and allocator overhead on
+   * individual small strings.  Strings for entries that are later removed
+   * or replaced are retained until the tree is finalized; the write paths
+   * essentially only add, so this stays bounded in practice. */
+  GStringChunk *arena;
 };
 
 G_DEFINE_TYPE (OstreeMutableTree, ostree_mutable_tree, G_TYPE_OBJECT)
@@ -114,6 +122,7 @@ ostree_mutable_tree_finalize (GObject *object)
   g_clear_pointer (&self->cached_error, g_error_free);
   g_hash_table_destroy (self->files);
   g_hash_table_destroy (self->subdirs);
+  g_clear_pointer (&self->arena, g_string_chunk_free);
 
   g_clear_object (&self->repo);
 
@@ -128,6 +137,15 @@ ostree_mutable_tree_class_init (OstreeMutableTreeClass *klass)
   gobject_class->finalize = ostree_mutable_tree_finalize;
 }
 
+/* Copy @str into @self's arena; the result lives until @self is finalized. */
+static char *
+mtree_intern (OstreeMutableTree *self, const char *str)
+{
+  if (self->arena == NULL)
+    self->arena = g_string_chunk_new (1024);
+  return g_string_chunk_insert (self->arena, str);
+}
+
 /* This must not be made public or we can't maintain the invariant that any
  * OstreeMutableTree has only one parent.
  *
@@ -136,7 +154,7 @@ static void
 insert_child_mtree (OstreeMutableTree *self, const gchar *name, OstreeMutableTree *child)
 {
   g_assert_null (child->parent);
-  g_hash_table_insert (self->subdirs, g_strdup (name), child);
+  g_hash_table_insert (self->subdirs, mtree_intern (self, name), child);
   child->parent = self;
 }
 
@@ -155,8 +173,9 @@ remove_child_mtree (gpointer data)
 static void
 ostree_mutable_tree_init (OstreeMutableTree *self)
 {
-  self->files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
-  self->subdirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, remove_child_mtree);
+  /* Keys and file checksum values live in self->arena */
+  self->files = g_hash_table_new (g_str_hash, g_str_equal);
+  self->subdirs = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, remove_child_mtree);
   self->state = MTREE_STATE_WHOLE;
 }
 
@@ -202,7 +221,8 @@ _ostree_mutable_tree_make_whole (OstreeMutableTree *self, GCancellable *cancella
       {
         char tmp_checksum[OSTREE_SHA256_STRING_LEN + 1];
         _ostree_checksum_inplace_from_bytes_v (contents_csum_v, tmp_checksum);
-        g_hash_table_insert (self->files, g_strdup (fname), g_strdup (tmp_checksum));
+        g_hash_table_insert (self->files, mtree_intern (self, fname),
+                             mtree_intern (self, tmp_checksum));
       }
   }
 
@@ -304,7 +324,7 @@ ostree_mutable_tree_replace_file (OstreeMutableTree *self, const char *name, con
     return glnx_throw (error, "Can't replace directory with file: %s", name);
 
   invalidate_contents_checksum (self);
-  g_hash_table_replace (self->files, g_strdup (name), g_strdup (checksum));
+  g_hash_table_replace (self->files, mtree_intern (self, name), mtree_intern (self, checksum));
   return TRUE;
 }
 
@@ -452,7 +472,7 @@ ostree_mutable_tree_ensure_parent_dirs (OstreeMutableTree *self, GPtrArray *spli
           invalidate_contents_checksum (subdir);
           next = ostree_mutable_tree_new ();
           ostree_mutable_tree_set_metadata_checksum (next, metadata_checksum);
-          insert_child_mtree (subdir, g_strdup (name), next);
+          insert_child_mtree (subdir, name, next);
         }
 
       subdir = next;
@@ -25,6 +25,8 @@
 #include <gio/gfiledescriptorbased.h>
 #include <gio/gunixoutputstream.h>
 #include <glib-unix.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/xattr.h>
 
 #include "ostree-core-private.h"
@@ -37,12 +39,181 @@
 
 #define OVERLAYFS_WHITEOUT_PREFIX ".ostree-wh."
 
+/* Don't bother preallocating small files; the extent allocation win only
+ * matters once a file spans multiple allocation groups.
+ */
+#define CHECKOUT_FALLOCATE_THRESHOLD_BYTES (1 * 1024 * 1024)
+
+/* Object checksum recorded on checked-out files by union-identical
+ * checkouts, so subsequent ones can test content equality with a single
+ * getxattr instead of re-reading both files.  Only used when xattrs aren't
+ * part of the object identity (bare-user-only, or xattrs disabled), since
+ * the record itself is an xattr.
+ */
+#define CHECKOUT_CHECKSUM_XATTR "user.ostree.object-checksum"
+
+/* Best-effort: not every filesystem supports user xattrs, and the record
+ * is only a cache.  The stat snapshot stored alongside the checksum
+ * invalidates the record if the file is modified after checkout.
+ */
+static void
+checkout_checksum_xattr_record (int fd, const char *checksum)
+{
+  struct stat stbuf;
+  if (fstat (fd, &stbuf) < 0)
+    return;
+  g_autofree char *value = g_strdup_printf (
+      "%s %" G_GUINT64_FORMAT ".%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT, checksum,
+      (guint64)stbuf.st_mtim.tv_sec, (guint64)stbuf.st_mtim.tv_nsec, (guint64)stbuf.st_size);
+  (void)fsetxattr (fd, CHECKOUT_CHECKSUM_XATTR, value, strlen (value), 0);
+}
+
+/* Return the object checksum a previous checkout recorded for the existing
+ * destination file, or %NULL if there is none or the file looks modified
+ * since (stat snapshot mismatch) — callers then fall back to the full
+ * content comparison.
+ */
+static char *
+checkout_checksum_xattr_lookup (int destination_dfd, const char *destination_name,
+                                const struct stat *dest_stbuf)
+{
+  glnx_autofd int fd = -1;
+  if (!glnx_openat_rdonly (destination_dfd, destination_name, FALSE, &fd, NULL))
+    return NULL;
+
+  char buf[OSTREE_SHA256_STRING_LEN + 128];
+  ssize_t n = fgetxattr (fd, CHECKOUT_CHECKSUM_XATTR, buf, sizeof (buf) - 1);
+  if (n <= 0)
+    return NULL;
+  buf[n] = '\0';
+
+  g_auto (GStrv) parts = g_strsplit (buf, " ", -1);
+  if (g_strv_length (parts) != 3 || !ostree_validate_checksum_string (parts[0], NULL))
+    return NULL;
+
+  g_autofree char *expected_stat = g_strdup_printf (
+      "%" G_GUINT64_FORMAT ".%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT,
+      (guint64)dest_stbuf->st_mtim.tv_sec, (guint64)dest_stbuf->st_mtim.tv_nsec,
+      (guint64)dest_stbuf->st_size);
+  g_autofree char *actual_stat = g_strconcat (parts[1], " ", parts[2], NULL);
+  if (!g_str_equal (expected_stat, actual_stat))
+    return NULL;
+
+  return g_strdup (parts[0]);
+}
+
+/* Byte-accurate progress reporting; see the progress option.  The total
+ * is computed up front with a dirtree size walk, and each completed
+ * regular file adds its size under the lock, so parallel checkout
+ * workers never lose updates.
+ */
+typedef struct
+{
+  OstreeAsyncProgress *progress; /* unowned */
+  GMutex lock;
+  guint64 bytes_written;
+  guint64 files_written;
+} CheckoutProgress;
+
+static void
+checkout_progress_add_bytes (CheckoutProgress *cp, guint64 bytes)
+{
+  g_mutex_lock (&cp->lock);
+  cp->bytes_written += bytes;
+  cp->files_written++;
+  const guint64 total = cp->bytes_written;
+  const guint64 files = cp->files_written;
+  g_mutex_unlock (&cp->lock);
+  ostree_async_progress_set (cp->progress, "bytes-written", "t", total, "files-written", "t", files,
+                             NULL);
+}
+
+/* Flags controlling how each repo in the parent chain participates in the
+ * checkout.  These depend only on the repo modes and the checkout options,
+ * both fixed for the duration of a checkout, but used to be rederived for
+ * every repo on every file, which showed up as branch dispatch overhead in
+ * checkout profiles of large trees.  checkout_plan_init() resolves them
+ * once per checkout_tree_at() call.
+ */
+typedef struct
+{
+  OstreeRepo *repo; /* unowned */
+  gboolean repo_is_usermode;
+  gboolean is_hardlinkable;
+  gboolean is_archive_z2_with_cache;
+} CheckoutRepoFlags;
+
+typedef struct
+{
+  GArray *repos; /* element-type CheckoutRepoFlags; the repo, then its parents */
+  gboolean can_cache;
+} CheckoutPlan;
+
+/* Work queue for parallel checkouts; see the checkout_threads option.
+ * Subdirectories of the checkout root are dispatched as jobs onto a
+ * thread pool.  Each job owns its own dirfd, so worker threads never
+ * contend on a shared parent directory; workers themselves recurse
+ * serially.
+ */
+typedef struct
+{
+  OstreeRepo *repo; /* unowned */
+  OstreeRepoCheckoutAtOptions *options;
+  OtThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  guint outstanding;
+  GError *caught_error;       /* first worker error wins */
+  CheckoutProgress *progress; /* unowned; NULL if not reporting */
+  const CheckoutPlan *plan;   /* unowned; shared read-only with workers */
+  GCancellable *cancellable;
+} CheckoutWorkQueue;
+
+static void
+checkout_plan_init (CheckoutPlan *plan, OstreeRepo *repo, OstreeRepoCheckoutAtOptions *options)
+{
+  plan->can_cache = (options->enable_uncompressed_cache && repo->enable_uncompressed_cache);
+  plan->repos = g_array_new (FALSE, FALSE, sizeof (CheckoutRepoFlags));
+
+  for (OstreeRepo *current_repo = repo; current_repo != NULL;
+       current_repo = current_repo->parent_repo)
+    {
+      CheckoutRepoFlags flags = {
+        0,
+      };
+      flags.repo = current_repo;
+      flags.repo_is_usermode = current_repo->mode == OSTREE_REPO_MODE_BARE_USER
+                               || current_repo->mode == OSTREE_REPO_MODE_BARE_USER_ONLY;
+      /* We're hardlinkable if the checkout mode matches the repo mode */
+      flags.is_hardlinkable = (current_repo->mode == OSTREE_REPO_MODE_BARE
+                               && options->mode == OSTREE_REPO_CHECKOUT_MODE_NONE)
+                              || (flags.repo_is_usermode
+                                  && options->mode == OSTREE_REPO_CHECKOUT_MODE_USER);
+      gboolean current_can_cache
+          = (options->enable_uncompressed_cache && current_repo->enable_uncompressed_cache);
+      flags.is_archive_z2_with_cache = (current_repo->mode == OSTREE_REPO_MODE_ARCHIVE
+                                        && options->mode == OSTREE_REPO_CHECKOUT_MODE_USER
+                                        && current_can_cache);
+      g_array_append_val (plan->repos, flags);
+    }
+}
+
+static void
+checkout_plan_clear (CheckoutPlan *plan)
+{
+  g_clear_pointer (&plan->repos, g_array_unref);
+}
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (CheckoutPlan, checkout_plan_clear)
+
 /* Per-checkout call state/caching */
 typedef struct
 {
   GString *path_buf;         /* buffer for real path if filtering enabled */
   GString *selabel_path_buf; /* buffer for selinux path if labeling enabled; this may be
                                 the same buffer as path_buf */
+  CheckoutWorkQueue *queue;   /* unowned; non-NULL only at the dispatch level */
+  CheckoutProgress *progress; /* unowned; shared across workers, NULL if not reporting */
+  const CheckoutPlan *plan;   /* unowned; immutable after checkout_tree_at() computes it */
 } CheckoutState;
 
 static void
@@ -128,12 +299,42 @@ write_regular_file_content (OstreeRepo *self, OstreeRepoCheckoutAtOptions *optio
     {
       int infd = g_file_descriptor_based_get_fd ((GFileDescriptorBased *)input);
       guint64 len = g_file_info_get_size (file_info);
+      gboolean did_clone = FALSE;
+
+#ifdef FICLONE
+      if (options->enable_reflink)
+        {
+          /* Try a metadata-only clone of the source extents; this only works
+           * on filesystems with reflink support (btrfs, XFS) and when the
+           * repository and target share a filesystem, so fall back silently
+           * to a regular copy.
+           */
+          if (ioctl (outfd, FICLONE, infd) == 0)
+            did_clone = TRUE;
+        }
+#endif
+
+      if (!did_clone)
+        {
+          /* Tell the filesystem the final size up front, so large copies
+           * get contiguous extents rather than growing allocation by
+           * allocation; a no-op where unsupported.
+           */
+          if (len >= CHECKOUT_FALLOCATE_THRESHOLD_BYTES
+              && !glnx_try_fallocate (outfd, 0, (off_t)len, error))
+            return FALSE;
 
-      if (glnx_regfile_copy_bytes (infd, outfd, (off_t)len) < 0)
-        return glnx_throw_errno_prefix (error, "regfile copy");
+          if (glnx_regfile_copy_bytes (infd, outfd, (off_t)len) < 0)
+            return glnx_throw_errno_prefix (error, "regfile copy");
+        }
     }
   else
     {
+      const guint64 len = g_file_info_get_size (file_info);
+      if (len >= CHECKOUT_FALLOCATE_THRESHOLD_BYTES
+          && !glnx_try_fallocate (outfd, 0, (off_t)len, error))
+        return FALSE;
+
       outstream = g_unix_output_stream_new (outfd, FALSE);
       if (g_output_stream_splice (outstream, input, 0, cancellable, error) < 0)
         return FALSE;
@@ -324,6 +525,12 @@ create_file_copy_from_input_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *o
                                        cancellable, error))
         return FALSE;
 
+      /* Remember the object identity so the next union-identical checkout
+       * over this file is a getxattr, not a content read. */
+      if (options->overwrite_mode == OSTREE_REPO_CHECKOUT_OVERWRITE_UNION_IDENTICAL
+          && (repo->disable_xattrs || repo->mode == OSTREE_REPO_MODE_BARE_USER_ONLY))
+        checkout_checksum_xattr_record (tmpf.fd, checksum);
+
       /* The add/union/none behaviors map directly to GLnxLinkTmpfileReplaceMode */
       GLnxLinkTmpfileReplaceMode replace_mode = GLNX_LINK_TMPFILE_NOREPLACE;
       switch (options->overwrite_mode)
@@ -366,14 +573,28 @@ create_file_copy_from_input_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *o
                 if (repo->mode == OSTREE_REPO_MODE_BARE_USER_ONLY)
                   flags |= OSTREE_CHECKSUM_FLAGS_CANONICAL_PERMISSIONS;
 
-                g_autofree char *actual_checksum = NULL;
-                if (!ostree_checksum_file_at (destination_dfd, destination_name, &dest_stbuf,
-                                              OSTREE_OBJECT_TYPE_FILE, flags, &actual_checksum,
-                                              cancellable, error))
-                  return FALSE;
+                /* Fast path: a previous union-identical checkout may have
+                 * recorded the object checksum in an xattr. */
+                g_autofree char *recorded = NULL;
+                if ((flags & OSTREE_CHECKSUM_FLAGS_IGNORE_XATTRS) > 0)
+                  recorded = checkout_checksum_xattr_lookup (destination_dfd, destination_name,
+                                                             &dest_stbuf);
+                if (recorded != NULL)
+                  {
+                    if (g_str_equal (checksum, recorded))
+                      return TRUE;
+                  }
+                else
+                  {
+                    g_autofree char *actual_checksum = NULL;
+                    if (!ostree_checksum_file_at (destination_dfd, destination_name, &dest_stbuf,
+                                                  OSTREE_OBJECT_TYPE_FILE, flags, &actual_checksum,
+                                                  cancellable, error))
+                      return FALSE;
 
-                if (g_str_equal (checksum, actual_checksum))
-                  return TRUE;
+                    if (g_str_equal (checksum, actual_checksum))
+                      return TRUE;
+                  }
 
                 /* Otherwise, fall through and do the link, we should
                  * get EEXIST.
@@ -511,13 +732,24 @@ checkout_file_hardlink (OstreeRepo *self, const char *checksum,
                 if (self->mode == OSTREE_REPO_MODE_BARE_USER_ONLY)
                   flags |= OSTREE_CHECKSUM_FLAGS_CANONICAL_PERMISSIONS;
 
-                g_autofree char *actual_checksum = NULL;
-                if (!ostree_checksum_file_at (destination_dfd, destination_name, &dest_stbuf,
-                                              OSTREE_OBJECT_TYPE_FILE, flags, &actual_checksum,
-                                              cancellable, error))
-                  return FALSE;
+                /* Fast path: a previous union-identical checkout may have
+                 * recorded the object checksum in an xattr. */
+                g_autofree char *recorded = NULL;
+                if ((flags & OSTREE_CHECKSUM_FLAGS_IGNORE_XATTRS) > 0)
+                  recorded = checkout_checksum_xattr_lookup (destination_dfd, destination_name,
+                                                             &dest_stbuf);
+                if (recorded != NULL)
+                  is_identical = g_str_equal (checksum, recorded);
+                else
+                  {
+                    g_autofree char *actual_checksum = NULL;
+                    if (!ostree_checksum_file_at (destination_dfd, destination_name, &dest_stbuf,
+                                                  OSTREE_OBJECT_TYPE_FILE, flags, &actual_checksum,
+                                                  cancellable, error))
+                      return FALSE;
 
-                is_identical = g_str_equal (checksum, actual_checksum);
+                    is_identical = g_str_equal (checksum, actual_checksum);
+                  }
               }
             if (is_identical)
               ret_result = HARDLINK_RESULT_SKIP_EXISTED;
@@ -676,10 +908,18 @@ checkout_one_file_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *options, Ch
                       const char *checksum, int destination_dfd, const char *destination_name,
                       GCancellable *cancellable, GError **error)
 {
+  /* Be sure cancellation takes effect promptly between files, not just
+   * whenever the next I/O call happens to check.
+   */
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return FALSE;
+
   /* Validate this up front to prevent path traversal attacks */
   if (!ot_util_filename_validate (destination_name, error))
     return FALSE;
 
+  ot_tracepoint1 (checkout_file, checksum);
+
   gboolean need_copy = TRUE;
   gboolean is_bare_user_symlink = FALSE;
   char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
@@ -708,10 +948,19 @@ checkout_one_file_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *options, Ch
       = (g_file_info_get_file_type (source_info) == G_FILE_TYPE_SYMBOLIC_LINK);
   const guint32 source_mode = g_file_info_get_attribute_uint32 (source_info, "unix::mode");
   const gboolean is_unreadable = (!is_symlink && (source_mode & S_IRUSR) == 0);
-  const gboolean is_whiteout = (!is_symlink && options->process_whiteouts
+  /* Whiteout names all start with '.', so a one-byte check rejects almost
+   * every file before the full prefix comparisons; when neither form of
+   * whiteout processing is enabled we skip even that.  These per-file
+   * string checks were showing up in checkout profiles on large trees.
+   */
+  const gboolean may_be_whiteout
+      = (!is_symlink && destination_name[0] == '.'
+         && (options->process_whiteouts || options->process_passthrough_whiteouts));
+  const gboolean is_whiteout = (may_be_whiteout && options->process_whiteouts
                                 && g_str_has_prefix (destination_name, WHITEOUT_PREFIX));
   const gboolean is_overlayfs_whiteout
-      = (!is_symlink && g_str_has_prefix (destination_name, OVERLAYFS_WHITEOUT_PREFIX));
+      = (may_be_whiteout && options->process_passthrough_whiteouts
+         && g_str_has_prefix (destination_name, OVERLAYFS_WHITEOUT_PREFIX));
   const gboolean is_reg_zerosized = (!is_symlink && g_file_info_get_size (source_info) == 0);
   const gboolean override_user_unreadable
       = (options->mode == OSTREE_REPO_CHECKOUT_MODE_USER && is_unreadable);
@@ -733,7 +982,7 @@ checkout_one_file_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *options, Ch
 
       need_copy = FALSE;
     }
-  else if (is_overlayfs_whiteout && options->process_passthrough_whiteouts)
+  else if (is_overlayfs_whiteout)
     {
       const char *name = destination_name + (sizeof (OVERLAYFS_WHITEOUT_PREFIX) - 1);
 
@@ -757,51 +1006,42 @@ checkout_one_file_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *options, Ch
     {
       HardlinkResult hardlink_res = HARDLINK_RESULT_NOT_SUPPORTED;
       /* Try to do a hardlink first, if it's a regular file.  This also
-       * traverses all parent repos.
+       * traverses all parent repos; the per-repo flags were resolved once
+       * in checkout_plan_init().
        */
-      OstreeRepo *current_repo = repo;
+      const CheckoutPlan *plan = state->plan;
 
-      while (current_repo)
+      for (guint i = 0; i < plan->repos->len; i++)
         {
-          /* TODO - Hoist this up to the toplevel at least for checking out from
-           * !parent; don't need to compute it for each file.
-           */
-          gboolean repo_is_usermode = current_repo->mode == OSTREE_REPO_MODE_BARE_USER
-                                      || current_repo->mode == OSTREE_REPO_MODE_BARE_USER_ONLY;
-          /* We're hardlinkable if the checkout mode matches the repo mode */
-          gboolean is_hardlinkable
-              = (current_repo->mode == OSTREE_REPO_MODE_BARE
-                 && options->mode == OSTREE_REPO_CHECKOUT_MODE_NONE)
-                || (repo_is_usermode && options->mode == OSTREE_REPO_CHECKOUT_MODE_USER);
-          gboolean current_can_cache
-              = (options->enable_uncompressed_cache && current_repo->enable_uncompressed_cache);
-          gboolean is_archive_z2_with_cache
-              = (current_repo->mode == OSTREE_REPO_MODE_ARCHIVE
-                 && options->mode == OSTREE_REPO_CHECKOUT_MODE_USER && current_can_cache);
+          const CheckoutRepoFlags *rflags = &g_array_index (plan->repos, CheckoutRepoFlags, i);
+          OstreeRepo *current_repo = rflags->repo;
 
           /* NOTE: bare-user symlinks are not stored as symlinks; see
            * https://github.com/ostreedev/ostree/commit/47c612e5a0688c3452a125655a245e8f4f01b2b0
            * as well as write_object().
            */
-          is_bare_user_symlink = (repo_is_usermode && is_symlink);
-          const gboolean is_bare = is_hardlinkable && !is_bare_user_symlink;
+          is_bare_user_symlink = (rflags->repo_is_usermode && is_symlink);
+          const gboolean is_bare = rflags->is_hardlinkable && !is_bare_user_symlink;
 
           /* Verify if no_copy_fallback is set that we can hardlink, with a
            * special exception for bare-user symlinks.
            */
-          if (options->no_copy_fallback && !is_hardlinkable && !is_bare_user_symlink)
+          if (options->no_copy_fallback && !rflags->is_hardlinkable && !is_bare_user_symlink)
             return glnx_throw (error,
-                               repo_is_usermode
+                               rflags->repo_is_usermode
                                    ? "User repository mode requires user checkout mode to hardlink"
                                    : "Bare repository mode cannot hardlink in user checkout mode");
 
           /* But only under these conditions */
-          if (is_bare || is_archive_z2_with_cache)
+          if (is_bare || rflags->is_archive_z2_with_cache)
             {
               /* Override repo mode; for archive we're looking in
-                 the cache, which is in "bare" form */
-              _ostree_loose_path (loose_path_buf, checksum, OSTREE_OBJECT_TYPE_FILE,
-                                  OSTREE_REPO_MODE_BARE);
+                 the cache, which is in "bare" form.  The uncompressed
+                 cache always uses the default fanout; the real objects
+                 directory honors the repo's configuration. */
+              _ostree_loose_path_with_fanout (
+                  loose_path_buf, checksum, OSTREE_OBJECT_TYPE_FILE, OSTREE_REPO_MODE_BARE,
+                  _ostree_repo_mode_is_bare (current_repo->mode) && current_repo->deep_fanout);
               if (!checkout_file_hardlink (current_repo, checksum, options, loose_path_buf,
                                            destination_dfd, destination_name, TRUE, &hardlink_res,
                                            cancellable, error))
@@ -828,16 +1068,12 @@ checkout_one_file_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *options, Ch
               if (hardlink_res != HARDLINK_RESULT_NOT_SUPPORTED)
                 break;
             }
-          current_repo = current_repo->parent_repo;
         }
-      /* Pacify clang-analyzer which sees us testing effectively if (repo == NULL) */
-      g_assert (repo);
 
       need_copy = (hardlink_res == HARDLINK_RESULT_NOT_SUPPORTED);
     }
 
-  const gboolean can_cache
-      = (options->enable_uncompressed_cache && repo->enable_uncompressed_cache);
+  const gboolean can_cache = state->plan->can_cache;
 
   g_autoptr (GInputStream) input = NULL;
   g_autoptr (GVariant) xattrs = NULL;
@@ -930,6 +1166,12 @@ checkout_one_file_at (OstreeRepo *repo, OstreeRepoCheckoutAtOptions *options, Ch
         }
     }
 
+  /* Hardlinked files complete their bytes instantly as far as progress
+   * is concerned; the total walk counted them too.
+   */
+  if (state->progress != NULL && !is_symlink)
+    checkout_progress_add_bytes (state->progress, (guint64)g_file_info_get_size (source_info));
+
   return TRUE;
 }
 
@@ -978,6 +1220,232 @@ pop_path_element (OstreeRepoCheckoutAtOptions *options, CheckoutState *state, co
  * Like ostree_repo_checkout_tree(), but check out @source into the
  * relative @destination_name, located by @destination_parent_fd.
  */
+static gboolean checkout_tree_at_recurse (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options,
+                                          CheckoutState *state, int destination_parent_fd,
+                                          const char *destination_name,
+                                          const char *dirtree_checksum,
+                                          const char *dirmeta_checksum, GCancellable *cancellable,
+                                          GError **error);
+
+typedef struct
+{
+  CheckoutWorkQueue *queue;
+  int destination_dfd; /* owned dup of the parent dirfd */
+  char *dname;
+  char *selabel_path; /* snapshot of the selinux label path, or NULL */
+  char dirtree_checksum[OSTREE_SHA256_STRING_LEN + 1];
+  char dirmeta_checksum[OSTREE_SHA256_STRING_LEN + 1];
+} CheckoutWorkItem;
+
+static void
+checkout_queue_worker (gpointer data, gpointer user_data)
+{
+  CheckoutWorkItem *item = data;
+  CheckoutWorkQueue *queue = item->queue;
+  g_autoptr (GError) local_error = NULL;
+
+  /* Don't bother starting new subtrees once something failed */
+  g_mutex_lock (&queue->lock);
+  const gboolean had_error = queue->caught_error != NULL;
+  g_mutex_unlock (&queue->lock);
+
+  if (!had_error)
+    {
+      /* A fresh state; filtering is disabled when the queue is in use, and
+       * for SELinux labeling each job re-seeds a private path buffer from the
+       * dispatch-time snapshot, so nothing here is shared mutably.  queue is
+       * deliberately NULL so workers recurse serially.
+       */
+      g_auto (CheckoutState) state = {
+        0,
+      };
+      if (item->selabel_path != NULL)
+        state.selabel_path_buf = g_string_new (item->selabel_path);
+      state.progress = queue->progress;
+      state.plan = queue->plan;
+      (void)checkout_tree_at_recurse (queue->repo, queue->options, &state, item->destination_dfd,
+                                      item->dname, item->dirtree_checksum, item->dirmeta_checksum,
+                                      queue->cancellable, &local_error);
+    }
+
+  g_mutex_lock (&queue->lock);
+  if (local_error != NULL && queue->caught_error == NULL)
+    queue->caught_error = g_steal_pointer (&local_error);
+  g_assert_cmpuint (queue->outstanding, >, 0);
+  queue->outstanding--;
+  g_cond_signal (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+
+  glnx_close_fd (&item->destination_dfd);
+  g_free (item->dname);
+  g_free (item->selabel_path);
+  g_free (item);
+}
+
+static gboolean
+checkout_queue_push (CheckoutWorkQueue *queue, int destination_dfd, const char *dname,
+                     const char *selabel_path, const char *dirtree_checksum,
+                     const char *dirmeta_checksum, GError **error)
+{
+  glnx_autofd int dfd_copy = dup (destination_dfd);
+  if (dfd_copy < 0)
+    return glnx_throw_errno_prefix (error, "dup");
+
+  CheckoutWorkItem *item = g_new0 (CheckoutWorkItem, 1);
+  item->queue = queue;
+  item->destination_dfd = g_steal_fd (&dfd_copy);
+  item->dname = g_strdup (dname);
+  item->selabel_path = g_strdup (selabel_path);
+  memcpy (item->dirtree_checksum, dirtree_checksum, OSTREE_SHA256_STRING_LEN + 1);
+  memcpy (item->dirmeta_checksum, dirmeta_checksum, OSTREE_SHA256_STRING_LEN + 1);
+
+  g_mutex_lock (&queue->lock);
+  queue->outstanding++;
+  g_mutex_unlock (&queue->lock);
+  ot_thread_pool_push (queue->pool, item);
+  return TRUE;
+}
+
+/* Wait for all dispatched subtrees to complete, and propagate the first
+ * error any worker hit.
+ */
+static gboolean
+checkout_queue_drain (CheckoutWorkQueue *queue, GError **error)
+{
+  g_mutex_lock (&queue->lock);
+  while (queue->outstanding > 0)
+    g_cond_wait (&queue->cond, &queue->lock);
+  g_autoptr (GError) caught_error = g_steal_pointer (&queue->caught_error);
+  g_mutex_unlock (&queue->lock);
+
+  if (caught_error)
+    {
+      g_propagate_error (error, g_steal_pointer (&caught_error));
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+checkout_queue_free (CheckoutWorkQueue *queue)
+{
+  if (queue == NULL)
+    return;
+  (void)checkout_queue_drain (queue, NULL);
+  ot_thread_pool_free (queue->pool);
+  g_cond_clear (&queue->cond);
+  g_mutex_clear (&queue->lock);
+  g_free (queue);
+}
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CheckoutWorkQueue, checkout_queue_free)
+
+/* Checkout consumes loose objects in tree order, which is random with
+ * respect to on-disk layout; on rotating media most of the disk time goes
+ * to seeks.  A background thread walks the dirtrees (metadata only, and
+ * the checkout is about to load the same variants anyway), orders the
+ * content objects physically, and issues POSIX_FADV_WILLNEED so the
+ * kernel queues the reads in that order ahead of the checkout.  Bounded
+ * so a checkout larger than memory doesn't evict its own readahead.
+ */
+#define CHECKOUT_PREFETCH_MAX_BYTES (2ULL * 1024 * 1024 * 1024)
+
+typedef struct
+{
+  OstreeRepo *repo; /* unowned; the thread is joined before checkout returns */
+  char dirtree_checksum[OSTREE_SHA256_STRING_LEN + 1];
+  GCancellable *cancellable;
+  gint stop; /* atomic */
+} CheckoutPrefetchData;
+
+static void
+checkout_prefetch_collect (CheckoutPrefetchData *pd, const char *dirtree_checksum,
+                           GHashTable *seen, GPtrArray *objects)
+{
+  if (g_atomic_int_get (&pd->stop) || g_cancellable_is_cancelled (pd->cancellable))
+    return;
+
+  g_autoptr (GVariant) tree = NULL;
+  if (!ostree_repo_load_variant (pd->repo, OSTREE_OBJECT_TYPE_DIR_TREE, dirtree_checksum, &tree,
+                                 NULL))
+    return;
+
+  g_autoptr (GVariant) file_entries = g_variant_get_child_value (tree, 0);
+  const gsize n_files = g_variant_n_children (file_entries);
+  for (gsize i = 0; i < n_files; i++)
+    {
+      const char *fname;
+      g_autoptr (GVariant) csum_v = NULL;
+      g_variant_get_child (file_entries, i, "(&s@ay)", &fname, &csum_v);
+
+      char checksum[OSTREE_SHA256_STRING_LEN + 1];
+      _ostree_checksum_inplace_from_bytes_v (csum_v, checksum);
+      g_autoptr (GVariant) objname
+          = g_variant_ref_sink (ostree_object_name_serialize (checksum, OSTREE_OBJECT_TYPE_FILE));
+      if (g_hash_table_add (seen, g_variant_ref (objname)))
+        g_ptr_array_add (objects, g_steal_pointer (&objname));
+    }
+
+  g_autoptr (GVariant) dir_entries = g_variant_get_child_value (tree, 1);
+  const gsize n_dirs = g_variant_n_children (dir_entries);
+  for (gsize i = 0; i < n_dirs; i++)
+    {
+      const char *dname;
+      g_autoptr (GVariant) subtree_csum_v = NULL;
+      g_autoptr (GVariant) submeta_csum_v = NULL;
+      g_variant_get_child (dir_entries, i, "(&s@ay@ay)", &dname, &subtree_csum_v, &submeta_csum_v);
+
+      char subtree_checksum[OSTREE_SHA256_STRING_LEN + 1];
+      _ostree_checksum_inplace_from_bytes_v (subtree_csum_v, subtree_checksum);
+      g_autoptr (GVariant) objname = g_variant_ref_sink (
+          ostree_object_name_serialize (subtree_checksum, OSTREE_OBJECT_TYPE_DIR_TREE));
+      if (!g_hash_table_add (seen, g_steal_pointer (&objname)))
+        continue; /* Shared subtree we already walked */
+
+      checkout_prefetch_collect (pd, subtree_checksum, seen, objects);
+    }
+}
+
+static gpointer
+checkout_prefetch_thread (gpointer data)
+{
+  CheckoutPrefetchData *pd = data;
+  g_autoptr (GHashTable) seen = g_hash_table_new_full (
+      ostree_hash_object_name, g_variant_equal, (GDestroyNotify)g_variant_unref, NULL);
+  g_autoptr (GPtrArray) objects
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+
+  checkout_prefetch_collect (pd, pd->dirtree_checksum, seen, objects);
+  _ostree_repo_physical_order_objects (pd->repo, objects);
+
+  guint64 advised_bytes = 0;
+  for (guint i = 0; i < objects->len && advised_bytes < CHECKOUT_PREFETCH_MAX_BYTES; i++)
+    {
+      if (g_atomic_int_get (&pd->stop) || g_cancellable_is_cancelled (pd->cancellable))
+        break;
+
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (objects->pdata[i], &checksum, &objtype);
+
+      char loose_path[_OSTREE_LOOSE_PATH_MAX];
+      _ostree_repo_loose_path (pd->repo, loose_path, checksum, objtype);
+      glnx_autofd int fd
+          = openat (pd->repo->objects_dir_fd, loose_path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+      if (fd < 0 && errno == ENOENT
+          && _ostree_repo_loose_path_alternate (pd->repo, loose_path, checksum, objtype))
+        fd = openat (pd->repo->objects_dir_fd, loose_path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+      if (fd < 0)
+        continue; /* Symlink objects and parent-repo objects; plain files only */
+
+      struct stat stbuf;
+      if (fstat (fd, &stbuf) == 0)
+        advised_bytes += (guint64)stbuf.st_size;
+      (void)posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+    }
+
+  return NULL;
+}
+
 static gboolean
 checkout_tree_at_recurse (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options,
                           CheckoutState *state, int destination_parent_fd,
@@ -1022,18 +1490,21 @@ checkout_tree_at_recurse (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options
 
   if (options->process_whiteouts)
     {
-      g_autoptr (GVariant) dir_file_contents = g_variant_get_child_value (dirtree, 0);
-      GVariantIter viter;
-      const char *fname;
-      g_autoptr (GVariant) contents_csum_v = NULL;
-      g_variant_iter_init (&viter, dir_file_contents);
-      while (g_variant_iter_loop (&viter, "(&s@ay)", &fname, &contents_csum_v))
+      OtDirtreeIter dtiter;
+      if (!_ostree_dirtree_iter_init (&dtiter, dirtree, error))
+        return FALSE;
+      while (TRUE)
         {
+          const char *fname;
+          const guint8 *csum_bytes;
+          if (!_ostree_dirtree_iter_next_file (&dtiter, &fname, &csum_bytes, error))
+            return FALSE;
+          if (fname == NULL)
+            break;
           is_opaque_whiteout = (g_str_equal (fname, OPAQUE_WHITEOUT_NAME));
           if (is_opaque_whiteout)
             break;
         }
-      contents_csum_v = NULL; /* iter_loop freed it */
     }
 
   /* First, make the directory.  Push a new scope in case we end up using
@@ -1110,19 +1581,25 @@ checkout_tree_at_recurse (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options
         return FALSE;
     }
 
-  /* Process files in this subdir */
+  /* Process files in this subdir; the borrowing iterator avoids per-child
+   * GVariant allocations in this hot loop. */
+  OtDirtreeIter dtiter;
+  if (!_ostree_dirtree_iter_init (&dtiter, dirtree, error))
+    return FALSE;
   {
-    g_autoptr (GVariant) dir_file_contents = g_variant_get_child_value (dirtree, 0);
-    GVariantIter viter;
-    g_variant_iter_init (&viter, dir_file_contents);
-    const char *fname;
-    g_autoptr (GVariant) contents_csum_v = NULL;
-    while (g_variant_iter_loop (&viter, "(&s@ay)", &fname, &contents_csum_v))
+    while (TRUE)
       {
+        const char *fname;
+        const guint8 *contents_csum_bytes;
+        if (!_ostree_dirtree_iter_next_file (&dtiter, &fname, &contents_csum_bytes, error))
+          return FALSE;
+        if (fname == NULL)
+          break;
+
         push_path_element (options, state, fname, FALSE);
 
         char tmp_checksum[OSTREE_SHA256_STRING_LEN + 1];
-        _ostree_checksum_inplace_from_bytes_v (contents_csum_v, tmp_checksum);
+        ostree_checksum_inplace_from_bytes (contents_csum_bytes, tmp_checksum);
 
         if (!checkout_one_file_at (self, options, state, tmp_checksum, destination_dfd, fname,
                                    cancellable, error))
@@ -1130,20 +1607,21 @@ checkout_tree_at_recurse (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options
 
         pop_path_element (options, state, fname, FALSE);
       }
-    contents_csum_v = NULL; /* iter_loop freed it */
   }
 
   /* Process subdirectories */
   {
-    g_autoptr (GVariant) dir_subdirs = g_variant_get_child_value (dirtree, 1);
-    const char *dname;
-    g_autoptr (GVariant) subdirtree_csum_v = NULL;
-    g_autoptr (GVariant) subdirmeta_csum_v = NULL;
-    GVariantIter viter;
-    g_variant_iter_init (&viter, dir_subdirs);
-    while (
-        g_variant_iter_loop (&viter, "(&s@ay@ay)", &dname, &subdirtree_csum_v, &subdirmeta_csum_v))
+    while (TRUE)
       {
+        const char *dname;
+        const guint8 *subdirtree_csum_bytes;
+        const guint8 *subdirmeta_csum_bytes;
+        if (!_ostree_dirtree_iter_next_dir (&dtiter, &dname, &subdirtree_csum_bytes,
+                                            &subdirmeta_csum_bytes, error))
+          return FALSE;
+        if (dname == NULL)
+          break;
+
         /* Validate this up front to prevent path traversal attacks. Note that
          * we don't validate at the top of this function like we do for
          * checkout_one_file_at() becuase I believe in some cases this function
@@ -1156,18 +1634,34 @@ checkout_tree_at_recurse (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options
         push_path_element (options, state, dname, TRUE);
 
         char subdirtree_checksum[OSTREE_SHA256_STRING_LEN + 1];
-        _ostree_checksum_inplace_from_bytes_v (subdirtree_csum_v, subdirtree_checksum);
+        ostree_checksum_inplace_from_bytes (subdirtree_csum_bytes, subdirtree_checksum);
         char subdirmeta_checksum[OSTREE_SHA256_STRING_LEN + 1];
-        _ostree_checksum_inplace_from_bytes_v (subdirmeta_csum_v, subdirmeta_checksum);
-        if (!checkout_tree_at_recurse (self, options, state, destination_dfd, dname,
-                                       subdirtree_checksum, subdirmeta_checksum, cancellable,
-                                       error))
+        ostree_checksum_inplace_from_bytes (subdirmeta_csum_bytes, subdirmeta_checksum);
+        if (state->queue != NULL)
+          {
+            if (!checkout_queue_push (state->queue, destination_dfd, dname,
+                                      state->selabel_path_buf ? state->selabel_path_buf->str : NULL,
+                                      subdirtree_checksum, subdirmeta_checksum, error))
+              return FALSE;
+          }
+        else if (!checkout_tree_at_recurse (self, options, state, destination_dfd, dname,
+                                            subdirtree_checksum, subdirmeta_checksum, cancellable,
+                                            error))
           return FALSE;
 
         pop_path_element (options, state, dname, TRUE);
       }
   }
 
+  /* In the parallel case, all children must be complete before we finalize
+   * permissions and timestamps below.
+   */
+  if (state->queue != NULL)
+    {
+      if (!checkout_queue_drain (state->queue, error))
+        return FALSE;
+    }
+
   /* We do fchmod/fchown last so that no one else could access the
    * partially created directory and change content we're laying out.
    */
@@ -1226,6 +1720,13 @@ checkout_tree_at (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options, int de
     0,
   };
 
+  /* Resolve the per-repo-chain flags once for the whole checkout */
+  g_auto (CheckoutPlan) plan = {
+    0,
+  };
+  checkout_plan_init (&plan, self, options);
+  state.plan = &plan;
+
   if (options->filter)
     state.path_buf = g_string_new ("/");
 
@@ -1253,8 +1754,7 @@ checkout_tree_at (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options, int de
     }
 
   /* Uncompressed archive caches; should be considered deprecated */
-  const gboolean can_cache
-      = (options->enable_uncompressed_cache && self->enable_uncompressed_cache);
+  const gboolean can_cache = plan.can_cache;
   if (can_cache && !_ostree_repo_mode_is_bare (self->mode) && self->uncompressed_objects_dir_fd < 0)
     {
       self->uncompressed_objects_dir_fd
@@ -1291,17 +1791,90 @@ checkout_tree_at (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options, int de
                                    error);
     }
 
-  /* Cache any directory metadata we read during this operation;
-   * see commit b7afe91e21143d7abb0adde440683a52712aa246
+  g_assert_cmpint (g_file_info_get_file_type (source_info), ==, G_FILE_TYPE_DIRECTORY);
+
+  /* Set up the work queue for parallel checkouts.  We require all state that
+   * worker threads would share mutably (the filter path buffer, the devino
+   * cache, the uncompressed object cache) to be disabled.  SELinux labeling
+   * is fine: selabel_lookup() is thread-safe against the shared compiled
+   * policy db, the fscreatecon attribute is per-thread, and each dispatched
+   * job owns a private copy of the label path buffer.
    */
-  g_auto (OstreeRepoMemoryCacheRef) memcache_ref;
-  _ostree_repo_memory_cache_ref_init (&memcache_ref, self);
+  g_autoptr (CheckoutWorkQueue) queue = NULL;
+  if (options->checkout_threads > 1 && options->filter == NULL
+      && options->devino_to_csum_cache == NULL && !can_cache)
+    {
+      queue = g_new0 (CheckoutWorkQueue, 1);
+      queue->repo = self;
+      queue->options = options;
+      queue->plan = &plan;
+      queue->cancellable = cancellable;
+      g_mutex_init (&queue->lock);
+      g_cond_init (&queue->cond);
+      queue->pool = ot_thread_pool_new ("checkout", checkout_queue_worker, NULL,
+                                        options->checkout_threads);
+      state.queue = queue;
+    }
 
-  g_assert_cmpint (g_file_info_get_file_type (source_info), ==, G_FILE_TYPE_DIRECTORY);
   const char *dirtree_checksum = ostree_repo_file_tree_get_contents_checksum (source);
   const char *dirmeta_checksum = ostree_repo_file_tree_get_metadata_checksum (source);
-  return checkout_tree_at_recurse (self, options, &state, destination_parent_fd, destination_name,
-                                   dirtree_checksum, dirmeta_checksum, cancellable, error);
+
+  /* Byte progress: size the tree up front (a metadata-only walk), then
+   * publish the running total as files complete.
+   */
+  CheckoutProgress progress_state = {
+    0,
+  };
+  if (options->progress != NULL)
+    {
+      guint64 total_bytes = 0;
+      if (!_ostree_repo_dirtree_content_size (self, dirtree_checksum, &total_bytes, cancellable,
+                                              error))
+        return FALSE;
+
+      progress_state.progress = options->progress;
+      g_mutex_init (&progress_state.lock);
+      ostree_async_progress_set (options->progress, "bytes-total", "t", total_bytes,
+                                 "bytes-written", "t", (guint64)0, "files-written", "t", (guint64)0,
+                                 NULL);
+      state.progress = &progress_state;
+      if (queue != NULL)
+        queue->progress = &progress_state;
+    }
+
+  /* Start the physical-order readahead advisor when the checkout will
+   * actually read object payloads; hardlink checkouts don't.  (Copies can
+   * still happen without force_copy when hardlinking isn't possible, but
+   * then they're the exception rather than the bulk of the I/O.)
+   */
+  CheckoutPrefetchData prefetch_data = {
+    0,
+  };
+  GThread *prefetcher = NULL;
+  if (self->mode == OSTREE_REPO_MODE_ARCHIVE || options->force_copy)
+    {
+      prefetch_data.repo = self;
+      memcpy (prefetch_data.dirtree_checksum, dirtree_checksum, OSTREE_SHA256_STRING_LEN + 1);
+      prefetch_data.cancellable = cancellable;
+      prefetcher = g_thread_new ("co-prefetch", checkout_prefetch_thread, &prefetch_data);
+    }
+
+  gboolean ret
+      = checkout_tree_at_recurse (self, options, &state, destination_parent_fd, destination_name,
+                                  dirtree_checksum, dirmeta_checksum, cancellable, error);
+  if (prefetcher != NULL)
+    {
+      g_atomic_int_set (&prefetch_data.stop, 1);
+      g_thread_join (prefetcher);
+    }
+  /* On error paths workers may still be running and touching the shared
+   * progress state; wait for them before tearing it down.
+   */
+  if (queue != NULL && !checkout_queue_drain (queue, ret ? error : NULL) && ret)
+    ret = FALSE;
+  if (state.progress != NULL)
+    g_mutex_clear (&progress_state.lock);
+  return ret;
 }
 
 static void
@@ -1470,6 +2043,320 @@ ostree_repo_checkout_at (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options,
   return TRUE;
 }
 
+typedef struct
+{
+  OstreeRepoCheckoutAtOptions options;
+  char *subpath;
+  char *sepolicy_prefix;
+  int destination_dfd;
+  char *destination_path;
+  char *commit;
+} CheckoutAtAsyncData;
+
+static void
+checkout_at_async_data_free (gpointer user_data)
+{
+  CheckoutAtAsyncData *data = user_data;
+
+  if (data->options.devino_to_csum_cache)
+    ostree_repo_devino_cache_unref (data->options.devino_to_csum_cache);
+  g_clear_object (&data->options.sepolicy);
+  g_clear_object (&data->options.progress);
+  g_free (data->subpath);
+  g_free (data->sepolicy_prefix);
+  g_free (data->destination_path);
+  g_free (data->commit);
+  g_free (data);
+}
+
+static void
+checkout_at_thread (GTask *task, GObject *object, gpointer datap, GCancellable *cancellable)
+{
+  OstreeRepo *repo = OSTREE_REPO (object);
+  CheckoutAtAsyncData *data = datap;
+  GError *local_error = NULL;
+
+  if (!ostree_repo_checkout_at (repo, &data->options, data->destination_dfd,
+                                data->destination_path, data->commit, cancellable, &local_error))
+    g_task_return_error (task, local_error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * ostree_repo_checkout_at_async:
+ * @self: Repo
+ * @options: (allow-none): Options
+ * @destination_dfd: Directory FD for destination
+ * @destination_path: Directory for destination
+ * @commit: Checksum for commit
+ * @cancellable: Cancellable
+ * @callback: Invoked when the checkout is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronous version of ostree_repo_checkout_at(), performing the
+ * checkout in a worker thread so the caller's main loop keeps running.
+ * To observe progress, set the `progress` member of @options; the
+ * `bytes-total`, `bytes-written` and `files-written` keys are updated
+ * as files complete, and change notifications are emitted in the main
+ * context that created the progress object.  Cancelling @cancellable
+ * takes effect promptly between files.
+ *
+ * Note that if a `filter` is set in @options, it will be invoked on the
+ * worker thread.
+ *
+ * Since: 2023.6
+ */
+void
+ostree_repo_checkout_at_async (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options,
+                               int destination_dfd, const char *destination_path,
+                               const char *commit, GCancellable *cancellable,
+                               GAsyncReadyCallback callback, gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  CheckoutAtAsyncData *data;
+
+  data = g_new0 (CheckoutAtAsyncData, 1);
+  if (options)
+    data->options = *options;
+  /* The caller's options may go out of scope before the worker thread
+   * runs, so own a copy (or a reference) of everything it points at.
+   */
+  data->subpath = g_strdup (data->options.subpath);
+  data->options.subpath = data->subpath;
+  data->sepolicy_prefix = g_strdup (data->options.sepolicy_prefix);
+  data->options.sepolicy_prefix = data->sepolicy_prefix;
+  if (data->options.devino_to_csum_cache)
+    ostree_repo_devino_cache_ref (data->options.devino_to_csum_cache);
+  if (data->options.sepolicy)
+    g_object_ref (data->options.sepolicy);
+  if (data->options.progress)
+    g_object_ref (data->options.progress);
+  data->destination_dfd = destination_dfd;
+  data->destination_path = g_strdup (destination_path);
+  data->commit = g_strdup (commit);
+
+  task = g_task_new (G_OBJECT (self), cancellable, callback, user_data);
+  g_task_set_task_data (task, data, checkout_at_async_data_free);
+  g_task_set_source_tag (task, ostree_repo_checkout_at_async);
+  g_task_run_in_thread (task, (GTaskThreadFunc)checkout_at_thread);
+}
+
+/**
+ * ostree_repo_checkout_at_finish:
+ * @self: Repo
+ * @result: Result
+ * @error: Error
+ *
+ * Complete a call to ostree_repo_checkout_at_async().
+ *
+ * Since: 2023.6
+ */
+gboolean
+ostree_repo_checkout_at_finish (OstreeRepo *self, GAsyncResult *result, GError **error)
+{
+  g_return_val_if_fail (OSTREE_IS_REPO (self), FALSE);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  g_return_val_if_fail (g_async_result_is_tagged (result, ostree_repo_checkout_at_async), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static GLnxFileCopyFlags
+replicate_copy_flags (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options)
+{
+  GLnxFileCopyFlags flags = 0;
+  if (options->mode == OSTREE_REPO_CHECKOUT_MODE_USER || self->disable_xattrs)
+    flags |= GLNX_FILE_COPY_NOXATTRS;
+  if (fsync_is_enabled (self, options))
+    flags |= GLNX_FILE_COPY_DATASYNC;
+  return flags;
+}
+
+/* Re-apply ownership, xattrs, mode and mtime from an already-checked-out
+ * directory onto its replica.  Ordered like the regular checkout path:
+ * permissions are finalized only after the contents are in place.
+ */
+static gboolean
+replicate_dir_meta (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options, int src_dfd,
+                    int dest_dfd, const struct stat *src_stbuf, GCancellable *cancellable,
+                    GError **error)
+{
+  if (options->mode != OSTREE_REPO_CHECKOUT_MODE_USER)
+    {
+      if (TEMP_FAILURE_RETRY (fchown (dest_dfd, src_stbuf->st_uid, src_stbuf->st_gid)) < 0)
+        return glnx_throw_errno_prefix (error, "fchown");
+
+      if (!self->disable_xattrs)
+        {
+          g_autoptr (GVariant) xattrs = NULL;
+          if (!glnx_fd_get_all_xattrs (src_dfd, &xattrs, cancellable, error))
+            return FALSE;
+          if (!glnx_fd_set_all_xattrs (dest_dfd, xattrs, cancellable, error))
+            return FALSE;
+        }
+    }
+
+  if (TEMP_FAILURE_RETRY (fchmod (dest_dfd, src_stbuf->st_mode & ALLPERMS)) < 0)
+    return glnx_throw_errno_prefix (error, "fchmod");
+
+  /* The source checkout already normalized directory mtimes (to
+   * OSTREE_TIMESTAMP, unless copying); just mirror them.
+   */
+  const struct timespec times[2] = { { 0, UTIME_OMIT }, src_stbuf->st_mtim };
+  if (TEMP_FAILURE_RETRY (futimens (dest_dfd, times)) < 0)
+    return glnx_throw_errno (error);
+
+  if (fsync_is_enabled (self, options))
+    {
+      if (fsync (dest_dfd) == -1)
+        return glnx_throw_errno (error);
+    }
+
+  return TRUE;
+}
+
+/* Replicate one directory level of an existing checkout at @src_dfd into
+ * @dest_dfd.  Regular files and symlinks are hardlinked from the source
+ * checkout (or copied when @options->force_copy is set); directories are
+ * recreated and their metadata re-applied from the source.  This
+ * deliberately reads nothing from the repository: the first checkout
+ * already resolved all metadata, so fanning out additional destinations
+ * costs only directory iteration plus linkat()/copy I/O.
+ */
+static gboolean
+checkout_replicate_dir (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options, int src_dfd,
+                        int dest_dfd, GCancellable *cancellable, GError **error)
+{
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (src_dfd, ".", FALSE, &dfd_iter, error))
+    return FALSE;
+
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+
+      if (dent->d_type == DT_DIR)
+        {
+          struct stat stbuf;
+          if (!glnx_fstatat (dfd_iter.fd, dent->d_name, &stbuf, AT_SYMLINK_NOFOLLOW, error))
+            return FALSE;
+
+          /* As in the regular checkout path, create with 0700 first and
+           * only apply the final mode once the contents are in place.
+           */
+          if (TEMP_FAILURE_RETRY (mkdirat (dest_dfd, dent->d_name, 0700)) < 0)
+            return glnx_throw_errno_prefix (error, "mkdirat(%s)", dent->d_name);
+
+          glnx_autofd int src_subdfd = -1;
+          glnx_autofd int dest_subdfd = -1;
+          if (!glnx_opendirat (dfd_iter.fd, dent->d_name, FALSE, &src_subdfd, error))
+            return FALSE;
+          if (!glnx_opendirat (dest_dfd, dent->d_name, FALSE, &dest_subdfd, error))
+            return FALSE;
+
+          if (!checkout_replicate_dir (self, options, src_subdfd, dest_subdfd, cancellable, error))
+            return FALSE;
+
+          if (!replicate_dir_meta (self, options, src_subdfd, dest_subdfd, &stbuf, cancellable,
+                                   error))
+            return FALSE;
+        }
+      else if (!options->force_copy)
+        {
+          if (linkat (dfd_iter.fd, dent->d_name, dest_dfd, dent->d_name, 0) < 0)
+            {
+              if (options->no_copy_fallback
+                  || (errno != EMLINK && errno != EXDEV && errno != EPERM))
+                return glnx_throw_errno_prefix (error, "linkat(%s)", dent->d_name);
+              if (!glnx_file_copy_at (dfd_iter.fd, dent->d_name, NULL, dest_dfd, dent->d_name,
+                                      replicate_copy_flags (self, options), cancellable, error))
+                return FALSE;
+            }
+        }
+      else
+        {
+          if (!glnx_file_copy_at (dfd_iter.fd, dent->d_name, NULL, dest_dfd, dent->d_name,
+                                  replicate_copy_flags (self, options), cancellable, error))
+            return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+/* Check out @commit once into the first element of @destination_paths, then
+ * fan the result out to each remaining destination by walking the completed
+ * checkout: files are hardlinked (or copied under force_copy), directory
+ * metadata is mirrored.  Resolving the commit's metadata, devino lookups and
+ * any SELinux label computation thus happen once no matter how many roots
+ * are provisioned.  Replica destinations must not already exist; the union
+ * overwrite modes only apply to the first checkout.
+ */
+gboolean
+_ostree_repo_checkout_at_fanout (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options,
+                                 int destination_dfd, const char *const *destination_paths,
+                                 const char *commit, GCancellable *cancellable, GError **error)
+{
+  g_assert (destination_paths != NULL && destination_paths[0] != NULL);
+
+  OstreeRepoCheckoutAtOptions default_options = {
+    0,
+  };
+  if (!options)
+    options = &default_options;
+
+  if (!ostree_repo_checkout_at (self, options, destination_dfd, destination_paths[0], commit,
+                                cancellable, error))
+    return FALSE;
+
+  if (destination_paths[1] == NULL)
+    return TRUE;
+
+  /* Canonicalize a copy so the mode checks during replication match what
+   * the first checkout actually did (e.g. bare-user-only forcing USER).
+   */
+  OstreeRepoCheckoutAtOptions real_options = *options;
+  options = &real_options;
+  canonicalize_options (self, options);
+
+  glnx_autofd int src_dfd = -1;
+  if (!glnx_opendirat (destination_dfd, destination_paths[0], TRUE, &src_dfd, error))
+    return FALSE;
+
+  struct stat src_stbuf;
+  if (!glnx_fstat (src_dfd, &src_stbuf, error))
+    return FALSE;
+
+  for (guint i = 1; destination_paths[i] != NULL; i++)
+    {
+      const char *dest = destination_paths[i];
+
+      if (TEMP_FAILURE_RETRY (mkdirat (destination_dfd, dest, 0700)) < 0)
+        return glnx_throw_errno_prefix (error, "mkdirat(%s)", dest);
+
+      glnx_autofd int dest_dfd = -1;
+      if (!glnx_opendirat (destination_dfd, dest, TRUE, &dest_dfd, error))
+        return FALSE;
+
+      if (!checkout_replicate_dir (self, options, src_dfd, dest_dfd, cancellable, error))
+        return glnx_prefix_error (error, "Replicating checkout to %s", dest);
+
+      if (!replicate_dir_meta (self, options, src_dfd, dest_dfd, &src_stbuf, cancellable, error))
+        return glnx_prefix_error (error, "Replicating checkout to %s", dest);
+    }
+
+  return TRUE;
+}
+
 /**
  * ostree_repo_checkout_at_options_set_devino:
  * @opts: Checkout options
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gio/gunixinputstream.h>
+#include <string.h>
+
+#include "bupsplit.h"
+#include "ostree-core-private.h"
+#include "ostree-repo-private.h"
+#include "otutil.h"
+
+/* Chunked storage for large content objects in archive repositories
+ *
+ * Archive repositories store every content object as a whole gzip'd loose
+ * file, so near-identical large files - successive kernels, initramfs
+ * images, firmware blobs - share no storage at all.  Chunking splits the
+ * uncompressed content of a large object at content-defined boundaries
+ * (the same bupsplit rolling checksum used by ostree-rollsum.c for delta
+ * generation) and stores each piece content addressed, so identical runs
+ * of bytes across objects collapse to a single copy on disk.
+ *
+ * Everything lives under objects/chunk/, fanned out like loose objects:
+ *
+ *   <prefix>/<rest>.chunk  - raw (uncompressed) chunk bytes, named by the
+ *                            SHA256 of those bytes
+ *   <prefix>/<rest>.recipe - per-object reassembly recipe, named by the
+ *                            object checksum: a GVariant of type
+ *                            (uayta(ayt)) holding a format version, the
+ *                            serialized file header (uid/gid/mode/xattrs),
+ *                            the content size, and the ordered list of
+ *                            (chunk checksum, chunk length) pairs
+ *
+ * The loose .filez is deleted once the recipe is in place; reads
+ * reconstitute the object stream transparently from the recipe, so the
+ * object checksum still verifies end to end (fsck re-hashes the
+ * reassembled stream).  Like pack files, chunked objects are not prune
+ * candidates and cannot be served as loose HTTP URLs; `ostree chunk` is
+ * intended for locally accessed repositories.  Chunks orphaned by deleted
+ * recipes are not garbage collected.
+ */
+
+#define CHUNK_RECIPE_VERSION 1
+
+/* bupsplit emits a boundary roughly every 2^BUP_BLOBBITS (8KiB) bytes;
+ * we only accept boundaries where the rolling checksum matches
+ * CHUNK_TARGET_BITS bits, giving ~256KiB average chunks so the chunk
+ * store doesn't explode into tiny files, and cap outliers at 4MiB.
+ */
+#define CHUNK_TARGET_BITS 18
+#define CHUNK_MAX_SIZE (4 * 1024 * 1024)
+
+static char *
+chunk_object_path (const char *checksum, const char *suffix)
+{
+  return g_strdup_printf (_OSTREE_CHUNK_DIR "/%c%c/%s%s", checksum[0], checksum[1], checksum + 2,
+                          suffix);
+}
+
+/* Find the length of the next chunk in @buf; always in (0, CHUNK_MAX_SIZE].
+ * bupsplit restarts its (64 byte) rolling window at every boundary it
+ * reports, so accepting only high-bit boundaries still yields stable,
+ * shift-resistant split points.
+ */
+static guint64
+chunk_next_boundary (const guint8 *buf, guint64 remaining)
+{
+  guint64 pos = 0;
+
+  while (pos < remaining && pos < CHUNK_MAX_SIZE)
+    {
+      int bits = 0;
+      int offset = bupsplit_find_ofs (buf + pos, MIN (remaining - pos, (guint64)G_MAXINT32), &bits);
+      if (offset == 0)
+        break;
+      pos += offset;
+      if (bits >= CHUNK_TARGET_BITS)
+        return MIN (pos, CHUNK_MAX_SIZE);
+    }
+
+  return MIN (remaining, CHUNK_MAX_SIZE);
+}
+
+/* Write the chunk @buf of @len bytes into the chunk store, if an identical
+ * chunk isn't stored already, and format its checksum into @chunk_checksum.
+ */
+static gboolean
+chunk_store_one (OstreeRepo *self, const guint8 *buf, guint64 len,
+                 char chunk_checksum[OSTREE_SHA256_STRING_LEN + 1], GCancellable *cancellable,
+                 GError **error)
+{
+  g_autoptr (GBytes) bytes = g_bytes_new_static (buf, len);
+  guint8 digest[_OSTREE_SHA256_DIGEST_LEN];
+  ot_checksum_bytes (bytes, digest);
+  ostree_checksum_inplace_from_bytes (digest, chunk_checksum);
+
+  g_autofree char *chunk_path = chunk_object_path (chunk_checksum, ".chunk");
+
+  struct stat stbuf;
+  if (!glnx_fstatat_allow_noent (self->objects_dir_fd, chunk_path, &stbuf, 0, error))
+    return FALSE;
+  if (errno != ENOENT)
+    return TRUE; /* Deduplicated against an existing chunk */
+
+  g_autofree char *fanout_dir
+      = g_strdup_printf (_OSTREE_CHUNK_DIR "/%c%c", chunk_checksum[0], chunk_checksum[1]);
+  if (!glnx_shutil_mkdir_p_at (self->objects_dir_fd, fanout_dir, DEFAULT_DIRECTORY_MODE,
+                               cancellable, error))
+    return FALSE;
+
+  if (!glnx_file_replace_contents_at (self->objects_dir_fd, chunk_path, buf, len,
+                                      self->disable_fsync ? GLNX_FILE_REPLACE_NODATASYNC
+                                                          : GLNX_FILE_REPLACE_DATASYNC_NEW,
+                                      cancellable, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Convert the given loose FILE objects (an array of serialized object names)
+ * into chunked form, skipping non-regular files and content smaller than
+ * @min_size.  Chunks are made durable before the recipe that references
+ * them, and the loose copy is only deleted once the recipe is in place, so
+ * a crash can at worst leave orphaned chunks.
+ */
+gboolean
+_ostree_repo_chunked_create (OstreeRepo *self, GPtrArray *objects, guint64 min_size,
+                             guint *out_n_chunked, GCancellable *cancellable, GError **error)
+{
+  g_assert (self->mode == OSTREE_REPO_MODE_ARCHIVE);
+
+  guint n_chunked = 0;
+
+  for (guint i = 0; i < objects->len; i++)
+    {
+      GVariant *serialized_key = objects->pdata[i];
+      const char *checksum;
+      OstreeObjectType objtype;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+
+      ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+      if (objtype != OSTREE_OBJECT_TYPE_FILE)
+        continue;
+
+      char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
+      _ostree_repo_loose_path (self, loose_path_buf, checksum, objtype);
+
+      glnx_autofd int fd = -1;
+      if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
+        return FALSE;
+      if (fd < 0 && _ostree_repo_loose_path_alternate (self, loose_path_buf, checksum, objtype))
+        {
+          if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
+            return FALSE;
+        }
+      if (fd < 0)
+        continue; /* Raced with e.g. a prune; just skip it */
+
+      struct stat stbuf;
+      if (!glnx_fstat (fd, &stbuf, error))
+        return FALSE;
+
+      g_autoptr (GInputStream) loose_stream = g_unix_input_stream_new (g_steal_fd (&fd), TRUE);
+      g_autoptr (GInputStream) content_in = NULL;
+      g_autoptr (GFileInfo) file_info = NULL;
+      g_autoptr (GVariant) xattrs = NULL;
+      if (!ostree_content_stream_parse (TRUE, loose_stream, stbuf.st_size, TRUE, &content_in,
+                                        &file_info, &xattrs, cancellable, error))
+        return glnx_prefix_error (error, "Parsing object %s", checksum);
+
+      /* Symlinks are tiny; only regular file content is worth chunking */
+      if (g_file_info_get_file_type (file_info) != G_FILE_TYPE_REGULAR)
+        continue;
+
+      guint64 content_size = g_file_info_get_size (file_info);
+      if (content_size < min_size)
+        continue;
+
+      /* The rolling checksum needs to see the content as one buffer; the
+       * caller restricts this path to large-but-bounded objects (kernels,
+       * initramfs images), so buffering the uncompressed content is fine.
+       */
+      g_autofree guint8 *content = g_malloc (content_size);
+      gsize bytes_read;
+      if (!g_input_stream_read_all (content_in, content, content_size, &bytes_read, cancellable,
+                                    error))
+        return FALSE;
+      if (bytes_read != content_size)
+        return glnx_throw (error, "Object %s: expected %" G_GUINT64_FORMAT " content bytes, got %"
+                           G_GSIZE_FORMAT, checksum, content_size, bytes_read);
+
+      g_autoptr (GVariantBuilder) chunks_builder
+          = g_variant_builder_new (G_VARIANT_TYPE ("a(ayt)"));
+      guint64 pos = 0;
+      while (pos < content_size)
+        {
+          guint64 chunk_len = chunk_next_boundary (content + pos, content_size - pos);
+
+          char chunk_checksum[OSTREE_SHA256_STRING_LEN + 1];
+          if (!chunk_store_one (self, content + pos, chunk_len, chunk_checksum, cancellable,
+                                error))
+            return FALSE;
+
+          guint8 chunk_digest[_OSTREE_SHA256_DIGEST_LEN];
+          ostree_checksum_inplace_to_bytes (chunk_checksum, chunk_digest);
+          g_variant_builder_add (chunks_builder, "(@ayt)",
+                                 ot_gvariant_new_bytearray (chunk_digest,
+                                                            _OSTREE_SHA256_DIGEST_LEN),
+                                 chunk_len);
+          pos += chunk_len;
+        }
+
+      /* The recipe stores the uncompressed-format file header, so reads can
+       * reassemble the canonical object stream that checksums are computed
+       * over without re-deriving it.
+       */
+      g_autoptr (GBytes) header = _ostree_file_header_new (file_info, xattrs);
+      g_autoptr (GVariant) recipe = g_variant_ref_sink (g_variant_new (
+          "(u@ayta(ayt))", (guint32)CHUNK_RECIPE_VERSION,
+          ot_gvariant_new_bytearray (g_bytes_get_data (header, NULL), g_bytes_get_size (header)),
+          content_size, chunks_builder));
+
+      g_autofree char *recipe_path = chunk_object_path (checksum, ".recipe");
+      g_autofree char *fanout_dir
+          = g_strdup_printf (_OSTREE_CHUNK_DIR "/%c%c", checksum[0], checksum[1]);
+      if (!glnx_shutil_mkdir_p_at (self->objects_dir_fd, fanout_dir, DEFAULT_DIRECTORY_MODE,
+                                   cancellable, error))
+        return FALSE;
+      if (!glnx_file_replace_contents_at (self->objects_dir_fd, recipe_path,
+                                          g_variant_get_data (recipe),
+                                          g_variant_get_size (recipe),
+                                          self->disable_fsync ? GLNX_FILE_REPLACE_NODATASYNC
+                                                              : GLNX_FILE_REPLACE_DATASYNC_NEW,
+                                          cancellable, error))
+        return FALSE;
+
+      /* Now that the recipe is in place, the loose copy is redundant */
+      if (!ot_ensure_unlinked_at (self->objects_dir_fd, loose_path_buf, error))
+        return FALSE;
+
+      n_chunked++;
+    }
+
+  if (out_n_chunked)
+    *out_n_chunked = n_chunked;
+  return TRUE;
+}
+
+/* Check whether a chunk recipe exists for the FILE object @checksum. */
+gboolean
+_ostree_repo_chunked_has_object (OstreeRepo *self, const char *checksum, gboolean *out_found,
+                                 GError **error)
+{
+  *out_found = FALSE;
+
+  if (self->mode != OSTREE_REPO_MODE_ARCHIVE)
+    return TRUE;
+
+  g_autofree char *recipe_path = chunk_object_path (checksum, ".recipe");
+  struct stat stbuf;
+  if (!glnx_fstatat_allow_noent (self->objects_dir_fd, recipe_path, &stbuf, 0, error))
+    return FALSE;
+  *out_found = (errno != ENOENT);
+  return TRUE;
+}
+
+/* Look up the FILE object @checksum in the chunk store; if a recipe exists,
+ * reassemble the object stream from its chunks and parse it like the loose
+ * path would, setting @out_found.  The chunks are mmap'ed, so reassembly
+ * copies no content bytes.
+ */
+gboolean
+_ostree_repo_chunked_load (OstreeRepo *self, const char *checksum, gboolean *out_found,
+                           GInputStream **out_input, GFileInfo **out_file_info,
+                           GVariant **out_xattrs, GCancellable *cancellable, GError **error)
+{
+  *out_found = FALSE;
+
+  if (self->mode != OSTREE_REPO_MODE_ARCHIVE)
+    return TRUE;
+
+  g_autofree char *recipe_path = chunk_object_path (checksum, ".recipe");
+  glnx_autofd int recipe_fd = -1;
+  if (!ot_openat_ignore_enoent (self->objects_dir_fd, recipe_path, &recipe_fd, error))
+    return FALSE;
+  if (recipe_fd < 0)
+    return TRUE;
+
+  g_autoptr (GVariant) recipe = NULL;
+  if (!ot_variant_read_fd (recipe_fd, 0, G_VARIANT_TYPE ("(uayta(ayt))"), FALSE, &recipe, error))
+    return glnx_prefix_error (error, "Reading chunk recipe for %s", checksum);
+
+  guint32 version;
+  g_variant_get_child (recipe, 0, "u", &version);
+  if (version != CHUNK_RECIPE_VERSION)
+    return glnx_throw (error, "Unsupported chunk recipe version %u for %s", version, checksum);
+
+  g_autoptr (GVariant) header_v = g_variant_get_child_value (recipe, 1);
+  g_autoptr (GBytes) header = g_variant_get_data_as_bytes (header_v);
+  guint64 content_size;
+  g_variant_get_child (recipe, 2, "t", &content_size);
+  g_autoptr (GVariant) chunks = g_variant_get_child_value (recipe, 3);
+
+  g_autoptr (GInputStream) stream = g_memory_input_stream_new ();
+  g_memory_input_stream_add_bytes ((GMemoryInputStream *)stream, header);
+
+  guint64 total = 0;
+  gsize n_chunks = g_variant_n_children (chunks);
+  for (gsize i = 0; i < n_chunks; i++)
+    {
+      g_autoptr (GVariant) csum_v = NULL;
+      guint64 chunk_len;
+      g_variant_get_child (chunks, i, "(@ayt)", &csum_v, &chunk_len);
+
+      gsize csum_len;
+      const guchar *csum = g_variant_get_fixed_array (csum_v, &csum_len, 1);
+      if (csum_len != OSTREE_SHA256_DIGEST_LEN)
+        return glnx_throw (error, "Corrupt chunk recipe for %s: invalid chunk checksum", checksum);
+
+      char chunk_checksum[OSTREE_SHA256_STRING_LEN + 1];
+      ostree_checksum_inplace_from_bytes (csum, chunk_checksum);
+
+      g_autofree char *chunk_path = chunk_object_path (chunk_checksum, ".chunk");
+      glnx_autofd int chunk_fd = -1;
+      if (!glnx_openat_rdonly (self->objects_dir_fd, chunk_path, FALSE, &chunk_fd, error))
+        return glnx_prefix_error (error, "Loading chunk %s of %s", chunk_checksum, checksum);
+
+      g_autoptr (GMappedFile) mfile = g_mapped_file_new_from_fd (chunk_fd, FALSE, error);
+      if (!mfile)
+        return glnx_prefix_error (error, "Mapping chunk %s", chunk_checksum);
+
+      g_autoptr (GBytes) chunk_bytes = g_mapped_file_get_bytes (mfile);
+      if (g_bytes_get_size (chunk_bytes) != chunk_len)
+        return glnx_throw (error, "Chunk %s: expected %" G_GUINT64_FORMAT " bytes, got %"
+                           G_GSIZE_FORMAT, chunk_checksum, chunk_len,
+                           g_bytes_get_size (chunk_bytes));
+
+      g_memory_input_stream_add_bytes ((GMemoryInputStream *)stream, chunk_bytes);
+      total += chunk_len;
+    }
+
+  if (total != content_size)
+    return glnx_throw (error, "Corrupt chunk recipe for %s: chunks total %" G_GUINT64_FORMAT
+                       " bytes, expected %" G_GUINT64_FORMAT, checksum, total, content_size);
+
+  *out_found = TRUE;
+  return ostree_content_stream_parse (FALSE, stream, g_bytes_get_size (header) + total, TRUE,
+                                      out_input, out_file_info, out_xattrs, cancellable, error);
+}
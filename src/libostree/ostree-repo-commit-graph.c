@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "ostree-core-private.h"
+#include "ostree-repo-private.h"
+#include "otutil.h"
+
+/* Commit-graph cache
+ *
+ * Walking commit ancestry — `ostree log`, depth-limited pulls, prune's
+ * --commit-only traversal — loads each commit object just to read its parent
+ * pointer and timestamp.  The commit-graph file at objects/commit-graph
+ * caches exactly those two fields: a GVariant of type (ua(ayayt)) holding a
+ * format version, then an array of (checksum, parent-checksum, timestamp)
+ * rows sorted by checksum for binary search.  The parent is the empty byte
+ * array for commits without one; timestamps are big-endian.
+ *
+ * The graph is maintained incrementally: every transaction that writes
+ * commit objects folds their rows in at commit time, so it self-populates as
+ * a repository is used.  It is strictly a cache — lookups fall back to
+ * loading the object on a miss, and since the fields of a commit are
+ * immutable for its checksum, entries can only go stale by referring to a
+ * commit that was since pruned; callers that care check object existence
+ * first.
+ */
+
+#define COMMIT_GRAPH_VERSION 1
+
+void
+_ostree_repo_commit_graph_clear (OstreeRepo *self)
+{
+  g_clear_pointer (&self->commit_graph, g_variant_unref);
+  self->commit_graph_initialized = FALSE;
+}
+
+/* Get a reference to the commit-graph, lazily loading it; sets @out_graph to
+ * %NULL (without error) if the repository has none.
+ */
+static gboolean
+commit_graph_get (OstreeRepo *self, GVariant **out_graph, GError **error)
+{
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&self->commit_graph_lock);
+  if (!self->commit_graph_initialized)
+    {
+      glnx_autofd int fd = -1;
+      if (!ot_openat_ignore_enoent (self->objects_dir_fd, _OSTREE_COMMIT_GRAPH_PATH, &fd, error))
+        goto out;
+      if (fd != -1)
+        {
+          g_autoptr (GVariant) graph = NULL;
+          if (!ot_variant_read_fd (fd, 0, G_VARIANT_TYPE (OSTREE_COMMIT_GRAPH_GVARIANT_STRING),
+                                   FALSE, &graph, error))
+            {
+              glnx_prefix_error (error, "Reading commit-graph");
+              goto out;
+            }
+
+          guint32 version;
+          g_variant_get_child (graph, 0, "u", &version);
+          if (version != COMMIT_GRAPH_VERSION)
+            {
+              glnx_throw (error, "Unsupported commit-graph version %u", version);
+              goto out;
+            }
+
+          self->commit_graph = g_steal_pointer (&graph);
+        }
+      self->commit_graph_initialized = TRUE;
+    }
+
+  *out_graph = self->commit_graph ? g_variant_ref (self->commit_graph) : NULL;
+  ret = TRUE;
+out:
+  g_mutex_unlock (&self->commit_graph_lock);
+  return ret;
+}
+
+/* Binary search the commit-graph for @checksum.  On a hit, @out_found is
+ * %TRUE, @out_parent holds the parent checksum (or %NULL for a parentless
+ * commit) and @out_timestamp the commit timestamp; on a miss @out_found is
+ * %FALSE without error and the caller should load the object instead.
+ */
+gboolean
+_ostree_repo_commit_graph_lookup (OstreeRepo *self, const char *checksum, gboolean *out_found,
+                                  char **out_parent, guint64 *out_timestamp, GError **error)
+{
+  *out_found = FALSE;
+
+  g_autoptr (GVariant) graph = NULL;
+  if (!commit_graph_get (self, &graph, error))
+    return FALSE;
+  if (graph == NULL)
+    return TRUE;
+
+  guchar csum[OSTREE_SHA256_DIGEST_LEN];
+  ostree_checksum_inplace_to_bytes (checksum, csum);
+
+  g_autoptr (GVariant) entries = g_variant_get_child_value (graph, 1);
+  gsize imin = 0;
+  gsize imax = g_variant_n_children (entries);
+
+  while (imin < imax)
+    {
+      gsize imid = imin + (imax - imin) / 2;
+      g_autoptr (GVariant) entry = g_variant_get_child_value (entries, imid);
+      g_autoptr (GVariant) csum_v = g_variant_get_child_value (entry, 0);
+
+      gsize csum_len;
+      const guchar *entry_csum = g_variant_get_fixed_array (csum_v, &csum_len, 1);
+      if (csum_len != OSTREE_SHA256_DIGEST_LEN)
+        return TRUE; /* Corrupt entry; treat as a miss */
+
+      int c = memcmp (entry_csum, csum, OSTREE_SHA256_DIGEST_LEN);
+      if (c == 0)
+        {
+          if (out_parent != NULL)
+            {
+              g_autoptr (GVariant) parent_v = g_variant_get_child_value (entry, 1);
+              gsize parent_len;
+              const guchar *parent_csum = g_variant_get_fixed_array (parent_v, &parent_len, 1);
+              if (parent_len == OSTREE_SHA256_DIGEST_LEN)
+                *out_parent = ostree_checksum_from_bytes (parent_csum);
+              else
+                *out_parent = NULL;
+            }
+          if (out_timestamp != NULL)
+            {
+              guint64 ts;
+              g_variant_get_child (entry, 2, "t", &ts);
+              *out_timestamp = GUINT64_FROM_BE (ts);
+            }
+          *out_found = TRUE;
+          return TRUE;
+        }
+
+      if (c < 0)
+        imin = imid + 1;
+      else
+        imax = imid;
+    }
+
+  return TRUE;
+}
+
+static int
+commit_graph_entry_compare (gconstpointer ap, gconstpointer bp)
+{
+  const OstreeRepoCommitGraphEntry *a = ap;
+  const OstreeRepoCommitGraphEntry *b = bp;
+  return memcmp (a->checksum, b->checksum, OSTREE_SHA256_DIGEST_LEN);
+}
+
+/* Fold the rows for newly written commits into the commit-graph, creating it
+ * if necessary, and atomically replace it.  Called from
+ * ostree_repo_commit_transaction() after the objects have been moved into
+ * place.
+ */
+gboolean
+_ostree_repo_commit_graph_append (OstreeRepo *self,
+                                  GPtrArray *new_entries, /* (element-type
+                                                             OstreeRepoCommitGraphEntry) */
+                                  GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GVariant) graph = NULL;
+  if (!commit_graph_get (self, &graph, error))
+    return FALSE;
+
+  g_autoptr (GArray) merged = g_array_new (FALSE, FALSE, sizeof (OstreeRepoCommitGraphEntry));
+  g_autoptr (GHashTable) new_checksums = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (guint i = 0; i < new_entries->len; i++)
+    {
+      OstreeRepoCommitGraphEntry *entry = new_entries->pdata[i];
+      char *hexname = ostree_checksum_from_bytes (entry->checksum);
+      /* A transaction may write the same commit twice; first one wins */
+      if (!g_hash_table_replace (new_checksums, hexname, NULL))
+        continue;
+      g_array_append_vals (merged, entry, 1);
+    }
+
+  if (graph != NULL)
+    {
+      g_autoptr (GVariant) entries = g_variant_get_child_value (graph, 1);
+      gsize n = g_variant_n_children (entries);
+      for (gsize i = 0; i < n; i++)
+        {
+          g_autoptr (GVariant) entry_v = g_variant_get_child_value (entries, i);
+          g_autoptr (GVariant) csum_v = g_variant_get_child_value (entry_v, 0);
+          g_autoptr (GVariant) parent_v = g_variant_get_child_value (entry_v, 1);
+
+          gsize csum_len, parent_len;
+          const guchar *entry_csum = g_variant_get_fixed_array (csum_v, &csum_len, 1);
+          const guchar *parent_csum = g_variant_get_fixed_array (parent_v, &parent_len, 1);
+          if (csum_len != OSTREE_SHA256_DIGEST_LEN)
+            continue; /* Drop corrupt entries on rewrite */
+
+          g_autofree char *hexname = ostree_checksum_from_bytes (entry_csum);
+          if (g_hash_table_contains (new_checksums, hexname))
+            continue;
+
+          OstreeRepoCommitGraphEntry entry = {
+            0,
+          };
+          memcpy (entry.checksum, entry_csum, OSTREE_SHA256_DIGEST_LEN);
+          if (parent_len == OSTREE_SHA256_DIGEST_LEN)
+            {
+              entry.has_parent = TRUE;
+              memcpy (entry.parent, parent_csum, OSTREE_SHA256_DIGEST_LEN);
+            }
+          guint64 ts;
+          g_variant_get_child (entry_v, 2, "t", &ts);
+          entry.timestamp = GUINT64_FROM_BE (ts);
+          g_array_append_val (merged, entry);
+        }
+    }
+
+  g_array_sort (merged, commit_graph_entry_compare);
+
+  g_autoptr (GVariantBuilder) builder = g_variant_builder_new (G_VARIANT_TYPE ("a(ayayt)"));
+  for (guint i = 0; i < merged->len; i++)
+    {
+      OstreeRepoCommitGraphEntry *entry = &g_array_index (merged, OstreeRepoCommitGraphEntry, i);
+      g_variant_builder_add (
+          builder, "(@ay@ayt)",
+          ot_gvariant_new_bytearray (entry->checksum, OSTREE_SHA256_DIGEST_LEN),
+          ot_gvariant_new_bytearray (entry->parent, entry->has_parent ? OSTREE_SHA256_DIGEST_LEN : 0),
+          GUINT64_TO_BE (entry->timestamp));
+    }
+
+  g_autoptr (GVariant) new_graph = g_variant_ref_sink (
+      g_variant_new (OSTREE_COMMIT_GRAPH_GVARIANT_STRING, (guint32)COMMIT_GRAPH_VERSION, builder));
+  if (!_ostree_repo_file_replace_contents (self, self->objects_dir_fd, _OSTREE_COMMIT_GRAPH_PATH,
+                                           g_variant_get_data (new_graph),
+                                           g_variant_get_size (new_graph), cancellable, error))
+    return FALSE;
+
+  g_mutex_lock (&self->commit_graph_lock);
+  _ostree_repo_commit_graph_clear (self);
+  g_mutex_unlock (&self->commit_graph_lock);
+  return TRUE;
+}
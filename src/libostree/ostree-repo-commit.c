@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include <ext2fs/ext2_fs.h>
+#include <fnmatch.h>
 #include <gio/gfiledescriptorbased.h>
 #include <gio/gunixinputstream.h>
 #include <gio/gunixoutputstream.h>
@@ -64,18 +65,147 @@
  * option that again invokes `fsync()` directly.  This also notably
  * provides "backpressure", ensuring we aren't queuing up a huge amount
  * of I/O at once.
+ *
+ * The delayed barrier itself also comes in two flavors (the `fsync-barrier`
+ * config option): the default `syncfs()` of the staging filesystem, or a
+ * "batch" mode that fsyncs just the staged object files as they're renamed
+ * into place, which avoids flushing unrelated dirty data on a shared
+ * filesystem.
+ */
+
+#ifdef HAVE_LIBURING
+/* Batched object fsync engine backed by io_uring; see the `core.io-uring`
+ * config option.  Rather than a blocking fsync() per object in
+ * per-object-fsync mode, we queue fsyncs onto a submission ring and only
+ * reap completions at batch boundaries, and fully drain before the
+ * transaction updates refs.  This keeps the per-object backpressure
+ * property while collapsing most of the syscall overhead.
  */
+#include <liburing.h>
+
+#define URING_FSYNC_QUEUE_DEPTH 64
+
+struct OstreeRepoUringFsync
+{
+  struct io_uring ring;
+  guint inflight;
+};
+
+static gboolean
+uring_fsync_reap (OstreeRepoUringFsync *uring_fsync, gboolean wait_all, GError **error)
+{
+  gboolean ret = TRUE;
+  while (uring_fsync->inflight > 0)
+    {
+      struct io_uring_cqe *cqe;
+      int r;
+      if (wait_all)
+        r = io_uring_wait_cqe (&uring_fsync->ring, &cqe);
+      else
+        {
+          r = io_uring_peek_cqe (&uring_fsync->ring, &cqe);
+          if (r == -EAGAIN)
+            break;
+        }
+      if (r < 0)
+        return glnx_throw_errno_prefix (error, "io_uring_wait_cqe: %s", g_strerror (-r));
+
+      int fd = (int)(intptr_t)io_uring_cqe_get_data (cqe);
+      if (cqe->res < 0 && ret)
+        {
+          ret = glnx_throw_errno_prefix (error, "io_uring fsync: %s", g_strerror (-cqe->res));
+          /* Keep reaping so we don't leak fds, but remember the error */
+          wait_all = TRUE;
+        }
+      (void)close (fd);
+      io_uring_cqe_seen (&uring_fsync->ring, cqe);
+      uring_fsync->inflight--;
+    }
+  return ret;
+}
+
+void
+_ostree_repo_uring_fsync_free (OstreeRepoUringFsync *uring_fsync)
+{
+  (void)io_uring_submit (&uring_fsync->ring);
+  (void)uring_fsync_reap (uring_fsync, TRUE, NULL);
+  io_uring_queue_exit (&uring_fsync->ring);
+  g_free (uring_fsync);
+}
+
+/* Queue an fsync of @fd; the engine owns a dup() for the lifetime of the
+ * request, so the caller is free to close or rename it immediately.
+ */
+static gboolean
+uring_fsync_queue (OstreeRepo *self, int fd, GError **error)
+{
+  if (self->uring_fsync == NULL)
+    {
+      OstreeRepoUringFsync *uring_fsync = g_new0 (OstreeRepoUringFsync, 1);
+      int r = io_uring_queue_init (URING_FSYNC_QUEUE_DEPTH, &uring_fsync->ring, 0);
+      if (r < 0)
+        {
+          g_free (uring_fsync);
+          return glnx_throw_errno_prefix (error, "io_uring_queue_init: %s", g_strerror (-r));
+        }
+      self->uring_fsync = uring_fsync;
+    }
+  OstreeRepoUringFsync *uring_fsync = self->uring_fsync;
+
+  int fd_copy = dup (fd);
+  if (fd_copy < 0)
+    return glnx_throw_errno_prefix (error, "dup");
+
+  struct io_uring_sqe *sqe = io_uring_get_sqe (&uring_fsync->ring);
+  if (sqe == NULL)
+    {
+      /* The ring is full; kick it and reap what's already done */
+      (void)io_uring_submit (&uring_fsync->ring);
+      if (!uring_fsync_reap (uring_fsync, TRUE, error))
+        {
+          (void)close (fd_copy);
+          return FALSE;
+        }
+      sqe = io_uring_get_sqe (&uring_fsync->ring);
+      g_assert (sqe != NULL);
+    }
+  io_uring_prep_fsync (sqe, fd_copy, 0);
+  io_uring_sqe_set_data (sqe, (void *)(intptr_t)fd_copy);
+  uring_fsync->inflight++;
+
+  /* Submit in batches rather than per-object */
+  if (uring_fsync->inflight % (URING_FSYNC_QUEUE_DEPTH / 2) == 0)
+    (void)io_uring_submit (&uring_fsync->ring);
+  return TRUE;
+}
+
+/* Wait for all queued fsyncs to complete. */
+static gboolean
+uring_fsync_drain (OstreeRepo *self, GError **error)
+{
+  if (self->uring_fsync == NULL)
+    return TRUE;
+  (void)io_uring_submit (&self->uring_fsync->ring);
+  return uring_fsync_reap (self->uring_fsync, TRUE, error);
+}
+#else /* HAVE_LIBURING */
+void
+_ostree_repo_uring_fsync_free (OstreeRepoUringFsync *uring_fsync)
+{
+  g_assert (uring_fsync == NULL);
+}
+#endif
 
 /* The directory where we place content */
 static int
-commit_dest_dfd (OstreeRepo *self)
+commit_dest_dfd (OstreeRepo *self, OstreeObjectType objtype)
 {
   if (self->per_object_fsync)
-    return self->objects_dir_fd;
+    return _ostree_repo_objects_dir_fd_for_objtype (self, objtype);
   else if (self->in_transaction && !self->disable_fsync)
     return self->commit_stagedir.fd;
   else
-    return self->objects_dir_fd;
+    return _ostree_repo_objects_dir_fd_for_objtype (self, objtype);
 }
 
 /* If we don't have O_TMPFILE, or for symlinks we'll create temporary
@@ -100,17 +230,23 @@ gboolean
 _ostree_repo_ensure_loose_objdir_at (int dfd, const char *loose_path, GCancellable *cancellable,
                                      GError **error)
 {
-  char loose_prefix[3];
+  /* The fanout may be one or two directory levels deep (see the deep-fanout
+   * config option); create every leading component of @loose_path. */
+  char loose_prefix[_OSTREE_LOOSE_PATH_MAX];
 
-  loose_prefix[0] = loose_path[0];
-  loose_prefix[1] = loose_path[1];
-  loose_prefix[2] = '\0';
-  if (mkdirat (dfd, loose_prefix, 0777) == -1)
+  for (const char *slash = strchr (loose_path, '/'); slash != NULL;
+       slash = strchr (slash + 1, '/'))
     {
-      if (G_UNLIKELY (errno != EEXIST))
+      const gsize len = slash - loose_path;
+      memcpy (loose_prefix, loose_path, len);
+      loose_prefix[len] = '\0';
+      if (mkdirat (dfd, loose_prefix, 0777) == -1)
         {
-          glnx_set_error_from_errno (error);
-          return FALSE;
+          if (G_UNLIKELY (errno != EEXIST))
+            {
+              glnx_set_error_from_errno (error);
+              return FALSE;
+            }
         }
     }
   return TRUE;
@@ -172,19 +308,79 @@ ot_security_smack_reset_fd (int fd)
 #endif
 }
 
+/* Check whether @loose_path was already written or found present during the
+ * current transaction. Returns %FALSE when no transaction is active. */
+gboolean
+_ostree_repo_txn_object_is_present (OstreeRepo *self, const char *loose_path)
+{
+  if (!self->in_transaction)
+    return FALSE;
+
+  g_mutex_lock (&self->txn_lock);
+  gboolean present = self->txn.known_objects != NULL
+                     && g_hash_table_contains (self->txn.known_objects, loose_path);
+  g_mutex_unlock (&self->txn_lock);
+
+  return present;
+}
+
+/* Record that the loose object at @loose_path is present in the repository, so
+ * _ostree_repo_has_loose_object() can skip re-statting it for the rest of the
+ * transaction. Objects can't be pruned while the transaction's shared lock is
+ * held, so entries never go stale before the transaction ends. No-op outside a
+ * transaction. */
+void
+_ostree_repo_txn_mark_object_present (OstreeRepo *self, const char *loose_path)
+{
+  if (!self->in_transaction)
+    return;
+
+  g_mutex_lock (&self->txn_lock);
+  if (self->txn.known_objects == NULL)
+    self->txn.known_objects = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_hash_table_add (self->txn.known_objects, g_strdup (loose_path));
+  g_mutex_unlock (&self->txn_lock);
+}
+
 /* Given an O_TMPFILE regular file, link it into place. */
 gboolean
 _ostree_repo_commit_tmpf_final (OstreeRepo *self, const char *checksum, OstreeObjectType objtype,
                                 GLnxTmpfile *tmpf, GCancellable *cancellable, GError **error)
 {
   char tmpbuf[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (tmpbuf, checksum, objtype, self->mode);
+  _ostree_repo_loose_path (self, tmpbuf, checksum, objtype);
 
-  int dest_dfd = commit_dest_dfd (self);
+  int dest_dfd = commit_dest_dfd (self, objtype);
   if (!_ostree_repo_ensure_loose_objdir_at (dest_dfd, tmpbuf, cancellable, error))
     return FALSE;
 
-  if (!_ostree_tmpf_fsverity (self, tmpf, NULL, error))
+  /* The tmpfile was created under the repository root; when the destination
+   * is a metadata root on a different filesystem, linkat() would fail with
+   * EXDEV, so copy into a tmpfile on the destination and link that instead.
+   */
+  if (dest_dfd == self->metadata_objects_dir_fd && self->metadata_objects_device != self->device)
+    {
+      if (lseek (tmpf->fd, 0, SEEK_SET) < 0)
+        return glnx_throw_errno_prefix (error, "lseek");
+      g_auto (GLnxTmpfile) dest_tmpf = {
+        0,
+      };
+      if (!glnx_open_tmpfile_linkable_at (dest_dfd, ".", O_WRONLY | O_CLOEXEC, &dest_tmpf, error))
+        return FALSE;
+      if (glnx_regfile_copy_bytes (tmpf->fd, dest_tmpf.fd, (off_t)-1) < 0)
+        return glnx_throw_errno_prefix (error, "regfile copy");
+      glnx_tmpfile_clear (tmpf);
+      *tmpf = dest_tmpf;
+      dest_tmpf.initialized = FALSE; /* Ownership was transferred */
+    }
+
+  /* Inside a transaction, enabling verity (a synchronous Merkle tree
+   * computation in the kernel) is handed off to a worker pool and drained
+   * before the transaction commits; otherwise enable it inline. */
+  gboolean fsverity_queued = FALSE;
+  if (!_ostree_repo_fsverity_maybe_queue (self, tmpf, &fsverity_queued, error))
+    return FALSE;
+  if (!fsverity_queued && !_ostree_tmpf_fsverity (self, tmpf, NULL, error))
     return FALSE;
 
   if (!glnx_link_tmpfile_at (tmpf, GLNX_LINK_TMPFILE_NOREPLACE_IGNORE_EXIST, dest_dfd, tmpbuf,
@@ -192,6 +388,7 @@ _ostree_repo_commit_tmpf_final (OstreeRepo *self, const char *checksum, OstreeOb
     return FALSE;
   /* We're done with the fd */
   glnx_tmpfile_clear (tmpf);
+  _ostree_repo_txn_mark_object_present (self, tmpbuf);
   return TRUE;
 }
 
@@ -204,15 +401,26 @@ commit_path_final (OstreeRepo *self, const char *checksum, OstreeObjectType objt
 {
   /* The final renameat() */
   char tmpbuf[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (tmpbuf, checksum, objtype, self->mode);
+  _ostree_repo_loose_path (self, tmpbuf, checksum, objtype);
 
-  int dest_dfd = commit_dest_dfd (self);
+  int dest_dfd = commit_dest_dfd (self, objtype);
   if (!_ostree_repo_ensure_loose_objdir_at (dest_dfd, tmpbuf, cancellable, error))
     return FALSE;
 
   if (renameat (tmp_path->dfd, tmp_path->path, dest_dfd, tmpbuf) == -1)
     {
-      if (errno != EEXIST)
+      if (errno == EXDEV)
+        {
+          /* The metadata root may live on a different filesystem; fall back
+           * to a copy.  Metadata objects are always regular files.  The
+           * source tmpfile is unlinked by the caller's cleanup. */
+          if (!glnx_file_copy_at (tmp_path->dfd, tmp_path->path, NULL, dest_dfd, tmpbuf,
+                                  GLNX_FILE_COPY_OVERWRITE | GLNX_FILE_COPY_NOXATTRS
+                                      | (self->disable_fsync ? 0 : GLNX_FILE_COPY_DATASYNC),
+                                  cancellable, error))
+            return FALSE;
+        }
+      else if (errno != EEXIST)
         return glnx_throw_errno_prefix (error, "Storing file '%s'", tmp_path->path);
       /* Otherwise, the caller's cleanup will unlink+free */
     }
@@ -222,6 +430,7 @@ commit_path_final (OstreeRepo *self, const char *checksum, OstreeObjectType objt
       ot_cleanup_unlinkat_clear (tmp_path);
     }
 
+  _ostree_repo_txn_mark_object_present (self, tmpbuf);
   return TRUE;
 }
 
@@ -298,8 +507,16 @@ commit_loose_regfile_object (OstreeRepo *self, const char *checksum, GLnxTmpfile
    */
   if (!self->disable_fsync && self->per_object_fsync)
     {
-      if (fsync (tmpf->fd) == -1)
-        return glnx_throw_errno_prefix (error, "fsync");
+#ifdef HAVE_LIBURING
+      if (self->use_io_uring)
+        {
+          if (!uring_fsync_queue (self, tmpf->fd, error))
+            return FALSE;
+        }
+      else
+#endif
+        if (fsync (tmpf->fd) == -1)
+          return glnx_throw_errno_prefix (error, "fsync");
     }
 
   if (!_ostree_repo_commit_tmpf_final (self, checksum, OSTREE_OBJECT_TYPE_FILE, tmpf, cancellable,
@@ -463,6 +680,12 @@ throw_min_free_space_error (OstreeRepo *self, guint64 bytes_required, GError **e
                        err_msg);
 }
 
+/* Incoming writes are staged here and flushed in buffer-sized (and hence
+ * filesystem-block-aligned) chunks, both to issue large write()s and to
+ * satisfy the O_DIRECT alignment requirements when that's in play.
+ */
+#define BARE_CONTENT_WRITE_BUFFER_SIZE (1 * 1024 * 1024)
+
 typedef struct
 {
   gboolean initialized;
@@ -475,6 +698,9 @@ typedef struct
   guint gid;
   guint mode;
   GVariant *xattrs;
+  guint8 *buf;       /* Lazily allocated staging buffer; page aligned for O_DIRECT */
+  gsize buf_len;     /* Bytes currently staged in buf */
+  gboolean direct_io; /* tmpf.fd currently has O_DIRECT set */
 } OstreeRealRepoBareContent;
 G_STATIC_ASSERT (sizeof (OstreeRepoBareContent) >= sizeof (OstreeRealRepoBareContent));
 
@@ -492,13 +718,57 @@ _ostree_repo_bare_content_open (OstreeRepo *self, const char *expected_checksum,
   g_assert (!real->initialized);
   real->initialized = TRUE;
   g_assert (S_ISREG (mode));
-  if (!glnx_open_tmpfile_linkable_at (commit_tmp_dfd (self), ".", O_WRONLY | O_CLOEXEC, &real->tmpf,
-                                      error))
+
+  /* When the caller already knows the object's checksum (the static delta
+   * path always does, from the superblock), create the tmpfile directly in
+   * the destination fanout directory.  With O_TMPFILE the final linkat()
+   * then stays within one directory, and on filesystems where we fall back
+   * to a named tmpfile the rename is in-directory too, so the data never
+   * has to move after being written.
+   */
+  int open_dfd = commit_tmp_dfd (self);
+  const char *open_path = ".";
+  char fanout_buf[_OSTREE_LOOSE_PATH_MAX];
+  if (expected_checksum != NULL)
+    {
+      _ostree_repo_loose_path (self, fanout_buf, expected_checksum, OSTREE_OBJECT_TYPE_FILE);
+      int dest_dfd = commit_dest_dfd (self, OSTREE_OBJECT_TYPE_FILE);
+      if (!_ostree_repo_ensure_loose_objdir_at (dest_dfd, fanout_buf, cancellable, error))
+        return FALSE;
+      *strrchr (fanout_buf, '/') = '\0'; /* Keep just the fanout directory */
+      open_dfd = dest_dfd;
+      open_path = fanout_buf;
+    }
+
+  /* Large objects optionally bypass the page cache (see the
+   * direct-io-threshold config option); streaming in gigabytes of object
+   * content otherwise evicts every warm page on small-RAM devices.  Not all
+   * filesystems support O_DIRECT, so fall back silently.
+   */
+  real->direct_io = FALSE;
+  if (self->direct_io_threshold > 0 && content_len >= self->direct_io_threshold)
+    {
+      if (glnx_open_tmpfile_linkable_at (open_dfd, open_path, O_WRONLY | O_CLOEXEC | O_DIRECT,
+                                         &real->tmpf, NULL))
+        real->direct_io = TRUE;
+    }
+  if (!real->tmpf.initialized
+      && !glnx_open_tmpfile_linkable_at (open_dfd, open_path, O_WRONLY | O_CLOEXEC, &real->tmpf,
+                                         error))
     return FALSE;
+
+  /* The final size is known from the object header; reserving it upfront
+   * gives the filesystem a chance at contiguous extents and fails early on
+   * ENOSPC instead of mid-stream. */
+  if (content_len > 0 && !glnx_try_fallocate (real->tmpf.fd, 0, content_len, error))
+    return FALSE;
+
   ot_checksum_init (&real->checksum);
   real->expected_checksum = g_strdup (expected_checksum);
   real->content_len = content_len;
   real->bytes_written = 0;
+  real->buf = NULL;
+  real->buf_len = 0;
   real->uid = uid;
   real->gid = gid;
   real->mode = mode;
@@ -512,6 +782,17 @@ _ostree_repo_bare_content_open (OstreeRepo *self, const char *expected_checksum,
   return TRUE;
 }
 
+static gboolean
+bare_content_flush_buf (OstreeRealRepoBareContent *real, GError **error)
+{
+  if (real->buf_len == 0)
+    return TRUE;
+  if (glnx_loop_write (real->tmpf.fd, real->buf, real->buf_len) < 0)
+    return glnx_throw_errno_prefix (error, "write");
+  real->buf_len = 0;
+  return TRUE;
+}
+
 gboolean
 _ostree_repo_bare_content_write (OstreeRepo *repo, OstreeRepoBareContent *barewrite,
                                  const guint8 *buf, size_t len, GCancellable *cancellable,
@@ -520,8 +801,31 @@ _ostree_repo_bare_content_write (OstreeRepo *repo, OstreeRepoBareContent *barewr
   OstreeRealRepoBareContent *real = (OstreeRealRepoBareContent *)barewrite;
   g_assert (real->initialized);
   ot_checksum_update (&real->checksum, buf, len);
-  if (glnx_loop_write (real->tmpf.fd, buf, len) < 0)
-    return glnx_throw_errno_prefix (error, "write");
+
+  while (len > 0)
+    {
+      if (real->buf == NULL)
+        {
+          /* O_DIRECT requires the source buffer to be block aligned; a page
+           * boundary satisfies that everywhere, and costs nothing in the
+           * buffered case. */
+          void *aligned = NULL;
+          if (posix_memalign (&aligned, 4096, BARE_CONTENT_WRITE_BUFFER_SIZE) != 0)
+            return glnx_throw_errno_prefix (error, "posix_memalign");
+          real->buf = aligned;
+        }
+
+      const gsize to_copy = MIN (len, BARE_CONTENT_WRITE_BUFFER_SIZE - real->buf_len);
+      memcpy (real->buf + real->buf_len, buf, to_copy);
+      real->buf_len += to_copy;
+      buf += to_copy;
+      len -= to_copy;
+
+      /* Only flush full (aligned) buffers here; the unaligned tail is
+       * handled at commit time. */
+      if (real->buf_len == BARE_CONTENT_WRITE_BUFFER_SIZE && !bare_content_flush_buf (real, error))
+        return FALSE;
+    }
   return TRUE;
 }
 
@@ -533,6 +837,21 @@ _ostree_repo_bare_content_commit (OstreeRepo *self, OstreeRepoBareContent *barew
   OstreeRealRepoBareContent *real = (OstreeRealRepoBareContent *)barewrite;
   g_assert (real->initialized);
 
+  /* Flush the buffered tail.  Its length is rarely block aligned, so it
+   * can't go through O_DIRECT; drop the flag for this final write. */
+  if (real->buf_len > 0)
+    {
+      if (real->direct_io)
+        {
+          const int fdflags = fcntl (real->tmpf.fd, F_GETFL);
+          if (fdflags < 0 || fcntl (real->tmpf.fd, F_SETFL, fdflags & ~O_DIRECT) < 0)
+            return glnx_throw_errno_prefix (error, "fcntl(O_DIRECT)");
+          real->direct_io = FALSE;
+        }
+      if (!bare_content_flush_buf (real, error))
+        return FALSE;
+    }
+
   if ((self->min_free_space_percent > 0 || self->min_free_space_mb > 0) && self->in_transaction)
     {
       struct stat st_buf;
@@ -580,6 +899,8 @@ _ostree_repo_bare_content_cleanup (OstreeRepoBareContent *regwrite)
   ot_checksum_clear (&real->checksum);
   g_clear_pointer (&real->expected_checksum, g_free);
   g_clear_pointer (&real->xattrs, g_variant_unref);
+  g_clear_pointer (&real->buf, free); /* from posix_memalign() */
+  real->buf_len = 0;
   real->initialized = FALSE;
 }
 
@@ -643,6 +964,190 @@ create_regular_tmpfile_linkable_with_content (OstreeRepo *self, guint64 length,
   return TRUE;
 }
 
+typedef struct
+{
+  int fd;
+  guint64 offset;
+  guint64 length;
+  GBytes *header;
+  char checksum[OSTREE_SHA256_STRING_LEN + 1];
+  gboolean success;
+  GError *error;
+} TeeHashThreadData;
+
+static gpointer
+tee_hash_thread (gpointer user_data)
+{
+  TeeHashThreadData *data = user_data;
+
+  g_auto (OtChecksum) checksum = {
+    0,
+  };
+  ot_checksum_init (&checksum);
+  ot_checksum_update_bytes (&checksum, data->header);
+
+  const gsize buf_size = MIN (data->length, (guint64)1048576);
+  g_autofree guint8 *buf = g_malloc (buf_size);
+  guint64 remaining = data->length;
+  guint64 offset = data->offset;
+  while (remaining > 0)
+    {
+      const gssize bytes_read
+          = TEMP_FAILURE_RETRY (pread (data->fd, buf, MIN (remaining, buf_size), offset));
+      if (bytes_read < 0)
+        {
+          glnx_throw_errno_prefix (&data->error, "pread");
+          return NULL;
+        }
+      if (bytes_read == 0)
+        {
+          glnx_throw (&data->error,
+                      "Unexpected EOF with %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT
+                      " bytes remaining",
+                      remaining, data->length);
+          return NULL;
+        }
+      ot_checksum_update (&checksum, buf, bytes_read);
+      remaining -= bytes_read;
+      offset += bytes_read;
+    }
+
+  ot_checksum_get_hexdigest (&checksum, data->checksum, sizeof (data->checksum));
+  data->success = TRUE;
+  return NULL;
+}
+
+/* Tee-mode variant of create_regular_tmpfile_linkable_with_content(): the
+ * payload goes input fd → tmpfile through the kernel, while a worker
+ * thread hashes the same byte range (after the synthesized object
+ * @header) from the page cache behind the copy.  This overlaps the
+ * checksum CPU with the copy I/O instead of serializing them through a
+ * userspace buffer.
+ */
+static gboolean
+create_regular_tmpfile_linkable_with_tee_checksum (OstreeRepo *self, guint64 length,
+                                                   GInputStream *input, GBytes *header,
+                                                   GLnxTmpfile *out_tmpf, char **out_checksum,
+                                                   GCancellable *cancellable, GError **error)
+{
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return FALSE;
+
+  const int infd = g_file_descriptor_based_get_fd ((GFileDescriptorBased *)input);
+  const off_t start_offset = lseek (infd, 0, SEEK_CUR);
+  if (start_offset < 0)
+    return glnx_throw_errno_prefix (error, "lseek");
+
+  TeeHashThreadData tee = {
+    .fd = infd,
+    .offset = (guint64)start_offset,
+    .length = length,
+    .header = header,
+  };
+  GThread *hasher = g_thread_new ("commit-tee-hash", tee_hash_thread, &tee);
+
+  g_auto (GLnxTmpfile) tmpf = {
+    0,
+  };
+  g_autoptr (GError) copy_error = NULL;
+  gboolean copy_ok = FALSE;
+  if (glnx_open_tmpfile_linkable_at (commit_tmp_dfd (self), ".", O_WRONLY | O_CLOEXEC, &tmpf,
+                                     &copy_error)
+      && glnx_try_fallocate (tmpf.fd, 0, length, &copy_error))
+    {
+      if (glnx_regfile_copy_bytes (infd, tmpf.fd, (off_t)length) < 0)
+        glnx_throw_errno_prefix (&copy_error, "regfile copy");
+      else
+        copy_ok = TRUE;
+    }
+
+  /* Always reap the hasher, even on a failed copy */
+  g_thread_join (hasher);
+
+  if (!copy_ok)
+    {
+      g_propagate_error (error, g_steal_pointer (&copy_error));
+      return FALSE;
+    }
+  if (!tee.success)
+    {
+      g_propagate_error (error, g_steal_pointer (&tee.error));
+      return FALSE;
+    }
+
+  if (!glnx_fchmod (tmpf.fd, 0644, error))
+    return FALSE;
+
+  *out_tmpf = tmpf;
+  tmpf.initialized = FALSE;
+  *out_checksum = g_strdup (tee.checksum);
+  return TRUE;
+}
+
+/* Below this size, starting a hashing thread costs more than it overlaps */
+#define COMMIT_TEE_CHECKSUM_THRESHOLD (16 * 1024 * 1024)
+
+/* Whether the tee-checksum copy applies: an uncompressed destination, a
+ * regular-file payload large enough to be worth a hashing thread, and a
+ * seekable regular-file input so the worker can read the same bytes with
+ * pread() while the copy consumes the fd offset.
+ */
+/* Whether @input wraps a seekable regular file, so we can read its bytes
+ * with pread() without consuming the stream offset.
+ */
+static gboolean
+seekable_regfile_input (GInputStream *input)
+{
+  if (!G_IS_FILE_DESCRIPTOR_BASED (input))
+    return FALSE;
+
+  struct stat stbuf;
+  if (fstat (g_file_descriptor_based_get_fd ((GFileDescriptorBased *)input), &stbuf) < 0)
+    return FALSE;
+  return S_ISREG (stbuf.st_mode);
+}
+
+static gboolean
+tee_copy_eligible (OstreeRepoMode repo_mode, GFileType object_file_type, GInputStream *input,
+                   GFileInfo *file_info)
+{
+  if (repo_mode == OSTREE_REPO_MODE_ARCHIVE || object_file_type != G_FILE_TYPE_REGULAR)
+    return FALSE;
+  if ((guint64)g_file_info_get_size (file_info) < COMMIT_TEE_CHECKSUM_THRESHOLD)
+    return FALSE;
+  return seekable_regfile_input (input);
+}
+
+/* Hash @header plus @input's byte range via pread(), leaving the stream
+ * offset untouched, so the caller can ask whether the object already exists
+ * before copying anything into a tmpfile.
+ */
+static gboolean
+probe_hash_regular_file (GInputStream *input, guint64 length, GBytes *header, char **out_checksum,
+                         GError **error)
+{
+  const int infd = g_file_descriptor_based_get_fd ((GFileDescriptorBased *)input);
+  const off_t start_offset = lseek (infd, 0, SEEK_CUR);
+  if (start_offset < 0)
+    return glnx_throw_errno_prefix (error, "lseek");
+
+  TeeHashThreadData hash = {
+    .fd = infd,
+    .offset = (guint64)start_offset,
+    .length = length,
+    .header = header,
+  };
+  tee_hash_thread (&hash);
+  if (!hash.success)
+    {
+      g_propagate_error (error, g_steal_pointer (&hash.error));
+      return FALSE;
+    }
+
+  *out_checksum = g_strdup (hash.checksum);
+  return TRUE;
+}
+
 static gboolean
 _check_support_reflink (OstreeRepo *dest, gboolean *supported, GError **error)
 {
@@ -690,10 +1195,14 @@ _create_payload_link (OstreeRepo *self, const char *checksum, const char *payloa
   if (payload_checksum == NULL || g_file_info_get_size (file_info) < self->payload_link_threshold)
     return TRUE;
 
-  char target_buf[_OSTREE_LOOSE_PATH_MAX + _OSTREE_PAYLOAD_LINK_PREFIX_LEN];
+  char target_buf[_OSTREE_LOOSE_PATH_MAX + 2 * _OSTREE_PAYLOAD_LINK_PREFIX_LEN];
+  /* One "../" per fanout level; the link lives at the same depth as its
+   * target (see the deep-fanout config option). */
   strcpy (target_buf, _OSTREE_PAYLOAD_LINK_PREFIX);
-  _ostree_loose_path (target_buf + _OSTREE_PAYLOAD_LINK_PREFIX_LEN, checksum,
-                      OSTREE_OBJECT_TYPE_FILE, self->mode);
+  if (self->deep_fanout)
+    strcat (target_buf, _OSTREE_PAYLOAD_LINK_PREFIX);
+  _ostree_repo_loose_path (self, target_buf + strlen (target_buf), checksum,
+                           OSTREE_OBJECT_TYPE_FILE);
 
   if (symlinkat (target_buf, commit_tmp_dfd (self), payload_checksum) < 0)
     {
@@ -786,17 +1295,22 @@ _try_clone_from_payload_link (OstreeRepo *self, OstreeRepo *dest_repo, const cha
       glnx_autofd int fdf = -1;
       char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
       char loose_path_target_buf[_OSTREE_LOOSE_PATH_MAX];
-      char target_buf[_OSTREE_LOOSE_PATH_MAX + _OSTREE_PAYLOAD_LINK_PREFIX_LEN];
+      char target_buf[_OSTREE_LOOSE_PATH_MAX + 2 * _OSTREE_PAYLOAD_LINK_PREFIX_LEN];
       char target_checksum[OSTREE_SHA256_STRING_LEN + 1];
       int dfd = dfd_searches[i];
       ssize_t size;
       if (dfd == -1)
         continue;
 
-      _ostree_loose_path (loose_path_buf, payload_checksum, OSTREE_OBJECT_TYPE_PAYLOAD_LINK,
-                          self->mode);
+      _ostree_repo_loose_path (self, loose_path_buf, payload_checksum,
+                               OSTREE_OBJECT_TYPE_PAYLOAD_LINK);
 
       size = TEMP_FAILURE_RETRY (readlinkat (dfd, loose_path_buf, target_buf, sizeof (target_buf)));
+      if (size < 0 && errno == ENOENT
+          && _ostree_repo_loose_path_alternate (self, loose_path_buf, payload_checksum,
+                                                OSTREE_OBJECT_TYPE_PAYLOAD_LINK))
+        size
+            = TEMP_FAILURE_RETRY (readlinkat (dfd, loose_path_buf, target_buf, sizeof (target_buf)));
       if (size < 0)
         {
           if (errno == ENOENT)
@@ -804,16 +1318,39 @@ _try_clone_from_payload_link (OstreeRepo *self, OstreeRepo *dest_repo, const cha
           return glnx_throw_errno_prefix (error, "readlinkat");
         }
 
-      if (size < OSTREE_SHA256_STRING_LEN + _OSTREE_PAYLOAD_LINK_PREFIX_LEN)
+      if (size < OSTREE_SHA256_STRING_LEN + _OSTREE_PAYLOAD_LINK_PREFIX_LEN
+          || size >= (ssize_t)sizeof (target_buf))
         return glnx_throw (error, "invalid data size for %s", loose_path_buf);
+      target_buf[size] = '\0';
 
-      sprintf (target_checksum, "%.2s%.62s", target_buf + _OSTREE_PAYLOAD_LINK_PREFIX_LEN,
-               target_buf + _OSTREE_PAYLOAD_LINK_PREFIX_LEN + 3);
+      /* The target is one "../" per fanout level followed by the loose path,
+       * which may use either fanout layout (see deep-fanout). */
+      {
+        const char *tp = target_buf;
+        while (g_str_has_prefix (tp, _OSTREE_PAYLOAD_LINK_PREFIX))
+          tp += _OSTREE_PAYLOAD_LINK_PREFIX_LEN;
+        guint n = 0;
+        for (; *tp != '\0' && *tp != '.' && n < OSTREE_SHA256_STRING_LEN; tp++)
+          {
+            if (*tp != '/')
+              target_checksum[n++] = *tp;
+          }
+        if (n != OSTREE_SHA256_STRING_LEN)
+          return glnx_throw (error, "invalid payload link target for %s", loose_path_buf);
+        target_checksum[n] = '\0';
+      }
 
-      _ostree_loose_path (loose_path_target_buf, target_checksum, OSTREE_OBJECT_TYPE_FILE,
-                          self->mode);
+      _ostree_repo_loose_path (self, loose_path_target_buf, target_checksum,
+                               OSTREE_OBJECT_TYPE_FILE);
       if (!ot_openat_ignore_enoent (dfd, loose_path_target_buf, &fdf, error))
         return FALSE;
+      if (fdf < 0
+          && _ostree_repo_loose_path_alternate (self, loose_path_target_buf, target_checksum,
+                                                OSTREE_OBJECT_TYPE_FILE))
+        {
+          if (!ot_openat_ignore_enoent (dfd, loose_path_target_buf, &fdf, error))
+            return FALSE;
+        }
 
       if (fdf < 0)
         {
@@ -832,8 +1369,22 @@ _try_clone_from_payload_link (OstreeRepo *self, OstreeRepo *dest_repo, const cha
         }
     }
   if (self->parent_repo)
-    return _try_clone_from_payload_link (self->parent_repo, dest_repo, payload_checksum, file_info,
-                                         tmpf, cancellable, error);
+    {
+      if (!_try_clone_from_payload_link (self->parent_repo, dest_repo, payload_checksum, file_info,
+                                         tmpf, cancellable, error))
+        return FALSE;
+    }
+
+  /* Shared object pools can be reflink sources too */
+  if (self->object_pools != NULL)
+    {
+      for (guint i = 0; i < self->object_pools->len; i++)
+        {
+          if (!_try_clone_from_payload_link (self->object_pools->pdata[i], dest_repo,
+                                             payload_checksum, file_info, tmpf, cancellable, error))
+            return FALSE;
+        }
+    }
 
   return TRUE;
 }
@@ -861,11 +1412,37 @@ write_content_object (OstreeRepo *self, const char *expected_checksum, GInputStr
       && g_getenv ("OSTREE_EXP_WRITE_BARE_SPLIT_XATTRS") == NULL)
     return glnx_throw (error, "Not allowed due to repo mode");
 
+  /* If we were handed the checksum up front, look for the object before
+   * doing any copying or (for archive repos) compression work.  The
+   * streaming entry point ostree_repo_write_content() does the same check,
+   * but other callers reach here directly.  When size metadata is wanted we
+   * fall through so the size entries get created.
+   */
+  if (expected_checksum != NULL && !self->generate_sizes)
+    {
+      gboolean have_obj;
+      if (!_ostree_repo_has_loose_object (self, expected_checksum, OSTREE_OBJECT_TYPE_FILE,
+                                          &have_obj, cancellable, error))
+        return FALSE;
+      if (have_obj)
+        {
+          g_mutex_lock (&self->txn_lock);
+          self->txn.stats.content_objects_total++;
+          g_mutex_unlock (&self->txn_lock);
+
+          if (out_csum != NULL)
+            *out_csum = ostree_checksum_to_bytes (expected_checksum);
+          return TRUE;
+        }
+    }
+
   GInputStream *file_input;                         /* Unowned alias */
   g_autoptr (GInputStream) file_input_owned = NULL; /* We need a temporary for bare-user symlinks */
   glnx_unref_object OtChecksumInstream *checksum_input = NULL;
   glnx_unref_object OtChecksumInstream *checksum_payload_input = NULL;
   const GFileType object_file_type = g_file_info_get_file_type (file_info);
+  g_autoptr (GBytes) tee_header = NULL;
+  g_autofree char *tee_checksum = NULL;
   if (out_csum)
     {
       /* Previously we checksummed the input verbatim; now
@@ -876,8 +1453,6 @@ write_content_object (OstreeRepo *self, const char *expected_checksum, GInputStr
        */
       gboolean reflinks_supported = FALSE;
       g_autoptr (GBytes) header = _ostree_file_header_new (file_info, xattrs);
-      size_t len;
-      const guint8 *buf = g_bytes_get_data (header, &len);
       /* Give a null input if there's no content */
       g_autoptr (GInputStream) null_input = NULL;
       if (!input)
@@ -885,24 +1460,79 @@ write_content_object (OstreeRepo *self, const char *expected_checksum, GInputStr
           null_input = input = g_memory_input_stream_new_from_data ("", 0, NULL);
           (void)null_input; /* quiet static analysis */
         }
-      checksum_input = ot_checksum_instream_new_with_start (input, G_CHECKSUM_SHA256, buf, len);
 
       if (!_check_support_reflink (self, &reflinks_supported, error))
         return FALSE;
 
-      if (xattrs == NULL
-          || !G_IN_SET (self->mode, OSTREE_REPO_MODE_BARE, OSTREE_REPO_MODE_BARE_USER,
-                        OSTREE_REPO_MODE_BARE_USER_ONLY)
-          || object_file_type != G_FILE_TYPE_REGULAR || !reflinks_supported)
-        file_input = (GInputStream *)checksum_input;
-      else
+      const gboolean want_payload_checksum
+          = (xattrs != NULL
+             && G_IN_SET (self->mode, OSTREE_REPO_MODE_BARE, OSTREE_REPO_MODE_BARE_USER,
+                          OSTREE_REPO_MODE_BARE_USER_ONLY)
+             && object_file_type == G_FILE_TYPE_REGULAR && reflinks_supported);
+
+      /* Incremental commits mostly re-encounter objects the repo already
+       * has; hashing the input up front without consuming the stream lets
+       * us skip the tmpfile copy entirely for those.  On a miss the bytes
+       * are warm in the page cache for the copy that follows, and we reuse
+       * the probed checksum rather than hashing again.  This matters even
+       * more for archive repos, where discovering the object exists any
+       * later means having zlib-compressed it for nothing.  Skipped when
+       * size metadata is wanted (that needs the packed object written) and
+       * when verifying an expected checksum, which keeps the stream hashers.
+       */
+      if (!want_payload_checksum && !self->generate_sizes && expected_checksum == NULL
+          && object_file_type == G_FILE_TYPE_REGULAR && seekable_regfile_input (input))
+        {
+          g_autofree char *probed_checksum = NULL;
+          if (!probe_hash_regular_file (input, (guint64)g_file_info_get_size (file_info), header,
+                                        &probed_checksum, error))
+            return FALSE;
+
+          gboolean have_obj;
+          if (!_ostree_repo_has_loose_object (self, probed_checksum, OSTREE_OBJECT_TYPE_FILE,
+                                              &have_obj, cancellable, error))
+            return FALSE;
+          if (have_obj)
+            {
+              g_mutex_lock (&self->txn_lock);
+              self->txn.stats.content_objects_total++;
+              g_mutex_unlock (&self->txn_lock);
+
+              *out_csum = ostree_checksum_to_bytes (probed_checksum);
+              /* Note early return */
+              return TRUE;
+            }
+
+          /* It's new; copy it below without hashing a second time */
+          tee_checksum = g_steal_pointer (&probed_checksum);
+          file_input = input;
+        }
+      else if (!want_payload_checksum
+               && tee_copy_eligible (repo_mode, object_file_type, input, file_info))
         {
-          /* The payload checksum-input reads from the full object checksum-input; this
-           * means it skips the header.
+          /* The copy computes the checksum itself; see
+           * create_regular_tmpfile_linkable_with_tee_checksum().
            */
-          checksum_payload_input
-              = ot_checksum_instream_new ((GInputStream *)checksum_input, G_CHECKSUM_SHA256);
-          file_input = (GInputStream *)checksum_payload_input;
+          tee_header = g_steal_pointer (&header);
+          file_input = input;
+        }
+      else
+        {
+          size_t len;
+          const guint8 *buf = g_bytes_get_data (header, &len);
+          checksum_input = ot_checksum_instream_new_with_start (input, G_CHECKSUM_SHA256, buf, len);
+
+          if (!want_payload_checksum)
+            file_input = (GInputStream *)checksum_input;
+          else
+            {
+              /* The payload checksum-input reads from the full object checksum-input; this
+               * means it skips the header.
+               */
+              checksum_payload_input
+                  = ot_checksum_instream_new ((GInputStream *)checksum_input, G_CHECKSUM_SHA256);
+              file_input = (GInputStream *)checksum_payload_input;
+            }
         }
     }
   else
@@ -983,14 +1613,21 @@ write_content_object (OstreeRepo *self, const char *expected_checksum, GInputStr
     }
   else if (repo_mode != OSTREE_REPO_MODE_ARCHIVE)
     {
-      if (!create_regular_tmpfile_linkable_with_content (self, size, file_input, &tmpf, cancellable,
-                                                         error))
+      if (tee_header != NULL)
+        {
+          if (!create_regular_tmpfile_linkable_with_tee_checksum (
+                  self, size, file_input, tee_header, &tmpf, &tee_checksum, cancellable, error))
+            return FALSE;
+        }
+      else if (!create_regular_tmpfile_linkable_with_content (self, size, file_input, &tmpf,
+                                                              cancellable, error))
         return FALSE;
     }
   else
     {
       g_autoptr (GConverter) zlib_compressor = NULL;
       g_autoptr (GOutputStream) compressed_out_stream = NULL;
+      g_autoptr (GOutputStream) fd_out = NULL;
       g_autoptr (GOutputStream) temp_out = NULL;
 
       g_assert (repo_mode == OSTREE_REPO_MODE_ARCHIVE);
@@ -998,7 +1635,12 @@ write_content_object (OstreeRepo *self, const char *expected_checksum, GInputStr
       if (!glnx_open_tmpfile_linkable_at (commit_tmp_dfd (self), ".", O_WRONLY | O_CLOEXEC, &tmpf,
                                           error))
         return FALSE;
-      temp_out = g_unix_output_stream_new (tmpf.fd, FALSE);
+      fd_out = g_unix_output_stream_new (tmpf.fd, FALSE);
+      /* The compressor emits output in small chunks; aggregate them so we
+       * issue large write() calls instead of being bounded by syscall count.
+       */
+      temp_out = g_buffered_output_stream_new_sized (fd_out, _OSTREE_ARCHIVE_WRITE_BUFFER_SIZE);
+      g_filter_output_stream_set_close_base_stream ((GFilterOutputStream *)temp_out, FALSE);
 
       g_autoptr (GBytes) file_meta_header = _ostree_zlib_file_header_new (file_info, xattrs);
       gsize file_meta_len;
@@ -1041,11 +1683,14 @@ write_content_object (OstreeRepo *self, const char *expected_checksum, GInputStr
   const char *actual_checksum = NULL;
   g_autofree char *actual_payload_checksum = NULL;
   g_autofree char *actual_checksum_owned = NULL;
-  if (!checksum_input)
+  if (!checksum_input && tee_checksum == NULL)
     actual_checksum = expected_checksum;
   else
     {
-      actual_checksum = actual_checksum_owned = ot_checksum_instream_get_string (checksum_input);
+      if (tee_checksum != NULL)
+        actual_checksum = tee_checksum;
+      else
+        actual_checksum = actual_checksum_owned = ot_checksum_instream_get_string (checksum_input);
       if (expected_checksum)
         {
           if (!_ostree_compare_object_checksum (OSTREE_OBJECT_TYPE_FILE, expected_checksum,
@@ -1155,6 +1800,9 @@ write_content_object (OstreeRepo *self, const char *expected_checksum, GInputStr
         return FALSE;
     }
 
+  ot_tracepoint2 (commit_write_content_object, actual_checksum,
+                  (guint64)g_file_info_get_size (file_info));
+
   /* Update statistics */
   g_mutex_lock (&self->txn_lock);
   self->txn.stats.content_objects_written++;
@@ -1229,12 +1877,12 @@ adopt_and_commit_regfile (OstreeRepo *self, int dfd, const char *name, GFileInfo
 
   /* TODO: dedup this with commit_path_final() */
   char loose_path[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (loose_path, checksum, OSTREE_OBJECT_TYPE_FILE, self->mode);
+  _ostree_repo_loose_path (self, loose_path, checksum, OSTREE_OBJECT_TYPE_FILE);
 
   const guint32 src_dev = g_file_info_get_attribute_uint32 (finfo, "unix::device");
   const guint64 src_inode = g_file_info_get_attribute_uint64 (finfo, "unix::inode");
 
-  int dest_dfd = commit_dest_dfd (self);
+  int dest_dfd = commit_dest_dfd (self, OSTREE_OBJECT_TYPE_FILE);
   if (!_ostree_repo_ensure_loose_objdir_at (dest_dfd, loose_path, cancellable, error))
     return FALSE;
 
@@ -1386,6 +2034,31 @@ write_metadata_object (OstreeRepo *self, OstreeObjectType objtype, const char *e
               return FALSE;
             }
         }
+
+      /* Record the commit's ancestry; folded into the commit-graph when the
+       * transaction commits.
+       */
+      if (self->in_transaction)
+        {
+          g_autoptr (GVariant) commit_v = g_variant_ref_sink (
+              g_variant_new_from_bytes (OSTREE_COMMIT_GVARIANT_FORMAT, buf, TRUE));
+          g_autofree char *parent = ostree_commit_get_parent (commit_v);
+
+          OstreeRepoCommitGraphEntry *entry = g_new0 (OstreeRepoCommitGraphEntry, 1);
+          ostree_checksum_inplace_to_bytes (actual_checksum, entry->checksum);
+          if (parent != NULL)
+            {
+              entry->has_parent = TRUE;
+              ostree_checksum_inplace_to_bytes (parent, entry->parent);
+            }
+          entry->timestamp = ostree_commit_get_timestamp (commit_v);
+
+          g_mutex_lock (&self->txn_lock);
+          if (self->txn.written_commits == NULL)
+            self->txn.written_commits = g_ptr_array_new_with_free_func (g_free);
+          g_ptr_array_add (self->txn.written_commits, entry);
+          g_mutex_unlock (&self->txn_lock);
+        }
     }
 
   /* Update the stats, note we both wrote one and add to total */
@@ -1493,6 +2166,16 @@ scan_loose_devino (OstreeRepo *self, GHashTable *devino_cache, GCancellable *can
         return FALSE;
     }
 
+  /* Shared object pools participate in hardlink dedup too */
+  if (self->object_pools != NULL)
+    {
+      for (guint i = 0; i < self->object_pools->len; i++)
+        {
+          if (!scan_loose_devino (self->object_pools->pdata[i], devino_cache, cancellable, error))
+            return FALSE;
+        }
+    }
+
   if (self->mode == OSTREE_REPO_MODE_ARCHIVE && self->uncompressed_objects_dir_fd != -1)
     {
       if (!scan_one_loose_devino (self, self->uncompressed_objects_dir_fd, devino_cache,
@@ -1506,6 +2189,179 @@ scan_loose_devino (OstreeRepo *self, GHashTable *devino_cache, GCancellable *can
   return TRUE;
 }
 
+/* Persistent devino cache, stored in the repo cache directory so that
+ * short-lived processes invoking ostree_repo_scan_hardlinks() can skip
+ * re-statting every loose object.  The serialized form is a GVariant
+ *
+ *   (ua(stt)a(ttay))
+ *
+ * holding a version, an array of (fanout dirname, mtime sec, mtime nsec)
+ * stamps for every two-character directory under objects/, and the
+ * (dev, ino, binary checksum) entries themselves.  Any change to a fanout
+ * directory bumps its mtime and hence invalidates the cache, forcing a
+ * full rescan.
+ */
+#define DEVINO_CACHE_NAME "devino-cache"
+#define DEVINO_CACHE_VERSION 1
+#define DEVINO_CACHE_GVARIANT_STRING "(ua(stt)a(ttay))"
+
+/* Gather the current fanout directory mtimes; values are 2-element
+ * guint64 arrays of (sec, nsec).
+ */
+static gboolean
+devino_cache_get_stamps (OstreeRepo *self, GHashTable **out_stamps, GCancellable *cancellable,
+                         GError **error)
+{
+  g_autoptr (GHashTable) stamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (self->objects_dir_fd, ".", FALSE, &dfd_iter, error))
+    return FALSE;
+
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+      if (dent->d_type != DT_DIR || strlen (dent->d_name) != 2)
+        continue;
+
+      struct stat stbuf;
+      if (!glnx_fstatat (dfd_iter.fd, dent->d_name, &stbuf, AT_SYMLINK_NOFOLLOW, error))
+        return FALSE;
+
+      guint64 *stamp = g_new (guint64, 2);
+      stamp[0] = stbuf.st_mtim.tv_sec;
+      stamp[1] = stbuf.st_mtim.tv_nsec;
+      g_hash_table_replace (stamps, g_strdup (dent->d_name), stamp);
+    }
+
+  *out_stamps = g_steal_pointer (&stamps);
+  return TRUE;
+}
+
+/* Try to fill @devino_cache from the persistent cache file; @out_loaded
+ * says whether the cache was present and still valid.
+ */
+static gboolean
+devino_cache_load (OstreeRepo *self, GHashTable *devino_cache, gboolean *out_loaded,
+                   GCancellable *cancellable, GError **error)
+{
+  *out_loaded = FALSE;
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (self->cache_dir_fd, DEVINO_CACHE_NAME, &fd, error))
+    return FALSE;
+  if (fd == -1)
+    return TRUE;
+
+  g_autoptr (GVariant) cache = NULL;
+  if (!ot_variant_read_fd (fd, 0, G_VARIANT_TYPE (DEVINO_CACHE_GVARIANT_STRING), FALSE, &cache,
+                           error))
+    return FALSE;
+
+  guint32 version;
+  g_autoptr (GVariant) stamps_v = NULL;
+  g_autoptr (GVariant) entries_v = NULL;
+  g_variant_get (cache, "(u@a(stt)@a(ttay))", &version, &stamps_v, &entries_v);
+  if (version != DEVINO_CACHE_VERSION)
+    return TRUE;
+
+  /* Validate the fanout stamps; any mismatch means the objects directory
+   * changed since the cache was written.
+   */
+  g_autoptr (GHashTable) stamps = NULL;
+  if (!devino_cache_get_stamps (self, &stamps, cancellable, error))
+    return FALSE;
+  if (g_variant_n_children (stamps_v) != g_hash_table_size (stamps))
+    return TRUE;
+  GVariantIter stamps_iter;
+  g_variant_iter_init (&stamps_iter, stamps_v);
+  const char *dirname;
+  guint64 sec, nsec;
+  while (g_variant_iter_next (&stamps_iter, "(&stt)", &dirname, &sec, &nsec))
+    {
+      const guint64 *cur = g_hash_table_lookup (stamps, dirname);
+      if (cur == NULL || cur[0] != sec || cur[1] != nsec)
+        return TRUE;
+    }
+
+  GVariantIter entries_iter;
+  g_variant_iter_init (&entries_iter, entries_v);
+  guint64 dev, ino;
+  g_autoptr (GVariant) csum_v = NULL;
+  while (g_variant_iter_loop (&entries_iter, "(tt@ay)", &dev, &ino, &csum_v))
+    {
+      if (g_variant_n_children (csum_v) != OSTREE_SHA256_DIGEST_LEN)
+        return TRUE; /* Corrupt; treat as a miss */
+      OstreeDevIno *key = g_new (OstreeDevIno, 1);
+      key->dev = dev;
+      key->ino = ino;
+      ostree_checksum_inplace_from_bytes (g_variant_get_data (csum_v), key->checksum);
+      g_hash_table_add (devino_cache, key);
+    }
+  csum_v = NULL; /* iter_loop freed it */
+
+  *out_loaded = TRUE;
+  return TRUE;
+}
+
+/* Serialize @devino_cache into the cache directory, replacing any
+ * previous version atomically.
+ */
+static gboolean
+devino_cache_save (OstreeRepo *self, GHashTable *devino_cache, GCancellable *cancellable,
+                   GError **error)
+{
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  g_autoptr (GHashTable) stamps = NULL;
+  if (!devino_cache_get_stamps (self, &stamps, cancellable, error))
+    return FALSE;
+
+  g_auto (GVariantBuilder) builder;
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (DEVINO_CACHE_GVARIANT_STRING));
+  g_variant_builder_add (&builder, "u", (guint32)DEVINO_CACHE_VERSION);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(stt)"));
+  GLNX_HASH_TABLE_FOREACH_KV (stamps, const char *, dirname, const guint64 *, stamp)
+    g_variant_builder_add (&builder, "(stt)", dirname, stamp[0], stamp[1]);
+  g_variant_builder_close (&builder);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(ttay)"));
+  GLNX_HASH_TABLE_FOREACH (devino_cache, const OstreeDevIno *, devino)
+    {
+      guint8 csum[OSTREE_SHA256_DIGEST_LEN];
+      ostree_checksum_inplace_to_bytes (devino->checksum, csum);
+      g_variant_builder_add (
+          &builder, "(tt@ay)", (guint64)devino->dev, (guint64)devino->ino,
+          g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, csum, sizeof (csum), 1));
+    }
+  g_variant_builder_close (&builder);
+
+  g_autoptr (GVariant) cache = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  g_auto (GLnxTmpfile) tmpf = {
+    0,
+  };
+  if (!glnx_open_tmpfile_linkable_at (self->cache_dir_fd, ".", O_WRONLY | O_CLOEXEC, &tmpf, error))
+    return FALSE;
+  if (glnx_loop_write (tmpf.fd, g_variant_get_data (cache), g_variant_get_size (cache)) < 0)
+    return glnx_throw_errno_prefix (error, "write");
+  if (!glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, self->cache_dir_fd,
+                             DEVINO_CACHE_NAME, error))
+    return FALSE;
+
+  return TRUE;
+}
+
 /* Loook up a (device,inode) pair in our cache, and see if it maps to a known
  * checksum. */
 static const char *
@@ -1531,6 +2387,169 @@ devino_cache_lookup (OstreeRepo *self, OstreeRepoCommitModifier *modifier, guint
   return dev_ino_val->checksum;
 }
 
+/* State for the parallel content prehashing engine, enabled via the
+ * `core.parallel-checksum-threads` config option.  Before serially processing
+ * a directory's entries in write_dfd_iter_to_mtree_internal(), we push its
+ * regular files onto a thread pool which computes their content object
+ * checksums.  For objects the repository already has - the common case when
+ * re-committing a mostly-unchanged tree - the serialized write path can then
+ * be skipped entirely, and directory traversal overlaps with hashing.
+ */
+struct OstreeRepoPrehasher
+{
+  OtThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  guint outstanding;
+  GHashTable *cache; /* Set of OstreeDevIno, see ostree_repo_devino_cache_new() */
+};
+
+typedef struct
+{
+  OstreeRepoPrehasher *prehasher;
+  int dfd; /* Unowned; the main thread keeps it open until the pool drains */
+  char *name;
+  guint32 dev;
+  guint64 ino;
+} PrehashJob;
+
+static void
+prehash_worker (gpointer data, gpointer user_data)
+{
+  PrehashJob *job = data;
+  OstreeRepoPrehasher *prehasher = job->prehasher;
+
+  /* Errors here are deliberately not propagated; on failure the main thread
+   * just falls back to the serial write path for this file.
+   */
+  g_autofree char *checksum = NULL;
+  (void)ostree_checksum_file_at (job->dfd, job->name, NULL, OSTREE_OBJECT_TYPE_FILE,
+                                 OSTREE_CHECKSUM_FLAGS_NONE, &checksum, NULL, NULL);
+
+  g_mutex_lock (&prehasher->lock);
+  if (checksum != NULL)
+    {
+      OstreeDevIno *key = g_new (OstreeDevIno, 1);
+      key->dev = job->dev;
+      key->ino = job->ino;
+      memcpy (key->checksum, checksum, OSTREE_SHA256_STRING_LEN + 1);
+      g_hash_table_add (prehasher->cache, key);
+    }
+  g_assert_cmpuint (prehasher->outstanding, >, 0);
+  prehasher->outstanding--;
+  g_cond_signal (&prehasher->cond);
+  g_mutex_unlock (&prehasher->lock);
+
+  g_free (job->name);
+  g_free (job);
+}
+
+void
+_ostree_repo_prehasher_free (OstreeRepoPrehasher *prehasher)
+{
+  g_mutex_lock (&prehasher->lock);
+  while (prehasher->outstanding > 0)
+    g_cond_wait (&prehasher->cond, &prehasher->lock);
+  g_mutex_unlock (&prehasher->lock);
+  ot_thread_pool_free (prehasher->pool);
+  g_hash_table_unref (prehasher->cache);
+  g_cond_clear (&prehasher->cond);
+  g_mutex_clear (&prehasher->lock);
+  g_free (prehasher);
+}
+
+static OstreeRepoPrehasher *
+repo_ensure_prehasher (OstreeRepo *self)
+{
+  if (self->prehasher == NULL)
+    {
+      OstreeRepoPrehasher *prehasher = g_new0 (OstreeRepoPrehasher, 1);
+      g_mutex_init (&prehasher->lock);
+      g_cond_init (&prehasher->cond);
+      prehasher->cache = (GHashTable *)ostree_repo_devino_cache_new ();
+      prehasher->pool = ot_thread_pool_new ("commit-prehash", prehash_worker, NULL,
+                                            self->parallel_checksum_threads);
+      self->prehasher = prehasher;
+    }
+  return self->prehasher;
+}
+
+/* Queue checksumming of all regular files in @dfd onto the prehashing pool,
+ * then wait for the results so prehash_lookup() below can use them.  @dfd is
+ * iterated independently of the caller's GLnxDirFdIterator.
+ */
+static gboolean
+prehash_dfd_content (OstreeRepo *self, OstreeRepoCommitModifier *modifier, int dfd,
+                     GCancellable *cancellable, GError **error)
+{
+  OstreeRepoPrehasher *prehasher = repo_ensure_prehasher (self);
+
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (dfd, ".", FALSE, &dfd_iter, error))
+    return FALSE;
+
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+      if (dent->d_type != DT_REG)
+        continue;
+
+      struct stat stbuf;
+      if (!glnx_fstatat (dfd_iter.fd, dent->d_name, &stbuf, AT_SYMLINK_NOFOLLOW, error))
+        return FALSE;
+
+      /* A devino cache hit is already as fast as it gets */
+      if (devino_cache_lookup (self, modifier, stbuf.st_dev, stbuf.st_ino) != NULL)
+        continue;
+
+      PrehashJob *job = g_new0 (PrehashJob, 1);
+      job->prehasher = prehasher;
+      job->dfd = dfd;
+      job->name = g_strdup (dent->d_name);
+      job->dev = stbuf.st_dev;
+      job->ino = stbuf.st_ino;
+
+      g_mutex_lock (&prehasher->lock);
+      prehasher->outstanding++;
+      g_mutex_unlock (&prehasher->lock);
+      ot_thread_pool_push (prehasher->pool, job);
+    }
+
+  /* Wait for this directory's jobs (all outstanding ones, in fact) so that
+   * lookups during the serial walk below see the results, and so no worker
+   * still references @dfd once the caller moves on.
+   */
+  g_mutex_lock (&prehasher->lock);
+  while (prehasher->outstanding > 0)
+    g_cond_wait (&prehasher->cond, &prehasher->lock);
+  g_mutex_unlock (&prehasher->lock);
+
+  return TRUE;
+}
+
+/* Look up a (device,inode) pair in the prehash cache. */
+static const char *
+prehash_lookup (OstreeRepo *self, guint32 device, guint64 inode)
+{
+  if (self->prehasher == NULL)
+    return NULL;
+
+  OstreeDevIno dev_ino_key;
+  dev_ino_key.dev = device;
+  dev_ino_key.ino = inode;
+  /* No locking needed; the pool is always drained before we get here */
+  OstreeDevIno *dev_ino_val = g_hash_table_lookup (self->prehasher->cache, &dev_ino_key);
+  if (!dev_ino_val)
+    return NULL;
+  return dev_ino_val->checksum;
+}
+
 /**
  * ostree_repo_scan_hardlinks:
  * @self: An #OstreeRepo
@@ -1567,7 +2586,39 @@ ostree_repo_scan_hardlinks (OstreeRepo *self, GCancellable *cancellable, GError
   if (!self->loose_object_devino_hash)
     self->loose_object_devino_hash = (GHashTable *)ostree_repo_devino_cache_new ();
   g_hash_table_remove_all (self->loose_object_devino_hash);
-  return scan_loose_devino (self, self->loose_object_devino_hash, cancellable, error);
+
+  /* For the simple case, see if the persistent cache is still valid; any
+   * failure here is non-fatal and we just fall back to the full scan.  We
+   * don't persist for repos with a parent, object pools, or an uncompressed
+   * object cache, since the cache file only stamps our own objects directory.
+   */
+  const gboolean can_persist
+      = self->parent_repo == NULL && self->object_pools == NULL
+        && !(self->mode == OSTREE_REPO_MODE_ARCHIVE && self->uncompressed_objects_dir_fd != -1);
+  if (can_persist)
+    {
+      gboolean loaded = FALSE;
+      g_autoptr (GError) cache_error = NULL;
+      if (!devino_cache_load (self, self->loose_object_devino_hash, &loaded, cancellable,
+                              &cache_error))
+        g_debug ("Failed to load devino cache: %s", cache_error->message);
+      if (loaded)
+        return TRUE;
+      /* Drop anything a partial load added */
+      g_hash_table_remove_all (self->loose_object_devino_hash);
+    }
+
+  if (!scan_loose_devino (self, self->loose_object_devino_hash, cancellable, error))
+    return FALSE;
+
+  if (can_persist)
+    {
+      g_autoptr (GError) cache_error = NULL;
+      if (!devino_cache_save (self, self->loose_object_devino_hash, cancellable, &cache_error))
+        g_debug ("Failed to save devino cache: %s", cache_error->message);
+    }
+
+  return TRUE;
 }
 
 /**
@@ -1593,6 +2644,11 @@ ostree_repo_scan_hardlinks (OstreeRepo *self, GCancellable *cancellable, GError
  * on a single `OstreeRepo` instance as long as their lifetime is bounded by the
  * transaction.
  *
+ * Transactions in separate processes may run concurrently against the same
+ * repository, even when writing: object writes are idempotent, and the ref
+ * updates at the end of ostree_repo_commit_transaction() are serialized on a
+ * dedicated lock.
+ *
  * Locking: Acquires a `shared` lock; release via commit or abort
  * Multithreading: This function is *not* MT safe; only one transaction can be
  * active at a time.
@@ -1674,19 +2730,15 @@ ostree_repo_prepare_transaction (OstreeRepo *self, gboolean *out_transaction_res
   return TRUE;
 }
 
-/* Synchronize the directories holding the objects */
+/* Synchronize the directories under one object root */
 static gboolean
-fsync_object_dirs (OstreeRepo *self, GCancellable *cancellable, GError **error)
+fsync_one_object_root (int root_dfd, GCancellable *cancellable, GError **error)
 {
-  GLNX_AUTO_PREFIX_ERROR ("fsync objdirs", error);
   g_auto (GLnxDirFdIterator) dfd_iter = {
     0,
   };
 
-  if (self->disable_fsync)
-    return TRUE; /* No fsync?  Nothing to do then. */
-
-  if (!glnx_dirfd_iterator_init_at (self->objects_dir_fd, ".", FALSE, &dfd_iter, error))
+  if (!glnx_dirfd_iterator_init_at (root_dfd, ".", FALSE, &dfd_iter, error))
     return FALSE;
   while (TRUE)
     {
@@ -1702,7 +2754,7 @@ fsync_object_dirs (OstreeRepo *self, GCancellable *cancellable, GError **error)
         continue;
 
       glnx_autofd int target_dir_fd = -1;
-      if (!glnx_opendirat (self->objects_dir_fd, dent->d_name, FALSE, &target_dir_fd, error))
+      if (!glnx_opendirat (root_dfd, dent->d_name, FALSE, &target_dir_fd, error))
         return FALSE;
       /* This synchronizes the directory to ensure all the objects we wrote
        * are there.  We need to do this before removing the .commitpartial
@@ -1713,12 +2765,46 @@ fsync_object_dirs (OstreeRepo *self, GCancellable *cancellable, GError **error)
     }
 
   /* In case we created any loose object subdirs, make sure they are on disk */
-  if (fsync (self->objects_dir_fd) == -1)
+  if (fsync (root_dfd) == -1)
     return glnx_throw_errno_prefix (error, "fsync");
 
   return TRUE;
 }
 
+/* Synchronize the directories holding the objects */
+static gboolean
+fsync_object_dirs (OstreeRepo *self, GCancellable *cancellable, GError **error)
+{
+  GLNX_AUTO_PREFIX_ERROR ("fsync objdirs", error);
+
+  if (self->disable_fsync)
+    return TRUE; /* No fsync?  Nothing to do then. */
+
+  if (!fsync_one_object_root (self->objects_dir_fd, cancellable, error))
+    return FALSE;
+  if (self->metadata_objects_dir_fd != -1
+      && !fsync_one_object_root (self->metadata_objects_dir_fd, cancellable, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Whether a loose object file name refers to a metadata object; used to route
+ * staged objects into the configured metadata root.  Unknown suffixes
+ * (including the archive "filez" suffix) are content.
+ */
+static gboolean
+loose_name_is_meta (const char *name)
+{
+  const char *dot = strrchr (name, '.');
+  if (dot == NULL)
+    return FALSE;
+  dot++;
+  return strcmp (dot, "commit") == 0 || strcmp (dot, "dirtree") == 0
+         || strcmp (dot, "dirmeta") == 0 || strcmp (dot, "commitmeta") == 0
+         || strcmp (dot, "tombstone-commit") == 0;
+}
+
 /* Called for commit, to iterate over the "staging" directory and rename all the
  * objects into the primary objects/ location. Notably this is called only after
  * syncfs() has potentially been invoked to ensure that all objects have been
@@ -1775,13 +2861,52 @@ rename_pending_loose_objects (OstreeRepo *self, GCancellable *cancellable, GErro
 
           g_strlcpy (loose_objpath + 3, child_dent->d_name, sizeof (loose_objpath) - 3);
 
-          if (!_ostree_repo_ensure_loose_objdir_at (self->objects_dir_fd, loose_objpath,
-                                                    cancellable, error))
-            return FALSE;
+          /* In batch-barrier mode the commit-time syncfs() is skipped, so
+           * make each staged file durable here instead.  Symlinks are
+           * covered by the directory fsyncs that follow the renames.
+           */
+          if (self->batch_fsync_barrier && !self->disable_fsync)
+            {
+              glnx_autofd int object_fd
+                  = openat (child_dfd_iter.fd, child_dent->d_name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+              if (object_fd < 0)
+                {
+                  if (errno != ELOOP)
+                    return glnx_throw_errno_prefix (error, "openat(%s)", loose_objpath);
+                }
+#ifdef HAVE_LIBURING
+              else if (self->use_io_uring)
+                {
+                  if (!uring_fsync_queue (self, object_fd, error))
+                    return FALSE;
+                }
+#endif
+              else if (fsync (object_fd) == -1)
+                return glnx_throw_errno_prefix (error, "fsync");
+            }
+
+          int dest_root_dfd = self->objects_dir_fd;
+          if (self->metadata_objects_dir_fd != -1 && loose_name_is_meta (child_dent->d_name))
+            dest_root_dfd = self->metadata_objects_dir_fd;
 
-          if (!glnx_renameat (child_dfd_iter.fd, loose_objpath + 3, self->objects_dir_fd,
-                              loose_objpath, error))
+          if (!_ostree_repo_ensure_loose_objdir_at (dest_root_dfd, loose_objpath, cancellable,
+                                                    error))
             return FALSE;
+
+          if (renameat (child_dfd_iter.fd, loose_objpath + 3, dest_root_dfd, loose_objpath) < 0)
+            {
+              if (errno != EXDEV)
+                return glnx_throw_errno_prefix (error, "renameat(%s)", loose_objpath);
+              /* The metadata root lives on a different filesystem */
+              if (!glnx_file_copy_at (child_dfd_iter.fd, loose_objpath + 3, NULL, dest_root_dfd,
+                                      loose_objpath,
+                                      GLNX_FILE_COPY_OVERWRITE | GLNX_FILE_COPY_NOXATTRS
+                                          | (self->disable_fsync ? 0 : GLNX_FILE_COPY_DATASYNC),
+                                      cancellable, error))
+                return FALSE;
+              if (!glnx_unlinkat (child_dfd_iter.fd, loose_objpath + 3, 0, error))
+                return FALSE;
+            }
         }
     }
 
@@ -1826,6 +2951,12 @@ cleanup_txn_dir (OstreeRepo *self, int dfd, const char *path, GCancellable *canc
   return TRUE;
 }
 
+/* Mtime of this file (in repo/tmp/cache, which the scan below skips) records
+ * when the last full tmpdir scan ran, so concurrent processes share the
+ * schedule.
+ */
+#define _OSTREE_TMP_CLEANUP_STAMP "tmp-cleanup-stamp"
+
 /* Look in repo/tmp and delete files that are older than a day (by default).
  * This used to be primarily used by the libsoup fetcher which stored partially
  * written objects.  In practice now that that isn't done anymore, we should
@@ -1838,6 +2969,25 @@ cleanup_tmpdir (OstreeRepo *self, GCancellable *cancellable, GError **error)
   GLNX_AUTO_PREFIX_ERROR ("tmpdir cleanup", error);
   const guint64 curtime_secs = g_get_real_time () / 1000000;
 
+  /* This runs at the end of every transaction, but the scan is O(entries) and
+   * only ever deletes things older than the expiry interval, so running it
+   * more often than that interval can't reap anything new.  Throttle on a
+   * stamp file; object staging itself is O_TMPFILE-based and leaves nothing
+   * here on a crash, so unthrottled littering is the rare case.  When the
+   * min-free-space handling asked us to reap the current staging directory we
+   * always scan.
+   */
+  if (!self->cleanup_stagedir && self->cache_dir_fd != -1)
+    {
+      struct stat stbuf;
+      if (!glnx_fstatat_allow_noent (self->cache_dir_fd, _OSTREE_TMP_CLEANUP_STAMP, &stbuf, 0,
+                                     error))
+        return FALSE;
+      if (errno != ENOENT && (guint64)stbuf.st_mtime <= curtime_secs
+          && curtime_secs - (guint64)stbuf.st_mtime < self->tmp_expiry_seconds)
+        return TRUE; /* Note early return */
+    }
+
   g_auto (GLnxDirFdIterator) dfd_iter = {
     0,
   };
@@ -1894,6 +3044,12 @@ cleanup_tmpdir (OstreeRepo *self, GCancellable *cancellable, GError **error)
         }
     }
 
+  /* Best-effort; a failure just means the next transaction scans again */
+  if (self->cache_dir_fd != -1)
+    (void)glnx_file_replace_contents_at (self->cache_dir_fd, _OSTREE_TMP_CLEANUP_STAMP,
+                                         (guint8 *)"", 0, GLNX_FILE_REPLACE_NODATASYNC, cancellable,
+                                         NULL);
+
   return TRUE;
 }
 
@@ -1939,18 +3095,26 @@ ostree_repo_mark_commit_partial_reason (OstreeRepo *self, const char *checksum,
         {
           if (errno != EEXIST)
             return glnx_throw_errno_prefix (error, "open(%s)", commitpartial_path);
+          /* An existing marker keeps its reason byte; the index already
+           * reflects it, so don't touch it. */
         }
       else
         {
+          OstreeRepoCommitState new_state = OSTREE_REPO_COMMIT_STATE_PARTIAL;
           if (in_state & OSTREE_REPO_COMMIT_STATE_FSCK_PARTIAL)
-            if (glnx_loop_write (fd, "f", 1) < 0)
-              return glnx_throw_errno_prefix (error, "write(%s)", commitpartial_path);
+            {
+              if (glnx_loop_write (fd, "f", 1) < 0)
+                return glnx_throw_errno_prefix (error, "write(%s)", commitpartial_path);
+              new_state |= OSTREE_REPO_COMMIT_STATE_FSCK_PARTIAL;
+            }
+          _ostree_repo_commit_state_index_update (self, checksum, new_state);
         }
     }
   else
     {
       if (!ot_ensure_unlinked_at (self->repo_dir_fd, commitpartial_path, 0))
         return FALSE;
+      _ostree_repo_commit_state_index_update (self, checksum, OSTREE_REPO_COMMIT_STATE_NORMAL);
     }
 
   return TRUE;
@@ -2205,10 +3369,25 @@ ostree_repo_commit_transaction (OstreeRepo *self, OstreeRepoTransactionStats *ou
   if ((self->test_error_flags & OSTREE_REPO_TEST_ERROR_PRE_COMMIT) > 0)
     return glnx_throw (error, "OSTREE_REPO_TEST_ERROR_PRE_COMMIT specified");
 
+  /* All queued fs-verity enablement must have completed (successfully)
+   * before the objects become visible via refs.
+   */
+  if (!_ostree_repo_fsverity_drain (self, error))
+    return FALSE;
+
+#ifdef HAVE_LIBURING
+  /* All queued object fsyncs must be durable before we move on to
+   * renames and ref updates.
+   */
+  if (!uring_fsync_drain (self, error))
+    return FALSE;
+#endif
+
   /* FIXME: Added OSTREE_SUPPRESS_SYNCFS since valgrind in el7 doesn't know
    * about `syncfs`...we should delete this later.
    */
-  if (!self->disable_fsync && g_getenv ("OSTREE_SUPPRESS_SYNCFS") == NULL)
+  if (!self->disable_fsync && !self->batch_fsync_barrier
+      && g_getenv ("OSTREE_SUPPRESS_SYNCFS") == NULL)
     {
       if (syncfs (self->tmp_dir_fd) < 0)
         return glnx_throw_errno_prefix (error, "syncfs");
@@ -2217,6 +3396,14 @@ ostree_repo_commit_transaction (OstreeRepo *self, OstreeRepoTransactionStats *ou
   if (!rename_pending_loose_objects (self, cancellable, error))
     return FALSE;
 
+#ifdef HAVE_LIBURING
+  /* Batch-barrier fsyncs queued during the renames above must complete
+   * before the directory fsyncs and ref updates.
+   */
+  if (!uring_fsync_drain (self, error))
+    return FALSE;
+#endif
+
   if (!fsync_object_dirs (self, cancellable, error))
     return FALSE;
 
@@ -2232,6 +3419,40 @@ ostree_repo_commit_transaction (OstreeRepo *self, OstreeRepoTransactionStats *ou
   if (self->loose_object_devino_hash)
     g_hash_table_remove_all (self->loose_object_devino_hash);
 
+  /* Everything up to here ran under the shared repo lock: object writes
+   * are idempotent, so transactions in other processes can stage and
+   * rename their objects concurrently.  What follows is read-modify-write
+   * cycles on state shared between branches — the commit-graph, loose
+   * refs plus the packed-refs index, and the summary — so take the
+   * cross-process refs lock for just this window.
+   */
+  g_auto (GLnxLockFile) reflock = {
+    0,
+  };
+  if ((self->txn.written_commits || self->txn.refs || self->txn.collection_refs)
+      && !_ostree_repo_refs_lock (self, &reflock, error))
+    return FALSE;
+
+  /* If a refcount-mode prune has been run against this repository,
+   * account each new commit's closure in the ledger; the objects are all
+   * in place at this point, so the traversal is a page-cache walk of
+   * metadata we just wrote.
+   */
+  if (self->txn.written_commits && _ostree_repo_refcount_ledger_exists (self))
+    {
+      if (!_ostree_repo_refcount_ledger_account_commits (self, self->txn.written_commits,
+                                                         cancellable, error))
+        return FALSE;
+    }
+
+  /* The objects are in place now, so the commit-graph can reference them */
+  if (self->txn.written_commits)
+    {
+      if (!_ostree_repo_commit_graph_append (self, self->txn.written_commits, cancellable, error))
+        return FALSE;
+      g_clear_pointer (&self->txn.written_commits, g_ptr_array_unref);
+    }
+
   if (self->txn.refs)
     if (!_ostree_repo_update_refs (self, self->txn.refs, cancellable, error))
       return FALSE;
@@ -2249,6 +3470,7 @@ ostree_repo_commit_transaction (OstreeRepo *self, OstreeRepoTransactionStats *ou
 
   g_clear_pointer (&self->txn.refs, g_hash_table_destroy);
   g_clear_pointer (&self->txn.collection_refs, g_hash_table_destroy);
+  g_clear_pointer (&self->txn.known_objects, g_hash_table_destroy);
 
   self->in_transaction = FALSE;
 
@@ -2299,11 +3521,25 @@ ostree_repo_abort_transaction (OstreeRepo *self, GCancellable *cancellable, GErr
 
   g_debug ("Aborting transaction in repository %p", self);
 
+  /* Wait for in-flight verity workers, ignoring errors since we're
+   * discarding the staged objects anyways.
+   */
+  (void)_ostree_repo_fsverity_drain (self, NULL);
+
+#ifdef HAVE_LIBURING
+  /* Reap outstanding fsyncs, ignoring errors since we're discarding
+   * the staged objects anyways.
+   */
+  (void)uring_fsync_drain (self, NULL);
+#endif
+
   if (self->loose_object_devino_hash)
     g_hash_table_remove_all (self->loose_object_devino_hash);
 
   g_clear_pointer (&self->txn.refs, g_hash_table_destroy);
   g_clear_pointer (&self->txn.collection_refs, g_hash_table_destroy);
+  g_clear_pointer (&self->txn.written_commits, g_ptr_array_unref);
+  g_clear_pointer (&self->txn.known_objects, g_hash_table_destroy);
 
   glnx_tmpdir_unset (&self->commit_stagedir);
   glnx_release_lock_file (&self->commit_stagedir_lock);
@@ -2858,6 +4094,192 @@ create_empty_gvariant_dict (void)
   return g_variant_builder_end (&builder);
 }
 
+/* An optional index over commit metadata, mapping (key, value) pairs for
+ * string-valued metadata entries (both inline and detached) to the commits
+ * carrying them.  It is maintained opportunistically as commits are written,
+ * so queries like "which commit has version=X" don't need to load every
+ * commit object; ostree_repo_find_commits_with_metadata() verifies each
+ * candidate against the actual objects, which keeps entries left behind by
+ * pruning or metadata rewrites harmless.
+ */
+#define COMMIT_METADATA_INDEX_NAME "commit-metadata-index"
+#define COMMIT_METADATA_INDEX_VERSION 1
+#define COMMIT_METADATA_INDEX_GVARIANT_STRING "(ua{sa{sas}})"
+
+/* Map of key → (map of value → set of commit checksums) */
+static GHashTable *
+commit_metadata_index_new_table (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                (GDestroyNotify)g_hash_table_unref);
+}
+
+static void
+commit_metadata_index_table_add (GHashTable *index, const char *key, const char *value,
+                                 const char *checksum)
+{
+  GHashTable *by_value = g_hash_table_lookup (index, key);
+  if (by_value == NULL)
+    {
+      by_value = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                        (GDestroyNotify)g_hash_table_unref);
+      g_hash_table_replace (index, g_strdup (key), by_value);
+    }
+  GHashTable *commits = g_hash_table_lookup (by_value, value);
+  if (commits == NULL)
+    {
+      commits = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      g_hash_table_replace (by_value, g_strdup (value), commits);
+    }
+  g_hash_table_add (commits, g_strdup (checksum));
+}
+
+/* Fill @index from the persistent index file; @out_loaded says whether an
+ * index of the current version was present.
+ */
+static gboolean
+commit_metadata_index_load (OstreeRepo *self, GHashTable *index, gboolean *out_loaded,
+                            GCancellable *cancellable, GError **error)
+{
+  *out_loaded = FALSE;
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (self->cache_dir_fd, COMMIT_METADATA_INDEX_NAME, &fd, error))
+    return FALSE;
+  if (fd == -1)
+    return TRUE;
+
+  g_autoptr (GVariant) cache = NULL;
+  if (!ot_variant_read_fd (fd, 0, G_VARIANT_TYPE (COMMIT_METADATA_INDEX_GVARIANT_STRING), FALSE,
+                           &cache, error))
+    return FALSE;
+
+  guint32 version;
+  g_autoptr (GVariant) entries_v = NULL;
+  g_variant_get (cache, "(u@a{sa{sas}})", &version, &entries_v);
+  if (version != COMMIT_METADATA_INDEX_VERSION)
+    return TRUE;
+
+  GVariantIter keys_iter;
+  g_variant_iter_init (&keys_iter, entries_v);
+  const char *key;
+  GVariant *by_value_v;
+  while (g_variant_iter_loop (&keys_iter, "{&s@a{sas}}", &key, &by_value_v))
+    {
+      GVariantIter values_iter;
+      g_variant_iter_init (&values_iter, by_value_v);
+      const char *value;
+      GVariant *commits_v;
+      while (g_variant_iter_loop (&values_iter, "{&s@as}", &value, &commits_v))
+        {
+          gsize n = g_variant_n_children (commits_v);
+          for (gsize i = 0; i < n; i++)
+            {
+              const char *checksum;
+              g_variant_get_child (commits_v, i, "&s", &checksum);
+              if (ostree_validate_checksum_string (checksum, NULL))
+                commit_metadata_index_table_add (index, key, value, checksum);
+            }
+        }
+    }
+
+  *out_loaded = TRUE;
+  return TRUE;
+}
+
+/* Serialize @index into the cache directory, replacing any previous
+ * version atomically.
+ */
+static gboolean
+commit_metadata_index_save (OstreeRepo *self, GHashTable *index, GCancellable *cancellable,
+                            GError **error)
+{
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  g_auto (GVariantBuilder) builder;
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (COMMIT_METADATA_INDEX_GVARIANT_STRING));
+  g_variant_builder_add (&builder, "u", (guint32)COMMIT_METADATA_INDEX_VERSION);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sa{sas}}"));
+  GLNX_HASH_TABLE_FOREACH_KV (index, const char *, key, GHashTable *, by_value)
+    {
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("{sa{sas}}"));
+      g_variant_builder_add (&builder, "s", key);
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sas}"));
+      GLNX_HASH_TABLE_FOREACH_KV (by_value, const char *, value, GHashTable *, commits)
+        {
+          g_variant_builder_open (&builder, G_VARIANT_TYPE ("{sas}"));
+          g_variant_builder_add (&builder, "s", value);
+          g_variant_builder_open (&builder, G_VARIANT_TYPE ("as"));
+          GLNX_HASH_TABLE_FOREACH (commits, const char *, checksum)
+            g_variant_builder_add (&builder, "s", checksum);
+          g_variant_builder_close (&builder);
+          g_variant_builder_close (&builder);
+        }
+      g_variant_builder_close (&builder);
+      g_variant_builder_close (&builder);
+    }
+  g_variant_builder_close (&builder);
+
+  g_autoptr (GVariant) cache = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  g_auto (GLnxTmpfile) tmpf = {
+    0,
+  };
+  if (!glnx_open_tmpfile_linkable_at (self->cache_dir_fd, ".", O_WRONLY | O_CLOEXEC, &tmpf, error))
+    return FALSE;
+  if (glnx_loop_write (tmpf.fd, g_variant_get_data (cache), g_variant_get_size (cache)) < 0)
+    return glnx_throw_errno_prefix (error, "write");
+  if (!glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, self->cache_dir_fd,
+                             COMMIT_METADATA_INDEX_NAME, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Record the string-valued entries of @metadata (of type a{sv}) for
+ * @checksum in the persistent metadata index.  Best-effort: writing the
+ * commit must not fail just because the cache directory is missing or
+ * racing with a concurrent writer.
+ */
+static void
+commit_metadata_index_add (OstreeRepo *self, const char *checksum, GVariant *metadata,
+                           GCancellable *cancellable)
+{
+  if (self->cache_dir_fd == -1 || metadata == NULL)
+    return;
+
+  gboolean have_strings = FALSE;
+  GVariantIter iter;
+  g_variant_iter_init (&iter, metadata);
+  const char *key;
+  GVariant *value;
+  while (g_variant_iter_loop (&iter, "{&sv}", &key, &value))
+    {
+      if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        have_strings = TRUE;
+    }
+  if (!have_strings)
+    return;
+
+  gboolean loaded = FALSE;
+  g_autoptr (GHashTable) index = commit_metadata_index_new_table ();
+  if (!commit_metadata_index_load (self, index, &loaded, cancellable, NULL))
+    return;
+
+  g_variant_iter_init (&iter, metadata);
+  while (g_variant_iter_loop (&iter, "{&sv}", &key, &value))
+    {
+      if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        commit_metadata_index_table_add (index, key, g_variant_get_string (value, NULL), checksum);
+    }
+
+  (void)commit_metadata_index_save (self, index, cancellable, NULL);
+}
+
 /**
  * ostree_repo_write_commit:
  * @self: Repo
@@ -2964,6 +4386,10 @@ ostree_repo_write_commit_with_time (OstreeRepo *self, const char *parent, const
     return FALSE;
 
   g_autofree char *ret_commit = ostree_checksum_from_bytes (commit_csum);
+
+  /* Opportunistically index the metadata for fast lookup later */
+  commit_metadata_index_add (self, ret_commit, new_metadata, cancellable);
+
   ot_transfer_out_value (out_commit, &ret_commit);
   return TRUE;
 }
@@ -2989,7 +4415,7 @@ ostree_repo_read_commit_detached_metadata (OstreeRepo *self, const char *checksu
   g_assert (out_metadata != NULL);
 
   char buf[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (buf, checksum, OSTREE_OBJECT_TYPE_COMMIT_META, self->mode);
+  _ostree_repo_loose_path (self, buf, checksum, OSTREE_OBJECT_TYPE_COMMIT_META);
 
   if (self->commit_stagedir.initialized)
     {
@@ -3000,9 +4426,17 @@ ostree_repo_read_commit_detached_metadata (OstreeRepo *self, const char *checksu
         return ot_variant_read_fd (fd, 0, G_VARIANT_TYPE ("a{sv}"), TRUE, out_metadata, error);
     }
 
+  const int objdir_fd
+      = _ostree_repo_objects_dir_fd_for_objtype (self, OSTREE_OBJECT_TYPE_COMMIT_META);
   glnx_autofd int fd = -1;
-  if (!ot_openat_ignore_enoent (self->objects_dir_fd, buf, &fd, error))
+  if (!ot_openat_ignore_enoent (objdir_fd, buf, &fd, error))
     return FALSE;
+  if (fd < 0
+      && _ostree_repo_loose_path_alternate (self, buf, checksum, OSTREE_OBJECT_TYPE_COMMIT_META))
+    {
+      if (!ot_openat_ignore_enoent (objdir_fd, buf, &fd, error))
+        return FALSE;
+    }
   if (fd != -1)
     return ot_variant_read_fd (fd, 0, G_VARIANT_TYPE ("a{sv}"), TRUE, out_metadata, error);
 
@@ -3036,9 +4470,12 @@ ostree_repo_write_commit_detached_metadata (OstreeRepo *self, const char *checks
   if (self->in_transaction)
     dest_dfd = self->commit_stagedir.fd;
   else
-    dest_dfd = self->objects_dir_fd;
+    dest_dfd = _ostree_repo_objects_dir_fd_for_objtype (self, OSTREE_OBJECT_TYPE_COMMIT_META);
+
+  char pathbuf[_OSTREE_LOOSE_PATH_MAX];
+  _ostree_repo_loose_path (self, pathbuf, checksum, OSTREE_OBJECT_TYPE_COMMIT_META);
 
-  if (!_ostree_repo_ensure_loose_objdir_at (dest_dfd, checksum, cancellable, error))
+  if (!_ostree_repo_ensure_loose_objdir_at (dest_dfd, pathbuf, cancellable, error))
     return FALSE;
 
   g_autoptr (GVariant) normalized = NULL;
@@ -3053,9 +4490,6 @@ ostree_repo_write_commit_detached_metadata (OstreeRepo *self, const char *checks
 
   if (data == NULL)
     data = (guint8 *)"";
-
-  char pathbuf[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (pathbuf, checksum, OSTREE_OBJECT_TYPE_COMMIT_META, self->mode);
   if (!glnx_file_replace_contents_at (dest_dfd, pathbuf, data, normalized_size, 0, cancellable,
                                       error))
     {
@@ -3063,6 +4497,134 @@ ostree_repo_write_commit_detached_metadata (OstreeRepo *self, const char *checks
       return FALSE;
     }
 
+  if (metadata != NULL)
+    commit_metadata_index_add (self, checksum, metadata, cancellable);
+
+  return TRUE;
+}
+
+/* Check whether @checksum (which may no longer exist) carries @key with the
+ * string @value, in either its inline or detached metadata.
+ */
+static gboolean
+commit_has_metadata_kv (OstreeRepo *self, const char *checksum, const char *key, const char *value,
+                        gboolean *out_matches, GCancellable *cancellable, GError **error)
+{
+  *out_matches = FALSE;
+
+  gboolean have_commit = FALSE;
+  if (!ostree_repo_has_object (self, OSTREE_OBJECT_TYPE_COMMIT, checksum, &have_commit,
+                               cancellable, error))
+    return FALSE;
+  if (!have_commit)
+    return TRUE;
+
+  g_autoptr (GVariant) commit = NULL;
+  if (!ostree_repo_load_variant (self, OSTREE_OBJECT_TYPE_COMMIT, checksum, &commit, error))
+    return FALSE;
+  g_autoptr (GVariant) inline_metadata = g_variant_get_child_value (commit, 0);
+  const char *found = NULL;
+  if (g_variant_lookup (inline_metadata, key, "&s", &found) && strcmp (found, value) == 0)
+    {
+      *out_matches = TRUE;
+      return TRUE;
+    }
+
+  g_autoptr (GVariant) detached = NULL;
+  if (!ostree_repo_read_commit_detached_metadata (self, checksum, &detached, cancellable, error))
+    return FALSE;
+  if (detached != NULL && g_variant_lookup (detached, key, "&s", &found)
+      && strcmp (found, value) == 0)
+    *out_matches = TRUE;
+
+  return TRUE;
+}
+
+static gint
+cmp_checksum_strings (gconstpointer a, gconstpointer b)
+{
+  return strcmp (*(const char *const *)a, *(const char *const *)b);
+}
+
+/**
+ * ostree_repo_find_commits_with_metadata:
+ * @self: Repo
+ * @key: Metadata key
+ * @value: Metadata value
+ * @out_commits: (out) (transfer full) (array zero-terminated=1): Checksums of matching commits
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Find commits whose metadata contains @key with the string @value,
+ * considering both inline commit metadata and detached metadata.
+ *
+ * Commits written by this version of libostree maintain a persistent index
+ * over string-valued metadata keys, which makes this query cheap even on
+ * repositories with a large number of commits.  Candidates from the index
+ * are verified against the actual objects, so entries left behind by
+ * pruning or metadata rewrites are never returned.  When no index is
+ * available (for example on repositories populated by older versions), this
+ * falls back to scanning every commit object.
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ * Since: 2023.6
+ */
+gboolean
+ostree_repo_find_commits_with_metadata (OstreeRepo *self, const char *key, const char *value,
+                                        char ***out_commits, GCancellable *cancellable,
+                                        GError **error)
+{
+  g_return_val_if_fail (key != NULL, FALSE);
+  g_return_val_if_fail (value != NULL, FALSE);
+
+  g_autoptr (GPtrArray) ret_commits = g_ptr_array_new_with_free_func (g_free);
+
+  gboolean index_loaded = FALSE;
+  g_autoptr (GHashTable) index = commit_metadata_index_new_table ();
+  if (!commit_metadata_index_load (self, index, &index_loaded, cancellable, error))
+    return FALSE;
+
+  if (index_loaded)
+    {
+      GHashTable *by_value = g_hash_table_lookup (index, key);
+      GHashTable *candidates = by_value ? g_hash_table_lookup (by_value, value) : NULL;
+      if (candidates != NULL)
+        {
+          GLNX_HASH_TABLE_FOREACH (candidates, const char *, checksum)
+            {
+              gboolean matches = FALSE;
+              if (!commit_has_metadata_kv (self, checksum, key, value, &matches, cancellable,
+                                           error))
+                return FALSE;
+              if (matches)
+                g_ptr_array_add (ret_commits, g_strdup (checksum));
+            }
+        }
+    }
+  else
+    {
+      /* No index; fall back to the historical full scan */
+      g_autoptr (GHashTable) commits = NULL;
+      if (!ostree_repo_list_commit_objects_starting_with (self, "", &commits, cancellable, error))
+        return FALSE;
+      GLNX_HASH_TABLE_FOREACH (commits, GVariant *, object)
+        {
+          const char *checksum;
+          OstreeObjectType objtype;
+          ostree_object_name_deserialize (object, &checksum, &objtype);
+          if (objtype != OSTREE_OBJECT_TYPE_COMMIT)
+            continue;
+          gboolean matches = FALSE;
+          if (!commit_has_metadata_kv (self, checksum, key, value, &matches, cancellable, error))
+            return FALSE;
+          if (matches)
+            g_ptr_array_add (ret_commits, g_strdup (checksum));
+        }
+    }
+
+  g_ptr_array_sort (ret_commits, cmp_checksum_strings);
+  g_ptr_array_add (ret_commits, NULL);
+  *out_commits = (char **)g_ptr_array_free (g_steal_pointer (&ret_commits), FALSE);
   return TRUE;
 }
 
@@ -3122,6 +4684,119 @@ create_tree_variant_from_hashes (GHashTable *file_checksums, GHashTable *dir_con
   return g_variant_ref_sink (serialized_tree);
 }
 
+/* Compiled skip patterns, one trie node per path component.  Literal
+ * components are hash lookups; components containing wildcards are kept in a
+ * (normally very short) list matched with fnmatch(3).  Multiple patterns
+ * share literal prefixes, so evaluation cost is bounded by path depth, not
+ * pattern count.
+ */
+typedef struct
+{
+  char *pattern;
+  OstreeRepoSkipNode *child;
+} OstreeRepoSkipPattern;
+
+struct OstreeRepoSkipNode
+{
+  GHashTable *literal_children; /* component → OstreeRepoSkipNode */
+  GPtrArray *pattern_children;  /* OstreeRepoSkipPattern */
+  gboolean terminal;            /* a pattern ends here; matches the subtree */
+};
+
+static void skip_node_free (OstreeRepoSkipNode *node);
+
+static void
+skip_pattern_free (gpointer data)
+{
+  OstreeRepoSkipPattern *pat = data;
+  g_free (pat->pattern);
+  skip_node_free (pat->child);
+  g_free (pat);
+}
+
+static void
+skip_node_free (OstreeRepoSkipNode *node)
+{
+  g_clear_pointer (&node->literal_children, g_hash_table_unref);
+  g_clear_pointer (&node->pattern_children, g_ptr_array_unref);
+  g_free (node);
+}
+
+static OstreeRepoSkipNode *
+skip_node_ensure_child (OstreeRepoSkipNode *node, const char *component)
+{
+  if (strpbrk (component, "*?[") != NULL)
+    {
+      if (node->pattern_children == NULL)
+        node->pattern_children = g_ptr_array_new_with_free_func (skip_pattern_free);
+      for (guint i = 0; i < node->pattern_children->len; i++)
+        {
+          OstreeRepoSkipPattern *pat = node->pattern_children->pdata[i];
+          if (g_str_equal (pat->pattern, component))
+            return pat->child;
+        }
+      OstreeRepoSkipPattern *pat = g_new0 (OstreeRepoSkipPattern, 1);
+      pat->pattern = g_strdup (component);
+      pat->child = g_new0 (OstreeRepoSkipNode, 1);
+      g_ptr_array_add (node->pattern_children, pat);
+      return pat->child;
+    }
+
+  if (node->literal_children == NULL)
+    node->literal_children = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                    (GDestroyNotify)skip_node_free);
+  OstreeRepoSkipNode *child = g_hash_table_lookup (node->literal_children, component);
+  if (child == NULL)
+    {
+      child = g_new0 (OstreeRepoSkipNode, 1);
+      g_hash_table_insert (node->literal_children, g_strdup (component), child);
+    }
+  return child;
+}
+
+/* Match @path (with or without remaining leading slashes) against the trie.
+ * Components are sliced out of @path in place; nothing is allocated.
+ */
+static gboolean
+skip_node_matches (const OstreeRepoSkipNode *node, const char *path)
+{
+  if (node->terminal)
+    return TRUE; /* Pattern prefix matched; skip the whole subtree */
+
+  while (*path == '/')
+    path++;
+  if (*path == '\0')
+    return FALSE;
+
+  const char *end = strchrnul (path, '/');
+  const size_t len = (size_t)(end - path);
+  char component[NAME_MAX + 1];
+  if (len > NAME_MAX)
+    return FALSE;
+  memcpy (component, path, len);
+  component[len] = '\0';
+
+  if (node->literal_children != NULL)
+    {
+      OstreeRepoSkipNode *child = g_hash_table_lookup (node->literal_children, component);
+      if (child != NULL && skip_node_matches (child, end))
+        return TRUE;
+    }
+
+  if (node->pattern_children != NULL)
+    {
+      for (guint i = 0; i < node->pattern_children->len; i++)
+        {
+          OstreeRepoSkipPattern *pat = node->pattern_children->pdata[i];
+          if (fnmatch (pat->pattern, component, 0) == 0 && skip_node_matches (pat->child, end))
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+
 /* If any filtering is set up, perform it, and return modified file info in
  * @out_modified_info. Note that if no filtering is applied, @out_modified_info
  * will simply be another reference (with incremented refcount) to @file_info.
@@ -3146,6 +4821,15 @@ _ostree_repo_commit_modifier_apply (OstreeRepo *self, OstreeRepoCommitModifier *
         canonicalize_perms = TRUE;
       if (modifier->filter != NULL)
         has_filter = TRUE;
+
+      /* Compiled skip patterns run first; the callback is the fallback for
+       * paths no pattern matched.
+       */
+      if (modifier->skip_trie != NULL && skip_node_matches (modifier->skip_trie, path))
+        {
+          *out_modified_info = g_object_ref (file_info);
+          return OSTREE_REPO_COMMIT_FILTER_SKIP; /* Note: early return */
+        }
     }
 
   if (!(canonicalize_perms || has_filter))
@@ -3207,7 +4891,41 @@ ptrarray_path_join (GPtrArray *path)
         }
     }
 
-  return g_string_free (path_buf, FALSE);
+  return g_string_free (path_buf, FALSE);
+}
+
+/* Committing an SELinux-labeled tree sees only a handful of distinct xattr
+ * sets (mostly security.selinux labels) across hundreds of thousands of
+ * files.  Intern the final per-file variants so identical sets share one
+ * allocation, and the lazy serialization that feeds the object checksum
+ * happens once per distinct set rather than once per file.  Distinct sets
+ * are few in practice; if a tree somehow exceeds the cap we just return
+ * the caller's variant uninterned.
+ */
+#define XATTR_INTERN_CACHE_MAX_ENTRIES 256
+
+static GVariant *
+intern_xattrs (OstreeRepo *self, GVariant *xattrs)
+{
+  GVariant *interned;
+
+  g_mutex_lock (&self->cache_lock);
+  if (self->xattr_intern_cache == NULL)
+    self->xattr_intern_cache
+        = g_hash_table_new_full (g_variant_hash, g_variant_equal, (GDestroyNotify)g_variant_unref,
+                                 NULL);
+
+  interned = g_hash_table_lookup (self->xattr_intern_cache, xattrs);
+  if (interned == NULL)
+    {
+      if (g_hash_table_size (self->xattr_intern_cache) < XATTR_INTERN_CACHE_MAX_ENTRIES)
+        g_hash_table_add (self->xattr_intern_cache, g_variant_ref (xattrs));
+      interned = xattrs;
+    }
+  interned = g_variant_ref (interned);
+  g_mutex_unlock (&self->cache_lock);
+
+  return interned;
 }
 
 static gboolean
@@ -3314,6 +5032,13 @@ get_final_xattrs (OstreeRepo *self, OstreeRepoCommitModifier *modifier, const ch
   if (original_xattrs && ret_xattrs && g_variant_equal (original_xattrs, ret_xattrs))
     modified = FALSE;
 
+  if (ret_xattrs)
+    {
+      GVariant *interned = intern_xattrs (self, ret_xattrs);
+      g_variant_unref (ret_xattrs);
+      ret_xattrs = interned;
+    }
+
   if (out_xattrs)
     *out_xattrs = g_steal_pointer (&ret_xattrs);
   if (out_modified)
@@ -3543,6 +5268,23 @@ write_content_to_mtree_internal (OstreeRepo *self, OstreeRepoFile *repo_dir,
   if (dir_enum != NULL)
     child = g_file_enumerator_get_child (dir_enum, child_info);
 
+  /* Fast path when merging from an existing repository tree with no
+   * transforming modifier (see modifier_allows_dirtree_reuse(), which gates
+   * @repo_dir): the object is already stored, so graft its checksum into the
+   * mtree instead of re-reading and re-checksumming the content.
+   */
+  if (repo_dir != NULL && child != NULL && OSTREE_IS_REPO_FILE (child) && !child_info_was_modified)
+    {
+      const char *existing_checksum = ostree_repo_file_get_checksum ((OstreeRepoFile *)child);
+      if (existing_checksum != NULL)
+        {
+          if (!ostree_mutable_tree_replace_file (mtree, name, existing_checksum, error))
+            return FALSE;
+          g_ptr_array_remove_index (path, path->len - 1);
+          return TRUE;
+        }
+    }
+
   /* Our filters have passed, etc.; now we prepare to write the content object */
   glnx_autofd int file_input_fd = -1;
 
@@ -3631,33 +5373,62 @@ write_content_to_mtree_internal (OstreeRepo *self, OstreeRepoFile *repo_dir,
     }
   else
     {
-      g_autoptr (GInputStream) file_input = NULL;
+      /* If the prehashing pool already computed this file's object checksum
+       * and the repository has the object, there's nothing to write.  We can
+       * only trust the prehashed value if the commit didn't modify metadata.
+       */
+      const char *prehashed_checksum = NULL;
+      gboolean have_prehashed_object = FALSE;
+      if (file_type == G_FILE_TYPE_REGULAR && dfd_iter != NULL && !modified_file_meta)
+        {
+          guint32 dev = g_file_info_get_attribute_uint32 (child_info, "unix::device");
+          guint64 inode = g_file_info_get_attribute_uint64 (child_info, "unix::inode");
+          prehashed_checksum = prehash_lookup (self, dev, inode);
+          if (prehashed_checksum != NULL
+              && !ostree_repo_has_object (self, OSTREE_OBJECT_TYPE_FILE, prehashed_checksum,
+                                          &have_prehashed_object, cancellable, error))
+            return FALSE;
+        }
 
-      if (file_type == G_FILE_TYPE_REGULAR)
+      if (have_prehashed_object)
         {
-          if (dir_enum != NULL)
-            {
-              g_assert (child != NULL);
-              file_input = (GInputStream *)g_file_read (child, cancellable, error);
-              if (!file_input)
-                return FALSE;
-            }
-          else
+          if (!ostree_mutable_tree_replace_file (mtree, name, prehashed_checksum, error))
+            return FALSE;
+        }
+      else
+        {
+          g_autoptr (GInputStream) file_input = NULL;
+
+          if (file_type == G_FILE_TYPE_REGULAR)
             {
-              /* We already opened the fd above */
-              file_input = g_unix_input_stream_new (file_input_fd, FALSE);
+              if (dir_enum != NULL)
+                {
+                  g_assert (child != NULL);
+                  file_input = (GInputStream *)g_file_read (child, cancellable, error);
+                  if (!file_input)
+                    return FALSE;
+                }
+              else
+                {
+                  /* We already opened the fd above */
+                  file_input = g_unix_input_stream_new (file_input_fd, FALSE);
+                }
             }
-        }
 
-      g_autofree guchar *child_file_csum = NULL;
-      if (!write_content_object (self, NULL, file_input, modified_info, xattrs, &child_file_csum,
-                                 cancellable, error))
-        return FALSE;
+          /* Note we don't pass the prehashed checksum as the expected one
+           * here; if the file changed under us in the meanwhile, we want the
+           * usual last-reader-wins semantics rather than an error.
+           */
+          g_autofree guchar *child_file_csum = NULL;
+          if (!write_content_object (self, NULL, file_input, modified_info, xattrs,
+                                     &child_file_csum, cancellable, error))
+            return FALSE;
 
-      char tmp_checksum[OSTREE_SHA256_STRING_LEN + 1];
-      ostree_checksum_inplace_from_bytes (child_file_csum, tmp_checksum);
-      if (!ostree_mutable_tree_replace_file (mtree, name, tmp_checksum, error))
-        return FALSE;
+          char tmp_checksum[OSTREE_SHA256_STRING_LEN + 1];
+          ostree_checksum_inplace_from_bytes (child_file_csum, tmp_checksum);
+          if (!ostree_mutable_tree_replace_file (mtree, name, tmp_checksum, error))
+            return FALSE;
+        }
     }
 
   /* Process delete_after_commit. In the adoption case though, we already
@@ -3674,6 +5445,26 @@ write_content_to_mtree_internal (OstreeRepo *self, OstreeRepoFile *repo_dir,
   return TRUE;
 }
 
+/* Whether @modifier (possibly %NULL) cannot affect content that already
+ * lives in the repository.  If so, directories backed by existing dirtree
+ * objects can be grafted into the mtree by checksum instead of being
+ * re-enumerated and re-filtered, which keeps unchanged subtrees lazy all the
+ * way through ostree_repo_write_mtree().  Flags that only change how
+ * on-disk sources are consumed don't disqualify reuse.
+ */
+static gboolean
+modifier_allows_dirtree_reuse (OstreeRepoCommitModifier *modifier)
+{
+  if (modifier == NULL)
+    return TRUE;
+  if (modifier->filter != NULL || modifier->skip_trie != NULL || modifier->xattr_callback != NULL
+      || modifier->sepolicy != NULL)
+    return FALSE;
+  const OstreeRepoCommitModifierFlags inert_flags = OSTREE_REPO_COMMIT_MODIFIER_FLAGS_CONSUME
+                                                    | OSTREE_REPO_COMMIT_MODIFIER_FLAGS_DEVINO_CANONICAL;
+  return (modifier->flags & ~inert_flags) == 0;
+}
+
 /* Handles the dirmeta for the given GFile dir and then calls
  * write_{dir_entry,content}_to_mtree_internal() for each directory entry. */
 static gboolean
@@ -3689,7 +5480,7 @@ write_directory_to_mtree_internal (OstreeRepo *self, GFile *dir, OstreeMutableTr
 
   /* If the directory is already in the repository, we can try to
    * reuse checksums to skip checksumming. */
-  if (dir && OSTREE_IS_REPO_FILE (dir) && modifier == NULL)
+  if (dir && OSTREE_IS_REPO_FILE (dir) && modifier_allows_dirtree_reuse (modifier))
     repo_dir = (OstreeRepoFile *)dir;
 
   if (repo_dir)
@@ -3839,6 +5630,16 @@ write_dfd_iter_to_mtree_internal (OstreeRepo *self, GLnxDirFdIterator *src_dfd_i
   if (dir_stbuf.st_dev == self->device)
     flags |= WRITE_DIR_CONTENT_FLAGS_CAN_ADOPT;
 
+  /* Hash this directory's regular files on all cores before the serial walk
+   * below.  Not useful for repos without xattrs, since there every file's
+   * returned xattrs count as modified, which disables the prehash fast path.
+   */
+  if (self->parallel_checksum_threads > 0 && !self->disable_xattrs)
+    {
+      if (!prehash_dfd_content (self, modifier, src_dfd_iter->fd, cancellable, error))
+        return FALSE;
+    }
+
   while (TRUE)
     {
       struct dirent *dent;
@@ -3971,21 +5772,263 @@ ostree_repo_write_dfd_to_mtree (OstreeRepo *self, int dfd, const char *path,
   return TRUE;
 }
 
+/* Compute and set @mtree's dirmeta from the on-disk directory at @fs_relpath
+ * (relative to @root_dfd), applying @modifier with @cb_relpath.  Used by the
+ * incremental commit path for ancestor directories the seeded tree doesn't
+ * know about yet.
+ */
+static gboolean
+write_dirmeta_from_dfd_path (OstreeRepo *self, int root_dfd, const char *fs_relpath,
+                             const char *cb_relpath, OstreeMutableTree *mtree,
+                             OstreeRepoCommitModifier *modifier,
+                             OstreeRepoCommitFilterResult *out_filter_result,
+                             GCancellable *cancellable, GError **error)
+{
+  glnx_autofd int dir_fd = -1;
+  if (!glnx_opendirat (root_dfd, fs_relpath, FALSE, &dir_fd, error))
+    return FALSE;
+
+  struct stat stbuf;
+  if (!glnx_fstat (dir_fd, &stbuf, error))
+    return FALSE;
+
+  g_autoptr (GFileInfo) child_info = _ostree_stbuf_to_gfileinfo (&stbuf);
+  g_autoptr (GFileInfo) modified_info = NULL;
+  OstreeRepoCommitFilterResult filter_result
+      = _ostree_repo_commit_modifier_apply (self, modifier, cb_relpath, child_info, &modified_info);
+  if (filter_result == OSTREE_REPO_COMMIT_FILTER_ALLOW)
+    {
+      g_autoptr (GVariant) xattrs = NULL;
+      if (!get_final_xattrs (self, modifier, cb_relpath, modified_info, NULL, dir_fd, NULL, NULL,
+                             &xattrs, NULL, cancellable, error))
+        return FALSE;
+
+      g_autofree guchar *csum = NULL;
+      if (!_ostree_repo_write_directory_meta (self, modified_info, xattrs, &csum, cancellable,
+                                              error))
+        return FALSE;
+
+      g_autofree char *tmp_checksum = ostree_checksum_from_bytes (csum);
+      ostree_mutable_tree_set_metadata_checksum (mtree, tmp_checksum);
+    }
+
+  *out_filter_result = filter_result;
+  return TRUE;
+}
+
+/* Apply one entry of a change list to a seeded mtree: re-commit the file or
+ * subtree at @changed_path, or drop it if it no longer exists on disk.
+ */
+static gboolean
+write_changed_path_to_mtree (OstreeRepo *self, int root_dfd, const char *changed_path,
+                             OstreeMutableTree *mtree, OstreeRepoCommitModifier *modifier,
+                             GCancellable *cancellable, GError **error)
+{
+  /* A change to the root itself; we can't do better than a full walk */
+  if (changed_path[0] == '\0' || g_str_equal (changed_path, ".") || g_str_equal (changed_path, "/"))
+    {
+      g_auto (GLnxDirFdIterator) dfd_iter = {
+        0,
+      };
+      if (!glnx_dirfd_iterator_init_at (root_dfd, ".", FALSE, &dfd_iter, error))
+        return FALSE;
+      g_autoptr (GPtrArray) pathbuilder = g_ptr_array_new ();
+      return write_dfd_iter_to_mtree_internal (self, &dfd_iter, mtree, modifier, pathbuilder,
+                                               cancellable, error);
+    }
+
+  g_autoptr (GPtrArray) components = NULL;
+  if (!ot_util_path_split_validate (changed_path, &components, error))
+    return FALSE;
+  g_assert (components->len > 0);
+
+  /* Descend to the parent, computing dirmeta for ancestors the seeded tree
+   * doesn't have yet (i.e. directories created since the previous commit).
+   */
+  g_autoptr (GPtrArray) pathbuilder = g_ptr_array_new ();
+  OstreeMutableTree *parent = mtree; /* borrowed */
+  for (guint i = 0; i + 1 < components->len; i++)
+    {
+      const char *name = components->pdata[i];
+      g_autoptr (OstreeMutableTree) subdir = NULL;
+      if (!ostree_mutable_tree_ensure_dir (parent, name, &subdir, error))
+        return FALSE;
+      g_ptr_array_add (pathbuilder, (char *)name);
+      if (ostree_mutable_tree_get_metadata_checksum (subdir) == NULL)
+        {
+          g_autofree char *dir_relpath = ptrarray_path_join (pathbuilder);
+          OstreeRepoCommitFilterResult filter_result;
+          /* Skip the leading '/' from ptrarray_path_join() for openat() */
+          if (!write_dirmeta_from_dfd_path (self, root_dfd, dir_relpath + 1, dir_relpath, subdir,
+                                            modifier, &filter_result, cancellable, error))
+            return FALSE;
+          if (filter_result != OSTREE_REPO_COMMIT_FILTER_ALLOW)
+            {
+              /* Newly created but filtered out; drop it again and we're done */
+              return ostree_mutable_tree_remove (parent, name, TRUE, error);
+            }
+        }
+      /* Borrowed; the parent's child table keeps it alive */
+      parent = subdir;
+    }
+
+  const char *filename = components->pdata[components->len - 1];
+  g_ptr_array_add (pathbuilder, (char *)filename);
+  g_autofree char *target_relpath = ptrarray_path_join (pathbuilder);
+  g_ptr_array_remove_index (pathbuilder, pathbuilder->len - 1);
+
+  struct stat stbuf;
+  if (!glnx_fstatat_allow_noent (root_dfd, target_relpath + 1, &stbuf, AT_SYMLINK_NOFOLLOW, error))
+    return FALSE;
+  if (errno == ENOENT)
+    {
+      /* Deleted since the previous commit */
+      return ostree_mutable_tree_remove (parent, filename, TRUE, error);
+    }
+
+  /* The entry may have changed type (or, for a directory, lost children);
+   * drop whatever the seeded tree has before re-adding it.
+   */
+  if (!ostree_mutable_tree_remove (parent, filename, TRUE, error))
+    return FALSE;
+
+  if (S_ISDIR (stbuf.st_mode))
+    {
+      g_autoptr (OstreeMutableTree) subdir = NULL;
+      if (!ostree_mutable_tree_ensure_dir (parent, filename, &subdir, error))
+        return FALSE;
+
+      g_auto (GLnxDirFdIterator) dfd_iter = {
+        0,
+      };
+      if (!glnx_dirfd_iterator_init_at (root_dfd, target_relpath + 1, FALSE, &dfd_iter, error))
+        return FALSE;
+
+      g_ptr_array_add (pathbuilder, (char *)filename);
+      if (!write_dfd_iter_to_mtree_internal (self, &dfd_iter, subdir, modifier, pathbuilder,
+                                             cancellable, error))
+        return FALSE;
+      g_ptr_array_remove_index (pathbuilder, pathbuilder->len - 1);
+
+      /* A filtered-out directory ends up with no metadata; drop it */
+      if (ostree_mutable_tree_get_metadata_checksum (subdir) == NULL)
+        return ostree_mutable_tree_remove (parent, filename, TRUE, error);
+      return TRUE;
+    }
+
+  g_autoptr (GFileInfo) child_info = _ostree_stbuf_to_gfileinfo (&stbuf);
+  g_file_info_set_name (child_info, filename);
+
+  g_auto (GLnxDirFdIterator) parent_iter = {
+    0,
+  };
+  g_autofree char *parent_relpath = ptrarray_path_join (pathbuilder);
+  const char *parent_fs_relpath = (pathbuilder->len == 0) ? "." : parent_relpath + 1;
+  if (!glnx_dirfd_iterator_init_at (root_dfd, parent_fs_relpath, FALSE, &parent_iter, error))
+    return FALSE;
+
+  if (S_ISLNK (stbuf.st_mode))
+    {
+      if (!ot_readlinkat_gfile_info (parent_iter.fd, filename, child_info, cancellable, error))
+        return FALSE;
+    }
+  else if (!S_ISREG (stbuf.st_mode))
+    return glnx_throw (error, "Not a regular file or symlink: %s", changed_path);
+
+  return write_content_to_mtree_internal (self, NULL, NULL, &parent_iter,
+                                          WRITE_DIR_CONTENT_FLAGS_NONE, child_info, parent,
+                                          modifier, pathbuilder, cancellable, error);
+}
+
 /**
- * ostree_repo_write_mtree:
+ * ostree_repo_write_dfd_changes_to_mtree:
  * @self: Repo
- * @mtree: Mutable tree
- * @out_file: (out): An #OstreeRepoFile representing @mtree's root.
+ * @dfd: Directory file descriptor
+ * @path: Path
+ * @changed_paths: (array zero-terminated=1): Paths relative to @path which changed
+ * @mtree: Tree seeded from a previous commit
+ * @modifier: (allow-none): Optional modifier
  * @cancellable: Cancellable
  * @error: Error
  *
- * Write all metadata objects for @mtree to repo; the resulting
- * @out_file points to the %OSTREE_OBJECT_TYPE_DIR_TREE object that
- * the @mtree represented.
+ * Incremental variant of ostree_repo_write_dfd_to_mtree().  Rather than
+ * walking the whole directory, only the entries named in @changed_paths
+ * (for example from an inotify/fanotify journal) are re-read from the
+ * filesystem and written into @mtree, which is expected to have been seeded
+ * from the previous commit via ostree_mutable_tree_new_from_commit().
+ * Untouched subtrees keep their previously computed dirtree checksums, so
+ * ostree_repo_write_mtree() only re-serializes directories along the changed
+ * paths.
+ *
+ * A path that no longer exists on disk removes the corresponding entry; a
+ * path naming a directory causes that subtree to be re-walked in full.  The
+ * commit @modifier is only consulted for the changed entries, not for
+ * unchanged content inherited from the previous commit.
+ *
+ * Since: 2023.6
  */
 gboolean
-ostree_repo_write_mtree (OstreeRepo *self, OstreeMutableTree *mtree, GFile **out_file,
-                         GCancellable *cancellable, GError **error)
+ostree_repo_write_dfd_changes_to_mtree (OstreeRepo *self, int dfd, const char *path,
+                                        const char *const *changed_paths, OstreeMutableTree *mtree,
+                                        OstreeRepoCommitModifier *modifier,
+                                        GCancellable *cancellable, GError **error)
+{
+  _ostree_repo_setup_generate_sizes (self, modifier);
+
+  glnx_autofd int root_dfd = -1;
+  if (!glnx_opendirat (dfd, path, TRUE, &root_dfd, error))
+    return FALSE;
+
+  for (const char *const *iter = changed_paths; iter != NULL && *iter != NULL; iter++)
+    {
+      if (!write_changed_path_to_mtree (self, root_dfd, *iter, mtree, modifier, cancellable,
+                                        error))
+        return glnx_prefix_error (error, "Processing changed path %s", *iter);
+    }
+
+  return TRUE;
+}
+
+/* Append the sorted (name, checksum) pairs of @name_to_checksum to @buf.
+ * Names are path components (no '/'), and checksums are hex, so '/' and
+ * '\n' are safe separators.
+ */
+static void
+dirtree_dedup_key_append (GString *buf, GHashTable *name_to_checksum)
+{
+  g_autoptr (GList) names = g_hash_table_get_keys (name_to_checksum);
+  names = g_list_sort (names, (GCompareFunc)strcmp);
+  for (GList *iter = names; iter != NULL; iter = iter->next)
+    {
+      const char *name = iter->data;
+      g_string_append (buf, name);
+      g_string_append_c (buf, '/');
+      g_string_append (buf, (const char *)g_hash_table_lookup (name_to_checksum, name));
+      g_string_append_c (buf, '\n');
+    }
+}
+
+/* Build a key uniquely identifying a dirtree's serialization from its
+ * children, without actually serializing.  Two directories with equal keys
+ * produce byte-identical OSTREE_OBJECT_TYPE_DIR_TREE objects.
+ */
+static char *
+dirtree_dedup_key (GHashTable *file_checksums, GHashTable *dir_contents_checksums,
+                   GHashTable *dir_metadata_checksums)
+{
+  GString *buf = g_string_new (NULL);
+  dirtree_dedup_key_append (buf, file_checksums);
+  g_string_append_c (buf, '\n');
+  dirtree_dedup_key_append (buf, dir_contents_checksums);
+  g_string_append_c (buf, '\n');
+  dirtree_dedup_key_append (buf, dir_metadata_checksums);
+  return g_string_free (buf, FALSE);
+}
+
+static gboolean
+write_mtree_internal (OstreeRepo *self, OstreeMutableTree *mtree, GHashTable *dirtree_dedup,
+                      GMutex *dedup_lock, GFile **out_file, GCancellable *cancellable,
+                      GError **error)
 {
   const char *contents_checksum, *metadata_checksum;
   g_autoptr (GFile) ret_file = NULL;
@@ -4019,7 +6062,8 @@ ostree_repo_write_mtree (OstreeRepo *self, OstreeMutableTree *mtree, GFile **out
                                   OstreeMutableTree *, child_dir)
         {
           g_autoptr (GFile) child_file = NULL;
-          if (!ostree_repo_write_mtree (self, child_dir, &child_file, cancellable, error))
+          if (!write_mtree_internal (self, child_dir, dirtree_dedup, dedup_lock, &child_file,
+                                     cancellable, error))
             return FALSE;
 
           g_hash_table_replace (dir_contents_checksums, g_strdup (name),
@@ -4030,18 +6074,49 @@ ostree_repo_write_mtree (OstreeRepo *self, OstreeMutableTree *mtree, GFile **out
                                     OSTREE_REPO_FILE (child_file))));
         }
 
-      serialized_tree = create_tree_variant_from_hashes (
+      /* Identical subtrees (think vendored copies of the same module tree)
+       * serialize to byte-identical dirtrees; key on the children so
+       * repeated copies reuse the checksum computed for the first one
+       * instead of re-serializing and re-hashing each copy.
+       */
+      g_autofree char *dedup_key = dirtree_dedup_key (
           ostree_mutable_tree_get_files (mtree), dir_contents_checksums, dir_metadata_checksums);
+      if (dedup_lock != NULL)
+        g_mutex_lock (dedup_lock);
+      /* Copy, not borrow: with parallel writers another thread may replace
+       * this entry after we drop the lock.
+       */
+      g_autofree char *dedup_checksum = g_strdup (g_hash_table_lookup (dirtree_dedup, dedup_key));
+      if (dedup_lock != NULL)
+        g_mutex_unlock (dedup_lock);
+      if (dedup_checksum != NULL)
+        {
+          ostree_mutable_tree_set_contents_checksum (mtree, dedup_checksum);
+          ret_file = G_FILE (_ostree_repo_file_new_root (self, dedup_checksum, metadata_checksum));
+        }
+      else
+        {
+          serialized_tree = create_tree_variant_from_hashes (
+              ostree_mutable_tree_get_files (mtree), dir_contents_checksums,
+              dir_metadata_checksums);
 
-      if (!ostree_repo_write_metadata (self, OSTREE_OBJECT_TYPE_DIR_TREE, NULL, serialized_tree,
-                                       &contents_csum, cancellable, error))
-        return FALSE;
+          if (!ostree_repo_write_metadata (self, OSTREE_OBJECT_TYPE_DIR_TREE, NULL, serialized_tree,
+                                           &contents_csum, cancellable, error))
+            return FALSE;
 
-      ostree_checksum_inplace_from_bytes (contents_csum, contents_checksum_buf);
-      ostree_mutable_tree_set_contents_checksum (mtree, contents_checksum_buf);
+          ostree_checksum_inplace_from_bytes (contents_csum, contents_checksum_buf);
+          ostree_mutable_tree_set_contents_checksum (mtree, contents_checksum_buf);
 
-      ret_file
-          = G_FILE (_ostree_repo_file_new_root (self, contents_checksum_buf, metadata_checksum));
+          if (dedup_lock != NULL)
+            g_mutex_lock (dedup_lock);
+          g_hash_table_replace (dirtree_dedup, g_steal_pointer (&dedup_key),
+                                g_strdup (contents_checksum_buf));
+          if (dedup_lock != NULL)
+            g_mutex_unlock (dedup_lock);
+
+          ret_file = G_FILE (
+              _ostree_repo_file_new_root (self, contents_checksum_buf, metadata_checksum));
+        }
     }
 
   if (out_file)
@@ -4049,6 +6124,180 @@ ostree_repo_write_mtree (OstreeRepo *self, OstreeMutableTree *mtree, GFile **out
   return TRUE;
 }
 
+/* Parallel writer for ostree_repo_write_mtree(): the immediate subtrees of
+ * the root are dispatched onto a worker pool (same work-queue shape as
+ * parallel checkout), each worker writing its subtree's dirtrees bottom-up,
+ * and the root dirtree is written after all workers drain — preserving the
+ * children-before-parent ordering the object model requires, with the
+ * commit object still written last by the caller.  write_metadata_object()
+ * is safe to call concurrently: the transaction stats take txn_lock and
+ * each write goes through a private tmpfile.  The dirtree dedup table is
+ * shared under a mutex; two workers can race serializing identical
+ * subtrees, in which case the loose-object existence check dedups the
+ * write on disk.
+ */
+typedef struct
+{
+  OstreeRepo *repo;          /* unowned */
+  GHashTable *dirtree_dedup; /* shared; protected by lock */
+  OtThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  guint outstanding;
+  GError *caught_error; /* first worker error wins */
+  GCancellable *cancellable;
+} WriteMtreeQueue;
+
+typedef struct
+{
+  WriteMtreeQueue *queue;
+  OstreeMutableTree *subtree; /* owned */
+} WriteMtreeItem;
+
+static void
+write_mtree_queue_worker (gpointer data, gpointer user_data)
+{
+  WriteMtreeItem *item = data;
+  WriteMtreeQueue *queue = item->queue;
+  g_autoptr (GError) local_error = NULL;
+
+  /* Don't bother starting new subtrees once something failed */
+  g_mutex_lock (&queue->lock);
+  const gboolean had_error = queue->caught_error != NULL;
+  g_mutex_unlock (&queue->lock);
+
+  if (!had_error)
+    {
+      /* This records the subtree's contents checksum in the mtree itself,
+       * so the later serial pass over the root short-circuits for it.
+       */
+      (void)write_mtree_internal (queue->repo, item->subtree, queue->dirtree_dedup, &queue->lock,
+                                  NULL, queue->cancellable, &local_error);
+    }
+
+  g_mutex_lock (&queue->lock);
+  if (local_error != NULL && queue->caught_error == NULL)
+    queue->caught_error = g_steal_pointer (&local_error);
+  g_assert_cmpuint (queue->outstanding, >, 0);
+  queue->outstanding--;
+  g_cond_signal (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+
+  g_object_unref (item->subtree);
+  g_free (item);
+}
+
+/**
+ * ostree_repo_write_mtree:
+ * @self: Repo
+ * @mtree: Mutable tree
+ * @out_file: (out): An #OstreeRepoFile representing @mtree's root.
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Write all metadata objects for @mtree to repo; the resulting
+ * @out_file points to the %OSTREE_OBJECT_TYPE_DIR_TREE object that
+ * the @mtree represented.
+ */
+gboolean
+ostree_repo_write_mtree (OstreeRepo *self, OstreeMutableTree *mtree, GFile **out_file,
+                         GCancellable *cancellable, GError **error)
+{
+  /* Maps dirtree_dedup_key() -> dirtree checksum for this write, so that
+   * duplicated subtrees are serialized and hashed only once.
+   */
+  g_autoptr (GHashTable) dirtree_dedup
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  /* Write the top-level subtrees in parallel when the checksum pool is
+   * enabled; sizes generation mutates an unlocked table, so keep that
+   * combination serial.
+   */
+  GHashTable *subdirs = ostree_mutable_tree_get_subdirs (mtree);
+  if (self->parallel_checksum_threads > 1 && !self->generate_sizes && subdirs != NULL
+      && g_hash_table_size (subdirs) > 1
+      && ostree_mutable_tree_get_contents_checksum (mtree) == NULL)
+    {
+      WriteMtreeQueue queue = {
+        0,
+      };
+      queue.repo = self;
+      queue.dirtree_dedup = dirtree_dedup;
+      queue.cancellable = cancellable;
+      g_mutex_init (&queue.lock);
+      g_cond_init (&queue.cond);
+      queue.pool = ot_thread_pool_new ("write-mtree", write_mtree_queue_worker, NULL,
+                                       self->parallel_checksum_threads);
+
+      GLNX_HASH_TABLE_FOREACH_V (subdirs, OstreeMutableTree *, child_dir)
+        {
+          WriteMtreeItem *item = g_new0 (WriteMtreeItem, 1);
+          item->queue = &queue;
+          item->subtree = g_object_ref (child_dir);
+          g_mutex_lock (&queue.lock);
+          queue.outstanding++;
+          g_mutex_unlock (&queue.lock);
+          ot_thread_pool_push (queue.pool, item);
+        }
+
+      g_mutex_lock (&queue.lock);
+      while (queue.outstanding > 0)
+        g_cond_wait (&queue.cond, &queue.lock);
+      g_autoptr (GError) caught_error = g_steal_pointer (&queue.caught_error);
+      g_mutex_unlock (&queue.lock);
+
+      ot_thread_pool_free (queue.pool);
+      g_cond_clear (&queue.cond);
+      g_mutex_clear (&queue.lock);
+
+      if (caught_error)
+        {
+          g_propagate_error (error, g_steal_pointer (&caught_error));
+          return FALSE;
+        }
+    }
+
+  return write_mtree_internal (self, mtree, dirtree_dedup, NULL, out_file, cancellable, error);
+}
+
+/**
+ * ostree_repo_commit_modifier_add_skip_pattern:
+ * @modifier: Modifier
+ * @pattern: An absolute path; components may contain fnmatch(3) wildcards
+ *
+ * Skip any file or directory whose commit path matches @pattern; matched
+ * directories are pruned recursively.  Each slash-separated component of
+ * @pattern is matched against the corresponding path component, literally
+ * where possible and with fnmatch(3) where the component contains
+ * wildcards.
+ *
+ * Patterns are compiled into a shared trie and evaluated before any
+ * filter callback passed to ostree_repo_commit_modifier_new(); the
+ * callback only runs for paths no pattern matched, so it can be used as a
+ * fallback for conditions patterns can't express.
+ *
+ * Since: 2023.6
+ */
+void
+ostree_repo_commit_modifier_add_skip_pattern (OstreeRepoCommitModifier *modifier,
+                                              const char *pattern)
+{
+  g_return_if_fail (pattern != NULL && pattern[0] == '/');
+
+  if (modifier->skip_trie == NULL)
+    modifier->skip_trie = g_new0 (OstreeRepoSkipNode, 1);
+
+  OstreeRepoSkipNode *node = modifier->skip_trie;
+  g_auto (GStrv) components = g_strsplit (pattern + 1, "/", -1);
+  for (char **it = components; *it != NULL; it++)
+    {
+      if (**it == '\0')
+        continue;
+      node = skip_node_ensure_child (node, *it);
+    }
+  node->terminal = TRUE;
+}
+
 /**
  * ostree_repo_commit_modifier_new:
  * @flags: Control options for filter
@@ -4097,6 +6346,7 @@ ostree_repo_commit_modifier_unref (OstreeRepoCommitModifier *modifier)
     modifier->xattr_destroy (modifier->xattr_user_data);
 
   g_clear_pointer (&modifier->devino_cache, g_hash_table_unref);
+  g_clear_pointer (&modifier->skip_trie, skip_node_free);
 
   g_clear_object (&modifier->sepolicy);
 
@@ -4219,6 +6469,13 @@ G_DEFINE_BOXED_TYPE (OstreeRepoDevInoCache, ostree_repo_devino_cache, ostree_rep
 G_DEFINE_BOXED_TYPE (OstreeRepoCommitModifier, ostree_repo_commit_modifier,
                      ostree_repo_commit_modifier_ref, ostree_repo_commit_modifier_unref);
 
+/* With _OSTREE_REPO_IMPORT_FLAGS_VERIFY_SAMPLE, fully checksum one in this
+ * many untrusted content objects.  The sample is keyed on the (metadata
+ * verified) object checksum, so repeated pulls probe the same objects and a
+ * corrupted source repo fails deterministically rather than intermittently.
+ */
+#define IMPORT_VERIFY_SAMPLE_MODULUS 16
+
 /* Special case between bare-user and bare-user-only,
  * mostly for https://github.com/flatpak/flatpak/issues/845
  * see below for any more comments.
@@ -4290,18 +6547,41 @@ import_one_object_direct (OstreeRepo *dest_repo, OstreeRepo *src_repo, const cha
       = glnx_strjoina ("Importing ", checksum, ".", ostree_object_type_to_string (objtype));
   GLNX_AUTO_PREFIX_ERROR (errprefix, error);
   char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (loose_path_buf, checksum, objtype, dest_repo->mode);
-
-  /* hardlinks require the owner to match and to be on the same device */
-  const gboolean can_hardlink
-      = src_repo->owner_uid == dest_repo->owner_uid && src_repo->device == dest_repo->device;
+  _ostree_repo_loose_path (dest_repo, loose_path_buf, checksum, objtype);
+
+  /* The repositories may use different fanout layouts; resolve where the
+   * source object actually lives.  The object suffix tracks the destination
+   * mode as before (the modes are compatible on this path). */
+  char src_path_buf[_OSTREE_LOOSE_PATH_MAX];
+  const int src_objdir_fd = _ostree_repo_objects_dir_fd_for_objtype (src_repo, objtype);
+  _ostree_loose_path_with_fanout (src_path_buf, checksum, objtype, dest_repo->mode,
+                                  src_repo->deep_fanout);
+  if (src_repo->deep_fanout)
+    {
+      struct stat stbuf;
+      if (TEMP_FAILURE_RETRY (fstatat (src_objdir_fd, src_path_buf, &stbuf, AT_SYMLINK_NOFOLLOW))
+              < 0
+          && errno == ENOENT)
+        _ostree_loose_path_with_fanout (src_path_buf, checksum, objtype, dest_repo->mode, FALSE);
+    }
 
   /* Find our target dfd */
   int dest_dfd;
   if (dest_repo->commit_stagedir.initialized)
     dest_dfd = dest_repo->commit_stagedir.fd;
   else
-    dest_dfd = dest_repo->objects_dir_fd;
+    dest_dfd = _ostree_repo_objects_dir_fd_for_objtype (dest_repo, objtype);
+
+  /* hardlinks require the owner to match and to be on the same device; a
+   * metadata root may live on a different device than its repository */
+  dev_t src_device = src_repo->device;
+  if (src_objdir_fd == src_repo->metadata_objects_dir_fd)
+    src_device = src_repo->metadata_objects_device;
+  dev_t dest_device = dest_repo->device;
+  if (dest_dfd == dest_repo->metadata_objects_dir_fd)
+    dest_device = dest_repo->metadata_objects_device;
+  const gboolean can_hardlink
+      = src_repo->owner_uid == dest_repo->owner_uid && src_device == dest_device;
 
   if (!_ostree_repo_ensure_loose_objdir_at (dest_dfd, loose_path_buf, cancellable, error))
     return FALSE;
@@ -4309,10 +6589,19 @@ import_one_object_direct (OstreeRepo *dest_repo, OstreeRepo *src_repo, const cha
   gboolean did_hardlink = FALSE;
   if (can_hardlink)
     {
-      if (linkat (src_repo->objects_dir_fd, loose_path_buf, dest_dfd, loose_path_buf, 0) != 0)
+      if (linkat (src_objdir_fd, src_path_buf, dest_dfd, loose_path_buf, 0) != 0)
         {
           if (errno == EEXIST)
             did_hardlink = TRUE;
+          else if (errno == ENOENT)
+            {
+              /* The source object may live in a pack file rather than as a
+               * loose file; tell the caller to fall back to the generic copy
+               * path, which reads through the pack-aware load APIs.
+               */
+              *out_was_supported = FALSE;
+              return TRUE;
+            }
           else if (errno == EMLINK || errno == EXDEV || errno == EPERM)
             {
               /* EMLINK, EXDEV and EPERM shouldn't be fatal; we just can't do
@@ -4334,9 +6623,15 @@ import_one_object_direct (OstreeRepo *dest_repo, OstreeRepo *src_repo, const cha
     {
       struct stat stbuf;
 
-      if (!glnx_fstatat (src_repo->objects_dir_fd, loose_path_buf, &stbuf, AT_SYMLINK_NOFOLLOW,
-                         error))
+      if (!glnx_fstatat_allow_noent (src_objdir_fd, src_path_buf, &stbuf,
+                                     AT_SYMLINK_NOFOLLOW, error))
         return FALSE;
+      if (errno == ENOENT)
+        {
+          /* Packed object; fall back to the generic copy path */
+          *out_was_supported = FALSE;
+          return TRUE;
+        }
 
       /* Let's punt for symlinks right now, it's more complicated */
       if (!S_ISREG (stbuf.st_mode))
@@ -4350,7 +6645,7 @@ import_one_object_direct (OstreeRepo *dest_repo, OstreeRepo *src_repo, const cha
        * in the future we should add flags for those things?
        */
       glnx_autofd int src_fd = -1;
-      if (!glnx_openat_rdonly (src_repo->objects_dir_fd, loose_path_buf, FALSE, &src_fd, error))
+      if (!glnx_openat_rdonly (src_objdir_fd, src_path_buf, FALSE, &src_fd, error))
         return FALSE;
 
       /* Open a tmpfile for dest */
@@ -4505,10 +6800,20 @@ _ostree_repo_import_object (OstreeRepo *self, OstreeRepo *source, OstreeObjectTy
       /* For local repositories, if the untrusted flag is set, we verify the
        * checksum first. This assumes then that the files are immutable - the
        * above check verified that the owner uids match.
+       *
+       * With VERIFY_SAMPLE, only a deterministic 1-in-N sample of content
+       * objects is checksummed; the expected checksums still come from
+       * (always-verified) metadata, so this catches source-repo corruption
+       * statistically while keeping the import mostly metadata-only.
        */
       if (!trusted)
         {
-          if (!ostree_repo_fsck_object (source, objtype, checksum, cancellable, error))
+          gboolean verify_this = TRUE;
+          if ((flags & _OSTREE_REPO_IMPORT_FLAGS_VERIFY_SAMPLE) > 0
+              && !OSTREE_OBJECT_TYPE_IS_META (objtype))
+            verify_this = (g_str_hash (checksum) % IMPORT_VERIFY_SAMPLE_MODULUS) == 0;
+          if (verify_this
+              && !ostree_repo_fsck_object (source, objtype, checksum, cancellable, error))
             return FALSE;
         }
 
@@ -320,7 +320,8 @@ checkout_one_composefs_file_at (OstreeRepo *repo, const char *checksum, struct l
   else if (source_size != 0)
     {
       char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
-      _ostree_loose_path (loose_path_buf, checksum, OSTREE_OBJECT_TYPE_FILE, OSTREE_REPO_MODE_BARE);
+      _ostree_loose_path_with_fanout (loose_path_buf, checksum, OSTREE_OBJECT_TYPE_FILE,
+                                      OSTREE_REPO_MODE_BARE, repo->deep_fanout);
       if (lcfs_node_set_payload (node, loose_path_buf) != 0)
         return glnx_throw_errno (error);
 
@@ -477,12 +478,6 @@ checkout_composefs_tree (OstreeRepo *self, OstreeComposefsTarget *target, Ostree
   if (g_file_info_get_file_type (source_info) != G_FILE_TYPE_DIRECTORY)
     return glnx_throw (error, "Root checkout of composefs must be directory");
 
-  /* Cache any directory metadata we read during this operation;
-   * see commit b7afe91e21143d7abb0adde440683a52712aa246
-   */
-  g_auto (OstreeRepoMemoryCacheRef) memcache_ref;
-  _ostree_repo_memory_cache_ref_init (&memcache_ref, self);
-
   g_assert_cmpint (g_file_info_get_file_type (source_info), ==, G_FILE_TYPE_DIRECTORY);
 
   const char *dirtree_checksum = ostree_repo_file_tree_get_contents_checksum (source);
@@ -612,3 +607,207 @@ ostree_repo_commit_add_composefs_metadata (OstreeRepo *self, guint format_versio
   return composefs_not_supported (error);
 #endif
 }
+
+/* Generated composefs images are cached under the repository's tmp/cache
+ * directory (which survives tmpdir cleanup), keyed by commit checksum: the
+ * image is a deterministic function of the commit's filesystem tree.  A
+ * sidecar file records the image's fs-verity digest so a later deployment
+ * can validate a cached image against the commit metadata without
+ * regenerating anything.
+ */
+#define COMPOSEFS_CACHE_DIR "composefs"
+/* Cap on cached images; enough to cover rollback→roll-forward cycles across
+ * a few deployments without growing the cache with every upgrade. */
+#define COMPOSEFS_CACHE_MAX_IMAGES 5
+
+static char *
+composefs_cache_image_name (const char *checksum)
+{
+  return g_strconcat (checksum, ".cfs", NULL);
+}
+
+static char *
+composefs_cache_digest_name (const char *checksum)
+{
+  return g_strconcat (checksum, ".cfs.digest", NULL);
+}
+
+/* Best-effort: drop the oldest cached images beyond the cap.  Errors here
+ * only mean the cache is larger than we'd like. */
+static void
+composefs_cache_prune (int cache_dfd)
+{
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (cache_dfd, ".", FALSE, &dfd_iter, NULL))
+    return;
+
+  g_autoptr (GPtrArray) images = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr (GArray) mtimes = g_array_new (FALSE, FALSE, sizeof (guint64));
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, NULL, NULL))
+        return;
+      if (dent == NULL)
+        break;
+      if (!g_str_has_suffix (dent->d_name, ".cfs"))
+        continue;
+
+      struct stat stbuf;
+      if (fstatat (cache_dfd, dent->d_name, &stbuf, AT_SYMLINK_NOFOLLOW) < 0)
+        continue;
+
+      guint64 mtime = stbuf.st_mtime;
+      g_ptr_array_add (images, g_strdup (dent->d_name));
+      g_array_append_val (mtimes, mtime);
+    }
+
+  while (images->len > COMPOSEFS_CACHE_MAX_IMAGES)
+    {
+      guint oldest = 0;
+      for (guint i = 1; i < images->len; i++)
+        {
+          if (g_array_index (mtimes, guint64, i) < g_array_index (mtimes, guint64, oldest))
+            oldest = i;
+        }
+
+      const char *image_name = images->pdata[oldest];
+      g_autofree char *digest_name = g_strconcat (image_name, ".digest", NULL);
+      (void)unlinkat (cache_dfd, image_name, 0);
+      (void)unlinkat (cache_dfd, digest_name, 0);
+      g_ptr_array_remove_index_fast (images, oldest);
+      g_array_remove_index_fast (mtimes, oldest);
+    }
+}
+
+/**
+ * _ostree_repo_composefs_cache_linkat:
+ * @self: Repo
+ * @checksum: Commit checksum the image was generated from
+ * @expected_fsverity_digest: (nullable): Digest from the commit metadata, if any
+ * @destination_dfd: Directory fd to link the image into
+ * @destination_name: Name (or relative path) for the new link
+ * @out_found: Set to %TRUE if a cached image was linked
+ * @out_fsverity_digest: (out): On a hit, the image's recorded fs-verity digest
+ *
+ * Try to reuse a previously generated composefs image for @checksum by
+ * hardlinking it out of the repository cache.  A missing or unusable cache
+ * entry is not an error; @out_found is just left %FALSE.  If
+ * @expected_fsverity_digest is non-%NULL, an entry whose recorded digest
+ * doesn't match is evicted and treated as a miss.
+ */
+gboolean
+_ostree_repo_composefs_cache_linkat (OstreeRepo *self, const char *checksum,
+                                     const guchar *expected_fsverity_digest, int destination_dfd,
+                                     const char *destination_name, gboolean *out_found,
+                                     guchar **out_fsverity_digest, GCancellable *cancellable,
+                                     GError **error)
+{
+  *out_found = FALSE;
+
+  /* No cache dir for read-only repos, or when OSTREE_SKIP_CACHE is set */
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  glnx_autofd int cache_dfd = glnx_opendirat_with_errno (self->cache_dir_fd, COMPOSEFS_CACHE_DIR, TRUE);
+  if (cache_dfd < 0)
+    {
+      if (errno == ENOENT)
+        return TRUE;
+      return glnx_throw_errno_prefix (error, "opendir(%s)", COMPOSEFS_CACHE_DIR);
+    }
+
+  g_autofree char *image_name = composefs_cache_image_name (checksum);
+  g_autofree char *digest_name = composefs_cache_digest_name (checksum);
+
+  g_autofree char *digest_hex = glnx_file_get_contents_utf8_at (cache_dfd, digest_name, NULL, cancellable, NULL);
+  if (digest_hex == NULL || strlen (g_strstrip (digest_hex)) != OSTREE_SHA256_STRING_LEN
+      || !ostree_validate_checksum_string (digest_hex, NULL))
+    {
+      /* An image without a (valid) digest is of no use to us */
+      (void)unlinkat (cache_dfd, image_name, 0);
+      (void)unlinkat (cache_dfd, digest_name, 0);
+      return TRUE;
+    }
+
+  g_autofree guchar *fsverity_digest = ostree_checksum_to_bytes (digest_hex);
+  if (expected_fsverity_digest != NULL
+      && memcmp (fsverity_digest, expected_fsverity_digest, OSTREE_SHA256_DIGEST_LEN) != 0)
+    {
+      /* Stale or corrupted entry; regenerate */
+      (void)unlinkat (cache_dfd, image_name, 0);
+      (void)unlinkat (cache_dfd, digest_name, 0);
+      return TRUE;
+    }
+
+  if (linkat (cache_dfd, image_name, destination_dfd, destination_name, 0) < 0)
+    {
+      /* The deployment may live on a different filesystem than the repo
+       * (EXDEV); in that and other unexpected cases just regenerate. */
+      if (errno == ENOENT)
+        (void)unlinkat (cache_dfd, digest_name, 0);
+      if (errno == ENOENT || errno == EXDEV || errno == EMLINK || errno == EPERM)
+        return TRUE;
+      return glnx_throw_errno_prefix (error, "linkat(%s)", image_name);
+    }
+
+  /* Freshen the entry so pruning is LRU-ish */
+  (void)utimensat (cache_dfd, image_name, NULL, 0);
+
+  *out_found = TRUE;
+  *out_fsverity_digest = g_steal_pointer (&fsverity_digest);
+  return TRUE;
+}
+
+/**
+ * _ostree_repo_composefs_cache_store:
+ * @self: Repo
+ * @checksum: Commit checksum the image was generated from
+ * @fsverity_digest: The image's fs-verity digest
+ * @src_dfd: Directory fd holding the freshly linked image
+ * @src_name: Name (or relative path) of the image under @src_dfd
+ *
+ * Record a just-generated composefs image in the repository cache via a
+ * hardlink, so later deployments of @checksum can reuse it.  Caching is
+ * strictly best-effort; failures are logged and swallowed.
+ */
+void
+_ostree_repo_composefs_cache_store (OstreeRepo *self, const char *checksum,
+                                    const guchar *fsverity_digest, int src_dfd,
+                                    const char *src_name, GCancellable *cancellable)
+{
+  g_autoptr (GError) local_error = NULL;
+
+  if (self->cache_dir_fd == -1)
+    return;
+
+  glnx_autofd int cache_dfd = -1;
+  if (!glnx_shutil_mkdir_p_at_open (self->cache_dir_fd, COMPOSEFS_CACHE_DIR, 0755, &cache_dfd,
+                                    cancellable, &local_error))
+    {
+      g_debug ("Failed to open composefs cache dir: %s", local_error->message);
+      return;
+    }
+
+  g_autofree char *image_name = composefs_cache_image_name (checksum);
+  g_autofree char *digest_name = composefs_cache_digest_name (checksum);
+
+  if (linkat (src_dfd, src_name, cache_dfd, image_name, 0) < 0 && errno != EEXIST)
+    {
+      g_debug ("Failed to cache composefs image %s: %s", image_name, g_strerror (errno));
+      return;
+    }
+
+  g_autofree char *digest_hex = ostree_checksum_from_bytes (fsverity_digest);
+  if (!glnx_file_replace_contents_at (cache_dfd, digest_name, (guint8 *)digest_hex,
+                                      strlen (digest_hex), 0, cancellable, &local_error))
+    {
+      g_debug ("Failed to write composefs image digest %s: %s", digest_name, local_error->message);
+      (void)unlinkat (cache_dfd, image_name, 0);
+      return;
+    }
+
+  composefs_cache_prune (cache_dfd);
+}
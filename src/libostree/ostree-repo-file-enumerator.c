@@ -32,7 +32,12 @@ struct _OstreeRepoFileEnumerator
   char *attributes;
   GFileQueryInfoFlags flags;
 
-  int index;
+  /* Decoded once on the first next_file() call; the per-child work is then
+   * just building the GFileInfo. */
+  GArray *entries;
+  GFileAttributeMatcher *matcher;
+
+  guint index;
 };
 
 #define ostree_repo_file_enumerator_get_type _ostree_repo_file_enumerator_get_type
@@ -52,6 +57,8 @@ ostree_repo_file_enumerator_dispose (GObject *object)
 
   g_clear_object (&self->dir);
   g_free (self->attributes);
+  g_clear_pointer (&self->entries, g_array_unref);
+  g_clear_pointer (&self->matcher, g_file_attribute_matcher_unref);
 
   if (G_OBJECT_CLASS (ostree_repo_file_enumerator_parent_class)->dispose)
     G_OBJECT_CLASS (ostree_repo_file_enumerator_parent_class)->dispose (object);
@@ -107,20 +114,28 @@ ostree_repo_file_enumerator_next_file (GFileEnumerator *enumerator, GCancellable
                                        GError **error)
 {
   OstreeRepoFileEnumerator *self = OSTREE_REPO_FILE_ENUMERATOR (enumerator);
-  gboolean ret = FALSE;
-  GFileInfo *info = NULL;
+  g_autoptr (GFileInfo) info = NULL;
+
+  if (self->entries == NULL)
+    {
+      if (!_ostree_repo_file_tree_get_entries (self->dir, &self->entries, error))
+        return NULL;
+      self->matcher = g_file_attribute_matcher_new (self->attributes);
+    }
+
+  /* End of enumeration */
+  if (self->index >= self->entries->len)
+    return NULL;
 
-  if (!ostree_repo_file_tree_query_child (self->dir, self->index, self->attributes, self->flags,
-                                          &info, cancellable, error))
-    goto out;
+  const OstreeRepoFileTreeEntry *entry
+      = &g_array_index (self->entries, OstreeRepoFileTreeEntry, self->index);
+  if (!_ostree_repo_file_tree_query_entry (self->dir, entry, self->matcher, self->flags, &info,
+                                           cancellable, error))
+    return NULL;
 
   self->index++;
 
-  ret = TRUE;
-out:
-  if (!ret)
-    g_clear_object (&info);
-  return info;
+  return g_steal_pointer (&info);
 }
 
 static gboolean
@@ -53,4 +53,27 @@ GFileEnumerator *_ostree_repo_file_enumerator_new (OstreeRepoFile *dir, const ch
                                                    GFileQueryInfoFlags flags,
                                                    GCancellable *cancellable, GError **error);
 
+/* One decoded child of a dirtree.  The name and checksum pointers borrow
+ * from the tree variant owned by the OstreeRepoFile and are valid for its
+ * lifetime.
+ */
+typedef struct
+{
+  const char *name;
+  gboolean is_dir;
+  const guchar *content_csum; /* Files: content object; dirs: tree object */
+  const guchar *meta_csum;    /* Dirs only, otherwise %NULL */
+} OstreeRepoFileTreeEntry;
+
+G_GNUC_INTERNAL
+gboolean _ostree_repo_file_tree_get_entries (OstreeRepoFile *self, GArray **out_entries,
+                                             GError **error);
+
+G_GNUC_INTERNAL
+gboolean _ostree_repo_file_tree_query_entry (OstreeRepoFile *self,
+                                             const OstreeRepoFileTreeEntry *entry,
+                                             GFileAttributeMatcher *matcher,
+                                             GFileQueryInfoFlags flags, GFileInfo **out_info,
+                                             GCancellable *cancellable, GError **error);
+
 G_END_DECLS
@@ -249,9 +249,17 @@ do_resolve_nonroot (OstreeRepoFile *self, GError **error)
       tree_metadata = NULL;
       self->tree_contents_checksum = ostree_checksum_from_bytes_v (contents_csum_v);
       self->tree_metadata_checksum = ostree_checksum_from_bytes_v (metadata_csum_v);
+      self->cached_file_checksum = g_strdup (self->tree_metadata_checksum);
     }
   else
-    self->index = i;
+    {
+      self->index = i;
+      /* We have the entry in hand; record its checksum now so that a later
+       * ostree_repo_file_get_checksum() doesn't redo the binary search.
+       */
+      g_variant_get_child (container, i, "(&s@ay)", NULL, &contents_csum_v);
+      self->cached_file_checksum = ostree_checksum_from_bytes_v (contents_csum_v);
+    }
 
   return TRUE;
 }
@@ -718,24 +726,90 @@ set_info_from_dirmeta (GFileInfo *info, GVariant *metadata)
   g_file_info_set_attribute_uint32 (info, "unix::mode", mode);
 }
 
+/* Attributes whose values require loading the object (or its dirmeta);
+ * everything else can be synthesized from the dirtree entry alone.  This
+ * must cover every attribute ostree_repo_load_file() and
+ * set_info_from_dirmeta() can produce.  standard::type is handled
+ * separately: it is free for directories but needs the object load to
+ * distinguish regular files from symlinks.
+ */
+static const char *load_requiring_attributes[]
+    = { "standard::size", "standard::is-symlink", "standard::symlink-target",
+        "unix::mode",     "unix::uid",            "unix::gid",
+        "unix::rdev",     "unix::device",         "unix::inode",
+        "unix::nlink",    "unix::blocks",         "time::modified",
+        "time::access",   "time::changed" };
+
+static gboolean
+matcher_requires_object_load (GFileAttributeMatcher *matcher)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (load_requiring_attributes); i++)
+    {
+      if (g_file_attribute_matcher_matches (matcher, load_requiring_attributes[i]))
+        return TRUE;
+    }
+  return FALSE;
+}
+
+/* Immutable per-object GFileInfo templates shared across queries.  Tree
+ * walks query the same content objects over and over (hardlinked files,
+ * repeated dirmetas), and building a full GFileInfo from scratch dominates
+ * the allocation profile of such walks.  Keyed by object checksum with a
+ * one-character kind prefix (file content vs dirmeta), so the cache is
+ * bounded by the number of distinct objects touched over the life of the
+ * repo handle.  Name attributes are never stored; callers stamp those onto
+ * a private copy.
+ */
+static GFileInfo *
+repo_file_info_cache_lookup (OstreeRepo *repo, char kind, const char *checksum)
+{
+  g_autofree char *key = g_strdup_printf ("%c.%s", kind, checksum);
+  g_mutex_lock (&repo->cache_lock);
+  GFileInfo *cached
+      = repo->file_info_cache ? g_hash_table_lookup (repo->file_info_cache, key) : NULL;
+  GFileInfo *ret = cached ? g_file_info_dup (cached) : NULL;
+  g_mutex_unlock (&repo->cache_lock);
+  return ret;
+}
+
+static void
+repo_file_info_cache_insert (OstreeRepo *repo, char kind, const char *checksum, GFileInfo *info)
+{
+  char *key = g_strdup_printf ("%c.%s", kind, checksum);
+  g_mutex_lock (&repo->cache_lock);
+  if (repo->file_info_cache == NULL)
+    repo->file_info_cache
+        = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  g_hash_table_replace (repo->file_info_cache, key, g_file_info_dup (info));
+  g_mutex_unlock (&repo->cache_lock);
+}
+
 static gboolean
 query_child_info_dir (OstreeRepo *repo, const char *metadata_checksum,
                       GFileAttributeMatcher *matcher, GFileQueryInfoFlags flags,
                       GFileInfo **out_info, GCancellable *cancellable, GError **error)
 {
-
-  g_autoptr (GFileInfo) ret_info = g_file_info_new ();
-
-  g_file_info_set_attribute_uint32 (ret_info, "standard::type", G_FILE_TYPE_DIRECTORY);
+  g_autoptr (GFileInfo) ret_info = NULL;
 
   if (g_file_attribute_matcher_matches (matcher, "unix::mode"))
     {
-      g_autoptr (GVariant) metadata = NULL;
-      if (!ostree_repo_load_variant (repo, OSTREE_OBJECT_TYPE_DIR_META, metadata_checksum,
-                                     &metadata, error))
-        return FALSE;
+      ret_info = repo_file_info_cache_lookup (repo, 'd', metadata_checksum);
+      if (ret_info == NULL)
+        {
+          g_autoptr (GVariant) metadata = NULL;
+          if (!ostree_repo_load_variant (repo, OSTREE_OBJECT_TYPE_DIR_META, metadata_checksum,
+                                         &metadata, error))
+            return FALSE;
 
-      set_info_from_dirmeta (ret_info, metadata);
+          ret_info = g_file_info_new ();
+          set_info_from_dirmeta (ret_info, metadata);
+          repo_file_info_cache_insert (repo, 'd', metadata_checksum, ret_info);
+        }
+    }
+  else
+    {
+      ret_info = g_file_info_new ();
+      g_file_info_set_attribute_uint32 (ret_info, "standard::type", G_FILE_TYPE_DIRECTORY);
     }
 
   ot_transfer_out_value (out_info, &ret_info);
@@ -792,6 +866,121 @@ ostree_repo_file_tree_find_child (OstreeRepoFile *self, const char *name, gboole
   return i;
 }
 
+/* Decode the dirtree of @self into a flat array of #OstreeRepoFileTreeEntry
+ * in a single pass, rather than re-extracting the files/dirs variants and
+ * re-parsing attribute strings for every child as
+ * ostree_repo_file_tree_query_child() does.  The entries borrow from the
+ * tree variant owned by @self; the serialized data stays valid for the
+ * lifetime of @self even though the per-child variants are released here.
+ */
+gboolean
+_ostree_repo_file_tree_get_entries (OstreeRepoFile *self, GArray **out_entries, GError **error)
+{
+  if (!ostree_repo_file_ensure_resolved (self, error))
+    return FALSE;
+
+  g_assert (self->tree_contents);
+
+  g_autoptr (GVariant) files_variant = g_variant_get_child_value (self->tree_contents, 0);
+  g_autoptr (GVariant) dirs_variant = g_variant_get_child_value (self->tree_contents, 1);
+
+  const guint n_files = g_variant_n_children (files_variant);
+  const guint n_dirs = g_variant_n_children (dirs_variant);
+  g_autoptr (GArray) ret_entries
+      = g_array_sized_new (FALSE, TRUE, sizeof (OstreeRepoFileTreeEntry), n_files + n_dirs);
+
+  for (guint i = 0; i < n_files; i++)
+    {
+      OstreeRepoFileTreeEntry entry = {
+        NULL,
+      };
+      g_autoptr (GVariant) csum_v = NULL;
+
+      g_variant_get_child (files_variant, i, "(&s@ay)", &entry.name, &csum_v);
+      entry.content_csum = ostree_checksum_bytes_peek_validate (csum_v, error);
+      if (entry.content_csum == NULL)
+        return glnx_prefix_error (error, "File %u in dirtree", i);
+
+      g_array_append_val (ret_entries, entry);
+    }
+
+  for (guint i = 0; i < n_dirs; i++)
+    {
+      OstreeRepoFileTreeEntry entry = {
+        NULL,
+      };
+      g_autoptr (GVariant) tree_csum_v = NULL;
+      g_autoptr (GVariant) meta_csum_v = NULL;
+
+      g_variant_get_child (dirs_variant, i, "(&s@ay@ay)", &entry.name, &tree_csum_v, &meta_csum_v);
+      entry.is_dir = TRUE;
+      entry.content_csum = ostree_checksum_bytes_peek_validate (tree_csum_v, error);
+      if (entry.content_csum == NULL)
+        return glnx_prefix_error (error, "Dir %u in dirtree", i);
+      entry.meta_csum = ostree_checksum_bytes_peek_validate (meta_csum_v, error);
+      if (entry.meta_csum == NULL)
+        return glnx_prefix_error (error, "Dir %u in dirtree", i);
+
+      g_array_append_val (ret_entries, entry);
+    }
+
+  ot_transfer_out_value (out_entries, &ret_entries);
+  return TRUE;
+}
+
+/* Build a #GFileInfo for one decoded dirtree entry.  Unlike
+ * ostree_repo_file_tree_query_child(), the caller provides the (already
+ * parsed) attribute matcher, so enumerating a large tree doesn't redo that
+ * work per child.
+ */
+gboolean
+_ostree_repo_file_tree_query_entry (OstreeRepoFile *self, const OstreeRepoFileTreeEntry *entry,
+                                    GFileAttributeMatcher *matcher, GFileQueryInfoFlags flags,
+                                    GFileInfo **out_info, GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GFileInfo) ret_info = NULL;
+  char tmp_checksum[OSTREE_SHA256_STRING_LEN + 1];
+
+  if (entry->is_dir)
+    {
+      ostree_checksum_inplace_from_bytes (entry->meta_csum, tmp_checksum);
+
+      if (!query_child_info_dir (self->repo, tmp_checksum, matcher, flags, &ret_info, cancellable,
+                                 error))
+        return FALSE;
+    }
+  else
+    {
+      ostree_checksum_inplace_from_bytes (entry->content_csum, tmp_checksum);
+
+      if (!matcher_requires_object_load (matcher)
+          && !g_file_attribute_matcher_matches (matcher, "standard::type"))
+        {
+          /* Name-only enumeration; no need to touch the object at all */
+          ret_info = g_file_info_new ();
+        }
+      else
+        {
+          ret_info = repo_file_info_cache_lookup (self->repo, 'f', tmp_checksum);
+          if (ret_info == NULL)
+            {
+              if (!ostree_repo_load_file (self->repo, tmp_checksum, NULL, &ret_info, NULL,
+                                          cancellable, error))
+                return FALSE;
+              repo_file_info_cache_insert (self->repo, 'f', tmp_checksum, ret_info);
+            }
+        }
+    }
+
+  g_file_info_set_attribute_byte_string (ret_info, "standard::name", entry->name);
+  g_file_info_set_attribute_string (ret_info, "standard::display-name", entry->name);
+  if (*entry->name == '.')
+    g_file_info_set_is_hidden (ret_info, TRUE);
+
+  ot_transfer_out_value (out_info, &ret_info);
+  return TRUE;
+}
+
 /**
  * ostree_repo_file_tree_query_child:
  * @self: #OstreeRepoFile
@@ -842,9 +1031,23 @@ ostree_repo_file_tree_query_child (OstreeRepoFile *self, int n, const char *attr
 
       ostree_checksum_inplace_from_bytes (csum_bytes, tmp_checksum);
 
-      if (!ostree_repo_load_file (self->repo, tmp_checksum, NULL, &ret_info, NULL, cancellable,
-                                  error))
-        goto out;
+      if (!matcher_requires_object_load (matcher)
+          && !g_file_attribute_matcher_matches (matcher, "standard::type"))
+        {
+          /* Name-only query; no need to touch the object at all */
+          ret_info = g_file_info_new ();
+        }
+      else
+        {
+          ret_info = repo_file_info_cache_lookup (self->repo, 'f', tmp_checksum);
+          if (ret_info == NULL)
+            {
+              if (!ostree_repo_load_file (self->repo, tmp_checksum, NULL, &ret_info, NULL,
+                                          cancellable, error))
+                goto out;
+              repo_file_info_cache_insert (self->repo, 'f', tmp_checksum, ret_info);
+            }
+        }
     }
   else
     {
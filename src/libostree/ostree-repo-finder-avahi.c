@@ -557,6 +557,69 @@ get_refs_and_checksums_from_summary (
   return TRUE;
 }
 
+/* Process-wide cache of summary files downloaded from peers, shared across all
+ * #OstreeRepoFinderAvahi instances in the process. Peers advertise the
+ * last-modified timestamp of their summary in the `st` TXT record, so a cached
+ * copy can be reused as long as the advertised timestamp still matches what we
+ * downloaded; the age limit guards against peers which fail to bump `st`. */
+typedef struct
+{
+  GBytes *summary_bytes; /* (nullable) if the peer has no summary file */
+  guint64 summary_timestamp;
+  gint64 cached_time_us; /* monotonic */
+} SummaryCacheEntry;
+
+static void
+summary_cache_entry_free (SummaryCacheEntry *entry)
+{
+  g_clear_pointer (&entry->summary_bytes, g_bytes_unref);
+  g_free (entry);
+}
+
+#define SUMMARY_CACHE_MAX_AGE_USEC (5 * 60 * G_USEC_PER_SEC)
+
+static GMutex summary_cache_lock;
+static GHashTable *summary_cache = NULL; /* (element-type utf8 SummaryCacheEntry) */
+
+/* Look up the summary file for the repository at @uri in the process-wide
+ * cache. Returns %TRUE on a hit, in which case @out_summary_bytes is set
+ * (possibly to %NULL, if the peer was previously seen to have no summary
+ * file). */
+static gboolean
+summary_cache_lookup (const gchar *uri, guint64 summary_timestamp, GBytes **out_summary_bytes)
+{
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&summary_cache_lock);
+  SummaryCacheEntry *entry;
+
+  if (summary_cache == NULL)
+    return FALSE;
+
+  entry = g_hash_table_lookup (summary_cache, uri);
+  if (entry == NULL || entry->summary_timestamp != summary_timestamp
+      || g_get_monotonic_time () - entry->cached_time_us > SUMMARY_CACHE_MAX_AGE_USEC)
+    return FALSE;
+
+  *out_summary_bytes = (entry->summary_bytes != NULL) ? g_bytes_ref (entry->summary_bytes) : NULL;
+  return TRUE;
+}
+
+static void
+summary_cache_insert (const gchar *uri, guint64 summary_timestamp, GBytes *summary_bytes)
+{
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&summary_cache_lock);
+  SummaryCacheEntry *entry;
+
+  if (summary_cache == NULL)
+    summary_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify)summary_cache_entry_free);
+
+  entry = g_new0 (SummaryCacheEntry, 1);
+  entry->summary_bytes = (summary_bytes != NULL) ? g_bytes_ref (summary_bytes) : NULL;
+  entry->summary_timestamp = summary_timestamp;
+  entry->cached_time_us = g_get_monotonic_time ();
+  g_hash_table_replace (summary_cache, g_strdup (uri), entry);
+}
+
 /* Download the summary file from @remote, and return the bytes of the file in
  * @out_summary_bytes. This will return %TRUE and set @out_summary_bytes to %NULL
  * if the summary file does not exist. */
@@ -627,18 +690,28 @@ G_DEFINE_TYPE_WITH_CODE (OstreeRepoFinderAvahi, ostree_repo_finder_avahi, G_TYPE
 
 #ifdef HAVE_AVAHI
 
-/* Download the summary file from @remote and fill in the checksums in the given
+/* Get the summary file from @remote — from the process-wide cache if the
+ * peer’s advertised @summary_timestamp matches a recent download, otherwise by
+ * downloading it — and fill in the checksums in the given
  * @supported_ref_to_checksum hash table, given the existing refs in it as keys.
  * See get_refs_and_checksums_from_summary() for more details. */
 static gboolean
 get_checksums (OstreeRepoFinderAvahi *finder, OstreeRepo *repo, OstreeRemote *remote,
+               const gchar *uri, guint64 summary_timestamp,
                GHashTable *supported_ref_to_checksum /* (element-type OstreeCollectionRef utf8) */,
                GError **error)
 {
   g_autoptr (GBytes) summary_bytes = NULL;
 
-  if (!fetch_summary_from_remote (repo, remote, &summary_bytes, finder->avahi_cancellable, error))
-    return FALSE;
+  if (summary_cache_lookup (uri, summary_timestamp, &summary_bytes))
+    g_debug ("Using cached summary for repo ‘%s’", uri);
+  else
+    {
+      if (!fetch_summary_from_remote (repo, remote, &summary_bytes, finder->avahi_cancellable,
+                                      error))
+        return FALSE;
+      summary_cache_insert (uri, summary_timestamp, summary_bytes);
+    }
 
   if (summary_bytes == NULL)
     {
@@ -817,7 +890,9 @@ ostree_avahi_service_build_repo_finder_result (OstreeAvahiService *service,
       g_key_file_set_boolean (remote->options, remote->group, "gpg-verify", TRUE);
       g_key_file_set_boolean (remote->options, remote->group, "gpg-verify-summary", FALSE);
 
-      get_checksums (finder, parent_repo, remote, supported_ref_to_checksum, &error);
+      get_checksums (finder, parent_repo, remote, repo->uri,
+                     GUINT64_FROM_BE (g_variant_get_uint64 (summary_timestamp)),
+                     supported_ref_to_checksum, &error);
       if (error != NULL)
         {
           g_debug ("Failed to get checksums for possible refs; ignoring: %s", error->message);
@@ -899,6 +974,38 @@ results_compare_cb (gconstpointer a, gconstpointer b)
   return ostree_repo_finder_result_compare (result_a, result_b);
 }
 
+typedef struct
+{
+  OstreeAvahiService *service;            /* (unowned) */
+  OstreeRepoFinderAvahi *finder;          /* (unowned) */
+  OstreeRepo *parent_repo;                /* (unowned) */
+  gint priority;
+  const OstreeCollectionRef *const *refs; /* (unowned) */
+  GPtrArray *results;                     /* (owned) (element-type OstreeRepoFinderResult) */
+} ServiceResolveData;
+
+static void
+service_resolve_data_free (ServiceResolveData *data)
+{
+  g_clear_pointer (&data->results, g_ptr_array_unref);
+  g_free (data);
+}
+
+/* Executed in a worker thread spawned by complete_all_pending_tasks(). The
+ * shared state it touches — the remote list on @parent_repo and the
+ * process-wide summary cache — is lock-protected; each worker accumulates into
+ * its own @results array. */
+static gpointer
+build_repo_finder_result_in_thread_cb (gpointer user_data)
+{
+  ServiceResolveData *data = user_data;
+
+  ostree_avahi_service_build_repo_finder_result (data->service, data->finder, data->parent_repo,
+                                                 data->priority, data->refs, data->results,
+                                                 data->finder->avahi_cancellable);
+  return NULL;
+}
+
 /* Executed in @self->avahi_context.
  *
  * For each of the pending resolve tasks in self->resolve_tasks, calculate and
@@ -929,20 +1036,50 @@ complete_all_pending_tasks (OstreeRepoFinderAvahi *self)
       refs = (const OstreeCollectionRef *const *)data->refs;
       results = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_repo_finder_result_free);
 
+      g_autoptr (GPtrArray) service_data
+          = g_ptr_array_new_with_free_func ((GDestroyNotify)service_resolve_data_free);
+      g_autoptr (GPtrArray) threads = g_ptr_array_new ();
+
+      /* Resolve all the discovered services concurrently. Each one potentially
+       * involves downloading the peer’s summary file, so resolving them one at
+       * a time serialises a network round trip per peer. Each worker gets its
+       * own result array; they are merged in service order below so the
+       * outcome stays deterministic. */
       for (j = 0; j < self->found_services->len; j++)
         {
-          OstreeAvahiService *service = g_ptr_array_index (self->found_services, j);
-
-          ostree_avahi_service_build_repo_finder_result (service, self, data->parent_repo, priority,
-                                                         refs, results, self->avahi_cancellable);
-          if (g_cancellable_is_cancelled (self->avahi_cancellable))
-            {
-              cancelled = TRUE;
-              break;
-            }
+          ServiceResolveData *sdata = g_new0 (ServiceResolveData, 1);
+
+          sdata->service = g_ptr_array_index (self->found_services, j);
+          sdata->finder = self;
+          sdata->parent_repo = data->parent_repo;
+          sdata->priority = priority;
+          sdata->refs = refs;
+          sdata->results
+              = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_repo_finder_result_free);
+
+          g_ptr_array_add (service_data, sdata);
+          g_ptr_array_add (threads, g_thread_new ("avahi-result",
+                                                  build_repo_finder_result_in_thread_cb, sdata));
+        }
+
+      for (j = 0; j < threads->len; j++)
+        g_thread_join (g_ptr_array_index (threads, j));
+
+      for (j = 0; j < service_data->len; j++)
+        {
+          ServiceResolveData *sdata = g_ptr_array_index (service_data, j);
+          gsize k;
+
+          for (k = 0; k < sdata->results->len; k++)
+            g_ptr_array_add (results, g_ptr_array_index (sdata->results, k));
+          g_ptr_array_set_free_func (sdata->results, NULL); /* ownership transferred */
+        }
+
+      if (g_cancellable_is_cancelled (self->avahi_cancellable))
+        {
+          cancelled = TRUE;
+          break;
         }
-      if (cancelled)
-        break;
 
       g_ptr_array_add (results_for_tasks, g_steal_pointer (&results));
     }
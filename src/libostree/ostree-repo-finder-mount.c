@@ -63,6 +63,14 @@
  * `.ostree/repos.d`. Any symlink which points outside the volume’s file
  * system will be ignored. Repositories are deduplicated in the results.
  *
+ * A volume may carry a precomputed index file at `.ostree/repos.d.index`,
+ * listing its repositories and their collection–refs. If present, the index is
+ * used instead of enumerating and opening the repositories, which is
+ * significantly faster for volumes carrying several large repositories. The
+ * index is advisory: entries are subject to the same volume-containment checks
+ * as enumerated repositories, and the finder falls back to enumeration if the
+ * index is missing or malformed.
+ *
  * The volume monitor used to find mounted volumes can be overridden by setting
  * #OstreeRepoFinderMount:monitor. By default, g_volume_monitor_get() is used.
  *
@@ -171,7 +179,7 @@ results_compare_cb (gconstpointer a, gconstpointer b)
 typedef struct
 {
   char *ordering_name; /* (owned) */
-  OstreeRepo *repo;    /* (owned) */
+  char *repo_path;     /* (owned) absolute path of the repository */
   GHashTable *refs;    /* (owned) (element-type OstreeCollectionRef utf8) */
 } RepoAndRefs;
 
@@ -179,7 +187,7 @@ static void
 repo_and_refs_clear (RepoAndRefs *data)
 {
   g_hash_table_unref (data->refs);
-  g_object_unref (data->repo);
+  g_free (data->repo_path);
   g_free (data->ordering_name);
 }
 
@@ -273,7 +281,8 @@ scan_and_add_repo (int dfd, const char *path, gboolean sortable, const char *mou
   if (scan_repo (dfd, path, mount_name, mount_root_stbuf, parent_repo, &repo, &repo_refs,
                  cancellable, NULL))
     {
-      RepoAndRefs val = { sortable ? g_strdup (path) : NULL, g_steal_pointer (&repo),
+      g_autofree char *repo_path = g_file_get_path (ostree_repo_get_path (repo));
+      RepoAndRefs val = { sortable ? g_strdup (path) : NULL, g_steal_pointer (&repo_path),
                           g_steal_pointer (&repo_refs) };
       g_array_append_val (inout_repos_refs, val);
 
@@ -282,99 +291,248 @@ scan_and_add_repo (int dfd, const char *path, gboolean sortable, const char *mou
     }
 }
 
-static void
-ostree_repo_finder_mount_resolve_async (OstreeRepoFinder *finder,
-                                        const OstreeCollectionRef *const *refs,
-                                        OstreeRepo *parent_repo, GCancellable *cancellable,
-                                        GAsyncReadyCallback callback, gpointer user_data)
+/* Well-known path (relative to the root of a mounted volume) of the optional
+ * repository index file, and its GVariant type: an array of (repository path
+ * relative to the mount root, array of (collection ID, ref name, checksum))
+ * entries, in the order the repositories should be searched. A provisioning
+ * tool can write this when it populates the volume, so the finder reads one
+ * small file instead of opening every repository under `.ostree/repos.d`. */
+#define MOUNT_INDEX_PATH ".ostree/repos.d.index"
+#define MOUNT_INDEX_GVARIANT_STRING "a(sa(sss))"
+#define MOUNT_INDEX_GVARIANT_FORMAT G_VARIANT_TYPE (MOUNT_INDEX_GVARIANT_STRING)
+
+/* Try to load the repository index from @mount_root_dfd and append an entry to
+ * @inout_repos_refs for each repository it lists, without opening the
+ * repositories themselves. Returns %FALSE — with nothing appended — if the
+ * index is absent or unusable, in which case the caller should fall back to
+ * enumerating the volume. Index entries get the same device and identity
+ * checks as opened repositories, so a stale or malicious index can’t point
+ * resolution outside the volume or back at @parent_repo. */
+static gboolean
+load_mount_index (int mount_root_dfd, const char *mount_root_path, const char *mount_name,
+                  const struct stat *mount_root_stbuf, OstreeRepo *parent_repo,
+                  GArray *inout_repos_refs, GCancellable *cancellable)
 {
-  OstreeRepoFinderMount *self = OSTREE_REPO_FINDER_MOUNT (finder);
-  g_autoptr (GTask) task = NULL;
-  g_autoptr (ObjectList) mounts = NULL;
-  g_autoptr (GPtrArray) results = NULL; /* (element-type OstreeRepoFinderResult) */
-  GList *l;
-  const gint priority = 50; /* arbitrarily chosen */
+  g_autoptr (GError) local_error = NULL;
 
-  task = g_task_new (finder, cancellable, callback, user_data);
-  g_task_set_source_tag (task, ostree_repo_finder_mount_resolve_async);
+  glnx_autofd int index_fd = -1;
+  if (!glnx_openat_rdonly (mount_root_dfd, MOUNT_INDEX_PATH, TRUE, &index_fd, &local_error))
+    {
+      if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        g_debug ("Ignoring index file on mount ‘%s’ as it could not be opened: %s", mount_name,
+                 local_error->message);
+      return FALSE;
+    }
 
-  mounts = g_volume_monitor_get_mounts (self->monitor);
-  results = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_repo_finder_result_free);
+  g_autoptr (GBytes) index_bytes = glnx_fd_readall_bytes (index_fd, cancellable, &local_error);
+  if (index_bytes == NULL)
+    {
+      g_debug ("Ignoring index file on mount ‘%s’ as it could not be read: %s", mount_name,
+               local_error->message);
+      return FALSE;
+    }
 
-  g_debug ("%s: Found %u mounts", G_STRFUNC, g_list_length (mounts));
+  g_autoptr (GVariant) index
+      = g_variant_ref_sink (g_variant_new_from_bytes (MOUNT_INDEX_GVARIANT_FORMAT, index_bytes,
+                                                      FALSE));
+  if (!g_variant_is_normal_form (index))
+    {
+      g_debug ("Ignoring index file on mount ‘%s’ as it is not in normal form", mount_name);
+      return FALSE;
+    }
+
+  guint old_len = inout_repos_refs->len;
+  GVariantIter repo_iter;
+  const char *repo_relpath;
+  GVariant *listed_refs;
 
-  for (l = mounts; l != NULL; l = l->next)
+  g_variant_iter_init (&repo_iter, index);
+  while (g_variant_iter_loop (&repo_iter, "(&s@a(sss))", &repo_relpath, &listed_refs))
     {
-      GMount *mount = G_MOUNT (l->data);
-      g_autofree gchar *mount_name = NULL;
-      g_autoptr (GFile) mount_root = NULL;
-      g_autofree gchar *mount_root_path = NULL;
-      glnx_autofd int mount_root_dfd = -1;
-      struct stat mount_root_stbuf;
-      glnx_autofd int repos_dfd = -1;
-      gsize i;
-      g_autoptr (GHashTable) repo_to_refs = NULL; /* (element-type UriAndKeyring GHashTable) */
-      GHashTable *supported_ref_to_checksum;      /* (element-type OstreeCollectionRef utf8) */
-      GHashTableIter iter;
-      g_autoptr (GError) local_error = NULL;
-
-      mount_name = g_mount_get_name (mount);
-
-      /* Check the mount’s general properties. */
-      if (g_mount_is_shadowed (mount))
+      /* Only plain relative paths within the volume are acceptable. */
+      if (repo_relpath[0] == '/' || strstr (repo_relpath, "..") != NULL)
         {
-          g_debug ("Ignoring mount ‘%s’ as it’s shadowed.", mount_name);
+          g_debug ("Ignoring indexed repository ‘%s’ on mount ‘%s’ due to an invalid path",
+                   repo_relpath, mount_name);
           continue;
         }
 
-      mount_root = g_mount_get_root (mount);
-      mount_root_path = g_file_get_path (mount_root);
+      glnx_autofd int repo_dfd = -1;
+      struct stat stbuf;
 
-      if (!glnx_opendirat (AT_FDCWD, mount_root_path, TRUE, &mount_root_dfd, &local_error))
+      if (!glnx_opendirat (mount_root_dfd, repo_relpath, TRUE, &repo_dfd, &local_error))
         {
-          g_debug ("Ignoring mount ‘%s’ as ‘%s’ directory can’t be opened: %s", mount_name,
-                   mount_root_path, local_error->message);
+          g_debug ("Ignoring indexed repository ‘%s’ on mount ‘%s’ as it could not be opened: %s",
+                   repo_relpath, mount_name, local_error->message);
+          g_clear_error (&local_error);
           continue;
         }
 
-#if GLIB_CHECK_VERSION(2, 55, 0)
-      G_GNUC_BEGIN_IGNORE_DEPRECATIONS /* remove once GLIB_VERSION_MAX_ALLOWED ≥ 2.56 */
-          g_autoptr (GUnixMountEntry) mount_entry
-          = g_unix_mount_at (mount_root_path, NULL);
+      if (!glnx_fstat (repo_dfd, &stbuf, &local_error))
+        {
+          g_debug ("Ignoring indexed repository ‘%s’ on mount ‘%s’ as querying its info failed: %s",
+                   repo_relpath, mount_name, local_error->message);
+          g_clear_error (&local_error);
+          continue;
+        }
 
-      if (mount_entry != NULL
-          && (g_unix_is_system_fs_type (g_unix_mount_get_fs_type (mount_entry))
-              || g_unix_is_system_device_path (g_unix_mount_get_device_path (mount_entry))))
+      if (stbuf.st_dev != mount_root_stbuf->st_dev)
         {
-          g_debug ("Ignoring mount ‘%s’ as its file system type (%s) or device "
-                   "path (%s) indicate it’s a system mount.",
-                   mount_name, g_unix_mount_get_fs_type (mount_entry),
-                   g_unix_mount_get_device_path (mount_entry));
+          g_debug ("Ignoring indexed repository ‘%s’ on mount ‘%s’ as it’s on a different file "
+                   "system from the mount",
+                   repo_relpath, mount_name);
           continue;
         }
-      G_GNUC_END_IGNORE_DEPRECATIONS
-#endif /* GLib 2.56.0 */
 
-      /* stat() the mount root so we can later check whether the resolved
-       * repositories for individual refs are on the same device (to avoid the
-       * symlinks for them pointing outside the mount root). */
-      if (!glnx_fstat (mount_root_dfd, &mount_root_stbuf, &local_error))
+      if (stbuf.st_dev == parent_repo->device && stbuf.st_ino == parent_repo->inode)
         {
-          g_debug ("Ignoring mount ‘%s’ as querying info of ‘%s’ failed: %s", mount_name,
-                   mount_root_path, local_error->message);
+          g_debug ("Ignoring indexed repository ‘%s’ on mount ‘%s’ as it is the same as the one "
+                   "we are resolving",
+                   repo_relpath, mount_name);
           continue;
         }
 
+      g_autoptr (GHashTable) repo_refs
+          = g_hash_table_new_full (ostree_collection_ref_hash, ostree_collection_ref_equal,
+                                   (GDestroyNotify)ostree_collection_ref_free, g_free);
+
+      GVariantIter ref_iter;
+      const char *collection_id, *ref_name, *checksum;
+
+      g_variant_iter_init (&ref_iter, listed_refs);
+      while (g_variant_iter_loop (&ref_iter, "(&s&s&s)", &collection_id, &ref_name, &checksum))
+        {
+          if (!ostree_validate_collection_id (collection_id, NULL)
+              || !ostree_validate_rev (ref_name, NULL)
+              || !ostree_validate_checksum_string (checksum, NULL))
+            {
+              g_debug ("Ignoring invalid indexed ref (%s, %s) on mount ‘%s’", collection_id,
+                       ref_name, mount_name);
+              continue;
+            }
+
+          g_hash_table_insert (repo_refs, ostree_collection_ref_new (collection_id, ref_name),
+                               g_strdup (checksum));
+        }
+
+      g_autofree char *repo_path = g_build_filename (mount_root_path, repo_relpath, NULL);
+      RepoAndRefs val = { g_strdup (repo_relpath), g_steal_pointer (&repo_path),
+                          g_steal_pointer (&repo_refs) };
+      g_array_append_val (inout_repos_refs, val);
+    }
+
+  g_debug ("%s: Loaded %u repositories from ‘%s’ on mount ‘%s’", G_STRFUNC,
+           inout_repos_refs->len - old_len, MOUNT_INDEX_PATH, mount_name);
+
+  return TRUE;
+}
+
+/* Worker data for resolving the refs against a single mount. All the pointers
+ * are unowned; they are kept alive by resolve_all_mounts_in_thread() for the
+ * duration of the workers. Each worker accumulates into its own @results
+ * array; the shared state it touches (the remote list on @parent_repo) is
+ * lock-protected. */
+typedef struct
+{
+  GMount *mount;
+  OstreeRepoFinder *finder;
+  const OstreeCollectionRef *const *refs;
+  OstreeRepo *parent_repo;
+  gint priority;
+  GCancellable *cancellable;
+  GPtrArray *results; /* (owned) (element-type OstreeRepoFinderResult) */
+} MountData;
+
+static void
+mount_data_free (MountData *data)
+{
+  g_clear_pointer (&data->results, g_ptr_array_unref);
+  g_free (data);
+}
+
+/* Scan a single mount for repositories containing any of the requested refs,
+ * appending one result per (uri, keyring) pair to @data->results. */
+static void
+resolve_mount (MountData *data)
+{
+  GMount *mount = data->mount;
+  const OstreeCollectionRef *const *refs = data->refs;
+  OstreeRepo *parent_repo = data->parent_repo;
+  GCancellable *cancellable = data->cancellable;
+  g_autofree gchar *mount_name = NULL;
+  g_autoptr (GFile) mount_root = NULL;
+  g_autofree gchar *mount_root_path = NULL;
+  glnx_autofd int mount_root_dfd = -1;
+  struct stat mount_root_stbuf;
+  glnx_autofd int repos_dfd = -1;
+  gsize i;
+  g_autoptr (GHashTable) repo_to_refs = NULL; /* (element-type UriAndKeyring GHashTable) */
+  GHashTable *supported_ref_to_checksum;      /* (element-type OstreeCollectionRef utf8) */
+  GHashTableIter iter;
+  g_autoptr (GError) local_error = NULL;
+
+  mount_name = g_mount_get_name (mount);
+
+  /* Check the mount’s general properties. */
+  if (g_mount_is_shadowed (mount))
+    {
+      g_debug ("Ignoring mount ‘%s’ as it’s shadowed.", mount_name);
+      return;
+    }
+
+  mount_root = g_mount_get_root (mount);
+  mount_root_path = g_file_get_path (mount_root);
+
+  if (!glnx_opendirat (AT_FDCWD, mount_root_path, TRUE, &mount_root_dfd, &local_error))
+    {
+      g_debug ("Ignoring mount ‘%s’ as ‘%s’ directory can’t be opened: %s", mount_name,
+               mount_root_path, local_error->message);
+      return;
+    }
+
+#if GLIB_CHECK_VERSION(2, 55, 0)
+  G_GNUC_BEGIN_IGNORE_DEPRECATIONS /* remove once GLIB_VERSION_MAX_ALLOWED ≥ 2.56 */
+      g_autoptr (GUnixMountEntry) mount_entry
+      = g_unix_mount_at (mount_root_path, NULL);
+
+  if (mount_entry != NULL
+      && (g_unix_is_system_fs_type (g_unix_mount_get_fs_type (mount_entry))
+          || g_unix_is_system_device_path (g_unix_mount_get_device_path (mount_entry))))
+    {
+      g_debug ("Ignoring mount ‘%s’ as its file system type (%s) or device "
+               "path (%s) indicate it’s a system mount.",
+               mount_name, g_unix_mount_get_fs_type (mount_entry),
+               g_unix_mount_get_device_path (mount_entry));
+      return;
+    }
+  G_GNUC_END_IGNORE_DEPRECATIONS
+#endif /* GLib 2.56.0 */
+
+  /* stat() the mount root so we can later check whether the resolved
+   * repositories for individual refs are on the same device (to avoid the
+   * symlinks for them pointing outside the mount root). */
+  if (!glnx_fstat (mount_root_dfd, &mount_root_stbuf, &local_error))
+    {
+      g_debug ("Ignoring mount ‘%s’ as querying info of ‘%s’ failed: %s", mount_name,
+               mount_root_path, local_error->message);
+      return;
+    }
+
+  /* (element-type GHashTable (element-type OstreeCollectionRef utf8)) */
+  g_autoptr (GArray) repos_refs = g_array_new (FALSE, TRUE, sizeof (RepoAndRefs));
+  g_array_set_clear_func (repos_refs, (GDestroyNotify)repo_and_refs_clear);
+
+  /* If the volume carries a precomputed repository index, use it instead of
+   * opening every repository; its entries are already in search order. */
+  if (!load_mount_index (mount_root_dfd, mount_root_path, mount_name, &mount_root_stbuf,
+                         parent_repo, repos_refs, cancellable))
+    {
       /* Check if it contains a .ostree/repos.d directory. If not, move on and
        * try the other well-known subdirectories. */
       if (!glnx_opendirat (mount_root_dfd, ".ostree/repos.d", TRUE, &repos_dfd, NULL))
         repos_dfd = -1;
 
       /* List all the repositories in the repos.d directory. */
-      /* (element-type GHashTable (element-type OstreeCollectionRef utf8)) */
-      g_autoptr (GArray) repos_refs = g_array_new (FALSE, TRUE, sizeof (RepoAndRefs));
-      g_array_set_clear_func (repos_refs, (GDestroyNotify)repo_and_refs_clear);
-
       GLnxDirFdIterator repos_iter;
 
       if (repos_dfd >= 0
@@ -425,115 +583,185 @@ ostree_repo_finder_mount_resolve_async (OstreeRepoFinder *finder,
       for (i = 0; i < G_N_ELEMENTS (well_known_repos); i++)
         scan_and_add_repo (mount_root_dfd, well_known_repos[i], FALSE, mount_name,
                            &mount_root_stbuf, parent_repo, repos_refs, cancellable);
+    }
 
-      /* Check whether a subdirectory exists for any of the @refs we’re looking
-       * for. If so, and it’s a symbolic link, dereference it so multiple links
-       * to the same repository (containing multiple refs) are coalesced.
-       * Otherwise, include it as a result by itself. */
-      repo_to_refs = g_hash_table_new_full (uri_and_keyring_hash, uri_and_keyring_equal,
-                                            (GDestroyNotify)uri_and_keyring_free,
-                                            (GDestroyNotify)g_hash_table_unref);
+  /* Check whether a subdirectory exists for any of the @refs we’re looking
+   * for. If so, and it’s a symbolic link, dereference it so multiple links
+   * to the same repository (containing multiple refs) are coalesced.
+   * Otherwise, include it as a result by itself. */
+  repo_to_refs = g_hash_table_new_full (uri_and_keyring_hash, uri_and_keyring_equal,
+                                        (GDestroyNotify)uri_and_keyring_free,
+                                        (GDestroyNotify)g_hash_table_unref);
+
+  for (i = 0; refs[i] != NULL; i++)
+    {
+      const OstreeCollectionRef *ref = refs[i];
+      g_autofree gchar *resolved_repo_uri = NULL;
+      g_autoptr (UriAndKeyring) resolved_repo = NULL;
 
-      for (i = 0; refs[i] != NULL; i++)
+      for (gsize j = 0; j < repos_refs->len; j++)
         {
-          const OstreeCollectionRef *ref = refs[i];
-          g_autofree gchar *resolved_repo_uri = NULL;
-          g_autoptr (UriAndKeyring) resolved_repo = NULL;
+          const RepoAndRefs *repo_and_refs = &g_array_index (repos_refs, RepoAndRefs, j);
+          GHashTable *repo_refs = repo_and_refs->refs;
+          const char *repo_path = repo_and_refs->repo_path;
+          g_autoptr (OstreeRemote) keyring_remote = NULL;
 
-          for (gsize j = 0; j < repos_refs->len; j++)
+          const gchar *checksum = g_hash_table_lookup (repo_refs, ref);
+
+          if (checksum == NULL)
             {
-              const RepoAndRefs *repo_and_refs = &g_array_index (repos_refs, RepoAndRefs, j);
-              OstreeRepo *repo = repo_and_refs->repo;
-              GHashTable *repo_refs = repo_and_refs->refs;
-              g_autofree char *repo_path = g_file_get_path (ostree_repo_get_path (repo));
-              g_autoptr (OstreeRemote) keyring_remote = NULL;
+              g_debug ("Ignoring repository ‘%s’ when looking for ref (%s, %s) on mount ‘%s’ "
+                       "as it doesn’t contain the ref.",
+                       repo_path, ref->collection_id, ref->ref_name, mount_name);
+              g_clear_error (&local_error);
+              continue;
+            }
 
-              const gchar *checksum = g_hash_table_lookup (repo_refs, ref);
+          /* Finally, look up the GPG keyring for this ref. */
+          keyring_remote = ostree_repo_resolve_keyring_for_collection (
+              parent_repo, ref->collection_id, cancellable, &local_error);
 
-              if (checksum == NULL)
-                {
-                  g_debug ("Ignoring repository ‘%s’ when looking for ref (%s, %s) on mount ‘%s’ "
-                           "as it doesn’t contain the ref.",
-                           repo_path, ref->collection_id, ref->ref_name, mount_name);
-                  g_clear_error (&local_error);
-                  continue;
-                }
+          if (keyring_remote == NULL)
+            {
+              g_debug ("Ignoring repository ‘%s’ when looking for ref (%s, %s) on mount ‘%s’ "
+                       "due to missing keyring: %s",
+                       repo_path, ref->collection_id, ref->ref_name, mount_name,
+                       local_error->message);
+              g_clear_error (&local_error);
+              continue;
+            }
 
-              /* Finally, look up the GPG keyring for this ref. */
-              keyring_remote = ostree_repo_resolve_keyring_for_collection (
-                  parent_repo, ref->collection_id, cancellable, &local_error);
+          /* There is a valid repo at (or pointed to by)
+           * $mount_root/.ostree/repos.d/$something.
+           * Add it to the results, keyed by the canonicalised repository URI
+           * to deduplicate the results. */
+          g_autofree char *canonical_repo_path = realpath (repo_path, NULL);
+          resolved_repo_uri = g_strconcat ("file://", canonical_repo_path, NULL);
+          g_debug ("Resolved ref (%s, %s) on mount ‘%s’ to repo URI ‘%s’ with keyring ‘%s’ "
+                   "from remote ‘%s’.",
+                   ref->collection_id, ref->ref_name, mount_name, resolved_repo_uri,
+                   keyring_remote->keyring, keyring_remote->name);
 
-              if (keyring_remote == NULL)
-                {
-                  g_debug ("Ignoring repository ‘%s’ when looking for ref (%s, %s) on mount ‘%s’ "
-                           "due to missing keyring: %s",
-                           repo_path, ref->collection_id, ref->ref_name, mount_name,
-                           local_error->message);
-                  g_clear_error (&local_error);
-                  continue;
-                }
+          resolved_repo = uri_and_keyring_new (resolved_repo_uri, keyring_remote);
 
-              /* There is a valid repo at (or pointed to by)
-               * $mount_root/.ostree/repos.d/$something.
-               * Add it to the results, keyed by the canonicalised repository URI
-               * to deduplicate the results. */
-              g_autofree char *canonical_repo_path = realpath (repo_path, NULL);
-              resolved_repo_uri = g_strconcat ("file://", canonical_repo_path, NULL);
-              g_debug ("Resolved ref (%s, %s) on mount ‘%s’ to repo URI ‘%s’ with keyring ‘%s’ "
-                       "from remote ‘%s’.",
-                       ref->collection_id, ref->ref_name, mount_name, resolved_repo_uri,
-                       keyring_remote->keyring, keyring_remote->name);
+          supported_ref_to_checksum = g_hash_table_lookup (repo_to_refs, resolved_repo);
 
-              resolved_repo = uri_and_keyring_new (resolved_repo_uri, keyring_remote);
+          if (supported_ref_to_checksum == NULL)
+            {
+              supported_ref_to_checksum = g_hash_table_new_full (
+                  ostree_collection_ref_hash, ostree_collection_ref_equal, NULL, g_free);
+              g_hash_table_insert (repo_to_refs, g_steal_pointer (&resolved_repo),
+                                   supported_ref_to_checksum /* transfer */);
+            }
 
-              supported_ref_to_checksum = g_hash_table_lookup (repo_to_refs, resolved_repo);
+          g_hash_table_insert (supported_ref_to_checksum, (gpointer)ref, g_strdup (checksum));
 
-              if (supported_ref_to_checksum == NULL)
-                {
-                  supported_ref_to_checksum = g_hash_table_new_full (
-                      ostree_collection_ref_hash, ostree_collection_ref_equal, NULL, g_free);
-                  g_hash_table_insert (repo_to_refs, g_steal_pointer (&resolved_repo),
-                                       supported_ref_to_checksum /* transfer */);
-                }
+          /* We’ve found a result for this collection–ref. No point in checking
+           * the other repos on the mount, since pulling in parallel from them won’t help. */
+          break;
+        }
+    }
 
-              g_hash_table_insert (supported_ref_to_checksum, (gpointer)ref, g_strdup (checksum));
+  /* Aggregate the results. */
+  g_hash_table_iter_init (&iter, repo_to_refs);
 
-              /* We’ve found a result for this collection–ref. No point in checking
-               * the other repos on the mount, since pulling in parallel from them won’t help. */
-              break;
-            }
-        }
+  UriAndKeyring *repo;
+  while (
+      g_hash_table_iter_next (&iter, (gpointer *)&repo, (gpointer *)&supported_ref_to_checksum))
+    {
+      g_autoptr (OstreeRemote) remote = NULL;
+
+      /* Build an #OstreeRemote. Use the escaped URI, since remote->name
+       * is used in file paths, so needs to not contain special characters. */
+      g_autofree gchar *name = uri_and_keyring_to_name (repo);
+      remote = ostree_remote_new_dynamic (name, repo->keyring_remote->name);
+
+      g_clear_pointer (&remote->keyring, g_free);
+      remote->keyring = g_strdup (repo->keyring_remote->keyring);
+
+      /* gpg-verify-summary is false since we use the unsigned summary file support. */
+      g_key_file_set_string (remote->options, remote->group, "url", repo->uri);
+      g_key_file_set_boolean (remote->options, remote->group, "gpg-verify", TRUE);
+      g_key_file_set_boolean (remote->options, remote->group, "gpg-verify-summary", FALSE);
+
+      /* Set the timestamp in the #OstreeRepoFinderResult to 0 because
+       * the code in ostree_repo_pull_from_remotes_async() will be able to
+       * check it just as quickly as we can here; so don’t duplicate the
+       * code. */
+      g_ptr_array_add (data->results,
+                       ostree_repo_finder_result_new (remote, data->finder, data->priority,
+                                                      supported_ref_to_checksum, NULL, 0));
+    }
+}
 
-      /* Aggregate the results. */
-      g_hash_table_iter_init (&iter, repo_to_refs);
+static gpointer
+resolve_mount_in_thread_cb (gpointer user_data)
+{
+  resolve_mount (user_data);
+  return NULL;
+}
 
-      UriAndKeyring *repo;
-      while (
-          g_hash_table_iter_next (&iter, (gpointer *)&repo, (gpointer *)&supported_ref_to_checksum))
-        {
-          g_autoptr (OstreeRemote) remote = NULL;
-
-          /* Build an #OstreeRemote. Use the escaped URI, since remote->name
-           * is used in file paths, so needs to not contain special characters. */
-          g_autofree gchar *name = uri_and_keyring_to_name (repo);
-          remote = ostree_remote_new_dynamic (name, repo->keyring_remote->name);
-
-          g_clear_pointer (&remote->keyring, g_free);
-          remote->keyring = g_strdup (repo->keyring_remote->keyring);
-
-          /* gpg-verify-summary is false since we use the unsigned summary file support. */
-          g_key_file_set_string (remote->options, remote->group, "url", repo->uri);
-          g_key_file_set_boolean (remote->options, remote->group, "gpg-verify", TRUE);
-          g_key_file_set_boolean (remote->options, remote->group, "gpg-verify-summary", FALSE);
-
-          /* Set the timestamp in the #OstreeRepoFinderResult to 0 because
-           * the code in ostree_repo_pull_from_remotes_async() will be able to
-           * check it just as quickly as we can here; so don’t duplicate the
-           * code. */
-          g_ptr_array_add (results,
-                           ostree_repo_finder_result_new (remote, finder, priority,
-                                                          supported_ref_to_checksum, NULL, 0));
-        }
+typedef struct
+{
+  OstreeCollectionRef **refs; /* (owned) (array zero-terminated=1) */
+  OstreeRepo *parent_repo;    /* (owned) */
+  ObjectList *mounts;         /* (owned) */
+} ResolveData;
+
+static void
+resolve_data_free (ResolveData *data)
+{
+  g_clear_pointer (&data->mounts, object_list_free);
+  g_object_unref (data->parent_repo);
+  ostree_collection_ref_freev (data->refs);
+  g_free (data);
+}
+
+/* Executed in a #GTask worker thread. Probe all the mounts concurrently, one
+ * worker thread per mount, and merge the per-mount results in mount order so
+ * the outcome is deterministic. */
+static void
+resolve_all_mounts_in_thread (GTask *task, gpointer source_object, gpointer task_data,
+                              GCancellable *cancellable)
+{
+  ResolveData *resolve_data = task_data;
+  g_autoptr (GPtrArray) results = NULL; /* (element-type OstreeRepoFinderResult) */
+  g_autoptr (GPtrArray) mount_data = g_ptr_array_new_with_free_func ((GDestroyNotify)mount_data_free);
+  g_autoptr (GPtrArray) threads = g_ptr_array_new ();
+  const gint priority = 50; /* arbitrarily chosen */
+  GList *l;
+  gsize i;
+
+  results = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_repo_finder_result_free);
+
+  for (l = resolve_data->mounts; l != NULL; l = l->next)
+    {
+      MountData *data = g_new0 (MountData, 1);
+
+      data->mount = G_MOUNT (l->data);
+      data->finder = OSTREE_REPO_FINDER (source_object);
+      data->refs = (const OstreeCollectionRef *const *)resolve_data->refs;
+      data->parent_repo = resolve_data->parent_repo;
+      data->priority = priority;
+      data->cancellable = cancellable;
+      data->results
+          = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_repo_finder_result_free);
+
+      g_ptr_array_add (mount_data, data);
+      g_ptr_array_add (threads, g_thread_new ("mount-result", resolve_mount_in_thread_cb, data));
+    }
+
+  for (i = 0; i < threads->len; i++)
+    g_thread_join (g_ptr_array_index (threads, i));
+
+  for (i = 0; i < mount_data->len; i++)
+    {
+      MountData *data = g_ptr_array_index (mount_data, i);
+      gsize j;
+
+      for (j = 0; j < data->results->len; j++)
+        g_ptr_array_add (results, g_ptr_array_index (data->results, j));
+      g_ptr_array_set_free_func (data->results, NULL); /* ownership transferred */
     }
 
   g_ptr_array_sort (results, results_compare_cb);
@@ -541,6 +769,32 @@ ostree_repo_finder_mount_resolve_async (OstreeRepoFinder *finder,
   g_task_return_pointer (task, g_steal_pointer (&results), (GDestroyNotify)g_ptr_array_unref);
 }
 
+static void
+ostree_repo_finder_mount_resolve_async (OstreeRepoFinder *finder,
+                                        const OstreeCollectionRef *const *refs,
+                                        OstreeRepo *parent_repo, GCancellable *cancellable,
+                                        GAsyncReadyCallback callback, gpointer user_data)
+{
+  OstreeRepoFinderMount *self = OSTREE_REPO_FINDER_MOUNT (finder);
+  g_autoptr (GTask) task = NULL;
+  ResolveData *data;
+
+  task = g_task_new (finder, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ostree_repo_finder_mount_resolve_async);
+
+  /* List the mounts in the caller’s context, since #GVolumeMonitor is not
+   * thread-safe; everything else happens in worker threads. */
+  data = g_new0 (ResolveData, 1);
+  data->refs = ostree_collection_ref_dupv (refs);
+  data->parent_repo = g_object_ref (parent_repo);
+  data->mounts = g_volume_monitor_get_mounts (self->monitor);
+
+  g_debug ("%s: Found %u mounts", G_STRFUNC, g_list_length (data->mounts));
+
+  g_task_set_task_data (task, data, (GDestroyNotify)resolve_data_free);
+  g_task_run_in_thread (task, resolve_all_mounts_in_thread);
+}
+
 static GPtrArray *
 ostree_repo_finder_mount_resolve_finish (OstreeRepoFinder *self, GAsyncResult *result,
                                          GError **error)
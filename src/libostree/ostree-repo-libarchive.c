@@ -215,6 +215,42 @@ mtree_ensure_dir_with_meta (OstreeRepo *repo, OstreeMutableTree *parent, const c
   return TRUE;
 }
 
+/* Pipeline for parallel content hashing/writing, enabled via the
+ * `core.parallel-checksum-threads` config option.  The archive can only be
+ * decoded sequentially, so the reader thread decompresses each entry into a
+ * buffer and queues it; pool workers then checksum and write the content
+ * objects, which is where the import otherwise spends nearly all of its
+ * time.  The OstreeMutableTree is not thread-safe, so its updates are
+ * applied back on the reader thread, in entry arrival order.
+ */
+#define AIC_PIPELINE_MAX_BUFFERED_BYTES (64 * 1024 * 1024)
+
+typedef struct
+{
+  /* Filled by the reader */
+  OstreeMutableTree *parent;
+  char *name;
+  GFileInfo *fi;
+  GVariant *xattrs;
+  GBytes *content; /* Regular file payload; NULL for symlinks */
+
+  /* Filled by the worker; valid once done is set (under the pipeline lock) */
+  char *csum;
+  GError *error;
+  gboolean done;
+} AicPipelineItem;
+
+typedef struct
+{
+  OstreeRepo *repo;
+  GCancellable *cancellable;
+  OtThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  GQueue items; /* AicPipelineItem*, in entry arrival order */
+  guint64 buffered_bytes;
+} AicPipeline;
+
 typedef struct
 {
   OstreeRepo *repo;
@@ -224,6 +260,13 @@ typedef struct
   struct archive_entry *entry;
   GHashTable *deferred_hardlinks;
   OstreeRepoCommitModifier *modifier;
+  AicPipeline *pipeline; /* NULL when importing serially */
+
+  /* Memoized result of the last parent directory resolution; consecutive
+   * archive entries overwhelmingly share a parent, and this skips the
+   * per-component walk from the root for them. */
+  char *cached_parent_path;
+  OstreeMutableTree *cached_parent;
 } OstreeRepoArchiveImportContext;
 
 typedef struct
@@ -233,6 +276,8 @@ typedef struct
   guint64 size;
 } DeferredHardlink;
 
+static gboolean aic_pipeline_drain (AicPipeline *pipeline, gboolean wait_all, GError **error);
+
 static inline char *
 aic_get_final_path (OstreeRepoArchiveImportContext *ctx, const char *path, GError **error)
 {
@@ -363,6 +408,11 @@ aic_create_parent_dirs (OstreeRepoArchiveImportContext *ctx, GPtrArray *componen
   g_autofree char *fullpath = NULL;
   g_autoptr (OstreeMutableTree) dir = NULL;
 
+  /* Settle any queued file updates first so e.g. replacing a file with a
+   * directory fails the same way it would serially */
+  if (!aic_pipeline_drain (ctx->pipeline, TRUE, error))
+    return FALSE;
+
   /* start with the root itself */
   if (!aic_ensure_parent_dir (ctx, ctx->root, "/", &dir, cancellable, error))
     return FALSE;
@@ -383,8 +433,8 @@ aic_create_parent_dirs (OstreeRepoArchiveImportContext *ctx, GPtrArray *componen
 }
 
 static gboolean
-aic_get_parent_dir (OstreeRepoArchiveImportContext *ctx, const char *path,
-                    OstreeMutableTree **out_dir, GCancellable *cancellable, GError **error)
+aic_resolve_parent_dir (OstreeRepoArchiveImportContext *ctx, const char *path,
+                        OstreeMutableTree **out_dir, GCancellable *cancellable, GError **error)
 {
   g_autoptr (GPtrArray) components = NULL;
   if (!ot_util_path_split_validate (path, &components, error))
@@ -411,6 +461,29 @@ aic_get_parent_dir (OstreeRepoArchiveImportContext *ctx, const char *path,
   return FALSE;
 }
 
+static gboolean
+aic_get_parent_dir (OstreeRepoArchiveImportContext *ctx, const char *path,
+                    OstreeMutableTree **out_dir, GCancellable *cancellable, GError **error)
+{
+  g_autofree char *dirpath = g_path_get_dirname (path);
+
+  /* Directories are never removed during an import, so a previously
+   * resolved node cannot go stale. */
+  if (ctx->cached_parent != NULL && strcmp (dirpath, ctx->cached_parent_path) == 0)
+    {
+      *out_dir = g_object_ref (ctx->cached_parent);
+      return TRUE;
+    }
+
+  if (!aic_resolve_parent_dir (ctx, path, out_dir, cancellable, error))
+    return FALSE;
+
+  g_free (ctx->cached_parent_path);
+  ctx->cached_parent_path = g_steal_pointer (&dirpath);
+  g_set_object (&ctx->cached_parent, *out_dir);
+  return TRUE;
+}
+
 static gboolean
 aic_get_xattrs (OstreeRepoArchiveImportContext *ctx, const char *path, GFileInfo *file_info,
                 GVariant **out_xattrs, GCancellable *cancellable, GError **error)
@@ -484,6 +557,11 @@ aic_handle_dir (OstreeRepoArchiveImportContext *ctx, OstreeMutableTree *parent,
   const char *name = glnx_basename (path);
   g_autoptr (GVariant) xattrs = NULL;
 
+  /* The mtree is updated directly below, so preserve ordering relative to
+   * any queued file updates */
+  if (!aic_pipeline_drain (ctx->pipeline, TRUE, error))
+    return FALSE;
+
   if (!aic_get_xattrs (ctx, path, fi, &xattrs, cancellable, error))
     return FALSE;
 
@@ -516,6 +594,206 @@ aic_write_file (OstreeRepoArchiveImportContext *ctx, GFileInfo *fi, GVariant *xa
   return TRUE;
 }
 
+static void
+aic_pipeline_item_free (AicPipelineItem *item)
+{
+  g_clear_object (&item->parent);
+  g_free (item->name);
+  g_clear_object (&item->fi);
+  g_clear_pointer (&item->xattrs, g_variant_unref);
+  g_clear_pointer (&item->content, g_bytes_unref);
+  g_free (item->csum);
+  g_clear_error (&item->error);
+  g_free (item);
+}
+
+static void
+aic_pipeline_worker (gpointer data, gpointer user_data)
+{
+  AicPipelineItem *item = data;
+  AicPipeline *pipeline = user_data;
+
+  g_autoptr (GInputStream) content_stream = NULL;
+  if (item->content != NULL)
+    content_stream = g_memory_input_stream_new_from_bytes (item->content);
+
+  g_autoptr (GInputStream) file_object_input = NULL;
+  guint64 length;
+  g_autofree guchar *csum_raw = NULL;
+  GError *local_error = NULL;
+  if (ostree_raw_file_to_content_stream (content_stream, item->fi, item->xattrs,
+                                         &file_object_input, &length, pipeline->cancellable,
+                                         &local_error)
+      && ostree_repo_write_content (pipeline->repo, NULL, file_object_input, length, &csum_raw,
+                                    pipeline->cancellable, &local_error))
+    item->csum = ostree_checksum_from_bytes (csum_raw);
+
+  g_mutex_lock (&pipeline->lock);
+  item->error = local_error;
+  item->done = TRUE;
+  g_cond_broadcast (&pipeline->cond);
+  g_mutex_unlock (&pipeline->lock);
+}
+
+/* Apply completed mtree updates in arrival order on the reader thread; with
+ * @wait_all, block until the queue is empty.  After a failure we still reap
+ * every queued item so the workers are quiesced.
+ */
+static gboolean
+aic_pipeline_drain (AicPipeline *pipeline, gboolean wait_all, GError **error)
+{
+  gboolean ret = TRUE;
+
+  if (pipeline == NULL)
+    return TRUE;
+
+  g_mutex_lock (&pipeline->lock);
+  while (TRUE)
+    {
+      AicPipelineItem *item = g_queue_peek_head (&pipeline->items);
+      if (item == NULL)
+        break;
+      if (!item->done)
+        {
+          if (!wait_all)
+            break;
+          g_cond_wait (&pipeline->cond, &pipeline->lock);
+          continue;
+        }
+      g_queue_pop_head (&pipeline->items);
+      if (item->content != NULL)
+        pipeline->buffered_bytes -= g_bytes_get_size (item->content);
+      g_mutex_unlock (&pipeline->lock);
+
+      if (ret)
+        {
+          if (item->error != NULL)
+            {
+              g_propagate_error (error, g_steal_pointer (&item->error));
+              ret = FALSE;
+            }
+          else if (!ostree_mutable_tree_replace_file (item->parent, item->name, item->csum, error))
+            ret = FALSE;
+
+          if (!ret)
+            wait_all = TRUE;
+        }
+      aic_pipeline_item_free (item);
+
+      g_mutex_lock (&pipeline->lock);
+    }
+  g_mutex_unlock (&pipeline->lock);
+  return ret;
+}
+
+static AicPipeline *
+aic_pipeline_new (OstreeRepo *repo, GCancellable *cancellable)
+{
+  AicPipeline *pipeline = g_new0 (AicPipeline, 1);
+  pipeline->repo = repo;
+  pipeline->cancellable = cancellable;
+  g_mutex_init (&pipeline->lock);
+  g_cond_init (&pipeline->cond);
+  g_queue_init (&pipeline->items);
+  pipeline->pool = ot_thread_pool_new ("archive-import", aic_pipeline_worker, pipeline,
+                                       repo->parallel_checksum_threads);
+  return pipeline;
+}
+
+static void
+aic_pipeline_free (AicPipeline *pipeline)
+{
+  if (pipeline == NULL)
+    return;
+  /* Quiesce the workers; on the success path the queue is already empty */
+  (void)aic_pipeline_drain (pipeline, TRUE, NULL);
+  ot_thread_pool_free (pipeline->pool);
+  g_mutex_clear (&pipeline->lock);
+  g_cond_clear (&pipeline->cond);
+  g_free (pipeline);
+}
+
+/* Decompress the current entry's payload into a buffer; only used for
+ * entries that fit in the pipeline's buffer window.
+ */
+static gboolean
+aic_read_entry_content (OstreeRepoArchiveImportContext *ctx, guint64 size, GBytes **out_content,
+                        GError **error)
+{
+  g_autoptr (GByteArray) buf = g_byte_array_sized_new ((guint)size);
+  g_autofree guint8 *chunk = g_malloc (128 * 1024);
+
+  while (TRUE)
+    {
+      gssize bytes_read = archive_read_data (ctx->archive, chunk, 128 * 1024);
+      if (bytes_read < 0)
+        {
+          propagate_libarchive_error (error, ctx->archive);
+          return FALSE;
+        }
+      if (bytes_read == 0)
+        break;
+      g_byte_array_append (buf, chunk, bytes_read);
+    }
+
+  *out_content = g_byte_array_free_to_bytes (g_steal_pointer (&buf));
+  return TRUE;
+}
+
+/* Queue checksumming+writing of the current entry onto the pipeline.  The
+ * mtree update happens later, in order, in aic_pipeline_drain().
+ */
+static gboolean
+aic_queue_file (OstreeRepoArchiveImportContext *ctx, OstreeMutableTree *parent, const char *path,
+                GFileInfo *fi, GVariant *xattrs, GError **error)
+{
+  AicPipeline *pipeline = ctx->pipeline;
+
+  AicPipelineItem *item = g_new0 (AicPipelineItem, 1);
+  item->parent = g_object_ref (parent);
+  item->name = g_strdup (glnx_basename (path));
+  item->fi = g_object_ref (fi);
+  item->xattrs = xattrs ? g_variant_ref (xattrs) : NULL;
+
+  if (g_file_info_get_file_type (fi) == G_FILE_TYPE_REGULAR)
+    {
+      guint64 size = g_file_info_get_attribute_uint64 (fi, "standard::size");
+      if (!aic_read_entry_content (ctx, size, &item->content, error))
+        {
+          aic_pipeline_item_free (item);
+          return FALSE;
+        }
+    }
+
+  g_mutex_lock (&pipeline->lock);
+  g_queue_push_tail (&pipeline->items, item);
+  if (item->content != NULL)
+    pipeline->buffered_bytes += g_bytes_get_size (item->content);
+  g_mutex_unlock (&pipeline->lock);
+  ot_thread_pool_push (pipeline->pool, item);
+
+  /* Apply whatever has completed, then block if the buffer window is full */
+  if (!aic_pipeline_drain (pipeline, FALSE, error))
+    return FALSE;
+  while (TRUE)
+    {
+      g_mutex_lock (&pipeline->lock);
+      AicPipelineItem *head = g_queue_peek_head (&pipeline->items);
+      gboolean throttled
+          = head != NULL && pipeline->buffered_bytes > AIC_PIPELINE_MAX_BUFFERED_BYTES;
+      if (throttled)
+        {
+          while (!head->done)
+            g_cond_wait (&pipeline->cond, &pipeline->lock);
+        }
+      g_mutex_unlock (&pipeline->lock);
+      if (!throttled)
+        return TRUE;
+      if (!aic_pipeline_drain (pipeline, FALSE, error))
+        return FALSE;
+    }
+}
+
 static gboolean
 aic_import_file (OstreeRepoArchiveImportContext *ctx, OstreeMutableTree *parent, const char *path,
                  GFileInfo *fi, GCancellable *cancellable, GError **error)
@@ -528,6 +806,19 @@ aic_import_file (OstreeRepoArchiveImportContext *ctx, OstreeMutableTree *parent,
   if (!aic_get_xattrs (ctx, path, fi, &xattrs, cancellable, error))
     return FALSE;
 
+  if (ctx->pipeline != NULL)
+    {
+      /* Entries too large for the buffer window stream through the serial
+       * path below instead, after the queue has emptied. */
+      guint64 size = g_file_info_get_attribute_uint64 (fi, "standard::size");
+      if (g_file_info_get_file_type (fi) != G_FILE_TYPE_REGULAR
+          || size <= AIC_PIPELINE_MAX_BUFFERED_BYTES)
+        return aic_queue_file (ctx, parent, path, fi, xattrs, error);
+
+      if (!aic_pipeline_drain (ctx->pipeline, TRUE, error))
+        return FALSE;
+    }
+
   if (!aic_write_file (ctx, fi, xattrs, &csum, cancellable, error))
     return FALSE;
 
@@ -794,6 +1085,9 @@ ostree_repo_import_archive_to_mtree (OstreeRepo *self, OstreeRepoImportArchiveOp
 
   _ostree_repo_setup_generate_sizes (self, modifier);
 
+  if (self->parallel_checksum_threads > 0)
+    aictx.pipeline = aic_pipeline_new (self, cancellable);
+
   while (TRUE)
     {
       int r = archive_read_next_header (a, &aictx.entry);
@@ -812,6 +1106,11 @@ ostree_repo_import_archive_to_mtree (OstreeRepo *self, OstreeRepoImportArchiveOp
         goto out;
     }
 
+  /* The deferred hardlink pass below looks up content checksums in the
+   * mtree, so everything must have landed by now */
+  if (!aic_pipeline_drain (aictx.pipeline, TRUE, error))
+    goto out;
+
   if (!aic_import_deferred_hardlinks (&aictx, cancellable, error))
     goto out;
 
@@ -838,6 +1137,9 @@ ostree_repo_import_archive_to_mtree (OstreeRepo *self, OstreeRepoImportArchiveOp
 
   ret = TRUE;
 out:
+  aic_pipeline_free (aictx.pipeline);
+  g_free (aictx.cached_parent_path);
+  g_clear_object (&aictx.cached_parent);
   return ret;
 #else
   g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
@@ -1018,6 +1320,318 @@ out:
   return ret;
 }
 
+/* One flattened entry of the tree being exported.  The path/info pair is
+ * collected up front by the calling thread; for regular files the content
+ * fields are filled in later by a reader thread.
+ */
+typedef struct
+{
+  GFile *path;     /* owned */
+  GFileInfo *info; /* owned */
+
+  /* Regular files only */
+  char *checksum;
+  gboolean loaded;
+  GFileInfo *content_info;
+  GBytes *content; /* NULL once loaded == TRUE means: too large, stream it */
+} ExportEntry;
+
+static void
+export_entry_free (ExportEntry *entry)
+{
+  g_object_unref (entry->path);
+  g_object_unref (entry->info);
+  g_free (entry->checksum);
+  g_clear_object (&entry->content_info);
+  g_clear_pointer (&entry->content, g_bytes_unref);
+  g_free (entry);
+}
+
+typedef struct
+{
+  OstreeRepo *repo;
+  GPtrArray *entries;
+  guint window; /* max entries a reader may run ahead of the writer */
+
+  GMutex lock;
+  GCond cond;
+  guint write_index; /* next entry the writer will emit */
+  gboolean shutdown;
+  GError *caught_error;
+  GCancellable *cancellable;
+} ExportPipeline;
+
+/* Files larger than this are not buffered by the reader threads; the writer
+ * streams them from the repository directly to bound memory usage.
+ */
+#define EXPORT_PREFETCH_MAX_FILE_SIZE (32 * 1024 * 1024)
+
+static void
+export_reader_worker (gpointer item, gpointer user_data)
+{
+  ExportPipeline *pipeline = user_data;
+  const guint index = GPOINTER_TO_UINT (item) - 1;
+  ExportEntry *entry = pipeline->entries->pdata[index];
+  g_autoptr (GInputStream) file_in = NULL;
+  g_autoptr (GFileInfo) content_info = NULL;
+  g_autoptr (GBytes) content = NULL;
+  g_autoptr (GError) local_error = NULL;
+  gboolean skip;
+
+  /* Stay within the readahead window so buffered content stays bounded;
+   * the writer can always proceed since its next entry is never gated here.
+   */
+  g_mutex_lock (&pipeline->lock);
+  while (!pipeline->shutdown && pipeline->caught_error == NULL
+         && index >= pipeline->write_index + pipeline->window)
+    g_cond_wait (&pipeline->cond, &pipeline->lock);
+  skip = pipeline->shutdown || pipeline->caught_error != NULL;
+  g_mutex_unlock (&pipeline->lock);
+
+  if (!skip)
+    {
+      if (ostree_repo_load_file (pipeline->repo, entry->checksum, &file_in, &content_info, NULL,
+                                 pipeline->cancellable, &local_error))
+        {
+          if ((guint64)g_file_info_get_size (content_info) <= EXPORT_PREFETCH_MAX_FILE_SIZE)
+            content
+                = ot_map_anonymous_tmpfile_from_content (file_in, pipeline->cancellable, &local_error);
+        }
+    }
+
+  g_mutex_lock (&pipeline->lock);
+  if (local_error != NULL && pipeline->caught_error == NULL)
+    pipeline->caught_error = g_steal_pointer (&local_error);
+  entry->content_info = g_steal_pointer (&content_info);
+  entry->content = g_steal_pointer (&content);
+  entry->loaded = TRUE;
+  g_cond_broadcast (&pipeline->cond);
+  g_mutex_unlock (&pipeline->lock);
+}
+
+static gboolean
+export_collect_entries (GFile *dir, GPtrArray *entries, GCancellable *cancellable, GError **error)
+{
+  gboolean ret = FALSE;
+  g_autoptr (GFileInfo) dir_info = NULL;
+  g_autoptr (GFileEnumerator) dir_enum = NULL;
+
+  dir_info = g_file_query_info (dir, OSTREE_GIO_FAST_QUERYINFO, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                cancellable, error);
+  if (!dir_info)
+    goto out;
+
+  {
+    ExportEntry *entry = g_new0 (ExportEntry, 1);
+    entry->path = g_object_ref (dir);
+    entry->info = g_steal_pointer (&dir_info);
+    g_ptr_array_add (entries, entry);
+  }
+
+  dir_enum = g_file_enumerate_children (dir, OSTREE_GIO_FAST_QUERYINFO,
+                                        G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, cancellable, error);
+  if (!dir_enum)
+    goto out;
+
+  while (TRUE)
+    {
+      GFileInfo *file_info;
+      GFile *path;
+
+      if (!g_file_enumerator_iterate (dir_enum, &file_info, &path, cancellable, error))
+        goto out;
+      if (file_info == NULL)
+        break;
+
+      if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_DIRECTORY)
+        {
+          if (!export_collect_entries (path, entries, cancellable, error))
+            goto out;
+        }
+      else
+        {
+          ExportEntry *entry = g_new0 (ExportEntry, 1);
+          entry->path = g_object_ref (path);
+          entry->info = g_object_ref (file_info);
+          if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_REGULAR)
+            {
+              /* Resolve the checksum here, on the enumerating thread;
+               * OstreeRepoFile resolution is not thread safe.
+               */
+              entry->checksum
+                  = g_strdup (ostree_repo_file_get_checksum ((OstreeRepoFile *)path));
+            }
+          g_ptr_array_add (entries, entry);
+        }
+    }
+
+  ret = TRUE;
+out:
+  return ret;
+}
+
+/* Pipelined variant of write_directory_to_libarchive_recurse(): flatten the
+ * tree into an ordered entry list, let a pool of reader threads prefetch
+ * regular file content within a bounded window ahead of the writer, and emit
+ * archive entries strictly in order from the calling thread (a struct archive
+ * is not thread safe).
+ */
+static gboolean
+write_tree_to_libarchive_pipelined (OstreeRepo *self, OstreeRepoExportArchiveOptions *opts,
+                                    GFile *root, struct archive *a, guint n_reader_threads,
+                                    GCancellable *cancellable, GError **error)
+{
+  gboolean ret = FALSE;
+  g_autoptr (GPtrArray) entries
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)export_entry_free);
+  g_autoptr (OtThreadPool) pool = NULL;
+  ExportPipeline pipeline = {
+    0,
+  };
+  struct archive_entry *entry = NULL;
+  guint i;
+
+  pipeline.repo = self;
+  pipeline.entries = entries;
+  pipeline.window = MAX (n_reader_threads * 4, 16);
+  pipeline.cancellable = cancellable;
+  g_mutex_init (&pipeline.lock);
+  g_cond_init (&pipeline.cond);
+
+  if (!export_collect_entries (root, entries, cancellable, error))
+    goto out;
+
+  pool = ot_thread_pool_new ("export-read", export_reader_worker, &pipeline, n_reader_threads);
+  for (i = 0; i < entries->len; i++)
+    {
+      ExportEntry *eentry = entries->pdata[i];
+      if (g_file_info_get_file_type (eentry->info) == G_FILE_TYPE_REGULAR)
+        ot_thread_pool_push (pool, GUINT_TO_POINTER (i + 1));
+    }
+
+  for (i = 0; i < entries->len; i++)
+    {
+      ExportEntry *eentry = entries->pdata[i];
+
+      entry = archive_entry_new2 (a);
+      if (!file_to_archive_entry_common (root, opts, eentry->path, eentry->info, entry, error))
+        goto out;
+
+      switch (g_file_info_get_file_type (eentry->info))
+        {
+        case G_FILE_TYPE_DIRECTORY:
+          {
+            if (!write_header_free_entry (a, &entry, error))
+              goto out;
+          }
+          break;
+        case G_FILE_TYPE_SYMBOLIC_LINK:
+          {
+            archive_entry_set_symlink (entry, g_file_info_get_symlink_target (eentry->info));
+            if (!write_header_free_entry (a, &entry, error))
+              goto out;
+          }
+          break;
+        case G_FILE_TYPE_REGULAR:
+          {
+            g_mutex_lock (&pipeline.lock);
+            while (!eentry->loaded && pipeline.caught_error == NULL)
+              g_cond_wait (&pipeline.cond, &pipeline.lock);
+            if (pipeline.caught_error != NULL)
+              {
+                g_propagate_error (error, g_error_copy (pipeline.caught_error));
+                g_mutex_unlock (&pipeline.lock);
+                goto out;
+              }
+            g_mutex_unlock (&pipeline.lock);
+
+            archive_entry_set_size (entry, g_file_info_get_size (eentry->content_info));
+
+            if (archive_write_header (a, entry) != ARCHIVE_OK)
+              {
+                propagate_libarchive_error (error, a);
+                goto out;
+              }
+
+            if (eentry->content != NULL)
+              {
+                gsize len;
+                const guint8 *data = g_bytes_get_data (eentry->content, &len);
+                ssize_t r = archive_write_data (a, data, len);
+                if (r < 0 || (gsize)r != len)
+                  {
+                    propagate_libarchive_error (error, a);
+                    goto out;
+                  }
+                /* Release the prefetched content eagerly */
+                g_clear_pointer (&eentry->content, g_bytes_unref);
+              }
+            else
+              {
+                /* Too large to prefetch; stream it from the repository */
+                guint8 buf[8192];
+                g_autoptr (GInputStream) file_in = NULL;
+
+                if (!ostree_repo_load_file (self, eentry->checksum, &file_in, NULL, NULL,
+                                            cancellable, error))
+                  goto out;
+
+                while (TRUE)
+                  {
+                    gssize bytes_read
+                        = g_input_stream_read (file_in, buf, sizeof (buf), cancellable, error);
+                    if (bytes_read < 0)
+                      goto out;
+                    if (bytes_read == 0)
+                      break;
+
+                    {
+                      ssize_t r = archive_write_data (a, buf, bytes_read);
+                      if (r != bytes_read)
+                        {
+                          propagate_libarchive_error (error, a);
+                          goto out;
+                        }
+                    }
+                  }
+              }
+
+            if (archive_write_finish_entry (a) != ARCHIVE_OK)
+              {
+                propagate_libarchive_error (error, a);
+                goto out;
+              }
+
+            archive_entry_free (entry);
+            entry = NULL;
+          }
+          break;
+        default:
+          g_assert_not_reached ();
+        }
+
+      g_mutex_lock (&pipeline.lock);
+      pipeline.write_index = i + 1;
+      g_cond_broadcast (&pipeline.cond);
+      g_mutex_unlock (&pipeline.lock);
+    }
+
+  ret = TRUE;
+out:
+  /* Wake any readers blocked on the window so the pool can drain */
+  g_mutex_lock (&pipeline.lock);
+  pipeline.shutdown = TRUE;
+  g_cond_broadcast (&pipeline.cond);
+  g_mutex_unlock (&pipeline.lock);
+  g_clear_pointer (&pool, ot_thread_pool_free); /* waits for outstanding work */
+  g_clear_error (&pipeline.caught_error);
+  g_mutex_clear (&pipeline.lock);
+  g_cond_clear (&pipeline.cond);
+  if (entry)
+    archive_entry_free (entry);
+  return ret;
+}
+
 static gboolean
 write_directory_to_libarchive_recurse (OstreeRepo *self, OstreeRepoExportArchiveOptions *opts,
                                        GFile *root, GFile *dir, struct archive *a,
@@ -1169,8 +1783,14 @@ ostree_repo_export_tree_to_archive (OstreeRepo *self, OstreeRepoExportArchiveOpt
   gboolean ret = FALSE;
   struct archive *a = archive;
 
-  if (!write_directory_to_libarchive_recurse (self, opts, (GFile *)root, (GFile *)root, a,
-                                              cancellable, error))
+  if (opts->n_reader_threads > 1)
+    {
+      if (!write_tree_to_libarchive_pipelined (self, opts, (GFile *)root, a,
+                                               opts->n_reader_threads, cancellable, error))
+        goto out;
+    }
+  else if (!write_directory_to_libarchive_recurse (self, opts, (GFile *)root, (GFile *)root, a,
+                                                   cancellable, error))
     goto out;
 
   ret = TRUE;
@@ -0,0 +1,448 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "ostree-core-private.h"
+#include "ostree-repo-private.h"
+#include "otutil.h"
+
+/* Pack files for archive repositories
+ *
+ * An optional object store format for archive-mode repositories with very
+ * large object counts, where one gzip'd loose file per object wastes inodes
+ * and makes every read a small-file open.  A pack is a pair of files under
+ * objects/pack/:
+ *
+ *   <name>.data - the byte-for-byte concatenation of loose object files
+ *   <name>.idx  - a GVariant of type (ua(ayytt)): a format version, then an
+ *                 array of (checksum, objtype, offset, length) entries sorted
+ *                 by checksum so lookups can binary search the mmap'ed index.
+ *                 Offsets and lengths are big-endian.
+ *
+ * <name> is the SHA256 of the serialized index, making packs content
+ * addressed and safe to regenerate concurrently.  Packs are read-only once
+ * created; `ostree repack` consolidates current loose objects into a new
+ * pack and deletes the loose copies.  Commit objects always stay loose so
+ * that commit enumeration (fsck, prune, summary generation) keeps working
+ * unmodified.
+ *
+ * Because pack names are content addressed, they can't be enumerated over
+ * dumb transports like plain HTTP; objects/pack/manifest is a newline
+ * separated list of current pack names, regenerated whenever a pack is
+ * created, so pull clients can discover the indexes with a single fetch.
+ */
+
+#define PACK_INDEX_VERSION 1
+
+typedef struct
+{
+  GVariant *index;   /* (ua(ayytt)) */
+  GVariant *entries; /* a(ayytt), child of index */
+  GBytes *data;
+} OstreeRepoPackFile;
+
+static void
+pack_file_free (gpointer data)
+{
+  OstreeRepoPackFile *pack = data;
+  g_clear_pointer (&pack->entries, g_variant_unref);
+  g_clear_pointer (&pack->index, g_variant_unref);
+  g_clear_pointer (&pack->data, g_bytes_unref);
+  g_free (pack);
+}
+
+void
+_ostree_repo_packs_clear (OstreeRepo *self)
+{
+  g_clear_pointer (&self->pack_files, g_ptr_array_unref);
+  self->packs_initialized = FALSE;
+}
+
+/* Scan objects/pack/ and mmap every index and data file.  Must be called
+ * with the pack lock held.
+ */
+static gboolean
+packs_ensure_initialized_locked (OstreeRepo *self, GCancellable *cancellable, GError **error)
+{
+  if (self->packs_initialized)
+    return TRUE;
+
+  g_autoptr (GPtrArray) packs = g_ptr_array_new_with_free_func (pack_file_free);
+
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  gboolean exists;
+  if (!ot_dfd_iter_init_allow_noent (self->objects_dir_fd, _OSTREE_PACK_DIR, &dfd_iter, &exists,
+                                     error))
+    return FALSE;
+
+  while (exists)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+
+      size_t len = strlen (dent->d_name);
+      if (len <= 4 || strcmp (dent->d_name + len - 4, ".idx") != 0)
+        continue;
+
+      glnx_autofd int idx_fd = -1;
+      if (!glnx_openat_rdonly (dfd_iter.fd, dent->d_name, FALSE, &idx_fd, error))
+        return FALSE;
+
+      g_autoptr (GVariant) index = NULL;
+      if (!ot_variant_read_fd (idx_fd, 0, G_VARIANT_TYPE (OSTREE_PACK_INDEX_GVARIANT_STRING),
+                               FALSE, &index, error))
+        return glnx_prefix_error (error, "Reading pack index %s", dent->d_name);
+
+      guint32 version;
+      g_variant_get_child (index, 0, "u", &version);
+      if (version != PACK_INDEX_VERSION)
+        return glnx_throw (error, "Unsupported pack index version %u in %s", version,
+                           dent->d_name);
+
+      g_autofree char *data_name = g_strndup (dent->d_name, len - 4);
+      g_autofree char *data_path = g_strconcat (data_name, ".data", NULL);
+      glnx_autofd int data_fd = -1;
+      if (!glnx_openat_rdonly (dfd_iter.fd, data_path, FALSE, &data_fd, error))
+        return FALSE;
+
+      g_autoptr (GMappedFile) mfile = g_mapped_file_new_from_fd (data_fd, FALSE, error);
+      if (!mfile)
+        return glnx_prefix_error (error, "Mapping pack data %s", data_path);
+
+      OstreeRepoPackFile *pack = g_new0 (OstreeRepoPackFile, 1);
+      pack->index = g_steal_pointer (&index);
+      pack->entries = g_variant_get_child_value (pack->index, 1);
+      pack->data = g_mapped_file_get_bytes (mfile);
+      g_ptr_array_add (packs, pack);
+    }
+
+  self->pack_files = g_steal_pointer (&packs);
+  self->packs_initialized = TRUE;
+  return TRUE;
+}
+
+/* Binary search @entries (sorted by checksum) for (csum, objtype); returns
+ * the matching entry or %NULL.
+ */
+static GVariant *
+pack_entries_bsearch (GVariant *entries, const guchar *csum, OstreeObjectType objtype)
+{
+  gsize imin = 0;
+  gsize imax = g_variant_n_children (entries);
+
+  while (imin < imax)
+    {
+      gsize imid = imin + (imax - imin) / 2;
+      g_autoptr (GVariant) entry = g_variant_get_child_value (entries, imid);
+      g_autoptr (GVariant) csum_v = g_variant_get_child_value (entry, 0);
+
+      gsize csum_len;
+      const guchar *entry_csum = g_variant_get_fixed_array (csum_v, &csum_len, 1);
+      int c;
+      if (csum_len != OSTREE_SHA256_DIGEST_LEN)
+        return NULL; /* Corrupt entry; treat as a miss */
+      c = memcmp (entry_csum, csum, OSTREE_SHA256_DIGEST_LEN);
+      if (c == 0)
+        {
+          guint8 entry_objtype;
+          g_variant_get_child (entry, 1, "y", &entry_objtype);
+          if (entry_objtype == (guint8)objtype)
+            return g_steal_pointer (&entry);
+          c = (entry_objtype < (guint8)objtype) ? -1 : 1;
+        }
+
+      if (c < 0)
+        imin = imid + 1;
+      else
+        imax = imid;
+    }
+
+  return NULL;
+}
+
+/* Look up (checksum, objtype) in the repository's pack files.  On success
+ * with the object found, @out_data holds a zero-copy slice of the mmap'ed
+ * pack data; if the object isn't packed, @out_data is %NULL.
+ */
+gboolean
+_ostree_repo_pack_lookup (OstreeRepo *self, const char *checksum, OstreeObjectType objtype,
+                          GBytes **out_data, GCancellable *cancellable, GError **error)
+{
+  *out_data = NULL;
+
+  /* Packs are currently only created for archive repositories */
+  if (self->mode != OSTREE_REPO_MODE_ARCHIVE)
+    return TRUE;
+
+  guchar csum[OSTREE_SHA256_DIGEST_LEN];
+  ostree_checksum_inplace_to_bytes (checksum, csum);
+
+  g_mutex_lock (&self->pack_lock);
+  gboolean ret = packs_ensure_initialized_locked (self, cancellable, error);
+  g_autoptr (GPtrArray) packs = ret ? g_ptr_array_ref (self->pack_files) : NULL;
+  g_mutex_unlock (&self->pack_lock);
+  if (!ret)
+    return FALSE;
+
+  /* A loaded pack list is never mutated, only replaced (see
+   * _ostree_repo_packs_clear), and GVariant reads are thread-safe, so
+   * holding a reference is enough past this point.
+   */
+  for (guint i = 0; i < packs->len; i++)
+    {
+      OstreeRepoPackFile *pack = packs->pdata[i];
+      g_autoptr (GVariant) entry = pack_entries_bsearch (pack->entries, csum, objtype);
+      if (entry == NULL)
+        continue;
+
+      guint64 offset, length;
+      g_variant_get_child (entry, 2, "t", &offset);
+      g_variant_get_child (entry, 3, "t", &length);
+      offset = GUINT64_FROM_BE (offset);
+      length = GUINT64_FROM_BE (length);
+
+      gsize data_size = g_bytes_get_size (pack->data);
+      if (offset > data_size || length > data_size - offset)
+        return glnx_throw (error, "Corrupt pack entry for %s.%s: offset %" G_GUINT64_FORMAT
+                           " length %" G_GUINT64_FORMAT " exceeds pack size %" G_GSIZE_FORMAT,
+                           checksum, ostree_object_type_to_string (objtype), offset, length,
+                           data_size);
+
+      *out_data = g_bytes_new_from_bytes (pack->data, offset, length);
+      return TRUE;
+    }
+
+  return TRUE;
+}
+
+/* Rewrite objects/pack/manifest from the .idx files currently on disk so
+ * that HTTP clients can discover the content-addressed pack names.
+ */
+static gboolean
+pack_manifest_regenerate (OstreeRepo *self, GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GString) manifest = g_string_new (NULL);
+
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (self->objects_dir_fd, _OSTREE_PACK_DIR, FALSE, &dfd_iter,
+                                    error))
+    return FALSE;
+
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+
+      size_t len = strlen (dent->d_name);
+      if (len != OSTREE_SHA256_STRING_LEN + 4 || strcmp (dent->d_name + len - 4, ".idx") != 0)
+        continue;
+
+      g_string_append_len (manifest, dent->d_name, len - 4);
+      g_string_append_c (manifest, '\n');
+    }
+
+  if (!glnx_file_replace_contents_at (self->objects_dir_fd, _OSTREE_PACK_DIR "/manifest",
+                                      (const guint8 *)manifest->str, manifest->len,
+                                      self->disable_fsync ? GLNX_FILE_REPLACE_NODATASYNC
+                                                          : GLNX_FILE_REPLACE_DATASYNC_NEW,
+                                      cancellable, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+typedef struct
+{
+  guchar csum[OSTREE_SHA256_DIGEST_LEN];
+  guint8 objtype;
+  guint64 offset;
+  guint64 length;
+} PackWriterEntry;
+
+static int
+pack_writer_entry_compare (gconstpointer ap, gconstpointer bp)
+{
+  const PackWriterEntry *a = ap;
+  const PackWriterEntry *b = bp;
+  int c = memcmp (a->csum, b->csum, OSTREE_SHA256_DIGEST_LEN);
+  if (c != 0)
+    return c;
+  return (int)a->objtype - (int)b->objtype;
+}
+
+/* Consolidate the given loose objects (an array of serialized object names)
+ * into a new pack under objects/pack/, then delete the loose copies.  The
+ * data file is made durable before the index is linked in, so a crash can at
+ * worst leave an orphaned .data file.
+ */
+gboolean
+_ostree_repo_pack_create (OstreeRepo *self, GPtrArray *objects, guint *out_n_packed,
+                          GCancellable *cancellable, GError **error)
+{
+  g_assert (self->mode == OSTREE_REPO_MODE_ARCHIVE);
+
+  if (!glnx_shutil_mkdir_p_at (self->objects_dir_fd, _OSTREE_PACK_DIR, DEFAULT_DIRECTORY_MODE,
+                               cancellable, error))
+    return FALSE;
+
+  g_auto (GLnxTmpfile) data_tmpf = {
+    0,
+  };
+  if (!glnx_open_tmpfile_linkable_at (self->objects_dir_fd, _OSTREE_PACK_DIR, O_WRONLY | O_CLOEXEC,
+                                      &data_tmpf, error))
+    return FALSE;
+
+  g_autoptr (GArray) entries = g_array_new (FALSE, FALSE, sizeof (PackWriterEntry));
+  guint64 offset = 0;
+
+  for (guint i = 0; i < objects->len; i++)
+    {
+      GVariant *serialized_key = objects->pdata[i];
+      const char *checksum;
+      OstreeObjectType objtype;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+
+      ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+
+      char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
+      _ostree_repo_loose_path (self, loose_path_buf, checksum, objtype);
+
+      glnx_autofd int fd = -1;
+      if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
+        return FALSE;
+      if (fd < 0 && _ostree_repo_loose_path_alternate (self, loose_path_buf, checksum, objtype))
+        {
+          if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
+            return FALSE;
+        }
+      if (fd < 0)
+        continue; /* Raced with e.g. a prune; just skip it */
+
+      g_autoptr (GBytes) bytes = glnx_fd_readall_bytes (fd, cancellable, error);
+      if (!bytes)
+        return FALSE;
+
+      gsize len;
+      const guint8 *buf = g_bytes_get_data (bytes, &len);
+      if (glnx_loop_write (data_tmpf.fd, buf, len) < 0)
+        return glnx_throw_errno_prefix (error, "write");
+
+      PackWriterEntry entry;
+      ostree_checksum_inplace_to_bytes (checksum, entry.csum);
+      entry.objtype = (guint8)objtype;
+      entry.offset = offset;
+      entry.length = len;
+      g_array_append_val (entries, entry);
+      offset += len;
+    }
+
+  if (entries->len == 0)
+    {
+      if (out_n_packed)
+        *out_n_packed = 0;
+      return TRUE;
+    }
+
+  g_array_sort (entries, pack_writer_entry_compare);
+
+  g_autoptr (GVariantBuilder) entries_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(ayytt)"));
+  for (guint i = 0; i < entries->len; i++)
+    {
+      PackWriterEntry *entry = &g_array_index (entries, PackWriterEntry, i);
+      g_variant_builder_add (entries_builder, "(@ayytt)",
+                             ot_gvariant_new_bytearray (entry->csum, OSTREE_SHA256_DIGEST_LEN),
+                             entry->objtype, GUINT64_TO_BE (entry->offset),
+                             GUINT64_TO_BE (entry->length));
+    }
+
+  g_autoptr (GVariant) index = g_variant_ref_sink (g_variant_new (
+      OSTREE_PACK_INDEX_GVARIANT_STRING, (guint32)PACK_INDEX_VERSION, entries_builder));
+  g_autoptr (GBytes) index_bytes = g_variant_get_data_as_bytes (index);
+
+  guint8 digest[_OSTREE_SHA256_DIGEST_LEN];
+  ot_checksum_bytes (index_bytes, digest);
+  char pack_name[OSTREE_SHA256_STRING_LEN + 1];
+  ostree_checksum_inplace_from_bytes (digest, pack_name);
+
+  /* Data must be durable before the index that references it appears */
+  if (!self->disable_fsync && fsync (data_tmpf.fd) < 0)
+    return glnx_throw_errno_prefix (error, "fsync");
+
+  g_autofree char *data_path
+      = g_strconcat (_OSTREE_PACK_DIR "/", pack_name, ".data", NULL);
+  if (!glnx_link_tmpfile_at (&data_tmpf, GLNX_LINK_TMPFILE_REPLACE, self->objects_dir_fd,
+                             data_path, error))
+    return FALSE;
+
+  g_autofree char *index_path = g_strconcat (_OSTREE_PACK_DIR "/", pack_name, ".idx", NULL);
+  if (!glnx_file_replace_contents_at (self->objects_dir_fd, index_path,
+                                      g_bytes_get_data (index_bytes, NULL),
+                                      g_bytes_get_size (index_bytes),
+                                      self->disable_fsync ? GLNX_FILE_REPLACE_NODATASYNC
+                                                          : GLNX_FILE_REPLACE_DATASYNC_NEW,
+                                      cancellable, error))
+    return FALSE;
+
+  if (!pack_manifest_regenerate (self, cancellable, error))
+    return FALSE;
+
+  /* Now that the pack is in place, the loose copies are redundant */
+  for (guint i = 0; i < objects->len; i++)
+    {
+      GVariant *serialized_key = objects->pdata[i];
+      const char *checksum;
+      OstreeObjectType objtype;
+
+      ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+
+      char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
+      _ostree_repo_loose_path (self, loose_path_buf, checksum, objtype);
+
+      if (!ot_ensure_unlinked_at (self->objects_dir_fd, loose_path_buf, error))
+        return FALSE;
+      if (_ostree_repo_loose_path_alternate (self, loose_path_buf, checksum, objtype)
+          && !ot_ensure_unlinked_at (self->objects_dir_fd, loose_path_buf, error))
+        return FALSE;
+    }
+
+  /* Pick up the new pack on the next lookup through this repo object */
+  g_mutex_lock (&self->pack_lock);
+  _ostree_repo_packs_clear (self);
+  g_mutex_unlock (&self->pack_lock);
+
+  if (out_n_packed)
+    *out_n_packed = entries->len;
+  return TRUE;
+}
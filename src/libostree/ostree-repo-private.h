@@ -31,10 +31,69 @@ G_BEGIN_DECLS
 #define OSTREE_DELTAPART_VERSION (0)
 
 #define _OSTREE_SUMMARY_CACHE_DIR "summaries"
+#define _OSTREE_DELTA_SUPERBLOCK_CACHE_DIR "delta-superblocks"
 #define _OSTREE_CACHE_DIR "cache"
 
+/* Pack files for archive repositories; a subdirectory of objects/.  See
+ * ostree-repo-pack.c for the format.
+ */
+#define _OSTREE_PACK_DIR "pack"
+#define OSTREE_PACK_INDEX_GVARIANT_STRING "(ua(ayytt))"
+
+/* Chunked storage for large content objects in archive repositories; a
+ * subdirectory of objects/.  See ostree-repo-chunked.c for the format.
+ */
+#define _OSTREE_CHUNK_DIR "chunk"
+
+/* Packed refs index for repositories with very many refs; see
+ * ostree-repo-refs.c for the format.
+ */
+#define _OSTREE_PACKED_REFS_PATH "packed-refs"
+#define OSTREE_PACKED_REFS_GVARIANT_STRING "(ua(ss))"
+
+/* Cross-process lock serializing writers of the shared ref state; see
+ * _ostree_repo_refs_lock().
+ */
+#define _OSTREE_REFS_LOCK_PATH ".reflock"
+
+/* Commit ancestry cache, relative to objects/; see ostree-repo-commit-graph.c */
+#define _OSTREE_COMMIT_GRAPH_PATH "commit-graph"
+#define OSTREE_COMMIT_GRAPH_GVARIANT_STRING "(ua(ayayt))"
+
+/* Binary diffs between successive published summary files, written by
+ * summary regeneration and served as summary.delta/<sha256-of-old-summary>.
+ * Each file is (new summary sha256, new summary size (be), bsdiff payload);
+ * clients walk the digest chain hop by hop until no further delta exists.
+ */
+#define _OSTREE_SUMMARY_DELTA_DIR "summary.delta"
+#define OSTREE_SUMMARY_DELTA_GVARIANT_STRING "(stay)"
+
+/* Per-commit object reachability bitmaps served next to the summary;
+ * see ostree-repo-traverse.c for the format description.
+ */
+#define _OSTREE_OBJECT_BITMAPS_PATH "object-bitmaps"
+#define OSTREE_OBJECT_BITMAPS_GVARIANT_STRING "(ua{sv}a(yay)a{say})"
+
 #define _OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS 8
-#define _OSTREE_MAX_OUTSTANDING_DELTAPART_REQUESTS 2
+/* With HTTP/2 multiplexing, requests are cheap streams on a shared
+ * connection rather than separate sockets, so allow a much deeper window
+ * to keep small-object pulls latency-bound on the server, not on us.
+ */
+#define _OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS_MULTIPLEXED 64
+/* Delta parts are large, so the real throttle on them is the in-flight
+ * bytes window below; the count cap just avoids flooding the fetcher with
+ * many tiny parts.  Parts keep occupying the window while they decompress
+ * and apply, so downloads of later parts overlap with the apply stage of
+ * earlier ones rather than strictly alternating with it.
+ */
+#define _OSTREE_MAX_OUTSTANDING_DELTAPART_REQUESTS 4
+#define _OSTREE_DEFAULT_DELTAPART_INFLIGHT_BYTES (64 * 1024 * 1024)
+
+/* The zlib compressor produces output in small chunks; buffer this much
+ * compressed data before hitting the kernel so archive commits aren't
+ * bounded by write() syscall count.
+ */
+#define _OSTREE_ARCHIVE_WRITE_BUFFER_SIZE (1 * 1024 * 1024)
 
 /* We want some parallelism with disk writes, but we also
  * want to avoid starting tens or hundreds of threads
@@ -56,6 +115,35 @@ G_BEGIN_DECLS
 #define OSTREE_SUMMARY_MODE "ostree.summary.mode"
 #define OSTREE_SUMMARY_TOMBSTONE_COMMITS "ostree.summary.tombstone-commits"
 #define OSTREE_SUMMARY_INDEXED_DELTAS "ostree.summary.indexed-deltas"
+#define OSTREE_SUMMARY_REF_SHARDS "ostree.summary.ref-shards"
+
+/* Bloom filter over every ref name in the summary, of type (yyay):
+ * (k hash functions, hash function id, filter bytes).  Hash id 1 is
+ * ostree_str_bloom_hash() of the ref name; ids are specific to this key
+ * and unrelated to the DNS-SD TXT record bloom encoding.  Lets clients
+ * answer "ref definitely absent" without parsing the full ref map or,
+ * when the ref list is sharded, without fetching any shard.
+ */
+#define OSTREE_SUMMARY_REF_BLOOM "ostree.summary.ref-bloom"
+
+/* Directory (relative to the repo root) holding the per-shard ref lists
+ * referenced by OSTREE_SUMMARY_REF_SHARDS; shard @k is the file "<k>".
+ */
+#define _OSTREE_SUMMARY_SHARD_DIR "summary.d"
+
+/* Which shard a ref lives in when the summary ref list is sharded.  This
+ * is part of the repository format shared between server and client, so
+ * it must never change; it's spelled out (djb2) rather than using
+ * g_str_hash(), whose value GLib does not document as stable.
+ */
+static inline guint
+_ostree_summary_ref_shard_index (const char *ref_name, guint n_shards)
+{
+  guint32 h = 5381;
+  for (const guint8 *p = (const guint8 *)ref_name; *p != 0; p++)
+    h = h * 33 + *p;
+  return h % n_shards;
+}
 
 #define _OSTREE_PAYLOAD_LINK_PREFIX "../"
 #define _OSTREE_PAYLOAD_LINK_PREFIX_LEN (sizeof (_OSTREE_PAYLOAD_LINK_PREFIX) - 1)
@@ -78,6 +166,9 @@ typedef enum
   OSTREE_REPO_TEST_ERROR_INVALID_CACHE = (1 << 1),
 } OstreeRepoTestErrorFlags;
 
+/* Compiled skip-pattern trie; see ostree_repo_commit_modifier_add_skip_pattern() */
+typedef struct OstreeRepoSkipNode OstreeRepoSkipNode;
+
 struct OstreeRepoCommitModifier
 {
   gint refcount; /* atomic */
@@ -86,6 +177,7 @@ struct OstreeRepoCommitModifier
   OstreeRepoCommitFilter filter;
   gpointer user_data;
   GDestroyNotify destroy_notify;
+  OstreeRepoSkipNode *skip_trie;
 
   OstreeRepoCommitModifierXattrCallback xattr_callback;
   GDestroyNotify xattr_destroy;
@@ -104,10 +196,24 @@ typedef enum
   OSTREE_REPO_SYSROOT_KIND_IS_SYSROOT_OSTREE, /* We match /ostree/repo */
 } OstreeRepoSysrootKind;
 
+/* One row of the commit-graph cache; see ostree-repo-commit-graph.c */
+typedef struct
+{
+  guchar checksum[OSTREE_SHA256_DIGEST_LEN];
+  guchar parent[OSTREE_SHA256_DIGEST_LEN]; /* Valid only if has_parent */
+  gboolean has_parent;
+  guint64 timestamp;
+} OstreeRepoCommitGraphEntry;
+
 typedef struct
 {
   GHashTable *refs;            /* (element-type utf8 utf8) */
   GHashTable *collection_refs; /* (element-type OstreeCollectionRef utf8) */
+  GPtrArray *written_commits;  /* (element-type OstreeRepoCommitGraphEntry) */
+  /* Loose object paths written or found present during this transaction;
+   * consulted by _ostree_repo_has_loose_object() to avoid re-statting them.
+   * Protected by txn_lock. */
+  GHashTable *known_objects; /* (element-type utf8) */
   OstreeRepoTransactionStats stats;
   /* Implementation of min-free-space-percent */
   gulong blocksize;
@@ -171,6 +277,10 @@ struct OstreeRepo
   int cache_dir_fd;
   char *cache_dir;
   int objects_dir_fd;
+  int metadata_objects_dir_fd;    /* Separate root for metadata objects; see the
+                                   * metadata-objects-root config option.  -1 when unset. */
+  dev_t metadata_objects_device;  /* Valid when metadata_objects_dir_fd != -1 */
+  char *metadata_objects_root;
   int uncompressed_objects_dir_fd;
   GFile *sysroot_dir;
   GWeakRef sysroot; /* Weak to avoid a circular ref; see also `is_system` */
@@ -186,10 +296,36 @@ struct OstreeRepo
   OtTristate composefs_wanted;
   gboolean composefs_supported;
 
+  GMutex fsverity_lock; /* Protects the fields below */
+  GCond fsverity_cond;
+  OtThreadPool *fsverity_pool; /* Lazily created; enables verity off the object write path */
+  guint fsverity_outstanding; /* Queued enablements not yet completed */
+  GError *fsverity_error;     /* First worker failure, reported at the drain barrier */
+
   GMutex cache_lock;
-  guint dirmeta_cache_refcount;
-  /* char * checksum → GVariant * for dirmeta objects, used in the checkout path */
-  GHashTable *dirmeta_cache;
+  /* LRU cache of parsed dirtree/dirmeta variants; see the metadata-cache-size
+   * config option and load_metadata_internal().  All fields below are
+   * protected by cache_lock. */
+  guint metadata_cache_size;
+  /* char * "checksum.objtype" → MetadataCacheEntry, see ostree-repo.c */
+  GHashTable *metadata_cache;
+  GQueue metadata_cache_lru; /* Most recently used first */
+  /* Interned per-file xattr variants used during commit; see
+   * get_final_xattrs() in ostree-repo-commit.c. */
+  GHashTable *xattr_intern_cache;
+  /* Fanout-dir prefix → (object basename → user.ostreemeta GBytes) for
+   * bare-user repos; see bare_user_meta_cache_lookup() in ostree-repo.c. */
+  GHashTable *bare_user_meta_cache;
+  /* Immutable GFileInfo templates per object checksum; see
+   * ostree-repo-file.c. */
+  GHashTable *file_info_cache;
+  /* Remote name → digest of the last (summary, signatures) pair that passed
+   * verification; see _ostree_repo_verify_summary() in ostree-repo-pull.c. */
+  GHashTable *verified_summary_cache;
+  /* Keyring-content digest → assembled GPG home directory path, so repeated
+   * verifications against the same trust set import the keys only once; see
+   * _ostree_repo_gpg_verify_data_internal() in ostree-repo.c. */
+  GHashTable *gpg_home_cache;
 
   gboolean inited;
   gboolean writable;
@@ -198,11 +334,36 @@ struct OstreeRepo
   gboolean in_transaction;
   gboolean disable_fsync;
   gboolean per_object_fsync;
+  gboolean batch_fsync_barrier; /* See the fsync-barrier config option */
   gboolean disable_xattrs;
+  gboolean deep_fanout; /* See the deep-fanout config option */
   guint zlib_compression_level;
+  guint parallel_checksum_threads; /* See the parallel-checksum-threads config option */
+  struct OstreeRepoPrehasher *prehasher;
+  gboolean use_io_uring; /* See the io-uring config option; effective only if built with liburing */
+  struct OstreeRepoUringFsync *uring_fsync;
+  GMutex pack_lock;
+  gboolean packs_initialized; /* protected by pack_lock */
+  GPtrArray *pack_files;      /* Array<OstreeRepoPackFile>, see ostree-repo-pack.c */
+  GMutex packed_refs_lock;
+  gboolean packed_refs_initialized; /* protected by packed_refs_lock */
+  GVariant *packed_refs;            /* (ua(ss)); %NULL if there is no packed-refs file */
+  GMutex commit_graph_lock;
+  gboolean commit_graph_initialized; /* protected by commit_graph_lock */
+  GVariant *commit_graph;            /* (ua(ayayt)); %NULL if there is no commit-graph file */
+  GMutex commit_state_lock;
+  gboolean commit_state_initialized; /* protected by commit_state_lock */
+  /* Commit checksum → OstreeRepoCommitState, built by enumerating state/
+   * once; the .commitpartial markers remain the on-disk journal.  See
+   * commit_state_index_ensure() in ostree-repo.c. */
+  GHashTable *commit_state_index;
   GHashTable *loose_object_devino_hash;
   GHashTable *updated_uncompressed_dirs;
 
+  /* Per-ref summary row cache; see summary_add_ref_entry() */
+  GHashTable *summary_row_cache; /* (utf8 ref) → GVariant (s(taya{sv})) */
+  gboolean summary_row_cache_dirty;
+
   /* FIXME: The object sizes hash table is really per-commit state, not repo
    * state. Using a single table for the repo means that commits cannot be
    * built simultaneously if they're adding size information. This data should
@@ -226,6 +387,15 @@ struct OstreeRepo
   GKeyFile *config;
   GHashTable *remotes;
   GMutex remotes_lock;
+  /* Parsing the remotes.d directory is deferred from open to first use;
+   * see _ostree_repo_ensure_remotes_loaded().
+   */
+  GMutex remotes_load_lock;
+  gboolean remotes_d_loaded; /* protected by remotes_load_lock */
+  /* mtime of the remotes.d directory when it was parsed, for detecting
+   * remotes added/removed behind our back; protected by remotes_load_lock */
+  guint64 remotes_d_mtime_sec;
+  guint32 remotes_d_mtime_nsec;
   OstreeRepoMode mode;
   gboolean enable_uncompressed_cache;
   gboolean generate_sizes;
@@ -234,6 +404,7 @@ struct OstreeRepo
   gboolean add_remotes_config_dir; /* Add new remotes in remotes.d dir */
   gint lock_timeout_seconds;
   guint64 payload_link_threshold;
+  guint64 direct_io_threshold;    /* See the direct-io-threshold config option */
   gint fs_support_reflink; /* The underlying filesystem has support for ioctl (FICLONE..) */
   gchar **repo_finders;
   OstreeCfgSysrootBootloaderOpt bootloader; /* Configure which bootloader to use. */
@@ -242,6 +413,9 @@ struct OstreeRepo
   gboolean enable_bootprefix; /* If true, prepend bootloader entries with /boot */
 
   OstreeRepo *parent_repo;
+  /* Additional read-only object pools from core.object-pools, consulted in
+   * order after the parent by object lookups; NULL if none configured. */
+  GPtrArray *object_pools; /* (nullable) (element-type OstreeRepo) */
 };
 
 typedef struct
@@ -251,20 +425,75 @@ typedef struct
   char checksum[OSTREE_SHA256_STRING_LEN + 1];
 } OstreeDevIno;
 
-/* A MemoryCacheRef is an in-memory cache of objects (currently just DIRMETA).  This can
- * be used when performing an operation that traverses a repository in someway.  Currently,
- * the primary use case is ostree_repo_checkout_at() avoiding lots of duplicate dirmeta
- * lookups.
+/* Parallel content prehashing engine for the commit path; implemented in
+ * ostree-repo-commit.c.  See the `core.parallel-checksum-threads` config
+ * option.
  */
-typedef struct
-{
-  OstreeRepo *repo;
-} OstreeRepoMemoryCacheRef;
+typedef struct OstreeRepoPrehasher OstreeRepoPrehasher;
+
+void _ostree_repo_prehasher_free (OstreeRepoPrehasher *prehasher);
+
+/* Batched object fsync engine backed by io_uring, for the commit path;
+ * implemented in ostree-repo-commit.c and only built with liburing.  See the
+ * `core.io-uring` config option.
+ */
+typedef struct OstreeRepoUringFsync OstreeRepoUringFsync;
+
+void _ostree_repo_uring_fsync_free (OstreeRepoUringFsync *uring_fsync);
+
+/* Pack file support for archive repositories; see ostree-repo-pack.c */
+void _ostree_repo_packs_clear (OstreeRepo *self);
+
+gboolean _ostree_repo_pack_lookup (OstreeRepo *self, const char *checksum,
+                                   OstreeObjectType objtype, GBytes **out_data,
+                                   GCancellable *cancellable, GError **error);
+
+gboolean _ostree_repo_pack_create (OstreeRepo *self, GPtrArray *objects, guint *out_n_packed,
+                                   GCancellable *cancellable, GError **error);
+
+/* Chunked large-object storage for archive repositories; see
+ * ostree-repo-chunked.c
+ */
+gboolean _ostree_repo_chunked_create (OstreeRepo *self, GPtrArray *objects, guint64 min_size,
+                                      guint *out_n_chunked, GCancellable *cancellable,
+                                      GError **error);
+
+gboolean _ostree_repo_chunked_has_object (OstreeRepo *self, const char *checksum,
+                                          gboolean *out_found, GError **error);
+
+gboolean _ostree_repo_chunked_load (OstreeRepo *self, const char *checksum, gboolean *out_found,
+                                    GInputStream **out_input, GFileInfo **out_file_info,
+                                    GVariant **out_xattrs, GCancellable *cancellable,
+                                    GError **error);
+
+/* Packed refs index; see ostree-repo-refs.c */
+void _ostree_repo_packed_refs_clear (OstreeRepo *self);
+
+gboolean _ostree_repo_pack_refs (OstreeRepo *self, GCancellable *cancellable, GError **error);
+
+gboolean _ostree_repo_refs_lock (OstreeRepo *self, GLnxLockFile *out_lock, GError **error);
+
+/* Commit ancestry cache; see ostree-repo-commit-graph.c */
+void _ostree_repo_commit_graph_clear (OstreeRepo *self);
+
+gboolean _ostree_repo_commit_graph_lookup (OstreeRepo *self, const char *checksum,
+                                           gboolean *out_found, char **out_parent,
+                                           guint64 *out_timestamp, GError **error);
+
+gboolean _ostree_repo_commit_graph_append (OstreeRepo *self, GPtrArray *new_entries,
+                                           GCancellable *cancellable, GError **error);
 
-void _ostree_repo_memory_cache_ref_init (OstreeRepoMemoryCacheRef *state, OstreeRepo *repo);
+/* In-memory index of .commitpartial markers; see ostree-repo.c */
+void _ostree_repo_commit_state_index_clear (OstreeRepo *self);
 
-void _ostree_repo_memory_cache_ref_destroy (OstreeRepoMemoryCacheRef *state);
-G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (OstreeRepoMemoryCacheRef, _ostree_repo_memory_cache_ref_destroy)
+void _ostree_repo_commit_state_index_update (OstreeRepo *self, const char *checksum,
+                                             OstreeRepoCommitState state);
+
+gboolean _ostree_repo_refcount_ledger_exists (OstreeRepo *self);
+
+gboolean _ostree_repo_refcount_ledger_account_commits (OstreeRepo *self,
+                                                       GPtrArray *written_commits,
+                                                       GCancellable *cancellable, GError **error);
 
 #define OSTREE_REPO_TMPDIR_STAGING "staging-"
 
@@ -284,10 +513,32 @@ gboolean _ostree_repo_ensure_loose_objdir_at (int dfd, const char *loose_path,
 
 GFile *_ostree_repo_get_commit_metadata_loose_path (OstreeRepo *self, const char *checksum);
 
+gboolean _ostree_repo_txn_object_is_present (OstreeRepo *self, const char *loose_path);
+
+void _ostree_repo_txn_mark_object_present (OstreeRepo *self, const char *loose_path);
+
 gboolean _ostree_repo_has_loose_object (OstreeRepo *self, const char *checksum,
                                         OstreeObjectType objtype, gboolean *out_is_stored,
                                         GCancellable *cancellable, GError **error);
 
+/* Loose object path in @self's configured fanout layout; see the deep-fanout
+ * config option. */
+void _ostree_repo_loose_path (OstreeRepo *self, char *buf, const char *checksum,
+                              OstreeObjectType objtype);
+
+gboolean _ostree_repo_loose_path_alternate (OstreeRepo *self, char *buf, const char *checksum,
+                                            OstreeObjectType objtype);
+
+/* Object root holding loose objects of @objtype; see the
+ * metadata-objects-root config option. */
+int _ostree_repo_objects_dir_fd_for_objtype (OstreeRepo *self, OstreeObjectType objtype);
+
+gboolean _ostree_repo_migrate_fanout (OstreeRepo *self, guint *out_n_migrated,
+                                      GCancellable *cancellable, GError **error);
+
+gboolean _ostree_repo_defrag (OstreeRepo *self, guint *out_n_rewritten, GCancellable *cancellable,
+                              GError **error);
+
 gboolean _ostree_write_bareuser_metadata (int fd, guint32 uid, guint32 gid, guint32 mode,
                                           GVariant *xattrs, GError **error);
 
@@ -304,6 +555,9 @@ gboolean _ostree_repo_file_replace_contents (OstreeRepo *self, int dfd, const ch
                                              const guint8 *buf, gsize len,
                                              GCancellable *cancellable, GError **error);
 
+gboolean _ostree_repo_regenerate_object_bitmaps (OstreeRepo *self, GCancellable *cancellable,
+                                                 GError **error);
+
 gboolean _ostree_repo_write_ref (OstreeRepo *self, const char *remote,
                                  const OstreeCollectionRef *ref, const char *rev, const char *alias,
                                  GCancellable *cancellable, GError **error);
@@ -330,6 +584,9 @@ void _ostree_repo_setup_generate_sizes (OstreeRepo *self, OstreeRepoCommitModifi
 gboolean _ostree_repo_remote_name_is_file (const char *remote_name);
 
 #ifndef OSTREE_DISABLE_GPGME
+char *_ostree_repo_gpg_keyring_digest (OstreeRepo *self, const char *remote_name,
+                                       GCancellable *cancellable, GError **error);
+
 OstreeGpgVerifyResult *_ostree_repo_gpg_verify_with_metadata (
     OstreeRepo *self, GBytes *signed_data, GVariant *metadata, const char *remote_name,
     GFile *keyringdir, GFile *extra_keyring, GCancellable *cancellable, GError **error);
@@ -344,6 +601,10 @@ typedef enum
   _OSTREE_REPO_IMPORT_FLAGS_NONE = 0,
   _OSTREE_REPO_IMPORT_FLAGS_TRUSTED = (1 << 0),
   _OSTREE_REPO_IMPORT_FLAGS_VERIFY_BAREUSERONLY = (1 << 1),
+  /* Only fully checksum a deterministic sample of untrusted content objects;
+   * metadata is always verified.
+   */
+  _OSTREE_REPO_IMPORT_FLAGS_VERIFY_SAMPLE = (1 << 2),
 } OstreeRepoImportFlags;
 
 gboolean _ostree_repo_import_object (OstreeRepo *self, OstreeRepo *source, OstreeObjectType objtype,
@@ -357,7 +618,7 @@ gboolean _ostree_repo_commit_tmpf_final (OstreeRepo *self, const char *checksum,
 typedef struct
 {
   gboolean initialized;
-  gpointer opaque0[10];
+  gpointer opaque0[14];
   guint opaque1[10];
 } OstreeRepoBareContent;
 void _ostree_repo_bare_content_cleanup (OstreeRepoBareContent *regwrite);
@@ -387,6 +648,9 @@ gboolean _ostree_repo_load_file_bare (OstreeRepo *self, const char *checksum, in
 
 gboolean _ostree_repo_update_mtime (OstreeRepo *self, GError **error);
 
+gboolean _ostree_repo_ensure_remotes_loaded (OstreeRepo *self, GCancellable *cancellable,
+                                             GError **error);
+
 gboolean _ostree_repo_add_remote (OstreeRepo *self, OstreeRemote *remote);
 gboolean _ostree_repo_remove_remote (OstreeRepo *self, OstreeRemote *remote);
 OstreeRemote *_ostree_repo_get_remote (OstreeRepo *self, const char *name, GError **error);
@@ -405,12 +669,38 @@ gboolean _ostree_tmpf_fsverity_core (GLnxTmpfile *tmpf, _OstreeFeatureSupport fs
 gboolean _ostree_tmpf_fsverity (OstreeRepo *self, GLnxTmpfile *tmpf, GBytes *signature,
                                 GError **error);
 
+gboolean _ostree_repo_fsverity_maybe_queue (OstreeRepo *self, GLnxTmpfile *tmpf,
+                                            gboolean *out_queued, GError **error);
+
+gboolean _ostree_repo_fsverity_drain (OstreeRepo *self, GError **error);
+
 gboolean _ostree_repo_verify_bindings (const char *collection_id, const char *ref_name,
                                        GVariant *commit, GError **error);
 
 GHashTable *ostree_repo_list_objects_set (OstreeRepo *self, OstreeRepoListObjectsFlags flags,
                                           GCancellable *cancellable, GError **error);
 
+typedef struct OstreeRepoObjectIndex OstreeRepoObjectIndex;
+
+OstreeRepoObjectIndex *_ostree_repo_object_index_new (OstreeRepo *self, GCancellable *cancellable,
+                                                      GError **error);
+
+gboolean _ostree_repo_object_index_contains (OstreeRepoObjectIndex *index,
+                                             OstreeObjectType objtype, const char *checksum);
+
+void _ostree_repo_object_index_free (OstreeRepoObjectIndex *index);
+
+void _ostree_repo_physical_order_objects (OstreeRepo *self, GPtrArray *objects);
+
+void _ostree_repo_advise_object_read (OstreeRepo *self, OstreeObjectType objtype,
+                                      const char *checksum);
+
+gboolean _ostree_repo_dirtree_content_size (OstreeRepo *repo, const char *dirtree_checksum,
+                                            guint64 *out_size, GCancellable *cancellable,
+                                            GError **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (OstreeRepoObjectIndex, _ostree_repo_object_index_free)
+
 gboolean _ostree_repo_transaction_write_repo_metadata (OstreeRepo *self,
                                                        GVariant *additional_metadata,
                                                        char **out_checksum,
@@ -463,10 +753,25 @@ gboolean ostree_composefs_target_write (OstreeComposefsTarget *target, int fd,
                                         guchar **out_fsverity_digest, GCancellable *cancellable,
                                         GError **error);
 
+gboolean _ostree_repo_checkout_at_fanout (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options,
+                                          int destination_dfd,
+                                          const char *const *destination_paths, const char *commit,
+                                          GCancellable *cancellable, GError **error);
+
 gboolean ostree_repo_checkout_composefs (OstreeRepo *self, OstreeComposefsTarget *target,
                                          OstreeRepoFile *source, GCancellable *cancellable,
                                          GError **error);
 
+gboolean _ostree_repo_composefs_cache_linkat (OstreeRepo *self, const char *checksum,
+                                              const guchar *expected_fsverity_digest,
+                                              int destination_dfd, const char *destination_name,
+                                              gboolean *out_found, guchar **out_fsverity_digest,
+                                              GCancellable *cancellable, GError **error);
+
+void _ostree_repo_composefs_cache_store (OstreeRepo *self, const char *checksum,
+                                         const guchar *fsverity_digest, int src_dfd,
+                                         const char *src_name, GCancellable *cancellable);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (OstreeComposefsTarget, ostree_composefs_target_unref)
 
 G_END_DECLS
@@ -72,20 +72,37 @@ maybe_prune_loose_object (OtPruneData *data, OstreeRepoPruneFlags flags, GVarian
               ssize_t size;
               char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
               char target_checksum[OSTREE_SHA256_STRING_LEN + 1];
-              char target_buf[_OSTREE_LOOSE_PATH_MAX + _OSTREE_PAYLOAD_LINK_PREFIX_LEN];
+              char target_buf[_OSTREE_LOOSE_PATH_MAX + 2 * _OSTREE_PAYLOAD_LINK_PREFIX_LEN];
 
-              _ostree_loose_path (loose_path_buf, checksum, OSTREE_OBJECT_TYPE_PAYLOAD_LINK,
-                                  data->repo->mode);
+              _ostree_repo_loose_path (data->repo, loose_path_buf, checksum,
+                                       OSTREE_OBJECT_TYPE_PAYLOAD_LINK);
               size = readlinkat (data->repo->objects_dir_fd, loose_path_buf, target_buf,
                                  sizeof (target_buf));
+              if (size < 0 && errno == ENOENT
+                  && _ostree_repo_loose_path_alternate (data->repo, loose_path_buf, checksum,
+                                                        OSTREE_OBJECT_TYPE_PAYLOAD_LINK))
+                size = readlinkat (data->repo->objects_dir_fd, loose_path_buf, target_buf,
+                                   sizeof (target_buf));
               if (size < 0)
                 return glnx_throw_errno_prefix (error, "readlinkat");
-
-              if (size < OSTREE_SHA256_STRING_LEN + _OSTREE_PAYLOAD_LINK_PREFIX_LEN)
+              if (size >= (ssize_t)sizeof (target_buf))
                 return glnx_throw (error, "invalid data size for %s", loose_path_buf);
-
-              sprintf (target_checksum, "%.2s%.62s", target_buf + _OSTREE_PAYLOAD_LINK_PREFIX_LEN,
-                       target_buf + _OSTREE_PAYLOAD_LINK_PREFIX_LEN + 3);
+              target_buf[size] = '\0';
+
+              /* The target is ../xx/... (or ../../xx/yy/... with deep-fanout);
+               * skip the relative prefix and collect the hex portions. */
+              const char *p = target_buf;
+              while (g_str_has_prefix (p, _OSTREE_PAYLOAD_LINK_PREFIX))
+                p += _OSTREE_PAYLOAD_LINK_PREFIX_LEN;
+              guint n = 0;
+              for (; *p && *p != '.' && n < OSTREE_SHA256_STRING_LEN; p++)
+                {
+                  if (*p != '/')
+                    target_checksum[n++] = *p;
+                }
+              if (n != OSTREE_SHA256_STRING_LEN)
+                return glnx_throw (error, "invalid payload link target for %s", loose_path_buf);
+              target_checksum[n] = '\0';
 
               g_autoptr (GVariant) target_key
                   = ostree_object_name_serialize (target_checksum, OSTREE_OBJECT_TYPE_FILE);
@@ -142,6 +159,10 @@ _ostree_repo_prune_tmp (OstreeRepo *self, GCancellable *cancellable, GError **er
   if (self->cache_dir_fd == -1)
     return TRUE;
 
+  /* We consult self->remotes below to decide which summary caches to keep */
+  if (!_ostree_repo_ensure_remotes_loaded (self, cancellable, error))
+    return FALSE;
+
   g_auto (GLnxDirFdIterator) dfd_iter = {
     0,
   };
@@ -156,7 +177,7 @@ _ostree_repo_prune_tmp (OstreeRepo *self, GCancellable *cancellable, GError **er
   while (TRUE)
     {
       size_t len;
-      gboolean has_sig_suffix = FALSE;
+      size_t suffix_len = 0;
       struct dirent *dent;
       g_autofree gchar *d_name = NULL;
 
@@ -169,22 +190,31 @@ _ostree_repo_prune_tmp (OstreeRepo *self, GCancellable *cancellable, GError **er
       d_name = g_strdup (dent->d_name);
       len = strlen (d_name);
       if (len > 4 && g_strcmp0 (d_name + len - 4, ".sig") == 0)
-        {
-          has_sig_suffix = TRUE;
-          d_name[len - 4] = '\0';
-        }
+        suffix_len = 4;
+      else if (len > 13 && g_strcmp0 (d_name + len - 13, ".delta-misses") == 0)
+        suffix_len = 13;
+      if (suffix_len > 0)
+        d_name[len - suffix_len] = '\0';
 
       if (!g_hash_table_contains (self->remotes, d_name))
         {
           /* Restore the previous value to get the file name.  */
-          if (has_sig_suffix)
-            d_name[len - 4] = '.';
+          if (suffix_len > 0)
+            d_name[len - suffix_len] = '.';
 
           if (!glnx_unlinkat (dfd_iter.fd, d_name, 0, error))
             return FALSE;
         }
     }
 
+  /* Also drop the cached delta superblocks; they're regenerated on
+   * demand, and entries for deltas the server no longer publishes would
+   * otherwise accumulate forever.
+   */
+  if (!glnx_shutil_rm_rf_at (self->cache_dir_fd, _OSTREE_DELTA_SUPERBLOCK_CACHE_DIR, cancellable,
+                             error))
+    return FALSE;
+
   return TRUE;
 }
 
@@ -291,45 +321,1032 @@ repo_prune_internal (OstreeRepo *self, GHashTable *objects, OstreeRepoPruneOptio
   return TRUE;
 }
 
+#define PRUNE_INDEX_DIR "prune-index"
+#define PRUNE_INDEX_VERSION 1
+#define PRUNE_INDEX_GVARIANT_STRING "(ua(su))"
+
+/* Try to fill @reachable with the recorded closure of @commit_checksum;
+ * @out_loaded says whether an index entry was present and valid.  Any
+ * malformed entry is treated as a miss, since the traversal will simply
+ * recompute (and rewrite) it.
+ */
+static gboolean
+prune_index_load_commit (OstreeRepo *self, const char *commit_checksum, GHashTable *reachable,
+                         gboolean *out_loaded, GCancellable *cancellable, GError **error)
+{
+  *out_loaded = FALSE;
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  g_autofree char *path
+      = g_strconcat (PRUNE_INDEX_DIR "/", commit_checksum, ".reachable", NULL);
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (self->cache_dir_fd, path, &fd, error))
+    return FALSE;
+  if (fd == -1)
+    return TRUE;
+
+  g_autoptr (GVariant) index = NULL;
+  if (!ot_variant_read_fd (fd, 0, G_VARIANT_TYPE (PRUNE_INDEX_GVARIANT_STRING), FALSE, &index,
+                           NULL))
+    return TRUE; /* Corrupt; treat as a miss */
+
+  guint32 version;
+  g_autoptr (GVariant) objects_v = NULL;
+  g_variant_get (index, "(u@a(su))", &version, &objects_v);
+  if (version != PRUNE_INDEX_VERSION)
+    return TRUE;
+
+  const gsize n = g_variant_n_children (objects_v);
+  for (gsize i = 0; i < n; i++)
+    {
+      const char *checksum;
+      guint32 objtype;
+      g_variant_get_child (objects_v, i, "(&su)", &checksum, &objtype);
+      if (strlen (checksum) != OSTREE_SHA256_STRING_LEN || objtype < OSTREE_OBJECT_TYPE_FILE
+          || objtype > OSTREE_OBJECT_TYPE_LAST)
+        return TRUE; /* Corrupt; treat as a miss */
+    }
+  for (gsize i = 0; i < n; i++)
+    {
+      g_autoptr (GVariant) key = g_variant_ref_sink (g_variant_get_child_value (objects_v, i));
+      g_hash_table_add (reachable, g_steal_pointer (&key));
+    }
+
+  *out_loaded = TRUE;
+  return TRUE;
+}
+
+/* Persist the closure of @commit_checksum, replacing any previous entry
+ * atomically.  Since commits are immutable the entry never goes stale;
+ * entries for deleted commits are collected at the end of the prune.
+ */
+static gboolean
+prune_index_save_commit (OstreeRepo *self, const char *commit_checksum,
+                         GHashTable *commit_reachable, GCancellable *cancellable, GError **error)
+{
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  if (!glnx_shutil_mkdir_p_at (self->cache_dir_fd, PRUNE_INDEX_DIR, DEFAULT_DIRECTORY_MODE,
+                               cancellable, error))
+    return FALSE;
+
+  g_auto (GVariantBuilder) builder;
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (PRUNE_INDEX_GVARIANT_STRING));
+  g_variant_builder_add (&builder, "u", (guint32)PRUNE_INDEX_VERSION);
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(su)"));
+  GLNX_HASH_TABLE_FOREACH (commit_reachable, GVariant *, object)
+    g_variant_builder_add_value (&builder, object);
+  g_variant_builder_close (&builder);
+  g_autoptr (GVariant) index = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  g_auto (GLnxTmpfile) tmpf = {
+    0,
+  };
+  if (!glnx_open_tmpfile_linkable_at (self->cache_dir_fd, PRUNE_INDEX_DIR, O_WRONLY | O_CLOEXEC,
+                                      &tmpf, error))
+    return FALSE;
+  if (glnx_loop_write (tmpf.fd, g_variant_get_data (index), g_variant_get_size (index)) < 0)
+    return glnx_throw_errno_prefix (error, "write");
+  g_autofree char *path
+      = g_strconcat (PRUNE_INDEX_DIR "/", commit_checksum, ".reachable", NULL);
+  if (!glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, self->cache_dir_fd, path, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Indexed counterpart of ostree_repo_traverse_commit_with_flags(): walks
+ * the commit chain, taking each commit's closure from the persistent
+ * index when available and traversing (then recording) it otherwise.
+ */
+static gboolean
+indexed_traverse_commit (OstreeRepo *self, const char *commit_checksum, int maxdepth,
+                         GHashTable *reachable, GCancellable *cancellable, GError **error)
+{
+  g_autofree char *tmp_checksum = NULL;
+
+  while (TRUE)
+    {
+      g_autoptr (GVariant) key = g_variant_ref_sink (
+          ostree_object_name_serialize (commit_checksum, OSTREE_OBJECT_TYPE_COMMIT));
+
+      if (g_hash_table_contains (reachable, key))
+        break;
+
+      gboolean loaded = FALSE;
+      if (!prune_index_load_commit (self, commit_checksum, reachable, &loaded, cancellable, error))
+        return FALSE;
+
+      if (!loaded)
+        {
+          /* Traverse just this commit (no parents) into a private set so we
+           * can persist exactly its closure, then union it in.
+           */
+          g_autoptr (GHashTable) commit_reachable = ostree_repo_traverse_new_reachable ();
+          if (!ostree_repo_traverse_commit_union (self, commit_checksum, 0, commit_reachable,
+                                                  cancellable, error))
+            return FALSE;
+
+          /* The commit itself being absent (partial history) yields an
+           * empty closure; nothing to record.
+           */
+          if (g_hash_table_contains (commit_reachable, key))
+            {
+              /* Partial commits have an incomplete closure which can grow
+               * as objects arrive, so never index those.
+               */
+              OstreeRepoCommitState commitstate;
+              if (!ostree_repo_load_commit (self, commit_checksum, NULL, &commitstate, error))
+                return FALSE;
+              if ((commitstate & OSTREE_REPO_COMMIT_STATE_PARTIAL) == 0)
+                {
+                  if (!prune_index_save_commit (self, commit_checksum, commit_reachable,
+                                                cancellable, error))
+                    return FALSE;
+                }
+            }
+
+          GLNX_HASH_TABLE_FOREACH (commit_reachable, GVariant *, object)
+            g_hash_table_add (reachable, g_variant_ref (object));
+        }
+
+      /* Follow the parent chain like the non-indexed traversal */
+      g_autoptr (GVariant) commit = NULL;
+      if (!ostree_repo_load_variant_if_exists (self, OSTREE_OBJECT_TYPE_COMMIT, commit_checksum,
+                                               &commit, error))
+        return FALSE;
+      if (!commit)
+        break;
+
+      gboolean recurse = FALSE;
+      if (maxdepth == -1 || maxdepth > 0)
+        {
+          g_free (tmp_checksum);
+          tmp_checksum = ostree_commit_get_parent (commit);
+          if (tmp_checksum)
+            {
+              commit_checksum = tmp_checksum;
+              if (maxdepth > 0)
+                maxdepth -= 1;
+              recurse = TRUE;
+            }
+        }
+      if (!recurse)
+        break;
+    }
+
+  return TRUE;
+}
+
+/* Delete index entries for commits that are no longer present, so the
+ * index cannot outlive (or outgrow) the repository content.
+ */
+static gboolean
+prune_index_cleanup (OstreeRepo *self, GHashTable *reachable, GCancellable *cancellable,
+                     GError **error)
+{
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  gboolean exists;
+  if (!ot_dfd_iter_init_allow_noent (self->cache_dir_fd, PRUNE_INDEX_DIR, &dfd_iter, &exists,
+                                     error))
+    return FALSE;
+  if (!exists)
+    return TRUE;
+
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+
+      const char *name = dent->d_name;
+      const char *suffix = strstr (name, ".reachable");
+      gboolean keep = FALSE;
+      if (suffix != NULL && (suffix - name) == OSTREE_SHA256_STRING_LEN && strlen (suffix) == 10)
+        {
+          char checksum[OSTREE_SHA256_STRING_LEN + 1];
+          memcpy (checksum, name, OSTREE_SHA256_STRING_LEN);
+          checksum[OSTREE_SHA256_STRING_LEN] = '\0';
+          g_autoptr (GVariant) key = g_variant_ref_sink (
+              ostree_object_name_serialize (checksum, OSTREE_OBJECT_TYPE_COMMIT));
+          keep = g_hash_table_contains (reachable, key);
+        }
+
+      if (!keep)
+        {
+          if (!glnx_unlinkat (dfd_iter.fd, name, 0, error))
+            return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+/* State for the parallel reachability traversal.  Commit chains are
+ * walked serially (they're a tiny fraction of the graph), while dirtree
+ * objects fan out to a thread pool; each dirtree is claimed exactly once
+ * by inserting it into @reachable under @lock before it is pushed.
+ */
+typedef struct
+{
+  OstreeRepo *repo;
+  OtThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  guint outstanding;
+  GHashTable *reachable; /* Set<GVariant>, protected by lock */
+  GError *caught_error;  /* protected by lock */
+  GCancellable *cancellable;
+} ParallelReachableTraversal;
+
+typedef struct
+{
+  gboolean ignore_missing_dirs;
+  char checksum[OSTREE_SHA256_STRING_LEN + 1];
+} DirtreeWorkItem;
+
+/* Add the dirtree to the reachable set, and queue a traversal of its
+ * children if it wasn't already there.  Must be called with pt->lock held.
+ */
+static void
+parallel_traverse_enqueue_dirtree_locked (ParallelReachableTraversal *pt, const char *checksum,
+                                          gboolean ignore_missing_dirs)
+{
+  g_autoptr (GVariant) key
+      = g_variant_ref_sink (ostree_object_name_serialize (checksum, OSTREE_OBJECT_TYPE_DIR_TREE));
+
+  if (!g_hash_table_add (pt->reachable, g_steal_pointer (&key)))
+    return;
+
+  DirtreeWorkItem *item = g_new0 (DirtreeWorkItem, 1);
+  item->ignore_missing_dirs = ignore_missing_dirs;
+  memcpy (item->checksum, checksum, OSTREE_SHA256_STRING_LEN);
+  pt->outstanding++;
+  ot_thread_pool_push (pt->pool, item);
+}
+
+static void
+parallel_traverse_dirtree_worker (gpointer data, gpointer user_data)
+{
+  g_autofree DirtreeWorkItem *item = data;
+  ParallelReachableTraversal *pt = user_data;
+  g_autoptr (GVariant) tree = NULL;
+  g_autoptr (GError) local_error = NULL;
+
+  g_mutex_lock (&pt->lock);
+  gboolean skip = (pt->caught_error != NULL) || g_cancellable_is_cancelled (pt->cancellable);
+  g_mutex_unlock (&pt->lock);
+
+  if (!skip)
+    {
+      if (item->ignore_missing_dirs)
+        {
+          /* Partial commit; a missing subtree just terminates this branch,
+           * matching traverse_iter().
+           */
+          if (!ostree_repo_load_variant_if_exists (pt->repo, OSTREE_OBJECT_TYPE_DIR_TREE,
+                                                   item->checksum, &tree, &local_error))
+            tree = NULL;
+        }
+      else if (!ostree_repo_load_variant (pt->repo, OSTREE_OBJECT_TYPE_DIR_TREE, item->checksum,
+                                          &tree, &local_error))
+        tree = NULL;
+    }
+
+  if (tree != NULL)
+    {
+      /* PARSE OSTREE_SERIALIZED_TREE_VARIANT */
+      g_autoptr (GVariant) files_variant = g_variant_get_child_value (tree, 0);
+      g_autoptr (GVariant) dirs_variant = g_variant_get_child_value (tree, 1);
+      const guint n_files = g_variant_n_children (files_variant);
+      const guint n_dirs = g_variant_n_children (dirs_variant);
+
+      g_mutex_lock (&pt->lock);
+      for (guint i = 0; local_error == NULL && i < n_files; i++)
+        {
+          const char *filename;
+          g_autoptr (GVariant) csum = NULL;
+          g_variant_get_child (files_variant, i, "(&s@ay)", &filename, &csum);
+
+          const guchar *csum_bytes = ostree_checksum_bytes_peek_validate (csum, &local_error);
+          if (csum_bytes == NULL)
+            {
+              glnx_prefix_error (&local_error, "File %u in dirtree %s", i, item->checksum);
+              break;
+            }
+
+          char buf[OSTREE_SHA256_STRING_LEN + 1];
+          ostree_checksum_inplace_from_bytes (csum_bytes, buf);
+          g_hash_table_add (pt->reachable,
+                            g_variant_ref_sink (
+                                ostree_object_name_serialize (buf, OSTREE_OBJECT_TYPE_FILE)));
+        }
+
+      for (guint i = 0; local_error == NULL && i < n_dirs; i++)
+        {
+          const char *dirname;
+          g_autoptr (GVariant) tree_csum = NULL;
+          g_autoptr (GVariant) meta_csum = NULL;
+          g_variant_get_child (dirs_variant, i, "(&s@ay@ay)", &dirname, &tree_csum, &meta_csum);
+
+          const guchar *tree_csum_bytes
+              = ostree_checksum_bytes_peek_validate (tree_csum, &local_error);
+          const guchar *meta_csum_bytes
+              = tree_csum_bytes
+                    ? ostree_checksum_bytes_peek_validate (meta_csum, &local_error)
+                    : NULL;
+          if (meta_csum_bytes == NULL)
+            {
+              glnx_prefix_error (&local_error, "Dir %u in dirtree %s", i, item->checksum);
+              break;
+            }
+
+          char buf[OSTREE_SHA256_STRING_LEN + 1];
+          ostree_checksum_inplace_from_bytes (meta_csum_bytes, buf);
+          g_hash_table_add (pt->reachable,
+                            g_variant_ref_sink (
+                                ostree_object_name_serialize (buf, OSTREE_OBJECT_TYPE_DIR_META)));
+
+          ostree_checksum_inplace_from_bytes (tree_csum_bytes, buf);
+          parallel_traverse_enqueue_dirtree_locked (pt, buf, item->ignore_missing_dirs);
+        }
+      g_mutex_unlock (&pt->lock);
+    }
+
+  g_mutex_lock (&pt->lock);
+  if (local_error != NULL && pt->caught_error == NULL)
+    pt->caught_error = g_steal_pointer (&local_error);
+  g_assert_cmpuint (pt->outstanding, >, 0);
+  pt->outstanding--;
+  g_cond_signal (&pt->cond);
+  g_mutex_unlock (&pt->lock);
+}
+
+/* Parallel counterpart of ostree_repo_traverse_commit_with_flags(): walks
+ * the commit chain serially, handing each root dirtree to the pool.
+ */
+static gboolean
+parallel_traverse_commit (ParallelReachableTraversal *pt, OstreeRepoCommitTraverseFlags flags,
+                          const char *commit_checksum, int maxdepth, GError **error)
+{
+  g_autofree char *tmp_checksum = NULL;
+  gboolean commit_only = flags & OSTREE_REPO_COMMIT_TRAVERSE_FLAG_COMMIT_ONLY;
+
+  while (TRUE)
+    {
+      g_autoptr (GVariant) key = g_variant_ref_sink (
+          ostree_object_name_serialize (commit_checksum, OSTREE_OBJECT_TYPE_COMMIT));
+
+      g_mutex_lock (&pt->lock);
+      gboolean seen = g_hash_table_contains (pt->reachable, key);
+      g_mutex_unlock (&pt->lock);
+      if (seen)
+        break;
+
+      g_autoptr (GVariant) commit = NULL;
+      if (!ostree_repo_load_variant_if_exists (pt->repo, OSTREE_OBJECT_TYPE_COMMIT,
+                                               commit_checksum, &commit, error))
+        return FALSE;
+
+      /* Just return if the commit isn't found; we do expect most
+       * people to have partial repositories.
+       */
+      if (!commit)
+        break;
+
+      OstreeRepoCommitState commitstate;
+      if (!ostree_repo_load_commit (pt->repo, commit_checksum, NULL, &commitstate, error))
+        return FALSE;
+
+      gboolean ignore_missing_dirs = (commitstate & OSTREE_REPO_COMMIT_STATE_PARTIAL) != 0;
+
+      g_mutex_lock (&pt->lock);
+      g_hash_table_add (pt->reachable, g_variant_ref (key));
+      g_mutex_unlock (&pt->lock);
+
+      if (!commit_only)
+        {
+          g_autoptr (GVariant) tree_contents_csum = NULL;
+          g_autoptr (GVariant) tree_meta_csum = NULL;
+          g_variant_get_child (commit, 6, "@ay", &tree_contents_csum);
+          g_variant_get_child (commit, 7, "@ay", &tree_meta_csum);
+
+          const guchar *tree_contents_csum_bytes
+              = ostree_checksum_bytes_peek_validate (tree_contents_csum, error);
+          if (tree_contents_csum_bytes == NULL)
+            return glnx_prefix_error (error, "Commit %s", commit_checksum);
+          const guchar *tree_meta_csum_bytes
+              = ostree_checksum_bytes_peek_validate (tree_meta_csum, error);
+          if (tree_meta_csum_bytes == NULL)
+            return glnx_prefix_error (error, "Commit %s", commit_checksum);
+
+          char buf[OSTREE_SHA256_STRING_LEN + 1];
+          ostree_checksum_inplace_from_bytes (tree_meta_csum_bytes, buf);
+
+          g_mutex_lock (&pt->lock);
+          g_hash_table_add (pt->reachable,
+                            g_variant_ref_sink (
+                                ostree_object_name_serialize (buf, OSTREE_OBJECT_TYPE_DIR_META)));
+          ostree_checksum_inplace_from_bytes (tree_contents_csum_bytes, buf);
+          parallel_traverse_enqueue_dirtree_locked (pt, buf, ignore_missing_dirs);
+          g_mutex_unlock (&pt->lock);
+        }
+
+      gboolean recurse = FALSE;
+      if (maxdepth == -1 || maxdepth > 0)
+        {
+          g_free (tmp_checksum);
+          tmp_checksum = ostree_commit_get_parent (commit);
+          if (tmp_checksum)
+            {
+              commit_checksum = tmp_checksum;
+              if (maxdepth > 0)
+                maxdepth -= 1;
+              recurse = TRUE;
+            }
+        }
+      if (!recurse)
+        break;
+    }
+
+  return TRUE;
+}
+
+static void
+parallel_traverse_init (ParallelReachableTraversal *pt, OstreeRepo *self, GHashTable *reachable,
+                        GCancellable *cancellable)
+{
+  memset (pt, 0, sizeof (*pt));
+  pt->repo = self;
+  pt->reachable = reachable;
+  pt->cancellable = cancellable;
+  g_mutex_init (&pt->lock);
+  g_cond_init (&pt->cond);
+  pt->pool
+      = ot_thread_pool_new ("prune-traverse", parallel_traverse_dirtree_worker, pt,
+                            g_get_num_processors ());
+}
+
+/* Wait for all queued dirtrees, tear down the pool, and propagate the
+ * first worker error (if any).
+ */
+static gboolean
+parallel_traverse_finish (ParallelReachableTraversal *pt, GError **error)
+{
+  g_mutex_lock (&pt->lock);
+  while (pt->outstanding > 0)
+    g_cond_wait (&pt->cond, &pt->lock);
+  g_mutex_unlock (&pt->lock);
+
+  ot_thread_pool_free (pt->pool);
+  pt->pool = NULL;
+
+  gboolean ret = TRUE;
+  if (pt->caught_error != NULL)
+    {
+      g_propagate_error (error, g_steal_pointer (&pt->caught_error));
+      ret = FALSE;
+    }
+
+  g_mutex_clear (&pt->lock);
+  g_cond_clear (&pt->cond);
+  return ret;
+}
+
 static gboolean
 traverse_reachable_internal (OstreeRepo *self, OstreeRepoCommitTraverseFlags flags, guint depth,
-                             GHashTable *reachable, GCancellable *cancellable, GError **error)
+                             gboolean parallel, gboolean indexed, GHashTable *reachable,
+                             GCancellable *cancellable, GError **error)
 {
   g_autoptr (OstreeRepoAutoLock) lock
       = ostree_repo_auto_lock_push (self, OSTREE_REPO_LOCK_SHARED, cancellable, error);
   if (!lock)
     return FALSE;
 
-  /* Ignoring collections. */
-  g_autoptr (GHashTable) all_refs = NULL; /* (element-type utf8 utf8) */
+  /* Declared before the first goto so the auto cleanups are in scope */
+  g_autoptr (GHashTable) all_refs = NULL;            /* (element-type utf8 utf8) */
+  g_autoptr (GHashTable) all_collection_refs = NULL; /* (element-type OstreeChecksumRef utf8) */
 
+  ParallelReachableTraversal pt;
+  if (parallel)
+    parallel_traverse_init (&pt, self, reachable, cancellable);
+
+  gboolean ret = FALSE;
+
+  /* Ignoring collections. */
   if (!ostree_repo_list_refs (self, NULL, &all_refs, cancellable, error))
-    return FALSE;
+    goto out;
 
   GLNX_HASH_TABLE_FOREACH_V (all_refs, const char *, checksum)
     {
       g_debug ("Finding objects to keep for commit %s", checksum);
-      if (!ostree_repo_traverse_commit_with_flags (self, flags, checksum, depth, reachable, NULL,
-                                                   cancellable, error))
-        return FALSE;
+      if (indexed)
+        {
+          if (!indexed_traverse_commit (self, checksum, depth, reachable, cancellable, error))
+            goto out;
+        }
+      else if (parallel)
+        {
+          if (!parallel_traverse_commit (&pt, flags, checksum, depth, error))
+            goto out;
+        }
+      else if (!ostree_repo_traverse_commit_with_flags (self, flags, checksum, depth, reachable,
+                                                        NULL, cancellable, error))
+        goto out;
     }
 
   /* Using collections. */
-  g_autoptr (GHashTable) all_collection_refs = NULL; /* (element-type OstreeChecksumRef utf8) */
-
   if (!ostree_repo_list_collection_refs (self, NULL, &all_collection_refs,
                                          OSTREE_REPO_LIST_REFS_EXT_EXCLUDE_REMOTES, cancellable,
                                          error))
-    return FALSE;
+    goto out;
 
   GLNX_HASH_TABLE_FOREACH_V (all_collection_refs, const char *, checksum)
     {
       g_debug ("Finding objects to keep for commit %s", checksum);
-      if (!ostree_repo_traverse_commit_with_flags (self, flags, checksum, depth, reachable, NULL,
-                                                   cancellable, error))
+      if (indexed)
+        {
+          if (!indexed_traverse_commit (self, checksum, depth, reachable, cancellable, error))
+            goto out;
+        }
+      else if (parallel)
+        {
+          if (!parallel_traverse_commit (&pt, flags, checksum, depth, error))
+            goto out;
+        }
+      else if (!ostree_repo_traverse_commit_with_flags (self, flags, checksum, depth, reachable,
+                                                        NULL, cancellable, error))
+        goto out;
+    }
+
+  ret = TRUE;
+out:
+  if (parallel)
+    {
+      /* Always drain the pool; on the error path workers reference state
+       * on this stack frame.
+       */
+      g_autoptr (GError) pool_error = NULL;
+      if (!parallel_traverse_finish (&pt, ret ? error : &pool_error))
+        ret = FALSE;
+    }
+  return ret;
+}
+
+/* The refcount ledger maintains a persistent per-object reference count:
+ * for each object, the number of accounted commits whose closure contains
+ * it.  Commits append increments for their closure to a write-ahead log
+ * when the transaction completes; a refcount-mode prune reconciles the
+ * ledger against the commits actually present (accounting commits the
+ * ledger missed, un-accounting commits being discarded), marks every
+ * object with a positive count reachable, and lazily compacts the log
+ * into a snapshot.  Only commits entering or leaving the ledger are ever
+ * traversed, so steady-state prunes do no graph traversal at all.
+ *
+ * Like the prune index, the ledger lives in the cache directory and any
+ * inconsistency just degrades to a rebuild from a full traversal.
+ */
+
+#define REFCOUNT_LEDGER_DIR "refcounts"
+#define REFCOUNT_LEDGER_WAL REFCOUNT_LEDGER_DIR "/ledger.wal"
+#define REFCOUNT_LEDGER_SNAPSHOT REFCOUNT_LEDGER_DIR "/counts"
+#define REFCOUNT_LEDGER_VERSION 1
+#define REFCOUNT_LEDGER_GVARIANT_STRING "(uta(yayu))"
+/* op byte, objtype byte, binary checksum */
+#define REFCOUNT_LEDGER_RECORD_SIZE (2 + OSTREE_SHA256_DIGEST_LEN)
+#define REFCOUNT_LEDGER_OP_INCREF '+'
+#define REFCOUNT_LEDGER_OP_DECREF '-'
+
+gboolean
+_ostree_repo_refcount_ledger_exists (OstreeRepo *self)
+{
+  if (self->cache_dir_fd == -1)
+    return FALSE;
+  struct stat stbuf;
+  return fstatat (self->cache_dir_fd, REFCOUNT_LEDGER_SNAPSHOT, &stbuf, 0) == 0;
+}
+
+static void
+refcount_ledger_encode_object (GByteArray *buf, guint8 op, const char *checksum,
+                               OstreeObjectType objtype, guint n)
+{
+  guint8 record[REFCOUNT_LEDGER_RECORD_SIZE];
+  record[0] = op;
+  record[1] = (guint8)objtype;
+  ostree_checksum_inplace_to_bytes (checksum, record + 2);
+  for (guint i = 0; i < n; i++)
+    g_byte_array_append (buf, record, sizeof (record));
+}
+
+/* Encode one WAL record per object in @closure, each @n times.  Commit
+ * records are written last so that a torn write can never leave a commit
+ * accounted while part of its closure is missing; load just sees an
+ * unaccounted commit and the next prune re-accounts it.
+ */
+static void
+refcount_ledger_encode_closure (GByteArray *buf, guint8 op, GHashTable *closure, guint n)
+{
+  GLNX_HASH_TABLE_FOREACH (closure, GVariant *, object)
+    {
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (object, &checksum, &objtype);
+      if (objtype != OSTREE_OBJECT_TYPE_COMMIT)
+        refcount_ledger_encode_object (buf, op, checksum, objtype, n);
+    }
+  GLNX_HASH_TABLE_FOREACH (closure, GVariant *, object)
+    {
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (object, &checksum, &objtype);
+      if (objtype == OSTREE_OBJECT_TYPE_COMMIT)
+        refcount_ledger_encode_object (buf, op, checksum, objtype, n);
+    }
+}
+
+/* Durably append the encoded records in @buf to the write-ahead log */
+static gboolean
+refcount_ledger_commit_wal (OstreeRepo *self, GByteArray *buf, GCancellable *cancellable,
+                            GError **error)
+{
+  if (buf->len == 0)
+    return TRUE;
+
+  if (!glnx_shutil_mkdir_p_at (self->cache_dir_fd, REFCOUNT_LEDGER_DIR, DEFAULT_DIRECTORY_MODE,
+                               cancellable, error))
+    return FALSE;
+
+  glnx_autofd int fd = openat (self->cache_dir_fd, REFCOUNT_LEDGER_WAL,
+                               O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return glnx_throw_errno_prefix (error, "openat(%s)", REFCOUNT_LEDGER_WAL);
+  if (glnx_loop_write (fd, buf->data, buf->len) < 0)
+    return glnx_throw_errno_prefix (error, "write(%s)", REFCOUNT_LEDGER_WAL);
+  if (fdatasync (fd) < 0)
+    return glnx_throw_errno_prefix (error, "fdatasync(%s)", REFCOUNT_LEDGER_WAL);
+
+  return TRUE;
+}
+
+static void
+refcount_counts_add (GHashTable *counts, GVariant *object, gint delta)
+{
+  guint count = GPOINTER_TO_UINT (g_hash_table_lookup (counts, object));
+
+  if (delta < 0 && (guint)(-delta) >= count)
+    count = 0;
+  else
+    count += delta;
+  g_hash_table_replace (counts, g_variant_ref (object), GUINT_TO_POINTER (count));
+}
+
+/* Fill @counts from the snapshot plus the WAL records it does not yet
+ * cover.  @out_valid reports whether a usable ledger was found; any
+ * malformed state is treated as absent since the prune just rebuilds.
+ */
+static gboolean
+refcount_ledger_load (OstreeRepo *self, GHashTable *counts, gboolean *out_valid,
+                      GCancellable *cancellable, GError **error)
+{
+  *out_valid = FALSE;
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  glnx_autofd int snap_fd = -1;
+  if (!ot_openat_ignore_enoent (self->cache_dir_fd, REFCOUNT_LEDGER_SNAPSHOT, &snap_fd, error))
+    return FALSE;
+  if (snap_fd == -1)
+    return TRUE;
+
+  g_autoptr (GVariant) snapshot = NULL;
+  if (!ot_variant_read_fd (snap_fd, 0, G_VARIANT_TYPE (REFCOUNT_LEDGER_GVARIANT_STRING), FALSE,
+                           &snapshot, NULL))
+    return TRUE; /* Corrupt; treat as absent */
+
+  guint32 version;
+  guint64 wal_offset;
+  g_autoptr (GVariant) entries = NULL;
+  g_variant_get (snapshot, "(ut@a(yayu))", &version, &wal_offset, &entries);
+  if (version != REFCOUNT_LEDGER_VERSION)
+    return TRUE;
+
+  const gsize n = g_variant_n_children (entries);
+  for (gsize i = 0; i < n; i++)
+    {
+      guint8 objtype;
+      guint32 count;
+      g_autoptr (GVariant) csum_v = NULL;
+      g_variant_get_child (entries, i, "(y@ayu)", &objtype, &csum_v, &count);
+      if (objtype < OSTREE_OBJECT_TYPE_FILE || objtype > OSTREE_OBJECT_TYPE_LAST
+          || g_variant_get_size (csum_v) != OSTREE_SHA256_DIGEST_LEN)
+        goto invalid;
+
+      char checksum[OSTREE_SHA256_STRING_LEN + 1];
+      ostree_checksum_inplace_from_bytes (g_variant_get_data (csum_v), checksum);
+      g_autoptr (GVariant) object
+          = g_variant_ref_sink (ostree_object_name_serialize (checksum, objtype));
+      g_hash_table_replace (counts, g_steal_pointer (&object), GUINT_TO_POINTER (count));
+    }
+
+  glnx_autofd int wal_fd = -1;
+  if (!ot_openat_ignore_enoent (self->cache_dir_fd, REFCOUNT_LEDGER_WAL, &wal_fd, error))
+    return FALSE;
+
+  guint64 wal_size = 0;
+  if (wal_fd != -1)
+    {
+      struct stat stbuf;
+      if (!glnx_fstat (wal_fd, &stbuf, error))
         return FALSE;
+      wal_size = stbuf.st_size;
     }
+  /* A WAL shorter than the snapshot covers means a crash interrupted
+   * compaction between resetting the log and landing the snapshot.
+   */
+  if (wal_size < wal_offset)
+    goto invalid;
 
+  /* Replay whole records past the snapshot; a torn final record is
+   * ignored, which at worst leaves a commit unaccounted (see
+   * refcount_ledger_encode_closure()).
+   */
+  const guint64 n_records = (wal_size - wal_offset) / REFCOUNT_LEDGER_RECORD_SIZE;
+  for (guint64 i = 0; i < n_records; i++)
+    {
+      guint8 record[REFCOUNT_LEDGER_RECORD_SIZE];
+      const guint64 offset = wal_offset + i * REFCOUNT_LEDGER_RECORD_SIZE;
+      if (TEMP_FAILURE_RETRY (pread (wal_fd, record, sizeof (record), offset))
+          != sizeof (record))
+        return glnx_throw_errno_prefix (error, "pread(%s)", REFCOUNT_LEDGER_WAL);
+
+      const guint8 op = record[0];
+      const guint8 objtype = record[1];
+      if ((op != REFCOUNT_LEDGER_OP_INCREF && op != REFCOUNT_LEDGER_OP_DECREF)
+          || objtype < OSTREE_OBJECT_TYPE_FILE || objtype > OSTREE_OBJECT_TYPE_LAST)
+        goto invalid;
+
+      char checksum[OSTREE_SHA256_STRING_LEN + 1];
+      ostree_checksum_inplace_from_bytes (record + 2, checksum);
+      g_autoptr (GVariant) object
+          = g_variant_ref_sink (ostree_object_name_serialize (checksum, objtype));
+      refcount_counts_add (counts, object, op == REFCOUNT_LEDGER_OP_INCREF ? 1 : -1);
+    }
+
+  *out_valid = TRUE;
+  return TRUE;
+
+invalid:
+  g_hash_table_remove_all (counts);
+  return TRUE;
+}
+
+/* Compact @counts into a fresh snapshot.  The WAL is reset first: if we
+ * crash before the snapshot lands, its recorded offset exceeds the WAL
+ * size and load rebuilds; the opposite order would silently double-apply
+ * the old records.
+ */
+static gboolean
+refcount_ledger_save (OstreeRepo *self, GHashTable *counts, GCancellable *cancellable,
+                      GError **error)
+{
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  if (!glnx_shutil_mkdir_p_at (self->cache_dir_fd, REFCOUNT_LEDGER_DIR, DEFAULT_DIRECTORY_MODE,
+                               cancellable, error))
+    return FALSE;
+
+  glnx_autofd int wal_fd = openat (self->cache_dir_fd, REFCOUNT_LEDGER_WAL,
+                                   O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (wal_fd < 0)
+    return glnx_throw_errno_prefix (error, "openat(%s)", REFCOUNT_LEDGER_WAL);
+
+  g_auto (GVariantBuilder) builder;
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (REFCOUNT_LEDGER_GVARIANT_STRING));
+  g_variant_builder_add (&builder, "u", (guint32)REFCOUNT_LEDGER_VERSION);
+  g_variant_builder_add (&builder, "t", (guint64)0);
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(yayu)"));
+  GLNX_HASH_TABLE_FOREACH_KV (counts, GVariant *, object, gpointer, countp)
+    {
+      const guint count = GPOINTER_TO_UINT (countp);
+      if (count == 0)
+        continue;
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (object, &checksum, &objtype);
+      g_variant_builder_add (&builder, "(y@ayu)", (guint8)objtype,
+                             ostree_checksum_to_bytes_v (checksum), (guint32)count);
+    }
+  g_variant_builder_close (&builder);
+  g_autoptr (GVariant) snapshot = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  g_auto (GLnxTmpfile) tmpf = {
+    0,
+  };
+  if (!glnx_open_tmpfile_linkable_at (self->cache_dir_fd, REFCOUNT_LEDGER_DIR,
+                                      O_WRONLY | O_CLOEXEC, &tmpf, error))
+    return FALSE;
+  if (glnx_loop_write (tmpf.fd, g_variant_get_data (snapshot), g_variant_get_size (snapshot)) < 0)
+    return glnx_throw_errno_prefix (error, "write");
+  if (!glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, self->cache_dir_fd,
+                             REFCOUNT_LEDGER_SNAPSHOT, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* The closure of @checksum alone (no parents), taken from the prune
+ * index when available — the indexed and refcount modes share it — and
+ * traversed otherwise.
+ */
+static gboolean
+refcount_commit_closure (OstreeRepo *self, const char *checksum, GHashTable **out_closure,
+                         GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GHashTable) closure = ostree_repo_traverse_new_reachable ();
+
+  gboolean loaded = FALSE;
+  if (!prune_index_load_commit (self, checksum, closure, &loaded, cancellable, error))
+    return FALSE;
+  if (!loaded)
+    {
+      if (!ostree_repo_traverse_commit_union (self, checksum, 0, closure, cancellable, error))
+        return FALSE;
+    }
+
+  *out_closure = g_steal_pointer (&closure);
+  return TRUE;
+}
+
+gboolean
+_ostree_repo_refcount_ledger_account_commits (OstreeRepo *self, GPtrArray *written_commits,
+                                              GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GByteArray) buf = g_byte_array_new ();
+
+  for (guint i = 0; i < written_commits->len; i++)
+    {
+      const OstreeRepoCommitGraphEntry *entry = written_commits->pdata[i];
+      char checksum[OSTREE_SHA256_STRING_LEN + 1];
+      ostree_checksum_inplace_from_bytes (entry->checksum, checksum);
+
+      /* Partial commits (e.g. mid-pull) have a closure that can still
+       * grow; the next prune's reconciliation pass picks them up once
+       * they are complete.
+       */
+      OstreeRepoCommitState commitstate;
+      if (!ostree_repo_load_commit (self, checksum, NULL, &commitstate, error))
+        return FALSE;
+      if (commitstate & OSTREE_REPO_COMMIT_STATE_PARTIAL)
+        continue;
+
+      g_autoptr (GHashTable) closure = NULL;
+      if (!refcount_commit_closure (self, checksum, &closure, cancellable, error))
+        return FALSE;
+      refcount_ledger_encode_closure (buf, REFCOUNT_LEDGER_OP_INCREF, closure, 1);
+    }
+
+  return refcount_ledger_commit_wal (self, buf, cancellable, error);
+}
+
+/* Compute the reachable set for a refcount-mode prune by reconciling the
+ * ledger with @objects: commits to be kept which the ledger has not seen
+ * get their closure accounted, commits being discarded get theirs
+ * un-accounted (as many times as they were accounted, so duplicate
+ * increments from idempotent re-commits cancel exactly), and then every
+ * object with a positive count is reachable.  @out_counts returns the
+ * reconciled counts for compaction after the deletions succeed.
+ */
+static gboolean
+refcount_compute_reachable (OstreeRepo *self, OstreeRepoPruneFlags flags, gint depth,
+                            GHashTable *objects, GHashTable *reachable, GHashTable **out_counts,
+                            GCancellable *cancellable, GError **error)
+{
+  const gboolean mutate = (flags & OSTREE_REPO_PRUNE_FLAGS_NO_PRUNE) == 0;
+  g_autoptr (GHashTable) counts = g_hash_table_new_full (
+      ostree_hash_object_name, g_variant_equal, (GDestroyNotify)g_variant_unref, NULL);
+
+  gboolean valid = FALSE;
+  if (!refcount_ledger_load (self, counts, &valid, cancellable, error))
+    return FALSE;
+
+  /* Commits accounted in the ledger but no longer present were deleted
+   * behind our back (say, by a non-refcount prune); their contributions
+   * cannot be un-accounted any more, so rebuild from scratch.
+   */
+  GLNX_HASH_TABLE_FOREACH_KV (counts, GVariant *, object, gpointer, countp)
+    {
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (object, &checksum, &objtype);
+      if (objtype == OSTREE_OBJECT_TYPE_COMMIT && GPOINTER_TO_UINT (countp) > 0
+          && !g_hash_table_contains (objects, object))
+        {
+          g_hash_table_remove_all (counts);
+          break;
+        }
+    }
+
+  /* Which commits to keep: every present commit by default, only those
+   * reachable from refs (within @depth) for a refs-only prune.
+   */
+  g_autoptr (GHashTable) live = ostree_repo_traverse_new_reachable ();
+  if (flags & OSTREE_REPO_PRUNE_FLAGS_REFS_ONLY)
+    {
+      if (!traverse_reachable_internal (self, OSTREE_REPO_COMMIT_TRAVERSE_FLAG_COMMIT_ONLY, depth,
+                                        FALSE, FALSE, live, cancellable, error))
+        return FALSE;
+    }
+  else
+    {
+      GLNX_HASH_TABLE_FOREACH (objects, GVariant *, serialized_key)
+        {
+          const char *checksum;
+          OstreeObjectType objtype;
+          ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+          if (objtype == OSTREE_OBJECT_TYPE_COMMIT)
+            g_hash_table_add (live, g_variant_ref (serialized_key));
+        }
+    }
+
+  g_autoptr (GByteArray) wal_buf = g_byte_array_new ();
+
+  GLNX_HASH_TABLE_FOREACH (objects, GVariant *, serialized_key)
+    {
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+      if (objtype != OSTREE_OBJECT_TYPE_COMMIT)
+        continue;
+
+      const guint accounted = GPOINTER_TO_UINT (g_hash_table_lookup (counts, serialized_key));
+      const gboolean keep = g_hash_table_contains (live, serialized_key);
+
+      if (keep && accounted == 0)
+        {
+          /* Partial commits have a closure that can still grow; keep
+           * them out of the ledger and mark their current closure
+           * reachable for just this run.
+           */
+          OstreeRepoCommitState commitstate;
+          if (!ostree_repo_load_commit (self, checksum, NULL, &commitstate, error))
+            return FALSE;
+
+          g_autoptr (GHashTable) closure = NULL;
+          if (!refcount_commit_closure (self, checksum, &closure, cancellable, error))
+            return FALSE;
+
+          if (commitstate & OSTREE_REPO_COMMIT_STATE_PARTIAL)
+            {
+              GLNX_HASH_TABLE_FOREACH (closure, GVariant *, object)
+                g_hash_table_add (reachable, g_variant_ref (object));
+              continue;
+            }
+
+          GLNX_HASH_TABLE_FOREACH (closure, GVariant *, object)
+            refcount_counts_add (counts, object, 1);
+          if (mutate)
+            refcount_ledger_encode_closure (wal_buf, REFCOUNT_LEDGER_OP_INCREF, closure, 1);
+        }
+      else if (!keep && accounted > 0)
+        {
+          g_autoptr (GHashTable) closure = NULL;
+          if (!refcount_commit_closure (self, checksum, &closure, cancellable, error))
+            return FALSE;
+
+          GLNX_HASH_TABLE_FOREACH (closure, GVariant *, object)
+            refcount_counts_add (counts, object, -(gint)accounted);
+          if (mutate)
+            refcount_ledger_encode_closure (wal_buf, REFCOUNT_LEDGER_OP_DECREF, closure,
+                                            accounted);
+        }
+    }
+
+  /* Make the reconciliation durable before anything is deleted; a crash
+   * from here on re-runs the deletions against correct counts.
+   */
+  if (mutate)
+    {
+      if (!refcount_ledger_commit_wal (self, wal_buf, cancellable, error))
+        return FALSE;
+    }
+
+  GLNX_HASH_TABLE_FOREACH_KV (counts, GVariant *, object, gpointer, countp)
+    {
+      if (GPOINTER_TO_UINT (countp) > 0)
+        g_hash_table_add (reachable, g_variant_ref (object));
+    }
+
+  *out_counts = g_steal_pointer (&counts);
   return TRUE;
 }
 
@@ -350,8 +1367,8 @@ gboolean
 ostree_repo_traverse_reachable_refs (OstreeRepo *self, guint depth, GHashTable *reachable,
                                      GCancellable *cancellable, GError **error)
 {
-  return traverse_reachable_internal (self, OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE, depth, reachable,
-                                      cancellable, error);
+  return traverse_reachable_internal (self, OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE, depth, FALSE,
+                                      FALSE, reachable, cancellable, error);
 }
 
 /**
@@ -394,6 +1411,16 @@ ostree_repo_prune (OstreeRepo *self, OstreeRepoPruneFlags flags, gint depth,
   g_autoptr (GHashTable) objects = NULL;
   gboolean refs_only = flags & OSTREE_REPO_PRUNE_FLAGS_REFS_ONLY;
   gboolean commit_only = flags & OSTREE_REPO_PRUNE_FLAGS_COMMIT_ONLY;
+  /* The ledger replaces reachability traversal entirely */
+  gboolean refcount = (flags & OSTREE_REPO_PRUNE_FLAGS_REFCOUNT) != 0;
+  /* The index only pays off when we actually descend into dirtrees */
+  gboolean indexed
+      = (flags & OSTREE_REPO_PRUNE_FLAGS_INDEXED_TRAVERSAL) && !commit_only && !refcount;
+  /* Parallelism only helps when we actually descend into dirtrees; the
+   * indexed traversal is serial and takes precedence.
+   */
+  gboolean parallel = (flags & OSTREE_REPO_PRUNE_FLAGS_PARALLEL_TRAVERSAL) && !commit_only
+                      && !indexed && !refcount;
 
   g_autoptr (GHashTable) reachable = ostree_repo_traverse_new_reachable ();
 
@@ -406,9 +1433,10 @@ ostree_repo_prune (OstreeRepo *self, OstreeRepoPruneFlags flags, gint depth,
   if (commit_only)
     traverse_flags |= OSTREE_REPO_COMMIT_TRAVERSE_FLAG_COMMIT_ONLY;
 
-  if (refs_only)
+  if (refs_only && !refcount)
     {
-      if (!traverse_reachable_internal (self, traverse_flags, depth, reachable, cancellable, error))
+      if (!traverse_reachable_internal (self, traverse_flags, depth, parallel, indexed, reachable,
+                                        cancellable, error))
         return FALSE;
     }
 
@@ -427,8 +1455,20 @@ ostree_repo_prune (OstreeRepo *self, OstreeRepoPruneFlags flags, gint depth,
   if (!objects)
     return FALSE;
 
-  if (!refs_only)
+  g_autoptr (GHashTable) refcounts = NULL;
+  if (refcount)
+    {
+      if (!refcount_compute_reachable (self, flags, depth, objects, reachable, &refcounts,
+                                       cancellable, error))
+        return FALSE;
+    }
+  else if (!refs_only)
     {
+      ParallelReachableTraversal pt;
+      if (parallel)
+        parallel_traverse_init (&pt, self, reachable, cancellable);
+      gboolean traverse_ok = TRUE;
+
       GLNX_HASH_TABLE_FOREACH (objects, GVariant *, serialized_key)
         {
           const char *checksum;
@@ -440,17 +1480,53 @@ ostree_repo_prune (OstreeRepo *self, OstreeRepoPruneFlags flags, gint depth,
             continue;
 
           g_debug ("Finding objects to keep for commit %s", checksum);
-          if (!ostree_repo_traverse_commit_with_flags (self, traverse_flags, checksum, depth,
-                                                       reachable, NULL, cancellable, error))
-            return FALSE;
+          if (indexed)
+            traverse_ok = indexed_traverse_commit (self, checksum, depth, reachable, cancellable, error);
+          else if (parallel)
+            traverse_ok = parallel_traverse_commit (&pt, traverse_flags, checksum, depth, error);
+          else
+            traverse_ok = ostree_repo_traverse_commit_with_flags (
+                self, traverse_flags, checksum, depth, reachable, NULL, cancellable, error);
+          if (!traverse_ok)
+            break;
+        }
+
+      if (parallel)
+        {
+          g_autoptr (GError) pool_error = NULL;
+          if (!parallel_traverse_finish (&pt, traverse_ok ? error : &pool_error))
+            traverse_ok = FALSE;
         }
+      if (!traverse_ok)
+        return FALSE;
     }
 
   {
     OstreeRepoPruneOptions opts = { flags, reachable };
-    return repo_prune_internal (self, objects, &opts, out_objects_total, out_objects_pruned,
-                                out_pruned_object_size_total, cancellable, error);
+    if (!repo_prune_internal (self, objects, &opts, out_objects_total, out_objects_pruned,
+                              out_pruned_object_size_total, cancellable, error))
+      return FALSE;
   }
+
+  /* With the deletions done, fold the write-ahead log into a fresh
+   * snapshot so the next load replays as little as possible.
+   */
+  if (refcount && (flags & OSTREE_REPO_PRUNE_FLAGS_NO_PRUNE) == 0)
+    {
+      if (!refcount_ledger_save (self, refcounts, cancellable, error))
+        return FALSE;
+    }
+
+  /* Drop index entries for commits we just deleted; they'd never be
+   * consulted again, but there's no point carrying them around.
+   */
+  if (indexed && (flags & OSTREE_REPO_PRUNE_FLAGS_NO_PRUNE) == 0)
+    {
+      if (!prune_index_cleanup (self, reachable, cancellable, error))
+        return FALSE;
+    }
+
+  return TRUE;
 }
 
 /**
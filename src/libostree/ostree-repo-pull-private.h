@@ -32,6 +32,15 @@ typedef enum
   OSTREE_FETCHER_SECURITY_STATE_INSECURE,
 } OstreeFetcherSecurityState;
 
+/* Per-object pull bookkeeping bits, stored in OtPullData's object_statuses
+ * table keyed by (binary checksum, object type). */
+typedef enum
+{
+  OT_PULL_OBJECT_REQUESTED = (1 << 0),      /* A fetch or local import has been enqueued */
+  OT_PULL_OBJECT_SCANNED = (1 << 1),        /* Metadata object has been scanned */
+  OT_PULL_OBJECT_DELTA_FALLBACK = (1 << 2), /* Content object requested as a delta fallback */
+} OtPullObjectStatus;
+
 typedef struct
 {
   OstreeRepo *repo;
@@ -45,6 +54,8 @@ typedef struct
 
   GPtrArray *meta_mirrorlist;    /* List of base URIs for fetching metadata */
   GPtrArray *content_mirrorlist; /* List of base URIs for fetching content */
+  GPtrArray *content_stripe_rotations; /* Array<GPtrArray>, rotations of content_mirrorlist */
+  guint content_stripe_counter;        /* round-robin cursor over the rotations */
   OstreeRepo *remote_repo_local;
   GPtrArray *localcache_repos; /* Array<OstreeRepo> */
 
@@ -54,11 +65,14 @@ typedef struct
 
   GVariant *extra_headers;
   char *append_user_agent;
+  guint64 limit_rate_bytes_per_sec; /* 0 = unlimited */
 
   gboolean dry_run;
   gboolean dry_run_emitted_progress;
   gboolean legacy_transaction_resuming;
   guint n_network_retries;
+  guint max_outstanding_fetcher_requests;
+  guint max_outstanding_write_requests;
   enum
   {
     OSTREE_PULL_PHASE_FETCHING_REFS,
@@ -80,24 +94,32 @@ typedef struct
   char *summary_sig_etag;
   guint64 summary_sig_last_modified; /* seconds since the epoch */
   GVariant *summary;
+  GVariant *summary_ref_shards;         /* (nullable) aay of shard digests, from the summary */
+  GHashTable *summary_shards;           /* (nullable) Map<shard index,GVariant> of fetched shards */
+  GHashTable *summary_collection_map_index; /* (nullable) Map<collection ID,GVariant ref list>
+                                               built lazily over the summary's collection map */
   GHashTable *summary_deltas_checksums; /* Filled from summary and delta indexes */
   gboolean summary_has_deltas;          /* True if the summary existed and had a delta index */
   gboolean has_indexed_deltas;
+  GHashTable *delta_miss_cache; /* (nullable) Set<delta name> of superblock probes known to 404
+                                   under the current summary; see delta_miss_cache_ensure_loaded()
+                                 */
+  gboolean delta_miss_cache_valid; /* True if the miss cache can be persisted for this pull */
+  guint8 delta_miss_summary_digest[OSTREE_SHA256_DIGEST_LEN];
   GHashTable *ref_original_commits;     /* Maps checksum to commit, used by timestamp checks */
   GHashTable *verified_commits;         /* Set<checksum> of commits that have been verified */
   GHashTable *signapi_verified_commits; /* Map<checksum,verification> of commits that have been
                                            signapi verified */
   GHashTable *ref_keyring_map;          /* Maps OstreeCollectionRef to keyring remote name */
+  GHashTable *gpg_keyring_digests;      /* Maps keyring remote name to keyring content digest */
   GPtrArray *static_delta_superblocks;
   GHashTable *expected_commit_sizes;           /* Maps commit checksum to known size */
   GHashTable *commit_to_depth;                 /* Maps parent commit checksum maximum depth */
-  GHashTable *scanned_metadata;                /* Maps object name to itself */
+  OtObjectStatusTable *object_statuses;        /* Set of OtPullObjectStatus per object */
   GHashTable *fetched_detached_metadata;       /* Map<checksum,GVariant> */
-  GHashTable *requested_metadata;              /* Maps object name to itself */
-  GHashTable *requested_content;               /* Maps checksum to itself */
-  GHashTable *requested_fallback_content;      /* Maps checksum to itself */
   GHashTable *pending_fetch_metadata;          /* Map<ObjectName,FetchObjectData> */
-  GHashTable *pending_fetch_content;           /* Map<checksum,FetchObjectData> */
+  GSequence *pending_fetch_content;            /* FetchObjectData, sorted by expected size */
+  GHashTable *object_sizes;                    /* (nullable) Map<checksum,guint64*>, from ostree.sizes */
   GHashTable *pending_fetch_delta_indexes;     /* Set<FetchDeltaIndexData> */
   GHashTable *pending_fetch_delta_superblocks; /* Set<FetchDeltaSuperData> */
   GHashTable *pending_fetch_deltaparts;        /* Set<FetchStaticDeltaData> */
@@ -107,6 +129,8 @@ typedef struct
   guint n_outstanding_content_write_requests;
   guint n_outstanding_deltapart_fetches;
   guint n_outstanding_deltapart_write_requests;
+  guint64 deltapart_inflight_bytes; /* Compressed size of parts downloading or applying */
+  guint64 max_deltapart_inflight_bytes;
   guint n_total_deltaparts;
   guint n_total_delta_fallbacks;
   guint64 fetched_deltapart_size; /* How much of the delta we have now */
@@ -122,6 +146,15 @@ typedef struct
   guint n_imported_metadata;
   guint n_imported_content;
 
+  /* Structured metrics, published via the progress object in
+   * update_progress().  Phase timings are monotonic-clock microseconds.
+   */
+  guint64 summary_fetch_usecs; /* Fetching and verifying the summary */
+  guint64 metadata_scan_usecs; /* Accumulated scan_one_metadata_object() time */
+  guint64 delta_apply_usecs;   /* Accumulated static delta part execution time */
+  guint64 imported_bytes;      /* Bytes satisfied from local repos, not the network */
+  GArray *request_latencies;   /* guint64 usecs per completed fetcher request */
+
   gboolean timestamp_check; /* Verify commit timestamps */
   char *timestamp_check_from_rev;
   int maxdepth;
@@ -142,12 +175,48 @@ typedef struct
   guint64 previous_bytes_sec;
   guint64 previous_total_downloaded;
 
+  /* Slab arenas backing the high-volume per-object records
+   * (FetchObjectData, ScanObjectQueueData); freed wholesale at the end
+   * of the pull, after all individual records have been returned.
+   */
+  OtArena *fetch_data_arena;
+  OtArena *scan_data_arena;
+
   GError *cached_async_error;
   GError **async_error;
   gboolean caught_error;
 
   GQueue scan_object_queue;
   GSource *idle_src;
+
+  /* Snapshot of locally present objects, to answer has-object probes
+   * without a stat() each; NULL if building it failed.
+   */
+  OstreeRepoObjectIndex *object_index; /* (nullable) */
+
+  /* Worker threads probing the repo for queued metadata scans; results
+   * flow back to the main loop through scan_prefetch_results.
+   */
+  OtThreadPool *scan_prefetch_pool; /* (nullable) */
+  GAsyncQueue *scan_prefetch_results;
+  guint n_outstanding_scan_prefetches;
+
+  /* Dedicated worker running commit signature verification off the main
+   * loop, so fetch dispatch isn't stalled on gpgme; verdicts flow back
+   * to the main loop through verify_results.
+   */
+  OtThreadPool *verify_pool; /* (nullable) */
+  GAsyncQueue *verify_results;
+  guint n_outstanding_verify_requests;
+
+  /* Coalescing metadata fetches into byte-range requests against remote
+   * pack files (see ostree-repo-pack.c); remote_pack_objects is NULL if
+   * the remote publishes no packs.
+   */
+  GHashTable *remote_pack_objects; /* Map<ObjectName,RemotePackObject> */
+  GHashTable *remote_pack_batches; /* Map<pack name,Array<FetchObjectData>> */
+  GSource *pack_flush_src;
+  gboolean pack_ranges_disabled;
 } OtPullData;
 
 gboolean _signapi_init_for_remote (OstreeRepo *repo, const char *remote_name,
@@ -160,7 +229,52 @@ gboolean _verify_unwritten_commit (OtPullData *pull_data, const char *checksum,
                                    GVariant *detached_metadata, const OstreeCollectionRef *ref,
                                    GCancellable *cancellable, GError **error);
 
+/* One commit signature verification handed to the verify worker.  The main
+ * loop fills the inputs in _verify_commit_job_new(), the worker runs the
+ * crypto in _verify_commit_job_run() touching nothing but the job, and the
+ * verdict is applied back on the main loop by _verify_commit_job_finish().
+ */
+typedef struct
+{
+  OstreeRepo *repo;          /* (unowned) */
+  GCancellable *cancellable; /* (unowned) (nullable) */
+  char *checksum;
+  GBytes *signed_data;
+  GVariant *detached_metadata;  /* (nullable) */
+  gboolean do_gpg;
+  char *keyring_remote;         /* Only set when do_gpg */
+  GPtrArray *signapi_verifiers; /* (unowned) (nullable) */
+
+  /* Results, filled by _verify_commit_job_run() */
+  OstreeGpgVerifyResult *gpg_result; /* (nullable) */
+  char *signapi_success_message;     /* (nullable) */
+  GError *error;
+
+  gpointer user_data; /* Owned by the caller */
+} OtVerifyCommitJob;
+
+OtVerifyCommitJob *_verify_commit_job_new (OtPullData *pull_data, const char *checksum,
+                                           GVariant *commit, GVariant *detached_metadata,
+                                           const OstreeCollectionRef *ref,
+                                           GCancellable *cancellable);
+
+void _verify_commit_job_run (OtVerifyCommitJob *job);
+
+gboolean _verify_commit_job_finish (OtPullData *pull_data, OtVerifyCommitJob *job, GError **error);
+
+void _verify_commit_job_free (OtVerifyCommitJob *job);
+
 gboolean _process_gpg_verify_result (OtPullData *pull_data, const char *checksum,
                                      OstreeGpgVerifyResult *result, GError **error);
 
+#ifndef OSTREE_DISABLE_GPGME
+gboolean _gpg_verify_cached_lookup (OtPullData *pull_data, const char *checksum,
+                                    const char *keyring_remote, GBytes *signed_data,
+                                    GVariant *detached_metadata, GCancellable *cancellable);
+
+void _gpg_verify_cached_mark (OtPullData *pull_data, const char *checksum,
+                              const char *keyring_remote, GBytes *signed_data,
+                              GVariant *detached_metadata, GCancellable *cancellable);
+#endif /* OSTREE_DISABLE_GPGME */
+
 G_END_DECLS
@@ -294,6 +294,117 @@ _sign_verify_for_remote (GPtrArray *verifiers, GBytes *signed_data, GVariant *me
 }
 
 #ifndef OSTREE_DISABLE_GPGME
+
+/* Persistent cache of successful GPG commit verifications, so that re-pulling
+ * an unchanged ref (e.g. a mirror sync cycle) doesn't pay the gpgme cost of
+ * re-verifying every commit.  Each entry is a file under the repo cache dir
+ * named by commit checksum, whose content is a digest over the signed commit
+ * data, its detached metadata, and the keyring the remote verifies against —
+ * so updating the keyring, re-signing, or rewriting the commit all invalidate
+ * the entry.  Entries expire after a day, since gpgme rechecks key and
+ * signature expiry on every run and the cache does not.
+ */
+#define GPG_VERIFIED_CACHE_DIR "gpg-verified"
+#define GPG_VERIFIED_CACHE_MAX_AGE_SECS (24 * 60 * 60)
+
+static char *
+gpg_verify_cached_digest (OtPullData *pull_data, const char *keyring_remote, GBytes *signed_data,
+                          GVariant *detached_metadata, GCancellable *cancellable)
+{
+  const char *keyring_digest
+      = g_hash_table_lookup (pull_data->gpg_keyring_digests, keyring_remote);
+  if (keyring_digest == NULL)
+    {
+      g_autoptr (GError) local_error = NULL;
+      char *computed = _ostree_repo_gpg_keyring_digest (pull_data->repo, keyring_remote,
+                                                        cancellable, &local_error);
+      if (computed == NULL)
+        {
+          g_debug ("Not caching GPG verification for remote %s: %s", keyring_remote,
+                   local_error->message);
+          return NULL;
+        }
+      g_hash_table_insert (pull_data->gpg_keyring_digests, g_strdup (keyring_remote), computed);
+      keyring_digest = computed;
+    }
+
+  g_autoptr (GChecksum) checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  gsize len;
+  const guint8 *buf = g_bytes_get_data (signed_data, &len);
+  g_checksum_update (checksum, buf, len);
+  if (detached_metadata != NULL)
+    g_checksum_update (checksum, g_variant_get_data (detached_metadata),
+                       g_variant_get_size (detached_metadata));
+  g_checksum_update (checksum, (const guchar *)keyring_digest, strlen (keyring_digest));
+
+  return g_strdup (g_checksum_get_string (checksum));
+}
+
+/* Returns %TRUE if a previous run verified @checksum against the same signed
+ * data, detached metadata and keyring content.  Purely an optimization; any
+ * failure here just means gpgme runs again.
+ */
+gboolean
+_gpg_verify_cached_lookup (OtPullData *pull_data, const char *checksum,
+                           const char *keyring_remote, GBytes *signed_data,
+                           GVariant *detached_metadata, GCancellable *cancellable)
+{
+  OstreeRepo *repo = pull_data->repo;
+  if (repo->cache_dir_fd == -1)
+    return FALSE;
+
+  g_autofree char *expected_digest
+      = gpg_verify_cached_digest (pull_data, keyring_remote, signed_data, detached_metadata,
+                                  cancellable);
+  if (expected_digest == NULL)
+    return FALSE;
+
+  g_autofree char *path = g_strconcat (GPG_VERIFIED_CACHE_DIR "/", checksum, NULL);
+  glnx_autofd int fd = openat (repo->cache_dir_fd, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return FALSE;
+
+  struct stat stbuf;
+  if (fstat (fd, &stbuf) < 0)
+    return FALSE;
+  if (stbuf.st_mtime + GPG_VERIFIED_CACHE_MAX_AGE_SECS < time (NULL))
+    return FALSE;
+
+  g_autoptr (GBytes) contents = glnx_fd_readall_bytes (fd, cancellable, NULL);
+  if (contents == NULL)
+    return FALSE;
+
+  gsize len;
+  const guint8 *buf = g_bytes_get_data (contents, &len);
+  return len == strlen (expected_digest) && memcmp (buf, expected_digest, len) == 0;
+}
+
+/* Record that @checksum passed GPG verification, keyed as above.  Best
+ * effort; failures are logged and swallowed.
+ */
+void
+_gpg_verify_cached_mark (OtPullData *pull_data, const char *checksum, const char *keyring_remote,
+                         GBytes *signed_data, GVariant *detached_metadata,
+                         GCancellable *cancellable)
+{
+  OstreeRepo *repo = pull_data->repo;
+  if (repo->cache_dir_fd == -1)
+    return;
+
+  g_autofree char *digest = gpg_verify_cached_digest (pull_data, keyring_remote, signed_data,
+                                                      detached_metadata, cancellable);
+  if (digest == NULL)
+    return;
+
+  glnx_autofd int cache_dfd = -1;
+  g_autoptr (GError) local_error = NULL;
+  if (!glnx_shutil_mkdir_p_at_open (repo->cache_dir_fd, GPG_VERIFIED_CACHE_DIR, 0755, &cache_dfd,
+                                    cancellable, &local_error)
+      || !glnx_file_replace_contents_at (cache_dfd, checksum, (const guint8 *)digest,
+                                         strlen (digest), 0, cancellable, &local_error))
+    g_debug ("Failed to cache GPG verification of %s: %s", checksum, local_error->message);
+}
+
 gboolean
 _process_gpg_verify_result (OtPullData *pull_data, const char *checksum,
                             OstreeGpgVerifyResult *result, GError **error)
@@ -457,11 +568,25 @@ _verify_unwritten_commit (OtPullData *pull_data, const char *checksum, GVariant
       if (keyring_remote == NULL)
         keyring_remote = pull_data->remote_name;
 
-      g_autoptr (OstreeGpgVerifyResult) result
-          = _ostree_repo_gpg_verify_with_metadata (pull_data->repo, signed_data, detached_metadata,
-                                                   keyring_remote, NULL, NULL, cancellable, error);
-      if (!_process_gpg_verify_result (pull_data, checksum, result, error))
-        return FALSE;
+      if (_gpg_verify_cached_lookup (pull_data, checksum, keyring_remote, signed_data,
+                                     detached_metadata, cancellable))
+        {
+          /* A previous run verified this exact commit against the same
+           * keyring; skip gpgme.  Note no "gpg-verify-result" signal is
+           * emitted on a cache hit. */
+          g_hash_table_add (pull_data->verified_commits, g_strdup (checksum));
+        }
+      else
+        {
+          g_autoptr (OstreeGpgVerifyResult) result = _ostree_repo_gpg_verify_with_metadata (
+              pull_data->repo, signed_data, detached_metadata, keyring_remote, NULL, NULL,
+              cancellable, error);
+          if (!_process_gpg_verify_result (pull_data, checksum, result, error))
+            return FALSE;
+
+          _gpg_verify_cached_mark (pull_data, checksum, keyring_remote, signed_data,
+                                   detached_metadata, cancellable);
+        }
     }
 #endif /* OSTREE_DISABLE_GPGME */
 
@@ -484,3 +609,145 @@ _verify_unwritten_commit (OtPullData *pull_data, const char *checksum, GVariant
 
   return TRUE;
 }
+
+/* Split of _verify_unwritten_commit() for offloading the crypto to a worker
+ * thread: _new() runs on the main loop and captures everything the worker
+ * needs (including resolving keyring remotes and consulting the verification
+ * cache, which touch pull_data state), _run() does the gpgme/signapi calls
+ * and touches nothing but the job, and _finish() applies the verdict back on
+ * the main loop (signal emission, verified-commit bookkeeping, cache marks).
+ * Returns %NULL if verification was fully satisfied synchronously (disabled,
+ * already verified, or a cache hit) and no worker trip is needed.
+ */
+OtVerifyCommitJob *
+_verify_commit_job_new (OtPullData *pull_data, const char *checksum, GVariant *commit,
+                        GVariant *detached_metadata, const OstreeCollectionRef *ref,
+                        GCancellable *cancellable)
+{
+  g_autoptr (GBytes) signed_data = g_variant_get_data_as_bytes (commit);
+  gboolean need_gpg = FALSE;
+  const char *keyring_remote = NULL;
+
+  /* Shouldn't happen, but see comment in process_gpg_verify_result() */
+  const gboolean need_signapi
+      = (pull_data->signapi_commit_verifiers != NULL
+         && !g_hash_table_contains (pull_data->signapi_verified_commits, checksum));
+
+#ifndef OSTREE_DISABLE_GPGME
+  if (pull_data->gpg_verify && !g_hash_table_contains (pull_data->verified_commits, checksum))
+    {
+      if (ref != NULL)
+        keyring_remote = g_hash_table_lookup (pull_data->ref_keyring_map, ref);
+      if (keyring_remote == NULL)
+        keyring_remote = pull_data->remote_name;
+
+      if (_gpg_verify_cached_lookup (pull_data, checksum, keyring_remote, signed_data,
+                                     detached_metadata, cancellable))
+        {
+          /* A previous run verified this exact commit against the same
+           * keyring; skip gpgme.  Note no "gpg-verify-result" signal is
+           * emitted on a cache hit. */
+          g_hash_table_add (pull_data->verified_commits, g_strdup (checksum));
+        }
+      else
+        need_gpg = TRUE;
+    }
+#endif /* OSTREE_DISABLE_GPGME */
+
+  if (!need_gpg && !need_signapi)
+    return NULL;
+
+  OtVerifyCommitJob *job = g_new0 (OtVerifyCommitJob, 1);
+  job->repo = pull_data->repo;
+  job->cancellable = cancellable;
+  job->checksum = g_strdup (checksum);
+  job->signed_data = g_steal_pointer (&signed_data);
+  job->detached_metadata = detached_metadata != NULL ? g_variant_ref (detached_metadata) : NULL;
+  job->do_gpg = need_gpg;
+  if (need_gpg)
+    job->keyring_remote = g_strdup (keyring_remote);
+  if (need_signapi)
+    job->signapi_verifiers = pull_data->signapi_commit_verifiers;
+  return job;
+}
+
+void
+_verify_commit_job_run (OtVerifyCommitJob *job)
+{
+#ifndef OSTREE_DISABLE_GPGME
+  if (job->do_gpg)
+    {
+      job->gpg_result
+          = _ostree_repo_gpg_verify_with_metadata (job->repo, job->signed_data,
+                                                   job->detached_metadata, job->keyring_remote,
+                                                   NULL, NULL, job->cancellable, &job->error);
+      if (job->gpg_result == NULL)
+        return;
+    }
+#endif /* OSTREE_DISABLE_GPGME */
+
+  if (job->signapi_verifiers != NULL)
+    {
+      /* Nothing to check if detached metadata is absent */
+      if (job->detached_metadata == NULL)
+        {
+          glnx_throw (&job->error, "Can't verify commit without detached metadata");
+          return;
+        }
+
+      if (!_sign_verify_for_remote (job->signapi_verifiers, job->signed_data,
+                                    job->detached_metadata, &job->signapi_success_message,
+                                    &job->error))
+        glnx_prefix_error (&job->error, "Can't verify commit");
+    }
+}
+
+gboolean
+_verify_commit_job_finish (OtPullData *pull_data, OtVerifyCommitJob *job, GError **error)
+{
+#ifndef OSTREE_DISABLE_GPGME
+  if (job->do_gpg)
+    {
+      /* On a gpgme failure gpg_result is NULL and job->error holds the
+       * cause; _process_gpg_verify_result() adds the commit prefix. */
+      if (job->error != NULL)
+        g_propagate_error (error, g_steal_pointer (&job->error));
+      if (!_process_gpg_verify_result (pull_data, job->checksum, job->gpg_result, error))
+        return FALSE;
+
+      _gpg_verify_cached_mark (pull_data, job->checksum, job->keyring_remote, job->signed_data,
+                               job->detached_metadata, pull_data->cancellable);
+    }
+#endif /* OSTREE_DISABLE_GPGME */
+
+  if (job->error != NULL)
+    {
+      g_propagate_error (error, g_steal_pointer (&job->error));
+      return FALSE;
+    }
+
+  if (job->signapi_success_message != NULL)
+    {
+      /* Mark the commit as verified to avoid double verification
+       * see process_verify_result () for rationale */
+      g_hash_table_insert (pull_data->signapi_verified_commits, g_strdup (job->checksum),
+                           g_steal_pointer (&job->signapi_success_message));
+    }
+
+  return TRUE;
+}
+
+void
+_verify_commit_job_free (OtVerifyCommitJob *job)
+{
+  if (job == NULL)
+    return;
+  g_free (job->checksum);
+  g_clear_pointer (&job->signed_data, g_bytes_unref);
+  g_clear_pointer (&job->detached_metadata, g_variant_unref);
+  g_free (job->keyring_remote);
+  g_clear_object (&job->gpg_result);
+  g_free (job->signapi_success_message);
+  g_clear_error (&job->error);
+  g_free (job);
+}
@@ -32,6 +32,8 @@
 
 #ifdef HAVE_LIBCURL_OR_LIBSOUP
 
+#include "bsdiff/bspatch.h"
+#include "ostree-bloom-private.h"
 #include "ostree-core-private.h"
 #include "ostree-metalink.h"
 #include "ostree-repo-static-delta-private.h"
@@ -62,6 +64,17 @@
  * `n-network-retries` pull option. */
 #define DEFAULT_N_NETWORK_RETRIES 5
 
+/* When coalescing packed metadata fetches into byte ranges: merge two
+ * objects into one range if the unwanted bytes between them are at most
+ * this large, and cap the total range size so a single response doesn't
+ * monopolize a connection.
+ */
+#define PACK_RANGE_MAX_GAP (32 * 1024)
+#define PACK_RANGE_MAX_LENGTH (4 * 1024 * 1024)
+
+/* Upper bound on the size of a single remote pack index */
+#define PACK_INDEX_MAX_SIZE (100 * 1024 * 1024)
+
 typedef struct
 {
   OtPullData *pull_data;
@@ -76,6 +89,8 @@ typedef struct
 
   OstreeCollectionRef *requested_ref; /* (nullable) */
   guint n_retries_remaining;
+  guint64 fetch_start_time; /* monotonic usecs; feeds the request latency metrics */
+  guint64 expected_size;    /* from ostree.sizes when known, else 0 */
 } FetchObjectData;
 
 typedef struct
@@ -88,15 +103,22 @@ typedef struct
   guint i;
   guint64 size;
   guint n_retries_remaining;
+  guint64 fetch_start_time; /* monotonic usecs; reused to time the apply stage */
 } FetchStaticDeltaData;
 
 typedef struct
 {
+  OtPullData *pull_data;
   guchar csum[OSTREE_SHA256_DIGEST_LEN];
   char *path;
   OstreeObjectType objtype;
   guint recursion_depth;              /* NB: not used anymore, though might be nice to print */
   OstreeCollectionRef *requested_ref; /* (nullable) */
+
+  /* Filled in by the scan prefetch worker threads */
+  gboolean prefetched;           /* Repo membership was probed off the main loop */
+  gboolean prefetched_is_stored; /* Result of that probe */
+  GVariant *prefetched_object;   /* (nullable) preloaded commit/dirtree variant */
 } ScanObjectQueueData;
 
 typedef struct
@@ -117,6 +139,30 @@ typedef struct
   guint n_retries_remaining;
 } FetchDeltaIndexData;
 
+/* Where a metadata object lives inside a remote pack file; see
+ * fetch_remote_pack_indexes() and ostree-repo-pack.c for the format.
+ */
+typedef struct
+{
+  char *pack_name;
+  guint64 offset;
+  guint64 length;
+} RemotePackObject;
+
+/* One in-flight byte-range request against a remote pack data file,
+ * carrying the batched metadata fetches it will satisfy.
+ */
+typedef struct
+{
+  OtPullData *pull_data;
+  char *pack_name;
+  guint64 range_start;
+  guint64 range_length;
+  GPtrArray *objects; /* FetchObjectData, sorted by pack offset; elements
+                         are consumed individually on completion */
+  guint64 fetch_start_time; /* monotonic usecs; feeds the request latency metrics */
+} PackRangeRequest;
+
 static void
 variant_or_null_unref (gpointer data)
 {
@@ -125,10 +171,12 @@ variant_or_null_unref (gpointer data)
 }
 
 static void start_fetch (OtPullData *pull_data, FetchObjectData *fetch);
+static void pending_fetch_content_clear (OtPullData *pull_data);
 static void start_fetch_deltapart (OtPullData *pull_data, FetchStaticDeltaData *fetch);
 static void start_fetch_delta_superblock (OtPullData *pull_data, FetchDeltaSuperData *fetch_data);
 static void start_fetch_delta_index (OtPullData *pull_data, FetchDeltaIndexData *fetch_data);
 static gboolean fetcher_queue_is_full (OtPullData *pull_data);
+static gboolean metadata_fetcher_queue_is_full (OtPullData *pull_data);
 static void queue_scan_one_metadata_object (OtPullData *pull_data, const char *csum,
                                             OstreeObjectType objtype, const char *path,
                                             guint recursion_depth, const OstreeCollectionRef *ref);
@@ -148,15 +196,48 @@ static void enqueue_one_static_delta_superblock_request_s (OtPullData *pull_data
 static void enqueue_one_static_delta_part_request_s (OtPullData *pull_data,
                                                      FetchStaticDeltaData *fetch_data);
 static void ensure_idle_queued (OtPullData *pull_data);
-
-static gboolean scan_one_metadata_object (OtPullData *pull_data, const char *checksum,
-                                          OstreeObjectType objtype, const char *path,
-                                          guint recursion_depth, const OstreeCollectionRef *ref,
-                                          GCancellable *cancellable, GError **error);
+static void collect_scan_prefetch_results (OtPullData *pull_data);
+static void collect_verify_results (OtPullData *pull_data);
+static void ensure_pack_flush_queued (OtPullData *pull_data);
+static void pack_batches_abandon (OtPullData *pull_data);
+
+static gboolean scan_one_metadata_object (OtPullData *pull_data, ScanObjectQueueData *scan_data,
+                                          const char *checksum, GCancellable *cancellable,
+                                          GError **error);
 static void scan_object_queue_data_free (ScanObjectQueueData *scan_data);
 static gboolean initiate_delta_request (OtPullData *pull_data, const OstreeCollectionRef *ref,
                                         const char *to_revision, const char *delta_from_revision,
                                         GError **error);
+static gboolean _ostree_repo_load_cache_summary_file (OstreeRepo *self, const char *filename,
+                                                      const char *extension, GBytes **out_data,
+                                                      GCancellable *cancellable, GError **error);
+static gboolean _ostree_repo_save_cache_summary_file (OstreeRepo *self, const char *filename,
+                                                      const char *extension, GBytes *data,
+                                                      const char *etag, guint64 last_modified,
+                                                      GCancellable *cancellable, GError **error);
+
+static gint
+compare_uint64 (gconstpointer ap, gconstpointer bp)
+{
+  guint64 a = *(const guint64 *)ap;
+  guint64 b = *(const guint64 *)bp;
+  if (a < b)
+    return -1;
+  else if (a > b)
+    return 1;
+  return 0;
+}
+
+/* Nearest-rank percentile over the sorted request latency array;
+ * returns 0 when no requests have completed yet.
+ */
+static guint64
+latency_percentile (GArray *latencies, guint percentile)
+{
+  if (latencies->len == 0)
+    return 0;
+  return g_array_index (latencies, guint64, (latencies->len - 1) * percentile / 100);
+}
 
 static gboolean
 update_progress (gpointer user_data)
@@ -191,10 +272,20 @@ update_progress (gpointer user_data)
   n_scanned_metadata = pull_data->n_scanned_metadata;
   start_time = pull_data->start_time;
 
+  /* Completion callbacks only ever append, so sorting in place here is
+   * safe; the array stays mostly sorted between timer ticks.
+   */
+  g_array_sort (pull_data->request_latencies, compare_uint64);
+
   ostree_async_progress_set (
       pull_data->progress, "outstanding-fetches", "u", outstanding_fetches, "outstanding-writes",
       "u", outstanding_writes, "fetched", "u", fetched, "requested", "u", requested, "scanning",
-      "u", g_queue_is_empty (&pull_data->scan_object_queue) ? 0 : 1, "caught-error", "b",
+      "u",
+      (g_queue_is_empty (&pull_data->scan_object_queue)
+       && pull_data->n_outstanding_scan_prefetches == 0)
+          ? 0
+          : 1,
+      "caught-error", "b",
       pull_data->caught_error, "scanned-metadata", "u", n_scanned_metadata, "bytes-transferred",
       "t", bytes_transferred, "start-time", "t", start_time,
       /* We use these status keys even though we now also
@@ -215,6 +306,18 @@ update_progress (gpointer user_data)
          specifically. */
       "outstanding-metadata-fetches", "u", pull_data->n_outstanding_metadata_fetches,
       "metadata-fetched", "u", pull_data->n_fetched_metadata,
+      /* Structured metrics: per-phase wall-clock costs, HTTP request
+       * latency percentiles, and how many bytes were satisfied from
+       * local repos rather than the network.  Together these let a
+       * monitoring agent tell a slow CDN from slow local I/O.
+       */
+      "summary-fetch-usecs", "t", pull_data->summary_fetch_usecs, "metadata-scan-usecs", "t",
+      pull_data->metadata_scan_usecs, "delta-apply-usecs", "t", pull_data->delta_apply_usecs,
+      "bytes-from-cache", "t", pull_data->imported_bytes, "request-count", "u",
+      pull_data->request_latencies->len, "request-latency-p50-usecs", "t",
+      latency_percentile (pull_data->request_latencies, 50), "request-latency-p90-usecs", "t",
+      latency_percentile (pull_data->request_latencies, 90), "request-latency-p99-usecs", "t",
+      latency_percentile (pull_data->request_latencies, 99),
       /* Overall status. */
       "status", "s", "", NULL);
 
@@ -224,18 +327,56 @@ update_progress (gpointer user_data)
   return TRUE;
 }
 
+/* Thin wrappers over the per-object status table, converting the hex
+ * checksums used throughout this file to the binary form it is keyed by. */
+static guint8
+pull_object_status (OtPullData *pull_data, const char *checksum, OstreeObjectType objtype)
+{
+  guint8 csum[OSTREE_SHA256_DIGEST_LEN];
+  ostree_checksum_inplace_to_bytes (checksum, csum);
+  return ot_object_status_table_get (pull_data->object_statuses, csum, (guint8)objtype);
+}
+
+static void
+pull_object_set_status (OtPullData *pull_data, const char *checksum, OstreeObjectType objtype,
+                        guint8 status_bits)
+{
+  guint8 csum[OSTREE_SHA256_DIGEST_LEN];
+  ostree_checksum_inplace_to_bytes (checksum, csum);
+  ot_object_status_table_set (pull_data->object_statuses, csum, (guint8)objtype, status_bits);
+}
+
+static gboolean
+pull_object_clear_status (OtPullData *pull_data, const char *checksum, OstreeObjectType objtype,
+                          guint8 status_bits)
+{
+  guint8 csum[OSTREE_SHA256_DIGEST_LEN];
+  ostree_checksum_inplace_to_bytes (checksum, csum);
+  return ot_object_status_table_clear (pull_data->object_statuses, csum, (guint8)objtype,
+                                       status_bits);
+}
+
 /* The core logic function for whether we should continue the main loop */
 static gboolean
 pull_termination_condition (OtPullData *pull_data)
 {
+  /* Pick up any scans the prefetch workers finished; they wake up the
+   * main context after pushing results.  Likewise signature verdicts.
+   */
+  collect_scan_prefetch_results (pull_data);
+  collect_verify_results (pull_data);
+
   gboolean current_fetch_idle = (pull_data->n_outstanding_metadata_fetches == 0
                                  && pull_data->n_outstanding_content_fetches == 0
                                  && pull_data->n_outstanding_deltapart_fetches == 0);
   gboolean current_write_idle = (pull_data->n_outstanding_metadata_write_requests == 0
                                  && pull_data->n_outstanding_content_write_requests == 0
                                  && pull_data->n_outstanding_deltapart_write_requests == 0);
-  gboolean current_scan_idle = g_queue_is_empty (&pull_data->scan_object_queue);
-  gboolean current_idle = current_fetch_idle && current_write_idle && current_scan_idle;
+  gboolean current_scan_idle = (g_queue_is_empty (&pull_data->scan_object_queue)
+                                && pull_data->n_outstanding_scan_prefetches == 0);
+  gboolean current_verify_idle = (pull_data->n_outstanding_verify_requests == 0);
+  gboolean current_idle
+      = current_fetch_idle && current_write_idle && current_scan_idle && current_verify_idle;
 
   /* we only enter the main loop when we're fetching objects */
   g_assert (pull_data->phase == OSTREE_PULL_PHASE_FETCHING_OBJECTS);
@@ -281,11 +422,13 @@ check_outstanding_requests_handle_error (OtPullData *pull_data, GError **errorp)
     {
       g_queue_foreach (&pull_data->scan_object_queue, (GFunc)scan_object_queue_data_free, NULL);
       g_queue_clear (&pull_data->scan_object_queue);
+      if (pull_data->remote_pack_batches != NULL)
+        pack_batches_abandon (pull_data);
       g_hash_table_remove_all (pull_data->pending_fetch_metadata);
       g_hash_table_remove_all (pull_data->pending_fetch_delta_indexes);
       g_hash_table_remove_all (pull_data->pending_fetch_delta_superblocks);
       g_hash_table_remove_all (pull_data->pending_fetch_deltaparts);
-      g_hash_table_remove_all (pull_data->pending_fetch_content);
+      pending_fetch_content_clear (pull_data);
     }
   else
     {
@@ -301,7 +444,8 @@ check_outstanding_requests_handle_error (OtPullData *pull_data, GError **errorp)
 
       /* Try filling the queue with metadata we need to fetch */
       g_hash_table_iter_init (&hiter, pull_data->pending_fetch_metadata);
-      while (!fetcher_queue_is_full (pull_data) && g_hash_table_iter_next (&hiter, &key, &value))
+      while (!metadata_fetcher_queue_is_full (pull_data)
+             && g_hash_table_iter_next (&hiter, &key, &value))
         {
           GVariant *objname = key;
           FetchObjectData *fetch = value;
@@ -343,20 +487,20 @@ check_outstanding_requests_handle_error (OtPullData *pull_data, GError **errorp)
           start_fetch_deltapart (pull_data, fetch);
         }
 
-      /* Next, fill the queue with content */
-      g_hash_table_iter_init (&hiter, pull_data->pending_fetch_content);
-      while (!fetcher_queue_is_full (pull_data) && g_hash_table_iter_next (&hiter, &key, &value))
+      /* Next, fill the queue with content, largest objects first (when
+       * sizes are known) so a late-discovered giant object starts as
+       * early as possible and small objects fill remaining concurrency.
+       */
+      while (!fetcher_queue_is_full (pull_data)
+             && g_sequence_get_length (pull_data->pending_fetch_content) > 0)
         {
-          char *checksum = key;
-          FetchObjectData *fetch = value;
+          GSequenceIter *last
+              = g_sequence_iter_prev (g_sequence_get_end_iter (pull_data->pending_fetch_content));
+          FetchObjectData *fetch = g_sequence_get (last);
+          g_sequence_remove (last);
 
-          /* Steal both key and value */
-          g_hash_table_iter_steal (&hiter);
-
-          /* This takes ownership of the value */
+          /* This takes ownership */
           start_fetch (pull_data, fetch);
-          /* And unref the key */
-          g_free (checksum);
         }
 
       /* Finally, if we still have capacity, scan more metadata objects */
@@ -365,10 +509,15 @@ check_outstanding_requests_handle_error (OtPullData *pull_data, GError **errorp)
     }
 }
 
-/* We have a total-request limit, as well has a hardcoded max of 2 for delta
- * parts. The logic for the delta one is that processing them is expensive, and
- * doing multiple simultaneously could risk space/memory on smaller devices. We
- * also throttle on outstanding writes in case fetches are faster.
+/* We have a total-request limit, and delta parts are throttled on a bytes
+ * window: a part occupies the window from the start of its download until
+ * its apply completes, so we keep downloading later parts while earlier
+ * ones decompress and apply instead of alternating between the two stages.
+ * The window (rather than a count) is what bounds space/memory on smaller
+ * devices; the count cap just avoids flooding the fetcher with tiny parts.
+ * We also throttle on outstanding object writes in case fetches are faster;
+ * deltapart applies are excluded from that since they're already accounted
+ * in the bytes window.
  */
 static gboolean
 fetcher_queue_is_full (OtPullData *pull_data)
@@ -376,23 +525,112 @@ fetcher_queue_is_full (OtPullData *pull_data)
   const gboolean fetch_full
       = ((pull_data->n_outstanding_metadata_fetches + pull_data->n_outstanding_content_fetches
           + pull_data->n_outstanding_deltapart_fetches)
-         == _OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS);
+         >= pull_data->max_outstanding_fetcher_requests);
   const gboolean deltas_full
-      = (pull_data->n_outstanding_deltapart_fetches == _OSTREE_MAX_OUTSTANDING_DELTAPART_REQUESTS);
+      = (pull_data->n_outstanding_deltapart_fetches >= _OSTREE_MAX_OUTSTANDING_DELTAPART_REQUESTS
+         || pull_data->deltapart_inflight_bytes >= pull_data->max_deltapart_inflight_bytes);
   const gboolean writes_full = ((pull_data->n_outstanding_metadata_write_requests
-                                 + pull_data->n_outstanding_content_write_requests
-                                 + pull_data->n_outstanding_deltapart_write_requests)
-                                >= _OSTREE_MAX_OUTSTANDING_WRITE_REQUESTS);
+                                 + pull_data->n_outstanding_content_write_requests)
+                                >= pull_data->max_outstanding_write_requests);
   return fetch_full || deltas_full || writes_full;
 }
 
+/* Like fetcher_queue_is_full(), but only counts metadata against the fetch
+ * limit.  Metadata objects are small, and every dirtree we fetch unlocks a
+ * whole subtree of further discovery; if they had to share the window with
+ * bulk content, a deep tree would pay one content-drain round trip per
+ * directory level.  Content fetches still see the combined count, so
+ * metadata effectively has reserved headroom rather than extra capacity.
+ */
+static gboolean
+metadata_fetcher_queue_is_full (OtPullData *pull_data)
+{
+  const gboolean fetch_full
+      = (pull_data->n_outstanding_metadata_fetches >= pull_data->max_outstanding_fetcher_requests);
+  const gboolean writes_full = ((pull_data->n_outstanding_metadata_write_requests
+                                 + pull_data->n_outstanding_content_write_requests)
+                                >= pull_data->max_outstanding_write_requests);
+  return fetch_full || writes_full;
+}
+
 static void
 scan_object_queue_data_free (ScanObjectQueueData *scan_data)
 {
   g_free (scan_data->path);
   if (scan_data->requested_ref != NULL)
     ostree_collection_ref_free (scan_data->requested_ref);
-  g_free (scan_data);
+  g_clear_pointer (&scan_data->prefetched_object, g_variant_unref);
+  ot_arena_free_one (scan_data->pull_data->scan_data_arena, scan_data);
+}
+
+/* Runs on a scan_prefetch_pool thread.  Do the read-only repository
+ * probing for a queued metadata scan (the part that would otherwise
+ * serialize with HTTP dispatch on the main loop): check whether we
+ * already have the object, and if so preload its variant.  Errors are
+ * deliberately ignored; the main-loop scan redoes the failed step and
+ * reports them properly.
+ */
+static void
+scan_prefetch_worker (gpointer data, gpointer user_data)
+{
+  OtPullData *pull_data = user_data;
+  ScanObjectQueueData *scan_data = data;
+  char checksum[OSTREE_SHA256_STRING_LEN + 1];
+  gboolean is_stored = FALSE;
+
+  ostree_checksum_inplace_from_bytes (scan_data->csum, checksum);
+
+  if (pull_data->object_index != NULL)
+    {
+      is_stored
+          = _ostree_repo_object_index_contains (pull_data->object_index, scan_data->objtype, checksum);
+      scan_data->prefetched = TRUE;
+      scan_data->prefetched_is_stored = is_stored;
+    }
+  else if (ostree_repo_has_object (pull_data->repo, scan_data->objtype, checksum, &is_stored,
+                                   pull_data->cancellable, NULL))
+    {
+      scan_data->prefetched = TRUE;
+      scan_data->prefetched_is_stored = is_stored;
+    }
+
+  if (is_stored
+      && (scan_data->objtype == OSTREE_OBJECT_TYPE_COMMIT
+          || scan_data->objtype == OSTREE_OBJECT_TYPE_DIR_TREE))
+    (void)ostree_repo_load_variant (pull_data->repo, scan_data->objtype, checksum,
+                                    &scan_data->prefetched_object, NULL);
+
+  g_async_queue_push (pull_data->scan_prefetch_results, scan_data);
+  g_main_context_wakeup (pull_data->main_context);
+}
+
+/* Move completed prefetches onto the main-loop scan queue.  Called from
+ * the main loop only; the worker threads just wake the context up.
+ */
+static void
+collect_scan_prefetch_results (OtPullData *pull_data)
+{
+  ScanObjectQueueData *scan_data;
+  gboolean collected = FALSE;
+
+  if (pull_data->scan_prefetch_results == NULL)
+    return;
+
+  while ((scan_data = g_async_queue_try_pop (pull_data->scan_prefetch_results)) != NULL)
+    {
+      g_assert_cmpuint (pull_data->n_outstanding_scan_prefetches, >, 0);
+      pull_data->n_outstanding_scan_prefetches--;
+      if (pull_data->caught_error)
+        scan_object_queue_data_free (scan_data);
+      else
+        {
+          g_queue_push_tail (&pull_data->scan_object_queue, scan_data);
+          collected = TRUE;
+        }
+    }
+
+  if (collected)
+    ensure_idle_queued (pull_data);
 }
 
 /* Called out of the main loop to process the "scan object queue", which is a
@@ -416,9 +654,9 @@ idle_worker (gpointer user_data)
 
   char checksum[OSTREE_SHA256_STRING_LEN + 1];
   ostree_checksum_inplace_from_bytes (scan_data->csum, checksum);
-  scan_one_metadata_object (pull_data, checksum, scan_data->objtype, scan_data->path,
-                            scan_data->recursion_depth, scan_data->requested_ref,
-                            pull_data->cancellable, &error);
+  guint64 scan_start_time = g_get_monotonic_time ();
+  scan_one_metadata_object (pull_data, scan_data, checksum, pull_data->cancellable, &error);
+  pull_data->metadata_scan_usecs += g_get_monotonic_time () - scan_start_time;
 
   /* No need to retry scan tasks, since they’re local. */
   check_outstanding_requests_handle_error (pull_data, &error);
@@ -435,8 +673,10 @@ ensure_idle_queued (OtPullData *pull_data)
   if (pull_data->idle_src)
     return;
 
-  /* If the operation queue is full, there's no point in blocking further. */
-  if (fetcher_queue_is_full (pull_data))
+  /* If even the metadata queue is full, there's no point in blocking further.
+   * We deliberately don't gate on the content queue here: scanning is what
+   * discovers new dirtrees, and those ride the metadata headroom. */
+  if (metadata_fetcher_queue_is_full (pull_data))
     return;
 
   idle_src = g_idle_source_new ();
@@ -550,6 +790,19 @@ pull_matches_subdir (OtPullData *pull_data, const char *path, const char *basena
   return FALSE;
 }
 
+/* Best-effort accounting of bytes satisfied from a local source repo
+ * rather than the network; feeds the "bytes-from-cache" progress key.
+ * Failure to stat the object just loses a data point.
+ */
+static void
+account_imported_bytes (OtPullData *pull_data, OstreeRepo *src_repo, OstreeObjectType objtype,
+                        const char *checksum)
+{
+  guint64 size = 0;
+  if (ostree_repo_query_object_storage_size (src_repo, objtype, checksum, &size, NULL, NULL))
+    pull_data->imported_bytes += size;
+}
+
 typedef struct
 {
   OtPullData *pull_data;
@@ -616,6 +869,12 @@ on_local_object_imported (GObject *object, GAsyncResult *result, gpointer user_d
   if (!async_import_one_local_content_object_finish (pull_data, result, error))
     goto out;
 
+  {
+    ImportLocalAsyncData *iataskdata = g_task_get_task_data (G_TASK (result));
+    account_imported_bytes (pull_data, iataskdata->src_repo, OSTREE_OBJECT_TYPE_FILE,
+                            iataskdata->checksum);
+  }
+
 out:
   pull_data->n_imported_content++;
   g_assert_cmpint (pull_data->n_outstanding_content_write_requests, >, 0);
@@ -625,25 +884,33 @@ out:
 }
 
 static gboolean
-scan_dirtree_object (OtPullData *pull_data, const char *checksum, const char *path,
-                     int recursion_depth, GCancellable *cancellable, GError **error)
+scan_dirtree_object (OtPullData *pull_data, const char *checksum, GVariant *prefetched_tree,
+                     const char *path, int recursion_depth, GCancellable *cancellable,
+                     GError **error)
 {
-  g_autoptr (GVariant) tree = NULL;
-  if (!ostree_repo_load_variant (pull_data->repo, OSTREE_OBJECT_TYPE_DIR_TREE, checksum, &tree,
-                                 error))
+  g_autoptr (GVariant) tree = prefetched_tree ? g_variant_ref (prefetched_tree) : NULL;
+  if (tree == NULL
+      && !ostree_repo_load_variant (pull_data->repo, OSTREE_OBJECT_TYPE_DIR_TREE, checksum, &tree,
+                                    error))
     return FALSE;
 
-  /* PARSE OSTREE_SERIALIZED_TREE_VARIANT */
-  g_autoptr (GVariant) files_variant = g_variant_get_child_value (tree, 0);
-  const guint n = g_variant_n_children (files_variant);
-  for (guint i = 0; i < n; i++)
+  /* PARSE OSTREE_SERIALIZED_TREE_VARIANT; the borrowing iterator hands
+   * back pointers into the mapped variant, so this hot loop makes no
+   * per-child allocations. */
+  OtDirtreeIter iter;
+  if (!_ostree_dirtree_iter_init (&iter, tree, error))
+    return glnx_prefix_error (error, "Parsing dirtree %s", checksum);
+  for (guint i = 0;; i++)
     {
       const char *filename;
+      const guint8 *csum_bytes;
       gboolean file_is_stored;
-      g_autoptr (GVariant) csum = NULL;
-      g_autofree char *file_checksum = NULL;
+      char file_checksum[OSTREE_SHA256_STRING_LEN + 1];
 
-      g_variant_get_child (files_variant, i, "(&s@ay)", &filename, &csum);
+      if (!_ostree_dirtree_iter_next_file (&iter, &filename, &csum_bytes, error))
+        return glnx_prefix_error (error, "Parsing dirtree %s", checksum);
+      if (filename == NULL)
+        break;
 
       /* Note this is now obsoleted by the _ostree_validate_structureof_metadata()
        * but I'm keeping this since:
@@ -659,10 +926,16 @@ scan_dirtree_object (OtPullData *pull_data, const char *checksum, const char *pa
       if (!pull_matches_subdir (pull_data, path, filename, FALSE))
         continue;
 
-      file_checksum = ostree_checksum_from_bytes_v (csum);
+      /* Convert on the stack; this loop runs once per file in the tree, and
+       * most iterations bail out just below when the object is already
+       * stored, so a heap copy is only made for objects we actually queue. */
+      ostree_checksum_inplace_from_bytes (csum_bytes, file_checksum);
 
-      if (!ostree_repo_has_object (pull_data->repo, OSTREE_OBJECT_TYPE_FILE, file_checksum,
-                                   &file_is_stored, cancellable, error))
+      if (pull_data->object_index != NULL)
+        file_is_stored = _ostree_repo_object_index_contains (pull_data->object_index,
+                                                             OSTREE_OBJECT_TYPE_FILE, file_checksum);
+      else if (!ostree_repo_has_object (pull_data->repo, OSTREE_OBJECT_TYPE_FILE, file_checksum,
+                                        &file_is_stored, cancellable, error))
         return FALSE;
 
       /* If we already have this object, move on to the next */
@@ -670,7 +943,8 @@ scan_dirtree_object (OtPullData *pull_data, const char *checksum, const char *pa
         continue;
 
       /* Already have a request pending?  If so, move on to the next */
-      if (g_hash_table_lookup (pull_data->requested_content, file_checksum))
+      if (pull_object_status (pull_data, file_checksum, OSTREE_OBJECT_TYPE_FILE)
+          & OT_PULL_OBJECT_REQUESTED)
         continue;
 
       /* Is this a local repo? */
@@ -679,7 +953,8 @@ scan_dirtree_object (OtPullData *pull_data, const char *checksum, const char *pa
           async_import_one_local_content_object (pull_data, pull_data->remote_repo_local,
                                                  file_checksum, cancellable,
                                                  on_local_object_imported, pull_data);
-          g_hash_table_add (pull_data->requested_content, g_steal_pointer (&file_checksum));
+          pull_object_set_status (pull_data, file_checksum, OSTREE_OBJECT_TYPE_FILE,
+                                  OT_PULL_OBJECT_REQUESTED);
           /* Note early loop continue */
           continue;
         }
@@ -701,7 +976,8 @@ scan_dirtree_object (OtPullData *pull_data, const char *checksum, const char *pa
               async_import_one_local_content_object (pull_data, localcache_repo, file_checksum,
                                                      cancellable, on_local_object_imported,
                                                      pull_data);
-              g_hash_table_add (pull_data->requested_content, g_steal_pointer (&file_checksum));
+              pull_object_set_status (pull_data, file_checksum, OSTREE_OBJECT_TYPE_FILE,
+                                      OT_PULL_OBJECT_REQUESTED);
               did_import_from_cache_repo = TRUE;
               break;
             }
@@ -710,20 +986,23 @@ scan_dirtree_object (OtPullData *pull_data, const char *checksum, const char *pa
         continue; /* Note early continue */
 
       /* Not available locally, queue a HTTP request */
-      g_hash_table_add (pull_data->requested_content, file_checksum);
+      pull_object_set_status (pull_data, file_checksum, OSTREE_OBJECT_TYPE_FILE,
+                              OT_PULL_OBJECT_REQUESTED);
       enqueue_one_object_request (pull_data, file_checksum, OSTREE_OBJECT_TYPE_FILE, path, FALSE,
                                   FALSE, NULL);
-      file_checksum = NULL; /* Transfer ownership */
     }
 
-  g_autoptr (GVariant) dirs_variant = g_variant_get_child_value (tree, 1);
-  const guint m = g_variant_n_children (dirs_variant);
-  for (guint i = 0; i < m; i++)
+  for (guint i = 0;; i++)
     {
-      const char *dirname = NULL;
-      g_autoptr (GVariant) tree_csum = NULL;
-      g_autoptr (GVariant) meta_csum = NULL;
-      g_variant_get_child (dirs_variant, i, "(&s@ay@ay)", &dirname, &tree_csum, &meta_csum);
+      const char *dirname;
+      const guint8 *tree_csum_bytes;
+      const guint8 *meta_csum_bytes;
+
+      if (!_ostree_dirtree_iter_next_dir (&iter, &dirname, &tree_csum_bytes, &meta_csum_bytes,
+                                          error))
+        return glnx_prefix_error (error, "Parsing dirtree %s", checksum);
+      if (dirname == NULL)
+        break;
 
       /* See comment above for files */
       if (!ot_util_filename_validate (dirname, error))
@@ -732,14 +1011,6 @@ scan_dirtree_object (OtPullData *pull_data, const char *checksum, const char *pa
       if (!pull_matches_subdir (pull_data, path, dirname, TRUE))
         continue;
 
-      const guchar *tree_csum_bytes = ostree_checksum_bytes_peek_validate (tree_csum, error);
-      if (tree_csum_bytes == NULL)
-        return glnx_prefix_error (error, "Parsing dirtree %s tree child %s", checksum, dirname);
-
-      const guchar *meta_csum_bytes = ostree_checksum_bytes_peek_validate (meta_csum, error);
-      if (meta_csum_bytes == NULL)
-        return glnx_prefix_error (error, "Parsing dirtree %s meta child %s", checksum, dirname);
-
       g_autofree char *subpath = g_strconcat (path, dirname, "/", NULL);
       queue_scan_one_metadata_object_c (pull_data, tree_csum_bytes, OSTREE_OBJECT_TYPE_DIR_TREE,
                                         subpath, recursion_depth + 1, NULL);
@@ -798,6 +1069,82 @@ fetch_ref_contents (OtPullData *pull_data, const char *main_collection_id,
   return TRUE;
 }
 
+/* Fetch (or return the cached copy of) shard @shard_idx of a sharded
+ * summary ref list, verifying it against the digest recorded in the
+ * (already verified) summary.
+ */
+static gboolean
+fetch_summary_ref_shard (OtPullData *pull_data, guint shard_idx, GVariant **out_shard,
+                         GError **error)
+{
+  if (pull_data->summary_shards == NULL)
+    pull_data->summary_shards
+        = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_variant_unref);
+
+  GVariant *cached = g_hash_table_lookup (pull_data->summary_shards, GUINT_TO_POINTER (shard_idx));
+  if (cached != NULL)
+    {
+      *out_shard = g_variant_ref (cached);
+      return TRUE;
+    }
+
+  g_autofree char *filename = g_strdup_printf (_OSTREE_SUMMARY_SHARD_DIR "/%u", shard_idx);
+  g_autoptr (GBytes) bytes = NULL;
+  if (!_ostree_fetcher_mirrored_request_to_membuf (
+          pull_data->fetcher, pull_data->meta_mirrorlist, filename, 0, NULL, 0,
+          pull_data->n_network_retries, &bytes, NULL, NULL, NULL, OSTREE_MAX_METADATA_SIZE,
+          pull_data->cancellable, error))
+    return glnx_prefix_error (error, "Fetching summary ref shard %s", filename);
+
+  g_autoptr (GVariant) expected_digest_v
+      = g_variant_get_child_value (pull_data->summary_ref_shards, shard_idx);
+  gsize expected_len;
+  const guint8 *expected_digest
+      = g_variant_get_fixed_array (expected_digest_v, &expected_len, sizeof (guint8));
+  guint8 actual_digest[OSTREE_SHA256_DIGEST_LEN];
+  ot_checksum_bytes (bytes, actual_digest);
+  if (expected_len != OSTREE_SHA256_DIGEST_LEN
+      || memcmp (expected_digest, actual_digest, sizeof (actual_digest)) != 0)
+    return glnx_throw (error, "Invalid checksum for summary ref shard %s", filename);
+
+  GVariant *shard
+      = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE ("a(s(taya{sv}))"), bytes, FALSE));
+  g_hash_table_insert (pull_data->summary_shards, GUINT_TO_POINTER (shard_idx), shard);
+  *out_shard = g_variant_ref (shard);
+  return TRUE;
+}
+
+/* Check @ref_name against the summary's ref bloom filter, if present.
+ * Returns %FALSE only when the ref is definitely not in the summary;
+ * a missing or unparseable filter answers %TRUE (i.e. "maybe").
+ */
+static gboolean
+summary_ref_bloom_maybe_contains (GVariant *additional_metadata, const char *ref_name)
+{
+  g_autoptr (GVariant) bloom_encoded = g_variant_lookup_value (
+      additional_metadata, OSTREE_SUMMARY_REF_BLOOM, G_VARIANT_TYPE ("(yyay)"));
+  if (bloom_encoded == NULL)
+    return TRUE;
+
+  guint8 k, hash_id;
+  g_autoptr (GVariant) bloom_variant = NULL;
+  g_variant_get (bloom_encoded, "(yy@ay)", &k, &hash_id, &bloom_variant);
+
+  /* Unknown hash function or degenerate filter: can't say anything */
+  if (k == 0 || hash_id != 1)
+    return TRUE;
+
+  gsize n_bloom_bytes;
+  const guint8 *bloom_bytes
+      = g_variant_get_fixed_array (bloom_variant, &n_bloom_bytes, sizeof (guint8));
+  if (n_bloom_bytes == 0)
+    return TRUE;
+
+  g_autoptr (GBytes) bytes = g_bytes_new_static (bloom_bytes, n_bloom_bytes);
+  g_autoptr (OstreeBloom) bloom = ostree_bloom_new_from_bytes (bytes, k, ostree_str_bloom_hash);
+  return ostree_bloom_maybe_contains (bloom, ref_name);
+}
+
 static gboolean
 lookup_commit_checksum_and_collection_from_summary (OtPullData *pull_data,
                                                     const OstreeCollectionRef *ref,
@@ -814,20 +1161,58 @@ lookup_commit_checksum_and_collection_from_summary (OtPullData *pull_data,
   g_autoptr (GVariant) refs = NULL;
   const gchar *resolved_collection_id = NULL;
 
-  if (ref->collection_id == NULL || g_strcmp0 (ref->collection_id, main_collection_id) == 0)
+  if (!summary_ref_bloom_maybe_contains (additional_metadata, ref->ref_name))
     {
-      refs = g_variant_get_child_value (pull_data->summary, 0);
+      /* Definitely absent; skip the ref map search (and, for sharded ref
+       * lists, the shard fetch) and fall through to the error below. */
+    }
+  else if (ref->collection_id == NULL || g_strcmp0 (ref->collection_id, main_collection_id) == 0)
+    {
+      if (pull_data->summary_ref_shards != NULL)
+        {
+          /* Sharded ref list: the summary's own list is empty, fetch just
+           * the shard this ref hashes into. */
+          const guint n_shards = g_variant_n_children (pull_data->summary_ref_shards);
+          if (!fetch_summary_ref_shard (
+                  pull_data, _ostree_summary_ref_shard_index (ref->ref_name, n_shards), &refs,
+                  error))
+            return FALSE;
+        }
+      else
+        refs = g_variant_get_child_value (pull_data->summary, 0);
       resolved_collection_id = main_collection_id;
     }
   else if (ref->collection_id != NULL)
     {
-      g_autoptr (GVariant) collection_map = NULL;
+      /* Index the collection map by collection ID on first use; a dictionary
+       * GVariant lookup is a linear scan, which adds up when resolving many
+       * collection–refs against a summary with thousands of collections.  The
+       * index lives for the rest of the pull.
+       */
+      if (pull_data->summary_collection_map_index == NULL)
+        {
+          pull_data->summary_collection_map_index = g_hash_table_new_full (
+              g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
 
-      collection_map = g_variant_lookup_value (additional_metadata, OSTREE_SUMMARY_COLLECTION_MAP,
-                                               G_VARIANT_TYPE ("a{sa(s(taya{sv}))}"));
-      if (collection_map != NULL)
-        refs = g_variant_lookup_value (collection_map, ref->collection_id,
-                                       G_VARIANT_TYPE ("a(s(taya{sv}))"));
+          g_autoptr (GVariant) collection_map = g_variant_lookup_value (
+              additional_metadata, OSTREE_SUMMARY_COLLECTION_MAP,
+              G_VARIANT_TYPE ("a{sa(s(taya{sv}))}"));
+          if (collection_map != NULL)
+            {
+              GVariantIter iter;
+              const gchar *collection_id;
+              GVariant *collection_refs;
+              g_variant_iter_init (&iter, collection_map);
+              while (g_variant_iter_loop (&iter, "{&s@a(s(taya{sv}))}", &collection_id,
+                                          &collection_refs))
+                g_hash_table_replace (pull_data->summary_collection_map_index,
+                                      g_strdup (collection_id), g_variant_ref (collection_refs));
+            }
+        }
+
+      refs = g_hash_table_lookup (pull_data->summary_collection_map_index, ref->collection_id);
+      if (refs != NULL)
+        g_variant_ref (refs);
       resolved_collection_id = ref->collection_id;
     }
 
@@ -842,6 +1227,13 @@ lookup_commit_checksum_and_collection_from_summary (OtPullData *pull_data,
     }
 
   g_autoptr (GVariant) refdata = g_variant_get_child_value (refs, i);
+
+  /* The summary as a whole is not validated up front (see the comment
+   * where it's loaded), so check the one entry we're actually consuming.
+   */
+  if (!g_variant_is_normal_form (refdata))
+    return glnx_throw (error, "Invalid summary data for ref '%s'", ref->ref_name);
+
   g_autoptr (GVariant) reftargetdata = g_variant_get_child_value (refdata, 1);
   guint64 commit_size;
   g_autoptr (GVariant) commit_csum_v = NULL;
@@ -859,6 +1251,16 @@ lookup_commit_checksum_and_collection_from_summary (OtPullData *pull_data,
   return TRUE;
 }
 
+/* Record the elapsed time of one completed fetcher request, for the
+ * request latency percentiles in update_progress().
+ */
+static void
+record_request_latency (OtPullData *pull_data, guint64 fetch_start_time)
+{
+  guint64 elapsed = g_get_monotonic_time () - fetch_start_time;
+  g_array_append_val (pull_data->request_latencies, elapsed);
+}
+
 static void
 fetch_object_data_free (FetchObjectData *fetch_data)
 {
@@ -866,7 +1268,34 @@ fetch_object_data_free (FetchObjectData *fetch_data)
   g_free (fetch_data->path);
   if (fetch_data->requested_ref)
     ostree_collection_ref_free (fetch_data->requested_ref);
-  g_free (fetch_data);
+  ot_arena_free_one (fetch_data->pull_data->fetch_data_arena, fetch_data);
+}
+
+/* Ascending by expected size; the queue drain pops from the tail, so the
+ * largest pending object starts first.  Objects of unknown size compare as
+ * 0 and are fetched in roughly discovery order, as before.
+ */
+static gint
+pending_content_compare (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const FetchObjectData *fa = a;
+  const FetchObjectData *fb = b;
+
+  if (fa->expected_size < fb->expected_size)
+    return -1;
+  if (fa->expected_size > fb->expected_size)
+    return 1;
+  return 0;
+}
+
+static void
+pending_fetch_content_clear (OtPullData *pull_data)
+{
+  for (GSequenceIter *iter = g_sequence_get_begin_iter (pull_data->pending_fetch_content);
+       !g_sequence_iter_is_end (iter); iter = g_sequence_iter_next (iter))
+    fetch_object_data_free (g_sequence_get (iter));
+  g_sequence_remove_range (g_sequence_get_begin_iter (pull_data->pending_fetch_content),
+                           g_sequence_get_end_iter (pull_data->pending_fetch_content));
 }
 
 static void
@@ -879,13 +1308,13 @@ content_fetch_on_write_complete (GObject *object, GAsyncResult *result, gpointer
   OstreeObjectType objtype;
   const char *expected_checksum;
   g_autofree guchar *csum = NULL;
-  g_autofree char *checksum = NULL;
+  char checksum[OSTREE_SHA256_STRING_LEN + 1];
   g_autofree char *checksum_obj = NULL;
 
   if (!ostree_repo_write_content_finish ((OstreeRepo *)object, result, &csum, error))
     goto out;
 
-  checksum = ostree_checksum_from_bytes (csum);
+  ostree_checksum_inplace_from_bytes (csum, checksum);
 
   ostree_object_name_deserialize (fetch_data->object, &expected_checksum, &objtype);
   g_assert (objtype == OSTREE_OBJECT_TYPE_FILE);
@@ -898,7 +1327,8 @@ content_fetch_on_write_complete (GObject *object, GAsyncResult *result, gpointer
 
   pull_data->n_fetched_content++;
   /* Was this a delta fallback? */
-  if (g_hash_table_remove (pull_data->requested_fallback_content, expected_checksum))
+  if (pull_object_clear_status (pull_data, expected_checksum, OSTREE_OBJECT_TYPE_FILE,
+                                OT_PULL_OBJECT_DELTA_FALLBACK))
     pull_data->n_fetched_deltapart_fallbacks++;
 out:
   pull_data->n_outstanding_content_write_requests--;
@@ -930,9 +1360,12 @@ content_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_
   OstreeObjectType objtype;
   gboolean free_fetch_data = TRUE;
 
-  if (!_ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, error))
+  if (!_ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, NULL,
+                                                  error))
     goto out;
 
+  record_request_latency (pull_data, fetch_data->fetch_start_time);
+
   ostree_object_name_deserialize (fetch_data->object, &checksum, &objtype);
   g_assert (objtype == OSTREE_OBJECT_TYPE_FILE);
 
@@ -1007,14 +1440,14 @@ on_metadata_written (GObject *object, GAsyncResult *result, gpointer user_data)
   GError **error = &local_error;
   const char *expected_checksum;
   OstreeObjectType objtype;
-  g_autofree char *checksum = NULL;
+  char checksum[OSTREE_SHA256_STRING_LEN + 1];
   g_autofree guchar *csum = NULL;
   g_autofree char *stringified_object = NULL;
 
   if (!ostree_repo_write_metadata_finish ((OstreeRepo *)object, result, &csum, error))
     goto out;
 
-  checksum = ostree_checksum_from_bytes (csum);
+  ostree_checksum_inplace_from_bytes (csum, checksum);
 
   ostree_object_name_deserialize (fetch_data->object, &expected_checksum, &objtype);
   g_assert (OSTREE_OBJECT_TYPE_IS_META (objtype));
@@ -1042,6 +1475,90 @@ out:
   check_outstanding_requests_handle_error (pull_data, &local_error);
 }
 
+/* Pull-side context for an offloaded commit verification: the fetch that
+ * produced the commit, and the commit variant to write once verified.
+ */
+typedef struct
+{
+  FetchObjectData *fetch_data;
+  GVariant *commit;
+} VerifyCommitFetchData;
+
+static void
+verify_commit_fetch_data_free (VerifyCommitFetchData *vdata)
+{
+  if (vdata == NULL)
+    return;
+  if (vdata->fetch_data != NULL)
+    fetch_object_data_free (vdata->fetch_data);
+  g_clear_pointer (&vdata->commit, g_variant_unref);
+  g_free (vdata);
+}
+
+/* Runs on the verify_pool thread; pure crypto, touching only the job. */
+static void
+verify_commit_worker (gpointer data, gpointer user_data)
+{
+  OtPullData *pull_data = user_data;
+  OtVerifyCommitJob *job = data;
+
+  _verify_commit_job_run (job);
+
+  g_async_queue_push (pull_data->verify_results, job);
+  g_main_context_wakeup (pull_data->main_context);
+}
+
+/* Created lazily on the first commit needing verification, since whether
+ * GPG or signapi are enabled isn't known until remote config is parsed.
+ * A single thread both serializes gpgme and keeps verdict order stable.
+ */
+static void
+ensure_verify_pool (OtPullData *pull_data)
+{
+  if (pull_data->verify_pool != NULL)
+    return;
+
+  pull_data->verify_results = g_async_queue_new ();
+  pull_data->verify_pool = ot_thread_pool_new ("pull-verify", verify_commit_worker, pull_data, 1);
+}
+
+/* Apply verdicts from the verify worker: on success mark the commit
+ * partial and kick off its async write, exactly as the synchronous path
+ * would have; on failure feed the error to the usual handler.  Called
+ * from the main loop only; the worker just wakes the context up.
+ */
+static void
+collect_verify_results (OtPullData *pull_data)
+{
+  OtVerifyCommitJob *job;
+
+  if (pull_data->verify_results == NULL)
+    return;
+
+  while ((job = g_async_queue_try_pop (pull_data->verify_results)) != NULL)
+    {
+      VerifyCommitFetchData *vdata = job->user_data;
+      g_autoptr (GError) local_error = NULL;
+
+      g_assert_cmpuint (pull_data->n_outstanding_verify_requests, >, 0);
+      pull_data->n_outstanding_verify_requests--;
+
+      if (!pull_data->caught_error && _verify_commit_job_finish (pull_data, job, &local_error)
+          && ostree_repo_mark_commit_partial (pull_data->repo, job->checksum, TRUE, &local_error))
+        {
+          ostree_repo_write_metadata_async (pull_data->repo, OSTREE_OBJECT_TYPE_COMMIT, NULL,
+                                            vdata->commit, pull_data->cancellable,
+                                            on_metadata_written,
+                                            g_steal_pointer (&vdata->fetch_data));
+          pull_data->n_outstanding_metadata_write_requests++;
+        }
+
+      verify_commit_fetch_data_free (vdata);
+      _verify_commit_job_free (job);
+      check_outstanding_requests_handle_error (pull_data, &local_error);
+    }
+}
+
 static gboolean
 is_parent_commit (OtPullData *pull_data, const char *checksum)
 {
@@ -1053,6 +1570,127 @@ is_parent_commit (OtPullData *pull_data, const char *checksum)
   return g_hash_table_contains (pull_data->commit_to_depth, checksum);
 }
 
+/* Shared by the loose and packed metadata fetch paths: verify a fetched
+ * metadata variant and kick off its async write.  On success, ownership of
+ * @fetch_data passes to the write completion and *out_free_fetch_data is
+ * cleared.  @sha256_digest is an optional digest of @metadata's bytes the
+ * fetcher computed while they streamed in, saving a hash pass here.
+ */
+static gboolean
+process_fetched_metadata (OtPullData *pull_data, FetchObjectData *fetch_data, const char *checksum,
+                          OstreeObjectType objtype, GVariant *metadata, GBytes *sha256_digest,
+                          gboolean *out_free_fetch_data, GError **error)
+{
+  /* Compute checksum and verify structure now. Note this is a recent change
+   * (Jan 2018) - we used to verify the checksum only when writing down
+   * below. But we want to do "structure" verification early on as well
+   * before the object is written even to the staging directory.
+   */
+  if (!_ostree_verify_metadata_object_with_digest (objtype, checksum, metadata, sha256_digest,
+                                                   error))
+    return FALSE;
+
+  /* For commit objects, check the signature before writing to the repo,
+   * and also write the .commitpartial to say that we're still processing
+   * this commit.
+   */
+  if (objtype == OSTREE_OBJECT_TYPE_COMMIT)
+    {
+      /* Do signature verification. `detached_data` may be NULL if no detached
+       * metadata was found during pull; that's handled by
+       * ostree_ostree_verify_unwritten_commit(). If we ever change the pull code to
+       * not always fetch detached metadata, this bit will have to learn how
+       * to look up from the disk state as well, or insert the on-disk
+       * metadata into this hash.
+       */
+      GVariant *detached_data = g_hash_table_lookup (pull_data->fetched_detached_metadata, checksum);
+      OtVerifyCommitJob *job = _verify_commit_job_new (pull_data, checksum, metadata, detached_data,
+                                                       fetch_data->requested_ref,
+                                                       pull_data->cancellable);
+      if (job != NULL)
+        {
+          /* Hand the crypto to the verify worker so fetch dispatch keeps
+           * going; collect_verify_results() resumes the write once the
+           * signature checks out.  The job owns fetch_data from here.
+           */
+          VerifyCommitFetchData *vdata = g_new0 (VerifyCommitFetchData, 1);
+          vdata->fetch_data = fetch_data;
+          vdata->commit = g_variant_ref (metadata);
+          job->user_data = vdata;
+
+          ensure_verify_pool (pull_data);
+          pull_data->n_outstanding_verify_requests++;
+          ot_thread_pool_push (pull_data->verify_pool, job);
+          *out_free_fetch_data = FALSE;
+          return TRUE;
+        }
+
+      if (!ostree_repo_mark_commit_partial (pull_data->repo, checksum, TRUE, error))
+        return FALSE;
+    }
+
+  /* Note that we now (Jan 2018) pass NULL for checksum, which means "don't
+   * verify checksum", since we just did it above. Related to this...now
+   * that we're doing all the verification here, one thing we could do later
+   * just `glnx_link_tmpfile_at()` into the repository, like the content
+   * fetch path does for trusted commits.
+   */
+  ostree_repo_write_metadata_async (pull_data->repo, objtype, NULL, metadata,
+                                    pull_data->cancellable, on_metadata_written, fetch_data);
+  pull_data->n_outstanding_metadata_write_requests++;
+  *out_free_fetch_data = FALSE;
+  return TRUE;
+}
+
+/* If a commit's detached metadata carries inline content objects (see
+ * %OSTREE_COMMIT_META_KEY_INLINE_CONTENT), import the ones we don't already
+ * have.  The subsequent dirtree scan then finds them stored and skips
+ * fetching each one individually.
+ */
+static gboolean
+import_inline_content (OtPullData *pull_data, GVariant *detached_metadata, GError **error)
+{
+  g_autoptr (GVariant) inline_content = g_variant_lookup_value (
+      detached_metadata, OSTREE_COMMIT_META_KEY_INLINE_CONTENT, G_VARIANT_TYPE ("a(ayay)"));
+  if (inline_content == NULL)
+    return TRUE;
+
+  const gsize n = g_variant_n_children (inline_content);
+  for (gsize i = 0; i < n; i++)
+    {
+      g_autoptr (GVariant) csum_v = NULL;
+      g_autoptr (GVariant) data_v = NULL;
+      g_variant_get_child (inline_content, i, "(@ay@ay)", &csum_v, &data_v);
+
+      const guchar *csum_bytes = ostree_checksum_bytes_peek_validate (csum_v, error);
+      if (csum_bytes == NULL)
+        return glnx_prefix_error (error, "While parsing inline content metadata");
+      char checksum[OSTREE_SHA256_STRING_LEN + 1];
+      ostree_checksum_inplace_from_bytes (csum_bytes, checksum);
+
+      gboolean have_object;
+      if (!ostree_repo_has_object (pull_data->repo, OSTREE_OBJECT_TYPE_FILE, checksum, &have_object,
+                                   pull_data->cancellable, error))
+        return FALSE;
+      if (have_object)
+        continue;
+
+      /* The data is the canonical object stream, so writing it verifies the
+       * checksum just as a regular fetch would.
+       */
+      g_autoptr (GBytes) bytes = g_variant_get_data_as_bytes (data_v);
+      g_autoptr (GInputStream) object_input = g_memory_input_stream_new_from_bytes (bytes);
+      g_autofree guchar *csum = NULL;
+      if (!ostree_repo_write_content (pull_data->repo, checksum, object_input,
+                                      g_bytes_get_size (bytes), &csum, pull_data->cancellable,
+                                      error))
+        return glnx_prefix_error (error, "While importing inline content object %s", checksum);
+      pull_data->n_imported_content++;
+    }
+
+  return TRUE;
+}
+
 static void
 meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_data)
 {
@@ -1063,6 +1701,7 @@ meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_dat
   g_auto (GLnxTmpfile) tmpf = {
     0,
   };
+  g_autoptr (GBytes) fetched_digest = NULL;
   const char *checksum;
   g_autofree char *checksum_obj = NULL;
   OstreeObjectType objtype;
@@ -1075,7 +1714,8 @@ meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_dat
   g_debug ("fetch of %s%s complete", checksum_obj,
            fetch_data->is_detached_meta ? " (detached)" : "");
 
-  if (!_ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, error))
+  if (!_ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL,
+                                                  &fetched_digest, error))
     {
       if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
         {
@@ -1119,6 +1759,8 @@ meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_dat
       goto out;
     }
 
+  record_request_latency (pull_data, fetch_data->fetch_start_time);
+
   /* Tombstone commits are always empty, so skip all processing here */
   if (objtype == OSTREE_OBJECT_TYPE_TOMBSTONE_COMMIT)
     goto out;
@@ -1132,6 +1774,9 @@ meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_dat
                                                        pull_data->cancellable, error))
         goto out;
 
+      if (!import_inline_content (pull_data, metadata, error))
+        goto out;
+
       g_hash_table_insert (pull_data->fetched_detached_metadata, g_strdup (checksum),
                            g_steal_pointer (&metadata));
 
@@ -1148,47 +1793,9 @@ meta_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_dat
                                error))
         goto out;
 
-      /* Compute checksum and verify structure now. Note this is a recent change
-       * (Jan 2018) - we used to verify the checksum only when writing down
-       * below. But we want to do "structure" verification early on as well
-       * before the object is written even to the staging directory.
-       */
-      if (!_ostree_verify_metadata_object (objtype, checksum, metadata, error))
+      if (!process_fetched_metadata (pull_data, fetch_data, checksum, objtype, metadata,
+                                     fetched_digest, &free_fetch_data, error))
         goto out;
-
-      /* For commit objects, check the signature before writing to the repo,
-       * and also write the .commitpartial to say that we're still processing
-       * this commit.
-       */
-      if (objtype == OSTREE_OBJECT_TYPE_COMMIT)
-        {
-          /* Do signature verification. `detached_data` may be NULL if no detached
-           * metadata was found during pull; that's handled by
-           * ostree_ostree_verify_unwritten_commit(). If we ever change the pull code to
-           * not always fetch detached metadata, this bit will have to learn how
-           * to look up from the disk state as well, or insert the on-disk
-           * metadata into this hash.
-           */
-          GVariant *detached_data
-              = g_hash_table_lookup (pull_data->fetched_detached_metadata, checksum);
-          if (!_verify_unwritten_commit (pull_data, checksum, metadata, detached_data,
-                                         fetch_data->requested_ref, pull_data->cancellable, error))
-            goto out;
-
-          if (!ostree_repo_mark_commit_partial (pull_data->repo, checksum, TRUE, error))
-            goto out;
-        }
-
-      /* Note that we now (Jan 2018) pass NULL for checksum, which means "don't
-       * verify checksum", since we just did it above. Related to this...now
-       * that we're doing all the verification here, one thing we could do later
-       * just `glnx_link_tmpfile_at()` into the repository, like the content
-       * fetch path does for trusted commits.
-       */
-      ostree_repo_write_metadata_async (pull_data->repo, objtype, NULL, metadata,
-                                        pull_data->cancellable, on_metadata_written, fetch_data);
-      pull_data->n_outstanding_metadata_write_requests++;
-      free_fetch_data = FALSE;
     }
 
 out:
@@ -1207,6 +1814,355 @@ out:
     g_clear_pointer (&fetch_data, fetch_object_data_free);
 }
 
+static void
+remote_pack_object_free (gpointer data)
+{
+  RemotePackObject *obj = data;
+  g_free (obj->pack_name);
+  g_free (obj);
+}
+
+static void
+pack_range_request_free (PackRangeRequest *req)
+{
+  g_free (req->pack_name);
+  g_clear_pointer (&req->objects, g_ptr_array_unref);
+  g_free (req);
+}
+
+/* Called when we hit the error state: batched fetches will never be
+ * issued, so release them and their slice of the outstanding counter.
+ */
+static void
+pack_batches_abandon (OtPullData *pull_data)
+{
+  GHashTableIter hiter;
+  gpointer key, value;
+
+  g_hash_table_iter_init (&hiter, pull_data->remote_pack_batches);
+  while (g_hash_table_iter_next (&hiter, &key, &value))
+    {
+      GPtrArray *batch = value;
+      for (guint i = 0; i < batch->len; i++)
+        {
+          g_assert (pull_data->n_outstanding_metadata_fetches > 0);
+          pull_data->n_outstanding_metadata_fetches--;
+          fetch_object_data_free (batch->pdata[i]);
+        }
+      g_hash_table_iter_remove (&hiter);
+    }
+}
+
+/* Completion of one coalesced byte-range request; slice out each batched
+ * object and feed it through the same verification and write path a loose
+ * fetch would take.  If the range fetch failed (e.g. the server ignores
+ * Range headers), permanently fall back to loose fetches.
+ */
+static void
+pack_range_fetch_on_complete (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  OstreeFetcher *fetcher = (OstreeFetcher *)object;
+  PackRangeRequest *req = user_data;
+  OtPullData *pull_data = req->pull_data;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GError) local_error = NULL;
+  GError **error = &local_error;
+
+  if (!_ostree_fetcher_request_to_membuf_finish (fetcher, result, &bytes, NULL, NULL, NULL, error)
+      || g_bytes_get_size (bytes) != req->range_length)
+    {
+      g_debug ("pack range fetch from %s failed (%s); falling back to loose fetches",
+               req->pack_name, local_error != NULL ? local_error->message : "short response");
+      g_clear_error (&local_error);
+      pull_data->pack_ranges_disabled = TRUE;
+      for (guint i = 0; i < req->objects->len; i++)
+        {
+          FetchObjectData *fetch_data = req->objects->pdata[i];
+          req->objects->pdata[i] = NULL;
+          g_assert (pull_data->n_outstanding_metadata_fetches > 0);
+          pull_data->n_outstanding_metadata_fetches--;
+          /* Takes ownership; re-queues through the loose object path */
+          enqueue_one_object_request_s (pull_data, fetch_data);
+        }
+      goto out;
+    }
+
+  /* One latency sample per HTTP request, however many objects it carried */
+  record_request_latency (pull_data, req->fetch_start_time);
+
+  for (guint i = 0; i < req->objects->len; i++)
+    {
+      FetchObjectData *fetch_data = req->objects->pdata[i];
+      req->objects->pdata[i] = NULL;
+      gboolean free_fetch_data = TRUE;
+      const char *checksum;
+      OstreeObjectType objtype;
+
+      g_assert (pull_data->n_outstanding_metadata_fetches > 0);
+      pull_data->n_outstanding_metadata_fetches--;
+
+      ostree_object_name_deserialize (fetch_data->object, &checksum, &objtype);
+
+      if (local_error == NULL)
+        {
+          RemotePackObject *obj
+              = g_hash_table_lookup (pull_data->remote_pack_objects, fetch_data->object);
+          g_autoptr (GBytes) slice
+              = g_bytes_new_from_bytes (bytes, obj->offset - req->range_start, obj->length);
+          g_autoptr (GVariant) metadata = g_variant_ref_sink (
+              g_variant_new_from_bytes (ostree_metadata_variant_type (objtype), slice, FALSE));
+          g_autofree char *checksum_obj = ostree_object_to_string (checksum, objtype);
+          g_debug ("fetch of %s (packed) complete", checksum_obj);
+
+          if (process_fetched_metadata (pull_data, fetch_data, checksum, objtype, metadata, NULL,
+                                        &free_fetch_data, error))
+            pull_data->n_fetched_metadata++;
+        }
+
+      if (free_fetch_data)
+        fetch_object_data_free (fetch_data);
+    }
+
+out:
+  check_outstanding_requests_handle_error (pull_data, &local_error);
+  pack_range_request_free (req);
+}
+
+/* Issue one byte-range request covering @objects (sorted by offset,
+ * ownership transferred).  max_size is exactly the range length, so a
+ * server that ignores the Range header and replies with the whole pack
+ * fails the oversize check and we fall back to loose fetches.
+ */
+static void
+start_pack_range_fetch (OtPullData *pull_data, const char *pack_name, GPtrArray *objects,
+                        guint64 range_start, guint64 range_length)
+{
+  PackRangeRequest *req = g_new0 (PackRangeRequest, 1);
+  req->pull_data = pull_data;
+  req->pack_name = g_strdup (pack_name);
+  req->range_start = range_start;
+  req->range_length = range_length;
+  req->objects = objects;
+
+  g_debug ("fetching %u packed metadata objects from %s (%" G_GUINT64_FORMAT " bytes)",
+           objects->len, pack_name, range_length);
+
+  g_autofree char *data_path = g_strconcat ("objects/pack/", pack_name, ".data", NULL);
+  req->fetch_start_time = g_get_monotonic_time ();
+  _ostree_fetcher_request_range_to_membuf (
+      pull_data->fetcher, pull_data->content_mirrorlist, data_path, 0, range_start, range_length,
+      range_length, OSTREE_REPO_PULL_METADATA_PRIORITY, pull_data->cancellable,
+      pack_range_fetch_on_complete, req);
+}
+
+static int
+pack_batch_entry_compare (gconstpointer ap, gconstpointer bp, gpointer user_data)
+{
+  OtPullData *pull_data = user_data;
+  FetchObjectData *a = *((FetchObjectData **)ap);
+  FetchObjectData *b = *((FetchObjectData **)bp);
+  RemotePackObject *obj_a = g_hash_table_lookup (pull_data->remote_pack_objects, a->object);
+  RemotePackObject *obj_b = g_hash_table_lookup (pull_data->remote_pack_objects, b->object);
+
+  if (obj_a->offset < obj_b->offset)
+    return -1;
+  else if (obj_a->offset > obj_b->offset)
+    return 1;
+  return 0;
+}
+
+/* Turn each per-pack batch into as few byte-range requests as possible:
+ * sort by pack offset, then greedily merge neighbors whose gap and total
+ * span stay within the PACK_RANGE_* limits.
+ */
+static void
+flush_pack_batches (OtPullData *pull_data)
+{
+  GHashTableIter hiter;
+  gpointer key, value;
+
+  g_hash_table_iter_init (&hiter, pull_data->remote_pack_batches);
+  while (g_hash_table_iter_next (&hiter, &key, &value))
+    {
+      const char *pack_name = key;
+      GPtrArray *batch = value;
+
+      g_ptr_array_sort_with_data (batch, pack_batch_entry_compare, pull_data);
+
+      guint i = 0;
+      while (i < batch->len)
+        {
+          FetchObjectData *first = batch->pdata[i];
+          RemotePackObject *first_obj
+              = g_hash_table_lookup (pull_data->remote_pack_objects, first->object);
+          guint64 span_start = first_obj->offset;
+          guint64 span_end = first_obj->offset + first_obj->length;
+          g_autoptr (GPtrArray) span_objects = g_ptr_array_new ();
+          g_ptr_array_add (span_objects, first);
+          i++;
+
+          for (; i < batch->len; i++)
+            {
+              FetchObjectData *next = batch->pdata[i];
+              RemotePackObject *next_obj
+                  = g_hash_table_lookup (pull_data->remote_pack_objects, next->object);
+              guint64 next_end = next_obj->offset + next_obj->length;
+
+              if (next_obj->offset > span_end + PACK_RANGE_MAX_GAP
+                  || MAX (next_end, span_end) - span_start > PACK_RANGE_MAX_LENGTH)
+                break;
+              span_end = MAX (next_end, span_end);
+              g_ptr_array_add (span_objects, next);
+            }
+
+          start_pack_range_fetch (pull_data, pack_name, g_steal_pointer (&span_objects), span_start,
+                                  span_end - span_start);
+        }
+
+      g_hash_table_iter_remove (&hiter);
+    }
+}
+
+static gboolean
+pack_flush_worker (gpointer user_data)
+{
+  OtPullData *pull_data = user_data;
+
+  g_clear_pointer (&pull_data->pack_flush_src, g_source_destroy);
+  flush_pack_batches (pull_data);
+  return G_SOURCE_REMOVE;
+}
+
+/* Flush from an idle so one batch collects the whole burst of requests a
+ * dirtree scan enqueues before the main loop spins again.
+ */
+static void
+ensure_pack_flush_queued (OtPullData *pull_data)
+{
+  GSource *flush_src;
+
+  if (pull_data->pack_flush_src)
+    return;
+
+  flush_src = g_idle_source_new ();
+  g_source_set_callback (flush_src, pack_flush_worker, pull_data, NULL);
+  g_source_attach (flush_src, pull_data->main_context);
+  pull_data->pack_flush_src = flush_src;
+  /* Ownership is transferred to pull_data */
+  g_source_unref (flush_src);
+}
+
+/* Best effort: fetch objects/pack/manifest and each pack index from the
+ * remote, building a map from metadata object name to its byte range so
+ * start_fetch() can coalesce those objects into range requests.  Any
+ * failure just leaves the map unset and every fetch takes the loose path.
+ */
+static void
+fetch_remote_pack_indexes (OtPullData *pull_data, GCancellable *cancellable)
+{
+  g_autoptr (GError) local_error = NULL;
+
+  /* Packs are only created for archive repositories */
+  if (pull_data->remote_mode != OSTREE_REPO_MODE_ARCHIVE)
+    return;
+
+  g_autoptr (GBytes) manifest_bytes = NULL;
+  if (!_ostree_fetcher_mirrored_request_to_membuf (
+          pull_data->fetcher, pull_data->content_mirrorlist, "objects/pack/manifest",
+          OSTREE_FETCHER_REQUEST_OPTIONAL_CONTENT | OSTREE_FETCHER_REQUEST_NUL_TERMINATION, NULL, 0,
+          pull_data->n_network_retries, &manifest_bytes, NULL, NULL, NULL, OSTREE_MAX_METADATA_SIZE,
+          cancellable, &local_error))
+    {
+      g_debug ("No remote pack manifest: %s", local_error->message);
+      return;
+    }
+
+  const char *manifest = g_bytes_get_data (manifest_bytes, NULL);
+  if (!g_utf8_validate (manifest, -1, NULL))
+    return;
+
+  g_autoptr (GHashTable) pack_objects
+      = g_hash_table_new_full (ostree_hash_object_name, g_variant_equal,
+                               (GDestroyNotify)g_variant_unref, remote_pack_object_free);
+
+  g_auto (GStrv) pack_names = g_strsplit (manifest, "\n", -1);
+  for (char **iter = pack_names; *iter != NULL; iter++)
+    {
+      const char *pack_name = *iter;
+      if (strlen (pack_name) != OSTREE_SHA256_STRING_LEN)
+        continue;
+
+      g_autofree char *idx_path = g_strconcat ("objects/pack/", pack_name, ".idx", NULL);
+      g_autoptr (GBytes) idx_bytes = NULL;
+      if (!_ostree_fetcher_mirrored_request_to_membuf (
+              pull_data->fetcher, pull_data->content_mirrorlist, idx_path, 0, NULL, 0,
+              pull_data->n_network_retries, &idx_bytes, NULL, NULL, NULL, PACK_INDEX_MAX_SIZE,
+              cancellable, &local_error))
+        {
+          g_debug ("Failed to fetch pack index %s: %s", pack_name, local_error->message);
+          return;
+        }
+
+      g_autoptr (GVariant) index = g_variant_ref_sink (g_variant_new_from_bytes (
+          G_VARIANT_TYPE (OSTREE_PACK_INDEX_GVARIANT_STRING), idx_bytes, FALSE));
+      guint32 version;
+      g_variant_get_child (index, 0, "u", &version);
+      if (version != 1)
+        continue; /* Unknown future format; leave those objects loose */
+
+      g_autoptr (GVariant) entries = g_variant_get_child_value (index, 1);
+      gsize n_entries = g_variant_n_children (entries);
+      for (gsize i = 0; i < n_entries; i++)
+        {
+          g_autoptr (GVariant) entry = g_variant_get_child_value (entries, i);
+          g_autoptr (GVariant) csum_v = g_variant_get_child_value (entry, 0);
+          gsize csum_len;
+          const guchar *csum = g_variant_get_fixed_array (csum_v, &csum_len, 1);
+          guint8 entry_objtype;
+          guint64 offset, length;
+          g_variant_get_child (entry, 1, "y", &entry_objtype);
+          g_variant_get_child (entry, 2, "t", &offset);
+          g_variant_get_child (entry, 3, "t", &length);
+          offset = GUINT64_FROM_BE (offset);
+          length = GUINT64_FROM_BE (length);
+
+          if (csum_len != OSTREE_SHA256_DIGEST_LEN)
+            continue;
+          /* Only dirtree/dirmeta flow through the coalesced membuf path;
+           * commits need detached metadata handling, content the tmpfile
+           * import path.
+           */
+          if (entry_objtype != OSTREE_OBJECT_TYPE_DIR_TREE
+              && entry_objtype != OSTREE_OBJECT_TYPE_DIR_META)
+            continue;
+          /* Sanity: don't trust an index entry past the limits the loose
+           * path would enforce.
+           */
+          if (length == 0 || length > pull_data->max_metadata_size
+              || offset > G_MAXUINT64 - length)
+            continue;
+
+          char checksum[OSTREE_SHA256_STRING_LEN + 1];
+          ostree_checksum_inplace_from_bytes (csum, checksum);
+
+          RemotePackObject *obj = g_new0 (RemotePackObject, 1);
+          obj->pack_name = g_strdup (pack_name);
+          obj->offset = offset;
+          obj->length = length;
+          g_hash_table_replace (pack_objects, ostree_object_name_serialize (checksum, entry_objtype),
+                                obj);
+        }
+    }
+
+  if (g_hash_table_size (pack_objects) == 0)
+    return;
+
+  g_debug ("Remote publishes %u packed metadata objects", g_hash_table_size (pack_objects));
+  pull_data->remote_pack_objects = g_steal_pointer (&pack_objects);
+  pull_data->remote_pack_batches
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+}
+
 static void
 fetch_static_delta_data_free (gpointer data)
 {
@@ -1231,9 +2187,17 @@ on_static_delta_written (GObject *object, GAsyncResult *result, gpointer user_da
   if (!_ostree_static_delta_part_execute_finish (pull_data->repo, result, error))
     goto out;
 
+  /* fetch_start_time was reset when the apply stage was launched */
+  pull_data->delta_apply_usecs += g_get_monotonic_time () - fetch_data->fetch_start_time;
+
 out:
   g_assert (pull_data->n_outstanding_deltapart_write_requests > 0);
   pull_data->n_outstanding_deltapart_write_requests--;
+  /* The apply finished; release the part's slice of the in-flight window
+   * before draining the queue so a waiting part can start immediately.
+   */
+  g_assert_cmpuint (pull_data->deltapart_inflight_bytes, >=, fetch_data->size);
+  pull_data->deltapart_inflight_bytes -= fetch_data->size;
   /* No need to retry on failure to write locally. */
   check_outstanding_requests_handle_error (pull_data, &local_error);
   /* Always free state */
@@ -1250,27 +2214,30 @@ static_deltapart_fetch_on_complete (GObject *object, GAsyncResult *result, gpoin
     0,
   };
   g_autoptr (GInputStream) in = NULL;
-  g_autoptr (GVariant) part = NULL;
   g_autoptr (GError) local_error = NULL;
   GError **error = &local_error;
   gboolean free_fetch_data = TRUE;
 
   g_debug ("fetch static delta part %s complete", fetch_data->expected_checksum);
 
-  if (!_ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, error))
+  if (!_ostree_fetcher_request_to_tmpfile_finish (fetcher, result, &tmpf, NULL, NULL, NULL, NULL,
+                                                  error))
     goto out;
 
+  record_request_latency (pull_data, fetch_data->fetch_start_time);
+  /* From here the timestamp clocks the apply stage; see on_static_delta_written() */
+  fetch_data->fetch_start_time = g_get_monotonic_time ();
+
   /* Transfer ownership of the fd */
   in = g_unix_input_stream_new (g_steal_fd (&tmpf.fd), TRUE);
 
-  /* TODO - make async */
-  if (!_ostree_static_delta_part_open (in, NULL, 0, fetch_data->expected_checksum, &part,
-                                       pull_data->cancellable, error))
-    goto out;
-
-  _ostree_static_delta_part_execute_async (pull_data->repo, fetch_data->objects, part,
-                                           pull_data->cancellable, on_static_delta_written,
-                                           fetch_data);
+  /* Checksum verification, decompression and opcode execution all happen on
+   * the worker thread, so multiple fetched parts apply in parallel.
+   */
+  _ostree_static_delta_part_open_execute_async (pull_data->repo, fetch_data->objects, in, NULL, 0,
+                                                fetch_data->expected_checksum,
+                                                pull_data->cancellable, on_static_delta_written,
+                                                fetch_data);
   pull_data->n_outstanding_deltapart_write_requests++;
   free_fetch_data = FALSE;
 
@@ -1278,6 +2245,15 @@ out:
   g_assert (pull_data->n_outstanding_deltapart_fetches > 0);
   pull_data->n_outstanding_deltapart_fetches--;
 
+  /* If the apply stage wasn't launched, the part no longer occupies the
+   * in-flight window.  (A retried fetch re-accounts it when it restarts.)
+   */
+  if (free_fetch_data)
+    {
+      g_assert_cmpuint (pull_data->deltapart_inflight_bytes, >=, fetch_data->size);
+      pull_data->deltapart_inflight_bytes -= fetch_data->size;
+    }
+
   if (local_error == NULL)
     pull_data->n_fetched_deltaparts++;
 
@@ -1476,7 +2452,6 @@ scan_commit_object (OtPullData *pull_data, const char *checksum, guint recursion
    */
   if (pull_data->gpg_verify && !g_hash_table_contains (pull_data->verified_commits, checksum))
     {
-      g_autoptr (OstreeGpgVerifyResult) result = NULL;
       const char *keyring_remote = NULL;
 
       if (ref != NULL)
@@ -1484,10 +2459,39 @@ scan_commit_object (OtPullData *pull_data, const char *checksum, guint recursion
       if (keyring_remote == NULL)
         keyring_remote = pull_data->remote_name;
 
-      result = ostree_repo_verify_commit_for_remote (pull_data->repo, checksum, keyring_remote,
-                                                     cancellable, error);
-      if (!_process_gpg_verify_result (pull_data, checksum, result, error))
-        return FALSE;
+      /* This is the path re-syncs of unchanged refs take, since commits
+       * already in the repo never go through _verify_unwritten_commit();
+       * consult the persistent verification cache before paying the gpgme
+       * cost again. */
+      g_autoptr (GVariant) commit_for_cache = NULL;
+      g_autoptr (GVariant) metadata_for_cache = NULL;
+      g_autoptr (GBytes) signed_data_for_cache = NULL;
+      if (ostree_repo_load_variant (pull_data->repo, OSTREE_OBJECT_TYPE_COMMIT, checksum,
+                                    &commit_for_cache, NULL))
+        {
+          signed_data_for_cache = g_variant_get_data_as_bytes (commit_for_cache);
+          (void)ostree_repo_read_commit_detached_metadata (pull_data->repo, checksum,
+                                                           &metadata_for_cache, cancellable, NULL);
+        }
+
+      if (signed_data_for_cache != NULL
+          && _gpg_verify_cached_lookup (pull_data, checksum, keyring_remote,
+                                        signed_data_for_cache, metadata_for_cache, cancellable))
+        {
+          /* See the cache-hit comment in _verify_unwritten_commit(). */
+          g_hash_table_add (pull_data->verified_commits, g_strdup (checksum));
+        }
+      else
+        {
+          g_autoptr (OstreeGpgVerifyResult) result = ostree_repo_verify_commit_for_remote (
+              pull_data->repo, checksum, keyring_remote, cancellable, error);
+          if (!_process_gpg_verify_result (pull_data, checksum, result, error))
+            return FALSE;
+
+          if (signed_data_for_cache != NULL)
+            _gpg_verify_cached_mark (pull_data, checksum, keyring_remote, signed_data_for_cache,
+                                     metadata_for_cache, cancellable);
+        }
     }
 #endif /* OSTREE_DISABLE_GPGME */
 
@@ -1542,6 +2546,63 @@ scan_commit_object (OtPullData *pull_data, const char *checksum, guint recursion
   if (!ostree_validate_structureof_commit (commit, error))
     return glnx_prefix_error (error, "Validating commit %s", checksum);
 
+  /* Harvest per-object sizes when the commit carries ostree.sizes metadata
+   * (written by commit --generate-sizes), so queued content fetches can be
+   * scheduled largest-first.  The same pass doubles as a disk space
+   * preflight: summing the sizes of the objects we're missing lets us fail
+   * now, one metadata fetch in, rather than after downloading gigabytes we
+   * can't store.  This mirrors the free space check on the delta path.
+   */
+  {
+    g_autoptr (GPtrArray) sizes_entries = NULL;
+    if (ostree_commit_get_object_sizes (commit, &sizes_entries, NULL))
+      {
+        const gboolean target_is_archive
+            = ostree_repo_get_mode (pull_data->repo) == OSTREE_REPO_MODE_ARCHIVE;
+        guint64 needed_bytes = 0;
+        if (pull_data->object_sizes == NULL)
+          pull_data->object_sizes
+              = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+        for (guint i = 0; i < sizes_entries->len; i++)
+          {
+            OstreeCommitSizesEntry *entry = sizes_entries->pdata[i];
+            if (entry->checksum == NULL)
+              continue;
+
+            gboolean have_object;
+            if (!ostree_repo_has_object (pull_data->repo, entry->objtype, entry->checksum,
+                                         &have_object, cancellable, error))
+              return FALSE;
+            if (!have_object)
+              needed_bytes += target_is_archive ? entry->archived : entry->unpacked;
+
+            if (entry->objtype != OSTREE_OBJECT_TYPE_FILE)
+              continue;
+            guint64 *size = g_new (guint64, 1);
+            *size = entry->archived;
+            g_hash_table_replace (pull_data->object_sizes, g_strdup (entry->checksum), size);
+          }
+
+        if (needed_bytes > 0 && !pull_data->dry_run)
+          {
+            struct statvfs stvfsbuf;
+            if (TEMP_FAILURE_RETRY (fstatvfs (pull_data->repo->repo_dir_fd, &stvfsbuf)) < 0)
+              return glnx_throw_errno_prefix (error, "fstatvfs");
+            const guint64 needed_blocks = (needed_bytes / stvfsbuf.f_bsize) + 1;
+            if (needed_blocks > stvfsbuf.f_bfree)
+              {
+                g_autofree char *formatted_needed = g_format_size (needed_bytes);
+                g_autofree char *formatted_avail
+                    = g_format_size (((guint64)stvfsbuf.f_bsize) * stvfsbuf.f_bfree);
+                return glnx_throw (error,
+                                   "Commit %s requires at least %s of free space, but only %s is "
+                                   "available",
+                                   checksum, formatted_needed, formatted_avail);
+              }
+          }
+      }
+  }
+
   if (!pull_data->disable_verify_bindings)
     {
       /* If ref is non-NULL then the commit we fetched was requested through
@@ -1654,6 +2715,17 @@ queue_scan_one_metadata_object (OtPullData *pull_data, const char *csum, OstreeO
 static void
 queue_scan_one_metadata_object_s (OtPullData *pull_data, ScanObjectQueueData *scan_data)
 {
+  /* Route the scan through the worker pool first so the repo probing
+   * happens off the main loop; the result lands back in
+   * scan_object_queue via collect_scan_prefetch_results().
+   */
+  if (pull_data->scan_prefetch_pool != NULL)
+    {
+      pull_data->n_outstanding_scan_prefetches++;
+      ot_thread_pool_push (pull_data->scan_prefetch_pool, scan_data);
+      return;
+    }
+
   g_queue_push_tail (&pull_data->scan_object_queue, scan_data);
   ensure_idle_queued (pull_data);
 }
@@ -1663,8 +2735,9 @@ queue_scan_one_metadata_object_c (OtPullData *pull_data, const guchar *csum,
                                   OstreeObjectType objtype, const char *path, guint recursion_depth,
                                   const OstreeCollectionRef *ref)
 {
-  ScanObjectQueueData *scan_data = g_new0 (ScanObjectQueueData, 1);
+  ScanObjectQueueData *scan_data = ot_arena_alloc0 (pull_data->scan_data_arena);
 
+  scan_data->pull_data = pull_data;
   memcpy (scan_data->csum, csum, sizeof (scan_data->csum));
   scan_data->objtype = objtype;
   scan_data->path = g_strdup (path);
@@ -1679,21 +2752,49 @@ queue_scan_one_metadata_object_c (OtPullData *pull_data, const guchar *csum,
  * execution of this function.
  */
 static gboolean
-scan_one_metadata_object (OtPullData *pull_data, const char *checksum, OstreeObjectType objtype,
-                          const char *path, guint recursion_depth, const OstreeCollectionRef *ref,
-                          GCancellable *cancellable, GError **error)
+scan_one_metadata_object (OtPullData *pull_data, ScanObjectQueueData *scan_data,
+                          const char *checksum, GCancellable *cancellable, GError **error)
 {
-  g_autoptr (GVariant) object = ostree_object_name_serialize (checksum, objtype);
+  const OstreeObjectType objtype = scan_data->objtype;
+  const char *path = scan_data->path;
+  const guint recursion_depth = scan_data->recursion_depth;
+  const OstreeCollectionRef *ref = scan_data->requested_ref;
+
+  ot_tracepoint2 (pull_scan_metadata, checksum, (int)objtype);
+
+  const guint8 object_status = pull_object_status (pull_data, checksum, objtype);
 
   /* It may happen that we've already looked at this object (think shared
    * dirtree subtrees), if that's the case, we're done */
-  if (g_hash_table_lookup (pull_data->scanned_metadata, object))
+  if (object_status & OT_PULL_OBJECT_SCANNED)
     return TRUE;
 
-  gboolean is_requested = g_hash_table_lookup (pull_data->requested_metadata, object) != NULL;
-  /* Determine if we already have the object */
+  /* Scope filter: a commit-only pull never needs dirtree or dirmeta objects,
+   * no matter which path queued them; drop such requests here rather than
+   * loading (and traversing into) metadata we won't use.
+   */
+  if (pull_data->is_commit_only
+      && (objtype == OSTREE_OBJECT_TYPE_DIR_TREE || objtype == OSTREE_OBJECT_TYPE_DIR_META))
+    {
+      pull_object_set_status (pull_data, checksum, objtype, OT_PULL_OBJECT_SCANNED);
+      return TRUE;
+    }
+
+  gboolean is_requested = (object_status & OT_PULL_OBJECT_REQUESTED) != 0;
+  /* Determine if we already have the object.  A prefetched result may
+   * be slightly stale if the object landed after the worker probed, but
+   * that is safe in both directions: objects are never removed during a
+   * pull, and a spurious "not stored" just means the request is
+   * deduplicated against the per-object status table or re-written
+   * idempotently.
+   */
   gboolean is_stored;
-  if (!ostree_repo_has_object (pull_data->repo, objtype, checksum, &is_stored, cancellable, error))
+  if (scan_data->prefetched)
+    is_stored = scan_data->prefetched_is_stored;
+  else if (pull_data->object_index != NULL)
+    is_stored = _ostree_repo_object_index_contains (pull_data->object_index, objtype, checksum);
+  else if (!ostree_repo_has_object (pull_data->repo, objtype, checksum, &is_stored, cancellable,
+                                    error))
     return FALSE;
 
   /* Are we pulling an object we don't have from a local repo? */
@@ -1748,6 +2849,7 @@ scan_one_metadata_object (OtPullData *pull_data, const char *checksum, OstreeObj
        */
       if (objtype == OSTREE_OBJECT_TYPE_COMMIT)
         g_hash_table_insert (pull_data->fetched_detached_metadata, g_strdup (checksum), NULL);
+      account_imported_bytes (pull_data, pull_data->remote_repo_local, objtype, checksum);
       pull_data->n_imported_metadata++;
       is_stored = TRUE;
       is_requested = TRUE;
@@ -1777,6 +2879,7 @@ scan_one_metadata_object (OtPullData *pull_data, const char *checksum, OstreeObj
           /* See comment above */
           if (objtype == OSTREE_OBJECT_TYPE_COMMIT)
             g_hash_table_insert (pull_data->fetched_detached_metadata, g_strdup (checksum), NULL);
+          account_imported_bytes (pull_data, refd_repo, objtype, checksum);
           is_stored = TRUE;
           is_requested = TRUE;
           pull_data->n_imported_metadata++;
@@ -1788,7 +2891,7 @@ scan_one_metadata_object (OtPullData *pull_data, const char *checksum, OstreeObj
     {
       gboolean do_fetch_detached;
 
-      g_hash_table_add (pull_data->requested_metadata, g_variant_ref (object));
+      pull_object_set_status (pull_data, checksum, objtype, OT_PULL_OBJECT_REQUESTED);
 
       do_fetch_detached = (objtype == OSTREE_OBJECT_TYPE_COMMIT);
       enqueue_one_object_request (pull_data, checksum, objtype, path, do_fetch_detached, FALSE,
@@ -1807,17 +2910,17 @@ scan_one_metadata_object (OtPullData *pull_data, const char *checksum, OstreeObj
                                    pull_data->cancellable, error))
             return FALSE;
 
-          g_hash_table_add (pull_data->scanned_metadata, g_variant_ref (object));
+          pull_object_set_status (pull_data, checksum, objtype, OT_PULL_OBJECT_SCANNED);
           pull_data->n_scanned_metadata++;
         }
     }
   else if (is_stored && objtype == OSTREE_OBJECT_TYPE_DIR_TREE)
     {
-      if (!scan_dirtree_object (pull_data, checksum, path, recursion_depth, pull_data->cancellable,
-                                error))
+      if (!scan_dirtree_object (pull_data, checksum, scan_data->prefetched_object, path,
+                                recursion_depth, pull_data->cancellable, error))
         return glnx_prefix_error (error, "Validating dirtree %s (%s)", checksum, path);
 
-      g_hash_table_add (pull_data->scanned_metadata, g_variant_ref (object));
+      pull_object_set_status (pull_data, checksum, objtype, OT_PULL_OBJECT_SCANNED);
       pull_data->n_scanned_metadata++;
     }
 
@@ -1834,7 +2937,7 @@ enqueue_one_object_request_s (OtPullData *pull_data, FetchObjectData *fetch_data
   gboolean is_meta = OSTREE_OBJECT_TYPE_IS_META (objtype);
 
   /* Are too many requests are in flight? */
-  if (fetcher_queue_is_full (pull_data))
+  if (is_meta ? metadata_fetcher_queue_is_full (pull_data) : fetcher_queue_is_full (pull_data))
     {
       g_debug ("queuing fetch of %s.%s%s", checksum, ostree_object_type_to_string (objtype),
                fetch_data->is_detached_meta ? " (detached)" : "");
@@ -1846,7 +2949,14 @@ enqueue_one_object_request_s (OtPullData *pull_data, FetchObjectData *fetch_data
         }
       else
         {
-          g_hash_table_insert (pull_data->pending_fetch_content, g_strdup (checksum), fetch_data);
+          if (pull_data->object_sizes != NULL)
+            {
+              const guint64 *size = g_hash_table_lookup (pull_data->object_sizes, checksum);
+              if (size != NULL)
+                fetch_data->expected_size = *size;
+            }
+          g_sequence_insert_sorted (pull_data->pending_fetch_content, fetch_data,
+                                    pending_content_compare, NULL);
         }
     }
   else
@@ -1862,7 +2972,7 @@ enqueue_one_object_request (OtPullData *pull_data, const char *checksum, OstreeO
 {
   FetchObjectData *fetch_data;
 
-  fetch_data = g_new0 (FetchObjectData, 1);
+  fetch_data = ot_arena_alloc0 (pull_data->fetch_data_arena);
   fetch_data->pull_data = pull_data;
   fetch_data->object = ostree_object_name_serialize (checksum, objtype);
   fetch_data->path = g_strdup (path);
@@ -1879,6 +2989,23 @@ enqueue_one_object_request (OtPullData *pull_data, const char *checksum, OstreeO
   enqueue_one_object_request_s (pull_data, g_steal_pointer (&fetch_data));
 }
 
+/* Returns the mirrorlist to use for one content fetch.  Normally that's just
+ * content_mirrorlist, but when striping across equivalent sources is enabled
+ * (P2P pulls with multiple peers advertising the same commits) we hand out
+ * round-robin rotations of it, so requests spread over all peers while the
+ * fetcher's mirror fallback still reroutes each request through every other
+ * peer on failure.
+ */
+static GPtrArray *
+content_mirrorlist_for_fetch (OtPullData *pull_data)
+{
+  if (pull_data->content_stripe_rotations == NULL)
+    return pull_data->content_mirrorlist;
+
+  guint idx = pull_data->content_stripe_counter++ % pull_data->content_stripe_rotations->len;
+  return pull_data->content_stripe_rotations->pdata[idx];
+}
+
 static void
 start_fetch (OtPullData *pull_data, FetchObjectData *fetch)
 {
@@ -1900,6 +3027,29 @@ start_fetch (OtPullData *pull_data, FetchObjectData *fetch)
   else
     pull_data->n_outstanding_content_fetches++;
 
+  /* If this object lives in a remote pack file, batch it for a coalesced
+   * byte-range fetch instead of requesting the loose path; the flush idle
+   * merges the batch into as few HTTP requests as possible.
+   */
+  if (is_meta && !fetch->is_detached_meta && !pull_data->pack_ranges_disabled
+      && pull_data->remote_pack_objects != NULL)
+    {
+      RemotePackObject *obj = g_hash_table_lookup (pull_data->remote_pack_objects, fetch->object);
+      if (obj != NULL)
+        {
+          GPtrArray *batch = g_hash_table_lookup (pull_data->remote_pack_batches, obj->pack_name);
+          if (batch == NULL)
+            {
+              batch = g_ptr_array_new ();
+              g_hash_table_insert (pull_data->remote_pack_batches, g_strdup (obj->pack_name),
+                                   batch);
+            }
+          g_ptr_array_add (batch, fetch);
+          ensure_pack_flush_queued (pull_data);
+          return;
+        }
+    }
+
   OstreeFetcherRequestFlags flags = 0;
   /* Override the path if we're trying to fetch the .commitmeta file first */
   if (fetch->is_detached_meta)
@@ -1914,7 +3064,7 @@ start_fetch (OtPullData *pull_data, FetchObjectData *fetch)
   else
     {
       obj_subpath = _ostree_get_relative_object_path (expected_checksum, objtype, TRUE);
-      mirrorlist = pull_data->content_mirrorlist;
+      mirrorlist = content_mirrorlist_for_fetch (pull_data);
     }
 
   /* We may have determined maximum sizes from the summary file content; if so,
@@ -1933,6 +3083,14 @@ start_fetch (OtPullData *pull_data, FetchObjectData *fetch)
 
   if (!is_meta && pull_data->trusted_http_direct)
     flags |= OSTREE_FETCHER_REQUEST_LINKABLE;
+  /* Content objects can be large; stage them resumably so an interrupted
+   * pull doesn't refetch partial downloads from zero.  The object content is
+   * verified against its checksum on write, which also covers the resumed
+   * portion.  Metadata objects are small enough not to bother.
+   */
+  if (!is_meta)
+    flags |= OSTREE_FETCHER_REQUEST_RESUMABLE;
+  fetch->fetch_start_time = g_get_monotonic_time ();
   _ostree_fetcher_request_to_tmpfile (
       pull_data->fetcher, mirrorlist, obj_subpath, flags, NULL, 0, expected_max_size,
       is_meta ? OSTREE_REPO_PULL_METADATA_PRIORITY : OSTREE_REPO_PULL_CONTENT_PRIORITY,
@@ -1960,6 +3118,79 @@ load_remote_repo_config (OtPullData *pull_data, GKeyFile **out_keyfile, GCancell
   return TRUE;
 }
 
+/* A delta's fallback objects are fetched as plain loose objects either way,
+ * so when they make up most of the transfer, the parts only save a small
+ * fraction of the bytes.  Below this dominance ratio (fallback bytes vs part
+ * bytes still to fetch) we use the delta; above it we fall back to a loose
+ * pull, which skips already-stored objects individually and is friendlier to
+ * HTTP caches.  The absolute floor keeps tiny deltas from flapping.
+ */
+#define OSTREE_DELTA_FALLBACK_DOMINANCE_RATIO 2
+#define OSTREE_DELTA_FALLBACK_DOMINANCE_MIN_BYTES (1 * 1024 * 1024)
+
+static gboolean
+static_delta_fallbacks_dominate (OtPullData *pull_data, GVariant *delta_superblock,
+                                 gboolean *out_dominate, GCancellable *cancellable, GError **error)
+{
+  gboolean delta_byteswap = _ostree_delta_needs_byteswap (delta_superblock);
+  g_autoptr (GVariant) headers = g_variant_get_child_value (delta_superblock, 6);
+  g_autoptr (GVariant) fallback_objects = g_variant_get_child_value (delta_superblock, 7);
+  guint64 needed_part_bytes = 0;
+  guint64 needed_fallback_bytes = 0;
+
+  guint n = g_variant_n_children (fallback_objects);
+  for (guint i = 0; i < n; i++)
+    {
+      g_autoptr (GVariant) fallback_object = g_variant_get_child_value (fallback_objects, i);
+      guint8 objtype_y;
+      g_autoptr (GVariant) csum_v = NULL;
+      guint64 compressed_size, uncompressed_size;
+
+      g_variant_get (fallback_object, "(y@aytt)", &objtype_y, &csum_v, &compressed_size,
+                     &uncompressed_size);
+      if (!ostree_validate_structureof_objtype (objtype_y, error))
+        return FALSE;
+      if (!ostree_validate_structureof_csum_v (csum_v, error))
+        return FALSE;
+
+      g_autofree char *checksum = ostree_checksum_from_bytes_v (csum_v);
+      gboolean is_stored;
+      if (!ostree_repo_has_object (pull_data->repo, (OstreeObjectType)objtype_y, checksum,
+                                   &is_stored, cancellable, error))
+        return FALSE;
+      if (!is_stored)
+        needed_fallback_bytes += maybe_swap_endian_u64 (delta_byteswap, compressed_size);
+    }
+
+  n = g_variant_n_children (headers);
+  for (guint i = 0; i < n; i++)
+    {
+      g_autoptr (GVariant) header = g_variant_get_child_value (headers, i);
+      guint32 version;
+      g_autoptr (GVariant) csum_v = NULL;
+      g_autoptr (GVariant) objects = NULL;
+      guint64 size, usize;
+
+      g_variant_get (header, "(u@aytt@ay)", &version, &csum_v, &size, &usize, &objects);
+
+      gboolean have_all;
+      if (!_ostree_repo_static_delta_part_have_all_objects (pull_data->repo, objects, &have_all,
+                                                            cancellable, error))
+        return FALSE;
+      if (!have_all)
+        needed_part_bytes += maybe_swap_endian_u64 (delta_byteswap, size);
+    }
+
+  *out_dominate = (needed_fallback_bytes >= OSTREE_DELTA_FALLBACK_DOMINANCE_MIN_BYTES
+                   && needed_fallback_bytes
+                          > OSTREE_DELTA_FALLBACK_DOMINANCE_RATIO * needed_part_bytes);
+  if (*out_dominate)
+    g_debug ("Skipping delta: %" G_GUINT64_FORMAT " fallback bytes dominate %" G_GUINT64_FORMAT
+             " part bytes",
+             needed_fallback_bytes, needed_part_bytes);
+  return TRUE;
+}
+
 static gboolean
 process_one_static_delta_fallback (OtPullData *pull_data, gboolean delta_byteswap,
                                    GVariant *fallback_object, GCancellable *cancellable,
@@ -2005,17 +3236,17 @@ process_one_static_delta_fallback (OtPullData *pull_data, gboolean delta_byteswa
                            ostree_object_type_to_string (objtype));
       else
         {
-          if (!g_hash_table_lookup (pull_data->requested_content, checksum))
+          if (!(pull_object_status (pull_data, checksum, OSTREE_OBJECT_TYPE_FILE)
+                & OT_PULL_OBJECT_REQUESTED))
             {
-              /* Mark this as requested, like we do in the non-delta path */
-              g_hash_table_add (pull_data->requested_content, checksum);
-              /* But also record it's a delta fallback object, so we can account
+              /* Mark this as requested, like we do in the non-delta path, but
+               * also record it's a delta fallback object, so we can account
                * for it as logically part of the delta fetch.
                */
-              g_hash_table_add (pull_data->requested_fallback_content, g_strdup (checksum));
+              pull_object_set_status (pull_data, checksum, OSTREE_OBJECT_TYPE_FILE,
+                                      OT_PULL_OBJECT_REQUESTED | OT_PULL_OBJECT_DELTA_FALLBACK);
               enqueue_one_object_request (pull_data, checksum, OSTREE_OBJECT_TYPE_FILE, NULL, FALSE,
                                           FALSE, NULL);
-              checksum = NULL; /* We transferred ownership to the requested_content hash */
             }
         }
     }
@@ -2048,10 +3279,14 @@ start_fetch_deltapart (OtPullData *pull_data, FetchStaticDeltaData *fetch)
   pull_data->n_outstanding_deltapart_fetches++;
   g_assert_cmpint (pull_data->n_outstanding_deltapart_fetches, <=,
                    _OSTREE_MAX_OUTSTANDING_DELTAPART_REQUESTS);
-  _ostree_fetcher_request_to_tmpfile (pull_data->fetcher, pull_data->content_mirrorlist,
-                                      deltapart_path, 0, NULL, 0, fetch->size,
-                                      OSTREE_FETCHER_DEFAULT_PRIORITY, pull_data->cancellable,
-                                      static_deltapart_fetch_on_complete, fetch);
+  /* The part occupies the in-flight window until its apply completes */
+  pull_data->deltapart_inflight_bytes += fetch->size;
+  fetch->fetch_start_time = g_get_monotonic_time ();
+  _ostree_fetcher_request_to_tmpfile (pull_data->fetcher, content_mirrorlist_for_fetch (pull_data),
+                                      deltapart_path, OSTREE_FETCHER_REQUEST_RESUMABLE, NULL, 0,
+                                      fetch->size, OSTREE_FETCHER_DEFAULT_PRIORITY,
+                                      pull_data->cancellable, static_deltapart_fetch_on_complete,
+                                      fetch);
 }
 
 static gboolean
@@ -2115,7 +3350,10 @@ process_one_static_delta (OtPullData *pull_data, const char *from_revision, cons
                                                               detached_data, cancellable, error))
             return FALSE;
 
-          FetchObjectData *fetch_data = g_new0 (FetchObjectData, 1);
+          if (detached_data && !import_inline_content (pull_data, detached_data, error))
+            return FALSE;
+
+          FetchObjectData *fetch_data = ot_arena_alloc0 (pull_data->fetch_data_arena);
           fetch_data->pull_data = pull_data;
           fetch_data->object
               = ostree_object_name_serialize (to_checksum, OSTREE_OBJECT_TYPE_COMMIT);
@@ -2199,20 +3437,12 @@ process_one_static_delta (OtPullData *pull_data, const char *from_revision, cons
       if (inline_part_bytes != NULL)
         {
           g_autoptr (GInputStream) memin = g_memory_input_stream_new_from_bytes (inline_part_bytes);
-          g_autoptr (GVariant) inline_delta_part = NULL;
 
           /* For inline parts we are relying on per-commit GPG, so don't bother checksumming. */
-          if (!_ostree_static_delta_part_open (memin, inline_part_bytes,
-                                               OSTREE_STATIC_DELTA_OPEN_FLAGS_SKIP_CHECKSUM, NULL,
-                                               &inline_delta_part, cancellable, error))
-            {
-              fetch_static_delta_data_free (fetch_data);
-              return FALSE;
-            }
-
-          _ostree_static_delta_part_execute_async (pull_data->repo, fetch_data->objects,
-                                                   inline_delta_part, pull_data->cancellable,
-                                                   on_static_delta_written, fetch_data);
+          _ostree_static_delta_part_open_execute_async (
+              pull_data->repo, fetch_data->objects, memin, inline_part_bytes,
+              OSTREE_STATIC_DELTA_OPEN_FLAGS_SKIP_CHECKSUM, NULL, pull_data->cancellable,
+              on_static_delta_written, fetch_data);
           pull_data->n_outstanding_deltapart_write_requests++;
         }
       else
@@ -2400,6 +3630,166 @@ set_required_deltas_error (GError **error, const char *from_revision, const char
                "Static deltas required, but none found for %s to %s", from_revision, to_revision);
 }
 
+static GBytes *
+load_cached_delta_superblock (OstreeRepo *repo, const guchar *expected_digest)
+{
+  if (repo->cache_dir_fd == -1)
+    return NULL;
+
+  char hexdigest[OSTREE_SHA256_STRING_LEN + 1];
+  ostree_checksum_inplace_from_bytes (expected_digest, hexdigest);
+  g_autofree char *path
+      = g_strconcat (_OSTREE_DELTA_SUPERBLOCK_CACHE_DIR "/", hexdigest, NULL);
+
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (repo->cache_dir_fd, path, &fd, NULL))
+    return NULL;
+  if (fd == -1)
+    return NULL;
+
+  g_autoptr (GBytes) bytes = ot_fd_readall_or_mmap (fd, 0, NULL);
+  if (bytes == NULL)
+    return NULL;
+
+  /* The cache is content-addressed, so a digest mismatch just means a
+   * damaged entry; drop it and refetch.
+   */
+  guint8 actual_digest[OSTREE_SHA256_DIGEST_LEN];
+  ot_checksum_bytes (bytes, actual_digest);
+  if (memcmp (expected_digest, actual_digest, sizeof (actual_digest)) != 0)
+    {
+      (void)unlinkat (repo->cache_dir_fd, path, 0);
+      return NULL;
+    }
+
+  return g_steal_pointer (&bytes);
+}
+
+static void
+save_cached_delta_superblock (OstreeRepo *repo, const guint8 *digest, GBytes *data)
+{
+  if (repo->cache_dir_fd == -1)
+    return;
+
+  /* Just a cache; ignore errors */
+  if (!glnx_shutil_mkdir_p_at (repo->cache_dir_fd, _OSTREE_DELTA_SUPERBLOCK_CACHE_DIR,
+                               0775, NULL, NULL))
+    return;
+
+  char hexdigest[OSTREE_SHA256_STRING_LEN + 1];
+  ostree_checksum_inplace_from_bytes (digest, hexdigest);
+  g_autofree char *path
+      = g_strconcat (_OSTREE_DELTA_SUPERBLOCK_CACHE_DIR "/", hexdigest, NULL);
+
+  gsize len;
+  const guint8 *buf = g_bytes_get_data (data, &len);
+  g_auto (GLnxTmpfile) tmpf = {
+    0,
+  };
+  if (!glnx_open_tmpfile_linkable_at (repo->cache_dir_fd, _OSTREE_DELTA_SUPERBLOCK_CACHE_DIR,
+                                      O_WRONLY | O_CLOEXEC, &tmpf, NULL))
+    return;
+  if (glnx_loop_write (tmpf.fd, buf, len) < 0)
+    return;
+  (void)glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, repo->cache_dir_fd, path, NULL);
+}
+
+/* Verify and process superblock content, shared between the network
+ * fetch path and the local superblock cache.  @from_cache controls
+ * whether a verified superblock is (re)written to the cache.
+ */
+static gboolean
+process_delta_superblock (OtPullData *pull_data, FetchDeltaSuperData *fetch_data,
+                          GBytes *delta_superblock_data, gboolean from_cache, GError **error)
+{
+  const char *from_revision = fetch_data->from_revision;
+  const char *to_revision = fetch_data->to_revision;
+  g_autoptr (GVariant) delta_superblock = NULL;
+  g_autofree gchar *delta
+      = g_strconcat (from_revision ?: "", from_revision ? "-" : "", to_revision, NULL);
+  const guchar *expected_summary_digest
+      = g_hash_table_lookup (pull_data->summary_deltas_checksums, delta);
+  guint8 actual_summary_digest[OSTREE_SHA256_DIGEST_LEN];
+
+  ot_checksum_bytes (delta_superblock_data, actual_summary_digest);
+
+#ifndef OSTREE_DISABLE_GPGME
+  /* At this point we've GPG verified the data, so in theory
+   * could trust that they provided the right data, but let's
+   * make this a hard error.
+   */
+  if (pull_data->gpg_verify_summary && !expected_summary_digest)
+    {
+      g_set_error (error, OSTREE_GPG_ERROR, OSTREE_GPG_ERROR_NO_SIGNATURE,
+                   "GPG verification enabled, but no summary signatures found (use "
+                   "gpg-verify-summary=false in remote config to disable)");
+      return FALSE;
+    }
+#endif /* OSTREE_DISABLE_GPGME */
+
+  if (expected_summary_digest
+      && memcmp (expected_summary_digest, actual_summary_digest, sizeof (actual_summary_digest)))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Invalid checksum for static delta %s",
+                   delta);
+      return FALSE;
+    }
+
+  /* Only superblocks whose digest is pinned by the (verified) summary or
+   * delta index are cached, so a poisoned cache can't feed us anything
+   * the network couldn't.
+   */
+  if (expected_summary_digest && !from_cache)
+    save_cached_delta_superblock (pull_data->repo, actual_summary_digest, delta_superblock_data);
+
+  delta_superblock = g_variant_ref_sink (g_variant_new_from_bytes (
+      (GVariantType *)OSTREE_STATIC_DELTA_SUPERBLOCK_FORMAT, delta_superblock_data, FALSE));
+
+  /* Servers may publish next-generation delta formats alongside legacy ones;
+   * a delta requiring a capability this build lacks is skipped in favor of a
+   * plain object walk rather than failing mid-application.
+   */
+  {
+    g_autoptr (GVariant) metadata = g_variant_get_child_value (delta_superblock, 0);
+    g_autofree char *missing_cap = NULL;
+    if (!_ostree_delta_check_required_capabilities (metadata, &missing_cap))
+      {
+        if (pull_data->require_static_deltas)
+          return glnx_throw (error, "Static delta %s requires unsupported capability '%s'", delta,
+                             missing_cap);
+        if (!pull_data->dry_run)
+          {
+            g_debug ("Ignoring static delta %s requiring unsupported capability '%s'", delta,
+                     missing_cap);
+            queue_scan_one_metadata_object (pull_data, to_revision, OSTREE_OBJECT_TYPE_COMMIT, NULL,
+                                            0, fetch_data->requested_ref);
+            return TRUE;
+          }
+      }
+  }
+
+  /* If most of what we'd transfer is fallback objects anyway, the delta
+   * machinery is pure overhead; walk the commit like a plain pull instead.
+   */
+  if (!pull_data->require_static_deltas && !pull_data->dry_run)
+    {
+      gboolean fallbacks_dominate = FALSE;
+      if (!static_delta_fallbacks_dominate (pull_data, delta_superblock, &fallbacks_dominate,
+                                            pull_data->cancellable, error))
+        return FALSE;
+      if (fallbacks_dominate)
+        {
+          queue_scan_one_metadata_object (pull_data, to_revision, OSTREE_OBJECT_TYPE_COMMIT, NULL,
+                                          0, fetch_data->requested_ref);
+          return TRUE;
+        }
+    }
+
+  g_ptr_array_add (pull_data->static_delta_superblocks, g_variant_ref (delta_superblock));
+  return process_one_static_delta (pull_data, from_revision, to_revision, delta_superblock,
+                                   fetch_data->requested_ref, pull_data->cancellable, error);
+}
+
 static void
 on_superblock_fetched (GObject *src, GAsyncResult *res, gpointer data)
 
@@ -2419,6 +3809,10 @@ on_superblock_fetched (GObject *src, GAsyncResult *res, gpointer data)
         goto out;
       g_clear_error (&local_error);
 
+      /* Remember the miss so the next pull under the same summary can
+       * skip this probe entirely. */
+      delta_miss_cache_record (pull_data, from_revision, to_revision);
+
       if (pull_data->require_static_deltas)
         {
           set_required_deltas_error (error, from_revision, to_revision);
@@ -2430,44 +3824,7 @@ on_superblock_fetched (GObject *src, GAsyncResult *res, gpointer data)
     }
   else
     {
-      g_autoptr (GVariant) delta_superblock = NULL;
-      g_autofree gchar *delta
-          = g_strconcat (from_revision ?: "", from_revision ? "-" : "", to_revision, NULL);
-      const guchar *expected_summary_digest
-          = g_hash_table_lookup (pull_data->summary_deltas_checksums, delta);
-      guint8 actual_summary_digest[OSTREE_SHA256_DIGEST_LEN];
-
-      ot_checksum_bytes (delta_superblock_data, actual_summary_digest);
-
-#ifndef OSTREE_DISABLE_GPGME
-      /* At this point we've GPG verified the data, so in theory
-       * could trust that they provided the right data, but let's
-       * make this a hard error.
-       */
-      if (pull_data->gpg_verify_summary && !expected_summary_digest)
-        {
-          g_set_error (error, OSTREE_GPG_ERROR, OSTREE_GPG_ERROR_NO_SIGNATURE,
-                       "GPG verification enabled, but no summary signatures found (use "
-                       "gpg-verify-summary=false in remote config to disable)");
-          goto out;
-        }
-#endif /* OSTREE_DISABLE_GPGME */
-
-      if (expected_summary_digest
-          && memcmp (expected_summary_digest, actual_summary_digest,
-                     sizeof (actual_summary_digest)))
-        {
-          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Invalid checksum for static delta %s",
-                       delta);
-          goto out;
-        }
-
-      delta_superblock = g_variant_ref_sink (g_variant_new_from_bytes (
-          (GVariantType *)OSTREE_STATIC_DELTA_SUPERBLOCK_FORMAT, delta_superblock_data, FALSE));
-
-      g_ptr_array_add (pull_data->static_delta_superblocks, g_variant_ref (delta_superblock));
-      if (!process_one_static_delta (pull_data, from_revision, to_revision, delta_superblock,
-                                     fetch_data->requested_ref, pull_data->cancellable, error))
+      if (!process_delta_superblock (pull_data, fetch_data, delta_superblock_data, FALSE, error))
         goto out;
     }
 
@@ -2517,12 +3874,138 @@ enqueue_one_static_delta_superblock_request_s (OtPullData *pull_data,
     }
 }
 
+/* Negative cache for delta superblock probes.  Remotes that never publish
+ * static deltas otherwise cost a 404 round trip on every update check (see
+ * initiate_request()); remember which (from, to) superblocks were missing,
+ * validated by the digest of the summary that was current at the time, and
+ * skip re-probing until the summary changes.  Persisted per remote next to
+ * the cached summary.
+ */
+#define DELTA_MISS_CACHE_EXTENSION ".delta-misses"
+#define DELTA_MISS_CACHE_VARIANT_TYPE "(ayas)"
+/* Arbitrary bound so a client chasing many refs can't grow the file forever */
+#define DELTA_MISS_CACHE_MAX_ENTRIES 128
+
+static void
+delta_miss_cache_ensure_loaded (OtPullData *pull_data)
+{
+  if (pull_data->delta_miss_cache != NULL)
+    return;
+
+  pull_data->delta_miss_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* Without a remote name there's nowhere to persist, and without summary
+   * data there's no validity token; keep an in-memory-only table then.
+   */
+  if (pull_data->remote_name == NULL || pull_data->summary_data == NULL)
+    return;
+
+  ot_checksum_bytes (pull_data->summary_data, pull_data->delta_miss_summary_digest);
+  pull_data->delta_miss_cache_valid = TRUE;
+
+  g_autoptr (GBytes) contents = NULL;
+  if (!_ostree_repo_load_cache_summary_file (pull_data->repo, pull_data->remote_name,
+                                             DELTA_MISS_CACHE_EXTENSION, &contents, NULL, NULL))
+    return;
+  if (contents == NULL)
+    return;
+
+  g_autoptr (GVariant) cache = g_variant_ref_sink (g_variant_new_from_bytes (
+      G_VARIANT_TYPE (DELTA_MISS_CACHE_VARIANT_TYPE), contents, FALSE));
+  /* Just a cache; a damaged file simply means we re-probe */
+  if (!g_variant_is_normal_form (cache))
+    return;
+
+  g_autoptr (GVariant) digest_v = g_variant_get_child_value (cache, 0);
+  if (g_variant_n_children (digest_v) != OSTREE_SHA256_DIGEST_LEN
+      || memcmp (g_variant_get_data (digest_v), pull_data->delta_miss_summary_digest,
+                 OSTREE_SHA256_DIGEST_LEN)
+             != 0)
+    return; /* The summary changed, so previous misses are stale */
+
+  g_autoptr (GVariant) deltas = g_variant_get_child_value (cache, 1);
+  gsize n = g_variant_n_children (deltas);
+  for (gsize i = 0; i < n; i++)
+    {
+      const char *delta;
+      g_variant_get_child (deltas, i, "&s", &delta);
+      g_hash_table_add (pull_data->delta_miss_cache, g_strdup (delta));
+    }
+}
+
+static gboolean
+delta_miss_cache_lookup (OtPullData *pull_data, const char *delta)
+{
+  delta_miss_cache_ensure_loaded (pull_data);
+  return g_hash_table_contains (pull_data->delta_miss_cache, delta);
+}
+
+static int
+delta_miss_strptr_cmp (gconstpointer a, gconstpointer b)
+{
+  return strcmp (*(const char *const *)a, *(const char *const *)b);
+}
+
+static void
+delta_miss_cache_record (OtPullData *pull_data, const char *from_revision, const char *to_revision)
+{
+  delta_miss_cache_ensure_loaded (pull_data);
+
+  g_autofree char *delta
+      = g_strconcat (from_revision ?: "", from_revision ? "-" : "", to_revision, NULL);
+  if (!g_hash_table_add (pull_data->delta_miss_cache, g_steal_pointer (&delta)))
+    return; /* Already recorded */
+
+  if (!pull_data->delta_miss_cache_valid
+      || g_hash_table_size (pull_data->delta_miss_cache) > DELTA_MISS_CACHE_MAX_ENTRIES)
+    return;
+
+  /* Persist, best effort; sorted so the file is deterministic */
+  g_autofree const char **sorted
+      = (const char **)g_hash_table_get_keys_as_array (pull_data->delta_miss_cache, NULL);
+  qsort (sorted, g_hash_table_size (pull_data->delta_miss_cache), sizeof (char *),
+         delta_miss_strptr_cmp);
+
+  g_auto (GVariantBuilder) builder;
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
+  for (guint i = 0; i < g_hash_table_size (pull_data->delta_miss_cache); i++)
+    g_variant_builder_add (&builder, "s", sorted[i]);
+
+  g_autoptr (GVariant) cache = g_variant_ref_sink (g_variant_new (
+      "(@ayas)",
+      ot_gvariant_new_bytearray (pull_data->delta_miss_summary_digest, OSTREE_SHA256_DIGEST_LEN),
+      &builder));
+  g_autoptr (GBytes) contents = g_variant_get_data_as_bytes (cache);
+  (void)_ostree_repo_save_cache_summary_file (pull_data->repo, pull_data->remote_name,
+                                              DELTA_MISS_CACHE_EXTENSION, contents, NULL, 0, NULL,
+                                              NULL);
+}
+
 /* Start a request for a static delta */
 static void
 enqueue_one_static_delta_superblock_request (OtPullData *pull_data, const char *from_revision,
                                              const char *to_revision,
                                              const OstreeCollectionRef *ref)
 {
+  /* If an earlier pull saw a 404 for this superblock and the remote's
+   * summary hasn't changed since, don't probe again: go straight to the
+   * object fetch fallback, just as on_superblock_fetched() would.  When
+   * deltas are required we always probe, in case the server grew the
+   * delta without republishing its summary.
+   */
+  if (!pull_data->require_static_deltas)
+    {
+      g_autofree char *delta
+          = g_strconcat (from_revision ?: "", from_revision ? "-" : "", to_revision, NULL);
+      if (delta_miss_cache_lookup (pull_data, delta))
+        {
+          g_debug ("skipping delta superblock probe for %s (cached 404)", delta);
+          queue_scan_one_metadata_object (pull_data, to_revision, OSTREE_OBJECT_TYPE_COMMIT, NULL,
+                                          0, ref);
+          return;
+        }
+    }
+
   FetchDeltaSuperData *fdata = g_new0 (FetchDeltaSuperData, 1);
   fdata->pull_data = pull_data;
   fdata->from_revision = g_strdup (from_revision);
@@ -2530,6 +4013,33 @@ enqueue_one_static_delta_superblock_request (OtPullData *pull_data, const char *
   fdata->requested_ref = (ref != NULL) ? ostree_collection_ref_dup (ref) : NULL;
   fdata->n_retries_remaining = pull_data->n_network_retries;
 
+  /* If the summary (or delta index) pinned this superblock's digest and
+   * we have a cached copy from a previous pull, skip the fetch entirely.
+   * (Done here rather than in start_fetch_delta_superblock() since that
+   * may run from inside the queue-draining iteration, which must not be
+   * reentered.)
+   */
+  {
+    g_autofree gchar *delta
+        = g_strconcat (from_revision ?: "", from_revision ? "-" : "", to_revision, NULL);
+    const guchar *expected_summary_digest
+        = g_hash_table_lookup (pull_data->summary_deltas_checksums, delta);
+    if (expected_summary_digest != NULL)
+      {
+        g_autoptr (GBytes) cached
+            = load_cached_delta_superblock (pull_data->repo, expected_summary_digest);
+        if (cached != NULL)
+          {
+            g_debug ("using cached delta superblock for %s", delta);
+            g_autoptr (GError) local_error = NULL;
+            (void)process_delta_superblock (pull_data, fdata, cached, TRUE, &local_error);
+            check_outstanding_requests_handle_error (pull_data, &local_error);
+            g_clear_pointer (&fdata, fetch_delta_super_data_free);
+            return;
+          }
+      }
+  }
+
   enqueue_one_static_delta_superblock_request_s (pull_data, g_steal_pointer (&fdata));
 }
 
@@ -2670,6 +4180,34 @@ _ostree_repo_verify_summary (OstreeRepo *self, const char *name, gboolean gpg_ve
                              GPtrArray *signapi_summary_verifiers, GBytes *summary,
                              GBytes *signatures, GCancellable *cancellable, GError **error)
 {
+  /* On e.g. an hourly polling schedule the summary usually hasn't changed,
+   * and we get handed exactly the bytes that already passed verification on
+   * the previous iteration (loaded back out of tmp/cache/summaries, which is
+   * only written after a successful verification).  Skip the signature
+   * crypto when this (summary, signatures) pair is byte-identical to the
+   * last pair we verified for this remote.  The cache lives on the repo
+   * instance, so it assumes the remote's verification configuration is
+   * stable for the instance lifetime.
+   */
+  g_autofree char *digests = NULL;
+  if (summary != NULL && signatures != NULL
+      && (gpg_verify_summary || signapi_summary_verifiers))
+    {
+      g_autofree char *summary_digest = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, summary);
+      g_autofree char *sig_digest = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, signatures);
+      digests = g_strconcat (summary_digest, ".", sig_digest, NULL);
+
+      g_mutex_lock (&self->cache_lock);
+      const char *verified = self->verified_summary_cache != NULL
+                                 ? g_hash_table_lookup (self->verified_summary_cache, name)
+                                 : NULL;
+      const gboolean already_verified = g_strcmp0 (verified, digests) == 0;
+      g_mutex_unlock (&self->cache_lock);
+
+      if (already_verified)
+        return TRUE;
+    }
+
   if (gpg_verify_summary)
     {
       if (summary == NULL)
@@ -2731,6 +4269,17 @@ _ostree_repo_verify_summary (OstreeRepo *self, const char *name, gboolean gpg_ve
         }
     }
 
+  if (digests != NULL)
+    {
+      g_mutex_lock (&self->cache_lock);
+      if (self->verified_summary_cache == NULL)
+        self->verified_summary_cache
+            = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+      g_hash_table_replace (self->verified_summary_cache, g_strdup (name),
+                            g_steal_pointer (&digests));
+      g_mutex_unlock (&self->cache_lock);
+    }
+
   return TRUE;
 }
 
@@ -2963,6 +4512,16 @@ _ostree_repo_remote_new_fetcher (OstreeRepo *self, const char *remote_name, gboo
       goto out;
     if (!http2)
       fetcher_flags |= OSTREE_FETCHER_FLAGS_DISABLE_HTTP2;
+    else
+      {
+        gboolean multiplexing;
+
+        if (!ostree_repo_get_remote_boolean_option (self, remote_name, "http2-multiplexing", FALSE,
+                                                    &multiplexing, error))
+          goto out;
+        if (multiplexing)
+          fetcher_flags |= OSTREE_FETCHER_FLAGS_MULTIPLEXING;
+      }
   }
 
   fetcher = _ostree_fetcher_new (self->tmp_dir_fd, remote_name, fetcher_flags);
@@ -3019,6 +4578,28 @@ _ostree_repo_remote_new_fetcher (OstreeRepo *self, const char *remote_name, gboo
       _ostree_fetcher_set_proxy (fetcher, http_proxy);
   }
 
+  {
+    g_autofree char *connections_per_host = NULL;
+
+    if (!ostree_repo_get_remote_option (self, remote_name, "connections-per-host", NULL,
+                                        &connections_per_host, error))
+      goto out;
+
+    if (connections_per_host != NULL)
+      _ostree_fetcher_set_max_conns_per_host (
+          fetcher, g_ascii_strtoull (connections_per_host, NULL, 10));
+  }
+
+  {
+    g_autofree char *limit_rate = NULL;
+
+    if (!ostree_repo_get_remote_option (self, remote_name, "limit-rate", NULL, &limit_rate, error))
+      goto out;
+
+    if (limit_rate != NULL)
+      _ostree_fetcher_set_max_bytes_per_sec (fetcher, g_ascii_strtoull (limit_rate, NULL, 10));
+  }
+
   if (!_ostree_repo_remote_name_is_file (remote_name))
     {
       g_autofree char *cookie_file = g_strdup_printf ("%s.cookies.txt", remote_name);
@@ -3033,8 +4614,26 @@ _ostree_repo_remote_new_fetcher (OstreeRepo *self, const char *remote_name, gboo
         _ostree_fetcher_set_cookie_jar (fetcher, jar_path);
     }
 
-  if (extra_headers)
-    _ostree_fetcher_set_extra_headers (fetcher, extra_headers);
+  {
+    /* Advertise the delta formats this client can apply, so servers can vary
+     * delta selection per client.  User-supplied headers follow ours.
+     */
+    g_auto (GVariantBuilder) hdr_builder = OT_VARIANT_BUILDER_INITIALIZER;
+    g_variant_builder_init (&hdr_builder, G_VARIANT_TYPE ("a(ss)"));
+    g_autofree char *caps = g_strjoinv (" ", (char **)_ostree_delta_client_capabilities ());
+    g_variant_builder_add (&hdr_builder, "(ss)", OSTREE_DELTA_CAPABILITIES_HEADER, caps);
+    if (extra_headers)
+      {
+        GVariantIter viter;
+        const char *key;
+        const char *value;
+        g_variant_iter_init (&viter, extra_headers);
+        while (g_variant_iter_loop (&viter, "(&s&s)", &key, &value))
+          g_variant_builder_add (&hdr_builder, "(ss)", key, value);
+      }
+    g_autoptr (GVariant) all_headers = g_variant_ref_sink (g_variant_builder_end (&hdr_builder));
+    _ostree_fetcher_set_extra_headers (fetcher, all_headers);
+  }
 
   if (append_user_agent)
     _ostree_fetcher_set_extra_user_agent (fetcher, append_user_agent);
@@ -3222,6 +4821,50 @@ reinitialize_fetcher (OtPullData *pull_data, const char *remote_name, GError **e
   if (pull_data->fetcher == NULL)
     return FALSE;
 
+  /* A per-pull limit-rate option overrides the remote's configuration */
+  if (pull_data->limit_rate_bytes_per_sec > 0)
+    _ostree_fetcher_set_max_bytes_per_sec (pull_data->fetcher,
+                                           pull_data->limit_rate_bytes_per_sec);
+
+  /* Mirrors the http2-multiplexing handling in _ostree_repo_remote_new_fetcher();
+   * when multiplexing we keep a much deeper request window since each request is
+   * just a stream on a shared connection.
+   */
+  {
+    gboolean http2 = TRUE;
+    gboolean multiplexing = FALSE;
+#ifndef BUILDOPT_HTTP2
+    http2 = FALSE;
+#endif
+    if (!ostree_repo_get_remote_boolean_option (pull_data->repo, remote_name, "http2", http2,
+                                                &http2, error))
+      return FALSE;
+    if (http2
+        && !ostree_repo_get_remote_boolean_option (pull_data->repo, remote_name,
+                                                   "http2-multiplexing", FALSE, &multiplexing,
+                                                   error))
+      return FALSE;
+    pull_data->max_outstanding_fetcher_requests
+        = multiplexing ? _OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS_MULTIPLEXED
+                       : _OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS;
+  }
+
+  /* Size of the window of delta-part bytes allowed in flight at once; a part
+   * counts against it from the start of its download until its apply
+   * completes.  Smaller devices can shrink this to bound temporary space.
+   */
+  {
+    g_autofree char *inflight_mb_str = NULL;
+    if (!ostree_repo_get_remote_option (pull_data->repo, remote_name, "deltapart-inflight-mb", NULL,
+                                        &inflight_mb_str, error))
+      return FALSE;
+    if (inflight_mb_str != NULL)
+      pull_data->max_deltapart_inflight_bytes
+          = MAX (1, g_ascii_strtoull (inflight_mb_str, NULL, 10)) * 1024 * 1024;
+    else
+      pull_data->max_deltapart_inflight_bytes = _OSTREE_DEFAULT_DELTAPART_INFLIGHT_BYTES;
+  }
+
   return TRUE;
 }
 
@@ -3444,6 +5087,8 @@ all_requested_refs_have_commit (
  *   * `localcache-repos` (`as`): File paths for local repos to use as caches when doing remote
  * fetches
  *   * `append-user-agent` (`s`): Additional string to append to the user agent
+ *   * `limit-rate` (`t`): Cap the aggregate download rate at this many bytes per
+ *     second, overriding the remote's limit-rate configuration; 0 means unlimited
  *   * `n-network-retries` (`u`): Number of times to retry each download on receiving
  *     a transient network error, such as a socket timeout; default is 5, 0
  *     means return errors without retrying. Since: 2018.6
@@ -3465,6 +5110,12 @@ all_requested_refs_have_commit (
  *     is specified, `summary-bytes` must also be specified. Since: 2020.5
  *   * `disable-verify-bindings` (`b`): Disable verification of commit bindings.
  *     Since: 2020.9
+ *   * `extra-content-sources` (`as`): Additional base URLs serving the same
+ *     content as the remote being pulled from. Object and delta-part fetches
+ *     are striped round-robin across the remote and all extra sources, with
+ *     failed requests rerouted to the remaining sources. Content is verified
+ *     by checksum, so the extra sources need not be trusted. Metadata is only
+ *     fetched from the primary remote. Since: 2023.6
  */
 static gboolean
 ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_name_or_baseurl,
@@ -3499,6 +5150,7 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
   g_autofree char **override_commit_ids = NULL;
   g_autoptr (GSource) update_timeout = NULL;
   gboolean opt_per_object_fsync = FALSE;
+  gboolean opt_local_verify_sample = FALSE;
   gboolean opt_gpg_verify_set = FALSE;
   gboolean opt_gpg_verify_summary_set = FALSE;
   gboolean opt_collection_refs_set = FALSE;
@@ -3515,6 +5167,7 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
       = NULL; /* (element-type OstreeCollectionRef utf8) */
   gsize i;
   g_autofree char **opt_localcache_repos = NULL;
+  g_autofree char **extra_content_sources = NULL;
   g_autoptr (GVariantIter) ref_keyring_map_iter = NULL;
   g_autoptr (GVariant) summary_bytes_v = NULL;
   g_autoptr (GVariant) summary_sig_bytes_v = NULL;
@@ -3527,8 +5180,9 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
   };
   gboolean remote_mode_loaded = FALSE;
 
-  /* Default */
+  /* Defaults */
   pull_data->max_metadata_size = OSTREE_MAX_METADATA_SIZE;
+  pull_data->max_deltapart_inflight_bytes = _OSTREE_DEFAULT_DELTAPART_INFLIGHT_BYTES;
 
   if (options)
     {
@@ -3556,6 +5210,7 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
       (void)g_variant_lookup (options, "override-commit-ids", "^a&s", &override_commit_ids);
       (void)g_variant_lookup (options, "dry-run", "b", &pull_data->dry_run);
       (void)g_variant_lookup (options, "per-object-fsync", "b", &opt_per_object_fsync);
+      (void)g_variant_lookup (options, "local-verify-sample", "b", &opt_local_verify_sample);
       (void)g_variant_lookup (options, "override-url", "&s", &url_override);
       (void)g_variant_lookup (options, "inherit-transaction", "b", &inherit_transaction);
       (void)g_variant_lookup (options, "http-headers", "@a(ss)", &pull_data->extra_headers);
@@ -3566,6 +5221,7 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
                               &pull_data->timestamp_check_from_rev);
       (void)g_variant_lookup (options, "max-metadata-size", "t", &pull_data->max_metadata_size);
       (void)g_variant_lookup (options, "append-user-agent", "s", &pull_data->append_user_agent);
+      (void)g_variant_lookup (options, "limit-rate", "t", &pull_data->limit_rate_bytes_per_sec);
       opt_n_network_retries_set
           = g_variant_lookup (options, "n-network-retries", "u", &pull_data->n_network_retries);
       opt_ref_keyring_map_set
@@ -3574,6 +5230,7 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
       (void)g_variant_lookup (options, "summary-sig-bytes", "@ay", &summary_sig_bytes_v);
       (void)g_variant_lookup (options, "disable-verify-bindings", "b",
                               &pull_data->disable_verify_bindings);
+      (void)g_variant_lookup (options, "extra-content-sources", "^a&s", &extra_content_sources);
 
       if (pull_data->remote_refspec_name != NULL)
         pull_data->remote_name = g_strdup (pull_data->remote_refspec_name);
@@ -3641,9 +5298,21 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
   if (!opt_n_network_retries_set)
     pull_data->n_network_retries = DEFAULT_N_NETWORK_RETRIES;
 
+  /* May be raised by reinitialize_fetcher() for http2-multiplexing remotes */
+  pull_data->max_outstanding_fetcher_requests = _OSTREE_MAX_OUTSTANDING_FETCHER_REQUESTS;
+  /* May be raised below for local pulls */
+  pull_data->max_outstanding_write_requests = _OSTREE_MAX_OUTSTANDING_WRITE_REQUESTS;
+
   pull_data->repo = self;
   pull_data->progress = progress;
 
+  /* Metadata scan prefetching; if thread creation fails we silently
+   * fall back to probing the repo on the main loop as before.
+   */
+  pull_data->scan_prefetch_results = g_async_queue_new ();
+  pull_data->scan_prefetch_pool = ot_thread_pool_new (
+      "pull-scan-prefetch", scan_prefetch_worker, pull_data, MIN (g_get_num_processors (), 4));
+
   pull_data->expected_commit_sizes = g_hash_table_new_full (
       g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
   pull_data->commit_to_depth
@@ -3660,18 +5329,13 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
   pull_data->ref_keyring_map
       = g_hash_table_new_full (ostree_collection_ref_hash, ostree_collection_ref_equal,
                                (GDestroyNotify)ostree_collection_ref_free, (GDestroyNotify)g_free);
-  pull_data->scanned_metadata = g_hash_table_new_full (ostree_hash_object_name, g_variant_equal,
-                                                       (GDestroyNotify)g_variant_unref, NULL);
+  pull_data->gpg_keyring_digests
+      = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify)g_free,
+                               (GDestroyNotify)g_free);
+  pull_data->object_statuses = ot_object_status_table_new ();
   pull_data->fetched_detached_metadata = g_hash_table_new_full (
       g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)variant_or_null_unref);
-  pull_data->requested_content
-      = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
-  pull_data->requested_fallback_content
-      = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
-  pull_data->requested_metadata = g_hash_table_new_full (ostree_hash_object_name, g_variant_equal,
-                                                         (GDestroyNotify)g_variant_unref, NULL);
-  pull_data->pending_fetch_content = g_hash_table_new_full (
-      g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)fetch_object_data_free);
+  pull_data->pending_fetch_content = g_sequence_new (NULL);
   pull_data->pending_fetch_metadata = g_hash_table_new_full (
       ostree_hash_object_name, g_variant_equal, (GDestroyNotify)g_variant_unref,
       (GDestroyNotify)fetch_object_data_free);
@@ -3681,6 +5345,12 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
       = g_hash_table_new_full (NULL, NULL, (GDestroyNotify)fetch_delta_super_data_free, NULL);
   pull_data->pending_fetch_deltaparts
       = g_hash_table_new_full (NULL, NULL, (GDestroyNotify)fetch_static_delta_data_free, NULL);
+  pull_data->request_latencies = g_array_new (FALSE, FALSE, sizeof (guint64));
+  /* The two per-object record types allocated in bulk during the scan
+   * and fetch phases come out of slab arenas rather than malloc.
+   */
+  pull_data->fetch_data_arena = ot_arena_new ("pull-fetch-data", sizeof (FetchObjectData));
+  pull_data->scan_data_arena = ot_arena_new ("pull-scan-data", sizeof (ScanObjectQueueData));
 
   if (opt_localcache_repos && *opt_localcache_repos)
     {
@@ -3863,6 +5533,68 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
       }
   }
 
+  /* Geo-distributed mirrorlists can have large latency variance between
+   * entries, and the fetcher otherwise sticks to the first listed mirror for
+   * the whole pull.  When enabled per-remote, race a small fetch across the
+   * leading mirrors and promote the first responder; the relative order of
+   * the rest (and thus the sequential fallback chain) is preserved.
+   */
+  {
+    gboolean probe_mirrors = FALSE;
+    if (!ostree_repo_get_remote_boolean_option (self, remote_name_or_baseurl, "probe-mirrors",
+                                                FALSE, &probe_mirrors, error))
+      goto out;
+    if (probe_mirrors)
+      {
+        _ostree_fetcher_mirrorlist_probe_fastest (pull_data->fetcher, pull_data->meta_mirrorlist,
+                                                  OSTREE_FETCHER_MIRROR_PROBE_N, cancellable);
+        if (pull_data->content_mirrorlist != pull_data->meta_mirrorlist)
+          _ostree_fetcher_mirrorlist_probe_fastest (pull_data->fetcher,
+                                                    pull_data->content_mirrorlist,
+                                                    OSTREE_FETCHER_MIRROR_PROBE_N, cancellable);
+      }
+  }
+
+  /* Equivalent peers advertising the same commits (P2P pulls); append them to
+   * the content mirrorlist and stripe object fetches round-robin across all
+   * sources to aggregate their bandwidth.  Content is always checksum-verified
+   * after download, so fetching payload from extra peers is safe; metadata
+   * still comes from the primary source only.
+   */
+  if (extra_content_sources != NULL && extra_content_sources[0] != NULL)
+    {
+      /* The content mirrorlist may alias meta_mirrorlist; copy before extending */
+      g_autoptr (GPtrArray) striped
+          = g_ptr_array_new_with_free_func ((GDestroyNotify)_ostree_fetcher_uri_free);
+      for (guint i = 0; i < pull_data->content_mirrorlist->len; i++)
+        g_ptr_array_add (striped,
+                         _ostree_fetcher_uri_clone (pull_data->content_mirrorlist->pdata[i]));
+      for (char **iter = extra_content_sources; *iter != NULL; iter++)
+        {
+          OstreeFetcherURI *peer_uri = _ostree_fetcher_uri_parse (*iter, error);
+          if (peer_uri == NULL)
+            goto out;
+          g_ptr_array_add (striped, peer_uri);
+        }
+      g_ptr_array_unref (pull_data->content_mirrorlist);
+      pull_data->content_mirrorlist = g_steal_pointer (&striped);
+
+      /* Precompute the rotations handed out round-robin by
+       * content_mirrorlist_for_fetch(); each keeps every source in its
+       * fallback chain so a failing peer just reroutes the request.
+       */
+      guint n_sources = pull_data->content_mirrorlist->len;
+      pull_data->content_stripe_rotations
+          = g_ptr_array_new_with_free_func ((GDestroyNotify)g_ptr_array_unref);
+      for (guint r = 0; r < n_sources; r++)
+        {
+          GPtrArray *rotation = g_ptr_array_new ();
+          for (guint i = 0; i < n_sources; i++)
+            g_ptr_array_add (rotation, pull_data->content_mirrorlist->pdata[(r + i) % n_sources]);
+          g_ptr_array_add (pull_data->content_stripe_rotations, rotation);
+        }
+    }
+
   /* FIXME: Do we want an analogue of this which supports collection IDs? */
   if (!ostree_repo_get_remote_list_option (self, remote_name_or_baseurl, "branches",
                                            &configured_branches, error))
@@ -3905,11 +5637,22 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
        */
       if ((flags & OSTREE_REPO_PULL_FLAGS_UNTRUSTED) == 0)
         pull_data->importflags |= _OSTREE_REPO_IMPORT_FLAGS_TRUSTED;
+      else if (opt_local_verify_sample)
+        pull_data->importflags |= _OSTREE_REPO_IMPORT_FLAGS_VERIFY_SAMPLE;
 
       /* Shouldn't be referenced in this path, but just in case.  See below
        * for more information.
        */
       pull_data->trusted_http_direct = FALSE;
+
+      /* Local imports are hardlink/reflink-or-copy syscall work with no
+       * network half; the small write window above is sized to provide
+       * backpressure against HTTP fetches and would serialize a
+       * disk-to-disk copy to a few objects in flight.  Scale it with the
+       * CPU count instead; the GTask thread pool provides the actual
+       * execution parallelism.
+       */
+      pull_data->max_outstanding_write_requests = MIN (g_get_num_processors () * 2, 16);
     }
   else
     {
@@ -4047,6 +5790,7 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
   pull_data->static_delta_superblocks
       = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
 
+  guint64 summary_start_time = g_get_monotonic_time ();
   if (need_summary)
     {
       g_autoptr (GBytes) bytes_sig = NULL;
@@ -4308,14 +6052,17 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
           pull_data->summary_data = g_bytes_ref (bytes_summary);
           pull_data->summary_etag = g_strdup (summary_etag);
           pull_data->summary_last_modified = summary_last_modified;
+          /* Note the variant is in untrusted mode, so accessors perform
+           * bounds checking.  We deliberately do not check the whole file
+           * is in normal form up front: with many thousands of refs that
+           * walks (and faults in) every page of a potentially mmap()ed
+           * summary, while a pull of a single ref only needs the pages the
+           * binary search lands on.  Instead each ref entry is checked for
+           * normal form when it is actually resolved.
+           */
           pull_data->summary
               = g_variant_new_from_bytes (OSTREE_SUMMARY_GVARIANT_FORMAT, bytes_summary, FALSE);
 
-          if (!g_variant_is_normal_form (pull_data->summary))
-            {
-              g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Not normal form");
-              goto out;
-            }
           if (!g_variant_is_of_type (pull_data->summary, OSTREE_SUMMARY_GVARIANT_FORMAT))
             {
               g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Doesn't match variant type '%s'",
@@ -4350,30 +6097,70 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
           else if (!ostree_validate_collection_id (main_collection_id, error))
             goto out;
 
+          /* Only mirror pulls need to enumerate (and hence page in) the
+           * whole ref list; regular pulls resolve their refs one at a time
+           * via binary search, validating each entry as it's used.
+           */
+          pull_data->summary_ref_shards = g_variant_lookup_value (
+              additional_metadata, OSTREE_SUMMARY_REF_SHARDS, G_VARIANT_TYPE ("aay"));
+          if (pull_data->summary_ref_shards != NULL
+              && g_variant_n_children (pull_data->summary_ref_shards) == 0)
+            g_clear_pointer (&pull_data->summary_ref_shards, g_variant_unref);
+
           refs = g_variant_get_child_value (pull_data->summary, 0);
-          for (i = 0, n = g_variant_n_children (refs); i < n; i++)
+          if (pull_data->is_mirror && !refs_to_fetch && !opt_collection_refs_set)
             {
-              const char *refname;
-              g_autoptr (GVariant) ref = g_variant_get_child_value (refs, i);
+              for (i = 0, n = g_variant_n_children (refs); i < n; i++)
+                {
+                  const char *refname;
+                  g_autoptr (GVariant) ref = g_variant_get_child_value (refs, i);
 
-              g_variant_get_child (ref, 0, "&s", &refname);
+                  g_variant_get_child (ref, 0, "&s", &refname);
 
-              if (!ostree_validate_rev (refname, error))
-                goto out;
+                  if (!ostree_validate_rev (refname, error))
+                    goto out;
 
-              if (pull_data->is_mirror && !refs_to_fetch && !opt_collection_refs_set)
-                {
                   g_hash_table_insert (requested_refs_to_fetch,
                                        ostree_collection_ref_new (main_collection_id, refname),
                                        NULL);
                 }
+
+              /* With a sharded ref list the summary's own list above is
+               * empty; a mirror pull needs every ref, so fetch all shards.
+               */
+              if (pull_data->summary_ref_shards != NULL)
+                {
+                  const guint n_shards = g_variant_n_children (pull_data->summary_ref_shards);
+                  for (guint shard_idx = 0; shard_idx < n_shards; shard_idx++)
+                    {
+                      g_autoptr (GVariant) shard = NULL;
+                      if (!fetch_summary_ref_shard (pull_data, shard_idx, &shard, error))
+                        goto out;
+
+                      for (gsize j = 0, shard_n = g_variant_n_children (shard); j < shard_n; j++)
+                        {
+                          const char *refname;
+                          g_autoptr (GVariant) ref = g_variant_get_child_value (shard, j);
+
+                          g_variant_get_child (ref, 0, "&s", &refname);
+
+                          if (!ostree_validate_rev (refname, error))
+                            goto out;
+
+                          g_hash_table_insert (
+                              requested_refs_to_fetch,
+                              ostree_collection_ref_new (main_collection_id, refname), NULL);
+                        }
+                    }
+                }
             }
 
           g_autoptr (GVariant) collection_map = NULL;
           collection_map
               = g_variant_lookup_value (additional_metadata, OSTREE_SUMMARY_COLLECTION_MAP,
                                         G_VARIANT_TYPE ("a{sa(s(taya{sv}))}"));
-          if (collection_map != NULL)
+          if (collection_map != NULL && pull_data->is_mirror && !refs_to_fetch
+              && !opt_collection_refs_set)
             {
               GVariantIter collection_map_iter;
               const char *collection_id;
@@ -4397,12 +6184,9 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
                       if (!ostree_validate_rev (refname, error))
                         goto out;
 
-                      if (pull_data->is_mirror && !refs_to_fetch && !opt_collection_refs_set)
-                        {
-                          g_hash_table_insert (requested_refs_to_fetch,
-                                               ostree_collection_ref_new (collection_id, refname),
-                                               NULL);
-                        }
+                      g_hash_table_insert (requested_refs_to_fetch,
+                                           ostree_collection_ref_new (collection_id, refname),
+                                           NULL);
                     }
                 }
             }
@@ -4427,6 +6211,11 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
           pull_data->has_tombstone_commits = tombstone_commits;
           remote_mode_loaded = TRUE;
         }
+
+      /* Wall-clock cost of obtaining and verifying the summary, including
+       * any ref shard fetches; published as summary-fetch-usecs.
+       */
+      pull_data->summary_fetch_usecs = g_get_monotonic_time () - summary_start_time;
     }
 
   if (pull_data->require_static_deltas && !pull_data->has_indexed_deltas
@@ -4607,6 +6396,12 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
   if (!reinitialize_fetcher (pull_data, remote_name_or_baseurl, error))
     goto out;
 
+  /* Learn whether the remote publishes pack files, so metadata fetches can
+   * be coalesced into byte-range requests; entirely optional.
+   */
+  if (!pull_data->dry_run)
+    fetch_remote_pack_indexes (pull_data, cancellable);
+
   pull_data->legacy_transaction_resuming = FALSE;
   if (!inherit_transaction
       && !ostree_repo_prepare_transaction (pull_data->repo, &pull_data->legacy_transaction_resuming,
@@ -4616,6 +6411,14 @@ ostree_repo_pull_with_options_internal (OstreeRepo *self, const char *remote_nam
   if (pull_data->legacy_transaction_resuming)
     g_debug ("resuming legacy transaction");
 
+  /* Snapshot which objects we already have (including any staged by an
+   * interrupted pull) so the scan phase answers has-object probes from
+   * memory rather than a stat() per object.  Must happen after the
+   * transaction is prepared so the staging directory is included.  On
+   * failure just fall back to per-object probing.
+   */
+  pull_data->object_index = _ostree_repo_object_index_new (pull_data->repo, cancellable, NULL);
+
   /* Initiate requests for explicit commit revisions */
   GLNX_HASH_TABLE_FOREACH_V (commits_to_fetch, const char *, commit)
     {
@@ -4879,6 +6682,39 @@ out:
 
   if (!inherit_transaction)
     ostree_repo_abort_transaction (pull_data->repo, cancellable, NULL);
+  /* Wait for any in-flight prefetch workers, then reap their results;
+   * they reference pull_data and the main context.
+   */
+  if (pull_data->scan_prefetch_pool != NULL)
+    {
+      ot_thread_pool_free (pull_data->scan_prefetch_pool);
+      pull_data->scan_prefetch_pool = NULL;
+    }
+  if (pull_data->scan_prefetch_results != NULL)
+    {
+      ScanObjectQueueData *scan_data;
+      while ((scan_data = g_async_queue_try_pop (pull_data->scan_prefetch_results)) != NULL)
+        scan_object_queue_data_free (scan_data);
+      g_clear_pointer (&pull_data->scan_prefetch_results, g_async_queue_unref);
+    }
+  /* Likewise the signature verification worker and its verdict queue */
+  if (pull_data->verify_pool != NULL)
+    {
+      ot_thread_pool_free (pull_data->verify_pool);
+      pull_data->verify_pool = NULL;
+    }
+  if (pull_data->verify_results != NULL)
+    {
+      OtVerifyCommitJob *job;
+      while ((job = g_async_queue_try_pop (pull_data->verify_results)) != NULL)
+        {
+          verify_commit_fetch_data_free (job->user_data);
+          _verify_commit_job_free (job);
+        }
+      g_clear_pointer (&pull_data->verify_results, g_async_queue_unref);
+    }
+  /* After the prefetch workers have exited; they query the index */
+  g_clear_pointer (&pull_data->object_index, _ostree_repo_object_index_free);
   g_main_context_unref (pull_data->main_context);
   if (update_timeout)
     g_source_destroy (update_timeout);
@@ -4894,35 +6730,53 @@ out:
   g_clear_pointer (&pull_data->signapi_commit_verifiers, g_ptr_array_unref);
   g_clear_pointer (&pull_data->signapi_summary_verifiers, g_ptr_array_unref);
   g_clear_pointer (&pull_data->meta_mirrorlist, g_ptr_array_unref);
+  g_clear_pointer (&pull_data->content_stripe_rotations, g_ptr_array_unref);
   g_clear_pointer (&pull_data->content_mirrorlist, g_ptr_array_unref);
   g_clear_pointer (&pull_data->summary_data, g_bytes_unref);
   g_clear_pointer (&pull_data->summary_etag, g_free);
   g_clear_pointer (&pull_data->summary_data_sig, g_bytes_unref);
   g_clear_pointer (&pull_data->summary_sig_etag, g_free);
   g_clear_pointer (&pull_data->summary, g_variant_unref);
+  g_clear_pointer (&pull_data->summary_ref_shards, g_variant_unref);
+  g_clear_pointer (&pull_data->summary_shards, g_hash_table_unref);
+  g_clear_pointer (&pull_data->summary_collection_map_index, g_hash_table_unref);
   g_clear_pointer (&pull_data->static_delta_superblocks, g_ptr_array_unref);
   g_clear_pointer (&pull_data->commit_to_depth, g_hash_table_unref);
   g_clear_pointer (&pull_data->expected_commit_sizes, g_hash_table_unref);
-  g_clear_pointer (&pull_data->scanned_metadata, g_hash_table_unref);
+  g_clear_pointer (&pull_data->object_statuses, ot_object_status_table_free);
   g_clear_pointer (&pull_data->fetched_detached_metadata, g_hash_table_unref);
   g_clear_pointer (&pull_data->summary_deltas_checksums, g_hash_table_unref);
+  g_clear_pointer (&pull_data->delta_miss_cache, g_hash_table_unref);
   g_clear_pointer (&pull_data->ref_original_commits, g_hash_table_unref);
   g_free (pull_data->timestamp_check_from_rev);
   g_clear_pointer (&pull_data->verified_commits, g_hash_table_unref);
   g_clear_pointer (&pull_data->signapi_verified_commits, g_hash_table_unref);
   g_clear_pointer (&pull_data->ref_keyring_map, g_hash_table_unref);
-  g_clear_pointer (&pull_data->requested_content, g_hash_table_unref);
-  g_clear_pointer (&pull_data->requested_fallback_content, g_hash_table_unref);
-  g_clear_pointer (&pull_data->requested_metadata, g_hash_table_unref);
-  g_clear_pointer (&pull_data->pending_fetch_content, g_hash_table_unref);
+  g_clear_pointer (&pull_data->gpg_keyring_digests, g_hash_table_unref);
+  if (pull_data->pending_fetch_content != NULL)
+    {
+      pending_fetch_content_clear (pull_data);
+      g_clear_pointer (&pull_data->pending_fetch_content, g_sequence_free);
+    }
+  g_clear_pointer (&pull_data->object_sizes, g_hash_table_unref);
   g_clear_pointer (&pull_data->pending_fetch_metadata, g_hash_table_unref);
   g_clear_pointer (&pull_data->pending_fetch_delta_indexes, g_hash_table_unref);
   g_clear_pointer (&pull_data->pending_fetch_delta_superblocks, g_hash_table_unref);
   g_clear_pointer (&pull_data->pending_fetch_deltaparts, g_hash_table_unref);
+  g_clear_pointer (&pull_data->request_latencies, g_array_unref);
   g_queue_foreach (&pull_data->scan_object_queue, (GFunc)scan_object_queue_data_free, NULL);
   g_queue_clear (&pull_data->scan_object_queue);
   g_clear_pointer (&pull_data->idle_src, g_source_destroy);
+  if (pull_data->remote_pack_batches != NULL)
+    pack_batches_abandon (pull_data);
+  g_clear_pointer (&pull_data->remote_pack_batches, g_hash_table_unref);
+  g_clear_pointer (&pull_data->remote_pack_objects, g_hash_table_unref);
+  g_clear_pointer (&pull_data->pack_flush_src, g_source_destroy);
   g_clear_pointer (&pull_data->dirs, g_ptr_array_unref);
+  /* Last, after every container holding individual arena records has
+   * been torn down above. */
+  g_clear_pointer (&pull_data->fetch_data_arena, ot_arena_free);
+  g_clear_pointer (&pull_data->scan_data_arena, ot_arena_free);
   g_clear_pointer (&remote_config, g_key_file_unref);
   return ret;
 }
@@ -5347,33 +7201,49 @@ ostree_repo_find_remotes_async (OstreeRepo *self, const OstreeCollectionRef *con
                                         g_steal_pointer (&task));
 }
 
-/* Find the first instance of (@collection_id, @ref_name) in @refs and return
- * its index; or return %FALSE if nothing’s found. */
-static gboolean
-collection_refv_contains (const OstreeCollectionRef *const *refs, const gchar *collection_id,
-                          const gchar *ref_name, gsize *out_index)
+/* Build an index over @refs mapping each collection–ref to its array index,
+ * so summary entries resolve with one hash lookup instead of a linear scan
+ * over the requested refs (which is quadratic across a large summary).  The
+ * keys borrow @refs, which must outlive the returned table. */
+static GHashTable *
+collection_refv_index (const OstreeCollectionRef *const *refs)
 {
-  gsize i;
+  GHashTable *index = g_hash_table_new (ostree_collection_ref_hash, ostree_collection_ref_equal);
 
-  for (i = 0; refs[i] != NULL; i++)
+  for (gsize i = 0; refs[i] != NULL; i++)
     {
-      if (g_str_equal (refs[i]->collection_id, collection_id)
-          && g_str_equal (refs[i]->ref_name, ref_name))
-        {
-          *out_index = i;
-          return TRUE;
-        }
+      /* First instance wins, matching the old linear scan */
+      if (!g_hash_table_contains (index, refs[i]))
+        g_hash_table_insert (index, (gpointer)refs[i], GSIZE_TO_POINTER (i));
     }
 
-  return FALSE;
+  return index;
+}
+
+/* Look up (@collection_id, @ref_name) in an index built by
+ * collection_refv_index() and return its index in the underlying array; or
+ * return %FALSE if nothing’s found. */
+static gboolean
+collection_refv_contains (GHashTable *ref_indexes, const gchar *collection_id,
+                          const gchar *ref_name, gsize *out_index)
+{
+  const OstreeCollectionRef key = { (gchar *)collection_id, (gchar *)ref_name };
+  gpointer value;
+
+  if (!g_hash_table_lookup_extended (ref_indexes, &key, NULL, &value))
+    return FALSE;
+
+  *out_index = GPOINTER_TO_SIZE (value);
+  return TRUE;
 }
 
-/* For each ref from @refs which is listed in @summary_refs, cache its metadata
- * from the summary file entry into @commit_metadatas, and add the checksum it
- * points to into @refs_and_remotes_table at (@ref_index, @result_index).
- * @ref_index is the ref’s index in @refs. */
+/* For each ref from the requested refs (indexed by @ref_indexes) which is
+ * listed in @summary_refs, cache its metadata from the summary file entry
+ * into @commit_metadatas, and add the checksum it points to into
+ * @refs_and_remotes_table at (@ref_index, @result_index).
+ * @ref_index is the ref’s index in the requested refs array. */
 static gboolean
-find_remotes_process_refs (OstreeRepo *self, const OstreeCollectionRef *const *refs,
+find_remotes_process_refs (OstreeRepo *self, GHashTable *ref_indexes,
                            OstreeRepoFinderResult *result, gsize result_index,
                            const gchar *summary_collection_id, GVariant *summary_refs,
                            GHashTable *commit_metadatas, PointerTable *refs_and_remotes_table)
@@ -5418,7 +7288,7 @@ find_remotes_process_refs (OstreeRepo *self, const OstreeCollectionRef *const *r
       ostree_checksum_inplace_from_bytes (csum_bytes, tmp_checksum);
 
       /* Is this a ref we care about? */
-      if (!collection_refv_contains (refs, summary_collection_id, ref_name, &ref_index))
+      if (!collection_refv_contains (ref_indexes, summary_collection_id, ref_name, &ref_index))
         continue;
 
       /* Load the commit from disk if possible, for verification. */
@@ -5560,6 +7430,7 @@ find_remotes_cb (GObject *obj, GAsyncResult *async_result, gpointer user_data)
   n_refs = g_strv_length ((gchar **)refs); /* it’s not a GStrv, but this works */
   refs_and_remotes_table = pointer_table_new (n_refs, results->len);
   remotes_to_remove = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_remote_unref);
+  g_autoptr (GHashTable) ref_indexes = collection_refv_index (refs);
 
   /* Fetch and validate the summary file for each result. */
   /* FIXME: All these downloads could be parallelised; that requires the
@@ -5623,7 +7494,7 @@ find_remotes_cb (GObject *obj, GAsyncResult *async_result, gpointer user_data)
         {
           summary_refs = g_variant_get_child_value (summary_v, 0);
 
-          if (!find_remotes_process_refs (self, refs, result, i, summary_collection_id,
+          if (!find_remotes_process_refs (self, ref_indexes, result, i, summary_collection_id,
                                           summary_refs, commit_metadatas, refs_and_remotes_table))
             {
               g_clear_pointer (&g_ptr_array_index (results, i), ostree_repo_finder_result_free);
@@ -5647,7 +7518,7 @@ find_remotes_cb (GObject *obj, GAsyncResult *async_result, gpointer user_data)
                                                       summary_collection_id))
             continue;
 
-          if (!find_remotes_process_refs (self, refs, result, i, summary_collection_id,
+          if (!find_remotes_process_refs (self, ref_indexes, result, i, summary_collection_id,
                                           summary_refs, commit_metadatas, refs_and_remotes_table))
             {
               g_clear_pointer (&g_ptr_array_index (results, i), ostree_repo_finder_result_free);
@@ -6023,6 +7894,183 @@ copy_option (GVariantDict *master_options, GVariantDict *slave_options, const gc
     g_variant_dict_insert_value (slave_options, key, option_v);
 }
 
+/* One pull against a single finder result, as dispatched by
+ * ostree_repo_pull_from_remotes_async().  When independent ref sets resolve
+ * to different sources the jobs run on worker threads, each with its own
+ * thread-default main context; everything the pulls share — the inherited
+ * transaction, object existence checks, ref updates, progress reporting —
+ * is already mutex-protected, and objects written by one pull are seen by
+ * the others' existence checks, so shared objects are fetched only once.
+ */
+typedef struct
+{
+  OstreeRepo *repo;                     /* (unowned) */
+  const OstreeRepoFinderResult *result; /* (unowned) */
+  gsize result_index;
+  GPtrArray *refs_to_pull; /* (element-type OstreeCollectionRef) (unowned refs), NULL-terminated */
+  GVariant *local_options;
+  OstreeAsyncProgress *progress; /* (unowned) (nullable) */
+  GCancellable *cancellable;     /* (unowned) (nullable) */
+  gboolean remove_remote_after;
+  GError *error;
+} PullFromRemotesJob;
+
+static void
+pull_from_remotes_job_free (PullFromRemotesJob *job)
+{
+  g_clear_pointer (&job->refs_to_pull, g_ptr_array_unref);
+  g_clear_pointer (&job->local_options, g_variant_unref);
+  g_clear_error (&job->error);
+  g_free (job);
+}
+
+static gpointer
+pull_from_remotes_job_thread (gpointer data)
+{
+  PullFromRemotesJob *job = data;
+
+  g_autoptr (GMainContextPopDefault) mainctx = _ostree_main_context_new_default ();
+  ostree_repo_pull_with_options (job->repo, job->result->remote->name, job->local_options,
+                                 job->progress, job->cancellable, &job->error);
+  return NULL;
+}
+
+/* Select the refs result @i should pull — those its ref_to_checksum map has
+ * the latest checksum for and which aren't flagged in @refs_exclude — and
+ * build the pull options for them.  Selected refs are flagged in
+ * @refs_exclude so later results don't pick them up again.  Returns %NULL
+ * if this result has nothing to contribute.
+ */
+static PullFromRemotesJob *
+build_pull_from_remotes_job (OstreeRepo *self, const OstreeRepoFinderResult *const *results,
+                             gsize i, GHashTable *refs_exclude, GVariantDict *options_dict,
+                             OstreeRepoPullFlags flags, OstreeAsyncProgress *progress,
+                             GCancellable *cancellable)
+{
+  const OstreeRepoFinderResult *result = results[i];
+  gsize j;
+
+  g_autoptr (GPtrArray) refs_to_pull = g_ptr_array_new_with_free_func (NULL);
+  g_autoptr (GString) refs_to_pull_str = g_string_new ("");
+  g_auto (GVariantBuilder) refs_to_pull_builder = OT_VARIANT_BUILDER_INITIALIZER;
+  g_variant_builder_init (&refs_to_pull_builder, G_VARIANT_TYPE ("a(sss)"));
+
+  GLNX_HASH_TABLE_FOREACH_KV (result->ref_to_checksum, const OstreeCollectionRef *, ref,
+                              const char *, checksum)
+    {
+      if (checksum != NULL && !GPOINTER_TO_INT (g_hash_table_lookup (refs_exclude, ref)))
+        {
+          g_ptr_array_add (refs_to_pull, (gpointer)ref);
+          g_variant_builder_add (&refs_to_pull_builder, "(sss)", ref->collection_id, ref->ref_name,
+                                 checksum);
+
+          if (refs_to_pull_str->len > 0)
+            g_string_append (refs_to_pull_str, ", ");
+          g_string_append_printf (refs_to_pull_str, "(%s, %s)", ref->collection_id, ref->ref_name);
+        }
+    }
+
+  if (refs_to_pull->len == 0)
+    {
+      g_debug ("Ignoring remote ‘%s’ as it has no relevant refs or they "
+               "have already been pulled.",
+               result->remote->name);
+      return NULL;
+    }
+
+  for (j = 0; j < refs_to_pull->len; j++)
+    g_hash_table_replace (refs_exclude, refs_to_pull->pdata[j], GINT_TO_POINTER (TRUE));
+
+  /* NULL terminator. */
+  g_ptr_array_add (refs_to_pull, NULL);
+
+  g_debug ("Pulling from remote ‘%s’: %s", result->remote->name, refs_to_pull_str->str);
+
+  /* Find the other viable peers: any other result which advertises
+   * identical checksums for everything we're about to pull is an
+   * equivalent source, and the pull can stripe object fetches across all
+   * of them to aggregate their bandwidth rather than draining one peer at
+   * a time.
+   */
+  g_auto (GStrv) extra_sources = NULL;
+  {
+    g_autoptr (GPtrArray) extra = g_ptr_array_new_with_free_func (g_free);
+    for (j = 0; results[j] != NULL; j++)
+      {
+        if (j == i)
+          continue;
+
+        gboolean equivalent = TRUE;
+        for (gsize k = 0; refs_to_pull->pdata[k] != NULL; k++)
+          {
+            const OstreeCollectionRef *ref = refs_to_pull->pdata[k];
+            const char *checksum = g_hash_table_lookup (result->ref_to_checksum, ref);
+            const char *other_checksum = g_hash_table_lookup (results[j]->ref_to_checksum, ref);
+            if (other_checksum == NULL || g_strcmp0 (checksum, other_checksum) != 0)
+              {
+                equivalent = FALSE;
+                break;
+              }
+          }
+        if (!equivalent)
+          continue;
+
+        g_autofree char *peer_url = g_key_file_get_string (
+            results[j]->remote->options, results[j]->remote->group, "url", NULL);
+        if (peer_url != NULL)
+          g_ptr_array_add (extra, g_steal_pointer (&peer_url));
+      }
+    if (extra->len > 0)
+      {
+        g_debug ("Striping content fetches across %u extra peer(s)", extra->len);
+        g_ptr_array_add (extra, NULL);
+        extra_sources = (GStrv)g_ptr_array_free (g_steal_pointer (&extra), FALSE);
+      }
+  }
+
+  /* Set up the pull options. */
+  g_auto (GVariantDict) local_options_dict = OT_VARIANT_BUILDER_INITIALIZER;
+  g_variant_dict_init (&local_options_dict, NULL);
+
+  g_variant_dict_insert (&local_options_dict, "flags", "i",
+                         OSTREE_REPO_PULL_FLAGS_UNTRUSTED | flags);
+  g_variant_dict_insert_value (&local_options_dict, "collection-refs",
+                               g_variant_builder_end (&refs_to_pull_builder));
+#ifndef OSTREE_DISABLE_GPGME
+  g_variant_dict_insert (&local_options_dict, "gpg-verify", "b", TRUE);
+#else
+  g_variant_dict_insert (&local_options_dict, "gpg-verify", "b", FALSE);
+#endif /* OSTREE_DISABLE_GPGME */
+  g_variant_dict_insert (&local_options_dict, "gpg-verify-summary", "b", FALSE);
+  g_variant_dict_insert (&local_options_dict, "sign-verify", "b", FALSE);
+  g_variant_dict_insert (&local_options_dict, "sign-verify-summary", "b", FALSE);
+  g_variant_dict_insert (&local_options_dict, "inherit-transaction", "b", TRUE);
+  if (result->remote->refspec_name != NULL)
+    g_variant_dict_insert (&local_options_dict, "override-remote-name", "s",
+                           result->remote->refspec_name);
+  copy_option (options_dict, &local_options_dict, "depth", G_VARIANT_TYPE ("i"));
+  copy_option (options_dict, &local_options_dict, "disable-static-deltas", G_VARIANT_TYPE ("b"));
+  copy_option (options_dict, &local_options_dict, "http-headers", G_VARIANT_TYPE ("a(ss)"));
+  copy_option (options_dict, &local_options_dict, "subdirs", G_VARIANT_TYPE ("as"));
+  copy_option (options_dict, &local_options_dict, "update-frequency", G_VARIANT_TYPE ("u"));
+  copy_option (options_dict, &local_options_dict, "append-user-agent", G_VARIANT_TYPE ("s"));
+  copy_option (options_dict, &local_options_dict, "limit-rate", G_VARIANT_TYPE ("t"));
+  copy_option (options_dict, &local_options_dict, "n-network-retries", G_VARIANT_TYPE ("u"));
+  copy_option (options_dict, &local_options_dict, "ref-keyring-map", G_VARIANT_TYPE ("a(sss)"));
+  if (extra_sources != NULL)
+    g_variant_dict_insert (&local_options_dict, "extra-content-sources", "^as", extra_sources);
+
+  PullFromRemotesJob *job = g_new0 (PullFromRemotesJob, 1);
+  job->repo = self;
+  job->result = result;
+  job->result_index = i;
+  job->refs_to_pull = g_steal_pointer (&refs_to_pull);
+  job->local_options = g_variant_ref_sink (g_variant_dict_end (&local_options_dict));
+  job->progress = progress;
+  job->cancellable = cancellable;
+  return job;
+}
+
 /**
  * ostree_repo_pull_from_remotes_async:
  * @self: an #OstreeRepo
@@ -6040,7 +8088,12 @@ copy_option (GVariantDict *master_options, GVariantDict *slave_options, const gc
  *
  * @results are expected to be in priority order, with the best remotes to pull
  * from listed first. ostree_repo_pull_from_remotes_async() will generally pull
- * from the remotes in order, but may parallelise its downloads.
+ * from the remotes in order, but may parallelise its downloads: refs are
+ * assigned to the best source advertising their latest commit and the
+ * resulting per-source pulls run concurrently, and when several results
+ * advertise identical checksums for the refs being pulled, object fetches are
+ * striped across all of those peers to aggregate their bandwidth.  Objects
+ * shared between concurrently pulled refs are only fetched once.
  *
  * If an error is encountered when pulling from a given remote, that remote will
  * be ignored and another will be tried instead. If any refs have not been
@@ -6066,6 +8119,8 @@ copy_option (GVariantDict *master_options, GVariantDict *slave_options, const gc
  *   * `update-frequency` (`u`): Frequency to call the async progress callback in
  *     milliseconds, if any; only values higher than 0 are valid
  *   * `append-user-agent` (`s`): Additional string to append to the user agent
+ *   * `limit-rate` (`t`): Cap the aggregate download rate at this many bytes per
+ *     second; 0 means unlimited
  *   * `n-network-retries` (`u`): Number of times to retry each download on receiving
  *     a transient network error, such as a socket timeout; default is 5, 0
  *     means return errors without retrying. Since: 2018.6
@@ -6125,117 +8180,125 @@ ostree_repo_pull_from_remotes_async (OstreeRepo *self, const OstreeRepoFinderRes
       return;
     }
 
-  /* FIXME: Rework this code to pull in parallel where possible. At the moment
-   * we expect the (i == 0) iteration will do all the work (all the refs) and
-   * subsequent iterations are only there in case of error.
-   *
-   * The code is currently all synchronous, too. Making it asynchronous requires
-   * the underlying pull code to be asynchronous. */
-  for (i = 0; results[i] != NULL; i++)
+  /* Phase 1: walk the results in priority order assigning each ref to the
+   * first result that advertises its latest checksum, producing one pull
+   * job per contributing result.  On a fully successful run this matches
+   * what a sequential walk would pull; building the assignment up front
+   * lets independent ref sets be pulled from different sources
+   * concurrently instead of draining the sources one at a time.
+   */
+  g_autoptr (GPtrArray) jobs
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)pull_from_remotes_job_free);
+  {
+    g_autoptr (GHashTable) refs_assigned = g_hash_table_new_full (
+        ostree_collection_ref_hash, ostree_collection_ref_equal, NULL, NULL);
+    for (i = 0; results[i] != NULL; i++)
+      {
+        PullFromRemotesJob *job = build_pull_from_remotes_job (
+            self, results, i, refs_assigned, &options_dict, flags, progress, cancellable);
+        if (job != NULL)
+          g_ptr_array_add (jobs, job);
+      }
+  }
+
+  gsize n_results = 0;
+  while (results[n_results] != NULL)
+    n_results++;
+  g_autofree gboolean *attempted = g_new0 (gboolean, MAX (n_results, 1));
+
+  /* Phase 2: launch.  The common case of a single source covering every
+   * ref runs inline; with multiple sources, one worker thread per source.
+   */
+  const guint n_assigned_jobs = jobs->len;
+  if (n_assigned_jobs > 0)
     {
-      const OstreeRepoFinderResult *result = results[i];
+      for (i = 0; i < n_assigned_jobs; i++)
+        {
+          PullFromRemotesJob *job = jobs->pdata[i];
+          attempted[job->result_index] = TRUE;
+          job->remove_remote_after = !_ostree_repo_add_remote (self, job->result->remote);
+        }
 
-      g_autoptr (GString) refs_to_pull_str = NULL;
-      g_autoptr (GPtrArray) refs_to_pull = NULL; /* (element-type OstreeCollectionRef) */
-      g_auto (GVariantBuilder) refs_to_pull_builder = OT_VARIANT_BUILDER_INITIALIZER;
-      g_auto (GVariantDict) local_options_dict = OT_VARIANT_BUILDER_INITIALIZER;
-      g_autoptr (GVariant) local_options = NULL;
-      gboolean remove_remote;
+      if (n_assigned_jobs == 1)
+        (void)pull_from_remotes_job_thread (jobs->pdata[0]);
+      else
+        {
+          g_autoptr (GPtrArray) threads = g_ptr_array_new ();
+          for (i = 0; i < n_assigned_jobs; i++)
+            g_ptr_array_add (threads,
+                             g_thread_new ("pull-remotes", pull_from_remotes_job_thread,
+                                           jobs->pdata[i]));
+          for (i = 0; i < threads->len; i++)
+            g_thread_join (threads->pdata[i]);
+        }
 
-      refs_to_pull = g_ptr_array_new_with_free_func (NULL);
-      refs_to_pull_str = g_string_new ("");
-      g_variant_builder_init (&refs_to_pull_builder, G_VARIANT_TYPE ("a(sss)"));
+      for (i = 0; i < n_assigned_jobs; i++)
+        {
+          PullFromRemotesJob *job = jobs->pdata[i];
+          if (job->remove_remote_after)
+            _ostree_repo_remove_remote (self, job->result->remote);
+        }
 
-      GLNX_HASH_TABLE_FOREACH_KV (result->ref_to_checksum, const OstreeCollectionRef *, ref,
-                                  const char *, checksum)
+      for (i = 0; i < n_assigned_jobs; i++)
         {
-          if (checksum != NULL && !GPOINTER_TO_INT (g_hash_table_lookup (refs_pulled, ref)))
+          PullFromRemotesJob *job = jobs->pdata[i];
+
+          if (g_error_matches (job->error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
             {
-              g_ptr_array_add (refs_to_pull, (gpointer)ref);
-              g_variant_builder_add (&refs_to_pull_builder, "(sss)", ref->collection_id,
-                                     ref->ref_name, checksum);
-
-              if (refs_to_pull_str->len > 0)
-                g_string_append (refs_to_pull_str, ", ");
-              g_string_append_printf (refs_to_pull_str, "(%s, %s)", ref->collection_id,
-                                      ref->ref_name);
+              if (!inherit_transaction)
+                ostree_repo_abort_transaction (self, NULL, NULL);
+              g_task_return_error (task, g_steal_pointer (&job->error));
+              return;
             }
-        }
 
-      if (refs_to_pull->len == 0)
-        {
-          g_debug ("Ignoring remote ‘%s’ as it has no relevant refs or they "
-                   "have already been pulled.",
-                   result->remote->name);
-          continue;
+          for (j = 0; job->refs_to_pull->pdata[j] != NULL; j++)
+            g_hash_table_replace (refs_pulled, job->refs_to_pull->pdata[j],
+                                  GINT_TO_POINTER (job->error == NULL));
+
+          if (job->error != NULL)
+            g_debug ("Failed to pull refs from ‘%s’: %s", job->result->remote->name,
+                     job->error->message);
+          else
+            g_debug ("Pulled refs from ‘%s’.", job->result->remote->name);
         }
+    }
 
-      /* NULL terminators. */
-      g_ptr_array_add (refs_to_pull, NULL);
+  /* Phase 3: refs whose assigned pull failed are retried sequentially
+   * against the results not yet tried, in priority order. */
+  for (i = 0; results[i] != NULL; i++)
+    {
+      if (attempted[i])
+        continue;
 
-      g_debug ("Pulling from remote ‘%s’: %s", result->remote->name, refs_to_pull_str->str);
+      PullFromRemotesJob *job = build_pull_from_remotes_job (self, results, i, refs_pulled,
+                                                             &options_dict, flags, progress,
+                                                             cancellable);
+      if (job == NULL)
+        continue;
+      g_ptr_array_add (jobs, job);
 
-      /* Set up the pull options. */
-      g_variant_dict_init (&local_options_dict, NULL);
+      job->remove_remote_after = !_ostree_repo_add_remote (self, job->result->remote);
+      (void)pull_from_remotes_job_thread (job);
+      if (job->remove_remote_after)
+        _ostree_repo_remove_remote (self, job->result->remote);
 
-      g_variant_dict_insert (&local_options_dict, "flags", "i",
-                             OSTREE_REPO_PULL_FLAGS_UNTRUSTED | flags);
-      g_variant_dict_insert_value (&local_options_dict, "collection-refs",
-                                   g_variant_builder_end (&refs_to_pull_builder));
-#ifndef OSTREE_DISABLE_GPGME
-      g_variant_dict_insert (&local_options_dict, "gpg-verify", "b", TRUE);
-#else
-      g_variant_dict_insert (&local_options_dict, "gpg-verify", "b", FALSE);
-#endif /* OSTREE_DISABLE_GPGME */
-      g_variant_dict_insert (&local_options_dict, "gpg-verify-summary", "b", FALSE);
-      g_variant_dict_insert (&local_options_dict, "sign-verify", "b", FALSE);
-      g_variant_dict_insert (&local_options_dict, "sign-verify-summary", "b", FALSE);
-      g_variant_dict_insert (&local_options_dict, "inherit-transaction", "b", TRUE);
-      if (result->remote->refspec_name != NULL)
-        g_variant_dict_insert (&local_options_dict, "override-remote-name", "s",
-                               result->remote->refspec_name);
-      copy_option (&options_dict, &local_options_dict, "depth", G_VARIANT_TYPE ("i"));
-      copy_option (&options_dict, &local_options_dict, "disable-static-deltas",
-                   G_VARIANT_TYPE ("b"));
-      copy_option (&options_dict, &local_options_dict, "http-headers", G_VARIANT_TYPE ("a(ss)"));
-      copy_option (&options_dict, &local_options_dict, "subdirs", G_VARIANT_TYPE ("as"));
-      copy_option (&options_dict, &local_options_dict, "update-frequency", G_VARIANT_TYPE ("u"));
-      copy_option (&options_dict, &local_options_dict, "append-user-agent", G_VARIANT_TYPE ("s"));
-      copy_option (&options_dict, &local_options_dict, "n-network-retries", G_VARIANT_TYPE ("u"));
-      copy_option (&options_dict, &local_options_dict, "ref-keyring-map",
-                   G_VARIANT_TYPE ("a(sss)"));
-
-      local_options = g_variant_dict_end (&local_options_dict);
-
-      /* FIXME: We do nothing useful with @progress at the moment. */
-      remove_remote = !_ostree_repo_add_remote (self, result->remote);
-      ostree_repo_pull_with_options (self, result->remote->name, local_options, progress,
-                                     cancellable, &local_error);
-      if (remove_remote)
-        _ostree_repo_remove_remote (self, result->remote);
-
-      if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      if (g_error_matches (job->error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         {
           if (!inherit_transaction)
             ostree_repo_abort_transaction (self, NULL, NULL);
-          g_task_return_error (task, g_steal_pointer (&local_error));
+          g_task_return_error (task, g_steal_pointer (&job->error));
           return;
         }
 
-      for (j = 0; refs_to_pull->pdata[j] != NULL; j++)
-        g_hash_table_replace (refs_pulled, refs_to_pull->pdata[j],
-                              GINT_TO_POINTER (local_error == NULL));
+      for (j = 0; job->refs_to_pull->pdata[j] != NULL; j++)
+        g_hash_table_replace (refs_pulled, job->refs_to_pull->pdata[j],
+                              GINT_TO_POINTER (job->error == NULL));
 
-      if (local_error != NULL)
-        {
-          g_debug ("Failed to pull refs from ‘%s’: %s", result->remote->name, local_error->message);
-          g_clear_error (&local_error);
-          continue;
-        }
+      if (job->error != NULL)
+        g_debug ("Failed to pull refs from ‘%s’: %s", job->result->remote->name,
+                 job->error->message);
       else
-        {
-          g_debug ("Pulled refs from ‘%s’.", result->remote->name);
-        }
+        g_debug ("Pulled refs from ‘%s’.", job->result->remote->name);
     }
 
   /* Commit the transaction. */
@@ -6298,6 +8361,138 @@ ostree_repo_pull_from_remotes_finish (OstreeRepo *self, GAsyncResult *result, GE
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+/* How many summary deltas we'll chain through before giving up and doing a
+ * full fetch; matches how much history the server side retains.
+ */
+#define SUMMARY_DELTA_MAX_HOPS 5
+
+struct summary_bspatch_opaque_s
+{
+  const guint8 *data;
+  gsize len;
+  gsize offset;
+};
+
+static int
+summary_bspatch_read (const struct bspatch_stream *stream, void *buffer, int length)
+{
+  struct summary_bspatch_opaque_s *opaque = stream->opaque;
+
+  if (length < 0 || (gsize)length > opaque->len - opaque->offset)
+    return -1;
+  memcpy (buffer, opaque->data + opaque->offset, length);
+  opaque->offset += length;
+  return 0;
+}
+
+/* Try to reconstruct the remote's current summary from the cached one by
+ * walking the digest chain of binary diffs the server publishes under
+ * summary.delta/ (see write_summary_delta() in ostree-repo.c).  Each hop
+ * fetches summary.delta/<sha256-of-what-we-have>, applies the bsdiff
+ * payload, and verifies the embedded digest of the result; a missing delta
+ * after at least one successful hop means we've reached the head.  This is
+ * purely an optimization: any failure returns %FALSE (no error) and the
+ * caller falls back to fetching the full summary.  The result still passes
+ * through the same signature verification as a directly fetched summary.
+ */
+static gboolean
+fetch_summary_via_deltas (OstreeRepo *self, const char *name, OstreeFetcher *fetcher,
+                          GPtrArray *mirrorlist, guint n_network_retries, GBytes **out_summary,
+                          GCancellable *cancellable)
+{
+  g_autoptr (GBytes) current = NULL;
+
+  if (!_ostree_repo_load_cache_summary_file (self, name, NULL, &current, cancellable, NULL))
+    return FALSE;
+  if (current == NULL)
+    return FALSE;
+
+  guint n_applied = 0;
+  for (guint hop = 0; hop < SUMMARY_DELTA_MAX_HOPS; hop++)
+    {
+      g_autofree char *digest = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, current);
+      g_autofree char *delta_name = g_strdup_printf (_OSTREE_SUMMARY_DELTA_DIR "/%s", digest);
+      g_autoptr (GBytes) delta_bytes = NULL;
+      g_autoptr (GError) local_error = NULL;
+
+      if (!_ostree_preload_metadata_file (self, fetcher, mirrorlist, delta_name, FALSE, NULL, 0,
+                                          n_network_retries, &delta_bytes, NULL, NULL, NULL,
+                                          cancellable, &local_error))
+        {
+          g_debug ("Fetching %s failed: %s", delta_name, local_error->message);
+          return FALSE;
+        }
+
+      if (delta_bytes == NULL)
+        {
+          /* No delta from our version.  If we already applied some, there's
+           * simply nothing newer than what we have now; otherwise we're too
+           * far behind (the delta was pruned) or the server doesn't publish
+           * deltas at all.
+           */
+          if (n_applied == 0)
+            return FALSE;
+          break;
+        }
+
+      g_autoptr (GVariant) delta = g_variant_ref_sink (g_variant_new_from_bytes (
+          G_VARIANT_TYPE (OSTREE_SUMMARY_DELTA_GVARIANT_STRING), delta_bytes, FALSE));
+      const char *to_digest = NULL;
+      guint64 to_size;
+      g_autoptr (GVariant) payload_v = NULL;
+      g_variant_get (delta, "(&st@ay)", &to_digest, &to_size, &payload_v);
+      to_size = GUINT64_FROM_BE (to_size);
+
+      if (to_size == 0 || to_size > OSTREE_MAX_METADATA_SIZE)
+        {
+          g_debug ("Ignoring %s with invalid target size %" G_GUINT64_FORMAT, delta_name, to_size);
+          return FALSE;
+        }
+
+      gsize payload_len;
+      const guint8 *payload = g_variant_get_fixed_array (payload_v, &payload_len, 1);
+      gsize current_len;
+      const guint8 *current_buf = g_bytes_get_data (current, &current_len);
+
+      g_autofree guint8 *patched_buf = g_malloc0 (to_size);
+      struct summary_bspatch_opaque_s opaque;
+      opaque.data = payload;
+      opaque.len = payload_len;
+      opaque.offset = 0;
+      struct bspatch_stream stream;
+      stream.read = summary_bspatch_read;
+      stream.opaque = &opaque;
+      if (bspatch (current_buf, current_len, patched_buf, to_size, &stream) < 0)
+        {
+          g_debug ("Applying %s failed", delta_name);
+          return FALSE;
+        }
+
+      g_autoptr (GBytes) patched = g_bytes_new_take (g_steal_pointer (&patched_buf), to_size);
+      g_autofree char *actual_digest = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, patched);
+      if (!g_str_equal (actual_digest, to_digest))
+        {
+          g_debug ("Applying %s yielded digest %s, expected %s", delta_name, actual_digest,
+                   to_digest);
+          return FALSE;
+        }
+
+      g_clear_pointer (&current, g_bytes_unref);
+      current = g_steal_pointer (&patched);
+      n_applied++;
+    }
+
+  /* Exhausting the hop limit without hitting the end of the chain means we
+   * can't tell whether we reached the head; let the caller fetch in full.
+   */
+  if (n_applied == SUMMARY_DELTA_MAX_HOPS)
+    return FALSE;
+
+  g_debug ("Reconstructed summary for remote %s from %u delta(s)", name, n_applied);
+  *out_summary = g_steal_pointer (&current);
+  return TRUE;
+}
+
 /**
  * ostree_repo_remote_fetch_summary_with_options:
  * @self: Self
@@ -6335,6 +8530,7 @@ ostree_repo_remote_fetch_summary_with_options (OstreeRepo *self, const char *nam
   gboolean gpg_verify_summary;
   g_autoptr (GPtrArray) signapi_summary_verifiers = NULL;
   gboolean summary_is_from_cache = FALSE;
+  gboolean summary_is_from_delta = FALSE;
   g_autoptr (OstreeFetcher) fetcher = NULL;
   g_autoptr (GMainContextPopDefault) mainctx = NULL;
   const char *url_override = NULL;
@@ -6437,27 +8633,73 @@ ostree_repo_remote_fetch_summary_with_options (OstreeRepo *self, const char *nam
     summary_is_from_cache = TRUE;
   else
     {
-      if (!_ostree_preload_metadata_file (
-              self, fetcher, mirrorlist, "summary", metalink_url_string ? TRUE : FALSE,
-              summary_if_none_match, summary_if_modified_since, n_network_retries, &summary,
-              &summary_not_modified, &summary_etag, &summary_last_modified, cancellable, error))
-        return FALSE;
+      /* The summary changed.  If we have the previous version cached, first
+       * try walking the digest chain of binary diffs the server may publish;
+       * each hop is typically a few kilobytes against a summary of many
+       * megabytes.  (The metalink only describes the summary file itself, so
+       * the delta path doesn't apply there.)
+       */
+      if (metalink_url_string == NULL)
+        {
+          g_autoptr (GBytes) delta_summary = NULL;
+          if (fetch_summary_via_deltas (self, name, fetcher, mirrorlist, n_network_retries,
+                                        &delta_summary, cancellable))
+            {
+              summary = g_steal_pointer (&delta_summary);
+              summary_is_from_delta = TRUE;
+            }
+        }
 
-      /* The server returned HTTP status 304 Not Modified, so we’re clear to
-       * load summary.sig from the cache. Also load summary, since
-       * `_ostree_repo_load_cache_summary_if_same_sig()` would just do that anyway. */
-      if (summary_not_modified)
+      if (summary == NULL)
         {
-          g_clear_pointer (&summary, g_bytes_unref);
-          if (!_ostree_repo_load_cache_summary_file (self, name, NULL, &summary, cancellable,
-                                                     error))
+          if (!_ostree_preload_metadata_file (
+                  self, fetcher, mirrorlist, "summary", metalink_url_string ? TRUE : FALSE,
+                  summary_if_none_match, summary_if_modified_since, n_network_retries, &summary,
+                  &summary_not_modified, &summary_etag, &summary_last_modified, cancellable, error))
             return FALSE;
+
+          /* The server returned HTTP status 304 Not Modified, so we’re clear to
+           * load summary.sig from the cache. Also load summary, since
+           * `_ostree_repo_load_cache_summary_if_same_sig()` would just do that anyway. */
+          if (summary_not_modified)
+            {
+              g_clear_pointer (&summary, g_bytes_unref);
+              if (!_ostree_repo_load_cache_summary_file (self, name, NULL, &summary, cancellable,
+                                                         error))
+                return FALSE;
+            }
         }
     }
 
-  if (!_ostree_repo_verify_summary (self, name, gpg_verify_summary, signapi_summary_verifiers,
-                                    summary, signatures, cancellable, error))
-    return FALSE;
+  {
+    g_autoptr (GError) verify_error = NULL;
+    if (!_ostree_repo_verify_summary (self, name, gpg_verify_summary, signapi_summary_verifiers,
+                                      summary, signatures, cancellable,
+                                      summary_is_from_delta ? &verify_error : error))
+      {
+        if (!summary_is_from_delta)
+          return FALSE;
+
+        /* A stale delta chain (e.g. a CDN still propagating the newest
+         * delta) reconstructs an older summary whose signature no longer
+         * matches; retry with a full fetch rather than failing.
+         */
+        g_debug ("Summary reconstructed from deltas failed verification (%s); refetching in full",
+                 verify_error->message);
+        summary_is_from_delta = FALSE;
+        g_clear_pointer (&summary, g_bytes_unref);
+        if (!_ostree_preload_metadata_file (self, fetcher, mirrorlist, "summary", FALSE, NULL, 0,
+                                            n_network_retries, &summary, &summary_not_modified,
+                                            &summary_etag, &summary_last_modified, cancellable,
+                                            error))
+          return FALSE;
+
+        if (!_ostree_repo_verify_summary (self, name, gpg_verify_summary,
+                                          signapi_summary_verifiers, summary, signatures,
+                                          cancellable, error))
+          return FALSE;
+      }
+  }
 
   if (!summary_is_from_cache && summary && signatures)
     {
@@ -19,6 +19,9 @@
 
 #include "config.h"
 
+#include <sys/file.h>
+
+#include "ostree-autocleanups.h"
 #include "ostree-core-private.h"
 #include "ostree-repo-private.h"
 #include "ot-fs-utils.h"
@@ -60,10 +63,396 @@ add_ref_to_set (const char *remote, const char *collection_id, int base_fd, cons
   return TRUE;
 }
 
+/* Packed refs
+ *
+ * With many thousands of refs, enumerating refs/heads recursively costs one
+ * open/read per ref file, which dominates summary generation and pulls.  The
+ * optional packed-refs index — the git packed-refs idea — is a single file
+ * in the repository root holding a GVariant of type (ua(ss)): a format
+ * version, then an array of (refname, checksum) pairs sorted by refname so
+ * lookups can binary search.  Only local refs (refs/heads) are packed.
+ *
+ * Loose refs always take precedence over the index; _ostree_repo_pack_refs()
+ * consolidates the current refs into the index and removes the loose files
+ * (keeping ref aliases and their targets loose so the symlinks stay
+ * resolvable), and ref writes below keep the index from contradicting the
+ * loose state.
+ */
+
+#define PACKED_REFS_VERSION 1
+
+void
+_ostree_repo_packed_refs_clear (OstreeRepo *self)
+{
+  g_clear_pointer (&self->packed_refs, g_variant_unref);
+  self->packed_refs_initialized = FALSE;
+}
+
+/* Get a reference to the packed-refs index, lazily loading it; sets
+ * @out_packed_refs to %NULL (without error) if the repository has none.
+ */
+static gboolean
+packed_refs_get (OstreeRepo *self, GVariant **out_packed_refs, GError **error)
+{
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&self->packed_refs_lock);
+  if (!self->packed_refs_initialized)
+    {
+      glnx_autofd int fd = -1;
+      if (!ot_openat_ignore_enoent (self->repo_dir_fd, _OSTREE_PACKED_REFS_PATH, &fd, error))
+        goto out;
+      if (fd != -1)
+        {
+          g_autoptr (GVariant) packed = NULL;
+          if (!ot_variant_read_fd (fd, 0, G_VARIANT_TYPE (OSTREE_PACKED_REFS_GVARIANT_STRING),
+                                   FALSE, &packed, error))
+            {
+              glnx_prefix_error (error, "Reading packed-refs");
+              goto out;
+            }
+
+          guint32 version;
+          g_variant_get_child (packed, 0, "u", &version);
+          if (version != PACKED_REFS_VERSION)
+            {
+              glnx_throw (error, "Unsupported packed-refs version %u", version);
+              goto out;
+            }
+
+          self->packed_refs = g_steal_pointer (&packed);
+        }
+      self->packed_refs_initialized = TRUE;
+    }
+
+  *out_packed_refs = self->packed_refs ? g_variant_ref (self->packed_refs) : NULL;
+  ret = TRUE;
+out:
+  g_mutex_unlock (&self->packed_refs_lock);
+  return ret;
+}
+
+/* Binary search the packed-refs index for @refname; sets @out_rev to %NULL
+ * (without error) if it isn't packed.
+ */
+static gboolean
+packed_refs_lookup (OstreeRepo *self, const char *refname, char **out_rev, GError **error)
+{
+  *out_rev = NULL;
+
+  g_autoptr (GVariant) packed = NULL;
+  if (!packed_refs_get (self, &packed, error))
+    return FALSE;
+  if (packed == NULL)
+    return TRUE;
+
+  g_autoptr (GVariant) entries = g_variant_get_child_value (packed, 1);
+  gsize imin = 0;
+  gsize imax = g_variant_n_children (entries);
+
+  while (imin < imax)
+    {
+      gsize imid = imin + (imax - imin) / 2;
+      const char *entry_name;
+      const char *entry_rev;
+      g_variant_get_child (entries, imid, "(&s&s)", &entry_name, &entry_rev);
+
+      int c = strcmp (entry_name, refname);
+      if (c == 0)
+        {
+          if (!ostree_validate_checksum_string (entry_rev, error))
+            return glnx_prefix_error (error, "Parsing packed-refs entry for %s", refname);
+          *out_rev = g_strdup (entry_rev);
+          return TRUE;
+        }
+      if (c < 0)
+        imin = imid + 1;
+      else
+        imax = imid;
+    }
+
+  return TRUE;
+}
+
+/* Add the packed-refs entries not shadowed by a loose ref to @refs,
+ * following the prefix and key conventions of the loose enumeration in
+ * _ostree_repo_list_refs_internal().  As there, @collection_id selects
+ * between OstreeCollectionRef and refspec keys.
+ */
+static gboolean
+merge_packed_refs (OstreeRepo *self, const char *ref_prefix, gboolean cut_prefix,
+                   const char *collection_id, GHashTable *refs, GError **error)
+{
+  g_autoptr (GVariant) packed = NULL;
+  if (!packed_refs_get (self, &packed, error))
+    return FALSE;
+  if (packed == NULL)
+    return TRUE;
+
+  g_autoptr (GVariant) entries = g_variant_get_child_value (packed, 1);
+  gsize n = g_variant_n_children (entries);
+  for (gsize i = 0; i < n; i++)
+    {
+      const char *refname;
+      const char *rev;
+      g_variant_get_child (entries, i, "(&s&s)", &refname, &rev);
+
+      const char *key = refname;
+      if (ref_prefix != NULL && strcmp (refname, ref_prefix) != 0)
+        {
+          if (!(g_str_has_prefix (refname, ref_prefix) && refname[strlen (ref_prefix)] == '/'))
+            continue;
+          if (cut_prefix)
+            key = refname + strlen (ref_prefix) + 1;
+        }
+
+      if (collection_id != NULL)
+        {
+          g_autoptr (OstreeCollectionRef) ref = ostree_collection_ref_new (collection_id, key);
+          if (g_hash_table_contains (refs, ref))
+            continue;
+          g_hash_table_insert (refs, g_steal_pointer (&ref), g_strdup (rev));
+        }
+      else
+        {
+          if (g_hash_table_contains (refs, key))
+            continue;
+          g_hash_table_insert (refs, g_strdup (key), g_strdup (rev));
+        }
+    }
+
+  return TRUE;
+}
+
+/* If the packed-refs index contains @refname, atomically rewrite it with the
+ * entry updated to @rev — or removed, if @rev is %NULL — so the index never
+ * contradicts the loose refs.  Refs not in the index stay loose until the
+ * next _ostree_repo_pack_refs().
+ */
+static gboolean
+packed_refs_update (OstreeRepo *self, const char *refname, const char *rev,
+                    GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GVariant) packed = NULL;
+  if (!packed_refs_get (self, &packed, error))
+    return FALSE;
+  if (packed == NULL)
+    return TRUE;
+
+  g_autoptr (GVariant) entries = g_variant_get_child_value (packed, 1);
+  gsize n = g_variant_n_children (entries);
+  gboolean found = FALSE;
+  g_autoptr (GVariantBuilder) builder = g_variant_builder_new (G_VARIANT_TYPE ("a(ss)"));
+
+  for (gsize i = 0; i < n; i++)
+    {
+      const char *entry_name;
+      const char *entry_rev;
+      g_variant_get_child (entries, i, "(&s&s)", &entry_name, &entry_rev);
+
+      if (strcmp (entry_name, refname) == 0)
+        {
+          found = TRUE;
+          if (g_strcmp0 (entry_rev, rev) == 0)
+            return TRUE; /* Already current */
+          if (rev != NULL)
+            g_variant_builder_add (builder, "(ss)", entry_name, rev);
+          continue;
+        }
+
+      g_variant_builder_add (builder, "(ss)", entry_name, entry_rev);
+    }
+
+  if (!found)
+    return TRUE;
+
+  g_autoptr (GVariant) new_packed = g_variant_ref_sink (
+      g_variant_new (OSTREE_PACKED_REFS_GVARIANT_STRING, (guint32)PACKED_REFS_VERSION, builder));
+  if (!_ostree_repo_file_replace_contents (self, self->repo_dir_fd, _OSTREE_PACKED_REFS_PATH,
+                                           g_variant_get_data (new_packed),
+                                           g_variant_get_size (new_packed), cancellable, error))
+    return FALSE;
+
+  g_mutex_lock (&self->packed_refs_lock);
+  _ostree_repo_packed_refs_clear (self);
+  g_mutex_unlock (&self->packed_refs_lock);
+  return TRUE;
+}
+
+/* Bulk variant of packed_refs_update(): apply every entry of @updates
+ * (refname ↦ rev, where a %NULL rev means removal) to the index in a single
+ * rewrite, so a transaction touching thousands of refs doesn't rewrite the
+ * index once per ref.
+ */
+static gboolean
+packed_refs_update_many (OstreeRepo *self, GHashTable *updates, GCancellable *cancellable,
+                         GError **error)
+{
+  if (g_hash_table_size (updates) == 0)
+    return TRUE;
+
+  g_autoptr (GVariant) packed = NULL;
+  if (!packed_refs_get (self, &packed, error))
+    return FALSE;
+  if (packed == NULL)
+    return TRUE;
+
+  g_autoptr (GVariant) entries = g_variant_get_child_value (packed, 1);
+  gsize n = g_variant_n_children (entries);
+  gboolean changed = FALSE;
+  g_autoptr (GVariantBuilder) builder = g_variant_builder_new (G_VARIANT_TYPE ("a(ss)"));
+
+  for (gsize i = 0; i < n; i++)
+    {
+      const char *entry_name;
+      const char *entry_rev;
+      g_variant_get_child (entries, i, "(&s&s)", &entry_name, &entry_rev);
+
+      gpointer new_rev = NULL;
+      if (g_hash_table_lookup_extended (updates, entry_name, NULL, &new_rev))
+        {
+          if (new_rev == NULL)
+            {
+              changed = TRUE;
+              continue;
+            }
+          if (strcmp (entry_rev, (const char *)new_rev) != 0)
+            changed = TRUE;
+          g_variant_builder_add (builder, "(ss)", entry_name, (const char *)new_rev);
+          continue;
+        }
+
+      g_variant_builder_add (builder, "(ss)", entry_name, entry_rev);
+    }
+
+  if (!changed)
+    return TRUE;
+
+  g_autoptr (GVariant) new_packed = g_variant_ref_sink (
+      g_variant_new (OSTREE_PACKED_REFS_GVARIANT_STRING, (guint32)PACKED_REFS_VERSION, builder));
+  if (!_ostree_repo_file_replace_contents (self, self->repo_dir_fd, _OSTREE_PACKED_REFS_PATH,
+                                           g_variant_get_data (new_packed),
+                                           g_variant_get_size (new_packed), cancellable, error))
+    return FALSE;
+
+  g_mutex_lock (&self->packed_refs_lock);
+  _ostree_repo_packed_refs_clear (self);
+  g_mutex_unlock (&self->packed_refs_lock);
+  return TRUE;
+}
+
+/* Take the cross-process lock serializing writers of the shared ref state:
+ * loose refs, the packed-refs index, and the files derived from the refs
+ * (the summary and the commit-graph).  Object writes stay under the shared
+ * repo lock, so concurrent transactions against disjoint branches only
+ * serialize for this short window.  A dedicated lock file is used rather
+ * than upgrading the repo lock to exclusive, since two holders of a shared
+ * flock that both try to upgrade can never succeed.
+ *
+ * Release via glnx_release_lock_file(); a no-op for read-only repos.
+ */
+gboolean
+_ostree_repo_refs_lock (OstreeRepo *self, GLnxLockFile *out_lock, GError **error)
+{
+  if (!self->writable)
+    return TRUE;
+  return glnx_make_lock_file (self->repo_dir_fd, _OSTREE_REFS_LOCK_PATH, LOCK_EX, out_lock, error);
+}
+
+static int
+strptr_compare (gconstpointer a, gconstpointer b)
+{
+  return strcmp (*(const char *const *)a, *(const char *const *)b);
+}
+
+/* Consolidate the current local refs into the packed-refs index, then remove
+ * the now-redundant loose ref files.  Ref aliases and their targets are kept
+ * loose so the alias symlinks stay resolvable.
+ */
+gboolean
+_ostree_repo_pack_refs (OstreeRepo *self, GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GHashTable) refs = NULL;
+  if (!ostree_repo_list_refs_ext (self, NULL, &refs,
+                                  OSTREE_REPO_LIST_REFS_EXT_EXCLUDE_REMOTES
+                                      | OSTREE_REPO_LIST_REFS_EXT_EXCLUDE_MIRRORS,
+                                  cancellable, error))
+    return FALSE;
+
+  g_autoptr (GHashTable) aliases = NULL;
+  if (!ostree_repo_list_refs_ext (self, NULL, &aliases,
+                                  OSTREE_REPO_LIST_REFS_EXT_ALIASES
+                                      | OSTREE_REPO_LIST_REFS_EXT_EXCLUDE_REMOTES
+                                      | OSTREE_REPO_LIST_REFS_EXT_EXCLUDE_MIRRORS,
+                                  cancellable, error))
+    return FALSE;
+
+  /* Aliases (and hence their frozen values) don't belong in the index */
+  g_autoptr (GPtrArray) sorted_refs = g_ptr_array_new ();
+  GLNX_HASH_TABLE_FOREACH (refs, const char *, refname)
+    {
+      if (g_hash_table_contains (aliases, refname))
+        continue;
+      g_ptr_array_add (sorted_refs, (char *)refname);
+    }
+  g_ptr_array_sort (sorted_refs, strptr_compare);
+
+  g_autoptr (GVariantBuilder) builder = g_variant_builder_new (G_VARIANT_TYPE ("a(ss)"));
+  for (guint i = 0; i < sorted_refs->len; i++)
+    {
+      const char *refname = sorted_refs->pdata[i];
+      g_variant_builder_add (builder, "(ss)", refname, g_hash_table_lookup (refs, refname));
+    }
+
+  g_autoptr (GVariant) new_packed = g_variant_ref_sink (
+      g_variant_new (OSTREE_PACKED_REFS_GVARIANT_STRING, (guint32)PACKED_REFS_VERSION, builder));
+  if (!_ostree_repo_file_replace_contents (self, self->repo_dir_fd, _OSTREE_PACKED_REFS_PATH,
+                                           g_variant_get_data (new_packed),
+                                           g_variant_get_size (new_packed), cancellable, error))
+    return FALSE;
+
+  g_mutex_lock (&self->packed_refs_lock);
+  _ostree_repo_packed_refs_clear (self);
+  g_mutex_unlock (&self->packed_refs_lock);
+
+  /* The loose copies are now redundant, except for alias symlinks and their
+   * targets, which must keep resolving through the filesystem.
+   */
+  g_autoptr (GHashTable) keep_loose = g_hash_table_new (g_str_hash, g_str_equal);
+  GLNX_HASH_TABLE_FOREACH_KV (aliases, const char *, name, const char *, target)
+    {
+      g_hash_table_add (keep_loose, (char *)name);
+      g_hash_table_add (keep_loose, (char *)target);
+    }
+
+  glnx_autofd int refs_heads_dfd = -1;
+  if (!glnx_opendirat (self->repo_dir_fd, "refs/heads", TRUE, &refs_heads_dfd, error))
+    return FALSE;
+
+  for (guint i = 0; i < sorted_refs->len; i++)
+    {
+      const char *refname = sorted_refs->pdata[i];
+      if (g_hash_table_contains (keep_loose, refname))
+        continue;
+      if (!ot_ensure_unlinked_at (refs_heads_dfd, refname, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Write a loose ref file.  @datasync may be %FALSE when the caller batches
+ * many ref writes and issues a single barrier afterwards, instead of paying
+ * an fdatasync() per ref.
+ */
 static gboolean
 write_checksum_file_at (OstreeRepo *self, int dfd, const char *name, const char *sha256,
-                        GCancellable *cancellable, GError **error)
+                        gboolean datasync, GCancellable *cancellable, GError **error)
 {
+  GLnxFileReplaceFlags replace_flags = (datasync && !self->disable_fsync)
+                                           ? GLNX_FILE_REPLACE_DATASYNC_NEW
+                                           : GLNX_FILE_REPLACE_NODATASYNC;
+
   if (!ostree_validate_checksum_string (sha256, error))
     return FALSE;
 
@@ -93,8 +482,8 @@ write_checksum_file_at (OstreeRepo *self, int dfd, const char *name, const char
     bufnl[l] = '\n';
     bufnl[l + 1] = '\0';
 
-    if (!_ostree_repo_file_replace_contents (self, dfd, name, (guint8 *)bufnl, l + 1, cancellable,
-                                             &temp_error))
+    if (!glnx_file_replace_contents_at (dfd, name, (guint8 *)bufnl, l + 1, replace_flags,
+                                        cancellable, &temp_error))
       {
         if (g_error_matches (temp_error, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY))
           {
@@ -121,8 +510,8 @@ write_checksum_file_at (OstreeRepo *self, int dfd, const char *name, const char
             if (!glnx_shutil_rm_rf_at (dfd, name, cancellable, error))
               return FALSE;
 
-            if (!_ostree_repo_file_replace_contents (self, dfd, name, (guint8 *)bufnl, l + 1,
-                                                     cancellable, error))
+            if (!glnx_file_replace_contents_at (dfd, name, (guint8 *)bufnl, l + 1, replace_flags,
+                                                cancellable, error))
               return FALSE;
           }
         else
@@ -253,7 +642,14 @@ resolve_refspec (OstreeRepo *self, const char *remote, const char *ref, gboolean
       if (!ot_openat_ignore_enoent (self->repo_dir_fd, local_ref, &target_fd, error))
         return FALSE;
 
-      if (target_fd == -1 && fallback_remote)
+      /* Loose refs take precedence over the packed-refs index */
+      if (target_fd == -1)
+        {
+          if (!packed_refs_lookup (self, ref, &ret_rev, error))
+            return FALSE;
+        }
+
+      if (target_fd == -1 && ret_rev == NULL && fallback_remote)
         {
           local_ref = glnx_strjoina ("refs/remotes/", ref);
 
@@ -281,7 +677,7 @@ resolve_refspec (OstreeRepo *self, const char *remote, const char *ref, gboolean
       if (!ostree_validate_checksum_string (ret_rev, error))
         return FALSE;
     }
-  else
+  else if (ret_rev == NULL)
     {
       if (!resolve_refspec_fallback (self, remote, ref, allow_noent, fallback_remote, &ret_rev,
                                      cancellable, error))
@@ -377,7 +773,6 @@ _ostree_repo_resolve_rev_internal (OstreeRepo *self, const char *refspec, gboole
         {
           g_autofree char *parent_refspec = NULL;
           g_autofree char *parent_rev = NULL;
-          g_autoptr (GVariant) commit = NULL;
 
           parent_refspec = g_strdup (refspec);
           parent_refspec[strlen (parent_refspec) - 1] = '\0';
@@ -385,12 +780,39 @@ _ostree_repo_resolve_rev_internal (OstreeRepo *self, const char *refspec, gboole
           if (!ostree_repo_resolve_rev (self, parent_refspec, allow_noent, &parent_rev, error))
             return FALSE;
 
-          if (!ostree_repo_load_variant (self, OSTREE_OBJECT_TYPE_COMMIT, parent_rev, &commit,
-                                         error))
+          /* The commit-graph cache can answer this without loading the
+           * object, as long as the commit actually still exists.
+           */
+          gboolean graph_found = FALSE;
+          g_autofree char *graph_parent = NULL;
+          if (!_ostree_repo_commit_graph_lookup (self, parent_rev, &graph_found, &graph_parent,
+                                                 NULL, error))
             return FALSE;
+          if (graph_found)
+            {
+              gboolean have_commit = FALSE;
+              if (!ostree_repo_has_object (self, OSTREE_OBJECT_TYPE_COMMIT, parent_rev,
+                                           &have_commit, NULL, error))
+                return FALSE;
+              if (!have_commit)
+                graph_found = FALSE;
+            }
 
-          if (!(ret_rev = ostree_commit_get_parent (commit)))
-            return glnx_throw (error, "Commit %s has no parent", parent_rev);
+          if (graph_found)
+            {
+              if (!(ret_rev = g_steal_pointer (&graph_parent)))
+                return glnx_throw (error, "Commit %s has no parent", parent_rev);
+            }
+          else
+            {
+              g_autoptr (GVariant) commit = NULL;
+              if (!ostree_repo_load_variant (self, OSTREE_OBJECT_TYPE_COMMIT, parent_rev, &commit,
+                                             error))
+                return FALSE;
+
+              if (!(ret_rev = ostree_commit_get_parent (commit)))
+                return glnx_throw (error, "Commit %s has no parent", parent_rev);
+            }
         }
       else
         {
@@ -702,6 +1124,12 @@ _ostree_repo_list_refs_internal (OstreeRepo *self, gboolean cut_prefix,
                 return FALSE;
             }
         }
+
+      if (remote == NULL && !(flags & OSTREE_REPO_LIST_REFS_EXT_ALIASES))
+        {
+          if (!merge_packed_refs (self, ref_prefix, cut_prefix, NULL, ret_all_refs, error))
+            return FALSE;
+        }
     }
   else
     {
@@ -718,6 +1146,12 @@ _ostree_repo_list_refs_internal (OstreeRepo *self, gboolean cut_prefix,
                                    refs_heads_dfd, ".", ret_all_refs, cancellable, error))
         return FALSE;
 
+      if (!(flags & OSTREE_REPO_LIST_REFS_EXT_ALIASES))
+        {
+          if (!merge_packed_refs (self, NULL, FALSE, NULL, ret_all_refs, error))
+            return FALSE;
+        }
+
       if (!(flags & OSTREE_REPO_LIST_REFS_EXT_EXCLUDE_REMOTES))
         {
           g_string_truncate (base_path, 0);
@@ -987,6 +1421,240 @@ ostree_repo_remote_list_collection_refs (OstreeRepo *self, const char *remote_na
   return TRUE;
 }
 
+/* Reverse index mapping commit → refs whose history contains it, so that
+ * "which refs contain X" doesn't need to walk every ref's history.  The
+ * index lives in the cache directory and is maintained incrementally as
+ * refs are written: a fast-forward walks only the new commits, while a
+ * non-fast-forward re-walks just the one ref.  Consumers treat it as a
+ * hint scoped to the recorded ref heads — ostree_repo_list_refs_containing()
+ * falls back to walking any ref whose current head doesn't match the
+ * snapshot, so a stale or missing index is never wrong, just slower.
+ */
+#define REF_CONTAINMENT_INDEX_NAME "ref-containment-index"
+#define REF_CONTAINMENT_INDEX_VERSION 1
+#define REF_CONTAINMENT_INDEX_GVARIANT_STRING "(ua{ss}a{sas})"
+/* Refs with absurdly deep histories are dropped from the index rather than
+ * ballooning it; queries for those fall back to the walk.
+ */
+#define REF_CONTAINMENT_INDEX_MAX_DEPTH 65536
+
+/* Fill @heads (ref → head checksum at index time) and @containment
+ * (commit checksum → set of refs) from the persistent index file.
+ */
+static gboolean
+ref_containment_index_load (OstreeRepo *self, GHashTable *heads, GHashTable *containment,
+                            GCancellable *cancellable, GError **error)
+{
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (self->cache_dir_fd, REF_CONTAINMENT_INDEX_NAME, &fd, error))
+    return FALSE;
+  if (fd == -1)
+    return TRUE;
+
+  g_autoptr (GVariant) cache = NULL;
+  if (!ot_variant_read_fd (fd, 0, G_VARIANT_TYPE (REF_CONTAINMENT_INDEX_GVARIANT_STRING), FALSE,
+                           &cache, error))
+    return FALSE;
+
+  guint32 version;
+  g_autoptr (GVariant) heads_v = NULL;
+  g_autoptr (GVariant) entries_v = NULL;
+  g_variant_get (cache, "(u@a{ss}@a{sas})", &version, &heads_v, &entries_v);
+  if (version != REF_CONTAINMENT_INDEX_VERSION)
+    return TRUE;
+
+  GVariantIter heads_iter;
+  g_variant_iter_init (&heads_iter, heads_v);
+  const char *ref;
+  const char *head;
+  while (g_variant_iter_next (&heads_iter, "{&s&s}", &ref, &head))
+    g_hash_table_replace (heads, g_strdup (ref), g_strdup (head));
+
+  GVariantIter entries_iter;
+  g_variant_iter_init (&entries_iter, entries_v);
+  const char *commit;
+  GVariant *refs_v;
+  while (g_variant_iter_loop (&entries_iter, "{&s@as}", &commit, &refs_v))
+    {
+      GHashTable *set = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      gsize n = g_variant_n_children (refs_v);
+      for (gsize i = 0; i < n; i++)
+        {
+          const char *r;
+          g_variant_get_child (refs_v, i, "&s", &r);
+          g_hash_table_add (set, g_strdup (r));
+        }
+      g_hash_table_replace (containment, g_strdup (commit), set);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+ref_containment_index_save (OstreeRepo *self, GHashTable *heads, GHashTable *containment,
+                            GCancellable *cancellable, GError **error)
+{
+  if (self->cache_dir_fd == -1)
+    return TRUE;
+
+  g_auto (GVariantBuilder) builder;
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (REF_CONTAINMENT_INDEX_GVARIANT_STRING));
+  g_variant_builder_add (&builder, "u", (guint32)REF_CONTAINMENT_INDEX_VERSION);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{ss}"));
+  GLNX_HASH_TABLE_FOREACH_KV (heads, const char *, ref, const char *, head)
+    g_variant_builder_add (&builder, "{ss}", ref, head);
+  g_variant_builder_close (&builder);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sas}"));
+  GLNX_HASH_TABLE_FOREACH_KV (containment, const char *, commit, GHashTable *, set)
+    {
+      /* Compaction happens here: entries whose last containing ref went
+       * away are simply not written back.
+       */
+      if (g_hash_table_size (set) == 0)
+        continue;
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("{sas}"));
+      g_variant_builder_add (&builder, "s", commit);
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("as"));
+      GLNX_HASH_TABLE_FOREACH (set, const char *, r)
+        g_variant_builder_add (&builder, "s", r);
+      g_variant_builder_close (&builder);
+      g_variant_builder_close (&builder);
+    }
+  g_variant_builder_close (&builder);
+
+  g_autoptr (GVariant) cache = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  g_auto (GLnxTmpfile) tmpf = {
+    0,
+  };
+  if (!glnx_open_tmpfile_linkable_at (self->cache_dir_fd, ".", O_WRONLY | O_CLOEXEC, &tmpf, error))
+    return FALSE;
+  if (glnx_loop_write (tmpf.fd, g_variant_get_data (cache), g_variant_get_size (cache)) < 0)
+    return glnx_throw_errno_prefix (error, "write");
+  if (!glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, self->cache_dir_fd,
+                             REF_CONTAINMENT_INDEX_NAME, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+ref_containment_index_purge_ref (GHashTable *containment, const char *refspec)
+{
+  GLNX_HASH_TABLE_FOREACH_V (containment, GHashTable *, set)
+    g_hash_table_remove (set, refspec);
+}
+
+/* Fold one ref update into the loaded index tables.  @new_rev of %NULL
+ * means the ref was deleted.
+ */
+static void
+ref_containment_index_apply (OstreeRepo *self, GHashTable *heads, GHashTable *containment,
+                             const char *refspec, const char *new_rev, GCancellable *cancellable)
+{
+  const char *old_rev = g_hash_table_lookup (heads, refspec);
+
+  if (new_rev == NULL)
+    {
+      if (old_rev == NULL)
+        return;
+      ref_containment_index_purge_ref (containment, refspec);
+      g_hash_table_remove (heads, refspec);
+      return;
+    }
+
+  if (g_strcmp0 (old_rev, new_rev) == 0)
+    return;
+
+  /* Collect the commits reachable from the new head, stopping early at the
+   * previously indexed head (the fast-forward case).  A walk cut short by
+   * a missing commit object (partial history) is fine: the missing commits
+   * couldn't be found by a full walk either.
+   */
+  g_autoptr (GPtrArray) chain = g_ptr_array_new_with_free_func (g_free);
+  g_autofree char *cur = g_strdup (new_rev);
+  gboolean fast_forward = FALSE;
+  while (cur != NULL)
+    {
+      if (old_rev != NULL && strcmp (cur, old_rev) == 0)
+        {
+          fast_forward = TRUE;
+          break;
+        }
+      if (chain->len >= REF_CONTAINMENT_INDEX_MAX_DEPTH)
+        break;
+      g_autoptr (GVariant) commit = NULL;
+      if (!ostree_repo_load_variant_if_exists (self, OSTREE_OBJECT_TYPE_COMMIT, cur, &commit, NULL)
+          || commit == NULL)
+        break;
+      char *parent = ostree_commit_get_parent (commit);
+      g_ptr_array_add (chain, g_steal_pointer (&cur));
+      cur = parent;
+    }
+
+  if (chain->len >= REF_CONTAINMENT_INDEX_MAX_DEPTH)
+    {
+      ref_containment_index_purge_ref (containment, refspec);
+      g_hash_table_remove (heads, refspec);
+      return;
+    }
+
+  if (old_rev != NULL && !fast_forward)
+    ref_containment_index_purge_ref (containment, refspec);
+
+  for (guint i = 0; i < chain->len; i++)
+    {
+      const char *commit = chain->pdata[i];
+      GHashTable *set = g_hash_table_lookup (containment, commit);
+      if (set == NULL)
+        {
+          set = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+          g_hash_table_replace (containment, g_strdup (commit), set);
+        }
+      g_hash_table_add (set, g_strdup (refspec));
+    }
+  g_hash_table_replace (heads, g_strdup (refspec), g_strdup (new_rev));
+}
+
+/* Fold a batch of refspec → rev updates (rev of %NULL deletes) into the
+ * persistent index in a single load/save cycle.  Best-effort: the index is
+ * a cache, and maintaining it must never fail the ref write itself.
+ */
+static void
+ref_containment_index_update_many (OstreeRepo *self, GHashTable *updates,
+                                   GCancellable *cancellable)
+{
+  if (self->cache_dir_fd == -1 || g_hash_table_size (updates) == 0)
+    return;
+
+  g_autoptr (GHashTable) heads
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_autoptr (GHashTable) containment = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                              (GDestroyNotify)g_hash_table_unref);
+  if (!ref_containment_index_load (self, heads, containment, cancellable, NULL))
+    return;
+
+  GLNX_HASH_TABLE_FOREACH_KV (updates, const char *, refspec, const char *, rev)
+    ref_containment_index_apply (self, heads, containment, refspec, rev, cancellable);
+
+  (void)ref_containment_index_save (self, heads, containment, cancellable, NULL);
+}
+
+static void
+ref_containment_index_update_one (OstreeRepo *self, const char *refspec, const char *rev,
+                                  GCancellable *cancellable)
+{
+  g_autoptr (GHashTable) updates
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_hash_table_replace (updates, g_strdup (refspec), g_strdup (rev));
+  ref_containment_index_update_many (self, updates, cancellable);
+}
+
 static char *
 relative_symlink_to (const char *relpath, const char *target)
 {
@@ -1009,11 +1677,15 @@ relative_symlink_to (const char *relpath, const char *target)
   return g_string_free (g_steal_pointer (&buf), FALSE);
 }
 
-/* May specify @rev or @alias */
-gboolean
-_ostree_repo_write_ref (OstreeRepo *self, const char *remote, const OstreeCollectionRef *ref,
-                        const char *rev, const char *alias, GCancellable *cancellable,
-                        GError **error)
+/* May specify @rev or @alias.  With @deferred, the caller is batching many
+ * ref updates: the loose file is written without a per-file sync and the
+ * shared state (refs lock, packed-refs index, repo mtime, summary) is left
+ * for the caller to handle once for the whole batch.
+ */
+static gboolean
+write_ref_internal (OstreeRepo *self, const char *remote, const OstreeCollectionRef *ref,
+                    const char *rev, const char *alias, gboolean deferred,
+                    GCancellable *cancellable, GError **error)
 {
   glnx_autofd int dfd = -1;
 
@@ -1027,6 +1699,16 @@ _ostree_repo_write_ref (OstreeRepo *self, const char *remote, const OstreeCollec
   if (!ostree_validate_rev (ref->ref_name, error))
     return FALSE;
 
+  /* Serialize against ref writers in other processes; inside a transaction
+   * the refs lock is instead held across the whole ref update batch by
+   * ostree_repo_commit_transaction().
+   */
+  g_auto (GLnxLockFile) reflock = {
+    0,
+  };
+  if (!deferred && !self->in_transaction && !_ostree_repo_refs_lock (self, &reflock, error))
+    return FALSE;
+
   if (remote == NULL
       && (ref->collection_id == NULL
           || g_strcmp0 (ref->collection_id, ostree_repo_get_collection_id (self)) == 0))
@@ -1084,7 +1766,7 @@ _ostree_repo_write_ref (OstreeRepo *self, const char *remote, const OstreeCollec
     }
   else if (rev != NULL)
     {
-      if (!write_checksum_file_at (self, dfd, ref->ref_name, rev, cancellable, error))
+      if (!write_checksum_file_at (self, dfd, ref->ref_name, rev, !deferred, cancellable, error))
         return FALSE;
     }
   else if (alias != NULL)
@@ -1109,11 +1791,72 @@ _ostree_repo_write_ref (OstreeRepo *self, const char *remote, const OstreeCollec
         return FALSE;
     }
 
+  if (!deferred)
+    {
+      /* Keep the packed-refs index (if any) in sync with the local refs; for an
+       * alias this drops any stale entry for the name.
+       */
+      if (remote == NULL
+          && (ref->collection_id == NULL
+              || g_strcmp0 (ref->collection_id, ostree_repo_get_collection_id (self)) == 0))
+        {
+          if (!packed_refs_update (self, ref->ref_name, rev, cancellable, error))
+            return FALSE;
+        }
+
+      if (!_ostree_repo_update_mtime (self, error))
+        return FALSE;
+
+      /* Update the summary after updating the mtime so the summary doesn't look
+       * out of date */
+      if (!self->in_transaction
+          && !_ostree_repo_maybe_regenerate_summary (self, cancellable, error))
+        return FALSE;
+
+      /* Maintain the commit → containing-refs index.  Aliases resolve
+       * through their target ref, and foreign-collection mirrors aren't
+       * addressable by refspec, so both are skipped.
+       */
+      if (alias == NULL
+          && (remote != NULL || ref->collection_id == NULL
+              || g_strcmp0 (ref->collection_id, ostree_repo_get_collection_id (self)) == 0))
+        {
+          g_autofree char *refspec
+              = remote ? g_strconcat (remote, ":", ref->ref_name, NULL) : g_strdup (ref->ref_name);
+          ref_containment_index_update_one (self, refspec, rev, cancellable);
+        }
+    }
+
+  return TRUE;
+}
+
+/* May specify @rev or @alias */
+gboolean
+_ostree_repo_write_ref (OstreeRepo *self, const char *remote, const OstreeCollectionRef *ref,
+                        const char *rev, const char *alias, GCancellable *cancellable,
+                        GError **error)
+{
+  return write_ref_internal (self, remote, ref, rev, alias, FALSE, cancellable, error);
+}
+
+/* Finish a batch of deferred write_ref_internal() calls: issue one barrier
+ * for all the loose ref files (instead of an fdatasync() per ref), fold the
+ * accumulated local updates into the packed-refs index in a single rewrite,
+ * and bump the repo mtime once.
+ */
+static gboolean
+flush_ref_batch (OstreeRepo *self, GHashTable *packed_updates, GCancellable *cancellable,
+                 GError **error)
+{
+  if (!self->disable_fsync && syncfs (self->repo_dir_fd) < 0)
+    return glnx_throw_errno_prefix (error, "syncfs");
+
+  if (!packed_refs_update_many (self, packed_updates, cancellable, error))
+    return FALSE;
+
   if (!_ostree_repo_update_mtime (self, error))
     return FALSE;
 
-  /* Update the summary after updating the mtime so the summary doesn't look
-   * out of date */
   if (!self->in_transaction && !_ostree_repo_maybe_regenerate_summary (self, cancellable, error))
     return FALSE;
 
@@ -1124,6 +1867,15 @@ gboolean
 _ostree_repo_update_refs (OstreeRepo *self, GHashTable *refs, /* (element-type utf8 utf8) */
                           GCancellable *cancellable, GError **error)
 {
+  g_auto (GLnxLockFile) reflock = {
+    0,
+  };
+  if (!self->in_transaction && !_ostree_repo_refs_lock (self, &reflock, error))
+    return FALSE;
+
+  g_autoptr (GHashTable) packed_updates
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
   GLNX_HASH_TABLE_FOREACH_KV (refs, const char *, refspec, const char *, rev)
     {
       g_autofree char *remote = NULL;
@@ -1132,10 +1884,19 @@ _ostree_repo_update_refs (OstreeRepo *self, GHashTable *refs, /* (element-type u
         return FALSE;
 
       const OstreeCollectionRef ref = { NULL, ref_name };
-      if (!_ostree_repo_write_ref (self, remote, &ref, rev, NULL, cancellable, error))
+      if (!write_ref_internal (self, remote, &ref, rev, NULL, TRUE, cancellable, error))
         return FALSE;
+
+      if (remote == NULL)
+        g_hash_table_replace (packed_updates, g_strdup (ref_name), g_strdup (rev));
     }
 
+  if (!flush_ref_batch (self, packed_updates, cancellable, error))
+    return FALSE;
+
+  /* One load/save cycle of the containment index for the whole batch */
+  ref_containment_index_update_many (self, refs, cancellable);
+
   return TRUE;
 }
 
@@ -1147,16 +1908,37 @@ _ostree_repo_update_collection_refs (OstreeRepo *self,
   GHashTableIter hash_iter;
   gpointer key, value;
 
+  g_auto (GLnxLockFile) reflock = {
+    0,
+  };
+  if (!self->in_transaction && !_ostree_repo_refs_lock (self, &reflock, error))
+    return FALSE;
+
+  g_autoptr (GHashTable) packed_updates
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
   g_hash_table_iter_init (&hash_iter, refs);
   while (g_hash_table_iter_next (&hash_iter, &key, &value))
     {
       const OstreeCollectionRef *ref = key;
       const char *rev = value;
 
-      if (!_ostree_repo_write_ref (self, NULL, ref, rev, NULL, cancellable, error))
+      if (!write_ref_internal (self, NULL, ref, rev, NULL, TRUE, cancellable, error))
         return FALSE;
+
+      if (ref->collection_id == NULL
+          || g_strcmp0 (ref->collection_id, ostree_repo_get_collection_id (self)) == 0)
+        g_hash_table_replace (packed_updates, g_strdup (ref->ref_name), g_strdup (rev));
     }
 
+  if (!flush_ref_batch (self, packed_updates, cancellable, error))
+    return FALSE;
+
+  /* The local-collection updates are exactly the ones addressable by
+   * refspec, so they double as the containment index batch.
+   */
+  ref_containment_index_update_many (self, packed_updates, cancellable);
+
   return TRUE;
 }
 
@@ -1229,6 +2011,12 @@ ostree_repo_list_collection_refs (OstreeRepo *self, const char *match_collection
       if (!enumerate_refs_recurse (self, NULL, flags, main_collection_id, refs_heads_dfd, base_path,
                                    refs_heads_dfd, ".", ret_all_refs, cancellable, error))
         return FALSE;
+
+      if (!(flags & OSTREE_REPO_LIST_REFS_EXT_ALIASES))
+        {
+          if (!merge_packed_refs (self, NULL, FALSE, main_collection_id, ret_all_refs, error))
+            return FALSE;
+        }
     }
 
   g_string_truncate (base_path, 0);
@@ -1300,3 +2088,112 @@ ostree_repo_list_collection_refs (OstreeRepo *self, const char *match_collection
   ot_transfer_out_value (out_all_refs, &ret_all_refs);
   return TRUE;
 }
+
+static int
+cmp_refspec_strings (gconstpointer a, gconstpointer b)
+{
+  return strcmp (*(const char *const *)a, *(const char *const *)b);
+}
+
+/* Walk the commit history starting at @head looking for @checksum.  A
+ * history truncated by a locally missing parent commit just ends the walk.
+ */
+static gboolean
+history_contains_commit (OstreeRepo *self, const char *head, const char *checksum,
+                         gboolean *out_contains, GCancellable *cancellable, GError **error)
+{
+  *out_contains = FALSE;
+
+  g_autofree char *cur = g_strdup (head);
+  while (cur != NULL)
+    {
+      if (strcmp (cur, checksum) == 0)
+        {
+          *out_contains = TRUE;
+          return TRUE;
+        }
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+
+      g_autoptr (GVariant) commit = NULL;
+      if (!ostree_repo_load_variant_if_exists (self, OSTREE_OBJECT_TYPE_COMMIT, cur, &commit,
+                                               error))
+        return FALSE;
+      if (commit == NULL)
+        return TRUE;
+
+      g_free (cur);
+      cur = ostree_commit_get_parent (commit);
+    }
+
+  return TRUE;
+}
+
+/**
+ * ostree_repo_list_refs_containing:
+ * @self: Repo
+ * @checksum: ASCII SHA256 checksum of a commit
+ * @out_refs: (out) (transfer full) (array zero-terminated=1): Sorted list of
+ *   refspecs whose history contains @checksum
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * List the refs (local and remote-tracking) whose commit history contains
+ * @checksum.  This consults a reverse index maintained as refs are written,
+ * so answering the question for a repository with many refs doesn't require
+ * walking every ref's history; refs whose current head isn't covered by the
+ * index are walked individually, so the result is always exact.
+ *
+ * Since: 2023.6
+ */
+gboolean
+ostree_repo_list_refs_containing (OstreeRepo *self, const char *checksum, char ***out_refs,
+                                  GCancellable *cancellable, GError **error)
+{
+  g_return_val_if_fail (out_refs != NULL, FALSE);
+
+  if (!ostree_validate_checksum_string (checksum, error))
+    return FALSE;
+
+  g_autoptr (GHashTable) all_refs = NULL;
+  if (!ostree_repo_list_refs (self, NULL, &all_refs, cancellable, error))
+    return FALSE;
+
+  g_autoptr (GHashTable) heads = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_autoptr (GHashTable) containment = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                              (GDestroyNotify)g_hash_table_unref);
+  if (!ref_containment_index_load (self, heads, containment, cancellable, NULL))
+    {
+      /* Unreadable index is equivalent to no index; fall back to walking */
+      g_hash_table_remove_all (heads);
+      g_hash_table_remove_all (containment);
+    }
+
+  GHashTable *indexed_refs = g_hash_table_lookup (containment, checksum);
+
+  g_autoptr (GPtrArray) ret_refs = g_ptr_array_new_with_free_func (g_free);
+  GLNX_HASH_TABLE_FOREACH_KV (all_refs, const char *, refspec, const char *, head)
+    {
+      gboolean contains = FALSE;
+      const char *indexed_head = g_hash_table_lookup (heads, refspec);
+
+      if (strcmp (head, checksum) == 0)
+        contains = TRUE;
+      else if (indexed_head != NULL && strcmp (indexed_head, head) == 0)
+        {
+          /* The index covers this ref's current head, so trust it */
+          contains = indexed_refs != NULL && g_hash_table_contains (indexed_refs, refspec);
+        }
+      else if (!history_contains_commit (self, head, checksum, &contains, cancellable, error))
+        return FALSE;
+
+      if (contains)
+        g_ptr_array_add (ret_refs, g_strdup (refspec));
+    }
+
+  g_ptr_array_sort (ret_refs, cmp_refspec_strings);
+  g_ptr_array_add (ret_refs, NULL);
+  *out_refs = (char **)g_ptr_array_free (g_steal_pointer (&ret_refs), FALSE);
+  return TRUE;
+}
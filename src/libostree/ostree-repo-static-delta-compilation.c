@@ -36,8 +36,22 @@
 #include "ostree-varint.h"
 #include "otutil.h"
 
+#ifdef HAVE_ZSTD
+#include "ostree-zstd-compressor.h"
+#endif
+
 #define CONTENT_SIZE_SIMILARITY_THRESHOLD_PERCENT (30)
 
+/* Cost model for the part packer: applying an object costs the number of
+ * bytes the client must produce, plus this fixed surcharge (in byte
+ * equivalents) for opcode dispatch and opening/closing the output.
+ */
+#define DELTA_APPLY_COST_PER_OBJECT (4 * 1024)
+/* Floor for the per-part cost budget, so a small delta with a large
+ * target-parts value doesn't degenerate into many tiny parts.
+ */
+#define DELTA_MIN_PART_COST_BYTES (1 * 1000 * 1000)
+
 typedef enum
 {
   DELTAOPT_FLAG_NONE = (1 << 0),
@@ -49,6 +63,7 @@ typedef struct
 {
   guint64 compressed_size;
   guint64 uncompressed_size;
+  guint64 estimated_apply_cost; /* See part_apply_cost_exceeded() */
   GPtrArray *objects;
   GString *payload;
   GString *operations;
@@ -67,7 +82,10 @@ typedef struct
   guint64 loose_compressed_size;
   guint64 min_fallback_size_bytes;
   guint64 max_bsdiff_size_bytes;
+  guint64 bsdiff_memory_budget_bytes; /* See the bsdiff-memory-budget param; 0 disables */
   guint64 max_chunk_size_bytes;
+  guint target_part_count;         /* See the target-parts param; 0 disables */
+  guint64 target_part_cost_bytes;  /* Derived per-part budget; 0 disables */
   guint64 rollsum_size;
   guint n_rollsum;
   guint n_bsdiff;
@@ -75,6 +93,10 @@ typedef struct
   gboolean swap_endian;
   int parts_dfd;
   DeltaOpts delta_opts;
+  guint n_threads;
+  guint n_compress_threads;
+  guint8 compression_type;
+  gint32 compression_level;
 } OstreeStaticDeltaBuilder;
 
 /* Get an input stream for a GVariant */
@@ -209,10 +231,15 @@ xattr_chunk_equals (const void *one, const void *two)
   return memcmp (g_variant_get_data (v1), g_variant_get_data (v2), l1) == 0;
 }
 
+/* Compress the accumulated payload of @part_builder, write it to a
+ * temporary file in the parts directory, and fill in its header.  Only
+ * touches per-part state, so distinct parts can be finished from
+ * separate threads concurrently.
+ */
 static gboolean
-finish_part (OstreeStaticDeltaBuilder *builder, GError **error)
+finish_one_part (OstreeStaticDeltaBuilder *builder, OstreeStaticDeltaPartBuilder *part_builder,
+                 guint part_index, GError **error)
 {
-  OstreeStaticDeltaPartBuilder *part_builder = builder->parts->pdata[builder->parts->len - 1];
   g_autofree guchar *part_checksum = NULL;
   g_autoptr (GBytes) objtype_checksum_array = NULL;
   g_autoptr (GBytes) checksum_bytes = NULL;
@@ -251,9 +278,42 @@ finish_part (OstreeStaticDeltaBuilder *builder, GError **error)
     g_variant_ref_sink (delta_part_content);
   }
 
-  /* Hardcode xz for now */
-  compressor = (GConverter *)_ostree_lzma_compressor_new (NULL);
-  compression_type_char = 'x';
+  {
+    g_auto (GVariantBuilder) param_builder = OT_VARIANT_BUILDER_INITIALIZER;
+    g_variant_builder_init (&param_builder, G_VARIANT_TYPE ("a{sv}"));
+
+    if (builder->n_compress_threads > 1)
+      g_variant_builder_add (&param_builder, "{sv}", "threads",
+                             g_variant_new_uint32 (builder->n_compress_threads));
+
+    compression_type_char = builder->compression_type;
+    switch (compression_type_char)
+      {
+      case 'z':
+#ifdef HAVE_ZSTD
+        if (builder->compression_level != 0)
+          g_variant_builder_add (&param_builder, "{sv}", "level",
+                                 g_variant_new_int32 (builder->compression_level));
+        {
+          g_autoptr (GVariant) compressor_params
+              = g_variant_ref_sink (g_variant_builder_end (&param_builder));
+          compressor = (GConverter *)_ostree_zstd_compressor_new (compressor_params);
+        }
+        break;
+#else
+        return glnx_throw (error, "This ostree build does not support zstd compression");
+#endif
+      case 'x':
+        {
+          g_autoptr (GVariant) compressor_params
+              = g_variant_ref_sink (g_variant_builder_end (&param_builder));
+          compressor = (GConverter *)_ostree_lzma_compressor_new (compressor_params);
+        }
+        break;
+      default:
+        return glnx_throw (error, "Invalid compression type '%u'", compression_type_char);
+      }
+  }
   part_payload_in = variant_to_inputstream (delta_part_content);
   part_payload_out = (GMemoryOutputStream *)g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
   part_payload_compressor = (GConverterOutputStream *)g_converter_output_stream_new (
@@ -302,17 +362,108 @@ finish_part (OstreeStaticDeltaBuilder *builder, GError **error)
     {
       g_printerr ("part %u n:%u compressed:%" G_GUINT64_FORMAT " uncompressed:%" G_GUINT64_FORMAT
                   "\n",
-                  builder->parts->len, part_builder->objects->len, part_builder->compressed_size,
+                  part_index, part_builder->objects->len, part_builder->compressed_size,
                   part_builder->uncompressed_size);
     }
 
   return TRUE;
 }
 
+static gboolean
+finish_part (OstreeStaticDeltaBuilder *builder, GError **error)
+{
+  OstreeStaticDeltaPartBuilder *part_builder = builder->parts->pdata[builder->parts->len - 1];
+
+  return finish_one_part (builder, part_builder, builder->parts->len, error);
+}
+
+typedef struct
+{
+  OstreeStaticDeltaBuilder *builder;
+  GMutex lock;
+  GCond cond;
+  guint outstanding;
+  GError *caught_error;
+} PartCompressor;
+
+static void
+compress_part_worker (gpointer data, gpointer user_data)
+{
+  PartCompressor *compressor = user_data;
+  OstreeStaticDeltaBuilder *builder = compressor->builder;
+  const guint part_index = GPOINTER_TO_UINT (data);
+  OstreeStaticDeltaPartBuilder *part_builder = builder->parts->pdata[part_index - 1];
+  g_autoptr (GError) local_error = NULL;
+
+  g_mutex_lock (&compressor->lock);
+  const gboolean bailing = compressor->caught_error != NULL;
+  g_mutex_unlock (&compressor->lock);
+
+  if (!bailing && !finish_one_part (builder, part_builder, part_index, &local_error))
+    {
+      g_mutex_lock (&compressor->lock);
+      if (compressor->caught_error == NULL)
+        compressor->caught_error = g_steal_pointer (&local_error);
+      g_mutex_unlock (&compressor->lock);
+    }
+
+  g_mutex_lock (&compressor->lock);
+  g_assert_cmpuint (compressor->outstanding, >, 0);
+  compressor->outstanding--;
+  g_cond_signal (&compressor->cond);
+  g_mutex_unlock (&compressor->lock);
+}
+
+/* Compress and write out every delta part.  In the serial case parts
+ * are finished eagerly by allocate_part() and only the last one is
+ * left; with multiple threads allocate_part() defers all of them so we
+ * can compress the parts concurrently here, at the cost of keeping the
+ * uncompressed payloads in memory until this point.
+ */
+static gboolean
+finish_all_parts (OstreeStaticDeltaBuilder *builder, GError **error)
+{
+  if (builder->n_threads <= 1)
+    return finish_part (builder, error);
+
+  PartCompressor compressor = {
+    builder,
+  };
+  g_mutex_init (&compressor.lock);
+  g_cond_init (&compressor.cond);
+
+  OtThreadPool *pool = ot_thread_pool_new ("delta-compress", compress_part_worker, &compressor,
+                                           MIN (builder->n_threads, builder->parts->len));
+
+  compressor.outstanding = builder->parts->len;
+  for (guint i = 0; i < builder->parts->len; i++)
+    ot_thread_pool_push (pool, GUINT_TO_POINTER (i + 1));
+
+  g_mutex_lock (&compressor.lock);
+  while (compressor.outstanding > 0)
+    g_cond_wait (&compressor.cond, &compressor.lock);
+  g_mutex_unlock (&compressor.lock);
+
+  ot_thread_pool_free (pool);
+  g_mutex_clear (&compressor.lock);
+  g_cond_clear (&compressor.cond);
+
+  if (compressor.caught_error != NULL)
+    {
+      g_propagate_error (error, compressor.caught_error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 static OstreeStaticDeltaPartBuilder *
 allocate_part (OstreeStaticDeltaBuilder *builder, GError **error)
 {
-  if (builder->parts->len > 0)
+  /* With multiple threads, defer finishing so that finish_all_parts()
+   * can compress the parts concurrently.
+   */
+  if (builder->parts->len > 0 && builder->n_threads <= 1)
     {
       if (!finish_part (builder, error))
         return NULL;
@@ -412,6 +563,21 @@ write_content_mode_xattrs (OstreeRepo *repo, OstreeStaticDeltaPartBuilder *curre
                                                   current_part->xattrs, content_xattrs);
 }
 
+/* Returns TRUE if the cost-based packer wants to start a new part.  The
+ * apply cost of a part is modelled as the number of bytes a client must
+ * produce when applying it, plus a fixed per-object surcharge for opcode
+ * dispatch; balancing this across a target number of parts is what lets a
+ * parallel apply scale, since one oversized part otherwise dominates the
+ * critical path.
+ */
+static gboolean
+part_apply_cost_exceeded (OstreeStaticDeltaBuilder *builder, OstreeStaticDeltaPartBuilder *part)
+{
+  if (builder->target_part_cost_bytes == 0)
+    return FALSE;
+  return part->objects->len > 0 && part->estimated_apply_cost >= builder->target_part_cost_bytes;
+}
+
 static gboolean
 process_one_object (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
                     OstreeStaticDeltaPartBuilder **current_part_val, const char *checksum,
@@ -438,8 +604,9 @@ process_one_object (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
     }
 
   /* Check to see if this delta is maximum size */
-  if (current_part->objects->len > 0
-      && current_part->payload->len + content_size > builder->max_chunk_size_bytes)
+  if ((current_part->objects->len > 0
+       && current_part->payload->len + content_size > builder->max_chunk_size_bytes)
+      || part_apply_cost_exceeded (builder, current_part))
     {
       current_part = allocate_part (builder, error);
       if (current_part == NULL)
@@ -454,6 +621,7 @@ process_one_object (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
   builder->loose_compressed_size += compressed_size;
 
   current_part->uncompressed_size += content_size;
+  current_part->estimated_apply_cost += content_size + DELTA_APPLY_COST_PER_OBJECT;
 
   g_ptr_array_add (current_part->objects, ostree_object_name_serialize (checksum, objtype));
 
@@ -532,13 +700,88 @@ content_bsdiffs_free (ContentBsdiff *bsdiff)
   g_free (bsdiff);
 }
 
+/* Delta generation maps the same uncompressed content repeatedly: an object
+ * is unpacked once to choose between rollsum and bsdiff, and again when the
+ * chosen strategy emits the part payload, and one large from-object may be
+ * diffed against many to-objects.  Cache the mappings — they're immutable,
+ * refcounted GBytes — keyed by checksum, bounded by total mapped size with
+ * least-recently-used eviction.
+ */
+#define UNPACKED_CONTENT_CACHE_MAX_BYTES (512 * 1024 * 1024)
+
+typedef struct
+{
+  GHashTable *by_checksum; /* char *checksum -> GBytes *, both owned */
+  GQueue lru;              /* of borrowed checksum keys, head = most recent */
+  guint64 total_bytes;
+} UnpackedContentCache;
+
+static UnpackedContentCache *
+unpacked_content_cache_new (void)
+{
+  UnpackedContentCache *cache = g_new0 (UnpackedContentCache, 1);
+  cache->by_checksum
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_bytes_unref);
+  g_queue_init (&cache->lru);
+  return cache;
+}
+
+static void
+unpacked_content_cache_free (UnpackedContentCache *cache)
+{
+  g_queue_clear (&cache->lru);
+  g_hash_table_unref (cache->by_checksum);
+  g_free (cache);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (UnpackedContentCache, unpacked_content_cache_free)
+
+static GBytes *
+unpacked_content_cache_lookup (UnpackedContentCache *cache, const char *checksum)
+{
+  gpointer orig_key, value;
+  if (!g_hash_table_lookup_extended (cache->by_checksum, checksum, &orig_key, &value))
+    return NULL;
+  g_queue_remove (&cache->lru, orig_key);
+  g_queue_push_head (&cache->lru, orig_key);
+  return g_bytes_ref (value);
+}
+
+static void
+unpacked_content_cache_insert (UnpackedContentCache *cache, const char *checksum, GBytes *content)
+{
+  char *key = g_strdup (checksum);
+  g_hash_table_replace (cache->by_checksum, key, g_bytes_ref (content));
+  g_queue_push_head (&cache->lru, key);
+  cache->total_bytes += g_bytes_get_size (content);
+
+  /* Evict oldest entries; outstanding references keep their mappings alive,
+   * we just stop pinning them.  Always retain the entry just inserted.
+   */
+  while (cache->total_bytes > UNPACKED_CONTENT_CACHE_MAX_BYTES
+         && g_queue_get_length (&cache->lru) > 1)
+    {
+      char *victim = g_queue_pop_tail (&cache->lru);
+      GBytes *victim_bytes = g_hash_table_lookup (cache->by_checksum, victim);
+      cache->total_bytes -= g_bytes_get_size (victim_bytes);
+      g_hash_table_remove (cache->by_checksum, victim);
+    }
+}
+
 /* Load a content object, uncompressing it to an unlinked tmpfile
-   that's mmap()'d and suitable for seeking.
+   that's mmap()'d and suitable for seeking.  @cache may be %NULL.
  */
 static gboolean
-get_unpacked_unlinked_content (OstreeRepo *repo, const char *checksum, GBytes **out_content,
-                               GCancellable *cancellable, GError **error)
+get_unpacked_unlinked_content (OstreeRepo *repo, UnpackedContentCache *cache, const char *checksum,
+                               GBytes **out_content, GCancellable *cancellable, GError **error)
 {
+  if (cache != NULL)
+    {
+      *out_content = unpacked_content_cache_lookup (cache, checksum);
+      if (*out_content != NULL)
+        return TRUE;
+    }
+
   g_autoptr (GInputStream) istream = NULL;
 
   if (!ostree_repo_load_file (repo, checksum, &istream, NULL, NULL, cancellable, error))
@@ -547,6 +790,9 @@ get_unpacked_unlinked_content (OstreeRepo *repo, const char *checksum, GBytes **
   *out_content = ot_map_anonymous_tmpfile_from_content (istream, cancellable, error);
   if (!*out_content)
     return FALSE;
+
+  if (cache != NULL)
+    unpacked_content_cache_insert (cache, checksum, *out_content);
   return TRUE;
 }
 
@@ -575,9 +821,86 @@ try_content_bsdiff (OstreeRepo *repo, const char *from, const char *to, ContentB
   return TRUE;
 }
 
+/* Bupsplit chunk maps are a pure function of an object's content, so they
+ * can be persisted keyed by object checksum and reused forever.  Repeated
+ * delta generation from slowly-changing trees then only scans objects it
+ * hasn't seen before; a release pipeline also gets the to-side maps back
+ * as from-side maps on the next build.  The cache lives under the
+ * repository's tmp/cache directory and is strictly best-effort.
+ */
+#define ROLLSUM_CACHE_DIR "rollsums"
+#define ROLLSUM_CHUNKS_GVARIANT_STRING "a(utt)"
+
+static GVariant *
+rollsum_cache_lookup (OstreeRepo *repo, const char *checksum)
+{
+  if (repo->cache_dir_fd == -1)
+    return NULL;
+
+  g_autofree char *path = g_strconcat (ROLLSUM_CACHE_DIR "/", checksum, ".chunks", NULL);
+  glnx_autofd int fd = openat (repo->cache_dir_fd, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  g_autoptr (GBytes) bytes = glnx_fd_readall_bytes (fd, NULL, NULL);
+  if (bytes == NULL)
+    return NULL;
+
+  return g_variant_ref_sink (g_variant_new_from_bytes (
+      G_VARIANT_TYPE (ROLLSUM_CHUNKS_GVARIANT_STRING), bytes, FALSE));
+}
+
+static void
+rollsum_cache_store (OstreeRepo *repo, const char *checksum, GVariant *chunks,
+                     GCancellable *cancellable)
+{
+  g_autoptr (GError) local_error = NULL;
+
+  if (repo->cache_dir_fd == -1)
+    return;
+
+  glnx_autofd int cache_dfd = -1;
+  if (!glnx_shutil_mkdir_p_at_open (repo->cache_dir_fd, ROLLSUM_CACHE_DIR, 0755, &cache_dfd,
+                                    cancellable, &local_error))
+    {
+      g_debug ("Failed to open rollsum cache dir: %s", local_error->message);
+      return;
+    }
+
+  g_autofree char *name = g_strconcat (checksum, ".chunks", NULL);
+  if (!glnx_file_replace_contents_at (cache_dfd, name, g_variant_get_data (chunks),
+                                      g_variant_get_size (chunks), 0, cancellable, &local_error))
+    g_debug ("Failed to cache rollsum chunks for %s: %s", checksum, local_error->message);
+}
+
+/* Guard against truncated or corrupted cache files: every chunk must lie
+ * inside the object and the chunks must tile it contiguously.  The matcher
+ * memcmp()s at cached offsets, so this is a memory-safety check, not just
+ * hygiene.
+ */
 static gboolean
-try_content_rollsum (OstreeRepo *repo, DeltaOpts opts, const char *from, const char *to,
-                     ContentRollsum **out_rollsum, GCancellable *cancellable, GError **error)
+rollsum_chunks_valid (GVariant *chunks, gsize content_len)
+{
+  GVariantIter viter;
+  guint32 crc;
+  guint64 start, offset;
+  guint64 expected_start = 0;
+
+  g_variant_iter_init (&viter, chunks);
+  while (g_variant_iter_next (&viter, "(utt)", &crc, &start, &offset))
+    {
+      if (start != expected_start || offset == 0 || start + offset > content_len)
+        return FALSE;
+      expected_start = start + offset;
+    }
+
+  return expected_start == content_len;
+}
+
+static gboolean
+try_content_rollsum (OstreeRepo *repo, DeltaOpts opts, UnpackedContentCache *content_cache,
+                     const char *from, const char *to, ContentRollsum **out_rollsum,
+                     GCancellable *cancellable, GError **error)
 {
   *out_rollsum = NULL;
 
@@ -585,13 +908,31 @@ try_content_rollsum (OstreeRepo *repo, DeltaOpts opts, const char *from, const c
    * we can just mmap() and seek around in conveniently.
    */
   g_autoptr (GBytes) tmp_from = NULL;
-  if (!get_unpacked_unlinked_content (repo, from, &tmp_from, cancellable, error))
+  if (!get_unpacked_unlinked_content (repo, content_cache, from, &tmp_from, cancellable, error))
     return FALSE;
   g_autoptr (GBytes) tmp_to = NULL;
-  if (!get_unpacked_unlinked_content (repo, to, &tmp_to, cancellable, error))
+  if (!get_unpacked_unlinked_content (repo, content_cache, to, &tmp_to, cancellable, error))
     return FALSE;
 
-  g_autoptr (OstreeRollsumMatches) matches = _ostree_compute_rollsum_matches (tmp_from, tmp_to);
+  g_autoptr (GVariant) from_chunks = rollsum_cache_lookup (repo, from);
+  if (from_chunks != NULL && !rollsum_chunks_valid (from_chunks, g_bytes_get_size (tmp_from)))
+    g_clear_pointer (&from_chunks, g_variant_unref);
+  if (from_chunks == NULL)
+    {
+      from_chunks = _ostree_rollsum_compute_chunks (tmp_from);
+      rollsum_cache_store (repo, from, from_chunks, cancellable);
+    }
+  g_autoptr (GVariant) to_chunks = rollsum_cache_lookup (repo, to);
+  if (to_chunks != NULL && !rollsum_chunks_valid (to_chunks, g_bytes_get_size (tmp_to)))
+    g_clear_pointer (&to_chunks, g_variant_unref);
+  if (to_chunks == NULL)
+    {
+      to_chunks = _ostree_rollsum_compute_chunks (tmp_to);
+      rollsum_cache_store (repo, to, to_chunks, cancellable);
+    }
+
+  g_autoptr (OstreeRollsumMatches) matches
+      = _ostree_compute_rollsum_matches_with_chunks (tmp_from, from_chunks, tmp_to, to_chunks);
 
   const guint match_ratio = (matches->bufmatches * 100) / matches->total;
 
@@ -632,6 +973,141 @@ bzdiff_write (struct bsdiff_stream *stream, const void *buffer, int size)
   return 0;
 }
 
+/* The control words of the patch stream are 64-bit sign-magnitude
+ * little-endian values; these match offtout()/offtin() in the vendored
+ * bsdiff and bspatch.
+ */
+static void
+bsdiff_offtout (gint64 x, guint8 *buf)
+{
+  guint64 y = (x < 0) ? -(guint64)x : (guint64)x;
+
+  for (guint i = 0; i < 8; i++)
+    {
+      buf[i] = y & 0xff;
+      y >>= 8;
+    }
+  if (x < 0)
+    buf[7] |= 0x80;
+}
+
+static gint64
+bsdiff_offtin (const guint8 *buf)
+{
+  gint64 y = buf[7] & 0x7f;
+
+  for (int i = 6; i >= 0; i--)
+    y = (y << 8) + buf[i];
+  if (buf[7] & 0x80)
+    y = -y;
+  return y;
+}
+
+static int
+bsdiff_capture_write (struct bsdiff_stream *stream, const void *buffer, int size)
+{
+  g_byte_array_append (stream->opaque, buffer, size);
+  return 0;
+}
+
+/* Estimated peak allocation of one bsdiff() call relative to the source
+ * size: the suffix sort keeps two arrays of 64-bit values over the
+ * source on top of the source buffer itself.
+ */
+#define BSDIFF_MEM_FACTOR 17
+
+/* Run bsdiff, windowing the input when the source is too large to
+ * suffix-sort within @memory_budget_bytes.  Each window of the target is
+ * diffed against a source window centered on the proportional position
+ * (content rarely shifts far within one object), and the per-window
+ * patches are stitched into a single valid patch stream by prefixing
+ * each with a seek-only control word that moves the source cursor from
+ * wherever the previous window left it to the next window's origin.
+ * The result applies with the stock bspatch against the whole source,
+ * so the wire format and old clients are unaffected; the tradeoff is
+ * that matches crossing window boundaries are missed, costing some
+ * patch size.  With @memory_budget_bytes == 0 this is plain bsdiff.
+ */
+static gboolean
+bsdiff_with_budget (const guint8 *from_buf, gsize from_len, const guint8 *to_buf, gsize to_len,
+                    struct bsdiff_stream *stream, guint64 memory_budget_bytes, GError **error)
+{
+  if (memory_budget_bytes == 0 || (guint64)from_len * BSDIFF_MEM_FACTOR <= memory_budget_bytes)
+    {
+      if (bsdiff (from_buf, from_len, to_buf, to_len, stream) < 0)
+        return glnx_throw (error, "bsdiff generation failed");
+      return TRUE;
+    }
+
+  const gsize min_window = 1 * 1024 * 1024;
+  const gsize from_win_max
+      = MAX ((gsize)(memory_budget_bytes / BSDIFF_MEM_FACTOR), min_window);
+  const gsize to_win = MAX (from_win_max * 2 / 3, min_window);
+
+  gint64 global_oldpos = 0;
+  g_autoptr (GByteArray) window_patch = g_byte_array_new ();
+
+  for (gsize off = 0; off < to_len; off += to_win)
+    {
+      const gsize chunk = MIN (to_win, to_len - off);
+
+      gsize from_center = (gsize)((double)off / to_len * from_len) + chunk / 2;
+      gsize from_start = (from_center > from_win_max / 2) ? from_center - from_win_max / 2 : 0;
+      if (from_start > from_len)
+        from_start = from_len;
+      gsize from_chunk = MIN (from_win_max, from_len - from_start);
+      /* Never hand bsdiff an empty source window if there is source data */
+      if (from_chunk == 0 && from_len > 0)
+        {
+          from_chunk = MIN (from_win_max, from_len);
+          from_start = from_len - from_chunk;
+        }
+
+      g_byte_array_set_size (window_patch, 0);
+      struct bsdiff_stream capture;
+      capture.malloc = malloc;
+      capture.free = free;
+      capture.write = bsdiff_capture_write;
+      capture.opaque = window_patch;
+      if (bsdiff (from_buf + from_start, from_chunk, to_buf + off, chunk, &capture) < 0)
+        return glnx_throw (error, "bsdiff generation failed");
+
+      /* Rebase the window onto global source coordinates */
+      guint8 ctrl[24];
+      bsdiff_offtout (0, ctrl);
+      bsdiff_offtout (0, ctrl + 8);
+      bsdiff_offtout ((gint64)from_start - global_oldpos, ctrl + 16);
+      if (stream->write (stream, ctrl, sizeof (ctrl)) < 0)
+        return glnx_throw (error, "bsdiff write failed");
+      for (gsize pos = 0; pos < window_patch->len;)
+        {
+          const int wsize = (int)MIN (window_patch->len - pos, (gsize)(64 * 1024 * 1024));
+          if (stream->write (stream, window_patch->data + pos, wsize) < 0)
+            return glnx_throw (error, "bsdiff write failed");
+          pos += wsize;
+        }
+
+      /* Walk the window's control words to find where it leaves the
+       * source cursor, in window-local coordinates. */
+      gint64 local_oldpos = 0;
+      for (gsize pos = 0; pos < window_patch->len;)
+        {
+          if (pos + 24 > window_patch->len)
+            return glnx_throw (error, "bsdiff emitted a malformed patch");
+          const gint64 x = bsdiff_offtin (window_patch->data + pos);
+          const gint64 y = bsdiff_offtin (window_patch->data + pos + 8);
+          const gint64 z = bsdiff_offtin (window_patch->data + pos + 16);
+          if (x < 0 || y < 0 || (guint64)(x + y) > window_patch->len - pos - 24)
+            return glnx_throw (error, "bsdiff emitted a malformed patch");
+          local_oldpos += x + z;
+          pos += 24 + x + y;
+        }
+      global_oldpos = (gint64)from_start + local_oldpos;
+    }
+
+  return TRUE;
+}
+
 static void
 append_payload_chunk_and_write (OstreeStaticDeltaPartBuilder *current_part, const guint8 *buf,
                                 guint64 offset)
@@ -647,13 +1123,15 @@ append_payload_chunk_and_write (OstreeStaticDeltaPartBuilder *current_part, cons
 
 static gboolean
 process_one_rollsum (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
+                     UnpackedContentCache *content_cache,
                      OstreeStaticDeltaPartBuilder **current_part_val, const char *to_checksum,
                      ContentRollsum *rollsum, GCancellable *cancellable, GError **error)
 {
   OstreeStaticDeltaPartBuilder *current_part = *current_part_val;
 
   /* Check to see if this delta has gone over maximum size */
-  if (current_part->objects->len > 0 && current_part->payload->len > builder->max_chunk_size_bytes)
+  if ((current_part->objects->len > 0 && current_part->payload->len > builder->max_chunk_size_bytes)
+      || part_apply_cost_exceeded (builder, current_part))
     {
       current_part = allocate_part (builder, error);
       if (current_part == NULL)
@@ -662,7 +1140,8 @@ process_one_rollsum (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
     }
 
   g_autoptr (GBytes) tmp_to = NULL;
-  if (!get_unpacked_unlinked_content (repo, to_checksum, &tmp_to, cancellable, error))
+  if (!get_unpacked_unlinked_content (repo, content_cache, to_checksum, &tmp_to, cancellable,
+                                      error))
     return FALSE;
 
   gsize tmp_to_len;
@@ -677,6 +1156,7 @@ process_one_rollsum (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
   g_assert_cmpint (tmp_to_len, ==, content_size);
 
   current_part->uncompressed_size += content_size;
+  current_part->estimated_apply_cost += content_size + DELTA_APPLY_COST_PER_OBJECT;
 
   g_ptr_array_add (current_part->objects,
                    ostree_object_name_serialize (to_checksum, OSTREE_OBJECT_TYPE_FILE));
@@ -763,13 +1243,15 @@ process_one_rollsum (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
 
 static gboolean
 process_one_bsdiff (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
+                    UnpackedContentCache *content_cache,
                     OstreeStaticDeltaPartBuilder **current_part_val, const char *to_checksum,
                     ContentBsdiff *bsdiff_content, GCancellable *cancellable, GError **error)
 {
   OstreeStaticDeltaPartBuilder *current_part = *current_part_val;
 
   /* Check to see if this delta has gone over maximum size */
-  if (current_part->objects->len > 0 && current_part->payload->len > builder->max_chunk_size_bytes)
+  if ((current_part->objects->len > 0 && current_part->payload->len > builder->max_chunk_size_bytes)
+      || part_apply_cost_exceeded (builder, current_part))
     {
       current_part = allocate_part (builder, error);
       if (current_part == NULL)
@@ -778,11 +1260,12 @@ process_one_bsdiff (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
     }
 
   g_autoptr (GBytes) tmp_from = NULL;
-  if (!get_unpacked_unlinked_content (repo, bsdiff_content->from_checksum, &tmp_from, cancellable,
-                                      error))
+  if (!get_unpacked_unlinked_content (repo, content_cache, bsdiff_content->from_checksum, &tmp_from,
+                                      cancellable, error))
     return FALSE;
   g_autoptr (GBytes) tmp_to = NULL;
-  if (!get_unpacked_unlinked_content (repo, to_checksum, &tmp_to, cancellable, error))
+  if (!get_unpacked_unlinked_content (repo, content_cache, to_checksum, &tmp_to, cancellable,
+                                      error))
     return FALSE;
 
   gsize tmp_to_len;
@@ -799,6 +1282,8 @@ process_one_bsdiff (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
   g_assert_cmpint (tmp_to_len, ==, content_size);
 
   current_part->uncompressed_size += content_size;
+  /* bspatch is roughly twice the work per output byte of a plain write */
+  current_part->estimated_apply_cost += 2 * content_size + DELTA_APPLY_COST_PER_OBJECT;
 
   g_ptr_array_add (current_part->objects,
                    ostree_object_name_serialize (to_checksum, OSTREE_OBJECT_TYPE_FILE));
@@ -835,8 +1320,9 @@ process_one_bsdiff (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
       op.cancellable = cancellable;
       op.error = error;
       stream.opaque = &op;
-      if (bsdiff (tmp_from_buf, tmp_from_len, tmp_to_buf, tmp_to_len, &stream) < 0)
-        return glnx_throw (error, "bsdiff generation failed");
+      if (!bsdiff_with_budget (tmp_from_buf, tmp_from_len, tmp_to_buf, tmp_to_len, &stream,
+                               builder->bsdiff_memory_budget_bytes, error))
+        return FALSE;
 
       payload = g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (out));
       payload_size = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (out));
@@ -884,6 +1370,71 @@ check_object_world_readable (OstreeRepo *repo, const char *checksum, gboolean *o
   return TRUE;
 }
 
+/* Estimate the total apply cost of everything that will land in parts and
+ * derive the per-part budget for the requested target part count; see
+ * part_apply_cost_exceeded().  Sizes come from a stat of each object, which
+ * is cheap relative to the compilation itself and close enough for
+ * balancing purposes.
+ */
+static gboolean
+compute_target_part_cost (OstreeRepo *repo, OstreeStaticDeltaBuilder *builder,
+                          GHashTable *new_reachable_metadata,
+                          GHashTable *rollsum_optimized_content_objects,
+                          GHashTable *bsdiff_optimized_content_objects,
+                          GHashTable *new_reachable_regfile_content,
+                          GHashTable *new_reachable_symlink_content, GCancellable *cancellable,
+                          GError **error)
+{
+  GHashTableIter hashiter;
+  gpointer key, value;
+  guint64 total_cost = 0;
+
+  g_hash_table_iter_init (&hashiter, new_reachable_metadata);
+  while (g_hash_table_iter_next (&hashiter, &key, &value))
+    {
+      GVariant *serialized_key = key;
+      const char *checksum;
+      OstreeObjectType objtype;
+      guint64 size;
+
+      ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+      if (!ostree_repo_query_object_storage_size (repo, objtype, checksum, &size, cancellable,
+                                                  error))
+        return FALSE;
+      total_cost += size + DELTA_APPLY_COST_PER_OBJECT;
+    }
+
+  g_hash_table_iter_init (&hashiter, new_reachable_regfile_content);
+  while (g_hash_table_iter_next (&hashiter, &key, &value))
+    {
+      const char *checksum = key;
+      guint64 size;
+      const gboolean diffed = g_hash_table_contains (rollsum_optimized_content_objects, checksum)
+                              || g_hash_table_contains (bsdiff_optimized_content_objects, checksum);
+
+      if (!ostree_repo_query_object_storage_size (repo, OSTREE_OBJECT_TYPE_FILE, checksum, &size,
+                                                  cancellable, error))
+        return FALSE;
+
+      /* Large non-diffed objects will become fallbacks outside any part */
+      if (!diffed && builder->min_fallback_size_bytes > 0
+          && size > builder->min_fallback_size_bytes)
+        continue;
+
+      if (g_hash_table_contains (bsdiff_optimized_content_objects, checksum))
+        total_cost += 2 * size + DELTA_APPLY_COST_PER_OBJECT;
+      else
+        total_cost += size + DELTA_APPLY_COST_PER_OBJECT;
+    }
+
+  total_cost
+      += (guint64)g_hash_table_size (new_reachable_symlink_content) * DELTA_APPLY_COST_PER_OBJECT;
+
+  builder->target_part_cost_bytes
+      = MAX (total_cost / builder->target_part_count, DELTA_MIN_PART_COST_BYTES);
+  return TRUE;
+}
+
 static gboolean
 generate_delta_lowlatency (OstreeRepo *repo, const char *from, const char *to, DeltaOpts opts,
                            OstreeStaticDeltaBuilder *builder, GCancellable *cancellable,
@@ -987,6 +1538,8 @@ generate_delta_lowlatency (OstreeRepo *repo, const char *from, const char *to, D
     g_hash_table_remove (new_reachable_metadata, commit);
   }
 
+  g_autoptr (UnpackedContentCache) content_cache = unpacked_content_cache_new ();
+
   rollsum_optimized_content_objects = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
                                                              (GDestroyNotify)content_rollsums_free);
 
@@ -1014,8 +1567,8 @@ generate_delta_lowlatency (OstreeRepo *repo, const char *from, const char *to, D
       if (!from_world_readable)
         continue;
 
-      if (!try_content_rollsum (repo, opts, from_checksum, to_checksum, &rollsum, cancellable,
-                                error))
+      if (!try_content_rollsum (repo, opts, content_cache, from_checksum, to_checksum, &rollsum,
+                                cancellable, error))
         return FALSE;
 
       if (rollsum)
@@ -1043,6 +1596,20 @@ generate_delta_lowlatency (OstreeRepo *repo, const char *from, const char *to, D
                   g_hash_table_size (modified_regfile_content));
     }
 
+  if (builder->target_part_count > 0)
+    {
+      if (!compute_target_part_cost (repo, builder, new_reachable_metadata,
+                                     rollsum_optimized_content_objects,
+                                     bsdiff_optimized_content_objects,
+                                     new_reachable_regfile_content,
+                                     new_reachable_symlink_content, cancellable, error))
+        return FALSE;
+
+      if (opts & DELTAOPT_FLAG_VERBOSE)
+        g_printerr ("target apply cost per part: %" G_GUINT64_FORMAT " bytes\n",
+                    builder->target_part_cost_bytes);
+    }
+
   current_part = allocate_part (builder, error);
   if (current_part == NULL)
     return FALSE;
@@ -1069,8 +1636,8 @@ generate_delta_lowlatency (OstreeRepo *repo, const char *from, const char *to, D
       const char *checksum = key;
       ContentRollsum *rollsum = value;
 
-      if (!process_one_rollsum (repo, builder, &current_part, checksum, rollsum, cancellable,
-                                error))
+      if (!process_one_rollsum (repo, builder, content_cache, &current_part, checksum, rollsum,
+                                cancellable, error))
         return FALSE;
 
       builder->n_rollsum++;
@@ -1091,8 +1658,8 @@ generate_delta_lowlatency (OstreeRepo *repo, const char *from, const char *to, D
           if (opts & DELTAOPT_FLAG_VERBOSE && (mod == 0 || builder->n_bsdiff % mod == 0))
             g_printerr ("processing bsdiff: [%u/%u]\n", builder->n_bsdiff, n_bsdiff);
 
-          if (!process_one_bsdiff (repo, builder, &current_part, checksum, bsdiff, cancellable,
-                                   error))
+          if (!process_one_bsdiff (repo, builder, content_cache, &current_part, checksum, bsdiff,
+                                   cancellable, error))
             return FALSE;
 
           builder->n_bsdiff++;
@@ -1162,18 +1729,22 @@ generate_delta_lowlatency (OstreeRepo *repo, const char *from, const char *to, D
         return FALSE;
     }
 
-  if (!finish_part (builder, error))
+  if (!finish_all_parts (builder, error))
     return FALSE;
 
   return TRUE;
 }
 
+/* Stream the fallback header array directly into @descriptor_builder, so the
+ * combined array variant is never materialized in memory. */
 static gboolean
-get_fallback_headers (OstreeRepo *self, OstreeStaticDeltaBuilder *builder, GVariant **out_headers,
-                      GCancellable *cancellable, GError **error)
+write_fallback_headers (OstreeRepo *self, OstreeStaticDeltaBuilder *builder,
+                        OtVariantBuilder *descriptor_builder, GCancellable *cancellable,
+                        GError **error)
 {
-  g_autoptr (GVariantBuilder) fallback_builder
-      = g_variant_builder_new (G_VARIANT_TYPE ("a" OSTREE_STATIC_DELTA_FALLBACK_FORMAT));
+  if (!ot_variant_builder_open (descriptor_builder,
+                                G_VARIANT_TYPE ("a" OSTREE_STATIC_DELTA_FALLBACK_FORMAT), error))
+    return FALSE;
 
   for (guint i = 0; i < builder->fallback_objects->len; i++)
     {
@@ -1205,16 +1776,15 @@ get_fallback_headers (OstreeRepo *self, OstreeStaticDeltaBuilder *builder, GVari
           uncompressed_size = g_file_info_get_size (file_info);
         }
 
-      g_variant_builder_add_value (
-          fallback_builder,
-          g_variant_new ("(y@aytt)", objtype, ostree_checksum_to_bytes_v (checksum),
-                         maybe_swap_endian_u64 (builder->swap_endian, compressed_size),
-                         maybe_swap_endian_u64 (builder->swap_endian, uncompressed_size)));
+      if (!ot_variant_builder_add (
+              descriptor_builder, error, "(y@aytt)", objtype,
+              ostree_checksum_to_bytes_v (checksum),
+              maybe_swap_endian_u64 (builder->swap_endian, compressed_size),
+              maybe_swap_endian_u64 (builder->swap_endian, uncompressed_size)))
+        return FALSE;
     }
 
-  g_autoptr (GVariant) ret_headers = g_variant_ref_sink (g_variant_builder_end (fallback_builder));
-  ot_transfer_out_value (out_headers, &ret_headers);
-  return TRUE;
+  return ot_variant_builder_close (descriptor_builder, error);
 }
 
 /**
@@ -1238,12 +1808,26 @@ get_fallback_headers (OstreeRepo *self, OstreeStaticDeltaBuilder *builder, GVari
  *   - min-fallback-size: u: Minimum uncompressed size in megabytes to use fallback, 0 to disable
  * fallbacks
  *   - max-chunk-size: u: Maximum size in megabytes of a delta part
+ *   - target-parts: u: Balance estimated apply cost (decompressed bytes plus per-object
+ *   overhead) across this many parts, for clients that apply parts in parallel; 0 disables
+ *   cost-based packing.  Default 0.
  *   - max-bsdiff-size: u: Maximum size in megabytes to consider bsdiff compression
  *   for input files
- *   - compression: y: Compression type: 0=none, x=lzma, g=gzip
+ *   - bsdiff-memory-budget: u: Cap bsdiff generation memory per object at this many
+ *   megabytes by diffing larger source files in windows, at some cost in patch size.
+ *   0 (the default) disables windowing.  Resulting deltas apply unchanged on all clients.
+ *   - compression: y: Compression type: x=lzma, z=zstd (requires an ostree built with zstd,
+ *   on both the generating and the applying side).  Default 'x'.
+ *   - compression-level: i: Compression level for zstd; 0 means the built-in default.
  *   - bsdiff-enabled: b: Enable bsdiff compression.  Default TRUE.
  *   - inline-parts: b: Put part data in header, to get a single file delta.  Default FALSE.
  *   - verbose: b: Print diagnostic messages.  Default FALSE.
+ *   - n-threads: u: Number of threads used to compress delta parts; 0 means one per processor.
+ * Values above 1 keep the uncompressed part payloads in memory until the end of generation.
+ * Default 1.
+ *   - compress-threads: u: Number of threads the xz encoder uses per delta part; 0 means one
+ * per processor.  Requires liblzma >= 5.2, otherwise single-threaded encoding is used.
+ * Default 1.
  *   - endianness: b: Deltas use host byte order by default; this option allows choosing
  * (G_BIG_ENDIAN or G_LITTLE_ENDIAN)
  *   - filename: ^ay: Save delta superblock to this filename (bytestring), and parts in the same
@@ -1266,13 +1850,11 @@ ostree_repo_static_delta_generate (OstreeRepo *self, OstreeStaticDeltaGenerateOp
   DeltaOpts delta_opts = DELTAOPT_FLAG_NONE;
   guint64 total_compressed_size = 0;
   guint64 total_uncompressed_size = 0;
-  g_autoptr (GVariantBuilder) part_headers = NULL;
   g_autoptr (GPtrArray) part_temp_paths = NULL;
   g_autoptr (GVariant) to_commit = NULL;
   const char *opt_filename;
   g_autofree char *descriptor_name = NULL;
   glnx_autofd int descriptor_dfd = -1;
-  g_autoptr (GVariant) fallback_headers = NULL;
   g_autoptr (GVariant) detached = NULL;
   gboolean inline_parts;
   guint endianness = G_BYTE_ORDER;
@@ -1293,10 +1875,45 @@ ostree_repo_static_delta_generate (OstreeRepo *self, OstreeStaticDeltaGenerateOp
   if (!g_variant_lookup (params, "max-bsdiff-size", "u", &max_bsdiff_size))
     max_bsdiff_size = 128;
   builder.max_bsdiff_size_bytes = ((guint64)max_bsdiff_size) * 1000 * 1000;
+  guint bsdiff_memory_budget;
+  if (!g_variant_lookup (params, "bsdiff-memory-budget", "u", &bsdiff_memory_budget))
+    bsdiff_memory_budget = 0;
+  builder.bsdiff_memory_budget_bytes = ((guint64)bsdiff_memory_budget) * 1000 * 1000;
   if (!g_variant_lookup (params, "max-chunk-size", "u", &max_chunk_size))
     max_chunk_size = 32;
   builder.max_chunk_size_bytes = ((guint64)max_chunk_size) * 1000 * 1000;
 
+  guint target_parts;
+  if (!g_variant_lookup (params, "target-parts", "u", &target_parts))
+    target_parts = 0;
+  builder.target_part_count = target_parts;
+
+  guint n_threads;
+  if (!g_variant_lookup (params, "n-threads", "u", &n_threads))
+    n_threads = 1;
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+  builder.n_threads = n_threads;
+
+  guint n_compress_threads;
+  if (!g_variant_lookup (params, "compress-threads", "u", &n_compress_threads))
+    n_compress_threads = 1;
+  if (n_compress_threads == 0)
+    n_compress_threads = g_get_num_processors ();
+  builder.n_compress_threads = n_compress_threads;
+
+  guint8 compression_type;
+  if (!g_variant_lookup (params, "compression", "y", &compression_type))
+    compression_type = 'x';
+  if (!(compression_type == 'x' || compression_type == 'z'))
+    return glnx_throw (error, "Invalid compression type '%u'", compression_type);
+  builder.compression_type = compression_type;
+
+  gint32 compression_level;
+  if (!g_variant_lookup (params, "compression-level", "i", &compression_level))
+    compression_level = 0;
+  builder.compression_level = compression_level;
+
   (void)g_variant_lookup (params, "endianness", "u", &endianness);
   if (!(endianness == G_BIG_ENDIAN || endianness == G_LITTLE_ENDIAN))
     return glnx_throw (error, "Invalid endianness parameter");
@@ -1421,7 +2038,19 @@ ostree_repo_static_delta_generate (OstreeRepo *self, OstreeStaticDeltaGenerateOp
       return FALSE;
   }
 
-  part_headers = g_variant_builder_new (G_VARIANT_TYPE ("a" OSTREE_STATIC_DELTA_META_ENTRY_FORMAT));
+  /* Deltas using part formats legacy clients can't apply carry their
+   * required capabilities, so capability-aware clients skip them cleanly
+   * instead of failing mid-application.
+   */
+  if (builder.compression_type == 'z')
+    {
+      const char *const required_caps[] = { "zstd", NULL };
+      if (!ot_variant_builder_add (descriptor_builder, error, "{sv}",
+                                   OSTREE_STATIC_DELTA_META_REQUIRED_CAPS,
+                                   g_variant_new_strv (required_caps, -1)))
+        return FALSE;
+    }
+
   part_temp_paths = g_ptr_array_new_with_free_func ((GDestroyNotify)glnx_tmpfile_clear);
   for (i = 0; i < builder.parts->len; i++)
     {
@@ -1455,15 +2084,10 @@ ostree_repo_static_delta_generate (OstreeRepo *self, OstreeStaticDeltaGenerateOp
             return FALSE;
         }
 
-      g_variant_builder_add_value (part_headers, part_builder->header);
-
       total_compressed_size += part_builder->compressed_size;
       total_uncompressed_size += part_builder->uncompressed_size;
     }
 
-  if (!get_fallback_headers (self, &builder, &fallback_headers, cancellable, error))
-    return FALSE;
-
   if (!ostree_repo_read_commit_detached_metadata (self, to, &detached, cancellable, error))
     return FALSE;
 
@@ -1492,10 +2116,26 @@ ostree_repo_static_delta_generate (OstreeRepo *self, OstreeStaticDeltaGenerateOp
         || !ot_variant_builder_add_value (descriptor_builder, to_csum_v, error)
         || !ot_variant_builder_add_value (descriptor_builder, to_commit, error)
         || !ot_variant_builder_add_value (descriptor_builder,
-                                          ot_gvariant_new_bytearray ((guchar *)"", 0), error)
-        || !ot_variant_builder_add_value (descriptor_builder, g_variant_builder_end (part_headers),
-                                          error)
-        || !ot_variant_builder_add_value (descriptor_builder, fallback_headers, error))
+                                          ot_gvariant_new_bytearray ((guchar *)"", 0), error))
+      return FALSE;
+
+    /* Stream out the part headers, then the fallback headers, rather than
+     * accumulating either array in memory first.
+     */
+    if (!ot_variant_builder_open (descriptor_builder,
+                                  G_VARIANT_TYPE ("a" OSTREE_STATIC_DELTA_META_ENTRY_FORMAT),
+                                  error))
+      return FALSE;
+    for (i = 0; i < builder.parts->len; i++)
+      {
+        OstreeStaticDeltaPartBuilder *part_builder = builder.parts->pdata[i];
+        if (!ot_variant_builder_add_value (descriptor_builder, part_builder->header, error))
+          return FALSE;
+      }
+    if (!ot_variant_builder_close (descriptor_builder, error))
+      return FALSE;
+
+    if (!write_fallback_headers (self, &builder, descriptor_builder, cancellable, error))
       return FALSE;
 
     if (!ot_variant_builder_end (descriptor_builder, error))
@@ -30,6 +30,10 @@
 #include <gio/gunixinputstream.h>
 #include <gio/gunixoutputstream.h>
 
+#ifdef HAVE_ZSTD
+#include "ostree-zstd-decompressor.h"
+#endif
+
 gboolean
 _ostree_static_delta_parse_checksum_array (GVariant *array, guint8 **out_checksums_array,
                                            guint *out_n_checksums, GError **error)
@@ -707,6 +711,23 @@ _ostree_static_delta_part_open (GInputStream *part_in, GBytes *inline_part_bytes
             G_VARIANT_TYPE (OSTREE_STATIC_DELTA_PART_PAYLOAD_FORMAT_V0), buf, FALSE);
       }
       break;
+    case 'z':
+#ifdef HAVE_ZSTD
+      {
+        g_autoptr (GConverter) decomp = (GConverter *)_ostree_zstd_decompressor_new ();
+        g_autoptr (GInputStream) convin = g_converter_input_stream_new (source_in, decomp);
+        g_autoptr (GBytes) buf = ot_map_anonymous_tmpfile_from_content (convin, cancellable, error);
+        if (!buf)
+          return FALSE;
+
+        ret_part = g_variant_new_from_bytes (
+            G_VARIANT_TYPE (OSTREE_STATIC_DELTA_PART_PAYLOAD_FORMAT_V0), buf, FALSE);
+      }
+      break;
+#else
+      return glnx_throw (error,
+                         "Delta part is zstd-compressed, but this ostree build lacks zstd support");
+#endif
     default:
       return glnx_throw (error, "Invalid compression type '%u'", comptype);
     }
@@ -898,6 +919,53 @@ _ostree_delta_needs_byteswap (GVariant *superblock)
     }
 }
 
+/* Capability strings for delta formats this build can apply.  Servers can
+ * publish next-generation deltas alongside legacy ones and mark them with
+ * OSTREE_STATIC_DELTA_META_REQUIRED_CAPS; clients that lack a required
+ * capability fall back rather than failing mid-application.  New formats
+ * (e.g. alternate part encodings) add their string here along with the
+ * decode support.
+ */
+const char *const *
+_ostree_delta_client_capabilities (void)
+{
+  static const char *caps[] = {
+    "lzma",
+#ifdef HAVE_ZSTD
+    "zstd",
+#endif
+    NULL,
+  };
+  return caps;
+}
+
+/* Check the superblock metadata's required-capabilities entry (if any)
+ * against what this client supports.  Returns %TRUE if the delta is
+ * applicable; otherwise %FALSE with the first missing capability in
+ * @out_missing.
+ */
+gboolean
+_ostree_delta_check_required_capabilities (GVariant *superblock_metadata, char **out_missing)
+{
+  g_autofree const char **required = NULL;
+  if (!g_variant_lookup (superblock_metadata, OSTREE_STATIC_DELTA_META_REQUIRED_CAPS, "^a&s",
+                         &required))
+    return TRUE;
+
+  const char *const *supported = _ostree_delta_client_capabilities ();
+  for (const char **req = required; *req != NULL; req++)
+    {
+      if (!g_strv_contains (supported, *req))
+        {
+          if (out_missing)
+            *out_missing = g_strdup (*req);
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
 gboolean
 _ostree_repo_static_delta_delete (OstreeRepo *self, const char *delta_id, GCancellable *cancellable,
                                   GError **error)
@@ -1121,6 +1189,183 @@ _ostree_repo_static_delta_dump (OstreeRepo *self, const char *delta_id, GCancell
   return TRUE;
 }
 
+/* State shared with the per-part fsck workers; the first failure wins and
+ * later parts are skipped.
+ */
+typedef struct
+{
+  OstreeRepo *repo;
+  const char *from;
+  const char *to;
+  GVariant *meta_entries;
+  gboolean swap_endian;
+  GCancellable *cancellable;
+  GMutex lock;
+  GError *caught_error; /* protected by lock */
+} DeltaFsckState;
+
+/* Verify one delta part against its superblock header: the blob must exist,
+ * match the declared compressed size, parse as a part payload, and hash to
+ * the declared checksum.  Notably this does not execute any opcodes.
+ */
+static gboolean
+fsck_one_part (DeltaFsckState *state, guint i, GError **error)
+{
+  guint32 version;
+  guint64 size;
+  g_autoptr (GVariant) csum_v = NULL;
+  g_variant_get_child (state->meta_entries, i, "(u@aytt@ay)", &version, &csum_v, &size, NULL, NULL);
+  size = maybe_swap_endian_u64 (state->swap_endian, size);
+
+  if (version > OSTREE_DELTAPART_VERSION)
+    return glnx_throw (error, "Delta part has too new version %u", version);
+
+  const guchar *csum = ostree_checksum_bytes_peek_validate (csum_v, error);
+  if (!csum)
+    return FALSE;
+  char checksum[OSTREE_SHA256_STRING_LEN + 1];
+  ostree_checksum_inplace_from_bytes (csum, checksum);
+
+  g_autofree char *part_path
+      = _ostree_get_relative_static_delta_part_path (state->from, state->to, i);
+  glnx_autofd int part_fd = openat (state->repo->repo_dir_fd, part_path, O_RDONLY | O_CLOEXEC);
+  if (part_fd < 0)
+    return glnx_throw_errno_prefix (error, "openat(%s)", part_path);
+
+  struct stat stbuf;
+  if (!glnx_fstat (part_fd, &stbuf, error))
+    return FALSE;
+  if ((guint64)stbuf.st_size != size)
+    return glnx_throw (error,
+                       "Delta part size mismatch; superblock says %" G_GUINT64_FORMAT
+                       " bytes, file has %" G_GUINT64_FORMAT,
+                       size, (guint64)stbuf.st_size);
+
+  g_autoptr (GInputStream) part_in = g_unix_input_stream_new (part_fd, FALSE);
+  g_autoptr (GVariant) part = NULL;
+  if (!_ostree_static_delta_part_open (part_in, NULL, 0, checksum, &part, state->cancellable,
+                                       error))
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+delta_fsck_worker (gpointer data, gpointer user_data)
+{
+  DeltaFsckState *state = user_data;
+  const guint i = GPOINTER_TO_UINT (data) - 1;
+
+  g_mutex_lock (&state->lock);
+  gboolean skip
+      = (state->caught_error != NULL) || g_cancellable_is_cancelled (state->cancellable);
+  g_mutex_unlock (&state->lock);
+  if (skip)
+    return;
+
+  g_autoptr (GError) local_error = NULL;
+  if (!fsck_one_part (state, i, &local_error))
+    {
+      g_prefix_error (&local_error, "Part %u: ", i);
+      g_mutex_lock (&state->lock);
+      if (state->caught_error == NULL)
+        state->caught_error = g_steal_pointer (&local_error);
+      g_mutex_unlock (&state->lock);
+    }
+}
+
+/* Validate the superblock and every part of @delta_id without applying it:
+ * structural checks on the superblock, then per-part size and checksum
+ * verification, parallelized across parts.  Used by `ostree fsck --deltas`
+ * so mirrors catch corrupted deltas before clients do.
+ */
+gboolean
+_ostree_repo_static_delta_fsck (OstreeRepo *self, const char *delta_id, guint n_threads,
+                                GCancellable *cancellable, GError **error)
+{
+  g_autofree char *from = NULL;
+  g_autofree char *to = NULL;
+  if (!_ostree_parse_delta_name (delta_id, &from, &to, error))
+    return FALSE;
+
+  glnx_autofd int superblock_fd = -1;
+  g_autofree char *superblock_path = _ostree_get_relative_static_delta_superblock_path (from, to);
+  if (!glnx_openat_rdonly (self->repo_dir_fd, superblock_path, TRUE, &superblock_fd, error))
+    return FALSE;
+
+  g_autoptr (GVariant) delta_superblock = NULL;
+  if (_ostree_repo_static_delta_is_signed (self, superblock_fd, NULL, NULL))
+    {
+      g_autoptr (GVariant) delta = NULL;
+      if (!ot_variant_read_fd (superblock_fd, 0, (GVariantType *)OSTREE_STATIC_DELTA_SIGNED_FORMAT,
+                               FALSE, &delta, error))
+        return FALSE;
+
+      g_autoptr (GVariant) child = g_variant_get_child_value (delta, 1);
+      g_autoptr (GBytes) bytes = g_variant_get_data_as_bytes (child);
+      delta_superblock = g_variant_ref_sink (g_variant_new_from_bytes (
+          (GVariantType *)OSTREE_STATIC_DELTA_SUPERBLOCK_FORMAT, bytes, FALSE));
+    }
+  else
+    {
+      if (!ot_variant_read_fd (superblock_fd, 0,
+                               (GVariantType *)OSTREE_STATIC_DELTA_SUPERBLOCK_FORMAT, FALSE,
+                               &delta_superblock, error))
+        return FALSE;
+    }
+
+  /* Structural consistency of the superblock itself */
+  g_autoptr (GVariant) from_commit_v = g_variant_get_child_value (delta_superblock, 2);
+  if (g_variant_n_children (from_commit_v) > 0
+      && !ostree_checksum_bytes_peek_validate (from_commit_v, error))
+    return FALSE;
+  g_autoptr (GVariant) to_commit_v = g_variant_get_child_value (delta_superblock, 3);
+  if (!ostree_checksum_bytes_peek_validate (to_commit_v, error))
+    return FALSE;
+
+  gboolean was_heuristic;
+  OstreeDeltaEndianness endianness = _ostree_delta_get_endianness (delta_superblock, &was_heuristic);
+  if (endianness == OSTREE_DELTA_ENDIAN_INVALID)
+    return glnx_throw (error, "Invalid endianness in superblock");
+  const gboolean swap_endian = (endianness == OSTREE_DELTA_ENDIAN_BIG)
+                                   ? (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+                                   : (G_BYTE_ORDER == G_BIG_ENDIAN);
+
+  g_autoptr (GVariant) meta_entries = NULL;
+  g_variant_get_child (delta_superblock, 6, "@a" OSTREE_STATIC_DELTA_META_ENTRY_FORMAT,
+                       &meta_entries);
+  const guint n_parts = g_variant_n_children (meta_entries);
+
+  DeltaFsckState state = {
+    0,
+  };
+  state.repo = self;
+  state.from = from;
+  state.to = to;
+  state.meta_entries = meta_entries;
+  state.swap_endian = swap_endian;
+  state.cancellable = cancellable;
+  g_mutex_init (&state.lock);
+
+  {
+    g_autoptr (OtThreadPool) pool
+        = ot_thread_pool_new ("delta-fsck", delta_fsck_worker, &state,
+                              MAX (1, MIN (n_threads, n_parts)));
+    for (guint i = 0; i < n_parts; i++)
+      ot_thread_pool_push (pool, GUINT_TO_POINTER (i + 1));
+    /* Teardown waits for the workers */
+  }
+
+  gboolean ret = TRUE;
+  if (state.caught_error != NULL)
+    {
+      g_propagate_error (error, g_steal_pointer (&state.caught_error));
+      ret = FALSE;
+    }
+  g_mutex_clear (&state.lock);
+  return ret;
+}
+
 /**
  * ostree_repo_static_delta_verify_signature:
  * @self: Repo
@@ -1196,6 +1441,39 @@ file_has_content (OstreeRepo *repo, const char *subpath, GBytes *data, GCancella
   return g_bytes_equal (existing_data, data);
 }
 
+/* Try to reuse the digest for @delta_name from the previous index: valid if
+ * the entry exists and the superblock hasn't been modified since the index
+ * was written.  Returns %NULL (without error) if the digest has to be
+ * recomputed.
+ */
+static GVariant *
+reuse_indexed_superblock_digest (OstreeRepo *repo, GVariant *old_deltas,
+                                 const struct stat *index_stbuf, const char *delta_name,
+                                 const char *from, const char *to)
+{
+  if (old_deltas == NULL)
+    return NULL;
+
+  g_autoptr (GVariant) digest = g_variant_lookup_value (old_deltas, delta_name, NULL);
+  if (digest == NULL)
+    return NULL;
+
+  g_autofree char *superblock_path = _ostree_get_relative_static_delta_superblock_path (from, to);
+  struct stat superblock_stbuf;
+  if (!glnx_fstatat (repo->repo_dir_fd, superblock_path, &superblock_stbuf, 0, NULL))
+    return NULL;
+
+  /* A superblock at least as new as the index may have been regenerated
+   * after the index was written; recompute to be safe.
+   */
+  if (superblock_stbuf.st_mtim.tv_sec > index_stbuf->st_mtim.tv_sec
+      || (superblock_stbuf.st_mtim.tv_sec == index_stbuf->st_mtim.tv_sec
+          && superblock_stbuf.st_mtim.tv_nsec >= index_stbuf->st_mtim.tv_nsec))
+    return NULL;
+
+  return g_steal_pointer (&digest);
+}
+
 /**
  * ostree_repo_static_delta_reindex:
  * @repo: Repo
@@ -1318,6 +1596,27 @@ ostree_repo_static_delta_reindex (OstreeRepo *repo, OstreeStaticDeltaIndexFlags
           g_autoptr (GVariant) index_variant = NULL;
           g_autoptr (GBytes) index = NULL;
 
+          /* Load the previous index (if any) so unchanged deltas don't
+           * require re-reading and re-hashing every superblock; with many
+           * deltas that full rescan dominates summary update time.
+           */
+          g_autoptr (GVariant) old_deltas = NULL;
+          struct stat index_stbuf = {
+            0,
+          };
+          {
+            glnx_autofd int index_fd = -1;
+            if (ot_openat_ignore_enoent (repo->repo_dir_fd, index_path, &index_fd, NULL)
+                && index_fd >= 0 && fstat (index_fd, &index_stbuf) == 0)
+              {
+                g_autoptr (GVariant) old_index = NULL;
+                if (ot_variant_read_fd (index_fd, 0, G_VARIANT_TYPE ("a{sv}"), FALSE, &old_index,
+                                        NULL))
+                  old_deltas = g_variant_lookup_value (old_index, OSTREE_SUMMARY_STATIC_DELTAS,
+                                                       G_VARIANT_TYPE ("a{sv}"));
+              }
+          }
+
           /* We sort on from here so that the index file is reproducible */
           g_ptr_array_sort (froms, (GCompareFunc)g_strcmp0);
 
@@ -1327,18 +1626,23 @@ ostree_repo_static_delta_reindex (OstreeRepo *repo, OstreeStaticDeltaIndexFlags
             {
               const char *from = g_ptr_array_index (froms, i);
               g_autofree char *delta_name = NULL;
-              GVariant *digest;
-
-              digest = _ostree_repo_static_delta_superblock_digest (repo, from, to, cancellable,
-                                                                    error);
-              if (digest == NULL)
-                return FALSE;
 
               if (from != NULL)
                 delta_name = g_strconcat (from, "-", to, NULL);
               else
                 delta_name = g_strdup (to);
 
+              g_autoptr (GVariant) digest = reuse_indexed_superblock_digest (
+                  repo, old_deltas, &index_stbuf, delta_name, from, to);
+              if (digest == NULL)
+                {
+                  GVariant *computed = _ostree_repo_static_delta_superblock_digest (
+                      repo, from, to, cancellable, error);
+                  if (computed == NULL)
+                    return FALSE;
+                  digest = g_variant_ref_sink (computed);
+                }
+
               g_variant_dict_insert_value (&deltas_builder, delta_name, digest);
             }
 
@@ -33,7 +33,7 @@ G_BEGIN_DECLS
 /**
  * OSTREE_STATIC_DELTA_PART_PAYLOAD_FORMAT_V0:
  *
- *   y  compression type (0: none, 'x': lzma)
+ *   y  compression type (0: none, 'x': lzma, 'z': zstd)
  *   ---
  *   a(uuu) modes
  *   aa(ayay) xattrs
@@ -160,6 +160,15 @@ void _ostree_static_delta_part_execute_async (OstreeRepo *repo, GVariant *header
                                               GVariant *part_payload, GCancellable *cancellable,
                                               GAsyncReadyCallback callback, gpointer user_data);
 
+void _ostree_static_delta_part_open_execute_async (OstreeRepo *repo, GVariant *header,
+                                                   GInputStream *part_in,
+                                                   GBytes *inline_part_bytes,
+                                                   OstreeStaticDeltaOpenFlags flags,
+                                                   const char *expected_checksum,
+                                                   GCancellable *cancellable,
+                                                   GAsyncReadyCallback callback,
+                                                   gpointer user_data);
+
 gboolean _ostree_static_delta_part_execute_finish (OstreeRepo *repo, GAsyncResult *result,
                                                    GError **error);
 
@@ -198,6 +207,9 @@ GVariant *_ostree_repo_static_delta_superblock_digest (OstreeRepo *repo, const c
 gboolean _ostree_repo_static_delta_dump (OstreeRepo *repo, const char *delta_id,
                                          GCancellable *cancellable, GError **error);
 
+gboolean _ostree_repo_static_delta_fsck (OstreeRepo *repo, const char *delta_id, guint n_threads,
+                                         GCancellable *cancellable, GError **error);
+
 gboolean _ostree_repo_static_delta_delete (OstreeRepo *repo, const char *delta_id,
                                            GCancellable *cancellable, GError **error);
 gboolean _ostree_repo_static_delta_reindex (OstreeRepo *repo, const char *opt_to_commit,
@@ -236,4 +248,20 @@ OstreeDeltaEndianness _ostree_delta_get_endianness (GVariant *superblock,
 
 gboolean _ostree_delta_needs_byteswap (GVariant *superblock);
 
+/* Superblock metadata (a{sv}) key holding an "as" of capability strings a
+ * client must support to apply the delta; absent means applicable by any
+ * client.  See _ostree_delta_client_capabilities().
+ */
+#define OSTREE_STATIC_DELTA_META_REQUIRED_CAPS "ostree.required-caps"
+
+/* HTTP request header under which pull advertises the client's delta
+ * capabilities, for servers that vary delta selection per client.
+ */
+#define OSTREE_DELTA_CAPABILITIES_HEADER "OSTree-Delta-Capabilities"
+
+const char *const *_ostree_delta_client_capabilities (void);
+
+gboolean _ostree_delta_check_required_capabilities (GVariant *superblock_metadata,
+                                                    char **out_missing);
+
 G_END_DECLS
@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include <string.h>
+#include <sys/mman.h>
 
 #include <gio/gfiledescriptorbased.h>
 #include <gio/gunixinputstream.h>
@@ -38,6 +39,11 @@
 /* This should really always be true, but hey, let's just assert it */
 G_STATIC_ASSERT (sizeof (guint) >= sizeof (guint32));
 
+/* bspatch outputs larger than this are staged in a file-backed mapping
+ * instead of the heap; see dispatch_bspatch().
+ */
+#define BSPATCH_HEAP_BUFFER_MAX (1 * 1024 * 1024)
+
 typedef struct
 {
   gboolean stats_only;
@@ -49,6 +55,13 @@ typedef struct
   const guint8 *opdata;
   guint oplen;
 
+  /* Arguments of the currently executing decoded op; see
+   * static_delta_decode_ops() and read_op_arg().
+   */
+  const guint64 *op_args;
+  guint op_n_args;
+  guint op_arg_index;
+
   GVariant *mode_dict;
   GVariant *xattr_dict;
 
@@ -103,16 +116,109 @@ static_delta_execution_state_init (StaticDeltaExecutionState *state)
   state->read_source_fd = -1;
 }
 
+/* Pop the next argument of the currently executing op; the varints were
+ * already decoded in a batch by static_delta_decode_ops().
+ */
 static gboolean
 read_varuint64 (StaticDeltaExecutionState *state, guint64 *out_value, GError **error)
 {
-  gsize bytes_read;
-  if (!_ostree_read_varuint64 (state->opdata, state->oplen, out_value, &bytes_read))
+  if (state->op_arg_index >= state->op_n_args)
+    return glnx_throw (error, "%s", "Unexpected EOF reading varint");
+  *out_value = state->op_args[state->op_arg_index];
+  state->op_arg_index++;
+  return TRUE;
+}
+
+/* Maximum number of varint arguments any single opcode consumes
+ * (OPEN_SPLICE_AND_CLOSE for a content object).
+ */
+#define STATIC_DELTA_OP_MAX_ARGS 4
+
+typedef struct
+{
+  guint8 opcode;
+  guint8 n_args;
+  guint64 args[STATIC_DELTA_OP_MAX_ARGS];
+} StaticDeltaDecodedOp;
+
+/* Decode the whole opcode stream into an array of ops with their varint
+ * arguments in a single pass, so that execution is a tight loop over
+ * fixed-size entries.  One varint decode call per op (instead of one per
+ * argument, each with per-byte bounds checks) measurably reduces the
+ * interpreter overhead of applying deltas with many small objects.
+ *
+ * The argument count of most opcodes is fixed; OPEN_SPLICE_AND_CLOSE takes
+ * two extra arguments for content objects, so we track the checksum index
+ * here the same way execution does (it advances on each close).
+ */
+static gboolean
+static_delta_decode_ops (StaticDeltaExecutionState *state, GArray **out_ops, GError **error)
+{
+  g_autoptr (GArray) decoded_ops
+      = g_array_sized_new (FALSE, FALSE, sizeof (StaticDeltaDecodedOp), state->oplen / 2 + 1);
+  guint checksum_index = state->checksum_index;
+
+  while (state->oplen > 0)
     {
-      return glnx_throw (error, "%s", "Unexpected EOF reading varint");
+      StaticDeltaDecodedOp op;
+
+      op.opcode = state->opdata[0];
+      state->opdata++;
+      state->oplen--;
+
+      switch (op.opcode)
+        {
+        case OSTREE_STATIC_DELTA_OP_OPEN_SPLICE_AND_CLOSE:
+          {
+            if (checksum_index >= state->n_checksums)
+              return glnx_throw (error, "Missing object for checksum index %u", checksum_index);
+            guint8 objtype
+                = state->checksums[checksum_index * OSTREE_STATIC_DELTA_OBJTYPE_CSUM_LEN];
+            if (G_UNLIKELY (!ostree_validate_structureof_objtype (objtype, error)))
+              return FALSE;
+            op.n_args = OSTREE_OBJECT_TYPE_IS_META (objtype) ? 2 : 4;
+            checksum_index++;
+          }
+          break;
+        case OSTREE_STATIC_DELTA_OP_OPEN:
+          op.n_args = 3;
+          break;
+        case OSTREE_STATIC_DELTA_OP_WRITE:
+          op.n_args = 2;
+          break;
+        case OSTREE_STATIC_DELTA_OP_SET_READ_SOURCE:
+          op.n_args = 1;
+          break;
+        case OSTREE_STATIC_DELTA_OP_UNSET_READ_SOURCE:
+          op.n_args = 0;
+          break;
+        case OSTREE_STATIC_DELTA_OP_CLOSE:
+          op.n_args = 0;
+          checksum_index++;
+          break;
+        case OSTREE_STATIC_DELTA_OP_BSPATCH:
+          op.n_args = 2;
+          break;
+        default:
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                       "Unknown opcode %u at offset %u", op.opcode, decoded_ops->len);
+          return FALSE;
+        }
+
+      if (op.n_args > 0)
+        {
+          gsize bytes_read;
+          if (!_ostree_read_varuint64_multi (state->opdata, state->oplen, op.args, op.n_args,
+                                             &bytes_read))
+            return glnx_throw (error, "%s", "Unexpected EOF reading varint");
+          state->opdata += bytes_read;
+          state->oplen -= bytes_read;
+        }
+
+      g_array_append_val (decoded_ops, op);
     }
-  state->opdata += bytes_read;
-  state->oplen -= bytes_read;
+
+  *out_ops = g_steal_pointer (&decoded_ops);
   return TRUE;
 }
 
@@ -172,6 +278,7 @@ _ostree_static_delta_part_execute (OstreeRepo *repo, GVariant *objects, GVariant
   g_autoptr (GVariant) xattr_dict = NULL;
   g_autoptr (GVariant) payload = NULL;
   g_autoptr (GVariant) ops = NULL;
+  g_autoptr (GArray) decoded_ops = NULL;
   StaticDeltaExecutionState statedata = {
     0,
   };
@@ -180,6 +287,8 @@ _ostree_static_delta_part_execute (OstreeRepo *repo, GVariant *objects, GVariant
 
   static_delta_execution_state_init (&statedata);
 
+  ot_tracepoint1 (delta_part_apply, (guint64)g_variant_get_size (part));
+
   state->repo = repo;
   state->async_error = error;
   state->stats_only = stats_only;
@@ -208,13 +317,17 @@ _ostree_static_delta_part_execute (OstreeRepo *repo, GVariant *objects, GVariant
   state->oplen = g_variant_n_children (ops);
   state->opdata = g_variant_get_data (ops);
 
-  while (state->oplen > 0)
+  if (!static_delta_decode_ops (state, &decoded_ops, error))
+    goto out;
+
+  for (guint i = 0; i < decoded_ops->len; i++)
     {
-      guint8 opcode;
+      const StaticDeltaDecodedOp *op = &g_array_index (decoded_ops, StaticDeltaDecodedOp, i);
+      guint8 opcode = op->opcode;
 
-      opcode = state->opdata[0];
-      state->oplen--;
-      state->opdata++;
+      state->op_args = op->args;
+      state->op_n_args = op->n_args;
+      state->op_arg_index = 0;
 
       if (g_cancellable_set_error_if_cancelled (cancellable, error))
         goto out;
@@ -274,6 +387,10 @@ typedef struct
   OstreeRepo *repo;
   GVariant *header;
   GVariant *part;
+  GInputStream *part_in;
+  GBytes *inline_part_bytes;
+  OstreeStaticDeltaOpenFlags open_flags;
+  char *expected_checksum;
   GCancellable *cancellable;
 } StaticDeltaPartExecuteAsyncData;
 
@@ -284,7 +401,10 @@ static_delta_part_execute_async_data_free (gpointer user_data)
 
   g_clear_object (&data->repo);
   g_variant_unref (data->header);
-  g_variant_unref (data->part);
+  g_clear_pointer (&data->part, g_variant_unref);
+  g_clear_object (&data->part_in);
+  g_clear_pointer (&data->inline_part_bytes, g_bytes_unref);
+  g_free (data->expected_checksum);
   g_clear_object (&data->cancellable);
   g_free (data);
 }
@@ -296,6 +416,18 @@ static_delta_part_execute_thread (GTask *task, GObject *object, gpointer datap,
   GError *error = NULL;
   StaticDeltaPartExecuteAsyncData *data = datap;
 
+  /* When given an unopened part, the checksum and decompression work also
+   * happens on this worker thread, keeping it off the pull main loop.
+   */
+  if (data->part == NULL
+      && !_ostree_static_delta_part_open (data->part_in, data->inline_part_bytes, data->open_flags,
+                                          data->expected_checksum, &data->part, cancellable,
+                                          &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
   if (!_ostree_static_delta_part_execute (data->repo, data->header, data->part, FALSE, NULL,
                                           cancellable, &error))
     g_task_return_error (task, error);
@@ -323,6 +455,37 @@ _ostree_static_delta_part_execute_async (OstreeRepo *repo, GVariant *header, GVa
   g_task_run_in_thread (task, (GTaskThreadFunc)static_delta_part_execute_thread);
 }
 
+/* Like _ostree_static_delta_part_execute_async(), but takes an unopened part;
+ * checksum verification and decompression run on the worker thread too, so
+ * fetched parts can be applied in parallel across cores.  Completion is
+ * collected with _ostree_static_delta_part_execute_finish().
+ */
+void
+_ostree_static_delta_part_open_execute_async (OstreeRepo *repo, GVariant *header,
+                                              GInputStream *part_in, GBytes *inline_part_bytes,
+                                              OstreeStaticDeltaOpenFlags flags,
+                                              const char *expected_checksum,
+                                              GCancellable *cancellable,
+                                              GAsyncReadyCallback callback, gpointer user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  StaticDeltaPartExecuteAsyncData *asyncdata;
+
+  asyncdata = g_new0 (StaticDeltaPartExecuteAsyncData, 1);
+  asyncdata->repo = g_object_ref (repo);
+  asyncdata->header = g_variant_ref (header);
+  asyncdata->part_in = g_object_ref (part_in);
+  asyncdata->inline_part_bytes = inline_part_bytes ? g_bytes_ref (inline_part_bytes) : NULL;
+  asyncdata->open_flags = flags;
+  asyncdata->expected_checksum = g_strdup (expected_checksum);
+  asyncdata->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+
+  task = g_task_new (G_OBJECT (repo), cancellable, callback, user_data);
+  g_task_set_task_data (task, asyncdata, (GDestroyNotify)static_delta_part_execute_async_data_free);
+  g_task_set_source_tag (task, _ostree_static_delta_part_execute_async);
+  g_task_run_in_thread (task, (GTaskThreadFunc)static_delta_part_execute_thread);
+}
+
 gboolean
 _ostree_static_delta_part_execute_finish (OstreeRepo *repo, GAsyncResult *result, GError **error)
 {
@@ -414,7 +577,36 @@ dispatch_bspatch (OstreeRepo *repo, StaticDeltaExecutionState *state, GCancellab
       if (!input_mfile)
         return FALSE;
 
-      g_autofree guchar *buf = g_malloc0 (state->content_size);
+      /* Back the patch output with an anonymous tmpfile rather than the heap.
+       * The payload mapping is already file-backed (see
+       * _ostree_static_delta_part_open()), so this keeps peak anonymous memory
+       * during delta application bounded regardless of object size - important
+       * for low-RAM devices applying deltas containing large files.  Small
+       * outputs stay on the heap to avoid mmap/ftruncate round trips.
+       */
+      g_autofree guchar *malloc_buf = NULL;
+      guchar *buf;
+      g_auto (GLnxTmpfile) buf_tmpf = {
+        0,
+      };
+      gsize map_len = 0;
+
+      if (state->content_size > BSPATCH_HEAP_BUFFER_MAX)
+        {
+          if (!glnx_open_anonymous_tmpfile (O_RDWR | O_CLOEXEC, &buf_tmpf, error))
+            return FALSE;
+          if (ftruncate (buf_tmpf.fd, state->content_size) < 0)
+            return glnx_throw_errno_prefix (error, "ftruncate");
+          map_len = state->content_size;
+          buf = mmap (NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, buf_tmpf.fd, 0);
+          if (buf == MAP_FAILED)
+            return glnx_throw_errno_prefix (error, "mmap");
+        }
+      else
+        {
+          malloc_buf = g_malloc0 (state->content_size);
+          buf = malloc_buf;
+        }
 
       struct bzpatch_opaque_s opaque;
       opaque.state = state;
@@ -423,13 +615,20 @@ dispatch_bspatch (OstreeRepo *repo, StaticDeltaExecutionState *state, GCancellab
       struct bspatch_stream stream;
       stream.read = bspatch_read;
       stream.opaque = &opaque;
-      if (bspatch ((const guint8 *)g_mapped_file_get_contents (input_mfile),
-                   g_mapped_file_get_length (input_mfile), buf, state->content_size, &stream)
-          < 0)
+      int patch_res = bspatch ((const guint8 *)g_mapped_file_get_contents (input_mfile),
+                               g_mapped_file_get_length (input_mfile), buf, state->content_size,
+                               &stream);
+
+      gboolean write_res = FALSE;
+      if (patch_res == 0)
+        write_res = _ostree_repo_bare_content_write (repo, &state->content_out, buf,
+                                                     state->content_size, cancellable, error);
+      if (map_len > 0)
+        (void)munmap (buf, map_len);
+
+      if (patch_res < 0)
         return glnx_throw (error, "bsdiff patch failed");
-
-      if (!_ostree_repo_bare_content_write (repo, &state->content_out, buf, state->content_size,
-                                            cancellable, error))
+      if (!write_res)
         return FALSE;
     }
 
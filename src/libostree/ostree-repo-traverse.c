@@ -22,6 +22,8 @@
 #include "config.h"
 
 #include "libglnx.h"
+#include "ostree-core-private.h"
+#include "ostree-repo-private.h"
 #include "ostree.h"
 #include "otutil.h"
 
@@ -348,8 +350,8 @@ ostree_repo_traverse_parents_get_commits (GHashTable *parents, GVariant *object)
 
 static gboolean traverse_dirtree (OstreeRepo *repo, const char *checksum, GVariant *parent_key,
                                   GHashTable *inout_reachable, GHashTable *inout_parents,
-                                  gboolean ignore_missing_dirs, GCancellable *cancellable,
-                                  GError **error);
+                                  gboolean metadata_only, gboolean ignore_missing_dirs,
+                                  GCancellable *cancellable, GError **error);
 
 static void
 add_parent_ref (GHashTable *inout_parents, GVariant *key, GVariant *parent_key)
@@ -398,8 +400,8 @@ add_parent_ref (GHashTable *inout_parents, GVariant *key, GVariant *parent_key)
 
 static gboolean
 traverse_iter (OstreeRepo *repo, OstreeRepoCommitTraverseIter *iter, GVariant *parent_key,
-               GHashTable *inout_reachable, GHashTable *inout_parents, gboolean ignore_missing_dirs,
-               GCancellable *cancellable, GError **error)
+               GHashTable *inout_reachable, GHashTable *inout_parents, gboolean metadata_only,
+               gboolean ignore_missing_dirs, GCancellable *cancellable, GError **error)
 {
   while (TRUE)
     {
@@ -427,16 +429,20 @@ traverse_iter (OstreeRepo *repo, OstreeRepoCommitTraverseIter *iter, GVariant *p
         break;
       else if (iterres == OSTREE_REPO_COMMIT_ITER_RESULT_FILE)
         {
-          char *name;
-          char *checksum;
+          /* Content objects are out of scope for a metadata-only traversal */
+          if (!metadata_only)
+            {
+              char *name;
+              char *checksum;
 
-          ostree_repo_commit_traverse_iter_get_file (iter, &name, &checksum);
+              ostree_repo_commit_traverse_iter_get_file (iter, &name, &checksum);
 
-          g_debug ("Found file object %s", checksum);
-          key = g_variant_ref_sink (
-              ostree_object_name_serialize (checksum, OSTREE_OBJECT_TYPE_FILE));
-          add_parent_ref (inout_parents, key, parent_key);
-          g_hash_table_add (inout_reachable, g_steal_pointer (&key));
+              g_debug ("Found file object %s", checksum);
+              key = g_variant_ref_sink (
+                  ostree_object_name_serialize (checksum, OSTREE_OBJECT_TYPE_FILE));
+              add_parent_ref (inout_parents, key, parent_key);
+              g_hash_table_add (inout_reachable, g_steal_pointer (&key));
+            }
         }
       else if (iterres == OSTREE_REPO_COMMIT_ITER_RESULT_DIR)
         {
@@ -459,7 +465,7 @@ traverse_iter (OstreeRepo *repo, OstreeRepoCommitTraverseIter *iter, GVariant *p
           if (!g_hash_table_lookup (inout_reachable, key))
             {
               if (!traverse_dirtree (repo, content_checksum, key, inout_reachable, inout_parents,
-                                     ignore_missing_dirs, cancellable, error))
+                                     metadata_only, ignore_missing_dirs, cancellable, error))
                 return FALSE;
 
               g_hash_table_add (inout_reachable, g_steal_pointer (&key));
@@ -474,7 +480,7 @@ traverse_iter (OstreeRepo *repo, OstreeRepoCommitTraverseIter *iter, GVariant *p
 
 static gboolean
 traverse_dirtree (OstreeRepo *repo, const char *checksum, GVariant *parent_key,
-                  GHashTable *inout_reachable, GHashTable *inout_parents,
+                  GHashTable *inout_reachable, GHashTable *inout_parents, gboolean metadata_only,
                   gboolean ignore_missing_dirs, GCancellable *cancellable, GError **error)
 {
   g_autoptr (GError) local_error = NULL;
@@ -501,8 +507,8 @@ traverse_dirtree (OstreeRepo *repo, const char *checksum, GVariant *parent_key,
                                                       OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE, error))
     return FALSE;
 
-  if (!traverse_iter (repo, &iter, parent_key, inout_reachable, inout_parents, ignore_missing_dirs,
-                      cancellable, error))
+  if (!traverse_iter (repo, &iter, parent_key, inout_reachable, inout_parents, metadata_only,
+                      ignore_missing_dirs, cancellable, error))
     return FALSE;
 
   return TRUE;
@@ -536,6 +542,8 @@ ostree_repo_traverse_commit_with_flags (OstreeRepo *repo, OstreeRepoCommitTraver
 {
   g_autofree char *tmp_checksum = NULL;
   gboolean commit_only = flags & OSTREE_REPO_COMMIT_TRAVERSE_FLAG_COMMIT_ONLY;
+  gboolean metadata_only = flags & OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NO_CONTENT;
+  gboolean tolerate_missing = flags & OSTREE_REPO_COMMIT_TRAVERSE_FLAG_TOLERATE_MISSING;
 
   while (TRUE)
     {
@@ -545,6 +553,41 @@ ostree_repo_traverse_commit_with_flags (OstreeRepo *repo, OstreeRepoCommitTraver
       if (g_hash_table_contains (inout_reachable, key))
         break;
 
+      /* For commit-only traversal all we need is the parent pointer, which
+       * the commit-graph cache can answer without loading the object; we
+       * still check existence since the graph may reference pruned commits.
+       */
+      if (commit_only)
+        {
+          gboolean found = FALSE;
+          g_autofree char *graph_parent = NULL;
+          if (!_ostree_repo_commit_graph_lookup (repo, commit_checksum, &found, &graph_parent,
+                                                 NULL, error))
+            return FALSE;
+          if (found)
+            {
+              gboolean have_commit = FALSE;
+              if (!ostree_repo_has_object (repo, OSTREE_OBJECT_TYPE_COMMIT, commit_checksum,
+                                           &have_commit, cancellable, error))
+                return FALSE;
+              if (!have_commit)
+                break;
+
+              g_hash_table_add (inout_reachable, g_variant_ref (key));
+
+              if ((maxdepth == -1 || maxdepth > 0) && graph_parent != NULL)
+                {
+                  g_free (tmp_checksum);
+                  tmp_checksum = g_steal_pointer (&graph_parent);
+                  commit_checksum = tmp_checksum;
+                  if (maxdepth > 0)
+                    maxdepth -= 1;
+                  continue;
+                }
+              break;
+            }
+        }
+
       g_autoptr (GVariant) commit = NULL;
       if (!ostree_repo_load_variant_if_exists (repo, OSTREE_OBJECT_TYPE_COMMIT, commit_checksum,
                                                &commit, error))
@@ -561,7 +604,7 @@ ostree_repo_traverse_commit_with_flags (OstreeRepo *repo, OstreeRepoCommitTraver
       if (!ostree_repo_load_commit (repo, commit_checksum, NULL, &commitstate, error))
         return FALSE;
 
-      gboolean ignore_missing_dirs = FALSE;
+      gboolean ignore_missing_dirs = tolerate_missing;
       if ((commitstate & OSTREE_REPO_COMMIT_STATE_PARTIAL) != 0)
         ignore_missing_dirs = TRUE;
 
@@ -578,8 +621,8 @@ ostree_repo_traverse_commit_with_flags (OstreeRepo *repo, OstreeRepoCommitTraver
                   &iter, repo, commit, OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE, error))
             return FALSE;
 
-          if (!traverse_iter (repo, &iter, key, inout_reachable, inout_parents, ignore_missing_dirs,
-                              cancellable, error))
+          if (!traverse_iter (repo, &iter, key, inout_reachable, inout_parents, metadata_only,
+                              ignore_missing_dirs, cancellable, error))
             return FALSE;
         }
 
@@ -680,3 +723,542 @@ ostree_repo_traverse_commit (OstreeRepo *repo, const char *commit_checksum, int
     *out_reachable = g_steal_pointer (&ret_reachable);
   return TRUE;
 }
+
+/* State shared by the streaming traversal below.  We only remember
+ * metadata objects (commits, dirtrees, dirmetas) to avoid re-walking
+ * shared subtrees; content objects are reported as found and never
+ * stored, which is what keeps memory usage flat.
+ */
+typedef struct
+{
+  OstreeRepoTraverseObjectCallback callback;
+  gpointer user_data;
+  GHashTable *seen_meta;  /* Set of serialized metadata object names */
+  gboolean metadata_only; /* Don't report content objects */
+} TraverseStreamData;
+
+static gboolean stream_dirtree (OstreeRepo *repo, const char *checksum, TraverseStreamData *data,
+                                gboolean ignore_missing_dirs, GCancellable *cancellable,
+                                GError **error);
+
+static gboolean
+stream_iter (OstreeRepo *repo, OstreeRepoCommitTraverseIter *iter, TraverseStreamData *data,
+             gboolean ignore_missing_dirs, GCancellable *cancellable, GError **error)
+{
+  while (TRUE)
+    {
+      g_autoptr (GError) local_error = NULL;
+      OstreeRepoCommitIterResult iterres
+          = ostree_repo_commit_traverse_iter_next (iter, cancellable, &local_error);
+
+      if (iterres == OSTREE_REPO_COMMIT_ITER_RESULT_ERROR)
+        {
+          if (ignore_missing_dirs
+              && g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+            {
+              g_debug ("Ignoring not-found dirmeta");
+              return TRUE; /* Note early return */
+            }
+
+          g_propagate_error (error, g_steal_pointer (&local_error));
+          return FALSE;
+        }
+      else if (iterres == OSTREE_REPO_COMMIT_ITER_RESULT_END)
+        break;
+      else if (iterres == OSTREE_REPO_COMMIT_ITER_RESULT_FILE)
+        {
+          if (!data->metadata_only)
+            {
+              char *name;
+              char *checksum;
+
+              ostree_repo_commit_traverse_iter_get_file (iter, &name, &checksum);
+
+              if (!data->callback (repo, checksum, OSTREE_OBJECT_TYPE_FILE, data->user_data,
+                                   error))
+                return FALSE;
+            }
+        }
+      else if (iterres == OSTREE_REPO_COMMIT_ITER_RESULT_DIR)
+        {
+          char *name;
+          char *content_checksum;
+          char *meta_checksum;
+
+          ostree_repo_commit_traverse_iter_get_dir (iter, &name, &content_checksum, &meta_checksum);
+
+          g_autoptr (GVariant) meta_key = g_variant_ref_sink (
+              ostree_object_name_serialize (meta_checksum, OSTREE_OBJECT_TYPE_DIR_META));
+          if (g_hash_table_add (data->seen_meta, g_steal_pointer (&meta_key)))
+            {
+              if (!data->callback (repo, meta_checksum, OSTREE_OBJECT_TYPE_DIR_META,
+                                   data->user_data, error))
+                return FALSE;
+            }
+
+          g_autoptr (GVariant) content_key = g_variant_ref_sink (
+              ostree_object_name_serialize (content_checksum, OSTREE_OBJECT_TYPE_DIR_TREE));
+          if (g_hash_table_add (data->seen_meta, g_steal_pointer (&content_key)))
+            {
+              if (!data->callback (repo, content_checksum, OSTREE_OBJECT_TYPE_DIR_TREE,
+                                   data->user_data, error))
+                return FALSE;
+
+              if (!stream_dirtree (repo, content_checksum, data, ignore_missing_dirs, cancellable,
+                                   error))
+                return FALSE;
+            }
+        }
+      else
+        g_assert_not_reached ();
+    }
+
+  return TRUE;
+}
+
+static gboolean
+stream_dirtree (OstreeRepo *repo, const char *checksum, TraverseStreamData *data,
+                gboolean ignore_missing_dirs, GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GError) local_error = NULL;
+
+  g_autoptr (GVariant) dirtree = NULL;
+  if (!ostree_repo_load_variant (repo, OSTREE_OBJECT_TYPE_DIR_TREE, checksum, &dirtree,
+                                 &local_error))
+    {
+      if (ignore_missing_dirs && g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+          g_debug ("Ignoring not-found dirtree %s", checksum);
+          return TRUE; /* Early return */
+        }
+
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return FALSE;
+    }
+
+  g_debug ("Traversing dirtree %s", checksum);
+  ostree_cleanup_repo_commit_traverse_iter OstreeRepoCommitTraverseIter iter = {
+    0,
+  };
+  if (!ostree_repo_commit_traverse_iter_init_dirtree (&iter, repo, dirtree,
+                                                      OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE, error))
+    return FALSE;
+
+  if (!stream_iter (repo, &iter, data, ignore_missing_dirs, cancellable, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Recursive worker for the content size walk below.  @size_cache maps
+ * serialized object names to a malloc'd guint64: for dirtrees the total
+ * content bytes beneath them, for content objects their unpacked size.
+ * Caching dirtree subtotals means a subtree shared between several
+ * directories is walked once but still counted at each appearance, which
+ * matches what a checkout will actually write.
+ */
+static gboolean
+dirtree_content_size_recurse (OstreeRepo *repo, const char *checksum, GHashTable *size_cache,
+                              guint64 *out_size, GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GVariant) dir_key
+      = g_variant_ref_sink (ostree_object_name_serialize (checksum, OSTREE_OBJECT_TYPE_DIR_TREE));
+  const guint64 *cached = g_hash_table_lookup (size_cache, dir_key);
+  if (cached != NULL)
+    {
+      *out_size = *cached;
+      return TRUE;
+    }
+
+  g_autoptr (GVariant) dirtree = NULL;
+  if (!ostree_repo_load_variant (repo, OSTREE_OBJECT_TYPE_DIR_TREE, checksum, &dirtree, error))
+    return FALSE;
+
+  guint64 total = 0;
+
+  OtDirtreeIter iter;
+  if (!_ostree_dirtree_iter_init (&iter, dirtree, error))
+    return FALSE;
+  while (TRUE)
+    {
+      const char *name;
+      const guint8 *csum;
+      if (!_ostree_dirtree_iter_next_file (&iter, &name, &csum, error))
+        return FALSE;
+      if (name == NULL)
+        break;
+
+      char file_checksum[OSTREE_SHA256_STRING_LEN + 1];
+      ostree_checksum_inplace_from_bytes (csum, file_checksum);
+
+      g_autoptr (GVariant) file_key = g_variant_ref_sink (
+          ostree_object_name_serialize (file_checksum, OSTREE_OBJECT_TYPE_FILE));
+      const guint64 *file_cached = g_hash_table_lookup (size_cache, file_key);
+      guint64 size;
+      if (file_cached != NULL)
+        size = *file_cached;
+      else
+        {
+          /* Dirtree entries don't record sizes, so ask the object store;
+           * only the file info is requested, which for bare repos is a
+           * stat() and for archive repos a header read, never content.
+           */
+          g_autoptr (GFileInfo) file_info = NULL;
+          if (!ostree_repo_load_file (repo, file_checksum, NULL, &file_info, NULL, cancellable,
+                                      error))
+            return FALSE;
+          size = (g_file_info_get_file_type (file_info) == G_FILE_TYPE_REGULAR)
+                     ? (guint64)g_file_info_get_size (file_info)
+                     : 0;
+          guint64 *entry = g_new (guint64, 1);
+          *entry = size;
+          g_hash_table_replace (size_cache, g_steal_pointer (&file_key), entry);
+        }
+      total += size;
+    }
+
+  while (TRUE)
+    {
+      const char *name;
+      const guint8 *subtree_csum;
+      const guint8 *submeta_csum;
+      if (!_ostree_dirtree_iter_next_dir (&iter, &name, &subtree_csum, &submeta_csum, error))
+        return FALSE;
+      if (name == NULL)
+        break;
+
+      char subtree_checksum[OSTREE_SHA256_STRING_LEN + 1];
+      ostree_checksum_inplace_from_bytes (subtree_csum, subtree_checksum);
+
+      guint64 subtotal = 0;
+      if (!dirtree_content_size_recurse (repo, subtree_checksum, size_cache, &subtotal, cancellable,
+                                         error))
+        return FALSE;
+      total += subtotal;
+    }
+
+  guint64 *entry = g_new (guint64, 1);
+  *entry = total;
+  g_hash_table_replace (size_cache, g_steal_pointer (&dir_key), entry);
+
+  *out_size = total;
+  return TRUE;
+}
+
+/* Sum the unpacked sizes of all regular file content beneath the dirtree
+ * @dirtree_checksum, counting shared subtrees once per appearance.  Used
+ * by checkout to size progress reporting; see also the public wrapper
+ * ostree_repo_traverse_commit_content_size().
+ */
+gboolean
+_ostree_repo_dirtree_content_size (OstreeRepo *repo, const char *dirtree_checksum,
+                                   guint64 *out_size, GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GHashTable) size_cache = g_hash_table_new_full (
+      ostree_hash_object_name, g_variant_equal, (GDestroyNotify)g_variant_unref, g_free);
+  return dirtree_content_size_recurse (repo, dirtree_checksum, size_cache, out_size, cancellable,
+                                       error);
+}
+
+/**
+ * ostree_repo_traverse_commit_content_size:
+ * @repo: Repo
+ * @commit_checksum: ASCII SHA256 checksum
+ * @out_size: (out): Total unpacked size in bytes of all content reachable from the commit root
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Compute the total number of bytes a full checkout of @commit_checksum
+ * would write for regular file content, by walking the directory tree
+ * metadata.  File content is never loaded, so this is far cheaper than a
+ * checkout; use it to size progress reporting or to check destination
+ * free space up front.
+ *
+ * Content shared between multiple directories is counted once per
+ * appearance, matching what a checkout writes; note that a hardlinked
+ * checkout will write fewer bytes than this.
+ *
+ * Since: 2023.6
+ */
+gboolean
+ostree_repo_traverse_commit_content_size (OstreeRepo *repo, const char *commit_checksum,
+                                          guint64 *out_size, GCancellable *cancellable,
+                                          GError **error)
+{
+  g_autoptr (GVariant) commit = NULL;
+  if (!ostree_repo_load_variant (repo, OSTREE_OBJECT_TYPE_COMMIT, commit_checksum, &commit, error))
+    return FALSE;
+
+  g_autoptr (GVariant) content_csum_bytes = NULL;
+  g_variant_get_child (commit, 6, "@ay", &content_csum_bytes);
+  const guchar *csum = ostree_checksum_bytes_peek_validate (content_csum_bytes, error);
+  if (csum == NULL)
+    return FALSE;
+  char dirtree_checksum[OSTREE_SHA256_STRING_LEN + 1];
+  ostree_checksum_inplace_from_bytes (csum, dirtree_checksum);
+
+  return _ostree_repo_dirtree_content_size (repo, dirtree_checksum, out_size, cancellable, error);
+}
+
+/**
+ * ostree_repo_traverse_commit_with_callback: (skip)
+ * @repo: Repo
+ * @flags: change traversal behaviour according to these flags
+ * @commit_checksum: ASCII SHA256 checksum
+ * @maxdepth: Traverse this many parent commits, -1 for unlimited
+ * @callback: Invoked for each object as it is discovered
+ * @user_data: Data for @callback
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Walk all objects reachable from @commit_checksum, traversing
+ * @maxdepth parent commits, invoking @callback for each object as it
+ * is discovered rather than materializing the full reachable set up
+ * front as ostree_repo_traverse_commit() does.  This lets callers
+ * pipeline their processing with the traversal, and only metadata
+ * objects are retained for deduplication, so memory usage stays
+ * proportional to the number of directories rather than the number of
+ * objects.
+ *
+ * Each metadata object is reported exactly once.  A content object may
+ * be reported more than once if it is referenced from multiple
+ * directory trees; callers requiring exactly-once semantics must
+ * deduplicate themselves.
+ *
+ * If @callback returns %FALSE, it must set @error, and the traversal
+ * is aborted.
+ *
+ * Since: 2023.6
+ */
+gboolean
+ostree_repo_traverse_commit_with_callback (OstreeRepo *repo, OstreeRepoCommitTraverseFlags flags,
+                                           const char *commit_checksum, int maxdepth,
+                                           OstreeRepoTraverseObjectCallback callback,
+                                           gpointer user_data, GCancellable *cancellable,
+                                           GError **error)
+{
+  g_autofree char *tmp_checksum = NULL;
+  gboolean commit_only = flags & OSTREE_REPO_COMMIT_TRAVERSE_FLAG_COMMIT_ONLY;
+  gboolean metadata_only = (flags & OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NO_CONTENT) != 0;
+  gboolean tolerate_missing = flags & OSTREE_REPO_COMMIT_TRAVERSE_FLAG_TOLERATE_MISSING;
+  g_autoptr (GHashTable) seen_meta = ostree_repo_traverse_new_reachable ();
+  TraverseStreamData data = { callback, user_data, seen_meta, metadata_only };
+
+  while (TRUE)
+    {
+      g_autoptr (GVariant) key = g_variant_ref_sink (
+          ostree_object_name_serialize (commit_checksum, OSTREE_OBJECT_TYPE_COMMIT));
+
+      if (!g_hash_table_add (seen_meta, g_steal_pointer (&key)))
+        break;
+
+      g_autoptr (GVariant) commit = NULL;
+      if (!ostree_repo_load_variant_if_exists (repo, OSTREE_OBJECT_TYPE_COMMIT, commit_checksum,
+                                               &commit, error))
+        return FALSE;
+
+      /* Just return if the parent isn't found; we do expect most
+       * people to have partial repositories.
+       */
+      if (!commit)
+        break;
+
+      /* See if the commit is partial, if so it's not an error to lack objects */
+      OstreeRepoCommitState commitstate;
+      if (!ostree_repo_load_commit (repo, commit_checksum, NULL, &commitstate, error))
+        return FALSE;
+
+      gboolean ignore_missing_dirs = tolerate_missing;
+      if ((commitstate & OSTREE_REPO_COMMIT_STATE_PARTIAL) != 0)
+        ignore_missing_dirs = TRUE;
+
+      if (!callback (repo, commit_checksum, OSTREE_OBJECT_TYPE_COMMIT, user_data, error))
+        return FALSE;
+
+      /* Save time by skipping traversal of non-commit objects */
+      if (!commit_only)
+        {
+          g_debug ("Traversing commit %s", commit_checksum);
+          ostree_cleanup_repo_commit_traverse_iter OstreeRepoCommitTraverseIter iter = {
+            0,
+          };
+          if (!ostree_repo_commit_traverse_iter_init_commit (
+                  &iter, repo, commit, OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE, error))
+            return FALSE;
+
+          if (!stream_iter (repo, &iter, &data, ignore_missing_dirs, cancellable, error))
+            return FALSE;
+        }
+
+      gboolean recurse = FALSE;
+      if (maxdepth == -1 || maxdepth > 0)
+        {
+          g_free (tmp_checksum);
+          tmp_checksum = ostree_commit_get_parent (commit);
+          if (tmp_checksum)
+            {
+              commit_checksum = tmp_checksum;
+              if (maxdepth > 0)
+                maxdepth -= 1;
+              recurse = TRUE;
+            }
+        }
+      if (!recurse)
+        break;
+    }
+
+  return TRUE;
+}
+
+/* Object reachability bitmaps, written to object-bitmaps in the repository
+ * root as a pull assist for served repositories.  The file enumerates every
+ * object reachable from any ref head in a canonical order (sorted by
+ * checksum, then object type) and records one bitmap per distinct commit,
+ * bit i (little-endian within each byte: byte i/8, bit i%8) meaning object i
+ * is reachable from that commit.  With it, a client upgrading from commit A
+ * to commit B can compute the exact object set to request — the bitwise
+ * difference of two bitmaps — without any scan round trips against the
+ * server.  Like the summary, it is a point-in-time artifact: it only
+ * describes commits that were ref heads at generation time, and clients must
+ * treat a missing commit entry as "fall back to the normal scan".
+ */
+
+#define OSTREE_OBJECT_BITMAPS_VERSION 1
+
+static int
+compare_object_names (gconstpointer ap, gconstpointer bp)
+{
+  GVariant *a = *((GVariant **)ap);
+  GVariant *b = *((GVariant **)bp);
+  const char *a_checksum;
+  const char *b_checksum;
+  OstreeObjectType a_objtype;
+  OstreeObjectType b_objtype;
+
+  ostree_object_name_deserialize (a, &a_checksum, &a_objtype);
+  ostree_object_name_deserialize (b, &b_checksum, &b_objtype);
+
+  int ret = strcmp (a_checksum, b_checksum);
+  if (ret != 0)
+    return ret;
+  return (int)a_objtype - (int)b_objtype;
+}
+
+static int
+compare_strings (gconstpointer ap, gconstpointer bp)
+{
+  return strcmp (*((const char *const *)ap), *((const char *const *)bp));
+}
+
+/* Regenerate the object-bitmaps file from the current ref heads.  Commits
+ * that cannot be fully traversed (partial or pruned) are simply left out;
+ * clients fall back to scanning for those.
+ */
+gboolean
+_ostree_repo_regenerate_object_bitmaps (OstreeRepo *self, GCancellable *cancellable,
+                                        GError **error)
+{
+  GLNX_AUTO_PREFIX_ERROR ("Regenerating object bitmaps", error);
+
+  g_autoptr (GHashTable) refs = NULL;
+  if (!ostree_repo_list_refs (self, NULL, &refs, cancellable, error))
+    return FALSE;
+
+  /* Refs sharing a head share a bitmap */
+  g_autoptr (GHashTable) commit_reachable = g_hash_table_new_full (
+      g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_hash_table_unref);
+  GLNX_HASH_TABLE_FOREACH_V (refs, const char *, checksum)
+    {
+      if (g_hash_table_contains (commit_reachable, checksum))
+        continue;
+
+      g_autoptr (GHashTable) reachable = NULL;
+      g_autoptr (GError) local_error = NULL;
+      if (!ostree_repo_traverse_commit (self, checksum, 0, &reachable, cancellable, &local_error))
+        {
+          if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            {
+              g_propagate_error (error, g_steal_pointer (&local_error));
+              return FALSE;
+            }
+          g_debug ("Not bitmapping commit %s: %s", checksum, local_error->message);
+          continue;
+        }
+      g_hash_table_replace (commit_reachable, g_strdup (checksum), g_steal_pointer (&reachable));
+    }
+
+  /* Build the canonical enumeration of all bitmapped objects */
+  g_autoptr (GHashTable) object_index
+      = g_hash_table_new_full (ostree_hash_object_name, g_variant_equal,
+                               (GDestroyNotify)g_variant_unref, NULL);
+  g_autoptr (GPtrArray) objects = g_ptr_array_new ();
+  GLNX_HASH_TABLE_FOREACH_V (commit_reachable, GHashTable *, reachable)
+    {
+      GLNX_HASH_TABLE_FOREACH (reachable, GVariant *, object)
+        {
+          if (!g_hash_table_contains (object_index, object))
+            {
+              g_hash_table_insert (object_index, g_variant_ref (object), NULL);
+              g_ptr_array_add (objects, object);
+            }
+        }
+    }
+  g_ptr_array_sort (objects, compare_object_names);
+  for (guint i = 0; i < objects->len; i++)
+    g_hash_table_insert (object_index, g_variant_ref (objects->pdata[i]),
+                         GUINT_TO_POINTER (i + 1));
+
+  g_autoptr (GVariantBuilder) objects_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(yay)"));
+  for (guint i = 0; i < objects->len; i++)
+    {
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (objects->pdata[i], &checksum, &objtype);
+
+      guchar csum_bytes[OSTREE_SHA256_DIGEST_LEN];
+      ostree_checksum_inplace_to_bytes (checksum, csum_bytes);
+      g_variant_builder_add (objects_builder, "(y@ay)", (guchar)objtype,
+                             ot_gvariant_new_bytearray (csum_bytes, sizeof (csum_bytes)));
+    }
+
+  const gsize bitmap_len = ((gsize)objects->len + 7) / 8;
+  g_autoptr (GVariantBuilder) bitmaps_builder = g_variant_builder_new (G_VARIANT_TYPE ("a{say}"));
+
+  g_autofree char **commits = (char **)g_hash_table_get_keys_as_array (commit_reachable, NULL);
+  gsize n_commits = 0;
+  while (commits[n_commits] != NULL)
+    n_commits++;
+  qsort (commits, n_commits, sizeof (char *), compare_strings);
+
+  for (gsize i = 0; i < n_commits; i++)
+    {
+      GHashTable *reachable = g_hash_table_lookup (commit_reachable, commits[i]);
+      g_autofree guint8 *bitmap = g_malloc0 (MAX (bitmap_len, 1));
+
+      GLNX_HASH_TABLE_FOREACH (reachable, GVariant *, object)
+        {
+          gpointer idxp = g_hash_table_lookup (object_index, object);
+          g_assert (idxp != NULL);
+          const guint idx = GPOINTER_TO_UINT (idxp) - 1;
+          bitmap[idx >> 3] |= (guint8)(1 << (idx & 7));
+        }
+
+      g_variant_builder_add (bitmaps_builder, "{s@ay}", commits[i],
+                             ot_gvariant_new_bytearray (bitmap, bitmap_len));
+    }
+
+  g_auto (GVariantBuilder) metadata_builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (
+      &metadata_builder, "{sv}", "ostree.bitmaps.last-modified",
+      g_variant_new_uint64 (GUINT64_TO_BE (g_get_real_time () / G_USEC_PER_SEC)));
+
+  g_autoptr (GVariant) bitmaps = g_variant_ref_sink (
+      g_variant_new ("(ua{sv}@a(yay)@a{say})", OSTREE_OBJECT_BITMAPS_VERSION, &metadata_builder,
+                     g_variant_builder_end (objects_builder),
+                     g_variant_builder_end (bitmaps_builder)));
+
+  return _ostree_repo_file_replace_contents (self, self->repo_dir_fd,
+                                             _OSTREE_OBJECT_BITMAPS_PATH,
+                                             g_variant_get_data (bitmaps),
+                                             g_variant_get_size (bitmaps), cancellable, error);
+}
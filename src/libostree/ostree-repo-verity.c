@@ -102,13 +102,12 @@ _ostree_repo_parse_fsverity_config (OstreeRepo *self, GError **error)
   return TRUE;
 }
 
-/* Wrapper around the fsverity ioctl, compressing the result to
- * "success, unsupported or error".  This is used for /boot where
- * we enable verity if supported.
- * */
-gboolean
-_ostree_tmpf_fsverity_core (GLnxTmpfile *tmpf, _OstreeFeatureSupport fsverity_requested,
-                            GBytes *signature, gboolean *supported, GError **error)
+/* Wrapper around the fsverity ioctl on a read-only fd, compressing the
+ * result to "success, unsupported or error".
+ */
+static gboolean
+fsverity_ioctl_fd (int fd, _OstreeFeatureSupport fsverity_requested, GBytes *signature,
+                   gboolean *supported, GError **error)
 {
   /* Set this by default to simplify the code below */
   if (supported)
@@ -120,10 +119,6 @@ _ostree_tmpf_fsverity_core (GLnxTmpfile *tmpf, _OstreeFeatureSupport fsverity_re
 #ifdef HAVE_LINUX_FSVERITY_H
   GLNX_AUTO_PREFIX_ERROR ("fsverity", error);
 
-  /* fs-verity requires a read-only file descriptor */
-  if (!glnx_tmpfile_reopen_rdonly (tmpf, error))
-    return FALSE;
-
   struct fsverity_enable_arg arg = {
     0,
   };
@@ -135,7 +130,7 @@ _ostree_tmpf_fsverity_core (GLnxTmpfile *tmpf, _OstreeFeatureSupport fsverity_re
   arg.sig_size = signature ? g_bytes_get_size (signature) : 0;
   arg.sig_ptr = signature ? (guint64)g_bytes_get_data (signature, NULL) : 0;
 
-  if (ioctl (tmpf->fd, FS_IOC_ENABLE_VERITY, &arg) < 0)
+  if (ioctl (fd, FS_IOC_ENABLE_VERITY, &arg) < 0)
     {
       switch (errno)
         {
@@ -153,15 +148,38 @@ _ostree_tmpf_fsverity_core (GLnxTmpfile *tmpf, _OstreeFeatureSupport fsverity_re
   return TRUE;
 }
 
-/* Enable verity on a file, respecting the "wanted" and "supported" states.
- * The main idea here is to optimize out pointlessly calling the ioctl()
- * over and over in cases where it's not supported for the repo's filesystem,
- * as well as to support "opportunistic" use (requested and if filesystem supports).
+/* As fsverity_ioctl_fd(), but reopening the tmpfile read-only first as the
+ * ioctl requires.  This is used for /boot where we enable verity if
+ * supported.
  * */
 gboolean
-_ostree_tmpf_fsverity (OstreeRepo *self, GLnxTmpfile *tmpf, GBytes *signature, GError **error)
+_ostree_tmpf_fsverity_core (GLnxTmpfile *tmpf, _OstreeFeatureSupport fsverity_requested,
+                            GBytes *signature, gboolean *supported, GError **error)
 {
+  if (supported)
+    *supported = FALSE;
+
+  if (fsverity_requested == _OSTREE_FEATURE_NO)
+    return TRUE;
+
+  /* fs-verity requires a read-only file descriptor */
+  if (!glnx_tmpfile_reopen_rdonly (tmpf, error))
+    return FALSE;
+
+  return fsverity_ioctl_fd (tmpf->fd, fsverity_requested, signature, supported, error);
+}
+
 #ifdef HAVE_LINUX_FSVERITY_H
+/* Enable verity on a read-only fd, respecting the "wanted" and "supported"
+ * states.  The main idea here is to optimize out pointlessly calling the
+ * ioctl() over and over in cases where it's not supported for the repo's
+ * filesystem, as well as to support "opportunistic" use (requested and if
+ * filesystem supports).  Called from both the synchronous path and the
+ * worker threads; everything it touches on @self is under txn_lock.
+ * */
+static gboolean
+fsverity_enable_fd (OstreeRepo *self, int fd, GBytes *signature, GError **error)
+{
   g_mutex_lock (&self->txn_lock);
   _OstreeFeatureSupport fsverity_wanted = self->fs_verity_wanted;
   _OstreeFeatureSupport fsverity_supported = self->fs_verity_supported;
@@ -182,7 +200,7 @@ _ostree_tmpf_fsverity (OstreeRepo *self, GLnxTmpfile *tmpf, GBytes *signature, G
     }
 
   gboolean supported = FALSE;
-  if (!_ostree_tmpf_fsverity_core (tmpf, fsverity_wanted, signature, &supported, error))
+  if (!fsverity_ioctl_fd (fd, fsverity_wanted, signature, &supported, error))
     return FALSE;
 
   if (!supported)
@@ -201,8 +219,124 @@ _ostree_tmpf_fsverity (OstreeRepo *self, GLnxTmpfile *tmpf, GBytes *signature, G
   g_mutex_lock (&self->txn_lock);
   self->fs_verity_supported = _OSTREE_FEATURE_YES;
   g_mutex_unlock (&self->txn_lock);
+  return TRUE;
+}
+#endif /* HAVE_LINUX_FSVERITY_H */
+
+/* Synchronously enable verity on a tmpfile; see fsverity_enable_fd(). */
+gboolean
+_ostree_tmpf_fsverity (OstreeRepo *self, GLnxTmpfile *tmpf, GBytes *signature, GError **error)
+{
+#ifdef HAVE_LINUX_FSVERITY_H
+  /* fs-verity requires a read-only file descriptor */
+  if (!glnx_tmpfile_reopen_rdonly (tmpf, error))
+    return FALSE;
+
+  return fsverity_enable_fd (self, tmpf->fd, signature, error);
 #else
   g_assert_cmpint (self->fs_verity_wanted, !=, _OSTREE_FEATURE_YES);
+  return TRUE;
+#endif
+}
+
+#ifdef HAVE_LINUX_FSVERITY_H
+/* Thread pool worker: computing the Merkle tree inside
+ * FS_IOC_ENABLE_VERITY is synchronous and can take 100ms+ for large
+ * files, so during a transaction we take it off the object write path.
+ * The first failure is stashed for _ostree_repo_fsverity_drain().
+ */
+static void
+fsverity_enable_in_thread (gpointer data, gpointer user_data)
+{
+  OstreeRepo *self = user_data;
+  glnx_autofd int fd = GPOINTER_TO_INT (data);
+  g_autoptr (GError) local_error = NULL;
+
+  if (!fsverity_enable_fd (self, fd, NULL, &local_error))
+    {
+      g_mutex_lock (&self->fsverity_lock);
+      if (self->fsverity_error == NULL)
+        self->fsverity_error = g_steal_pointer (&local_error);
+      g_mutex_unlock (&self->fsverity_lock);
+    }
+
+  g_mutex_lock (&self->fsverity_lock);
+  g_assert_cmpuint (self->fsverity_outstanding, >, 0);
+  self->fsverity_outstanding--;
+  g_cond_broadcast (&self->fsverity_cond);
+  g_mutex_unlock (&self->fsverity_lock);
+}
+#endif /* HAVE_LINUX_FSVERITY_H */
+
+/* If we're in a transaction and fs-verity may be enabled, queue enabling
+ * verity on @tmpf's inode to the repo's worker pool and set @out_queued.
+ * The caller must link the tmpfile into place regardless; the ioctl
+ * operates on the inode and doesn't care about the link.  When not queued
+ * (feature off, known-unsupported filesystem, or outside a transaction)
+ * the caller falls back to _ostree_tmpf_fsverity().
+ */
+gboolean
+_ostree_repo_fsverity_maybe_queue (OstreeRepo *self, GLnxTmpfile *tmpf, gboolean *out_queued,
+                                   GError **error)
+{
+  *out_queued = FALSE;
+#ifdef HAVE_LINUX_FSVERITY_H
+  g_mutex_lock (&self->txn_lock);
+  _OstreeFeatureSupport fsverity_wanted = self->fs_verity_wanted;
+  _OstreeFeatureSupport fsverity_supported = self->fs_verity_supported;
+  g_mutex_unlock (&self->txn_lock);
+
+  /* Only queue if we'd actually invoke the ioctl; the synchronous path
+   * handles the error and early-return cases. */
+  if (fsverity_wanted == _OSTREE_FEATURE_NO || fsverity_supported == _OSTREE_FEATURE_NO)
+    return TRUE;
+
+  /* The pool is drained at transaction commit/abort, so it can only be
+   * used inside a transaction. */
+  if (!self->in_transaction)
+    return TRUE;
+
+  /* fs-verity requires a read-only file descriptor */
+  if (!glnx_tmpfile_reopen_rdonly (tmpf, error))
+    return FALSE;
+
+  /* The worker owns its own fd; the caller is about to consume @tmpf */
+  glnx_autofd int fd = fcntl (tmpf->fd, F_DUPFD_CLOEXEC, 3);
+  if (fd < 0)
+    return glnx_throw_errno_prefix (error, "fcntl(F_DUPFD_CLOEXEC)");
+
+  g_mutex_lock (&self->fsverity_lock);
+  if (self->fsverity_pool == NULL)
+    self->fsverity_pool = ot_thread_pool_new ("fsverity", fsverity_enable_in_thread, self,
+                                              g_get_num_processors ());
+  self->fsverity_outstanding++;
+  g_mutex_unlock (&self->fsverity_lock);
+
+  ot_thread_pool_push (self->fsverity_pool, GINT_TO_POINTER (g_steal_fd (&fd)));
+  *out_queued = TRUE;
+#endif
+  return TRUE;
+}
+
+/* Barrier: wait for all queued verity enablement to complete, and report
+ * the first failure.  Must be called before a transaction is considered
+ * committed.
+ */
+gboolean
+_ostree_repo_fsverity_drain (OstreeRepo *self, GError **error)
+{
+#ifdef HAVE_LINUX_FSVERITY_H
+  g_mutex_lock (&self->fsverity_lock);
+  while (self->fsverity_outstanding > 0)
+    g_cond_wait (&self->fsverity_cond, &self->fsverity_lock);
+  g_autoptr (GError) local_error = g_steal_pointer (&self->fsverity_error);
+  g_mutex_unlock (&self->fsverity_lock);
+
+  if (local_error)
+    {
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return FALSE;
+    }
 #endif
   return TRUE;
 }
@@ -33,7 +33,9 @@
 #include <glnx-console.h>
 #include <linux/magic.h>
 
+#include "bsdiff/bsdiff.h"
 #include "ostree-autocleanups.h"
+#include "ostree-bloom-private.h"
 #include "ostree-core-private.h"
 #include "ostree-gpg-verifier.h"
 #include "ostree-remote-private.h"
@@ -852,6 +854,9 @@ _ostree_repo_get_remote (OstreeRepo *self, const char *name, GError **error)
 
   g_return_val_if_fail (name != NULL, NULL);
 
+  if (!_ostree_repo_ensure_remotes_loaded (self, NULL, error))
+    return NULL;
+
   g_mutex_lock (&self->remotes_lock);
 
   remote = g_hash_table_lookup (self->remotes, name);
@@ -1140,6 +1145,7 @@ ostree_repo_finalize (GObject *object)
   OstreeRepo *self = OSTREE_REPO (object);
 
   g_clear_object (&self->parent_repo);
+  g_clear_pointer (&self->object_pools, g_ptr_array_unref);
 
   g_free (self->stagedir_prefix);
   g_clear_object (&self->repodir_fdrel);
@@ -1150,6 +1156,8 @@ ostree_repo_finalize (GObject *object)
   glnx_close_fd (&self->tmp_dir_fd);
   glnx_close_fd (&self->cache_dir_fd);
   glnx_close_fd (&self->objects_dir_fd);
+  glnx_close_fd (&self->metadata_objects_dir_fd);
+  g_free (self->metadata_objects_root);
   glnx_close_fd (&self->uncompressed_objects_dir_fd);
   g_clear_object (&self->sysroot_dir);
   g_weak_ref_clear (&self->sysroot);
@@ -1157,15 +1165,49 @@ ostree_repo_finalize (GObject *object)
 
   if (self->loose_object_devino_hash)
     g_hash_table_destroy (self->loose_object_devino_hash);
+  g_clear_pointer (&self->summary_row_cache, g_hash_table_unref);
+  g_clear_pointer (&self->prehasher, _ostree_repo_prehasher_free);
+  g_clear_pointer (&self->uring_fsync, _ostree_repo_uring_fsync_free);
   if (self->updated_uncompressed_dirs)
     g_hash_table_destroy (self->updated_uncompressed_dirs);
-  if (self->config)
-    g_key_file_free (self->config);
+  /* Unref, not free: the config may be shared via the process-wide cache */
+  g_clear_pointer (&self->config, g_key_file_unref);
   g_clear_pointer (&self->txn.refs, g_hash_table_destroy);
   g_clear_pointer (&self->txn.collection_refs, g_hash_table_destroy);
+  g_clear_pointer (&self->txn.written_commits, g_ptr_array_unref);
   g_clear_error (&self->writable_error);
   g_clear_pointer (&self->object_sizes, g_hash_table_unref);
-  g_clear_pointer (&self->dirmeta_cache, g_hash_table_unref);
+  g_clear_pointer (&self->metadata_cache, g_hash_table_unref);
+  g_clear_pointer (&self->xattr_intern_cache, g_hash_table_unref);
+  g_clear_pointer (&self->bare_user_meta_cache, g_hash_table_unref);
+  g_clear_pointer (&self->file_info_cache, g_hash_table_unref);
+  g_clear_pointer (&self->verified_summary_cache, g_hash_table_unref);
+#ifndef OSTREE_DISABLE_GPGME
+  if (self->gpg_home_cache != NULL)
+    {
+      GLNX_HASH_TABLE_FOREACH_V (self->gpg_home_cache, const char *, home_dir)
+        {
+          ot_gpgme_kill_agent (home_dir);
+          (void)glnx_shutil_rm_rf_at (AT_FDCWD, home_dir, NULL, NULL);
+        }
+    }
+#endif /* OSTREE_DISABLE_GPGME */
+  g_clear_pointer (&self->gpg_home_cache, g_hash_table_unref);
+  _ostree_repo_packs_clear (self);
+  g_mutex_clear (&self->pack_lock);
+  _ostree_repo_packed_refs_clear (self);
+  g_mutex_clear (&self->packed_refs_lock);
+  _ostree_repo_commit_graph_clear (self);
+  g_mutex_clear (&self->commit_graph_lock);
+  _ostree_repo_commit_state_index_clear (self);
+  g_mutex_clear (&self->commit_state_lock);
+  /* Wait out any in-flight verity workers before tearing down the locks
+   * they use */
+  if (self->fsverity_pool)
+    ot_thread_pool_free (self->fsverity_pool);
+  g_clear_error (&self->fsverity_error);
+  g_mutex_clear (&self->fsverity_lock);
+  g_cond_clear (&self->fsverity_cond);
   g_mutex_clear (&self->cache_lock);
   g_mutex_clear (&self->txn_lock);
   g_free (self->collection_id);
@@ -1174,6 +1216,7 @@ ostree_repo_finalize (GObject *object)
 
   g_clear_pointer (&self->remotes, g_hash_table_destroy);
   g_mutex_clear (&self->remotes_lock);
+  g_mutex_clear (&self->remotes_load_lock);
 
   glnx_close_fd (&self->lock.fd);
   g_mutex_clear (&self->lock.mutex);
@@ -1324,17 +1367,25 @@ ostree_repo_init (OstreeRepo *self)
   g_mutex_init (&self->lock.mutex);
   g_mutex_init (&self->cache_lock);
   g_mutex_init (&self->txn_lock);
+  g_mutex_init (&self->pack_lock);
+  g_mutex_init (&self->packed_refs_lock);
+  g_mutex_init (&self->commit_graph_lock);
+  g_mutex_init (&self->commit_state_lock);
+  g_mutex_init (&self->fsverity_lock);
+  g_cond_init (&self->fsverity_cond);
 
   self->remotes = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify)NULL,
                                          (GDestroyNotify)ostree_remote_unref);
   self->bls_append_values = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify)g_free,
                                                    (GDestroyNotify)g_free);
   g_mutex_init (&self->remotes_lock);
+  g_mutex_init (&self->remotes_load_lock);
 
   self->repo_dir_fd = -1;
   self->cache_dir_fd = -1;
   self->tmp_dir_fd = -1;
   self->objects_dir_fd = -1;
+  self->metadata_objects_dir_fd = -1;
   self->uncompressed_objects_dir_fd = -1;
   self->lock.fd = -1;
   self->sysroot_kind = OSTREE_REPO_SYSROOT_KIND_UNKNOWN;
@@ -1610,11 +1661,22 @@ ostree_repo_write_config (OstreeRepo *self, GKeyFile *new_config, GError **error
                                       error))
     return FALSE;
 
-  g_key_file_free (self->config);
+  /* Not g_key_file_free(): the old keyfile may be shared with other
+   * instances through the process-wide config cache, and freeing would
+   * empty it under them.
+   */
+  g_key_file_unref (self->config);
   self->config = g_key_file_new ();
   if (!g_key_file_load_from_data (self->config, data, len, 0, error))
     return FALSE;
 
+  /* Let other instances in this process pick up the new config without
+   * re-parsing it.
+   */
+  struct stat config_stbuf;
+  if (fstatat (self->repo_dir_fd, "config", &config_stbuf, 0) == 0 && self->device != 0)
+    repo_config_cache_store (self->device, self->inode, &config_stbuf, self->config);
+
   return TRUE;
 }
 
@@ -1948,6 +2010,13 @@ _ostree_repo_remote_list (OstreeRepo *self, GHashTable *out)
   GHashTableIter iter;
   gpointer key, value;
 
+  {
+    g_autoptr (GError) local_error = NULL;
+    /* This API has no error channel; on failure just list what we have */
+    if (!_ostree_repo_ensure_remotes_loaded (self, NULL, &local_error))
+      g_debug ("Failed to load remote configs: %s", local_error->message);
+  }
+
   g_mutex_lock (&self->remotes_lock);
 
   g_hash_table_iter_init (&iter, self->remotes);
@@ -2981,6 +3050,85 @@ min_free_space_size_validate_and_convert (OstreeRepo *self, const char *min_free
   return TRUE;
 }
 
+/* Process-wide cache of parsed repository configuration, shared between
+ * OstreeRepo instances pointing at the same repository (keyed by the
+ * device and inode of the repository root).  Daemons routinely hold
+ * several handles to one repo; without this, every ostree_repo_open()
+ * re-reads and re-parses the config file.  Sharing the GKeyFile is safe
+ * because ostree_repo_get_config() hands it out with a "do not modify"
+ * contract and ostree_repo_write_config() replaces rather than mutates
+ * it.  Entries are revalidated against the config file's mtime (and
+ * size/inode) on every load, so edits by other processes are picked up
+ * by the next ostree_repo_open() or ostree_repo_reload_config().
+ */
+typedef struct
+{
+  struct timespec config_mtim;
+  guint64 config_size;
+  guint64 config_ino;
+  GKeyFile *config;
+} RepoConfigCacheEntry;
+
+static GMutex config_cache_lock;
+static GHashTable *config_cache; /* Map<"dev:ino",RepoConfigCacheEntry> */
+
+static void
+repo_config_cache_entry_free (gpointer data)
+{
+  RepoConfigCacheEntry *entry = data;
+  g_key_file_unref (entry->config);
+  g_free (entry);
+}
+
+static char *
+repo_config_cache_key (guint64 device, guint64 inode)
+{
+  return g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT, device, inode);
+}
+
+/* Look up the shared parsed config for the repository identified by
+ * @device/@inode; returns a new ref, or %NULL if there is no entry
+ * matching the stamp in @stbuf.
+ */
+static GKeyFile *
+repo_config_cache_lookup (guint64 device, guint64 inode, const struct stat *stbuf)
+{
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&config_cache_lock);
+
+  if (config_cache == NULL)
+    return NULL;
+
+  g_autofree char *key = repo_config_cache_key (device, inode);
+  RepoConfigCacheEntry *entry = g_hash_table_lookup (config_cache, key);
+  if (entry == NULL)
+    return NULL;
+
+  if (entry->config_mtim.tv_sec != stbuf->st_mtim.tv_sec
+      || entry->config_mtim.tv_nsec != stbuf->st_mtim.tv_nsec
+      || entry->config_size != (guint64)stbuf->st_size
+      || entry->config_ino != (guint64)stbuf->st_ino)
+    return NULL;
+
+  return g_key_file_ref (entry->config);
+}
+
+static void
+repo_config_cache_store (guint64 device, guint64 inode, const struct stat *stbuf, GKeyFile *config)
+{
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&config_cache_lock);
+
+  if (config_cache == NULL)
+    config_cache
+        = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, repo_config_cache_entry_free);
+
+  RepoConfigCacheEntry *entry = g_new0 (RepoConfigCacheEntry, 1);
+  entry->config_mtim = stbuf->st_mtim;
+  entry->config_size = stbuf->st_size;
+  entry->config_ino = stbuf->st_ino;
+  entry->config = g_key_file_ref (config);
+  g_hash_table_replace (config_cache, repo_config_cache_key (device, inode), entry);
+}
+
 static gboolean
 reload_core_config (OstreeRepo *self, GCancellable *cancellable, GError **error)
 {
@@ -2992,15 +3140,32 @@ reload_core_config (OstreeRepo *self, GCancellable *cancellable, GError **error)
   gsize len;
 
   g_clear_pointer (&self->config, g_key_file_unref);
-  self->config = g_key_file_new ();
 
-  contents = glnx_file_get_contents_utf8_at (self->repo_dir_fd, "config", &len, NULL, error);
-  if (!contents)
-    return FALSE;
-  if (!g_key_file_load_from_data (self->config, contents, len, 0, error))
+  /* Reuse the config another instance in this process already parsed, if
+   * its revalidation stamp still matches the file.
+   */
+  struct stat config_stbuf;
+  gboolean have_config_stat
+      = fstatat (self->repo_dir_fd, "config", &config_stbuf, 0) == 0
+        && self->device != 0;
+  if (have_config_stat)
+    self->config = repo_config_cache_lookup (self->device, self->inode, &config_stbuf);
+
+  if (self->config == NULL)
     {
-      g_prefix_error (error, "Couldn't parse config file: ");
-      return FALSE;
+      self->config = g_key_file_new ();
+
+      contents = glnx_file_get_contents_utf8_at (self->repo_dir_fd, "config", &len, NULL, error);
+      if (!contents)
+        return FALSE;
+      if (!g_key_file_load_from_data (self->config, contents, len, 0, error))
+        {
+          g_prefix_error (error, "Couldn't parse config file: ");
+          return FALSE;
+        }
+
+      if (have_config_stat)
+        repo_config_cache_store (self->device, self->inode, &config_stbuf, self->config);
     }
 
   version = g_key_file_get_value (self->config, "core", "repo_version", error);
@@ -3050,11 +3215,101 @@ reload_core_config (OstreeRepo *self, GCancellable *cancellable, GError **error)
                                             &self->per_object_fsync, error))
     return FALSE;
 
+  {
+    g_autofree char *fsync_barrier = NULL;
+
+    /* "syncfs" (the default) flushes the whole filesystem before objects are
+     * renamed into place; "batch" instead fsyncs just the staged object files
+     * at the same point, which avoids penalizing unrelated writers sharing
+     * the filesystem.
+     */
+    if (!ot_keyfile_get_value_with_default (self->config, "core", "fsync-barrier", "syncfs",
+                                            &fsync_barrier, error))
+      return FALSE;
+    if (strcmp (fsync_barrier, "batch") == 0)
+      self->batch_fsync_barrier = TRUE;
+    else if (strcmp (fsync_barrier, "syncfs") != 0)
+      return glnx_throw (error, "Invalid fsync-barrier '%s'", fsync_barrier);
+  }
+
+  {
+    g_autofree char *parallel_checksum_threads = NULL;
+
+    /* 0 (the default) disables the parallel prehashing pool used by the
+     * commit path; -1 means one thread per processor.
+     */
+    if (!ot_keyfile_get_value_with_default (self->config, "core", "parallel-checksum-threads", "0",
+                                            &parallel_checksum_threads, error))
+      return FALSE;
+
+    gint64 n_threads = g_ascii_strtoll (parallel_checksum_threads, NULL, 10);
+    if (n_threads < 0)
+      self->parallel_checksum_threads = g_get_num_processors ();
+    else
+      self->parallel_checksum_threads = MIN (n_threads, G_MAXINT16);
+  }
+
+  {
+    g_autofree char *worker_cpu_affinity = NULL;
+
+    /* CPU list (taskset(1) syntax) applied to all worker thread pools; on
+     * multi-socket machines pinning the workers keeps their memory on the
+     * local NUMA node.  Empty (the default) leaves workers unpinned.
+     */
+    if (!ot_keyfile_get_value_with_default (self->config, "core", "worker-cpu-affinity", "",
+                                            &worker_cpu_affinity, error))
+      return FALSE;
+
+    if (!ot_thread_pool_set_default_affinity (worker_cpu_affinity, error))
+      return FALSE;
+  }
+
+  {
+    g_autofree char *metadata_cache_size = NULL;
+
+    /* Maximum number of parsed dirtree/dirmeta variants retained in memory;
+     * 0 disables the cache.  See load_metadata_internal().
+     */
+    if (!ot_keyfile_get_value_with_default (self->config, "core", "metadata-cache-size", "512",
+                                            &metadata_cache_size, error))
+      return FALSE;
+
+    gint64 cache_size = g_ascii_strtoll (metadata_cache_size, NULL, 10);
+    self->metadata_cache_size = CLAMP (cache_size, 0, G_MAXINT16);
+  }
+
+  /* Only effective when built with liburing, and (currently) only changes the
+   * per-object-fsync strategy.
+   */
+  if (!ot_keyfile_get_boolean_with_default (self->config, "core", "io-uring", FALSE,
+                                            &self->use_io_uring, error))
+    return FALSE;
+
   /* See https://github.com/ostreedev/ostree/issues/758 */
   if (!ot_keyfile_get_boolean_with_default (self->config, "core", "disable-xattrs", FALSE,
                                             &self->disable_xattrs, error))
     return FALSE;
 
+  /* Two-level object fanout (objects/xx/yy/); see _ostree_loose_path_with_fanout().
+   * While enabled, lookups fall back to the single-level layout so objects
+   * written before the switch (or before `ostree migrate-fanout` has run)
+   * stay reachable.
+   */
+  if (!ot_keyfile_get_boolean_with_default (self->config, "core", "deep-fanout", FALSE,
+                                            &self->deep_fanout, error))
+    return FALSE;
+
+  /* Optional separate directory root for metadata objects, so the commonly
+   * traversed commit/dirtree/dirmeta objects can live on faster storage than
+   * the bulk content.  Relative paths are resolved against the repository
+   * directory.  The root is opened by ostree_repo_open(); changing this
+   * option requires reopening the repository.
+   */
+  g_clear_pointer (&self->metadata_objects_root, g_free);
+  if (!ot_keyfile_get_value_with_default (self->config, "core", "metadata-objects-root", NULL,
+                                          &self->metadata_objects_root, error))
+    return FALSE;
+
   {
     g_autofree char *tmp_expiry_seconds = NULL;
 
@@ -3183,6 +3438,32 @@ reload_core_config (OstreeRepo *self, GCancellable *cancellable, GError **error)
         }
     }
 
+  /* Like core.parent, but an ordered list: read-only object pools shared
+   * between multiple repos on one host, consulted after the parent.
+   */
+  {
+    g_auto (GStrv) pool_paths
+        = g_key_file_get_string_list (self->config, "core", "object-pools", NULL, NULL);
+
+    g_clear_pointer (&self->object_pools, g_ptr_array_unref);
+    if (pool_paths != NULL && pool_paths[0] != NULL)
+      {
+        self->object_pools = g_ptr_array_new_with_free_func (g_object_unref);
+        for (char **iter = pool_paths; *iter != NULL; iter++)
+          {
+            g_autoptr (GFile) pool_f = g_file_new_for_path (*iter);
+            g_autoptr (OstreeRepo) pool = ostree_repo_new (pool_f);
+
+            if (!ostree_repo_open (pool, cancellable, error))
+              {
+                g_prefix_error (error, "While checking object pool '%s': ", *iter);
+                return FALSE;
+              }
+            g_ptr_array_add (self->object_pools, g_steal_pointer (&pool));
+          }
+      }
+  }
+
   /* By default, only add remotes in a remotes config directory for
    * system repos. This is to preserve legacy behavior for non-system
    * repos that specify a remotes config dir (flatpak).
@@ -3205,6 +3486,16 @@ reload_core_config (OstreeRepo *self, GCancellable *cancellable, GError **error)
     self->payload_link_threshold = g_ascii_strtoull (payload_threshold, NULL, 10);
   }
 
+  {
+    g_autofree char *direct_io_threshold = NULL;
+
+    if (!ot_keyfile_get_value_with_default (self->config, "core", "direct-io-threshold", "0",
+                                            &direct_io_threshold, error))
+      return FALSE;
+
+    self->direct_io_threshold = g_ascii_strtoull (direct_io_threshold, NULL, 10);
+  }
+
   {
     g_auto (GStrv) configured_finders = NULL;
     g_autoptr (GError) local_error = NULL;
@@ -3253,40 +3544,125 @@ reload_remote_config (OstreeRepo *self, GCancellable *cancellable, GError **erro
   if (!add_remotes_from_keyfile (self, self->config, NULL, error))
     return FALSE;
 
-  g_autoptr (GFile) remotes_d = get_remotes_d_dir (self, NULL);
-  if (remotes_d == NULL)
-    return TRUE;
+  /* Parsing the remotes.d directory is deferred until a remote is actually
+   * looked up; short-lived read-only commands (e.g. `ostree rev-parse`)
+   * never pay for it.  See _ostree_repo_ensure_remotes_loaded().
+   */
+  g_mutex_lock (&self->remotes_load_lock);
+  self->remotes_d_loaded = FALSE;
+  g_mutex_unlock (&self->remotes_load_lock);
 
-  g_autoptr (GFileEnumerator) direnum = NULL;
-  if (!enumerate_directory_allow_noent (remotes_d, OSTREE_GIO_FAST_QUERYINFO, 0, &direnum,
-                                        cancellable, error))
-    return FALSE;
-  if (direnum)
+  return TRUE;
+}
+
+/* Parse any remote configs in the remotes.d directory if we haven't
+ * already; this is deferred from open/reload so that commands which never
+ * touch a remote don't pay for enumerating and parsing the directory.
+ * Called implicitly by _ostree_repo_get_remote() and the remote listing
+ * paths; anything else reading `self->remotes` directly must call it first.
+ *
+ * Once loaded, the directory's mtime is checked on each call, so remotes
+ * added or removed by another process (or via another repo handle) are
+ * picked up by long-lived daemons without reopening the repo: the
+ * file-backed remotes are dropped and re-parsed, while remotes defined in
+ * the repo config and all other repo state are preserved.  Remote config
+ * files are replaced by rename, so content changes bump the directory
+ * mtime too.
+ */
+gboolean
+_ostree_repo_ensure_remotes_loaded (OstreeRepo *self, GCancellable *cancellable, GError **error)
+{
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&self->remotes_load_lock);
+  if (self->remotes_d_loaded)
     {
-      while (TRUE)
+      gboolean stale = FALSE;
+      g_autoptr (GFile) remotes_d = get_remotes_d_dir (self, NULL);
+      if (remotes_d != NULL)
         {
-          GFileInfo *file_info;
-          GFile *path;
-          const char *name;
-          guint32 type;
-
-          if (!g_file_enumerator_iterate (direnum, &file_info, &path, NULL, error))
-            return FALSE;
-          if (file_info == NULL)
-            break;
+          struct stat stbuf;
+          if (stat (gs_file_get_path_cached (remotes_d), &stbuf) == 0
+              && ((guint64)stbuf.st_mtim.tv_sec != self->remotes_d_mtime_sec
+                  || (guint32)stbuf.st_mtim.tv_nsec != self->remotes_d_mtime_nsec))
+            stale = TRUE;
+        }
 
-          name = g_file_info_get_attribute_byte_string (file_info, "standard::name");
-          type = g_file_info_get_attribute_uint32 (file_info, "standard::type");
+      if (!stale)
+        {
+          ret = TRUE;
+          goto out;
+        }
 
-          if (type == G_FILE_TYPE_REGULAR && g_str_has_suffix (name, ".conf"))
-            {
-              if (!append_one_remote_config (self, path, cancellable, error))
-                return FALSE;
-            }
+      /* Drop just the file-backed remotes and fall through to re-parse */
+      g_mutex_lock (&self->remotes_lock);
+      GHashTableIter iter;
+      gpointer value;
+      g_hash_table_iter_init (&iter, self->remotes);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          OstreeRemote *remote = value;
+          if (remote->file != NULL)
+            g_hash_table_iter_remove (&iter);
         }
+      g_mutex_unlock (&self->remotes_lock);
+      self->remotes_d_loaded = FALSE;
     }
 
-  return TRUE;
+  {
+    g_autoptr (GFile) remotes_d = get_remotes_d_dir (self, NULL);
+    g_autoptr (GFileEnumerator) direnum = NULL;
+
+    /* Record the directory mtime before enumerating, so a concurrent
+     * change during the parse at worst triggers one redundant reload.
+     */
+    self->remotes_d_mtime_sec = 0;
+    self->remotes_d_mtime_nsec = 0;
+    if (remotes_d != NULL)
+      {
+        struct stat stbuf;
+        if (stat (gs_file_get_path_cached (remotes_d), &stbuf) == 0)
+          {
+            self->remotes_d_mtime_sec = stbuf.st_mtim.tv_sec;
+            self->remotes_d_mtime_nsec = stbuf.st_mtim.tv_nsec;
+          }
+      }
+
+    if (remotes_d != NULL
+        && !enumerate_directory_allow_noent (remotes_d, OSTREE_GIO_FAST_QUERYINFO, 0, &direnum,
+                                             cancellable, error))
+      goto out;
+    if (direnum)
+      {
+        while (TRUE)
+          {
+            GFileInfo *file_info;
+            GFile *path;
+            const char *name;
+            guint32 type;
+
+            if (!g_file_enumerator_iterate (direnum, &file_info, &path, NULL, error))
+              goto out;
+            if (file_info == NULL)
+              break;
+
+            name = g_file_info_get_attribute_byte_string (file_info, "standard::name");
+            type = g_file_info_get_attribute_uint32 (file_info, "standard::type");
+
+            if (type == G_FILE_TYPE_REGULAR && g_str_has_suffix (name, ".conf"))
+              {
+                if (!append_one_remote_config (self, path, cancellable, error))
+                  goto out;
+              }
+          }
+      }
+  }
+
+  self->remotes_d_loaded = TRUE;
+  ret = TRUE;
+out:
+  g_mutex_unlock (&self->remotes_load_lock);
+  return ret;
 }
 
 static gboolean
@@ -3480,10 +3856,41 @@ ostree_repo_open (OstreeRepo *self, GCancellable *cancellable, GError **error)
   if (!ostree_repo_reload_config (self, cancellable, error))
     return FALSE;
 
+  /* See the metadata-objects-root config option */
+  if (self->metadata_objects_root != NULL)
+    {
+      if (self->writable
+          && mkdirat (self->repo_dir_fd, self->metadata_objects_root, DEFAULT_DIRECTORY_MODE) == -1
+          && errno != EEXIST)
+        return glnx_throw_errno_prefix (error, "mkdir(%s)", self->metadata_objects_root);
+      if (!glnx_opendirat (self->repo_dir_fd, self->metadata_objects_root, TRUE,
+                           &self->metadata_objects_dir_fd, error))
+        return FALSE;
+      if (!glnx_fstat (self->metadata_objects_dir_fd, &stbuf, error))
+        return FALSE;
+      self->metadata_objects_device = stbuf.st_dev;
+    }
+
   self->inited = TRUE;
   return TRUE;
 }
 
+/*
+ * _ostree_repo_objects_dir_fd_for_objtype:
+ *
+ * Return the directory root holding loose objects of @objtype.  Metadata
+ * objects live under a separate root when the metadata-objects-root config
+ * option is set; everything else (and all objects when the option is unset)
+ * lives under objects/.
+ */
+int
+_ostree_repo_objects_dir_fd_for_objtype (OstreeRepo *self, OstreeObjectType objtype)
+{
+  if (self->metadata_objects_dir_fd != -1 && OSTREE_OBJECT_TYPE_IS_META (objtype))
+    return self->metadata_objects_dir_fd;
+  return self->objects_dir_fd;
+}
+
 /**
  * ostree_repo_set_disable_fsync:
  * @self: An #OstreeRepo
@@ -3719,11 +4126,24 @@ list_loose_objects_at (OstreeRepo *self, GVariant *dummy_value, GHashTable *inou
   if (!exists)
     return TRUE;
 
+  /* The fanout prefix is the hex characters of @prefix, which may span one
+   * or two directory levels (see the deep-fanout config option). */
+  char prefix_hex[5];
+  gsize prefix_hexlen = 0;
+  for (const char *p = prefix; *p != '\0'; p++)
+    {
+      if (*p == '/')
+        continue;
+      g_assert_cmpuint (prefix_hexlen, <, sizeof (prefix_hex) - 1);
+      prefix_hex[prefix_hexlen++] = *p;
+    }
+  prefix_hex[prefix_hexlen] = '\0';
+
   while (TRUE)
     {
       struct dirent *dent;
 
-      if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, cancellable, error))
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
         return FALSE;
       if (dent == NULL)
         break;
@@ -3732,6 +4152,17 @@ list_loose_objects_at (OstreeRepo *self, GVariant *dummy_value, GHashTable *inou
       if (strcmp (name, ".") == 0 || strcmp (name, "..") == 0)
         continue;
 
+      /* A second-level fanout directory (deep-fanout layout); recurse */
+      if (dent->d_type == DT_DIR && prefix_hexlen == 2 && strlen (name) == 2
+          && g_ascii_isxdigit (name[0]) && g_ascii_isxdigit (name[1]))
+        {
+          g_autofree char *subprefix = g_strconcat (prefix, "/", name, NULL);
+          if (!list_loose_objects_at (self, dummy_value, inout_objects, dfd, subprefix,
+                                      commit_starting_with, cancellable, error))
+            return FALSE;
+          continue;
+        }
+
       const char *dot = strrchr (name, '.');
       if (!dot)
         continue;
@@ -3751,13 +4182,13 @@ list_loose_objects_at (OstreeRepo *self, GVariant *dummy_value, GHashTable *inou
       else
         continue;
 
-      if ((dot - name) != 62)
+      if ((gsize)(dot - name) != OSTREE_SHA256_STRING_LEN - prefix_hexlen)
         continue;
 
       char buf[OSTREE_SHA256_STRING_LEN + 1];
 
-      memcpy (buf, prefix, 2);
-      memcpy (buf + 2, name, 62);
+      memcpy (buf, prefix_hex, prefix_hexlen);
+      memcpy (buf + prefix_hexlen, name, OSTREE_SHA256_STRING_LEN - prefix_hexlen);
       buf[sizeof (buf) - 1] = '\0';
 
       /* if we passed in a "starting with" argument, then
@@ -3801,117 +4232,701 @@ list_loose_objects (OstreeRepo *self, GVariant *dummy_value, GHashTable *inout_o
       if (!list_loose_objects_at (self, dummy_value, inout_objects, self->objects_dir_fd, buf,
                                   commit_starting_with, cancellable, error))
         return FALSE;
+      if (self->metadata_objects_dir_fd != -1
+          && !list_loose_objects_at (self, dummy_value, inout_objects,
+                                     self->metadata_objects_dir_fd, buf, commit_starting_with,
+                                     cancellable, error))
+        return FALSE;
     }
 
   return TRUE;
 }
 
-static gboolean
-load_metadata_internal (OstreeRepo *self, OstreeObjectType objtype, const char *sha256,
-                        gboolean error_if_not_found, GVariant **out_variant,
-                        GInputStream **out_stream, guint64 *out_size,
-                        OstreeRepoCommitState *out_state, GCancellable *cancellable, GError **error)
+/*
+ * _ostree_repo_migrate_fanout:
+ *
+ * Move every loose object file into the configured fanout layout; see the
+ * deep-fanout config option.  Files are renamed within objects/, so the
+ * migration never copies data and is idempotent — it can be interrupted and
+ * re-run, and lookups fall back to the other layout in the meantime.  The
+ * caller should hold an exclusive repository lock.
+ */
+gboolean
+_ostree_repo_migrate_fanout (OstreeRepo *self, guint *out_n_migrated, GCancellable *cancellable,
+                             GError **error)
 {
-  char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
-  glnx_autofd int fd = -1;
-  g_autoptr (GInputStream) ret_stream = NULL;
-  g_autoptr (GVariant) ret_variant = NULL;
-
-  g_return_val_if_fail (OSTREE_OBJECT_TYPE_IS_META (objtype), FALSE);
-  g_return_val_if_fail (objtype == OSTREE_OBJECT_TYPE_COMMIT || out_state == NULL, FALSE);
-
-  /* Ensure this is set to NULL if we didn't find the object */
-  if (out_variant)
-    *out_variant = NULL;
-
-  /* Special caching for dirmeta objects, since they're commonly referenced many
-   * times.
-   */
-  const gboolean is_dirmeta_cachable
-      = (objtype == OSTREE_OBJECT_TYPE_DIR_META && out_variant && !out_stream);
-  if (is_dirmeta_cachable)
-    {
-      GMutex *lock = &self->cache_lock;
-      g_mutex_lock (lock);
-      GVariant *cache_hit = NULL;
-      /* Look it up, if we have a cache */
-      if (self->dirmeta_cache)
-        cache_hit = g_hash_table_lookup (self->dirmeta_cache, sha256);
-      if (cache_hit)
-        *out_variant = g_variant_ref (cache_hit);
-      g_mutex_unlock (lock);
-      if (cache_hit)
-        return TRUE;
-    }
-
-  _ostree_loose_path (loose_path_buf, sha256, objtype, self->mode);
+  static const gchar hexchars[] = "0123456789abcdef";
+  guint n_migrated = 0;
 
-  if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
+  if (!ostree_repo_is_writable (self, error))
     return FALSE;
 
-  if (fd < 0 && self->commit_stagedir.initialized)
+  /* Walk the metadata root too when one is configured */
+  const guint n_roots = (self->metadata_objects_dir_fd != -1) ? 2 : 1;
+  for (guint i = 0; i < n_roots * 256; i++)
     {
-      if (!ot_openat_ignore_enoent (self->commit_stagedir.fd, loose_path_buf, &fd, error))
-        return FALSE;
-    }
+      const guint c = i % 256;
+      const int root_dfd = (i < 256) ? self->objects_dir_fd : self->metadata_objects_dir_fd;
+      char buf[3];
+      buf[0] = hexchars[c >> 4];
+      buf[1] = hexchars[c & 0xF];
+      buf[2] = '\0';
 
-  if (fd != -1)
-    {
-      struct stat stbuf;
-      if (!glnx_fstat (fd, &stbuf, error))
+      g_auto (GLnxDirFdIterator) dfd_iter = {
+        0,
+      };
+      gboolean exists;
+      if (!ot_dfd_iter_init_allow_noent (root_dfd, buf, &dfd_iter, &exists, error))
         return FALSE;
-      if (out_variant)
-        {
-          if (!ot_variant_read_fd (fd, 0, ostree_metadata_variant_type (objtype), TRUE,
-                                   &ret_variant, error))
-            return FALSE;
+      if (!exists)
+        continue;
 
-          /* Now, let's put it in the cache */
-          if (is_dirmeta_cachable)
-            {
-              GMutex *lock = &self->cache_lock;
-              g_mutex_lock (lock);
-              if (self->dirmeta_cache)
-                g_hash_table_replace (self->dirmeta_cache, g_strdup (sha256),
-                                      g_variant_ref (ret_variant));
-              g_mutex_unlock (lock);
-            }
-        }
-      else if (out_stream)
+      while (TRUE)
         {
-          ret_stream = g_unix_input_stream_new (fd, TRUE);
-          if (!ret_stream)
-            return FALSE;
-          fd = -1; /* Transfer ownership */
-        }
+          struct dirent *dent;
 
-      if (out_size)
-        *out_size = stbuf.st_size;
+          if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+            return FALSE;
+          if (dent == NULL)
+            break;
 
-      if (out_state)
-        {
-          g_autofree char *commitpartial_path = _ostree_get_commitpartial_path (sha256);
-          *out_state = 0;
+          const char *name = dent->d_name;
+          if (strcmp (name, ".") == 0 || strcmp (name, "..") == 0)
+            continue;
 
-          glnx_autofd int commitpartial_fd = -1;
-          if (!ot_openat_ignore_enoent (self->repo_dir_fd, commitpartial_path, &commitpartial_fd,
-                                        error))
-            return FALSE;
-          if (commitpartial_fd != -1)
+          if (dent->d_type == DT_DIR)
             {
-              *out_state |= OSTREE_REPO_COMMIT_STATE_PARTIAL;
-              char reason;
-              if (read (commitpartial_fd, &reason, 1) == 1)
+              /* A second-level fanout directory; flatten it if the repository
+               * is configured for the single-level layout. */
+              if (self->deep_fanout || strlen (name) != 2 || !g_ascii_isxdigit (name[0])
+                  || !g_ascii_isxdigit (name[1]))
+                continue;
+
+              g_auto (GLnxDirFdIterator) sub_iter = {
+                0,
+              };
+              if (!glnx_dirfd_iterator_init_at (dfd_iter.fd, name, FALSE, &sub_iter, error))
+                return FALSE;
+              while (TRUE)
                 {
-                  if (reason == 'f')
-                    *out_state |= OSTREE_REPO_COMMIT_STATE_FSCK_PARTIAL;
+                  struct dirent *sub_dent;
+                  if (!glnx_dirfd_iterator_next_dent (&sub_iter, &sub_dent, cancellable, error))
+                    return FALSE;
+                  if (sub_dent == NULL)
+                    break;
+                  if (strcmp (sub_dent->d_name, ".") == 0 || strcmp (sub_dent->d_name, "..") == 0)
+                    continue;
+
+                  char newname[_OSTREE_LOOSE_PATH_MAX];
+                  snprintf (newname, sizeof (newname), "%s%s", name, sub_dent->d_name);
+                  if (renameat (sub_iter.fd, sub_dent->d_name, dfd_iter.fd, newname) < 0)
+                    return glnx_throw_errno_prefix (error, "renameat(%s/%s/%s)", buf, name,
+                                                    sub_dent->d_name);
+                  n_migrated++;
                 }
+              /* Best-effort; a leftover empty directory is harmless */
+              (void)unlinkat (dfd_iter.fd, name, AT_REMOVEDIR);
+            }
+          else if (self->deep_fanout)
+            {
+              if (strlen (name) <= 2 || !g_ascii_isxdigit (name[0])
+                  || !g_ascii_isxdigit (name[1]))
+                continue;
+
+              char subdir[3] = { name[0], name[1], '\0' };
+              if (mkdirat (dfd_iter.fd, subdir, 0777) < 0 && errno != EEXIST)
+                return glnx_throw_errno_prefix (error, "mkdirat(%s/%s)", buf, subdir);
+
+              char newname[_OSTREE_LOOSE_PATH_MAX];
+              snprintf (newname, sizeof (newname), "%s/%s", subdir, name + 2);
+              if (renameat (dfd_iter.fd, name, dfd_iter.fd, newname) < 0)
+                return glnx_throw_errno_prefix (error, "renameat(%s/%s)", buf, name);
+              n_migrated++;
             }
         }
     }
-  else if (self->parent_repo)
-    {
-      /* Directly recurse to simplify out parameters */
+
+  if (out_n_migrated != NULL)
+    *out_n_migrated = n_migrated;
+  return TRUE;
+}
+
+/* Rewrite one loose object file into a freshly preallocated copy and rename
+ * it over the original, giving copy-on-write filesystems a chance to lay the
+ * data out contiguously again.  File metadata (mode, ownership, xattrs,
+ * timestamps) is preserved, so this is safe for all repository modes.
+ *
+ * Objects with a link count above one are skipped: they're hardlinked into
+ * checkouts or deployments (or shared via local pulls), and rewriting would
+ * sever that sharing and duplicate the data on disk.  Files that fit in a
+ * single filesystem block can't fragment and are skipped too.
+ */
+static gboolean
+defrag_one_object (OstreeRepo *self, int dirfd, const char *name, gboolean *out_rewritten,
+                   GCancellable *cancellable, GError **error)
+{
+  *out_rewritten = FALSE;
+
+  glnx_autofd int src_fd = -1;
+  if (!glnx_openat_rdonly (dirfd, name, FALSE, &src_fd, error))
+    return FALSE;
+
+  struct stat stbuf;
+  if (!glnx_fstat (src_fd, &stbuf, error))
+    return FALSE;
+  if (!S_ISREG (stbuf.st_mode) || stbuf.st_nlink > 1 || stbuf.st_size <= stbuf.st_blksize)
+    return TRUE;
+
+  g_auto (GLnxTmpfile) tmpf = {
+    0,
+  };
+  if (!glnx_open_tmpfile_linkable_at (dirfd, ".", O_WRONLY | O_CLOEXEC, &tmpf, error))
+    return FALSE;
+  if (!glnx_try_fallocate (tmpf.fd, 0, stbuf.st_size, error))
+    return FALSE;
+
+  /* Plain sequential read/write; reflink-style copies would just share the
+   * fragmented extents we're trying to leave behind.
+   */
+  {
+    const gsize bufsize = 1 << 20;
+    g_autofree char *buf = g_malloc (bufsize);
+    while (TRUE)
+      {
+        ssize_t bytes_read = TEMP_FAILURE_RETRY (read (src_fd, buf, bufsize));
+        if (bytes_read < 0)
+          return glnx_throw_errno_prefix (error, "read(%s)", name);
+        if (bytes_read == 0)
+          break;
+        if (glnx_loop_write (tmpf.fd, buf, bytes_read) < 0)
+          return glnx_throw_errno_prefix (error, "write");
+      }
+  }
+
+  if (fchmod (tmpf.fd, stbuf.st_mode & 07777) < 0)
+    return glnx_throw_errno_prefix (error, "fchmod(%s)", name);
+  if (fchown (tmpf.fd, stbuf.st_uid, stbuf.st_gid) < 0)
+    return glnx_throw_errno_prefix (error, "fchown(%s)", name);
+  if (!self->disable_xattrs)
+    {
+      g_autoptr (GVariant) xattrs = NULL;
+      if (!glnx_fd_get_all_xattrs (src_fd, &xattrs, cancellable, error))
+        return FALSE;
+      if (!glnx_fd_set_all_xattrs (tmpf.fd, xattrs, cancellable, error))
+        return FALSE;
+    }
+  {
+    const struct timespec times[2] = { stbuf.st_atim, stbuf.st_mtim };
+    if (futimens (tmpf.fd, times) < 0)
+      return glnx_throw_errno_prefix (error, "futimens(%s)", name);
+  }
+
+  /* The copy must be durable before it replaces the original */
+  if (!self->disable_fsync && fsync (tmpf.fd) < 0)
+    return glnx_throw_errno_prefix (error, "fsync(%s)", name);
+
+  if (!glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, dirfd, name, error))
+    return FALSE;
+
+  *out_rewritten = TRUE;
+  return TRUE;
+}
+
+static gboolean
+defrag_objdir (OstreeRepo *self, int dfd, guint *inout_n_rewritten, GCancellable *cancellable,
+               GError **error)
+{
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (dfd, ".", FALSE, &dfd_iter, error))
+    return FALSE;
+
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+      if (dent->d_type != DT_REG)
+        continue;
+
+      gboolean rewritten;
+      if (!defrag_one_object (self, dfd_iter.fd, dent->d_name, &rewritten, cancellable, error))
+        return FALSE;
+      if (rewritten)
+        (*inout_n_rewritten)++;
+    }
+
+  return TRUE;
+}
+
+/*
+ * _ostree_repo_defrag:
+ *
+ * Rewrite every eligible loose object file into a fresh contiguous copy; see
+ * defrag_one_object() for the eligibility rules.  Walks both fanout layouts,
+ * so it works regardless of the deep-fanout setting.  The caller should hold
+ * an exclusive repository lock, since objects are replaced in place.
+ */
+gboolean
+_ostree_repo_defrag (OstreeRepo *self, guint *out_n_rewritten, GCancellable *cancellable,
+                     GError **error)
+{
+  static const gchar hexchars[] = "0123456789abcdef";
+  guint n_rewritten = 0;
+
+  if (!ostree_repo_is_writable (self, error))
+    return FALSE;
+
+  /* Walk the metadata root too when one is configured */
+  const guint n_roots = (self->metadata_objects_dir_fd != -1) ? 2 : 1;
+  for (guint i = 0; i < n_roots * 256; i++)
+    {
+      const guint c = i % 256;
+      const int root_dfd = (i < 256) ? self->objects_dir_fd : self->metadata_objects_dir_fd;
+      char buf[3];
+      buf[0] = hexchars[c >> 4];
+      buf[1] = hexchars[c & 0xF];
+      buf[2] = '\0';
+
+      g_auto (GLnxDirFdIterator) dfd_iter = {
+        0,
+      };
+      gboolean exists;
+      if (!ot_dfd_iter_init_allow_noent (root_dfd, buf, &dfd_iter, &exists, error))
+        return FALSE;
+      if (!exists)
+        continue;
+
+      while (TRUE)
+        {
+          struct dirent *dent;
+
+          if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+            return FALSE;
+          if (dent == NULL)
+            break;
+
+          if (dent->d_type == DT_REG)
+            {
+              gboolean rewritten;
+              if (!defrag_one_object (self, dfd_iter.fd, dent->d_name, &rewritten, cancellable,
+                                      error))
+                return FALSE;
+              if (rewritten)
+                n_rewritten++;
+            }
+          else if (dent->d_type == DT_DIR && strlen (dent->d_name) == 2
+                   && g_ascii_isxdigit (dent->d_name[0]) && g_ascii_isxdigit (dent->d_name[1]))
+            {
+              /* Second-level fanout directory */
+              glnx_autofd int sub_dfd = -1;
+              if (!glnx_opendirat (dfd_iter.fd, dent->d_name, FALSE, &sub_dfd, error))
+                return FALSE;
+              if (!defrag_objdir (self, sub_dfd, &n_rewritten, cancellable, error))
+                return FALSE;
+            }
+        }
+    }
+
+  if (out_n_rewritten != NULL)
+    *out_n_rewritten = n_rewritten;
+  return TRUE;
+}
+
+/* Lazily build the in-memory commit state index by enumerating state/ once.
+ * The `.commitpartial` marker files remain the authoritative on-disk journal;
+ * this just avoids a stat per commit on every load path, which adds up when
+ * traversing repositories with very many commits.  Partial commits are rare
+ * relative to the commit count, so the directory is typically small.
+ * ostree_repo_mark_commit_partial_reason() keeps the index coherent with the
+ * markers it writes.
+ */
+static gboolean
+commit_state_index_ensure (OstreeRepo *self, GError **error)
+{
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&self->commit_state_lock);
+  if (self->commit_state_initialized)
+    {
+      ret = TRUE;
+      goto out;
+    }
+
+  g_autoptr (GHashTable) index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  gboolean exists;
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!ot_dfd_iter_init_allow_noent (self->repo_dir_fd, "state", &dfd_iter, &exists, error))
+    goto out;
+
+  while (exists)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, NULL, error))
+        goto out;
+      if (dent == NULL)
+        break;
+
+      const char *name = dent->d_name;
+      if (!g_str_has_suffix (name, ".commitpartial"))
+        continue;
+      gsize csumlen = strlen (name) - strlen (".commitpartial");
+      if (csumlen != OSTREE_SHA256_STRING_LEN)
+        continue;
+
+      guint state = OSTREE_REPO_COMMIT_STATE_PARTIAL;
+      glnx_autofd int fd = -1;
+      if (!ot_openat_ignore_enoent (dfd_iter.fd, name, &fd, error))
+        goto out;
+      if (fd != -1)
+        {
+          char reason;
+          if (read (fd, &reason, 1) == 1 && reason == 'f')
+            state |= OSTREE_REPO_COMMIT_STATE_FSCK_PARTIAL;
+        }
+
+      g_hash_table_replace (index, g_strndup (name, csumlen), GUINT_TO_POINTER (state));
+    }
+
+  self->commit_state_index = g_steal_pointer (&index);
+  self->commit_state_initialized = TRUE;
+  ret = TRUE;
+out:
+  g_mutex_unlock (&self->commit_state_lock);
+  return ret;
+}
+
+void
+_ostree_repo_commit_state_index_clear (OstreeRepo *self)
+{
+  g_mutex_lock (&self->commit_state_lock);
+  g_clear_pointer (&self->commit_state_index, g_hash_table_unref);
+  self->commit_state_initialized = FALSE;
+  g_mutex_unlock (&self->commit_state_lock);
+}
+
+/* Called by ostree_repo_mark_commit_partial_reason() after it has updated the
+ * on-disk marker, so an already-built index stays coherent.  A no-op if the
+ * index hasn't been built yet; the next enumeration will see the marker.
+ */
+void
+_ostree_repo_commit_state_index_update (OstreeRepo *self, const char *checksum,
+                                        OstreeRepoCommitState state)
+{
+  g_mutex_lock (&self->commit_state_lock);
+  if (self->commit_state_initialized)
+    {
+      if (state == OSTREE_REPO_COMMIT_STATE_NORMAL)
+        g_hash_table_remove (self->commit_state_index, checksum);
+      else
+        g_hash_table_replace (self->commit_state_index, g_strdup (checksum),
+                              GUINT_TO_POINTER ((guint)state));
+    }
+  g_mutex_unlock (&self->commit_state_lock);
+}
+
+static gboolean
+load_commitpartial_state (OstreeRepo *self, const char *sha256, OstreeRepoCommitState *out_state,
+                          GError **error)
+{
+  *out_state = 0;
+
+  if (!commit_state_index_ensure (self, error))
+    return FALSE;
+
+  g_mutex_lock (&self->commit_state_lock);
+  gpointer value;
+  if (self->commit_state_index != NULL
+      && g_hash_table_lookup_extended (self->commit_state_index, sha256, NULL, &value))
+    *out_state = (OstreeRepoCommitState)GPOINTER_TO_UINT (value);
+  g_mutex_unlock (&self->commit_state_lock);
+
+  return TRUE;
+}
+
+/* Entry in the repo-level LRU cache of parsed metadata variants.  Trees
+ * commonly share a handful of dirmeta objects across very many directories,
+ * and pull/checkout/diff/traverse all load the hot dirtree/dirmeta objects
+ * repeatedly, so keeping a bounded number of them parsed pays for itself.
+ */
+typedef struct
+{
+  const char *key; /* Owned by the metadata_cache hash table */
+  GVariant *variant;
+  GList *link; /* Node in metadata_cache_lru */
+} MetadataCacheEntry;
+
+static void
+metadata_cache_entry_free (gpointer data)
+{
+  MetadataCacheEntry *entry = data;
+  g_variant_unref (entry->variant);
+  g_list_free_1 (entry->link);
+  g_free (entry);
+}
+
+static char *
+metadata_cache_key (OstreeObjectType objtype, const char *sha256)
+{
+  return g_strdup_printf ("%s.%u", sha256, (guint)objtype);
+}
+
+/* Returns a new ref to the cached variant, or %NULL on a miss */
+static GVariant *
+metadata_cache_lookup (OstreeRepo *self, OstreeObjectType objtype, const char *sha256)
+{
+  if (self->metadata_cache_size == 0)
+    return NULL;
+
+  g_autofree char *key = metadata_cache_key (objtype, sha256);
+  GVariant *ret = NULL;
+
+  g_mutex_lock (&self->cache_lock);
+  MetadataCacheEntry *entry
+      = self->metadata_cache ? g_hash_table_lookup (self->metadata_cache, key) : NULL;
+  if (entry != NULL)
+    {
+      g_queue_unlink (&self->metadata_cache_lru, entry->link);
+      g_queue_push_head_link (&self->metadata_cache_lru, entry->link);
+      ret = g_variant_ref (entry->variant);
+    }
+  g_mutex_unlock (&self->cache_lock);
+  return ret;
+}
+
+static void
+metadata_cache_insert (OstreeRepo *self, OstreeObjectType objtype, const char *sha256,
+                       GVariant *variant)
+{
+  if (self->metadata_cache_size == 0)
+    return;
+
+  char *key = metadata_cache_key (objtype, sha256);
+
+  g_mutex_lock (&self->cache_lock);
+  if (self->metadata_cache == NULL)
+    self->metadata_cache
+        = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, metadata_cache_entry_free);
+
+  if (g_hash_table_contains (self->metadata_cache, key))
+    {
+      g_mutex_unlock (&self->cache_lock);
+      g_free (key);
+      return;
+    }
+
+  MetadataCacheEntry *entry = g_new0 (MetadataCacheEntry, 1);
+  entry->key = key;
+  entry->variant = g_variant_ref (variant);
+  entry->link = g_list_alloc ();
+  entry->link->data = entry;
+  g_hash_table_replace (self->metadata_cache, key, entry);
+  g_queue_push_head_link (&self->metadata_cache_lru, entry->link);
+
+  while (g_hash_table_size (self->metadata_cache) > self->metadata_cache_size)
+    {
+      GList *tail = g_queue_pop_tail_link (&self->metadata_cache_lru);
+      MetadataCacheEntry *evicted = tail->data;
+      /* The entry owns its (now unlinked) list node and frees it */
+      g_hash_table_remove (self->metadata_cache, evicted->key);
+    }
+  g_mutex_unlock (&self->cache_lock);
+}
+
+/* Find the first fallback repository containing @checksum — the parent,
+ * then the configured object pools in order — or set *out_repo to NULL if
+ * none has it.  Only used when object pools are configured; the plain
+ * parent chain recurses directly without a presence probe.
+ */
+static gboolean
+repo_lookup_fallback (OstreeRepo *self, OstreeObjectType objtype, const char *checksum,
+                      OstreeRepo **out_repo, GCancellable *cancellable, GError **error)
+{
+  *out_repo = NULL;
+
+  if (self->parent_repo != NULL)
+    {
+      gboolean have_object = FALSE;
+      if (!ostree_repo_has_object (self->parent_repo, objtype, checksum, &have_object, cancellable,
+                                   error))
+        return FALSE;
+      if (have_object)
+        {
+          *out_repo = self->parent_repo;
+          return TRUE;
+        }
+    }
+
+  if (self->object_pools != NULL)
+    {
+      for (guint i = 0; i < self->object_pools->len; i++)
+        {
+          OstreeRepo *pool = self->object_pools->pdata[i];
+          gboolean have_object = FALSE;
+          if (!ostree_repo_has_object (pool, objtype, checksum, &have_object, cancellable, error))
+            return FALSE;
+          if (have_object)
+            {
+              *out_repo = pool;
+              return TRUE;
+            }
+        }
+    }
+
+  return TRUE;
+}
+
+static gboolean
+load_metadata_internal (OstreeRepo *self, OstreeObjectType objtype, const char *sha256,
+                        gboolean error_if_not_found, GVariant **out_variant,
+                        GInputStream **out_stream, guint64 *out_size,
+                        OstreeRepoCommitState *out_state, GCancellable *cancellable, GError **error)
+{
+  char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
+  glnx_autofd int fd = -1;
+  g_autoptr (GInputStream) ret_stream = NULL;
+  g_autoptr (GVariant) ret_variant = NULL;
+
+  g_return_val_if_fail (OSTREE_OBJECT_TYPE_IS_META (objtype), FALSE);
+  g_return_val_if_fail (objtype == OSTREE_OBJECT_TYPE_COMMIT || out_state == NULL, FALSE);
+
+  /* Ensure this is set to NULL if we didn't find the object */
+  if (out_variant)
+    *out_variant = NULL;
+
+  /* Special caching for dirtree/dirmeta objects, since they're commonly
+   * referenced many times.
+   */
+  const gboolean is_metadata_cachable
+      = ((objtype == OSTREE_OBJECT_TYPE_DIR_META || objtype == OSTREE_OBJECT_TYPE_DIR_TREE)
+         && out_variant && !out_stream);
+  if (is_metadata_cachable)
+    {
+      *out_variant = metadata_cache_lookup (self, objtype, sha256);
+      if (*out_variant)
+        return TRUE;
+    }
+
+  _ostree_repo_loose_path (self, loose_path_buf, sha256, objtype);
+
+  const int objdir_fd = _ostree_repo_objects_dir_fd_for_objtype (self, objtype);
+  if (!ot_openat_ignore_enoent (objdir_fd, loose_path_buf, &fd, error))
+    return FALSE;
+
+  if (fd < 0 && self->commit_stagedir.initialized)
+    {
+      if (!ot_openat_ignore_enoent (self->commit_stagedir.fd, loose_path_buf, &fd, error))
+        return FALSE;
+    }
+
+  if (fd < 0 && _ostree_repo_loose_path_alternate (self, loose_path_buf, sha256, objtype))
+    {
+      if (!ot_openat_ignore_enoent (objdir_fd, loose_path_buf, &fd, error))
+        return FALSE;
+    }
+
+  /* Metadata written before metadata-objects-root was set lives under the
+   * primary root */
+  if (fd < 0 && objdir_fd != self->objects_dir_fd)
+    {
+      _ostree_repo_loose_path (self, loose_path_buf, sha256, objtype);
+      if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
+        return FALSE;
+      if (fd < 0 && _ostree_repo_loose_path_alternate (self, loose_path_buf, sha256, objtype))
+        {
+          if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
+            return FALSE;
+        }
+    }
+
+  g_autoptr (GBytes) packed = NULL;
+  if (fd < 0)
+    {
+      if (!_ostree_repo_pack_lookup (self, sha256, objtype, &packed, cancellable, error))
+        return FALSE;
+    }
+
+  if (fd != -1)
+    {
+      struct stat stbuf;
+      if (!glnx_fstat (fd, &stbuf, error))
+        return FALSE;
+      if (out_variant)
+        {
+          if (!ot_variant_read_fd (fd, 0, ostree_metadata_variant_type (objtype), TRUE,
+                                   &ret_variant, error))
+            return FALSE;
+
+          /* Now, let's put it in the cache */
+          if (is_metadata_cachable)
+            metadata_cache_insert (self, objtype, sha256, ret_variant);
+        }
+      else if (out_stream)
+        {
+          ret_stream = g_unix_input_stream_new (fd, TRUE);
+          if (!ret_stream)
+            return FALSE;
+          fd = -1; /* Transfer ownership */
+        }
+
+      if (out_size)
+        *out_size = stbuf.st_size;
+
+      if (out_state && !load_commitpartial_state (self, sha256, out_state, error))
+        return FALSE;
+    }
+  else if (packed != NULL)
+    {
+      /* The object was consolidated into a pack file; serve it from the
+       * mmap'ed pack data.  Packs are built from verified loose objects, so
+       * the data is trusted like the loose path above.
+       */
+      if (out_variant)
+        {
+          ret_variant = g_variant_ref_sink (
+              g_variant_new_from_bytes (ostree_metadata_variant_type (objtype), packed, TRUE));
+
+          if (is_metadata_cachable)
+            metadata_cache_insert (self, objtype, sha256, ret_variant);
+        }
+      else if (out_stream)
+        ret_stream = g_memory_input_stream_new_from_bytes (packed);
+
+      if (out_size)
+        *out_size = g_bytes_get_size (packed);
+
+      if (out_state && !load_commitpartial_state (self, sha256, out_state, error))
+        return FALSE;
+    }
+  else if (self->object_pools != NULL)
+    {
+      /* With pools configured we must probe before recursing so that a
+       * not-found in one candidate moves on to the next. */
+      OstreeRepo *fallback = NULL;
+      if (!repo_lookup_fallback (self, objtype, sha256, &fallback, cancellable, error))
+        return FALSE;
+      if (fallback != NULL)
+        {
+          /* Directly recurse to simplify out parameters */
+          return load_metadata_internal (fallback, objtype, sha256, error_if_not_found, out_variant,
+                                         out_stream, out_size, out_state, cancellable, error);
+        }
+      if (error_if_not_found)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No such metadata object %s.%s",
+                       sha256, ostree_object_type_to_string (objtype));
+          return FALSE;
+        }
+    }
+  else if (self->parent_repo)
+    {
+      /* Directly recurse to simplify out parameters */
       return load_metadata_internal (self->parent_repo, objtype, sha256, error_if_not_found,
                                      out_variant, out_stream, out_size, out_state, cancellable,
                                      error);
@@ -3939,49 +4954,268 @@ filemeta_to_stat (struct stat *stbuf, GVariant *metadata)
   stbuf->st_gid = GUINT32_FROM_BE (gid);
   stbuf->st_mode = GUINT32_FROM_BE (mode);
 
-  return xattrs;
+  return xattrs;
+}
+
+static gboolean
+repo_load_file_archive (OstreeRepo *self, const char *checksum, GInputStream **out_input,
+                        GFileInfo **out_file_info, GVariant **out_xattrs, GCancellable *cancellable,
+                        GError **error)
+{
+  struct stat stbuf;
+  char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
+  _ostree_repo_loose_path (self, loose_path_buf, checksum, OSTREE_OBJECT_TYPE_FILE);
+
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
+    return FALSE;
+
+  if (fd < 0 && self->commit_stagedir.initialized)
+    {
+      if (!ot_openat_ignore_enoent (self->commit_stagedir.fd, loose_path_buf, &fd, error))
+        return FALSE;
+    }
+
+  if (fd < 0 && _ostree_repo_loose_path_alternate (self, loose_path_buf, checksum, OSTREE_OBJECT_TYPE_FILE))
+    {
+      if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
+        return FALSE;
+    }
+
+  if (fd != -1)
+    {
+      if (!glnx_fstat (fd, &stbuf, error))
+        return FALSE;
+
+      g_autoptr (GInputStream) tmp_stream = g_unix_input_stream_new (g_steal_fd (&fd), TRUE);
+      /* Note return here */
+      return ostree_content_stream_parse (TRUE, tmp_stream, stbuf.st_size, TRUE, out_input,
+                                          out_file_info, out_xattrs, cancellable, error);
+    }
+
+  g_autoptr (GBytes) packed = NULL;
+  if (!_ostree_repo_pack_lookup (self, checksum, OSTREE_OBJECT_TYPE_FILE, &packed, cancellable,
+                                 error))
+    return FALSE;
+
+  if (packed != NULL)
+    {
+      /* Packed objects are the loose file content byte for byte, so parse
+       * them identically; the stream is a zero-copy view of the mmap'ed pack.
+       */
+      g_autoptr (GInputStream) tmp_stream = g_memory_input_stream_new_from_bytes (packed);
+      return ostree_content_stream_parse (TRUE, tmp_stream, g_bytes_get_size (packed), TRUE,
+                                          out_input, out_file_info, out_xattrs, cancellable,
+                                          error);
+    }
+
+  /* Large content objects may have been split into content-defined chunks;
+   * see ostree-repo-chunked.c.
+   */
+  gboolean chunked_found = FALSE;
+  if (!_ostree_repo_chunked_load (self, checksum, &chunked_found, out_input, out_file_info,
+                                  out_xattrs, cancellable, error))
+    return FALSE;
+
+  if (chunked_found)
+    return TRUE;
+  else if (self->object_pools != NULL)
+    {
+      OstreeRepo *fallback = NULL;
+      if (!repo_lookup_fallback (self, OSTREE_OBJECT_TYPE_FILE, checksum, &fallback, cancellable,
+                                 error))
+        return FALSE;
+      if (fallback != NULL)
+        return ostree_repo_load_file (fallback, checksum, out_input, out_file_info, out_xattrs,
+                                      cancellable, error);
+
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "Couldn't find file object '%s'",
+                   checksum);
+      return FALSE;
+    }
+  else if (self->parent_repo)
+    {
+      return ostree_repo_load_file (self->parent_repo, checksum, out_input, out_file_info,
+                                    out_xattrs, cancellable, error);
+    }
+  else
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "Couldn't find file object '%s'",
+                   checksum);
+      return FALSE;
+    }
+}
+
+/* Bare-user file metadata lives in a user.ostreemeta xattr per object, and
+ * checkout-heavy workloads pay one fgetxattr() per object accessed.  We batch
+ * those: the first lookup in a fanout directory scans it in a single pass and
+ * caches every object's metadata, and the scan result is persisted as a
+ * per-directory sidecar under tmp/cache so later processes load it with one
+ * read instead of re-walking the directory.  A sidecar records the fanout
+ * directory's mtime and is discarded when the directory has changed (new or
+ * pruned objects); objects the cache doesn't know about fall back to the
+ * object's own xattr.
+ */
+#define BARE_USER_META_CACHE_DIR "bare-user-meta"
+#define BARE_USER_META_CACHE_VERSION 1
+/* version, dir mtime (sec, nsec), then object basename → file metadata */
+#define BARE_USER_META_CACHE_GVARIANT_STRING "(utta{s" OSTREE_FILEMETA_GVARIANT_STRING "})"
+#define BARE_USER_META_CACHE_GVARIANT_FORMAT G_VARIANT_TYPE (BARE_USER_META_CACHE_GVARIANT_STRING)
+
+static GHashTable *
+bare_user_meta_table_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_bytes_unref);
+}
+
+/* Load the sidecar for fanout dir @prefix, or %NULL if it's absent or no
+ * longer matches the directory. */
+static GHashTable *
+bare_user_meta_sidecar_load (OstreeRepo *self, const char *prefix, const struct stat *dir_stbuf)
+{
+  if (self->cache_dir_fd == -1)
+    return NULL;
+
+  g_autofree char *path = g_strconcat (BARE_USER_META_CACHE_DIR "/", prefix, NULL);
+  glnx_autofd int fd = -1;
+  if (!glnx_openat_rdonly (self->cache_dir_fd, path, TRUE, &fd, NULL))
+    return NULL;
+
+  g_autoptr (GVariant) sidecar = NULL;
+  if (!ot_variant_read_fd (fd, 0, BARE_USER_META_CACHE_GVARIANT_FORMAT, TRUE, &sidecar, NULL))
+    return NULL;
+
+  guint32 version;
+  guint64 mtime_sec, mtime_nsec;
+  g_autoptr (GVariant) entries = NULL;
+  g_variant_get (sidecar, "(utt@a{s" OSTREE_FILEMETA_GVARIANT_STRING "})", &version, &mtime_sec,
+                 &mtime_nsec, &entries);
+  if (version != BARE_USER_META_CACHE_VERSION || mtime_sec != (guint64)dir_stbuf->st_mtim.tv_sec
+      || mtime_nsec != (guint64)dir_stbuf->st_mtim.tv_nsec)
+    return NULL;
+
+  g_autoptr (GHashTable) table = bare_user_meta_table_new ();
+  GVariantIter iter;
+  g_variant_iter_init (&iter, entries);
+  const char *name;
+  GVariant *meta;
+  while (g_variant_iter_loop (&iter, "{&s@" OSTREE_FILEMETA_GVARIANT_STRING "}", &name, &meta))
+    g_hash_table_replace (table, g_strdup (name), g_variant_get_data_as_bytes (meta));
+  return g_steal_pointer (&table);
+}
+
+/* Best-effort; the sidecar is purely a cache, so failures to persist it
+ * (e.g. a read-only repository) are ignored. */
+static void
+bare_user_meta_sidecar_save (OstreeRepo *self, const char *prefix, const struct stat *dir_stbuf,
+                             GHashTable *table)
+{
+  if (self->cache_dir_fd == -1 || g_hash_table_size (table) == 0)
+    return;
+
+  g_auto (GVariantBuilder) entries_builder;
+  g_variant_builder_init (&entries_builder,
+                          G_VARIANT_TYPE ("a{s" OSTREE_FILEMETA_GVARIANT_STRING "}"));
+  GLNX_HASH_TABLE_FOREACH_KV (table, const char *, name, GBytes *, bytes)
+    g_variant_builder_add_value (
+        &entries_builder,
+        g_variant_new_dict_entry (
+            g_variant_new_string (name),
+            /* Serialize-only path; the bytes came straight from our own
+             * xattrs, so skip validation. */
+            g_variant_new_from_bytes (OSTREE_FILEMETA_GVARIANT_FORMAT, bytes, TRUE)));
+
+  g_autoptr (GVariant) sidecar = g_variant_ref_sink (g_variant_new (
+      "(utt@a{s" OSTREE_FILEMETA_GVARIANT_STRING "})", (guint32)BARE_USER_META_CACHE_VERSION,
+      (guint64)dir_stbuf->st_mtim.tv_sec, (guint64)dir_stbuf->st_mtim.tv_nsec,
+      g_variant_builder_end (&entries_builder)));
+
+  g_autofree char *path = g_strconcat (BARE_USER_META_CACHE_DIR "/", prefix, NULL);
+  g_autofree char *dirpath = g_path_get_dirname (path);
+  if (!glnx_shutil_mkdir_p_at (self->cache_dir_fd, dirpath, DEFAULT_DIRECTORY_MODE, NULL, NULL))
+    return;
+  (void)glnx_file_replace_contents_at (self->cache_dir_fd, path, g_variant_get_data (sidecar),
+                                       g_variant_get_size (sidecar), GLNX_FILE_REPLACE_NODATASYNC,
+                                       NULL, NULL);
+}
+
+/* One pass over fanout dir @prefix collecting every object's metadata
+ * xattr.  Unreadable entries are skipped; the caller falls back to the
+ * per-object xattr for anything missing. */
+static GHashTable *
+bare_user_meta_scan_dir (OstreeRepo *self, const char *prefix, GCancellable *cancellable)
+{
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (self->objects_dir_fd, prefix, FALSE, &dfd_iter, NULL))
+    return NULL;
+
+  g_autoptr (GHashTable) table = bare_user_meta_table_new ();
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, NULL))
+        return NULL;
+      if (dent == NULL)
+        break;
+      if (dent->d_type != DT_REG || !g_str_has_suffix (dent->d_name, ".file"))
+        continue;
+
+      glnx_autofd int fd = -1;
+      if (!glnx_openat_rdonly (dfd_iter.fd, dent->d_name, FALSE, &fd, NULL))
+        continue;
+      g_autoptr (GBytes) bytes = glnx_fgetxattr_bytes (fd, "user.ostreemeta", NULL);
+      if (bytes == NULL)
+        continue;
+      g_hash_table_replace (table, g_strdup (dent->d_name), g_steal_pointer (&bytes));
+    }
+  return g_steal_pointer (&table);
 }
 
-static gboolean
-repo_load_file_archive (OstreeRepo *self, const char *checksum, GInputStream **out_input,
-                        GFileInfo **out_file_info, GVariant **out_xattrs, GCancellable *cancellable,
-                        GError **error)
+/* Look up the user.ostreemeta value for loose object @loose_path ("xx/...")
+ * in the per-directory cache, populating the cache on first use.  Returns
+ * %NULL (without error) when the cache can't answer. */
+static GBytes *
+bare_user_meta_cache_lookup (OstreeRepo *self, const char *loose_path, GCancellable *cancellable)
 {
-  struct stat stbuf;
-  char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (loose_path_buf, checksum, OSTREE_OBJECT_TYPE_FILE, self->mode);
-
-  glnx_autofd int fd = -1;
-  if (!ot_openat_ignore_enoent (self->objects_dir_fd, loose_path_buf, &fd, error))
-    return FALSE;
+  /* The fanout prefix may be one or two levels deep; see the deep-fanout
+   * config option. */
+  const char *last_slash = strrchr (loose_path, '/');
+  g_assert (last_slash != NULL);
+  g_autofree char *prefix = g_strndup (loose_path, last_slash - loose_path);
+  const char *basename = last_slash + 1;
 
-  if (fd < 0 && self->commit_stagedir.initialized)
-    {
-      if (!ot_openat_ignore_enoent (self->commit_stagedir.fd, loose_path_buf, &fd, error))
-        return FALSE;
-    }
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&self->cache_lock);
+  if (self->bare_user_meta_cache == NULL)
+    self->bare_user_meta_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                        (GDestroyNotify)g_hash_table_unref);
 
-  if (fd != -1)
+  GHashTable *dir_table = g_hash_table_lookup (self->bare_user_meta_cache, prefix);
+  if (dir_table == NULL)
     {
-      if (!glnx_fstat (fd, &stbuf, error))
-        return FALSE;
+      struct stat dir_stbuf;
+      if (TEMP_FAILURE_RETRY (fstatat (self->objects_dir_fd, prefix, &dir_stbuf, 0)) < 0)
+        return NULL;
 
-      g_autoptr (GInputStream) tmp_stream = g_unix_input_stream_new (g_steal_fd (&fd), TRUE);
-      /* Note return here */
-      return ostree_content_stream_parse (TRUE, tmp_stream, stbuf.st_size, TRUE, out_input,
-                                          out_file_info, out_xattrs, cancellable, error);
-    }
-  else if (self->parent_repo)
-    {
-      return ostree_repo_load_file (self->parent_repo, checksum, out_input, out_file_info,
-                                    out_xattrs, cancellable, error);
-    }
-  else
-    {
-      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "Couldn't find file object '%s'",
-                   checksum);
-      return FALSE;
+      g_autoptr (GHashTable) new_table = bare_user_meta_sidecar_load (self, prefix, &dir_stbuf);
+      if (new_table == NULL)
+        {
+          new_table = bare_user_meta_scan_dir (self, prefix, cancellable);
+          if (new_table == NULL)
+            return NULL;
+          bare_user_meta_sidecar_save (self, prefix, &dir_stbuf, new_table);
+        }
+      dir_table = new_table;
+      g_hash_table_insert (self->bare_user_meta_cache, g_strdup (prefix),
+                           g_steal_pointer (&new_table));
     }
+
+  GBytes *bytes = g_hash_table_lookup (dir_table, basename);
+  if (bytes != NULL)
+    return g_bytes_ref (bytes);
+  /* e.g. an object committed after the directory was scanned */
+  return NULL;
 }
 
 static GVariant *
@@ -3992,12 +5226,23 @@ _ostree_repo_read_xattrs_file_link (OstreeRepo *self, const char *checksum,
   g_assert (checksum != NULL);
 
   char xattr_path[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (xattr_path, checksum, OSTREE_OBJECT_TYPE_FILE_XATTRS_LINK, self->mode);
+  _ostree_repo_loose_path (self, xattr_path, checksum, OSTREE_OBJECT_TYPE_FILE_XATTRS_LINK);
 
   g_autoptr (GVariant) xattrs = NULL;
   glnx_autofd int fd = -1;
-  if (!glnx_openat_rdonly (self->objects_dir_fd, xattr_path, FALSE, &fd, error))
+  if (!ot_openat_ignore_enoent (self->objects_dir_fd, xattr_path, &fd, error))
     return FALSE;
+  if (fd < 0)
+    {
+      if (_ostree_repo_loose_path_alternate (self, xattr_path, checksum,
+                                             OSTREE_OBJECT_TYPE_FILE_XATTRS_LINK))
+        {
+          if (!ot_openat_ignore_enoent (self->objects_dir_fd, xattr_path, &fd, error))
+            return FALSE;
+        }
+      if (fd < 0)
+        return glnx_null_throw_errno_prefix (error, "openat(%s)", xattr_path);
+    }
 
   g_assert (fd >= 0);
   if (!ot_variant_read_fd (fd, 0, G_VARIANT_TYPE ("a(ayay)"), TRUE, &xattrs, error))
@@ -4028,7 +5273,7 @@ _ostree_repo_load_file_bare (OstreeRepo *self, const char *checksum, int *out_fd
   g_autofree char *ret_symlink = NULL;
   g_autoptr (GVariant) ret_xattrs = NULL;
   char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (loose_path_buf, checksum, OSTREE_OBJECT_TYPE_FILE, self->mode);
+  _ostree_repo_loose_path (self, loose_path_buf, checksum, OSTREE_OBJECT_TYPE_FILE);
 
   /* Do a fstatat() and find the object directory that contains this object */
   int objdir_fd = self->objects_dir_fd;
@@ -4040,11 +5285,28 @@ _ostree_repo_load_file_bare (OstreeRepo *self, const char *checksum, int *out_fd
       objdir_fd = self->commit_stagedir.fd;
       res = TEMP_FAILURE_RETRY (fstatat (objdir_fd, loose_path_buf, &stbuf, AT_SYMLINK_NOFOLLOW));
     }
+  if (res < 0 && errno == ENOENT
+      && _ostree_repo_loose_path_alternate (self, loose_path_buf, checksum,
+                                            OSTREE_OBJECT_TYPE_FILE))
+    {
+      objdir_fd = self->objects_dir_fd;
+      res = TEMP_FAILURE_RETRY (fstatat (objdir_fd, loose_path_buf, &stbuf, AT_SYMLINK_NOFOLLOW));
+    }
   if (res < 0 && errno != ENOENT)
     return glnx_throw_errno_prefix (error, "fstat");
   else if (res < 0)
     {
       g_assert (errno == ENOENT);
+      if (self->object_pools != NULL)
+        {
+          /* A NULL fallback hits the not-found base case above */
+          OstreeRepo *fallback = NULL;
+          if (!repo_lookup_fallback (self, OSTREE_OBJECT_TYPE_FILE, checksum, &fallback,
+                                     cancellable, error))
+            return FALSE;
+          return _ostree_repo_load_file_bare (fallback, checksum, out_fd, out_stbuf, out_symlink,
+                                              out_xattrs, cancellable, error);
+        }
       return _ostree_repo_load_file_bare (self->parent_repo, checksum, out_fd, out_stbuf,
                                           out_symlink, out_xattrs, cancellable, error);
     }
@@ -4075,12 +5337,26 @@ _ostree_repo_load_file_bare (OstreeRepo *self, const char *checksum, int *out_fd
 
   if (self->mode == OSTREE_REPO_MODE_BARE_USER)
     {
-      g_autoptr (GBytes) bytes = glnx_fgetxattr_bytes (fd, "user.ostreemeta", error);
+      /* Consult the per-directory metadata cache first; anything it doesn't
+       * know about (an object written after the directory was scanned, or
+       * one living in the staging directory) falls back to the object's own
+       * xattr. */
+      g_autoptr (GBytes) bytes = NULL;
+      if (objdir_fd == self->objects_dir_fd)
+        bytes = bare_user_meta_cache_lookup (self, loose_path_buf, cancellable);
       if (bytes == NULL)
-        return FALSE;
+        {
+          bytes = glnx_fgetxattr_bytes (fd, "user.ostreemeta", error);
+          if (bytes == NULL)
+            return FALSE;
+        }
 
+      /* The xattr was written by this repo (or copied from its sidecar
+       * cache), so treat it as trusted like loose metadata objects; lazy
+       * untrusted validation otherwise runs on every file query.
+       */
       g_autoptr (GVariant) metadata = g_variant_ref_sink (
-          g_variant_new_from_bytes (OSTREE_FILEMETA_GVARIANT_FORMAT, bytes, FALSE));
+          g_variant_new_from_bytes (OSTREE_FILEMETA_GVARIANT_FORMAT, bytes, TRUE));
       ret_xattrs = filemeta_to_stat (&stbuf, metadata);
       if (S_ISLNK (stbuf.st_mode))
         {
@@ -4261,6 +5537,39 @@ ostree_repo_load_object_stream (OstreeRepo *self, OstreeObjectType objtype, cons
   return TRUE;
 }
 
+/*
+ * _ostree_repo_loose_path:
+ * @buf: Buffer of size _OSTREE_LOOSE_PATH_MAX
+ *
+ * Compute the loose object path for @checksum in @self's configured
+ * fanout layout.
+ */
+void
+_ostree_repo_loose_path (OstreeRepo *self, char *buf, const char *checksum,
+                         OstreeObjectType objtype)
+{
+  _ostree_loose_path_with_fanout (buf, checksum, objtype, self->mode, self->deep_fanout);
+}
+
+/*
+ * _ostree_repo_loose_path_alternate:
+ *
+ * When deep fanout is enabled, a repository may hold objects written
+ * before the configuration change (or before `ostree migrate-fanout`
+ * completed) at single-level paths.  Fill @buf with the single-level
+ * path so lookup paths can fall back to it; returns %FALSE (leaving
+ * @buf untouched) when there is no alternate layout to try.
+ */
+gboolean
+_ostree_repo_loose_path_alternate (OstreeRepo *self, char *buf, const char *checksum,
+                                   OstreeObjectType objtype)
+{
+  if (!self->deep_fanout)
+    return FALSE;
+  _ostree_loose_path_with_fanout (buf, checksum, objtype, self->mode, FALSE);
+  return TRUE;
+}
+
 /*
  * _ostree_repo_has_loose_object:
  * @loose_path_buf: Buffer of size _OSTREE_LOOSE_PATH_MAX
@@ -4273,13 +5582,26 @@ _ostree_repo_has_loose_object (OstreeRepo *self, const char *checksum, OstreeObj
                                gboolean *out_is_stored, GCancellable *cancellable, GError **error)
 {
   char loose_path_buf[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (loose_path_buf, checksum, objtype, self->mode);
+  _ostree_repo_loose_path (self, loose_path_buf, checksum, objtype);
+
+  /* During a transaction, consult the set of objects already written or found
+   * present, to avoid re-statting them on every candidate object. */
+  if (_ostree_repo_txn_object_is_present (self, loose_path_buf))
+    {
+      *out_is_stored = TRUE;
+      return TRUE;
+    }
 
   gboolean found = FALSE;
+  const int objdir_fd = _ostree_repo_objects_dir_fd_for_objtype (self, objtype);
   /* It's easier to share code if we make this an array */
-  int dfd_searches[] = { -1, self->objects_dir_fd };
+  int dfd_searches[] = { -1, objdir_fd, -1 };
   if (self->commit_stagedir.initialized)
     dfd_searches[0] = self->commit_stagedir.fd;
+  /* Metadata written before metadata-objects-root was set lives under the
+   * primary root */
+  if (objdir_fd != self->objects_dir_fd)
+    dfd_searches[2] = self->objects_dir_fd;
   for (guint i = 0; i < G_N_ELEMENTS (dfd_searches); i++)
     {
       int dfd = dfd_searches[i];
@@ -4300,6 +5622,29 @@ _ostree_repo_has_loose_object (OstreeRepo *self, const char *checksum, OstreeObj
         }
     }
 
+  /* Not in the configured layout; check the alternate fanout depth */
+  char alt_path_buf[_OSTREE_LOOSE_PATH_MAX];
+  if (!found && _ostree_repo_loose_path_alternate (self, alt_path_buf, checksum, objtype))
+    {
+      for (guint i = 1; !found && i < G_N_ELEMENTS (dfd_searches); i++)
+        {
+          int dfd = dfd_searches[i];
+          if (dfd == -1)
+            continue;
+          struct stat stbuf;
+          if (TEMP_FAILURE_RETRY (fstatat (dfd, alt_path_buf, &stbuf, AT_SYMLINK_NOFOLLOW)) < 0)
+            {
+              if (errno != ENOENT)
+                return glnx_throw_errno_prefix (error, "fstatat(%s)", alt_path_buf);
+            }
+          else
+            found = TRUE;
+        }
+    }
+
+  if (found)
+    _ostree_repo_txn_mark_object_present (self, loose_path_buf);
+
   *out_is_stored = found;
   return TRUE;
 }
@@ -4328,7 +5673,19 @@ ostree_repo_has_object (OstreeRepo *self, OstreeObjectType objtype, const char *
                                       error))
     return FALSE;
 
-  /* In the future, here is where we would also look up in metadata pack files */
+  if (!ret_have_object)
+    {
+      g_autoptr (GBytes) packed = NULL;
+      if (!_ostree_repo_pack_lookup (self, checksum, objtype, &packed, cancellable, error))
+        return FALSE;
+      ret_have_object = (packed != NULL);
+    }
+
+  if (!ret_have_object && objtype == OSTREE_OBJECT_TYPE_FILE)
+    {
+      if (!_ostree_repo_chunked_has_object (self, checksum, &ret_have_object, error))
+        return FALSE;
+    }
 
   if (!ret_have_object && self->parent_repo)
     {
@@ -4337,11 +5694,211 @@ ostree_repo_has_object (OstreeRepo *self, OstreeObjectType objtype, const char *
         return FALSE;
     }
 
+  if (!ret_have_object && self->object_pools != NULL)
+    {
+      for (guint i = 0; i < self->object_pools->len && !ret_have_object; i++)
+        {
+          if (!ostree_repo_has_object (self->object_pools->pdata[i], objtype, checksum,
+                                       &ret_have_object, cancellable, error))
+            return FALSE;
+        }
+    }
+
   if (out_have_object)
     *out_have_object = ret_have_object;
   return TRUE;
 }
 
+struct OstreeRepoObjectIndex
+{
+  GHashTable *objects; /* Set<GVariant ObjectName> */
+  OstreeBloom *bloom;  /* Keyed by ASCII checksum */
+};
+
+/*
+ * _ostree_repo_object_index_new:
+ *
+ * Build an in-memory presence index of every loose object visible from
+ * @self, covering the same locations probed by ostree_repo_has_object():
+ * the objects directory, any active commit staging directory, and parent
+ * repositories.  This turns a per-object stat() into a hash lookup, which
+ * matters when e.g. resuming a mostly-complete pull of hundreds of
+ * thousands of objects.
+ *
+ * The index is a point-in-time snapshot; a lookup can answer %FALSE for
+ * an object written after it was built.  Callers must be prepared for
+ * that, typically by deduplicating requests elsewhere.  The index is
+ * immutable once built and hence safe to query from multiple threads.
+ */
+OstreeRepoObjectIndex *
+_ostree_repo_object_index_new (OstreeRepo *self, GCancellable *cancellable, GError **error)
+{
+  static const gchar hexchars[] = "0123456789abcdef";
+
+  g_autoptr (GHashTable) objects = g_hash_table_new_full (
+      ostree_hash_object_name, g_variant_equal, (GDestroyNotify)g_variant_unref, NULL);
+
+  for (OstreeRepo *repo = self; repo != NULL; repo = repo->parent_repo)
+    {
+      if (!list_loose_objects (repo, NULL, objects, NULL, cancellable, error))
+        return NULL;
+
+      /* Configured object pools are part of the visible set too */
+      if (repo->object_pools != NULL)
+        {
+          for (guint i = 0; i < repo->object_pools->len; i++)
+            {
+              if (!list_loose_objects (repo->object_pools->pdata[i], NULL, objects, NULL,
+                                       cancellable, error))
+                return NULL;
+            }
+        }
+    }
+
+  /* Objects staged by a previous interrupted transaction are visible to
+   * _ostree_repo_has_loose_object() too; they use the same fan-out layout.
+   */
+  if (self->commit_stagedir.initialized)
+    {
+      for (guint c = 0; c < 256; c++)
+        {
+          char buf[3];
+          buf[0] = hexchars[c >> 4];
+          buf[1] = hexchars[c & 0xF];
+          buf[2] = '\0';
+          if (!list_loose_objects_at (self, NULL, objects, self->commit_stagedir.fd, buf, NULL,
+                                      cancellable, error))
+            return NULL;
+        }
+    }
+
+  /* ~8 bits per element with k=4 gives a false positive rate around 2%;
+   * a false positive just costs the exact hash table lookup.
+   */
+  gsize n_bytes = MAX ((gsize)g_hash_table_size (objects), (gsize)1024);
+  g_autoptr (OstreeBloom) bloom = ostree_bloom_new (n_bytes, 4, ostree_str_bloom_hash);
+
+  GLNX_HASH_TABLE_FOREACH (objects, GVariant *, object)
+    {
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (object, &checksum, &objtype);
+      ostree_bloom_add_element (bloom, checksum);
+    }
+
+  OstreeRepoObjectIndex *index = g_new0 (OstreeRepoObjectIndex, 1);
+  index->objects = g_steal_pointer (&objects);
+  index->bloom = g_steal_pointer (&bloom);
+  return index;
+}
+
+gboolean
+_ostree_repo_object_index_contains (OstreeRepoObjectIndex *index, OstreeObjectType objtype,
+                                    const char *checksum)
+{
+  /* Definitely-absent answers come straight from the bloom filter */
+  if (!ostree_bloom_maybe_contains (index->bloom, checksum))
+    return FALSE;
+
+  g_autoptr (GVariant) object
+      = g_variant_ref_sink (ostree_object_name_serialize (checksum, objtype));
+  return g_hash_table_contains (index->objects, object);
+}
+
+void
+_ostree_repo_object_index_free (OstreeRepoObjectIndex *index)
+{
+  g_hash_table_unref (index->objects);
+  ostree_bloom_unref (index->bloom);
+  g_free (index);
+}
+
+typedef struct
+{
+  guint64 ino;
+  GVariant *objname; /* unowned */
+} PhysicalOrderEntry;
+
+static int
+physical_order_entry_cmp (const void *ap, const void *bp)
+{
+  const PhysicalOrderEntry *a = ap;
+  const PhysicalOrderEntry *b = bp;
+
+  if (a->ino < b->ino)
+    return -1;
+  if (a->ino > b->ino)
+    return 1;
+  return 0;
+}
+
+/*
+ * _ostree_repo_physical_order_objects:
+ *
+ * Reorder @objects (an array of serialized object-name variants) by the
+ * inode number of each loose object file.  Readers that visit many loose
+ * objects in tree or hash order effectively do random I/O on rotating
+ * media; inode order tracks on-disk allocation closely enough to turn
+ * most of that into forward seeks, without the privileged per-file
+ * FIEMAP ioctls exact extent ordering would need.  Objects we can't
+ * stat (missing, or in a parent repo) sort first and are otherwise left
+ * alone; this is purely advisory.
+ */
+void
+_ostree_repo_physical_order_objects (OstreeRepo *self, GPtrArray *objects)
+{
+  if (objects->len == 0)
+    return;
+
+  g_autofree PhysicalOrderEntry *entries = g_new0 (PhysicalOrderEntry, objects->len);
+  for (guint i = 0; i < objects->len; i++)
+    {
+      GVariant *objname = objects->pdata[i];
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (objname, &checksum, &objtype);
+
+      char loose_path[_OSTREE_LOOSE_PATH_MAX];
+      _ostree_repo_loose_path (self, loose_path, checksum, objtype);
+
+      const int objdir_fd = _ostree_repo_objects_dir_fd_for_objtype (self, objtype);
+      struct stat stbuf;
+      int res = fstatat (objdir_fd, loose_path, &stbuf, AT_SYMLINK_NOFOLLOW);
+      if (res < 0 && _ostree_repo_loose_path_alternate (self, loose_path, checksum, objtype))
+        res = fstatat (objdir_fd, loose_path, &stbuf, AT_SYMLINK_NOFOLLOW);
+      if (res == 0)
+        entries[i].ino = (guint64)stbuf.st_ino;
+      entries[i].objname = objname;
+    }
+
+  qsort (entries, objects->len, sizeof (PhysicalOrderEntry), physical_order_entry_cmp);
+
+  for (guint i = 0; i < objects->len; i++)
+    objects->pdata[i] = entries[i].objname;
+}
+
+/*
+ * _ostree_repo_advise_object_read:
+ *
+ * Tell the kernel we'll read the loose file for this object soon, so it
+ * can queue the readahead asynchronously.  Best-effort; missing objects
+ * and symlinks are silently skipped.
+ */
+void
+_ostree_repo_advise_object_read (OstreeRepo *self, OstreeObjectType objtype, const char *checksum)
+{
+  char loose_path[_OSTREE_LOOSE_PATH_MAX];
+  _ostree_repo_loose_path (self, loose_path, checksum, objtype);
+
+  const int objdir_fd = _ostree_repo_objects_dir_fd_for_objtype (self, objtype);
+  glnx_autofd int fd = openat (objdir_fd, loose_path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0 && _ostree_repo_loose_path_alternate (self, loose_path, checksum, objtype))
+    fd = openat (objdir_fd, loose_path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0)
+    return;
+  (void)posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+}
+
 /**
  * ostree_repo_delete_object:
  * @self: Repo
@@ -4359,21 +5916,63 @@ ostree_repo_delete_object (OstreeRepo *self, OstreeObjectType objtype, const cha
                            GCancellable *cancellable, GError **error)
 {
   char loose_path[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (loose_path, sha256, objtype, self->mode);
+  _ostree_repo_loose_path (self, loose_path, sha256, objtype);
+
+  /* The object may predate a fanout layout change (see deep-fanout) or the
+   * metadata-objects-root option being set; check all candidate locations. */
+  const int objdir_fd = _ostree_repo_objects_dir_fd_for_objtype (self, objtype);
+  int roots[] = { objdir_fd, -1 };
+  if (objdir_fd != self->objects_dir_fd)
+    roots[1] = self->objects_dir_fd;
 
   if (objtype == OSTREE_OBJECT_TYPE_COMMIT)
     {
-      char meta_loose[_OSTREE_LOOSE_PATH_MAX];
+      for (guint i = 0; i < G_N_ELEMENTS (roots); i++)
+        {
+          if (roots[i] == -1)
+            continue;
+          char meta_loose[_OSTREE_LOOSE_PATH_MAX];
 
-      _ostree_loose_path (meta_loose, sha256, OSTREE_OBJECT_TYPE_COMMIT_META, self->mode);
+          _ostree_repo_loose_path (self, meta_loose, sha256, OSTREE_OBJECT_TYPE_COMMIT_META);
 
-      if (!ot_ensure_unlinked_at (self->objects_dir_fd, meta_loose, error))
-        return FALSE;
+          if (!ot_ensure_unlinked_at (roots[i], meta_loose, error))
+            return FALSE;
+
+          if (_ostree_repo_loose_path_alternate (self, meta_loose, sha256,
+                                                 OSTREE_OBJECT_TYPE_COMMIT_META))
+            {
+              if (!ot_ensure_unlinked_at (roots[i], meta_loose, error))
+                return FALSE;
+            }
+        }
     }
 
-  if (!glnx_unlinkat (self->objects_dir_fd, loose_path, 0, error))
-    return glnx_prefix_error (error, "Deleting object %s.%s", sha256,
-                              ostree_object_type_to_string (objtype));
+  gboolean deleted = FALSE;
+  for (guint i = 0; !deleted && i < G_N_ELEMENTS (roots); i++)
+    {
+      if (roots[i] == -1)
+        continue;
+      _ostree_repo_loose_path (self, loose_path, sha256, objtype);
+      if (unlinkat (roots[i], loose_path, 0) == 0)
+        deleted = TRUE;
+      else if (errno != ENOENT)
+        return glnx_throw_errno_prefix (error, "Deleting object %s.%s", sha256,
+                                        ostree_object_type_to_string (objtype));
+      else if (_ostree_repo_loose_path_alternate (self, loose_path, sha256, objtype))
+        {
+          if (unlinkat (roots[i], loose_path, 0) == 0)
+            deleted = TRUE;
+          else if (errno != ENOENT)
+            return glnx_throw_errno_prefix (error, "Deleting object %s.%s", sha256,
+                                            ostree_object_type_to_string (objtype));
+        }
+    }
+  if (!deleted)
+    {
+      errno = ENOENT;
+      return glnx_throw_errno_prefix (error, "Deleting object %s.%s", sha256,
+                                      ostree_object_type_to_string (objtype));
+    }
 
   /* If the repository is configured to use tombstone commits, create one when deleting a commit.
    */
@@ -4541,15 +6140,30 @@ ostree_repo_query_object_storage_size (OstreeRepo *self, OstreeObjectType objtyp
                                        GCancellable *cancellable, GError **error)
 {
   char loose_path[_OSTREE_LOOSE_PATH_MAX];
-  _ostree_loose_path (loose_path, sha256, objtype, self->mode);
+  _ostree_repo_loose_path (self, loose_path, sha256, objtype);
+  const int objdir_fd = _ostree_repo_objects_dir_fd_for_objtype (self, objtype);
   int res;
 
   struct stat stbuf;
-  res = TEMP_FAILURE_RETRY (
-      fstatat (self->objects_dir_fd, loose_path, &stbuf, AT_SYMLINK_NOFOLLOW));
+  res = TEMP_FAILURE_RETRY (fstatat (objdir_fd, loose_path, &stbuf, AT_SYMLINK_NOFOLLOW));
   if (res < 0 && errno == ENOENT && self->commit_stagedir.initialized)
     res = TEMP_FAILURE_RETRY (
         fstatat (self->commit_stagedir.fd, loose_path, &stbuf, AT_SYMLINK_NOFOLLOW));
+  if (res < 0 && errno == ENOENT
+      && _ostree_repo_loose_path_alternate (self, loose_path, sha256, objtype))
+    res = TEMP_FAILURE_RETRY (fstatat (objdir_fd, loose_path, &stbuf, AT_SYMLINK_NOFOLLOW));
+  /* Metadata written before metadata-objects-root was set lives under the
+   * primary root */
+  if (res < 0 && errno == ENOENT && objdir_fd != self->objects_dir_fd)
+    {
+      _ostree_repo_loose_path (self, loose_path, sha256, objtype);
+      res = TEMP_FAILURE_RETRY (
+          fstatat (self->objects_dir_fd, loose_path, &stbuf, AT_SYMLINK_NOFOLLOW));
+      if (res < 0 && errno == ENOENT
+          && _ostree_repo_loose_path_alternate (self, loose_path, sha256, objtype))
+        res = TEMP_FAILURE_RETRY (
+            fstatat (self->objects_dir_fd, loose_path, &stbuf, AT_SYMLINK_NOFOLLOW));
+    }
 
   if (res < 0)
     return glnx_throw_errno_prefix (error, "Querying object %s.%s", sha256,
@@ -5221,6 +6835,34 @@ ostree_repo_sign_delta (OstreeRepo *self, const gchar *from_commit, const gchar
   return FALSE;
 }
 
+#ifndef OSTREE_DISABLE_GPGME
+/* GPG-sign in-memory summary data with each of @key_id, appending to
+ * @existing_metadata (if any), returning the new detached metadata in
+ * @out_metadata.  No file I/O, so callers already holding the summary bytes
+ * don't have to re-read the just-written file.
+ */
+static gboolean
+gpg_sign_summary_bytes (OstreeRepo *self, GBytes *summary_data, GVariant *existing_metadata,
+                        const gchar **key_id, const gchar *homedir, GVariant **out_metadata,
+                        GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GVariant) metadata = existing_metadata ? g_variant_ref (existing_metadata) : NULL;
+
+  for (guint i = 0; key_id[i]; i++)
+    {
+      g_autoptr (GBytes) signature_data = NULL;
+      if (!sign_data (self, summary_data, key_id[i], homedir, &signature_data, cancellable, error))
+        return FALSE;
+
+      g_autoptr (GVariant) old_metadata = g_steal_pointer (&metadata);
+      metadata = _ostree_detached_metadata_append_gpg_sig (old_metadata, signature_data);
+    }
+
+  *out_metadata = g_steal_pointer (&metadata);
+  return TRUE;
+}
+#endif /* OSTREE_DISABLE_GPGME */
+
 static gboolean
 _ostree_repo_add_gpg_signature_summary_at (OstreeRepo *self, int dir_fd, const gchar **key_id,
                                            const gchar *homedir, GCancellable *cancellable,
@@ -5236,25 +6878,20 @@ _ostree_repo_add_gpg_signature_summary_at (OstreeRepo *self, int dir_fd, const g
   /* Note that fd is reused below */
   glnx_close_fd (&fd);
 
-  g_autoptr (GVariant) metadata = NULL;
+  g_autoptr (GVariant) existing_metadata = NULL;
   if (!ot_openat_ignore_enoent (dir_fd, "summary.sig", &fd, error))
     return FALSE;
   if (fd >= 0)
     {
       if (!ot_variant_read_fd (fd, 0, G_VARIANT_TYPE (OSTREE_SUMMARY_SIG_GVARIANT_STRING), FALSE,
-                               &metadata, error))
+                               &existing_metadata, error))
         return FALSE;
     }
 
-  for (guint i = 0; key_id[i]; i++)
-    {
-      g_autoptr (GBytes) signature_data = NULL;
-      if (!sign_data (self, summary_data, key_id[i], homedir, &signature_data, cancellable, error))
-        return FALSE;
-
-      g_autoptr (GVariant) old_metadata = g_steal_pointer (&metadata);
-      metadata = _ostree_detached_metadata_append_gpg_sig (old_metadata, signature_data);
-    }
+  g_autoptr (GVariant) metadata = NULL;
+  if (!gpg_sign_summary_bytes (self, summary_data, existing_metadata, key_id, homedir, &metadata,
+                               cancellable, error))
+    return FALSE;
 
   g_autoptr (GVariant) normalized = g_variant_get_normal_form (metadata);
 
@@ -5460,23 +7097,94 @@ _ostree_repo_gpg_prepare_verifier (OstreeRepo *self, const gchar *remote_name, G
       _ostree_gpg_verifier_add_keyring_file (verifier, extra_keyring);
     }
 
-  if (out_verifier != NULL)
-    *out_verifier = g_steal_pointer (&verifier);
+  if (out_verifier != NULL)
+    *out_verifier = g_steal_pointer (&verifier);
+
+  return TRUE;
+}
+
+static OstreeGpgVerifyResult *
+_ostree_repo_gpg_verify_data_internal (OstreeRepo *self, const gchar *remote_name, GBytes *data,
+                                       GBytes *signatures, GFile *keyringdir, GFile *extra_keyring,
+                                       GCancellable *cancellable, GError **error)
+{
+  g_autoptr (OstreeGpgVerifier) verifier = NULL;
+  if (!_ostree_repo_gpg_prepare_verifier (self, remote_name, keyringdir, extra_keyring, TRUE,
+                                          &verifier, cancellable, error))
+    return NULL;
+
+  /* Importing the keys into a fresh gpgme home directory spawns gpg and
+   * dominates the cost of a single verification; a mirror sync verifies
+   * thousands of commits against the same trust set.  Cache the assembled
+   * home directory per keyring-content digest for the life of the repo
+   * instance (torn down in finalize); on any cache trouble just fall through
+   * to the uncached path.
+   */
+  g_autofree char *keyring_digest = _ostree_gpg_verifier_keyring_digest (verifier, cancellable, NULL);
+  if (keyring_digest != NULL)
+    {
+      g_mutex_lock (&self->cache_lock);
+      g_autofree char *home_dir = g_strdup (
+          self->gpg_home_cache != NULL ? g_hash_table_lookup (self->gpg_home_cache, keyring_digest)
+                                       : NULL);
+      g_mutex_unlock (&self->cache_lock);
+
+      if (home_dir == NULL)
+        {
+          home_dir = _ostree_gpg_verifier_prepare_home_dir (verifier, cancellable, NULL);
+          if (home_dir != NULL)
+            {
+              g_mutex_lock (&self->cache_lock);
+              if (self->gpg_home_cache == NULL)
+                self->gpg_home_cache
+                    = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+              const char *raced
+                  = g_hash_table_lookup (self->gpg_home_cache, keyring_digest);
+              if (raced != NULL)
+                {
+                  /* Another thread assembled the same trust set concurrently;
+                   * use theirs and discard ours. */
+                  g_autofree char *ours = g_steal_pointer (&home_dir);
+                  home_dir = g_strdup (raced);
+                  g_mutex_unlock (&self->cache_lock);
+                  ot_gpgme_kill_agent (ours);
+                  (void)glnx_shutil_rm_rf_at (AT_FDCWD, ours, NULL, NULL);
+                }
+              else
+                {
+                  g_hash_table_replace (self->gpg_home_cache, g_strdup (keyring_digest),
+                                        g_strdup (home_dir));
+                  g_mutex_unlock (&self->cache_lock);
+                }
+            }
+        }
+
+      /* The cached directory outlives the returned result (it's only removed
+       * when the repo is finalized), satisfying the lifetime contract. */
+      if (home_dir != NULL)
+        return _ostree_gpg_verifier_check_signature_with_home_dir (verifier, home_dir, data,
+                                                                   signatures, cancellable, error);
+    }
 
-  return TRUE;
+  return _ostree_gpg_verifier_check_signature (verifier, data, signatures, cancellable, error);
 }
 
-static OstreeGpgVerifyResult *
-_ostree_repo_gpg_verify_data_internal (OstreeRepo *self, const gchar *remote_name, GBytes *data,
-                                       GBytes *signatures, GFile *keyringdir, GFile *extra_keyring,
-                                       GCancellable *cancellable, GError **error)
+/* Compute a digest covering the keyring content that signatures from remote
+ * @remote_name would be checked against; the pull code uses this to key its
+ * persistent verified-commit cache.  The verifier is configured the same way
+ * as in _ostree_repo_gpg_verify_data_internal() so the digest changes
+ * whenever the effective trust set does.
+ */
+char *
+_ostree_repo_gpg_keyring_digest (OstreeRepo *self, const char *remote_name,
+                                 GCancellable *cancellable, GError **error)
 {
   g_autoptr (OstreeGpgVerifier) verifier = NULL;
-  if (!_ostree_repo_gpg_prepare_verifier (self, remote_name, keyringdir, extra_keyring, TRUE,
-                                          &verifier, cancellable, error))
+  if (!_ostree_repo_gpg_prepare_verifier (self, remote_name, NULL, NULL, TRUE, &verifier,
+                                          cancellable, error))
     return NULL;
 
-  return _ostree_gpg_verifier_check_signature (verifier, data, signatures, cancellable, error);
+  return _ostree_gpg_verifier_keyring_digest (verifier, cancellable, error);
 }
 
 OstreeGpgVerifyResult *
@@ -5722,9 +7430,82 @@ ostree_repo_verify_summary (OstreeRepo *self, const char *remote_name, GBytes *s
 #endif /* OSTREE_DISABLE_GPGME */
 }
 
+static int
+strptr_cmp (gconstpointer a, gconstpointer b)
+{
+  return strcmp (*(const char *const *)a, *(const char *const *)b);
+}
+
+#define SUMMARY_ROW_CACHE_FILE "summary-rows"
+
+/* Load the persistent per-ref summary row cache into memory.  Rows are
+ * keyed by ref name and embed the target checksum, so a row is simply
+ * recomputed when its ref has moved since the last regeneration; no
+ * invalidation hook on ref updates is needed.
+ */
+static void
+summary_row_cache_ensure_loaded (OstreeRepo *self)
+{
+  if (self->summary_row_cache != NULL)
+    return;
+
+  self->summary_row_cache
+      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+
+  if (self->cache_dir_fd == -1)
+    return;
+
+  glnx_autofd int fd = -1;
+  if (!glnx_openat_rdonly (self->cache_dir_fd, SUMMARY_ROW_CACHE_FILE, TRUE, &fd, NULL))
+    return;
+
+  /* A corrupt cache just means every row is rebuilt */
+  g_autoptr (GVariant) rows = NULL;
+  if (!ot_variant_read_fd (fd, 0, G_VARIANT_TYPE ("a(s(taya{sv}))"), FALSE, &rows, NULL))
+    return;
+
+  const gsize n = g_variant_n_children (rows);
+  for (gsize i = 0; i < n; i++)
+    {
+      g_autoptr (GVariant) row = g_variant_get_child_value (rows, i);
+      const char *ref;
+      g_variant_get_child (row, 0, "&s", &ref);
+      g_hash_table_replace (self->summary_row_cache, g_strdup (ref), g_steal_pointer (&row));
+    }
+}
+
+/* Best-effort persist of the row cache; like the bare-user metadata
+ * sidecar, failures (e.g. a read-only repository) are ignored. */
+static void
+summary_row_cache_save (OstreeRepo *self)
+{
+  if (!self->summary_row_cache_dirty || self->summary_row_cache == NULL
+      || self->cache_dir_fd == -1)
+    return;
+
+  g_autoptr (GPtrArray) sorted_refs = g_ptr_array_new ();
+  GLNX_HASH_TABLE_FOREACH (self->summary_row_cache, const char *, ref)
+    g_ptr_array_add (sorted_refs, (char *)ref);
+  g_ptr_array_sort (sorted_refs, strptr_cmp);
+
+  g_auto (GVariantBuilder) rows_builder;
+  g_variant_builder_init (&rows_builder, G_VARIANT_TYPE ("a(s(taya{sv}))"));
+  for (guint i = 0; i < sorted_refs->len; i++)
+    g_variant_builder_add_value (
+        &rows_builder, g_hash_table_lookup (self->summary_row_cache, sorted_refs->pdata[i]));
+
+  g_autoptr (GVariant) rows = g_variant_ref_sink (g_variant_builder_end (&rows_builder));
+  (void)glnx_file_replace_contents_at (self->cache_dir_fd, SUMMARY_ROW_CACHE_FILE,
+                                       g_variant_get_data (rows), g_variant_get_size (rows),
+                                       GLNX_FILE_REPLACE_NODATASYNC, NULL, NULL);
+  self->summary_row_cache_dirty = FALSE;
+}
+
 /* Add an entry for a @ref ↦ @checksum mapping to an `a(s(t@ay@a{sv}))`
  * @refs_builder to go into a `summary` file. This includes building the
- * standard additional metadata keys for the ref. */
+ * standard additional metadata keys for the ref.  Unchanged refs are
+ * served from the row cache, so steady-state regeneration only loads
+ * commit objects for refs that actually moved. */
 static gboolean
 summary_add_ref_entry (OstreeRepo *self, const char *ref, const char *checksum,
                        GVariantBuilder *refs_builder, GError **error)
@@ -5742,6 +7523,24 @@ summary_add_ref_entry (OstreeRepo *self, const char *ref, const char *checksum,
   if (remotename != NULL)
     return TRUE;
 
+  summary_row_cache_ensure_loaded (self);
+  {
+    GVariant *cached_row = g_hash_table_lookup (self->summary_row_cache, ref);
+    if (cached_row != NULL)
+      {
+        g_autoptr (GVariant) target = g_variant_get_child_value (cached_row, 1);
+        g_autoptr (GVariant) cached_csum_v = g_variant_get_child_value (target, 1);
+        g_autoptr (GVariant) new_csum_v
+            = g_variant_ref_sink (ostree_checksum_to_bytes_v (checksum));
+
+        if (g_variant_equal (cached_csum_v, new_csum_v) && g_variant_is_normal_form (cached_row))
+          {
+            g_variant_builder_add_value (refs_builder, cached_row);
+            return TRUE;
+          }
+      }
+  }
+
   g_autoptr (GVariant) commit_obj = NULL;
   if (!ostree_repo_load_variant (self, OSTREE_OBJECT_TYPE_COMMIT, checksum, &commit_obj, error))
     return FALSE;
@@ -5761,14 +7560,362 @@ summary_add_ref_entry (OstreeRepo *self, const char *ref, const char *checksum,
   if (g_variant_lookup (orig_metadata, OSTREE_COMMIT_META_KEY_VERSION, "&s", &version))
     g_variant_dict_insert (&commit_metadata_builder, OSTREE_COMMIT_VERSION, "s", version);
 
-  g_variant_builder_add_value (
-      refs_builder, g_variant_new ("(s(t@ay@a{sv}))", ref, (guint64)g_variant_get_size (commit_obj),
-                                   ostree_checksum_to_bytes_v (checksum),
-                                   g_variant_dict_end (&commit_metadata_builder)));
+  g_autoptr (GVariant) row = g_variant_ref_sink (
+      g_variant_new ("(s(t@ay@a{sv}))", ref, (guint64)g_variant_get_size (commit_obj),
+                     ostree_checksum_to_bytes_v (checksum),
+                     g_variant_dict_end (&commit_metadata_builder)));
+  g_variant_builder_add_value (refs_builder, row);
+
+  g_hash_table_replace (self->summary_row_cache, g_strdup (ref), g_steal_pointer (&row));
+  self->summary_row_cache_dirty = TRUE;
+
+  return TRUE;
+}
+
+/* Write the refs from @refs into @n_shards files under summary.d/, keyed
+ * by _ostree_summary_ref_shard_index(), returning the SHA256 digest of
+ * each shard in @out_shard_digests for inclusion in the (signed) summary.
+ * Entries whose target commit is unchanged are copied from the existing
+ * shard file instead of being rebuilt, and shards whose content did not
+ * change are not rewritten, so a single-ref update only touches one
+ * shard.
+ */
+static gboolean
+regenerate_summary_shards (OstreeRepo *self, GHashTable *refs, guint n_shards,
+                           GVariant **out_shard_digests, GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GPtrArray) shard_refs = g_ptr_array_new_with_free_func ((GDestroyNotify)g_ptr_array_unref);
+  for (guint i = 0; i < n_shards; i++)
+    g_ptr_array_add (shard_refs, g_ptr_array_new ());
+
+  GLNX_HASH_TABLE_FOREACH (refs, const char *, ref)
+    g_ptr_array_add (shard_refs->pdata[_ostree_summary_ref_shard_index (ref, n_shards)],
+                     (char *)ref);
+
+  if (!glnx_shutil_mkdir_p_at (self->repo_dir_fd, _OSTREE_SUMMARY_SHARD_DIR,
+                               DEFAULT_DIRECTORY_MODE, cancellable, error))
+    return FALSE;
+
+  /* Digests are computed in one batch after the loop */
+  g_autoptr (GPtrArray) shard_bytes_array
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)g_bytes_unref);
+
+  for (guint i = 0; i < n_shards; i++)
+    {
+      GPtrArray *shard = shard_refs->pdata[i];
+      g_ptr_array_sort (shard, strptr_cmp);
+
+      g_autofree char *shard_path = g_strdup_printf (_OSTREE_SUMMARY_SHARD_DIR "/%u", i);
+
+      /* Load the previous incarnation of this shard, if any; a corrupt
+       * file just means we rebuild every entry.
+       */
+      g_autoptr (GVariant) old_shard = NULL;
+      {
+        glnx_autofd int old_fd = -1;
+        if (!ot_openat_ignore_enoent (self->repo_dir_fd, shard_path, &old_fd, error))
+          return FALSE;
+        if (old_fd != -1)
+          (void)ot_variant_read_fd (old_fd, 0, G_VARIANT_TYPE ("a(s(taya{sv}))"), FALSE,
+                                    &old_shard, NULL);
+      }
+
+      g_autoptr (GVariantBuilder) shard_builder
+          = g_variant_builder_new (G_VARIANT_TYPE ("a(s(taya{sv}))"));
+
+      for (guint j = 0; j < shard->len; j++)
+        {
+          const char *ref = shard->pdata[j];
+          const char *checksum = g_hash_table_lookup (refs, ref);
+
+          /* Reuse the old entry when the ref still points at the same
+           * commit, avoiding a reload of the commit object.
+           */
+          int old_pos;
+          gboolean reused = FALSE;
+          if (old_shard != NULL && ot_variant_bsearch_str (old_shard, ref, &old_pos))
+            {
+              g_autoptr (GVariant) old_entry = g_variant_get_child_value (old_shard, old_pos);
+              g_autoptr (GVariant) old_target = g_variant_get_child_value (old_entry, 1);
+              g_autoptr (GVariant) old_csum_v = g_variant_get_child_value (old_target, 1);
+              g_autoptr (GVariant) new_csum_v
+                  = g_variant_ref_sink (ostree_checksum_to_bytes_v (checksum));
+
+              if (g_variant_equal (old_csum_v, new_csum_v)
+                  && g_variant_is_normal_form (old_entry))
+                {
+                  g_variant_builder_add_value (shard_builder, old_entry);
+                  reused = TRUE;
+                }
+            }
+
+          if (!reused && !summary_add_ref_entry (self, ref, checksum, shard_builder, error))
+            return FALSE;
+        }
+
+      g_autoptr (GVariant) shard_v = g_variant_ref_sink (g_variant_builder_end (shard_builder));
+      g_autoptr (GBytes) shard_bytes = g_variant_get_data_as_bytes (shard_v);
+
+      g_ptr_array_add (shard_bytes_array, g_bytes_ref (shard_bytes));
+
+      g_autoptr (GBytes) old_bytes
+          = old_shard != NULL ? g_variant_get_data_as_bytes (old_shard) : NULL;
+      if (old_bytes == NULL || !g_bytes_equal (old_bytes, shard_bytes))
+        {
+          if (!_ostree_repo_file_replace_contents (self, self->repo_dir_fd, shard_path,
+                                                   g_variant_get_data (shard_v),
+                                                   g_variant_get_size (shard_v), cancellable,
+                                                   error))
+            return FALSE;
+        }
+    }
+
+  /* Remove shards left over from a previous, larger shard count */
+  {
+    g_auto (GLnxDirFdIterator) dfd_iter = {
+      0,
+    };
+    gboolean exists;
+    if (!ot_dfd_iter_init_allow_noent (self->repo_dir_fd, _OSTREE_SUMMARY_SHARD_DIR, &dfd_iter,
+                                       &exists, error))
+      return FALSE;
+    while (exists)
+      {
+        struct dirent *dent;
+        if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, cancellable, error))
+          return FALSE;
+        if (dent == NULL)
+          break;
+
+        char *endptr = NULL;
+        guint64 idx = g_ascii_strtoull (dent->d_name, &endptr, 10);
+        if (endptr == dent->d_name || *endptr != '\0' || idx >= n_shards)
+          {
+            if (!glnx_unlinkat (dfd_iter.fd, dent->d_name, 0, error))
+              return FALSE;
+          }
+      }
+  }
+
+  /* Digest all shards in one batch; ot_checksum_many() fans the work out
+   * over the processors when there are enough shards to matter.
+   */
+  g_assert_cmpuint (shard_bytes_array->len, ==, n_shards);
+  g_autofree guint8 *digests = g_malloc ((gsize)n_shards * OSTREE_SHA256_DIGEST_LEN);
+  ot_checksum_many ((GBytes **)shard_bytes_array->pdata, n_shards, digests);
+
+  g_autoptr (GVariantBuilder) digests_builder = g_variant_builder_new (G_VARIANT_TYPE ("aay"));
+  for (guint i = 0; i < n_shards; i++)
+    g_variant_builder_add_value (
+        digests_builder, ot_gvariant_new_bytearray (digests + (gsize)i * OSTREE_SHA256_DIGEST_LEN,
+                                                    OSTREE_SHA256_DIGEST_LEN));
+
+  *out_shard_digests = g_variant_ref_sink (g_variant_builder_end (digests_builder));
+  return TRUE;
+}
+
+/* How many delta files to retain under summary.delta/.  Each regeneration
+ * adds exactly one (from the summary it replaced), so this is also how many
+ * versions behind a client can be and still reach the current summary by
+ * walking the digest chain; anyone further behind falls back to a full
+ * fetch.
+ */
+#define SUMMARY_DELTA_MAX_RETAINED 5
+
+struct summary_bsdiff_opaque_s
+{
+  GOutputStream *out;
+  GCancellable *cancellable;
+  GError **error;
+};
+
+static int
+summary_bsdiff_write (struct bsdiff_stream *stream, const void *buffer, int size)
+{
+  struct summary_bsdiff_opaque_s *op = stream->opaque;
+  if (!g_output_stream_write (op->out, buffer, size, op->cancellable, op->error))
+    return -1;
+
+  return 0;
+}
+
+typedef struct
+{
+  char *name;
+  guint64 mtime;
+} SummaryDeltaFile;
+
+static void
+summary_delta_file_free (SummaryDeltaFile *ent)
+{
+  g_free (ent->name);
+  g_free (ent);
+}
+
+/* Newest first */
+static int
+summary_delta_file_compare (gconstpointer ap, gconstpointer bp)
+{
+  const SummaryDeltaFile *a = *((SummaryDeltaFile **)ap);
+  const SummaryDeltaFile *b = *((SummaryDeltaFile **)bp);
+
+  if (a->mtime != b->mtime)
+    return a->mtime > b->mtime ? -1 : 1;
+  return strcmp (a->name, b->name);
+}
+
+/* Publish a bsdiff from @old_summary (the summary we just replaced) to
+ * @new_summary under summary.delta/<sha256-of-old>, and prune deltas from
+ * older versions beyond SUMMARY_DELTA_MAX_RETAINED.  Clients that still
+ * hold an old summary follow these files digest by digest instead of
+ * re-downloading the whole summary; see
+ * ostree_repo_remote_fetch_summary_with_options().
+ */
+static gboolean
+write_summary_delta (OstreeRepo *self, GBytes *old_summary, GBytes *new_summary,
+                     GCancellable *cancellable, GError **error)
+{
+  if (g_bytes_equal (old_summary, new_summary))
+    return TRUE;
+
+  gsize old_len;
+  const guint8 *old_buf = g_bytes_get_data (old_summary, &old_len);
+  gsize new_len;
+  const guint8 *new_buf = g_bytes_get_data (new_summary, &new_len);
+
+  g_autofree char *from_digest = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, old_summary);
+  g_autofree char *to_digest = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, new_summary);
+
+  g_autoptr (GOutputStream) out = g_memory_output_stream_new_resizable ();
+  struct bsdiff_stream stream;
+  struct summary_bsdiff_opaque_s op;
+  stream.malloc = malloc;
+  stream.free = free;
+  stream.write = summary_bsdiff_write;
+  op.out = out;
+  op.cancellable = cancellable;
+  op.error = error;
+  stream.opaque = &op;
+  if (bsdiff (old_buf, old_len, new_buf, new_len, &stream) < 0)
+    return glnx_throw (error, "bsdiff generation failed");
+
+  if (!g_output_stream_close (out, cancellable, error))
+    return FALSE;
+
+  g_autoptr (GBytes) payload
+      = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (out));
+
+  /* If the summaries share little content the diff can approach (or exceed)
+   * the size of the new summary; publishing it would just cost clients a
+   * round trip before the full fetch they'd need anyway.
+   */
+  if (g_bytes_get_size (payload) >= new_len)
+    return TRUE;
+
+  g_autoptr (GVariant) delta = g_variant_ref_sink (
+      g_variant_new ("(st@ay)", to_digest, GUINT64_TO_BE ((guint64)new_len),
+                     ot_gvariant_new_ay_bytes (payload)));
+
+  if (!glnx_shutil_mkdir_p_at (self->repo_dir_fd, _OSTREE_SUMMARY_DELTA_DIR, 0775, cancellable,
+                               error))
+    return FALSE;
+
+  g_autofree char *delta_path = g_strdup_printf (_OSTREE_SUMMARY_DELTA_DIR "/%s", from_digest);
+  if (!_ostree_repo_file_replace_contents (self, self->repo_dir_fd, delta_path,
+                                           g_variant_get_data (delta), g_variant_get_size (delta),
+                                           cancellable, error))
+    return FALSE;
+
+  /* Prune deltas for versions older than we retain. */
+  g_autoptr (GPtrArray) entries
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)summary_delta_file_free);
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (self->repo_dir_fd, _OSTREE_SUMMARY_DELTA_DIR, FALSE, &dfd_iter,
+                                    error))
+    return FALSE;
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+      if (dent->d_type != DT_REG)
+        continue;
+
+      struct stat stbuf;
+      if (!glnx_fstatat (dfd_iter.fd, dent->d_name, &stbuf, 0, error))
+        return FALSE;
+
+      SummaryDeltaFile *ent = g_new0 (SummaryDeltaFile, 1);
+      ent->name = g_strdup (dent->d_name);
+      ent->mtime = (guint64)stbuf.st_mtim.tv_sec * G_USEC_PER_SEC
+                   + (guint64)stbuf.st_mtim.tv_nsec / 1000;
+      g_ptr_array_add (entries, ent);
+    }
+  g_ptr_array_sort (entries, summary_delta_file_compare);
+  for (guint i = SUMMARY_DELTA_MAX_RETAINED; i < entries->len; i++)
+    {
+      SummaryDeltaFile *ent = entries->pdata[i];
+      if (!glnx_unlinkat (dfd_iter.fd, ent->name, 0, error))
+        return FALSE;
+    }
 
   return TRUE;
 }
 
+/* State for computing summary signatures on a worker thread, overlapped
+ * with writing the summary file itself.  All fields are owned by the caller
+ * and immutable while the thread runs; @metadata and @error carry the
+ * result back after g_thread_join().
+ */
+typedef struct
+{
+  OstreeRepo *repo;
+  GBytes *summary_bytes;
+  const gchar *const *gpg_key_ids;
+  const gchar *gpg_homedir;
+  OstreeSign *sign;
+  GVariant *sign_keys;
+  GCancellable *cancellable;
+  GVariant *metadata;
+  GError *error;
+} SignSummaryThreadData;
+
+static gpointer
+sign_summary_in_thread (gpointer user_data)
+{
+  SignSummaryThreadData *data = user_data;
+  g_autoptr (GVariant) metadata = NULL;
+
+  if (data->gpg_key_ids != NULL)
+    {
+#ifndef OSTREE_DISABLE_GPGME
+      if (!gpg_sign_summary_bytes (data->repo, data->summary_bytes, NULL,
+                                   (const gchar **)data->gpg_key_ids, data->gpg_homedir, &metadata,
+                                   data->cancellable, &data->error))
+        return NULL;
+#else
+      glnx_throw (&data->error, "GPG feature is disabled in a build time");
+      return NULL;
+#endif /* OSTREE_DISABLE_GPGME */
+    }
+
+  if (data->sign_keys != NULL)
+    {
+      g_autoptr (GVariant) old_metadata = g_steal_pointer (&metadata);
+      if (!_ostree_sign_summary_bytes (data->sign, data->summary_bytes, old_metadata,
+                                       data->sign_keys, &metadata, data->cancellable,
+                                       &data->error))
+        return NULL;
+    }
+
+  data->metadata = g_steal_pointer (&metadata);
+  return NULL;
+}
+
 static gboolean
 regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *additional_metadata,
                      GVariant *options, GCancellable *cancellable, GError **error)
@@ -5866,6 +8013,9 @@ regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *ad
   g_variant_dict_init (&additional_metadata_builder, additional_metadata);
   g_autoptr (GVariantBuilder) refs_builder
       = g_variant_builder_new (G_VARIANT_TYPE ("a(s(taya{sv}))"));
+  /* Every ref name going into the summary (or its shards), for the ref
+   * bloom filter below. */
+  g_autoptr (GPtrArray) all_ref_names = g_ptr_array_new_with_free_func (g_free);
 
   {
     if (main_collection_id == NULL)
@@ -5874,16 +8024,48 @@ regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *ad
         if (!ostree_repo_list_refs (self, NULL, &refs, cancellable, error))
           return FALSE;
 
-        g_autoptr (GList) ordered_keys = g_hash_table_get_keys (refs);
-        ordered_keys = g_list_sort (ordered_keys, (GCompareFunc)strcmp);
+        /* With `core/summary-shards` set, the ref list is split across
+         * per-shard files and the summary only carries their digests;
+         * the summary's own ref list is left empty.  Note only clients
+         * aware of OSTREE_SUMMARY_REF_SHARDS can pull by ref from such
+         * a repository.
+         */
+        guint64 n_shards = 0;
+        {
+          g_autofree char *shards_str = NULL;
+          if (!ot_keyfile_get_value_with_default (self->config, "core", "summary-shards", "0",
+                                                  &shards_str, error))
+            return FALSE;
+          n_shards = g_ascii_strtoull (shards_str, NULL, 10);
+        }
 
-        for (GList *iter = ordered_keys; iter; iter = iter->next)
+        if (n_shards > 1)
           {
-            const char *ref = iter->data;
-            const char *commit = g_hash_table_lookup (refs, ref);
-
-            if (!summary_add_ref_entry (self, ref, commit, refs_builder, error))
+            g_autoptr (GVariant) shard_digests = NULL;
+            if (!regenerate_summary_shards (self, refs, n_shards, &shard_digests, cancellable,
+                                            error))
               return FALSE;
+            g_variant_dict_insert_value (&additional_metadata_builder, OSTREE_SUMMARY_REF_SHARDS,
+                                         shard_digests);
+
+            GLNX_HASH_TABLE_FOREACH (refs, const char *, ref)
+              g_ptr_array_add (all_ref_names, g_strdup (ref));
+          }
+        else
+          {
+            g_autoptr (GList) ordered_keys = g_hash_table_get_keys (refs);
+            ordered_keys = g_list_sort (ordered_keys, (GCompareFunc)strcmp);
+
+            for (GList *iter = ordered_keys; iter; iter = iter->next)
+              {
+                const char *ref = iter->data;
+                const char *commit = g_hash_table_lookup (refs, ref);
+
+                if (!summary_add_ref_entry (self, ref, commit, refs_builder, error))
+                  return FALSE;
+
+                g_ptr_array_add (all_ref_names, g_strdup (ref));
+              }
           }
       }
   }
@@ -6017,6 +8199,8 @@ regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *ad
             if (!summary_add_ref_entry (self, ref, commit, builder, error))
               return FALSE;
 
+            g_ptr_array_add (all_ref_names, g_strdup (ref));
+
             if (!is_main_collection_id)
               collection_map_size++;
           }
@@ -6036,6 +8220,24 @@ regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *ad
                                    g_variant_builder_end (collection_refs_builder));
   }
 
+  if (all_ref_names->len > 0)
+    {
+      /* ~8 bits per element with k=4 gives a false positive rate around 2%;
+       * a false positive just costs the ref map search it would have done
+       * anyway.  See OSTREE_SUMMARY_REF_BLOOM for the encoding.
+       */
+      gsize n_bytes = MAX ((gsize)all_ref_names->len, (gsize)32);
+      g_autoptr (OstreeBloom) bloom = ostree_bloom_new (n_bytes, 4, ostree_str_bloom_hash);
+
+      for (guint i = 0; i < all_ref_names->len; i++)
+        ostree_bloom_add_element (bloom, all_ref_names->pdata[i]);
+
+      g_autoptr (GBytes) sealed = ostree_bloom_seal (bloom);
+      g_variant_dict_insert_value (
+          &additional_metadata_builder, OSTREE_SUMMARY_REF_BLOOM,
+          g_variant_new ("(yy@ay)", (guchar)4, (guchar)1, ot_gvariant_new_ay_bytes (sealed)));
+    }
+
   g_autoptr (GVariant) summary = NULL;
   {
     g_autoptr (GVariantBuilder) summary_builder
@@ -6051,6 +8253,24 @@ regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *ad
   if (!ostree_repo_static_delta_reindex (self, 0, NULL, cancellable, error))
     return FALSE;
 
+  /* Load the currently published summary now, before the rename below
+   * replaces it; once the new one is in place we publish a binary diff from
+   * it so that clients holding the old version don't have to re-download
+   * the whole file.
+   */
+  g_autoptr (GBytes) old_summary_bytes = NULL;
+  {
+    glnx_autofd int old_summary_fd = -1;
+    if (!ot_openat_ignore_enoent (self->repo_dir_fd, "summary", &old_summary_fd, error))
+      return FALSE;
+    if (old_summary_fd != -1)
+      {
+        old_summary_bytes = ot_fd_readall_or_mmap (old_summary_fd, 0, error);
+        if (old_summary_bytes == NULL)
+          return FALSE;
+      }
+  }
+
   /* Create the summary and signature in a temporary directory so that
    * the summary isn't published without a matching signature.
    */
@@ -6061,19 +8281,56 @@ regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *ad
     return FALSE;
   g_debug ("Using summary tmpdir %s", summary_tmpdir.path);
 
-  if (!_ostree_repo_file_replace_contents (self, summary_tmpdir.fd, "summary",
-                                           g_variant_get_data (summary),
-                                           g_variant_get_size (summary), cancellable, error))
-    return FALSE;
+  /* Compute the signatures over the in-memory summary on a worker thread
+   * while this thread writes (and syncs) the summary file, rather than
+   * serializing signing after the write and re-reading the file.
+   */
+  GThread *sign_thread = NULL;
+  SignSummaryThreadData sign_data_thread = {
+    0,
+  };
+  if (gpg_key_ids != NULL || sign_keys != NULL)
+    {
+      sign_data_thread.repo = self;
+      sign_data_thread.summary_bytes = g_variant_get_data_as_bytes (summary);
+      sign_data_thread.gpg_key_ids = (const gchar *const *)gpg_key_ids;
+      sign_data_thread.gpg_homedir = gpg_homedir;
+      sign_data_thread.sign = sign;
+      sign_data_thread.sign_keys = sign_keys;
+      sign_data_thread.cancellable = cancellable;
+      sign_thread = g_thread_new ("summary-sign", sign_summary_in_thread, &sign_data_thread);
+    }
 
-  if (gpg_key_ids != NULL
-      && !_ostree_repo_add_gpg_signature_summary_at (
-          self, summary_tmpdir.fd, (const char **)gpg_key_ids, gpg_homedir, cancellable, error))
-    return FALSE;
+  gboolean summary_written = _ostree_repo_file_replace_contents (
+      self, summary_tmpdir.fd, "summary", g_variant_get_data (summary),
+      g_variant_get_size (summary), cancellable, error);
 
-  if (sign_keys != NULL
-      && !_ostree_sign_summary_at (sign, self, summary_tmpdir.fd, sign_keys, cancellable, error))
-    return FALSE;
+  if (sign_thread != NULL)
+    {
+      g_thread_join (sign_thread);
+      g_bytes_unref (sign_data_thread.summary_bytes);
+    }
+  g_autoptr (GVariant) sig_metadata = sign_data_thread.metadata;
+
+  if (!summary_written)
+    {
+      g_clear_error (&sign_data_thread.error);
+      return FALSE;
+    }
+  if (sign_data_thread.error != NULL)
+    {
+      g_propagate_error (error, g_steal_pointer (&sign_data_thread.error));
+      return FALSE;
+    }
+
+  if (sig_metadata != NULL)
+    {
+      g_autoptr (GVariant) normalized = g_variant_get_normal_form (sig_metadata);
+      if (!_ostree_repo_file_replace_contents (self, summary_tmpdir.fd, "summary.sig",
+                                               g_variant_get_data (normalized),
+                                               g_variant_get_size (normalized), cancellable, error))
+        return FALSE;
+    }
 
   /* Rename them into place */
   if (!glnx_renameat (summary_tmpdir.fd, "summary", self->repo_dir_fd, "summary", error))
@@ -6100,6 +8357,18 @@ regenerate_metadata (OstreeRepo *self, gboolean do_metadata_commit, GVariant *ad
         return glnx_prefix_error (error, "Unable to delete summary signature file: ");
     }
 
+  /* Only once the new summary is live; a delta targeting an unpublished
+   * summary would send clients to a version that doesn't verify.
+   */
+  if (old_summary_bytes != NULL)
+    {
+      g_autoptr (GBytes) new_summary_bytes = g_variant_get_data_as_bytes (summary);
+      if (!write_summary_delta (self, old_summary_bytes, new_summary_bytes, cancellable, error))
+        return glnx_prefix_error (error, "Writing summary delta: ");
+    }
+
+  summary_row_cache_save (self);
+
   return TRUE;
 }
 
@@ -6361,34 +8630,6 @@ _ostree_repo_allocate_tmpdir (int tmpdir_dfd, const char *tmpdir_prefix, GLnxTmp
   return TRUE;
 }
 
-/* See ostree-repo-private.h for more information about this */
-void
-_ostree_repo_memory_cache_ref_init (OstreeRepoMemoryCacheRef *state, OstreeRepo *repo)
-{
-  state->repo = g_object_ref (repo);
-  GMutex *lock = &repo->cache_lock;
-  g_mutex_lock (lock);
-  repo->dirmeta_cache_refcount++;
-  if (repo->dirmeta_cache == NULL)
-    repo->dirmeta_cache
-        = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
-  g_mutex_unlock (lock);
-}
-
-/* See ostree-repo-private.h for more information about this */
-void
-_ostree_repo_memory_cache_ref_destroy (OstreeRepoMemoryCacheRef *state)
-{
-  OstreeRepo *repo = state->repo;
-  GMutex *lock = &repo->cache_lock;
-  g_mutex_lock (lock);
-  repo->dirmeta_cache_refcount--;
-  if (repo->dirmeta_cache_refcount == 0)
-    g_clear_pointer (&repo->dirmeta_cache, g_hash_table_unref);
-  g_mutex_unlock (lock);
-  g_object_unref (repo);
-}
-
 /**
  * ostree_repo_get_collection_id:
  * @self: an #OstreeRepo
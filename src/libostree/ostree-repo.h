@@ -559,6 +559,10 @@ void ostree_repo_commit_modifier_set_xattr_callback (OstreeRepoCommitModifier *m
                                                      OstreeRepoCommitModifierXattrCallback callback,
                                                      GDestroyNotify destroy, gpointer user_data);
 
+_OSTREE_PUBLIC
+void ostree_repo_commit_modifier_add_skip_pattern (OstreeRepoCommitModifier *modifier,
+                                                   const char *pattern);
+
 _OSTREE_PUBLIC
 void ostree_repo_commit_modifier_set_sepolicy (OstreeRepoCommitModifier *modifier,
                                                OstreeSePolicy *sepolicy);
@@ -590,6 +594,13 @@ gboolean ostree_repo_write_dfd_to_mtree (OstreeRepo *self, int dfd, const char *
                                          OstreeRepoCommitModifier *modifier,
                                          GCancellable *cancellable, GError **error);
 
+_OSTREE_PUBLIC
+gboolean ostree_repo_write_dfd_changes_to_mtree (OstreeRepo *self, int dfd, const char *path,
+                                                 const char *const *changed_paths,
+                                                 OstreeMutableTree *mtree,
+                                                 OstreeRepoCommitModifier *modifier,
+                                                 GCancellable *cancellable, GError **error);
+
 _OSTREE_PUBLIC
 gboolean ostree_repo_write_archive_to_mtree (OstreeRepo *self, GFile *archive,
                                              OstreeMutableTree *mtree,
@@ -673,7 +684,12 @@ typedef struct
   /* 4 byte hole on 64 bit arches */
   guint64 timestamp_secs;
 
-  guint unused_uint[8];
+  /* Number of threads prefetching file content ahead of the (single)
+   * archive writer; 0 or 1 disables the readahead pipeline.  Since: 2023.6
+   */
+  guint n_reader_threads;
+
+  guint unused_uint[7];
 
   char *path_prefix;
 
@@ -717,6 +733,16 @@ gboolean ostree_repo_write_commit_detached_metadata (OstreeRepo *self, const cha
                                                      GVariant *metadata, GCancellable *cancellable,
                                                      GError **error);
 
+_OSTREE_PUBLIC
+gboolean ostree_repo_find_commits_with_metadata (OstreeRepo *self, const char *key,
+                                                 const char *value, char ***out_commits,
+                                                 GCancellable *cancellable, GError **error);
+
+_OSTREE_PUBLIC
+gboolean ostree_repo_list_refs_containing (OstreeRepo *self, const char *checksum,
+                                           char ***out_refs, GCancellable *cancellable,
+                                           GError **error);
+
 /**
  * OstreeRepoCheckoutMode:
  * @OSTREE_REPO_CHECKOUT_MODE_NONE: No special options
@@ -804,15 +830,19 @@ typedef struct
   gboolean bareuseronly_dirs;    /* Since: 2017.7 */
   gboolean force_copy_zerosized; /* Since: 2018.9 */
   gboolean process_passthrough_whiteouts;
-  gboolean unused_bools[3];
+  gboolean enable_reflink; /* Since: 2023.6; try FICLONE before copying file content */
+  gboolean unused_bools[2];
   /* 3 byte hole on 64 bit */
 
   const char *subpath;
 
   OstreeRepoDevInoCache *devino_to_csum_cache;
 
-  int unused_ints[6];
-  gpointer unused_ptrs[3];
+  int checkout_threads; /* Since: 2023.6; number of worker threads, 0 or 1 is serial */
+  int unused_ints[5];
+  OstreeAsyncProgress *progress; /* Since: 2023.6; receives bytes-total/bytes-written/files-written
+                                  */
+  gpointer unused_ptrs[2];
   OstreeRepoCheckoutFilter filter; /* Since: 2018.2 */
   gpointer filter_user_data;       /* Since: 2018.2 */
   OstreeSePolicy *sepolicy;        /* Since: 2017.6 */
@@ -837,6 +867,15 @@ gboolean ostree_repo_checkout_at (OstreeRepo *self, OstreeRepoCheckoutAtOptions
                                   int destination_dfd, const char *destination_path,
                                   const char *commit, GCancellable *cancellable, GError **error);
 
+_OSTREE_PUBLIC
+void ostree_repo_checkout_at_async (OstreeRepo *self, OstreeRepoCheckoutAtOptions *options,
+                                    int destination_dfd, const char *destination_path,
+                                    const char *commit, GCancellable *cancellable,
+                                    GAsyncReadyCallback callback, gpointer user_data);
+
+_OSTREE_PUBLIC
+gboolean ostree_repo_checkout_at_finish (OstreeRepo *self, GAsyncResult *result, GError **error);
+
 _OSTREE_PUBLIC
 gboolean ostree_repo_checkout_gc (OstreeRepo *self, GCancellable *cancellable, GError **error);
 
@@ -920,11 +959,19 @@ typedef enum
  * @OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE: No special options for traverse
  * @OSTREE_REPO_COMMIT_TRAVERSE_FLAG_COMMIT_ONLY: Traverse and retrieve only commit objects.
  * (Since: 2022.2)
+ * @OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NO_CONTENT: Traverse and retrieve only metadata
+ * objects (commits, dirtrees and dirmetas), skipping content objects.  (Since: 2023.6)
+ * @OSTREE_REPO_COMMIT_TRAVERSE_FLAG_TOLERATE_MISSING: Treat a missing metadata object
+ * as the end of its subtree rather than an error, even for commits not marked
+ * partial; useful when traversing a repository mirrored from a partial source.
+ * (Since: 2023.6)
  */
 typedef enum
 {
   OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NONE = (1 << 0),
   OSTREE_REPO_COMMIT_TRAVERSE_FLAG_COMMIT_ONLY = (1 << 1),
+  OSTREE_REPO_COMMIT_TRAVERSE_FLAG_NO_CONTENT = (1 << 2),
+  OSTREE_REPO_COMMIT_TRAVERSE_FLAG_TOLERATE_MISSING = (1 << 3),
 } OstreeRepoCommitTraverseFlags;
 
 _OSTREE_PUBLIC
@@ -982,6 +1029,38 @@ gboolean ostree_repo_traverse_commit_with_flags (OstreeRepo *repo,
                                                  GHashTable *inout_parents,
                                                  GCancellable *cancellable, GError **error);
 
+/**
+ * OstreeRepoTraverseObjectCallback:
+ * @repo: Repo
+ * @checksum: ASCII SHA256 checksum of the object
+ * @objtype: Object type
+ * @user_data: User data
+ * @error: Error
+ *
+ * Invoked for each object discovered during a streaming traversal; see
+ * ostree_repo_traverse_commit_with_callback().
+ *
+ * Returns: %TRUE to continue the traversal, %FALSE with @error set to abort it
+ *
+ * Since: 2023.6
+ */
+typedef gboolean (*OstreeRepoTraverseObjectCallback) (OstreeRepo *repo, const char *checksum,
+                                                      OstreeObjectType objtype, gpointer user_data,
+                                                      GError **error);
+
+_OSTREE_PUBLIC
+gboolean ostree_repo_traverse_commit_with_callback (OstreeRepo *repo,
+                                                    OstreeRepoCommitTraverseFlags flags,
+                                                    const char *commit_checksum, int maxdepth,
+                                                    OstreeRepoTraverseObjectCallback callback,
+                                                    gpointer user_data, GCancellable *cancellable,
+                                                    GError **error);
+
+_OSTREE_PUBLIC
+gboolean ostree_repo_traverse_commit_content_size (OstreeRepo *repo, const char *commit_checksum,
+                                                   guint64 *out_size, GCancellable *cancellable,
+                                                   GError **error);
+
 struct _OstreeRepoCommitTraverseIter
 {
   gboolean initialized;
@@ -1042,6 +1121,15 @@ void ostree_repo_commit_traverse_iter_cleanup (void *p);
  * @OSTREE_REPO_PRUNE_FLAGS_REFS_ONLY: Do not traverse individual commit objects, only follow refs
  * for reachability calculations
  * @OSTREE_REPO_PRUNE_FLAGS_COMMIT_ONLY: Only traverse commit objects.  (Since 2022.2)
+ * @OSTREE_REPO_PRUNE_FLAGS_PARALLEL_TRAVERSAL: Compute the reachable set using multiple
+ * worker threads.  (Since 2023.6)
+ * @OSTREE_REPO_PRUNE_FLAGS_INDEXED_TRAVERSAL: Cache the reachable set of each commit in a
+ * persistent index, so repeated prunes only traverse new commits.  Takes precedence over
+ * %OSTREE_REPO_PRUNE_FLAGS_PARALLEL_TRAVERSAL.  (Since 2023.6)
+ * @OSTREE_REPO_PRUNE_FLAGS_REFCOUNT: Determine reachability from a maintained per-object
+ * reference count ledger instead of traversing; once enabled, commits keep the ledger
+ * updated and only commits the ledger has not yet seen are traversed.  Takes precedence
+ * over the traversal flags.  (Since 2023.6)
  */
 typedef enum
 {
@@ -1049,6 +1137,9 @@ typedef enum
   OSTREE_REPO_PRUNE_FLAGS_NO_PRUNE = (1 << 0),
   OSTREE_REPO_PRUNE_FLAGS_REFS_ONLY = (1 << 1),
   OSTREE_REPO_PRUNE_FLAGS_COMMIT_ONLY = (1 << 2),
+  OSTREE_REPO_PRUNE_FLAGS_PARALLEL_TRAVERSAL = (1 << 3),
+  OSTREE_REPO_PRUNE_FLAGS_INDEXED_TRAVERSAL = (1 << 4),
+  OSTREE_REPO_PRUNE_FLAGS_REFCOUNT = (1 << 5),
 } OstreeRepoPruneFlags;
 
 _OSTREE_PUBLIC
@@ -28,17 +28,22 @@
 
 #define ROLLSUM_BLOB_MAX (8192 * 4)
 
-static GHashTable *
-rollsum_chunks_crc32 (GBytes *bytes)
+/* Compute the bupsplit chunk map of @bytes as an `a(utt)` variant of
+ * (crc32, start, length) in file order.  The map is a pure function of the
+ * content, which makes it safe to persist keyed by object checksum; see
+ * the rollsum cache in ostree-repo-static-delta-compilation.c.
+ */
+GVariant *
+_ostree_rollsum_compute_chunks (GBytes *bytes)
 {
   gsize start = 0;
   gboolean rollsum_end = FALSE;
-  GHashTable *ret_rollsums = NULL;
   const guint8 *buf;
   gsize buflen;
   gsize remaining;
+  GVariantBuilder builder;
 
-  ret_rollsums = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_ptr_array_unref);
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(utt)"));
 
   buf = g_bytes_get_data (bytes, &buflen);
 
@@ -64,25 +69,40 @@ rollsum_chunks_crc32 (GBytes *bytes)
       /* Use zlib's crc32 */
       {
         guint32 crc = crc32 (0L, NULL, 0);
-        GVariant *val;
-        GPtrArray *matches;
-
         crc = crc32 (crc, buf, offset);
-
-        val = g_variant_ref_sink (g_variant_new ("(utt)", crc, (guint64)start, (guint64)offset));
-        matches = g_hash_table_lookup (ret_rollsums, GUINT_TO_POINTER (crc));
-        if (!matches)
-          {
-            matches = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
-            g_hash_table_insert (ret_rollsums, GUINT_TO_POINTER (crc), matches);
-          }
-        g_ptr_array_add (matches, val);
+        g_variant_builder_add (&builder, "(utt)", crc, (guint64)start, (guint64)offset);
       }
 
       start += offset;
       remaining -= offset;
     }
 
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/* Index a chunk map by crc32, as the matching loop wants it. */
+static GHashTable *
+rollsum_chunks_crc32 (GVariant *chunks)
+{
+  GHashTable *ret_rollsums
+      = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_ptr_array_unref);
+  GVariantIter viter;
+  guint32 crc;
+  guint64 start, offset;
+
+  g_variant_iter_init (&viter, chunks);
+  while (g_variant_iter_next (&viter, "(utt)", &crc, &start, &offset))
+    {
+      GVariant *val = g_variant_ref_sink (g_variant_new ("(utt)", crc, start, offset));
+      GPtrArray *matches = g_hash_table_lookup (ret_rollsums, GUINT_TO_POINTER (crc));
+      if (!matches)
+        {
+          matches = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+          g_hash_table_insert (ret_rollsums, GUINT_TO_POINTER (crc), matches);
+        }
+      g_ptr_array_add (matches, val);
+    }
+
   return ret_rollsums;
 }
 
@@ -105,12 +125,20 @@ compare_matches (const void *app, const void *bpp)
   return 1;
 }
 
+/* Like _ostree_compute_rollsum_matches(), but takes precomputed chunk maps
+ * for either side.  @from_chunks/@to_chunks may be %NULL, in which case the
+ * map is computed here; passing a cached map skips the bupsplit+crc32 scan
+ * of that object entirely.
+ */
 OstreeRollsumMatches *
-_ostree_compute_rollsum_matches (GBytes *from, GBytes *to)
+_ostree_compute_rollsum_matches_with_chunks (GBytes *from, GVariant *from_chunks, GBytes *to,
+                                             GVariant *to_chunks)
 {
   OstreeRollsumMatches *ret_rollsum = NULL;
   g_autoptr (GHashTable) from_rollsum = NULL;
   g_autoptr (GHashTable) to_rollsum = NULL;
+  g_autoptr (GVariant) local_from_chunks = NULL;
+  g_autoptr (GVariant) local_to_chunks = NULL;
   g_autoptr (GPtrArray) matches = NULL;
   const guint8 *from_buf;
   gsize from_len;
@@ -126,8 +154,13 @@ _ostree_compute_rollsum_matches (GBytes *from, GBytes *to)
   from_buf = g_bytes_get_data (from, &from_len);
   to_buf = g_bytes_get_data (to, &to_len);
 
-  from_rollsum = rollsum_chunks_crc32 (from);
-  to_rollsum = rollsum_chunks_crc32 (to);
+  if (from_chunks == NULL)
+    from_chunks = local_from_chunks = _ostree_rollsum_compute_chunks (from);
+  if (to_chunks == NULL)
+    to_chunks = local_to_chunks = _ostree_rollsum_compute_chunks (to);
+
+  from_rollsum = rollsum_chunks_crc32 (from_chunks);
+  to_rollsum = rollsum_chunks_crc32 (to_chunks);
 
   g_hash_table_iter_init (&hiter, to_rollsum);
   while (g_hash_table_iter_next (&hiter, &hkey, &hvalue))
@@ -196,6 +229,12 @@ _ostree_compute_rollsum_matches (GBytes *from, GBytes *to)
   return ret_rollsum;
 }
 
+OstreeRollsumMatches *
+_ostree_compute_rollsum_matches (GBytes *from, GBytes *to)
+{
+  return _ostree_compute_rollsum_matches_with_chunks (from, NULL, to, NULL);
+}
+
 void
 _ostree_rollsum_matches_free (OstreeRollsumMatches *rollsum)
 {
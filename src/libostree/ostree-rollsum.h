@@ -35,8 +35,14 @@ typedef struct
   GPtrArray *matches;
 } OstreeRollsumMatches;
 
+GVariant *_ostree_rollsum_compute_chunks (GBytes *bytes);
+
 OstreeRollsumMatches *_ostree_compute_rollsum_matches (GBytes *from, GBytes *to);
 
+OstreeRollsumMatches *_ostree_compute_rollsum_matches_with_chunks (GBytes *from,
+                                                                   GVariant *from_chunks,
+                                                                   GBytes *to, GVariant *to_chunks);
+
 void _ostree_rollsum_matches_free (OstreeRollsumMatches *rollsum);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (OstreeRollsumMatches, _ostree_rollsum_matches_free)
 
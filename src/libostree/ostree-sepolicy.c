@@ -632,7 +632,21 @@ ostree_sepolicy_restorecon (OstreeSePolicy *self, const char *path, GFileInfo *i
         }
       else
         {
-          if (lsetfilecon (gs_file_get_path_cached (target), label) < 0)
+          /* For a relabel pass over a mostly-correct tree, reading the
+           * existing context is much cheaper than unconditionally rewriting
+           * it; skip the write (and the resulting metadata dirtying) when
+           * the label already matches.
+           */
+          gboolean already_labeled = FALSE;
+          char *existing_con = NULL;
+          if (lgetfilecon_raw (gs_file_get_path_cached (target), &existing_con) > 0 && existing_con)
+            {
+              already_labeled = g_str_equal (existing_con, label);
+              freecon (existing_con);
+            }
+          if (already_labeled)
+            g_clear_pointer (&label, g_free);
+          else if (lsetfilecon (gs_file_get_path_cached (target), label) < 0)
             return glnx_throw_errno_prefix (error, "lsetfilecon");
         }
     }
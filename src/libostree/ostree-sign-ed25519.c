@@ -51,6 +51,11 @@ struct _OstreeSignEd25519
   guchar *secret_key;
   GList *public_keys;
   GList *revoked_keys;
+  /* Borrowed pointer into public_keys; the key that most recently verified
+   * a signature.  With long rotation keyrings the signing key is stable
+   * across a pull, so trying it first short-circuits the keyring scan.
+   */
+  gpointer last_verified_key;
 };
 
 #ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
@@ -91,6 +96,7 @@ _ostree_sign_ed25519_init (OstreeSignEd25519 *self)
   self->secret_key = NULL;
   self->public_keys = NULL;
   self->revoked_keys = NULL;
+  self->last_verified_key = NULL;
 
 #ifdef HAVE_LIBSODIUM
   if (sodium_init () < 0)
@@ -199,6 +205,33 @@ ostree_sign_ed25519_data_verify (OstreeSign *self, GBytes *data, GVariant *signa
   g_autoptr (GString) invalid_signatures = NULL;
   guint n_invalid_signatures = 0;
 
+  /* Filter revocations once rather than per (signature, key) pair, and put
+   * the most recently successful key first: during a pull the same key
+   * typically signed every commit, so the keyring scan usually ends after
+   * one verification.
+   */
+  g_autoptr (GPtrArray) usable_keys = g_ptr_array_new ();
+  {
+    g_autofree char *hex = g_malloc0 (crypto_sign_PUBLICKEYBYTES * 2 + 1);
+    for (GList *public_key = sign->public_keys; public_key != NULL; public_key = public_key->next)
+      {
+        /* TODO: use non-list for tons of revoked keys? */
+        if (g_list_find_custom (sign->revoked_keys, public_key->data, _compare_ed25519_keys)
+            != NULL)
+          {
+            g_debug ("Skip revoked key '%s'",
+                     sodium_bin2hex (hex, crypto_sign_PUBLICKEYBYTES * 2 + 1, public_key->data,
+                                     crypto_sign_PUBLICKEYBYTES));
+            continue;
+          }
+
+        if (public_key->data == sign->last_verified_key)
+          g_ptr_array_insert (usable_keys, 0, public_key->data);
+        else
+          g_ptr_array_add (usable_keys, public_key->data);
+      }
+  }
+
   for (gsize i = 0; i < g_variant_n_children (signatures); i++)
     {
       g_autoptr (GVariant) child = g_variant_get_child_value (signatures, i);
@@ -214,22 +247,13 @@ ostree_sign_ed25519_data_verify (OstreeSign *self, GBytes *data, GVariant *signa
 
       g_debug ("Read signature %d: %s", (gint)i, g_variant_print (child, TRUE));
 
-      for (GList *public_key = sign->public_keys; public_key != NULL; public_key = public_key->next)
+      for (guint j = 0; j < usable_keys->len; j++)
         {
-
-          /* TODO: use non-list for tons of revoked keys? */
-          if (g_list_find_custom (sign->revoked_keys, public_key->data, _compare_ed25519_keys)
-              != NULL)
-            {
-              g_debug ("Skip revoked key '%s'",
-                       sodium_bin2hex (hex, crypto_sign_PUBLICKEYBYTES * 2 + 1, public_key->data,
-                                       crypto_sign_PUBLICKEYBYTES));
-              continue;
-            }
+          gpointer public_key = usable_keys->pdata[j];
 
           if (crypto_sign_verify_detached ((guchar *)g_variant_get_data (child),
                                            g_bytes_get_data (data, NULL), g_bytes_get_size (data),
-                                           public_key->data)
+                                           public_key)
               != 0)
             {
               /* Incorrect signature! */
@@ -238,18 +262,19 @@ ostree_sign_ed25519_data_verify (OstreeSign *self, GBytes *data, GVariant *signa
               else
                 g_string_append (invalid_signatures, "; ");
               n_invalid_signatures++;
-              g_string_append_printf (invalid_signatures, "key '%s'",
-                                      sodium_bin2hex (hex, crypto_sign_PUBLICKEYBYTES * 2 + 1,
-                                                      public_key->data,
-                                                      crypto_sign_PUBLICKEYBYTES));
+              g_string_append_printf (
+                  invalid_signatures, "key '%s'",
+                  sodium_bin2hex (hex, crypto_sign_PUBLICKEYBYTES * 2 + 1, public_key,
+                                  crypto_sign_PUBLICKEYBYTES));
             }
           else
             {
+              sign->last_verified_key = public_key;
               if (out_success_message)
                 {
                   *out_success_message = g_strdup_printf (
                       "ed25519: Signature verified successfully with key '%s'",
-                      sodium_bin2hex (hex, crypto_sign_PUBLICKEYBYTES * 2 + 1, public_key->data,
+                      sodium_bin2hex (hex, crypto_sign_PUBLICKEYBYTES * 2 + 1, public_key,
                                       crypto_sign_PUBLICKEYBYTES));
                 }
               return TRUE;
@@ -322,6 +347,7 @@ ostree_sign_ed25519_clear_keys (OstreeSign *self, GError **error)
       g_list_free_full (sign->public_keys, g_free);
       sign->public_keys = NULL;
     }
+  sign->last_verified_key = NULL;
 
   /* Clear already loaded revoked keys */
   if (sign->revoked_keys != NULL)
@@ -32,4 +32,9 @@ G_BEGIN_DECLS
 gboolean _ostree_sign_summary_at (OstreeSign *self, OstreeRepo *repo, int dir_fd, GVariant *keys,
                                   GCancellable *cancellable, GError **error);
 
+gboolean _ostree_sign_summary_bytes (OstreeSign *self, GBytes *summary_data,
+                                     GVariant *existing_metadata, GVariant *keys,
+                                     GVariant **out_metadata, GCancellable *cancellable,
+                                     GError **error);
+
 G_END_DECLS
@@ -493,6 +493,193 @@ ostree_sign_commit (OstreeSign *self, OstreeRepo *repo, const gchar *commit_chec
   return TRUE;
 }
 
+/* The detached metadata key for per-dirtree signatures is derived from
+ * the engine's commit signature key, e.g. "ostree.sign.ed25519.dirtree".
+ */
+static gchar *
+_sign_dirtree_metadata_key (OstreeSign *self)
+{
+  return g_strconcat (ostree_sign_metadata_key (self), ".dirtree", NULL);
+}
+
+static int
+_compare_ascii_checksums (gconstpointer a_pp, gconstpointer b_pp)
+{
+  char *a = *((char **)a_pp);
+  char *b = *((char **)b_pp);
+
+  return strcmp (a, b);
+}
+
+/**
+ * ostree_sign_commit_dirtrees:
+ * @self: an #OstreeSign object
+ * @repo: an #OsreeRepo object
+ * @commit_checksum: SHA256 of given commit whose dirtrees to sign
+ * @cancellable: A #GCancellable
+ * @error: a #GError
+ *
+ * Sign every dirtree object reachable from a commit, storing the
+ * signatures in the commit's detached metadata as a map from dirtree
+ * checksum to signature list.
+ *
+ * This allows clients performing partial pulls to verify a subtree
+ * with only the commit's detached metadata and the target dirtree,
+ * instead of fetching the full metadata chain up to the commit;
+ * see #ostree_sign_dirtree_verify.
+ *
+ * Depending of the signing engine used you will need to load
+ * the secret key with #ostree_sign_set_sk.
+ *
+ * Returns: @TRUE if all dirtrees have been signed successfully,
+ * @FALSE in case of error (@error will contain the reason).
+ *
+ * Since: 2023.6
+ */
+gboolean
+ostree_sign_commit_dirtrees (OstreeSign *self, OstreeRepo *repo, const gchar *commit_checksum,
+                             GCancellable *cancellable, GError **error)
+{
+  g_assert (OSTREE_IS_SIGN (self));
+
+  g_autoptr (GVariant) old_metadata = NULL;
+  if (!ostree_repo_read_commit_detached_metadata (repo, commit_checksum, &old_metadata, cancellable,
+                                                  error))
+    return glnx_prefix_error (error, "Failed to read detached metadata");
+
+  g_autoptr (GHashTable) reachable = NULL;
+  if (!ostree_repo_traverse_commit (repo, commit_checksum, 0, &reachable, cancellable, error))
+    return glnx_prefix_error (error, "Failed to traverse commit");
+
+  /* Sort the dirtree checksums so re-signing the same commit yields the
+   * same serialized metadata.
+   */
+  g_autoptr (GPtrArray) dirtrees = g_ptr_array_new_with_free_func (g_free);
+  GLNX_HASH_TABLE_FOREACH (reachable, GVariant *, object)
+    {
+      OstreeObjectType objtype;
+      const char *checksum;
+
+      ostree_object_name_deserialize (object, &checksum, &objtype);
+      if (objtype == OSTREE_OBJECT_TYPE_DIR_TREE)
+        g_ptr_array_add (dirtrees, g_strdup (checksum));
+    }
+  g_ptr_array_sort (dirtrees, _compare_ascii_checksums);
+
+  g_autofree gchar *signature_key = _sign_dirtree_metadata_key (self);
+  GVariantType *signature_format = (GVariantType *)ostree_sign_metadata_format (self);
+
+  g_autoptr (GVariant) old_tree_signatures = NULL;
+  if (old_metadata)
+    old_tree_signatures
+        = g_variant_lookup_value (old_metadata, signature_key, G_VARIANT_TYPE ("a{saay}"));
+
+  g_auto (GVariantBuilder) tree_builder;
+  g_variant_builder_init (&tree_builder, G_VARIANT_TYPE ("a{saay}"));
+
+  for (guint i = 0; i < dirtrees->len; i++)
+    {
+      const char *checksum = dirtrees->pdata[i];
+      g_autoptr (GVariant) dirtree_variant = NULL;
+      g_autoptr (GBytes) dirtree_data = NULL;
+      g_autoptr (GBytes) signature = NULL;
+      g_autoptr (GVariant) existing_signatures = NULL;
+      g_autoptr (GVariantBuilder) signature_builder = NULL;
+
+      if (!ostree_repo_load_variant (repo, OSTREE_OBJECT_TYPE_DIR_TREE, checksum, &dirtree_variant,
+                                     error))
+        return glnx_prefix_error (error, "Failed to read dirtree %s", checksum);
+
+      dirtree_data = g_variant_get_data_as_bytes (dirtree_variant);
+
+      if (!ostree_sign_data (self, dirtree_data, &signature, cancellable, error))
+        return glnx_prefix_error (error, "Not able to sign dirtree %s", checksum);
+
+      /* Keep signatures made with other keys */
+      if (old_tree_signatures)
+        existing_signatures
+            = g_variant_lookup_value (old_tree_signatures, checksum, signature_format);
+
+      signature_builder
+          = ot_util_variant_builder_from_variant (existing_signatures, signature_format);
+
+      g_variant_builder_add (signature_builder, "@ay", ot_gvariant_new_ay_bytes (signature));
+
+      g_variant_builder_add (&tree_builder, "{s@aay}", checksum,
+                             g_variant_builder_end (signature_builder));
+    }
+
+  GVariantDict metadata_dict;
+  g_variant_dict_init (&metadata_dict, old_metadata);
+  g_variant_dict_insert_value (&metadata_dict, signature_key, g_variant_builder_end (&tree_builder));
+  g_autoptr (GVariant) new_metadata = g_variant_ref_sink (g_variant_dict_end (&metadata_dict));
+
+  if (!ostree_repo_write_commit_detached_metadata (repo, commit_checksum, new_metadata, cancellable,
+                                                   error))
+    return FALSE;
+
+  return TRUE;
+}
+
+/**
+ * ostree_sign_dirtree_verify:
+ * @self: an #OstreeSign object
+ * @repo: an #OsreeRepo object
+ * @commit_checksum: SHA256 of the commit holding the dirtree signatures
+ * @dirtree_checksum: SHA256 of the dirtree to verify
+ * @out_success_message: (out) (nullable) (optional): success message returned by the signing
+ * engine
+ * @cancellable: A #GCancellable
+ * @error: a #GError
+ *
+ * Verify if a dirtree is signed with a known key, using the per-dirtree
+ * signatures written by #ostree_sign_commit_dirtrees into the commit's
+ * detached metadata.  Only the detached metadata and the dirtree object
+ * itself are read; the intermediate metadata chain between the commit
+ * and the dirtree is not required.
+ *
+ * Depending of the signing engine used you will need to load
+ * the public key(s) for verification with #ostree_sign_set_pk,
+ * #ostree_sign_add_pk and/or #ostree_sign_load_pk.
+ *
+ * Returns: @TRUE if the dirtree has been verified successfully,
+ * @FALSE in case of error or no valid keys are available (@error will contain the reason).
+ *
+ * Since: 2023.6
+ */
+gboolean
+ostree_sign_dirtree_verify (OstreeSign *self, OstreeRepo *repo, const gchar *commit_checksum,
+                            const gchar *dirtree_checksum, char **out_success_message,
+                            GCancellable *cancellable, GError **error)
+{
+  g_assert (OSTREE_IS_SIGN (self));
+
+  g_autoptr (GVariant) metadata = NULL;
+  if (!ostree_repo_read_commit_detached_metadata (repo, commit_checksum, &metadata, cancellable,
+                                                  error))
+    return glnx_prefix_error (error, "Failed to read detached metadata");
+
+  g_autofree gchar *signature_key = _sign_dirtree_metadata_key (self);
+  GVariantType *signature_format = (GVariantType *)ostree_sign_metadata_format (self);
+
+  g_autoptr (GVariant) tree_signatures = NULL;
+  if (metadata)
+    tree_signatures = g_variant_lookup_value (metadata, signature_key, G_VARIANT_TYPE ("a{saay}"));
+
+  g_autoptr (GVariant) signatures = NULL;
+  if (tree_signatures)
+    signatures = g_variant_lookup_value (tree_signatures, dirtree_checksum, signature_format);
+
+  g_autoptr (GVariant) dirtree_variant = NULL;
+  if (!ostree_repo_load_variant (repo, OSTREE_OBJECT_TYPE_DIR_TREE, dirtree_checksum,
+                                 &dirtree_variant, error))
+    return glnx_prefix_error (error, "Failed to read dirtree");
+
+  g_autoptr (GBytes) signed_data = g_variant_get_data_as_bytes (dirtree_variant);
+
+  return ostree_sign_data_verify (self, signed_data, signatures, out_success_message, error);
+}
+
 /**
  * ostree_sign_get_all:
  *
@@ -559,35 +746,20 @@ ostree_sign_get_by_name (const gchar *name, GError **error)
   return sign;
 }
 
+/* Sign in-memory summary data with each of @keys, appending to
+ * @existing_metadata (if any), and return the new detached metadata in
+ * @out_metadata.  Performs no file I/O, so callers that already hold the
+ * summary bytes (e.g. summary regeneration) can compute the signature
+ * without re-reading the just-written file.
+ */
 gboolean
-_ostree_sign_summary_at (OstreeSign *self, OstreeRepo *repo, int dir_fd, GVariant *keys,
-                         GCancellable *cancellable, GError **error)
+_ostree_sign_summary_bytes (OstreeSign *self, GBytes *summary_data, GVariant *existing_metadata,
+                            GVariant *keys, GVariant **out_metadata, GCancellable *cancellable,
+                            GError **error)
 {
   g_assert (OSTREE_IS_SIGN (self));
-  g_assert (OSTREE_IS_REPO (repo));
 
-  g_autoptr (GVariant) normalized = NULL;
-  g_autoptr (GBytes) summary_data = NULL;
-  g_autoptr (GVariant) metadata = NULL;
-
-  glnx_autofd int fd = -1;
-  if (!glnx_openat_rdonly (dir_fd, "summary", TRUE, &fd, error))
-    return FALSE;
-  summary_data = ot_fd_readall_or_mmap (fd, 0, error);
-  if (!summary_data)
-    return FALSE;
-
-  /* Note that fd is reused below */
-  glnx_close_fd (&fd);
-
-  if (!ot_openat_ignore_enoent (dir_fd, "summary.sig", &fd, error))
-    return FALSE;
-
-  if (fd >= 0)
-    {
-      if (!ot_variant_read_fd (fd, 0, OSTREE_SUMMARY_SIG_GVARIANT_FORMAT, FALSE, &metadata, error))
-        return FALSE;
-    }
+  g_autoptr (GVariant) metadata = existing_metadata ? g_variant_ref (existing_metadata) : NULL;
 
   if (g_variant_n_children (keys) == 0)
     return glnx_throw (error, "No keys passed for signing summary");
@@ -613,6 +785,46 @@ _ostree_sign_summary_at (OstreeSign *self, OstreeRepo *repo, int dir_fd, GVarian
     }
   g_variant_iter_free (iter);
 
+  *out_metadata = g_steal_pointer (&metadata);
+  return TRUE;
+}
+
+gboolean
+_ostree_sign_summary_at (OstreeSign *self, OstreeRepo *repo, int dir_fd, GVariant *keys,
+                         GCancellable *cancellable, GError **error)
+{
+  g_assert (OSTREE_IS_SIGN (self));
+  g_assert (OSTREE_IS_REPO (repo));
+
+  g_autoptr (GVariant) normalized = NULL;
+  g_autoptr (GBytes) summary_data = NULL;
+  g_autoptr (GVariant) existing_metadata = NULL;
+
+  glnx_autofd int fd = -1;
+  if (!glnx_openat_rdonly (dir_fd, "summary", TRUE, &fd, error))
+    return FALSE;
+  summary_data = ot_fd_readall_or_mmap (fd, 0, error);
+  if (!summary_data)
+    return FALSE;
+
+  /* Note that fd is reused below */
+  glnx_close_fd (&fd);
+
+  if (!ot_openat_ignore_enoent (dir_fd, "summary.sig", &fd, error))
+    return FALSE;
+
+  if (fd >= 0)
+    {
+      if (!ot_variant_read_fd (fd, 0, OSTREE_SUMMARY_SIG_GVARIANT_FORMAT, FALSE, &existing_metadata,
+                               error))
+        return FALSE;
+    }
+
+  g_autoptr (GVariant) metadata = NULL;
+  if (!_ostree_sign_summary_bytes (self, summary_data, existing_metadata, keys, &metadata,
+                                   cancellable, error))
+    return FALSE;
+
   normalized = g_variant_get_normal_form (metadata);
   if (!_ostree_repo_file_replace_contents (repo, dir_fd, "summary.sig",
                                            g_variant_get_data (normalized),
@@ -115,6 +115,17 @@ gboolean ostree_sign_commit_verify (OstreeSign *self, OstreeRepo *repo,
                                     const gchar *commit_checksum, char **out_success_message,
                                     GCancellable *cancellable, GError **error);
 
+_OSTREE_PUBLIC
+gboolean ostree_sign_commit_dirtrees (OstreeSign *self, OstreeRepo *repo,
+                                      const gchar *commit_checksum, GCancellable *cancellable,
+                                      GError **error);
+
+_OSTREE_PUBLIC
+gboolean ostree_sign_dirtree_verify (OstreeSign *self, OstreeRepo *repo,
+                                     const gchar *commit_checksum, const gchar *dirtree_checksum,
+                                     char **out_success_message, GCancellable *cancellable,
+                                     GError **error);
+
 _OSTREE_PUBLIC
 gboolean ostree_sign_clear_keys (OstreeSign *self, GError **error);
 
@@ -25,6 +25,25 @@
 
 #include "ostree-sysroot-private.h"
 
+/* Resolve whether @dent refers to a directory, issuing at most one
+ * fstatat() and only when the filesystem didn't fill in d_type.
+ */
+static gboolean
+dent_is_dir (int dfd, struct dirent *dent, gboolean *out_is_dir, GError **error)
+{
+  if (dent->d_type != DT_UNKNOWN)
+    {
+      *out_is_dir = (dent->d_type == DT_DIR);
+      return TRUE;
+    }
+
+  struct stat stbuf;
+  if (!glnx_fstatat (dfd, dent->d_name, &stbuf, AT_SYMLINK_NOFOLLOW, error))
+    return FALSE;
+  *out_is_dir = S_ISDIR (stbuf.st_mode);
+  return TRUE;
+}
+
 /* @deploydir_dfd: Directory FD for ostree/deploy
  * @osname: Target osname
  * @inout_deployments: All deployments in this subdir will be appended to this array
@@ -48,18 +67,36 @@ _ostree_sysroot_list_deployment_dirs_for_os (int deploydir_dfd, const char *osna
     {
       struct dirent *dent;
 
-      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+      if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, cancellable, error))
         return FALSE;
       if (dent == NULL)
         break;
 
-      if (dent->d_type != DT_DIR)
+      /* Check the name before resolving the type; the .origin files (and
+       * other non-deployment leftovers) then never need a stat() even on
+       * filesystems that leave d_type as DT_UNKNOWN.
+       */
+      g_autoptr (GError) parse_error = NULL;
+      g_autofree char *csum = NULL;
+      gint deployserial = -1;
+      const gboolean name_ok
+          = _ostree_sysroot_parse_deploy_path_name (dent->d_name, &csum, &deployserial,
+                                                    &parse_error);
+      if (!name_ok && dent->d_type != DT_DIR && dent->d_type != DT_UNKNOWN)
         continue;
 
-      g_autofree char *csum = NULL;
-      gint deployserial;
-      if (!_ostree_sysroot_parse_deploy_path_name (dent->d_name, &csum, &deployserial, error))
+      gboolean is_dir;
+      if (!dent_is_dir (dfd_iter.fd, dent, &is_dir, error))
         return FALSE;
+      if (!is_dir)
+        continue;
+
+      /* Directories are required to look like deployments */
+      if (!name_ok)
+        {
+          g_propagate_error (error, g_steal_pointer (&parse_error));
+          return FALSE;
+        }
 
       g_ptr_array_add (inout_deployments,
                        ostree_deployment_new (-1, osname, csum, deployserial, NULL, -1));
@@ -150,20 +187,25 @@ _ostree_sysroot_list_all_boot_directories (OstreeSysroot *self, char ***out_boot
   while (exists)
     {
       struct dirent *dent;
-      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+      if (!glnx_dirfd_iterator_next_dent (&dfd_iter, &dent, cancellable, error))
         return FALSE;
       if (dent == NULL)
         break;
 
-      if (dent->d_type != DT_DIR)
-        continue;
-
       /* Only look at directories ending in -CHECKSUM; nothing else
-       * should be in here, but let's be conservative.
+       * should be in here, but let's be conservative.  Filtering on the
+       * name first means entries that don't match never need a stat()
+       * to resolve DT_UNKNOWN.
        */
       if (!_ostree_sysroot_parse_bootdir_name (dent->d_name, NULL, NULL))
         continue;
 
+      gboolean is_dir;
+      if (!dent_is_dir (dfd_iter.fd, dent, &is_dir, error))
+        return FALSE;
+      if (!is_dir)
+        continue;
+
       g_ptr_array_add (ret_bootdirs, g_strdup (dent->d_name));
     }
 
@@ -233,12 +275,17 @@ _ostree_sysroot_rmrf_deployment (OstreeSysroot *self, OstreeDeployment *deployme
   if (stbuf.st_dev == self->root_device && stbuf.st_ino == self->root_inode)
     return TRUE;
 
-  /* This deployment wasn't referenced, so delete it */
+  /* This deployment wasn't referenced, so delete it.  A deployment root is
+   * a full OS checkout (hundreds of thousands of inodes), so delete it with
+   * the sharded parallel helper rather than a sequential walk; the workers
+   * run at idle I/O priority so cleanup after an upgrade doesn't compete
+   * with the booted system.
+   */
   if (!_ostree_linuxfs_fd_alter_immutable_flag (deployment_fd, FALSE, cancellable, error))
     return FALSE;
   if (!glnx_shutil_rm_rf_at (self->sysroot_fd, origin_relpath, cancellable, error))
     return FALSE;
-  if (!glnx_shutil_rm_rf_at (self->sysroot_fd, deployment_path, cancellable, error))
+  if (!ot_rm_rf_parallel_at (self->sysroot_fd, deployment_path, cancellable, error))
     return FALSE;
 
   return TRUE;
@@ -32,6 +32,7 @@
 #include <sys/socket.h>
 #include <sys/statfs.h>
 #include <sys/statvfs.h>
+#include <sys/xattr.h>
 
 #ifdef HAVE_LIBMOUNT
 #include <libmount.h>
@@ -383,12 +384,15 @@ copy_dir_recurse (int src_parent_dfd, int dest_parent_dfd, const char *name,
 }
 
 /* If a chain of directories is added, this function will ensure
- * they're created.
+ * they're created.  @ensured_dirs (nullable) tracks directories already
+ * created, so that merging many files in the same directory doesn't
+ * re-open it and re-apply its attributes once per file.
  */
 static gboolean
 ensure_directory_from_template (int orig_etc_fd, int modified_etc_fd, int new_etc_fd,
-                                const char *path, int *out_dfd, OstreeSysrootDebugFlags flags,
-                                GCancellable *cancellable, GError **error)
+                                const char *path, GHashTable *ensured_dirs, int *out_dfd,
+                                OstreeSysrootDebugFlags flags, GCancellable *cancellable,
+                                GError **error)
 {
   glnx_autofd int src_dfd = -1;
   glnx_autofd int target_dfd = -1;
@@ -396,6 +400,9 @@ ensure_directory_from_template (int orig_etc_fd, int modified_etc_fd, int new_et
   g_assert (path != NULL);
   g_assert (*path != '/' && *path != '\0');
 
+  if (ensured_dirs != NULL && out_dfd == NULL && g_hash_table_contains (ensured_dirs, path))
+    return TRUE;
+
   if (!glnx_opendirat (modified_etc_fd, path, TRUE, &src_dfd, error))
     return FALSE;
 
@@ -414,7 +421,8 @@ again:
           if (strcmp (parent_path, ".") != 0)
             {
               if (!ensure_directory_from_template (orig_etc_fd, modified_etc_fd, new_etc_fd,
-                                                   parent_path, NULL, flags, cancellable, error))
+                                                   parent_path, ensured_dirs, NULL, flags,
+                                                   cancellable, error))
                 return FALSE;
 
               /* Loop */
@@ -437,6 +445,9 @@ again:
                                          cancellable, error))
     return FALSE;
 
+  if (ensured_dirs != NULL)
+    g_hash_table_add (ensured_dirs, g_strdup (path));
+
   if (out_dfd)
     *out_dfd = g_steal_fd (&target_dfd);
   return TRUE;
@@ -448,7 +459,8 @@ again:
  */
 static gboolean
 copy_modified_config_file (int orig_etc_fd, int modified_etc_fd, int new_etc_fd, const char *path,
-                           OstreeSysrootDebugFlags flags, GCancellable *cancellable, GError **error)
+                           GHashTable *ensured_dirs, OstreeSysrootDebugFlags flags,
+                           GCancellable *cancellable, GError **error)
 {
   struct stat modified_stbuf;
   struct stat new_stbuf;
@@ -456,23 +468,14 @@ copy_modified_config_file (int orig_etc_fd, int modified_etc_fd, int new_etc_fd,
   if (!glnx_fstatat (modified_etc_fd, path, &modified_stbuf, AT_SYMLINK_NOFOLLOW, error))
     return glnx_prefix_error (error, "Reading modified config file");
 
-  glnx_autofd int dest_parent_dfd = -1;
   if (strchr (path, '/') != NULL)
     {
       g_autofree char *parent = g_path_get_dirname (path);
 
       if (!ensure_directory_from_template (orig_etc_fd, modified_etc_fd, new_etc_fd, parent,
-                                           &dest_parent_dfd, flags, cancellable, error))
+                                           ensured_dirs, NULL, flags, cancellable, error))
         return FALSE;
     }
-  else
-    {
-      dest_parent_dfd = dup (new_etc_fd);
-      if (dest_parent_dfd == -1)
-        return glnx_throw_errno_prefix (error, "dup");
-    }
-
-  g_assert (dest_parent_dfd != -1);
 
   if (fstatat (new_etc_fd, path, &new_stbuf, AT_SYMLINK_NOFOLLOW) < 0)
     {
@@ -506,6 +509,10 @@ copy_modified_config_file (int orig_etc_fd, int modified_etc_fd, int new_etc_fd,
     {
       if (!copy_dir_recurse (modified_etc_fd, new_etc_fd, path, flags, cancellable, error))
         return FALSE;
+      /* Subsequent plan entries under this directory don't need to re-create
+       * it */
+      if (ensured_dirs != NULL)
+        g_hash_table_add (ensured_dirs, g_strdup (path));
     }
   else if (S_ISLNK (modified_stbuf.st_mode) || S_ISREG (modified_stbuf.st_mode))
     {
@@ -523,12 +530,83 @@ copy_modified_config_file (int orig_etc_fd, int modified_etc_fd, int new_etc_fd,
   return TRUE;
 }
 
+static int
+compare_path_strings (gconstpointer a, gconstpointer b)
+{
+  return strcmp (*(const char *const *)a, *(const char *const *)b);
+}
+
+/* The computed difference between a merge deployment's /usr/etc and /etc;
+ * the expensive-to-produce half of the /etc merge, separated out so it can
+ * be computed on a worker thread while the new tree checks out.
+ */
+typedef struct
+{
+  GFile *orig_etc;     /* The merge deployment's /usr/etc */
+  GFile *modified_etc; /* The merge deployment's /etc */
+  GPtrArray *modified; /* Array<OstreeDiffItem> */
+  GPtrArray *removed;  /* Array<GFile> */
+  GPtrArray *added;    /* Array<GFile> */
+} EtcMergeDiff;
+
+static void
+etc_merge_diff_free (EtcMergeDiff *diff)
+{
+  g_clear_object (&diff->orig_etc);
+  g_clear_object (&diff->modified_etc);
+  g_clear_pointer (&diff->modified, g_ptr_array_unref);
+  g_clear_pointer (&diff->removed, g_ptr_array_unref);
+  g_clear_pointer (&diff->added, g_ptr_array_unref);
+  g_free (diff);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (EtcMergeDiff, etc_merge_diff_free)
+
+/* Compute the difference between @merge_deployment's `/usr/etc` and `/etc`.
+ * This only reads existing deployments, so it's safe to run on a worker
+ * thread concurrently with the checkout of a new deployment.
+ */
+static gboolean
+compute_etc_merge_diff (OstreeSysroot *sysroot, OstreeDeployment *merge_deployment,
+                        EtcMergeDiff **out_diff, GCancellable *cancellable, GError **error)
+{
+  g_autofree char *merge_deployment_path
+      = ostree_sysroot_get_deployment_dirpath (sysroot, merge_deployment);
+  glnx_autofd int merge_deployment_dfd = -1;
+  if (!glnx_opendirat (sysroot->sysroot_fd, merge_deployment_path, FALSE, &merge_deployment_dfd,
+                       error))
+    return FALSE;
+
+  g_autoptr (EtcMergeDiff) diff = g_new0 (EtcMergeDiff, 1);
+  /* TODO: get rid of GFile usage here */
+  diff->orig_etc = ot_fdrel_to_gfile (merge_deployment_dfd, "usr/etc");
+  diff->modified_etc = ot_fdrel_to_gfile (merge_deployment_dfd, "etc");
+  diff->modified = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_diff_item_unref);
+  diff->removed = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
+  diff->added = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
+  /* For now, ignore changes to xattrs; the problem is that
+   * security.selinux will be different between the /usr/etc labels
+   * and the ones in the real /etc, so they all show up as different.
+   *
+   * This means that if you want to change the security context of a
+   * file, to have that change persist across upgrades, you must also
+   * modify the content of the file.
+   */
+  if (!ostree_diff_dirs (OSTREE_DIFF_FLAGS_IGNORE_XATTRS, diff->orig_etc, diff->modified_etc,
+                         diff->modified, diff->removed, diff->added, cancellable, error))
+    return glnx_prefix_error (error, "While computing configuration diff");
+
+  *out_diff = g_steal_pointer (&diff);
+  return TRUE;
+}
+
 /*
  * merge_configuration_from:
  * @sysroot: Sysroot
  * @merge_deployment: Source of configuration differences
  * @new_deployment: Target for merge of configuration
  * @new_deployment_dfd: Directory fd for @new_deployment (may *not* be -1)
+ * @precomputed_diff: (nullable): Diff from compute_etc_merge_diff(), or %NULL to compute here
  * @cancellable: Cancellable
  * @error: Error
  *
@@ -543,7 +621,7 @@ copy_modified_config_file (int orig_etc_fd, int modified_etc_fd, int new_etc_fd,
 static gboolean
 merge_configuration_from (OstreeSysroot *sysroot, OstreeDeployment *merge_deployment,
                           OstreeDeployment *new_deployment, int new_deployment_dfd,
-                          GCancellable *cancellable, GError **error)
+                          EtcMergeDiff *precomputed_diff, GCancellable *cancellable, GError **error)
 {
   GLNX_AUTO_PREFIX_ERROR ("During /etc merge", error);
   const OstreeSysrootDebugFlags flags = sysroot->debug_flags;
@@ -551,43 +629,33 @@ merge_configuration_from (OstreeSysroot *sysroot, OstreeDeployment *merge_deploy
   g_assert (merge_deployment != NULL && new_deployment != NULL);
   g_assert (new_deployment_dfd != -1);
 
-  g_autofree char *merge_deployment_path
-      = ostree_sysroot_get_deployment_dirpath (sysroot, merge_deployment);
-  glnx_autofd int merge_deployment_dfd = -1;
-  if (!glnx_opendirat (sysroot->sysroot_fd, merge_deployment_path, FALSE, &merge_deployment_dfd,
-                       error))
-    return FALSE;
-
-  /* TODO: get rid of GFile usage here */
-  g_autoptr (GFile) orig_etc = ot_fdrel_to_gfile (merge_deployment_dfd, "usr/etc");
-  g_autoptr (GFile) modified_etc = ot_fdrel_to_gfile (merge_deployment_dfd, "etc");
-  /* Return values for below */
-  g_autoptr (GPtrArray) modified
-      = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_diff_item_unref);
-  g_autoptr (GPtrArray) removed = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
-  g_autoptr (GPtrArray) added = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
-  /* For now, ignore changes to xattrs; the problem is that
-   * security.selinux will be different between the /usr/etc labels
-   * and the ones in the real /etc, so they all show up as different.
-   *
-   * This means that if you want to change the security context of a
-   * file, to have that change persist across upgrades, you must also
-   * modify the content of the file.
-   */
-  if (!ostree_diff_dirs (OSTREE_DIFF_FLAGS_IGNORE_XATTRS, orig_etc, modified_etc, modified, removed,
-                         added, cancellable, error))
-    return glnx_prefix_error (error, "While computing configuration diff");
+  g_autoptr (EtcMergeDiff) owned_diff = NULL;
+  EtcMergeDiff *diff = precomputed_diff;
+  if (diff == NULL)
+    {
+      if (!compute_etc_merge_diff (sysroot, merge_deployment, &owned_diff, cancellable, error))
+        return FALSE;
+      diff = owned_diff;
+    }
 
   {
     g_autofree char *msg
-        = g_strdup_printf ("Copying /etc changes: %u modified, %u removed, %u added", modified->len,
-                           removed->len, added->len);
+        = g_strdup_printf ("Copying /etc changes: %u modified, %u removed, %u added",
+                           diff->modified->len, diff->removed->len, diff->added->len);
     ot_journal_send ("MESSAGE_ID=" SD_ID128_FORMAT_STR, SD_ID128_FORMAT_VAL (OSTREE_CONFIGMERGE_ID),
-                     "MESSAGE=%s", msg, "ETC_N_MODIFIED=%u", modified->len, "ETC_N_REMOVED=%u",
-                     removed->len, "ETC_N_ADDED=%u", added->len, NULL);
+                     "MESSAGE=%s", msg, "ETC_N_MODIFIED=%u", diff->modified->len,
+                     "ETC_N_REMOVED=%u", diff->removed->len, "ETC_N_ADDED=%u", diff->added->len,
+                     NULL);
     _ostree_sysroot_emit_journal_msg (sysroot, msg);
   }
 
+  g_autofree char *merge_deployment_path
+      = ostree_sysroot_get_deployment_dirpath (sysroot, merge_deployment);
+  glnx_autofd int merge_deployment_dfd = -1;
+  if (!glnx_opendirat (sysroot->sysroot_fd, merge_deployment_path, FALSE, &merge_deployment_dfd,
+                       error))
+    return FALSE;
+
   glnx_autofd int orig_etc_fd = -1;
   if (!glnx_opendirat (merge_deployment_dfd, "usr/etc", TRUE, &orig_etc_fd, error))
     return FALSE;
@@ -598,38 +666,53 @@ merge_configuration_from (OstreeSysroot *sysroot, OstreeDeployment *merge_deploy
   if (!glnx_opendirat (new_deployment_dfd, "etc", TRUE, &new_etc_fd, error))
     return FALSE;
 
-  for (guint i = 0; i < removed->len; i++)
+  /* Batch the plan before touching the filesystem: resolve every diff entry
+   * to a relative path and sort.  Sorting groups entries in the same
+   * directory together (and parents before their children), so execution
+   * below ensures each destination directory once instead of once per file,
+   * and walks the tree in name order rather than diff-traversal order.
+   */
+  g_autoptr (GPtrArray) removed_paths = g_ptr_array_new_with_free_func (g_free);
+  for (guint i = 0; i < diff->removed->len; i++)
     {
-      GFile *file = removed->pdata[i];
-      g_autofree char *path = NULL;
-
-      path = g_file_get_relative_path (orig_etc, file);
+      GFile *file = diff->removed->pdata[i];
+      char *path = g_file_get_relative_path (diff->orig_etc, file);
       g_assert (path);
-
-      if (!glnx_shutil_rm_rf_at (new_etc_fd, path, cancellable, error))
-        return FALSE;
+      g_ptr_array_add (removed_paths, path);
     }
+  g_ptr_array_sort (removed_paths, compare_path_strings);
 
-  for (guint i = 0; i < modified->len; i++)
+  g_autoptr (GPtrArray) copy_paths = g_ptr_array_new_with_free_func (g_free);
+  for (guint i = 0; i < diff->modified->len; i++)
     {
-      OstreeDiffItem *diff = modified->pdata[i];
-      g_autofree char *path = g_file_get_relative_path (modified_etc, diff->target);
-
+      OstreeDiffItem *diff_item = diff->modified->pdata[i];
+      char *path = g_file_get_relative_path (diff->modified_etc, diff_item->target);
       g_assert (path);
-
-      if (!copy_modified_config_file (orig_etc_fd, modified_etc_fd, new_etc_fd, path, flags,
-                                      cancellable, error))
-        return FALSE;
+      g_ptr_array_add (copy_paths, path);
     }
-  for (guint i = 0; i < added->len; i++)
+  for (guint i = 0; i < diff->added->len; i++)
     {
-      GFile *file = added->pdata[i];
-      g_autofree char *path = g_file_get_relative_path (modified_etc, file);
-
+      GFile *file = diff->added->pdata[i];
+      char *path = g_file_get_relative_path (diff->modified_etc, file);
       g_assert (path);
+      g_ptr_array_add (copy_paths, path);
+    }
+  g_ptr_array_sort (copy_paths, compare_path_strings);
+
+  for (guint i = 0; i < removed_paths->len; i++)
+    {
+      const char *path = removed_paths->pdata[i];
+      if (!glnx_shutil_rm_rf_at (new_etc_fd, path, cancellable, error))
+        return FALSE;
+    }
 
-      if (!copy_modified_config_file (orig_etc_fd, modified_etc_fd, new_etc_fd, path, flags,
-                                      cancellable, error))
+  /* Destination directories already ensured during this merge */
+  g_autoptr (GHashTable) ensured_dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (guint i = 0; i < copy_paths->len; i++)
+    {
+      const char *path = copy_paths->pdata[i];
+      if (!copy_modified_config_file (orig_etc_fd, modified_etc_fd, new_etc_fd, path, ensured_dirs,
+                                      flags, cancellable, error))
         return FALSE;
     }
 
@@ -667,14 +750,328 @@ compare_verity_digests (GVariant *metadata_composefs, const guchar *fsverity_dig
 
 #endif
 
+/* Recursively clone @src_dfd into @dest_dfd: directories are recreated with
+ * their mode, ownership and xattrs, everything else is hardlinked.  Since
+ * deployment checkouts never rewrite file content in place, the links are as
+ * safe as the hardlink farm the checkout itself produces.  At the top level
+ * the base deployment's merged /etc and composefs image are skipped; both are
+ * regenerated for the new deployment by the normal deploy path.
+ */
+static gboolean
+fast_rollback_clone_at (int src_dfd, int dest_dfd, gboolean toplevel, GCancellable *cancellable,
+                        GError **error)
+{
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (src_dfd, ".", FALSE, &dfd_iter, error))
+    return FALSE;
+
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, cancellable, error))
+        return FALSE;
+      if (dent == NULL)
+        break;
+
+      if (toplevel
+          && (g_str_equal (dent->d_name, "etc") || g_str_equal (dent->d_name, ".ostree.cfs")))
+        continue;
+
+      if (dent->d_type == DT_DIR)
+        {
+          struct stat stbuf;
+          if (!glnx_fstatat (dfd_iter.fd, dent->d_name, &stbuf, AT_SYMLINK_NOFOLLOW, error))
+            return FALSE;
+          if (mkdirat (dest_dfd, dent->d_name, 0700) < 0)
+            return glnx_throw_errno_prefix (error, "mkdirat(%s)", dent->d_name);
+
+          glnx_autofd int src_subdfd = -1;
+          glnx_autofd int dest_subdfd = -1;
+          if (!glnx_opendirat (dfd_iter.fd, dent->d_name, FALSE, &src_subdfd, error))
+            return FALSE;
+          if (!glnx_opendirat (dest_dfd, dent->d_name, FALSE, &dest_subdfd, error))
+            return FALSE;
+
+          g_autoptr (GVariant) xattrs = NULL;
+          if (!glnx_fd_get_all_xattrs (src_subdfd, &xattrs, cancellable, error))
+            return FALSE;
+          if (!glnx_fd_set_all_xattrs (dest_subdfd, xattrs, cancellable, error))
+            return FALSE;
+          if (fchown (dest_subdfd, stbuf.st_uid, stbuf.st_gid) < 0)
+            return glnx_throw_errno_prefix (error, "fchown(%s)", dent->d_name);
+          if (fchmod (dest_subdfd, stbuf.st_mode & 07777) < 0)
+            return glnx_throw_errno_prefix (error, "fchmod(%s)", dent->d_name);
+
+          if (!fast_rollback_clone_at (src_subdfd, dest_subdfd, FALSE, cancellable, error))
+            return FALSE;
+        }
+      else
+        {
+          if (linkat (dfd_iter.fd, dent->d_name, dest_dfd, dent->d_name, 0) < 0)
+            return glnx_throw_errno_prefix (error, "linkat(%s)", dent->d_name);
+        }
+    }
+
+  return TRUE;
+}
+
+/* Make the directory at @relpath match the metadata (mode, ownership, xattrs)
+ * recorded for @target in the repository, including removing xattrs that are
+ * no longer present in the target tree.
+ */
+static gboolean
+fast_rollback_apply_dir_meta (GFile *target, int dfd, const char *relpath,
+                              GCancellable *cancellable, GError **error)
+{
+  glnx_autofd int target_dfd = -1;
+  if (!glnx_opendirat (dfd, relpath, FALSE, &target_dfd, error))
+    return FALSE;
+
+  g_autoptr (GFileInfo) info
+      = g_file_query_info (target, OSTREE_GIO_FAST_QUERYINFO,
+                           G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, cancellable, error);
+  if (info == NULL)
+    return FALSE;
+
+  g_autoptr (GVariant) new_xattrs = NULL;
+  if (!ostree_repo_file_get_xattrs ((OstreeRepoFile *)target, &new_xattrs, cancellable, error))
+    return FALSE;
+
+  g_autoptr (GVariant) old_xattrs = NULL;
+  if (!glnx_fd_get_all_xattrs (target_dfd, &old_xattrs, cancellable, error))
+    return FALSE;
+  const gsize n_old = g_variant_n_children (old_xattrs);
+  const gsize n_new = new_xattrs != NULL ? g_variant_n_children (new_xattrs) : 0;
+  for (gsize i = 0; i < n_old; i++)
+    {
+      const guint8 *name;
+      g_variant_get_child (old_xattrs, i, "(^&ay@ay)", &name, NULL);
+
+      gboolean found = FALSE;
+      for (gsize j = 0; j < n_new && !found; j++)
+        {
+          const guint8 *new_name;
+          g_variant_get_child (new_xattrs, j, "(^&ay@ay)", &new_name, NULL);
+          found = g_str_equal ((const char *)name, (const char *)new_name);
+        }
+      if (!found && fremovexattr (target_dfd, (const char *)name) < 0)
+        return glnx_throw_errno_prefix (error, "fremovexattr(%s)", (const char *)name);
+    }
+  if (new_xattrs != NULL && !glnx_fd_set_all_xattrs (target_dfd, new_xattrs, cancellable, error))
+    return FALSE;
+
+  const guint32 uid = g_file_info_get_attribute_uint32 (info, "unix::uid");
+  const guint32 gid = g_file_info_get_attribute_uint32 (info, "unix::gid");
+  const guint32 mode = g_file_info_get_attribute_uint32 (info, "unix::mode");
+  if (fchown (target_dfd, uid, gid) < 0)
+    return glnx_throw_errno_prefix (error, "fchown(%s)", relpath);
+  if (fchmod (target_dfd, mode & 07777) < 0)
+    return glnx_throw_errno_prefix (error, "fchmod(%s)", relpath);
+
+  return TRUE;
+}
+
+/* Check out the single path @relpath from commit @csum into the cloned
+ * deployment.  When @is_dir the whole subtree is checked out (used for type
+ * changes, where the diff doesn't enumerate children).
+ */
+static gboolean
+fast_rollback_checkout_path (OstreeRepo *repo, int deployment_dfd, const char *relpath,
+                             const char *csum, gboolean is_dir, GCancellable *cancellable,
+                             GError **error)
+{
+  g_autofree char *dn = g_path_get_dirname (relpath);
+  g_autofree char *bn = g_path_get_basename (relpath);
+  glnx_autofd int parent_dfd = -1;
+  if (!glnx_opendirat (deployment_dfd, dn, TRUE, &parent_dfd, error))
+    return FALSE;
+
+  g_autofree char *subpath = g_strconcat ("/", relpath, NULL);
+  OstreeRepoCheckoutAtOptions checkout_opts = { .subpath = subpath,
+                                                .process_passthrough_whiteouts = TRUE,
+                                                .enable_reflink = TRUE };
+  /* For a non-directory, "." skips the compat mkdir and the file keeps its
+   * basename from the tree. */
+  return ostree_repo_checkout_at (repo, &checkout_opts, parent_dfd, is_dir ? bn : ".", csum,
+                                  cancellable, error);
+}
+
+/* Whiteout markers are rewritten to their target names at checkout time (see
+ * process_passthrough_whiteouts), so diff entries naming them don't match
+ * what's on disk in the cloned checkout. */
+static gboolean
+fast_rollback_name_is_whiteout (const char *name)
+{
+  return g_str_has_prefix (name, ".wh.") || g_str_has_prefix (name, ".ostree-wh.");
+}
+
+/* The fast-rollback deployment path: instead of checking out the full target
+ * tree, hardlink-clone the base (merge) deployment's existing checkout and
+ * then apply only the file-level diff between the two commits, so deploy time
+ * scales with the size of the change rather than the size of the tree.  The
+ * result is byte-identical to a regular checkout; on any failure the caller
+ * discards the partial clone and falls back to the full checkout.
+ */
+static gboolean
+fast_rollback_checkout_tree (OstreeSysroot *sysroot, OstreeRepo *repo,
+                             OstreeDeployment *base_deployment, const char *csum,
+                             int osdeploy_dfd, const char *checkout_target_name,
+                             GCancellable *cancellable, GError **error)
+{
+  /* Re-deploying the base's own tree (the classic rollback) yields an empty
+   * diff, making this effectively just the hardlink clone. */
+  const char *base_csum = ostree_deployment_get_csum (base_deployment);
+
+  g_autoptr (GFile) base_root = NULL;
+  if (!ostree_repo_read_commit (repo, base_csum, &base_root, NULL, cancellable, error))
+    return FALSE;
+  g_autoptr (GFile) target_root = NULL;
+  if (!ostree_repo_read_commit (repo, csum, &target_root, NULL, cancellable, error))
+    return FALSE;
+
+  /* The clone skips the base deployment's merged /etc on the assumption that
+   * neither pristine tree carries a real /etc (it was moved to /usr/etc at
+   * commit time); bail out for trees predating that convention.
+   */
+  g_autoptr (GFile) base_etc = g_file_get_child (base_root, "etc");
+  g_autoptr (GFile) target_etc = g_file_get_child (target_root, "etc");
+  if (g_file_query_exists (base_etc, cancellable) || g_file_query_exists (target_etc, cancellable))
+    return glnx_throw (error, "Tree carries /etc");
+
+  g_autoptr (GPtrArray) modified
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_diff_item_unref);
+  g_autoptr (GPtrArray) removed = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr (GPtrArray) added = g_ptr_array_new_with_free_func (g_object_unref);
+  if (!ostree_diff_dirs (OSTREE_DIFF_FLAGS_NONE, base_root, target_root, modified, removed, added,
+                         cancellable, error))
+    return FALSE;
+
+  for (guint i = 0; i < removed->len; i++)
+    {
+      g_autofree char *bn = g_file_get_basename (removed->pdata[i]);
+      if (fast_rollback_name_is_whiteout (bn))
+        return glnx_throw (error, "Diff touches whiteout %s", bn);
+    }
+  for (guint i = 0; i < added->len; i++)
+    {
+      g_autofree char *bn = g_file_get_basename (added->pdata[i]);
+      if (fast_rollback_name_is_whiteout (bn))
+        return glnx_throw (error, "Diff touches whiteout %s", bn);
+    }
+  for (guint i = 0; i < modified->len; i++)
+    {
+      OstreeDiffItem *item = modified->pdata[i];
+      g_autofree char *bn = g_file_get_basename (item->target);
+      if (fast_rollback_name_is_whiteout (bn))
+        return glnx_throw (error, "Diff touches whiteout %s", bn);
+    }
+
+  g_autofree char *base_path = ostree_sysroot_get_deployment_dirpath (sysroot, base_deployment);
+  glnx_autofd int base_dfd = -1;
+  if (!glnx_opendirat (sysroot->sysroot_fd, base_path, TRUE, &base_dfd, error))
+    return FALSE;
+
+  if (mkdirat (osdeploy_dfd, checkout_target_name, 0700) < 0)
+    return glnx_throw_errno_prefix (error, "mkdirat(%s)", checkout_target_name);
+  glnx_autofd int deployment_dfd = -1;
+  if (!glnx_opendirat (osdeploy_dfd, checkout_target_name, TRUE, &deployment_dfd, error))
+    return FALSE;
+
+  if (!fast_rollback_clone_at (base_dfd, deployment_dfd, TRUE, cancellable, error))
+    return FALSE;
+  /* The roots themselves aren't compared by the diff */
+  if (!fast_rollback_apply_dir_meta (target_root, deployment_dfd, ".", cancellable, error))
+    return FALSE;
+
+  for (guint i = 0; i < removed->len; i++)
+    {
+      g_autofree char *relpath = g_file_get_relative_path (base_root, removed->pdata[i]);
+      g_assert (relpath != NULL);
+      if (!glnx_shutil_rm_rf_at (deployment_dfd, relpath, cancellable, error))
+        return FALSE;
+    }
+
+  for (guint i = 0; i < modified->len; i++)
+    {
+      OstreeDiffItem *item = modified->pdata[i];
+      g_autofree char *relpath = g_file_get_relative_path (target_root, item->target);
+      g_assert (relpath != NULL);
+      const GFileType src_type = g_file_info_get_file_type (item->src_info);
+      const GFileType target_type = g_file_info_get_file_type (item->target_info);
+
+      if (src_type == G_FILE_TYPE_DIRECTORY && target_type == G_FILE_TYPE_DIRECTORY)
+        {
+          /* Content changes below this directory show up as their own diff
+           * entries; only its metadata changed. */
+          if (!fast_rollback_apply_dir_meta (item->target, deployment_dfd, relpath, cancellable,
+                                             error))
+            return FALSE;
+        }
+      else
+        {
+          if (!glnx_shutil_rm_rf_at (deployment_dfd, relpath, cancellable, error))
+            return FALSE;
+          if (!fast_rollback_checkout_path (repo, deployment_dfd, relpath, csum,
+                                            target_type == G_FILE_TYPE_DIRECTORY, cancellable,
+                                            error))
+            return FALSE;
+        }
+    }
+
+  for (guint i = 0; i < added->len; i++)
+    {
+      GFile *f = added->pdata[i];
+      g_autofree char *relpath = g_file_get_relative_path (target_root, f);
+      g_assert (relpath != NULL);
+      g_autoptr (GFileInfo) info
+          = g_file_query_info (f, OSTREE_GIO_FAST_QUERYINFO,
+                               G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, cancellable, error);
+      if (info == NULL)
+        return FALSE;
+      if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+          /* The diff enumerates an added directory's children individually;
+           * just create the directory itself here. */
+          if (mkdirat (deployment_dfd, relpath, 0700) < 0)
+            return glnx_throw_errno_prefix (error, "mkdirat(%s)", relpath);
+          if (!fast_rollback_apply_dir_meta (f, deployment_dfd, relpath, cancellable, error))
+            return FALSE;
+        }
+      else
+        {
+          if (!fast_rollback_checkout_path (repo, deployment_dfd, relpath, csum, FALSE,
+                                            cancellable, error))
+            return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
 /* Look up @revision in the repository, and check it out in
  * /ostree/deploy/OS/deploy/${treecsum}.${deployserial}.
  * A dfd for the result is returned in @out_deployment_dfd.
+ *
+ * On the cost of the hardlink farm: it has been proposed to instead express a
+ * new deployment as an overlayfs layer over the previous checkout, with an
+ * upper dir holding just the diff, so that deploy time scales with the delta
+ * rather than the tree.  That doesn't fit the current deployment model:
+ * deployment directories must be directly readable while unmounted (sysroot
+ * scanning, kernel/initramfs extraction and bootloader updates all read them
+ * without any mount), everything from merge_configuration() onward would need
+ * the overlay mounted (and hence privileges we don't otherwise require), and
+ * pruning the lower deployment would corrupt the layered one.  Deployments
+ * that share a tree already share all file content via hardlinks; for scaling
+ * past the per-inode cost, composefs (below) is the supported direction since
+ * it replaces the link farm with a single cacheable image.
  */
 static gboolean
 checkout_deployment_tree (OstreeSysroot *sysroot, OstreeRepo *repo, OstreeDeployment *deployment,
-                          const char *revision, int *out_deployment_dfd, GCancellable *cancellable,
-                          GError **error)
+                          const char *revision, OstreeDeployment *merge_deployment,
+                          OstreeSysrootDeployTreeOpts *opts, int *out_deployment_dfd,
+                          GCancellable *cancellable, GError **error)
 {
   GLNX_AUTO_PREFIX_ERROR ("Checking out deployment tree", error);
   /* Find the directory with deployments for this stateroot */
@@ -694,19 +1091,48 @@ checkout_deployment_tree (OstreeSysroot *sysroot, OstreeRepo *repo, OstreeDeploy
   if (!glnx_shutil_rm_rf_at (osdeploy_dfd, checkout_target_name, cancellable, error))
     return FALSE;
 
-  /* Generate hardlink farm, then opendir it */
-  OstreeRepoCheckoutAtOptions checkout_opts = { .process_passthrough_whiteouts = TRUE };
-  if (!ostree_repo_checkout_at (repo, &checkout_opts, osdeploy_dfd, checkout_target_name, csum,
-                                cancellable, error))
+  /* Opt-in fast path: clone the merge deployment's checkout and apply the
+   * commit-level diff instead of walking the whole target tree.  Any failure
+   * there (including layouts the clone doesn't handle) just falls back to
+   * the full checkout below.
+   */
+  gboolean cloned = FALSE;
+  if (opts != NULL && opts->enable_fast_rollback && merge_deployment != NULL)
+    {
+      g_autoptr (GError) local_error = NULL;
+      if (fast_rollback_checkout_tree (sysroot, repo, merge_deployment, csum, osdeploy_dfd,
+                                       checkout_target_name, cancellable, &local_error))
+        cloned = TRUE;
+      else
+        {
+          if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            {
+              g_propagate_error (error, g_steal_pointer (&local_error));
+              return FALSE;
+            }
+          g_debug ("Fast-rollback checkout of %s from %s failed, falling back: %s", csum,
+                   ostree_deployment_get_csum (merge_deployment), local_error->message);
+          if (!glnx_shutil_rm_rf_at (osdeploy_dfd, checkout_target_name, cancellable, error))
+            return FALSE;
+        }
+    }
+
+  /* Generate hardlink farm, then opendir it.  Hardlinked content is never
+   * rewritten; enabling reflink additionally makes the copy fallback (e.g.
+   * a bare-user repo) metadata-only on capable filesystems, so upgrade
+   * bytes hit the disk once, at delta apply time.
+   */
+  OstreeRepoCheckoutAtOptions checkout_opts
+      = { .process_passthrough_whiteouts = TRUE, .enable_reflink = TRUE };
+  if (!cloned
+      && !ostree_repo_checkout_at (repo, &checkout_opts, osdeploy_dfd, checkout_target_name, csum,
+                                   cancellable, error))
     return FALSE;
 
 #ifdef HAVE_COMPOSEFS
   if (repo->composefs_wanted != OT_TRISTATE_NO)
     {
       g_autofree guchar *fsverity_digest = NULL;
-      g_auto (GLnxTmpfile) tmpf = {
-        0,
-      };
       g_autoptr (GVariant) commit_variant = NULL;
 
       if (!ostree_repo_load_commit (repo, revision, &commit_variant, NULL, error))
@@ -716,40 +1142,73 @@ checkout_deployment_tree (OstreeSysroot *sysroot, OstreeRepo *repo, OstreeDeploy
       g_autoptr (GVariant) metadata_composefs = g_variant_lookup_value (
           metadata, OSTREE_COMPOSEFS_DIGEST_KEY_V0, G_VARIANT_TYPE_BYTESTRING);
 
-      /* Create a composefs image and put in deploy dir as .ostree.cfs */
-      g_autoptr (OstreeComposefsTarget) target = ostree_composefs_target_new ();
-
-      g_autoptr (GFile) commit_root = NULL;
-      if (!ostree_repo_read_commit (repo, csum, &commit_root, NULL, cancellable, error))
-        return FALSE;
-
-      if (!ostree_repo_checkout_composefs (repo, target, (OstreeRepoFile *)commit_root, cancellable,
-                                           error))
-        return FALSE;
+      const guchar *expected_digest = NULL;
+      if (metadata_composefs != NULL
+          && g_variant_n_children (metadata_composefs) == OSTREE_SHA256_DIGEST_LEN)
+        expected_digest = g_variant_get_data (metadata_composefs);
 
       g_autofree char *composefs_cfs_path
           = g_strdup_printf ("%s/.ostree.cfs", checkout_target_name);
 
-      if (!glnx_open_tmpfile_linkable_at (osdeploy_dfd, checkout_target_name, O_WRONLY | O_CLOEXEC,
-                                          &tmpf, error))
+      /* Generating the erofs image is the expensive part of the deploy; reuse
+       * a previously generated one for this commit if the repo has it cached. */
+      gboolean cached_image_found = FALSE;
+      if (!_ostree_repo_composefs_cache_linkat (repo, csum, expected_digest, osdeploy_dfd,
+                                                composefs_cfs_path, &cached_image_found,
+                                                &fsverity_digest, cancellable, error))
         return FALSE;
 
-      if (!ostree_composefs_target_write (target, tmpf.fd, &fsverity_digest, cancellable, error))
-        return FALSE;
+      if (cached_image_found)
+        {
+          /* Covers the case where the digest in the commit metadata has an
+           * unexpected size; matching entries were checked during lookup. */
+          if (!compare_verity_digests (metadata_composefs, fsverity_digest, error))
+            return FALSE;
+        }
+      else
+        {
+          g_auto (GLnxTmpfile) tmpf = {
+            0,
+          };
 
-      /* If the commit specified a composefs digest, verify it */
-      if (!compare_verity_digests (metadata_composefs, fsverity_digest, error))
-        return FALSE;
+          /* Create a composefs image and put in deploy dir as .ostree.cfs */
+          g_autoptr (OstreeComposefsTarget) target = ostree_composefs_target_new ();
 
-      if (!glnx_fchmod (tmpf.fd, 0644, error))
-        return FALSE;
+          g_autoptr (GFile) commit_root = NULL;
+          if (!ostree_repo_read_commit (repo, csum, &commit_root, NULL, cancellable, error))
+            return FALSE;
 
-      if (!_ostree_tmpf_fsverity (repo, &tmpf, NULL, error))
-        return FALSE;
+          if (!ostree_repo_checkout_composefs (repo, target, (OstreeRepoFile *)commit_root,
+                                               cancellable, error))
+            return FALSE;
 
-      if (!glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, osdeploy_dfd, composefs_cfs_path,
-                                 error))
-        return FALSE;
+          if (!glnx_open_tmpfile_linkable_at (osdeploy_dfd, checkout_target_name,
+                                              O_WRONLY | O_CLOEXEC, &tmpf, error))
+            return FALSE;
+
+          if (!ostree_composefs_target_write (target, tmpf.fd, &fsverity_digest, cancellable,
+                                              error))
+            return FALSE;
+
+          /* If the commit specified a composefs digest, verify it */
+          if (!compare_verity_digests (metadata_composefs, fsverity_digest, error))
+            return FALSE;
+
+          if (!glnx_fchmod (tmpf.fd, 0644, error))
+            return FALSE;
+
+          if (!_ostree_tmpf_fsverity (repo, &tmpf, NULL, error))
+            return FALSE;
+
+          if (!glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_REPLACE, osdeploy_dfd,
+                                     composefs_cfs_path, error))
+            return FALSE;
+
+          /* Best-effort; a second hardlink into the repo cache so the next
+           * deployment of this commit can skip regeneration */
+          _ostree_repo_composefs_cache_store (repo, csum, fsverity_digest, osdeploy_dfd,
+                                              composefs_cfs_path, cancellable);
+        }
 
       /* This is where the erofs image will be temporarily mounted */
       g_autofree char *composefs_mnt_path
@@ -787,6 +1246,124 @@ ptrarray_path_join (GPtrArray *path)
   return g_string_free (path_buf, FALSE);
 }
 
+/* Work queue for the /var relabel, mirroring the parallel checkout
+ * workers: top-level subdirectories are dispatched onto a thread pool and
+ * each job relabels its own subtree, so workers never touch a shared
+ * directory.  selabel_lookup() against the shared compiled policy db is
+ * thread-safe.
+ */
+typedef struct
+{
+  OstreeSysroot *sysroot;   /* unowned */
+  OstreeSePolicy *sepolicy; /* unowned */
+  OtThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  guint outstanding;
+  GError *caught_error; /* first worker error wins */
+  GCancellable *cancellable;
+} RelabelWorkQueue;
+
+typedef struct
+{
+  RelabelWorkQueue *queue;
+  GFile *dir;
+  GFileInfo *dir_info;
+  char **path_parts; /* owned snapshot of the policy lookup path */
+} RelabelWorkItem;
+
+static gboolean relabel_recursively (OstreeSysroot *sysroot, OstreeSePolicy *sepolicy,
+                                     RelabelWorkQueue *queue, GFile *dir, GFileInfo *dir_info,
+                                     GPtrArray *path_parts, GCancellable *cancellable,
+                                     GError **error);
+
+static void
+relabel_queue_worker (gpointer data, gpointer user_data)
+{
+  RelabelWorkItem *item = data;
+  RelabelWorkQueue *queue = item->queue;
+  g_autoptr (GError) local_error = NULL;
+
+  /* Don't bother starting new subtrees once something failed */
+  g_mutex_lock (&queue->lock);
+  const gboolean had_error = queue->caught_error != NULL;
+  g_mutex_unlock (&queue->lock);
+
+  if (!had_error)
+    {
+      g_autoptr (GPtrArray) path_parts = g_ptr_array_new ();
+      for (char **it = item->path_parts; *it; it++)
+        g_ptr_array_add (path_parts, *it);
+      /* queue is deliberately NULL so workers recurse serially */
+      (void)relabel_recursively (queue->sysroot, queue->sepolicy, NULL, item->dir, item->dir_info,
+                                 path_parts, queue->cancellable, &local_error);
+    }
+
+  g_mutex_lock (&queue->lock);
+  if (local_error != NULL && queue->caught_error == NULL)
+    queue->caught_error = g_steal_pointer (&local_error);
+  g_assert_cmpuint (queue->outstanding, >, 0);
+  queue->outstanding--;
+  g_cond_signal (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+
+  g_object_unref (item->dir);
+  g_object_unref (item->dir_info);
+  g_strfreev (item->path_parts);
+  g_free (item);
+}
+
+static void
+relabel_queue_push (RelabelWorkQueue *queue, GFile *dir, GFileInfo *dir_info,
+                    GPtrArray *path_parts)
+{
+  RelabelWorkItem *item = g_new0 (RelabelWorkItem, 1);
+  item->queue = queue;
+  item->dir = g_object_ref (dir);
+  item->dir_info = g_object_ref (dir_info);
+  item->path_parts = g_new0 (char *, path_parts->len + 1);
+  for (guint i = 0; i < path_parts->len; i++)
+    item->path_parts[i] = g_strdup (path_parts->pdata[i]);
+
+  g_mutex_lock (&queue->lock);
+  queue->outstanding++;
+  g_mutex_unlock (&queue->lock);
+  ot_thread_pool_push (queue->pool, item);
+}
+
+/* Wait for all dispatched subtrees to complete, and propagate the first
+ * error any worker hit.
+ */
+static gboolean
+relabel_queue_drain (RelabelWorkQueue *queue, GError **error)
+{
+  g_mutex_lock (&queue->lock);
+  while (queue->outstanding > 0)
+    g_cond_wait (&queue->cond, &queue->lock);
+  g_autoptr (GError) caught_error = g_steal_pointer (&queue->caught_error);
+  g_mutex_unlock (&queue->lock);
+
+  if (caught_error)
+    {
+      g_propagate_error (error, g_steal_pointer (&caught_error));
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+relabel_queue_free (RelabelWorkQueue *queue)
+{
+  if (queue == NULL)
+    return;
+  (void)relabel_queue_drain (queue, NULL);
+  ot_thread_pool_free (queue->pool);
+  g_cond_clear (&queue->cond);
+  g_mutex_clear (&queue->lock);
+  g_free (queue);
+}
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RelabelWorkQueue, relabel_queue_free)
+
 static gboolean
 relabel_one_path (OstreeSysroot *sysroot, OstreeSePolicy *sepolicy, GFile *path, GFileInfo *info,
                   GPtrArray *path_parts, GCancellable *cancellable, GError **error)
@@ -806,9 +1383,9 @@ out:
 }
 
 static gboolean
-relabel_recursively (OstreeSysroot *sysroot, OstreeSePolicy *sepolicy, GFile *dir,
-                     GFileInfo *dir_info, GPtrArray *path_parts, GCancellable *cancellable,
-                     GError **error)
+relabel_recursively (OstreeSysroot *sysroot, OstreeSePolicy *sepolicy, RelabelWorkQueue *queue,
+                     GFile *dir, GFileInfo *dir_info, GPtrArray *path_parts,
+                     GCancellable *cancellable, GError **error)
 {
   gboolean ret = FALSE;
   g_autoptr (GFileEnumerator) direnum = NULL;
@@ -837,8 +1414,10 @@ relabel_recursively (OstreeSysroot *sysroot, OstreeSePolicy *sepolicy, GFile *di
       ftype = g_file_info_get_file_type (file_info);
       if (ftype == G_FILE_TYPE_DIRECTORY)
         {
-          if (!relabel_recursively (sysroot, sepolicy, child, file_info, path_parts, cancellable,
-                                    error))
+          if (queue != NULL)
+            relabel_queue_push (queue, child, file_info, path_parts);
+          else if (!relabel_recursively (sysroot, sepolicy, NULL, child, file_info, path_parts,
+                                         cancellable, error))
             goto out;
         }
       else
@@ -866,9 +1445,29 @@ selinux_relabel_dir (OstreeSysroot *sysroot, OstreeSePolicy *sepolicy, GFile *di
   if (!root_info)
     return FALSE;
 
+  /* Dispatch the top-level subdirectories onto worker threads; the bulk
+   * of a populated /var is a handful of large subtrees (lib, cache, log).
+   */
+  g_autoptr (RelabelWorkQueue) queue = NULL;
+  const guint n_threads = g_get_num_processors ();
+  if (n_threads > 1)
+    {
+      queue = g_new0 (RelabelWorkQueue, 1);
+      queue->sysroot = sysroot;
+      queue->sepolicy = sepolicy;
+      queue->cancellable = cancellable;
+      g_mutex_init (&queue->lock);
+      g_cond_init (&queue->cond);
+      queue->pool = ot_thread_pool_new ("relabel", relabel_queue_worker, NULL, n_threads);
+    }
+
   g_autoptr (GPtrArray) path_parts = g_ptr_array_new ();
   g_ptr_array_add (path_parts, (char *)prefix);
-  if (!relabel_recursively (sysroot, sepolicy, dir, root_info, path_parts, cancellable, error))
+  if (!relabel_recursively (sysroot, sepolicy, queue, dir, root_info, path_parts, cancellable,
+                            error))
+    return glnx_prefix_error (error, "Relabeling /%s", prefix);
+
+  if (queue != NULL && !relabel_queue_drain (queue, error))
     return glnx_prefix_error (error, "Relabeling /%s", prefix);
 
   return TRUE;
@@ -956,8 +1555,16 @@ prepare_deployment_etc (OstreeSysroot *sysroot, OstreeRepo *repo, OstreeDeployme
       /* We need copies of /etc from /usr/etc (so admins can use vi), and if
        * SELinux is enabled, we need to relabel.
        */
+      /* Parallelize the copy; with SELinux enabled, computing labels
+       * dominates this checkout, and the label lookups spread across the
+       * checkout worker threads.
+       */
       OstreeRepoCheckoutAtOptions etc_co_opts
-          = { .force_copy = TRUE, .subpath = "/usr/etc", .sepolicy_prefix = "/etc" };
+          = { .force_copy = TRUE,
+              .enable_reflink = TRUE,
+              .subpath = "/usr/etc",
+              .sepolicy_prefix = "/etc",
+              .checkout_threads = g_get_num_processors () };
 
       /* Here, we initialize SELinux policy from the /usr/etc inside
        * the root - this is before we've finalized the configuration
@@ -1098,8 +1705,8 @@ _ostree_kernel_layout_new (void)
 /* See get_kernel_from_tree() below */
 static gboolean
 get_kernel_from_tree_usrlib_modules (OstreeSysroot *sysroot, int deployment_dfd,
-                                     OstreeKernelLayout **out_layout, GCancellable *cancellable,
-                                     GError **error)
+                                     const char *known_bootcsum, OstreeKernelLayout **out_layout,
+                                     GCancellable *cancellable, GError **error)
 {
   g_autofree char *kver = NULL;
   /* Look in usr/lib/modules */
@@ -1166,20 +1773,28 @@ get_kernel_from_tree_usrlib_modules (OstreeSysroot *sysroot, int deployment_dfd,
       return TRUE;
     }
 
-  /* We found a module directory, compute the checksum */
+  /* We found a module directory; compute the checksum, unless the caller
+   * already knows it (e.g. finalizing a staged deployment whose bootcsum was
+   * computed when it was staged; the sealed deployment can't have changed).
+   */
+  const gboolean skip_checksum = (known_bootcsum != NULL);
   g_auto (OtChecksum) checksum = {
     0,
   };
   ot_checksum_init (&checksum);
   glnx_autofd int fd = -1;
-  /* Checksum the kernel */
-  if (!glnx_openat_rdonly (ret_layout->boot_dfd, "vmlinuz", TRUE, &fd, error))
-    return FALSE;
-  g_autoptr (GInputStream) in = g_unix_input_stream_new (fd, FALSE);
-  if (!ot_gio_splice_update_checksum (NULL, in, &checksum, cancellable, error))
-    return FALSE;
-  g_clear_object (&in);
-  glnx_close_fd (&fd);
+  g_autoptr (GInputStream) in = NULL;
+  if (!skip_checksum)
+    {
+      /* Checksum the kernel */
+      if (!glnx_openat_rdonly (ret_layout->boot_dfd, "vmlinuz", TRUE, &fd, error))
+        return FALSE;
+      in = g_unix_input_stream_new (fd, FALSE);
+      if (!ot_gio_splice_update_checksum (NULL, in, &checksum, cancellable, error))
+        return FALSE;
+      g_clear_object (&in);
+      glnx_close_fd (&fd);
+    }
 
   /* Look for an initramfs, but it's optional; since there wasn't any precedent
    * for this, let's be a bit conservative and support both `initramfs.img` and
@@ -1202,9 +1817,12 @@ get_kernel_from_tree_usrlib_modules (OstreeSysroot *sysroot, int deployment_dfd,
       g_assert (initramfs_path);
       ret_layout->initramfs_srcpath = g_strdup (initramfs_path);
       ret_layout->initramfs_namever = g_strdup_printf ("initramfs-%s.img", kver);
-      in = g_unix_input_stream_new (fd, FALSE);
-      if (!ot_gio_splice_update_checksum (NULL, in, &checksum, cancellable, error))
-        return FALSE;
+      if (!skip_checksum)
+        {
+          in = g_unix_input_stream_new (fd, FALSE);
+          if (!ot_gio_splice_update_checksum (NULL, in, &checksum, cancellable, error))
+            return FALSE;
+        }
     }
   g_clear_object (&in);
   glnx_close_fd (&fd);
@@ -1237,9 +1855,12 @@ get_kernel_from_tree_usrlib_modules (OstreeSysroot *sysroot, int deployment_dfd,
         {
           ret_layout->devicetree_srcpath = g_strdup ("devicetree");
           ret_layout->devicetree_namever = g_strdup_printf ("devicetree-%s", kver);
-          in = g_unix_input_stream_new (fd, FALSE);
-          if (!ot_gio_splice_update_checksum (NULL, in, &checksum, cancellable, error))
-            return FALSE;
+          if (!skip_checksum)
+            {
+              in = g_unix_input_stream_new (fd, FALSE);
+              if (!ot_gio_splice_update_checksum (NULL, in, &checksum, cancellable, error))
+                return FALSE;
+            }
         }
       else
         {
@@ -1254,8 +1875,9 @@ get_kernel_from_tree_usrlib_modules (OstreeSysroot *sysroot, int deployment_dfd,
               ret_layout->devicetree_srcpath = g_strdup ("dtb");
               ret_layout->devicetree_namever = NULL;
 
-              if (!checksum_dir_recurse (ret_layout->boot_dfd, "dtb", &checksum, cancellable,
-                                         error))
+              if (!skip_checksum
+                  && !checksum_dir_recurse (ret_layout->boot_dfd, "dtb", &checksum, cancellable,
+                                            error))
                 return FALSE;
             }
         }
@@ -1284,9 +1906,14 @@ get_kernel_from_tree_usrlib_modules (OstreeSysroot *sysroot, int deployment_dfd,
       ret_layout->kernel_hmac_namever = g_strdup_printf (".%s.hmac", ret_layout->kernel_namever);
     }
 
-  char hexdigest[OSTREE_SHA256_STRING_LEN + 1];
-  ot_checksum_get_hexdigest (&checksum, hexdigest, sizeof (hexdigest));
-  ret_layout->bootcsum = g_strdup (hexdigest);
+  if (skip_checksum)
+    ret_layout->bootcsum = g_strdup (known_bootcsum);
+  else
+    {
+      char hexdigest[OSTREE_SHA256_STRING_LEN + 1];
+      ot_checksum_get_hexdigest (&checksum, hexdigest, sizeof (hexdigest));
+      ret_layout->bootcsum = g_strdup (hexdigest);
+    }
 
   *out_layout = g_steal_pointer (&ret_layout);
   return TRUE;
@@ -1437,16 +2064,21 @@ get_kernel_from_tree_legacy_layouts (int deployment_dfd, OstreeKernelLayout **ou
  * we prefer that now. However, the default Fedora layout doesn't put the
  * initramfs there, so we need to look in /usr/lib/ostree-boot first.
  */
+/* @known_bootcsum may be the already-computed boot checksum of the tree (as
+ * recorded on the deployment when it was first deployed or staged); passing it
+ * skips re-hashing the kernel/initramfs/devicetree, which is the expensive
+ * part of this function.  Pass %NULL to compute the checksum from scratch.
+ */
 static gboolean
-get_kernel_from_tree (OstreeSysroot *sysroot, int deployment_dfd, OstreeKernelLayout **out_layout,
-                      GCancellable *cancellable, GError **error)
+get_kernel_from_tree (OstreeSysroot *sysroot, int deployment_dfd, const char *known_bootcsum,
+                      OstreeKernelLayout **out_layout, GCancellable *cancellable, GError **error)
 {
   g_autoptr (OstreeKernelLayout) usrlib_modules_layout = NULL;
   g_autoptr (OstreeKernelLayout) legacy_layout = NULL;
 
   /* First, gather from usr/lib/modules/$kver if it exists */
-  if (!get_kernel_from_tree_usrlib_modules (sysroot, deployment_dfd, &usrlib_modules_layout,
-                                            cancellable, error))
+  if (!get_kernel_from_tree_usrlib_modules (sysroot, deployment_dfd, known_bootcsum,
+                                            &usrlib_modules_layout, cancellable, error))
     return FALSE;
 
   /* Gather the legacy layout */
@@ -1934,9 +2566,14 @@ install_deployment_kernel (OstreeSysroot *sysroot, int new_bootversion,
   if (!sepolicy)
     return FALSE;
 
-  /* Find the kernel/initramfs/devicetree in the tree */
+  /* Find the kernel/initramfs/devicetree in the tree, reusing the bootcsum
+   * computed when the deployment was first deployed or staged rather than
+   * re-hashing the kernel; this matters for staged-deployment finalization,
+   * which runs during shutdown.
+   */
   g_autoptr (OstreeKernelLayout) kernel_layout = NULL;
-  if (!get_kernel_from_tree (sysroot, deployment_dfd, &kernel_layout, cancellable, error))
+  if (!get_kernel_from_tree (sysroot, deployment_dfd, ostree_deployment_get_bootcsum (deployment),
+                             &kernel_layout, cancellable, error))
     return FALSE;
 
   if (!_ostree_sysroot_ensure_boot_fd (sysroot, error))
@@ -2634,8 +3271,10 @@ get_kernel_layout_size (OstreeSysroot *self, OstreeDeployment *deployment, guint
   if (!glnx_opendirat (self->sysroot_fd, deployment_dirpath, FALSE, &deployment_dfd, error))
     return FALSE;
 
+  /* Only the file layout matters for sizing; skip the checksum work. */
   g_autoptr (OstreeKernelLayout) kernel_layout = NULL;
-  if (!get_kernel_from_tree (self, deployment_dfd, &kernel_layout, cancellable, error))
+  if (!get_kernel_from_tree (self, deployment_dfd, ostree_deployment_get_bootcsum (deployment),
+                             &kernel_layout, cancellable, error))
     return FALSE;
 
   guint64 bootdir_size = 0;
@@ -3210,12 +3849,50 @@ lint_deployment_fs (OstreeSysroot *self, OstreeDeployment *deployment, int deplo
   return TRUE;
 }
 
+static gpointer
+sysroot_early_sync_in_thread (gpointer data)
+{
+  glnx_autofd int fd = GPOINTER_TO_INT (data);
+  guint64 start_msec = g_get_monotonic_time () / 1000;
+  if (syncfs (fd) != 0)
+    ot_journal_print (LOG_INFO, "Early sync: syncfs failed: %s", g_strerror (errno));
+  else
+    ot_journal_print (LOG_INFO, "Early sync completed in %" G_GUINT64_FORMAT " msec",
+                      (g_get_monotonic_time () / 1000) - start_msec);
+  return NULL;
+}
+
+/* If opted in, eagerly start writeback of a freshly checked-out deployment on
+ * a background thread, rather than leaving gigabytes of dirty pages for the
+ * blocking syncfs() barrier at finalize time.  The data written is identical;
+ * this only moves the wait earlier and overlaps it with the remaining
+ * deployment work.  Fire-and-forget: the barrier in full_system_sync() is
+ * still what provides the ordering guarantee before bootloader updates.
+ */
+static void
+maybe_start_early_sync (OstreeSysroot *self, int deployment_dfd)
+{
+  if (!(self->opt_flags & OSTREE_SYSROOT_GLOBAL_OPT_EARLY_SYNC))
+    return;
+
+  int fd = fcntl (deployment_dfd, F_DUPFD_CLOEXEC, 3);
+  if (fd < 0)
+    {
+      ot_journal_print (LOG_INFO, "Early sync: dup failed: %s", g_strerror (errno));
+      return;
+    }
+  GThread *worker
+      = g_thread_new ("ostree early-sync", sysroot_early_sync_in_thread, GINT_TO_POINTER (fd));
+  g_thread_unref (worker);
+}
+
 /* The first part of writing a deployment. This primarily means doing the
  * hardlink farm checkout, but we also compute some initial state.
  */
 static gboolean
 sysroot_initialize_deployment (OstreeSysroot *self, const char *osname, const char *revision,
-                               GKeyFile *origin, OstreeSysrootDeployTreeOpts *opts,
+                               GKeyFile *origin, OstreeDeployment *merge_deployment,
+                               OstreeSysrootDeployTreeOpts *opts,
                                OstreeDeployment **out_new_deployment, GCancellable *cancellable,
                                GError **error)
 {
@@ -3236,12 +3913,12 @@ sysroot_initialize_deployment (OstreeSysroot *self, const char *osname, const ch
 
   /* Check out the userspace tree onto the filesystem */
   glnx_autofd int deployment_dfd = -1;
-  if (!checkout_deployment_tree (self, repo, new_deployment, revision, &deployment_dfd, cancellable,
-                                 error))
+  if (!checkout_deployment_tree (self, repo, new_deployment, revision, merge_deployment, opts,
+                                 &deployment_dfd, cancellable, error))
     return FALSE;
 
   g_autoptr (OstreeKernelLayout) kernel_layout = NULL;
-  if (!get_kernel_from_tree (self, deployment_dfd, &kernel_layout, cancellable, error))
+  if (!get_kernel_from_tree (self, deployment_dfd, NULL, &kernel_layout, cancellable, error))
     return FALSE;
 
   _ostree_deployment_set_bootcsum (new_deployment, kernel_layout->bootcsum);
@@ -3255,6 +3932,9 @@ sysroot_initialize_deployment (OstreeSysroot *self, const char *osname, const ch
   if (!lint_deployment_fs (self, new_deployment, deployment_dfd, cancellable, error))
     return FALSE;
 
+  /* All of the deployment's files have landed now */
+  maybe_start_early_sync (self, deployment_dfd);
+
   ot_transfer_out_value (out_new_deployment, &new_deployment);
   return TRUE;
 }
@@ -3441,8 +4121,8 @@ sysroot_finalize_selinux_policy (int deployment_dfd, GError **error)
 
 static gboolean
 sysroot_finalize_deployment (OstreeSysroot *self, OstreeDeployment *deployment,
-                             OstreeDeployment *merge_deployment, GCancellable *cancellable,
-                             GError **error)
+                             OstreeDeployment *merge_deployment, EtcMergeDiff *precomputed_etc_diff,
+                             GCancellable *cancellable, GError **error)
 {
   g_autofree char *deployment_path = ostree_sysroot_get_deployment_dirpath (self, deployment);
   glnx_autofd int deployment_dfd = -1;
@@ -3469,7 +4149,7 @@ sysroot_finalize_deployment (OstreeSysroot *self, OstreeDeployment *deployment,
     {
       /* And do the /etc merge */
       if (!merge_configuration_from (self, merge_deployment, deployment, deployment_dfd,
-                                     cancellable, error))
+                                     precomputed_etc_diff, cancellable, error))
         return FALSE;
 
 #ifdef HAVE_SELINUX
@@ -3521,6 +4201,28 @@ sysroot_finalize_deployment (OstreeSysroot *self, OstreeDeployment *deployment,
   return TRUE;
 }
 
+/* State handed to the worker thread that computes the /etc merge diff
+ * concurrently with the checkout of the new deployment tree.  The caller
+ * keeps all borrowed members alive until the thread is joined.
+ */
+typedef struct
+{
+  OstreeSysroot *sysroot;             /* borrowed */
+  OstreeDeployment *merge_deployment; /* borrowed */
+  GCancellable *cancellable;          /* borrowed */
+  EtcMergeDiff *diff;                 /* out */
+  GError *error;                      /* out */
+} EtcDiffThreadData;
+
+static gpointer
+compute_etc_merge_diff_in_thread (gpointer user_data)
+{
+  EtcDiffThreadData *data = user_data;
+  (void)compute_etc_merge_diff (data->sysroot, data->merge_deployment, &data->diff,
+                                data->cancellable, &data->error);
+  return NULL;
+}
+
 /**
  * ostree_sysroot_deploy_tree_with_options:
  * @self: Sysroot
@@ -3552,13 +4254,34 @@ ostree_sysroot_deploy_tree_with_options (OstreeSysroot *self, const char *osname
   if (!_ostree_sysroot_ensure_writable (self, error))
     return FALSE;
 
+  /* The diff half of the /etc merge only reads existing deployments, so
+   * overlap it with the (typically much longer) checkout of the new tree;
+   * we join before the merge applies it in sysroot_finalize_deployment().
+   */
+  EtcDiffThreadData etc_diff_data = { self, provided_merge_deployment, cancellable, NULL, NULL };
+  GThread *etc_diff_thread = NULL;
+  if (provided_merge_deployment != NULL)
+    etc_diff_thread
+        = g_thread_new ("etc-merge-diff", compute_etc_merge_diff_in_thread, &etc_diff_data);
+
   g_autoptr (OstreeDeployment) deployment = NULL;
-  if (!sysroot_initialize_deployment (self, osname, revision, origin, opts, &deployment,
-                                      cancellable, error))
-    return FALSE;
+  const gboolean initialized = sysroot_initialize_deployment (
+      self, osname, revision, origin, provided_merge_deployment, opts, &deployment, cancellable,
+      error);
+  if (etc_diff_thread != NULL)
+    g_thread_join (etc_diff_thread);
+  g_autoptr (EtcMergeDiff) etc_diff = g_steal_pointer (&etc_diff_data.diff);
+  g_autoptr (GError) etc_diff_error = g_steal_pointer (&etc_diff_data.error);
+  if (!initialized)
+    return FALSE;
+  if (etc_diff_error != NULL)
+    {
+      g_propagate_prefixed_error (error, g_steal_pointer (&etc_diff_error), "During /etc merge: ");
+      return FALSE;
+    }
 
-  if (!sysroot_finalize_deployment (self, deployment, provided_merge_deployment, cancellable,
-                                    error))
+  if (!sysroot_finalize_deployment (self, deployment, provided_merge_deployment, etc_diff,
+                                    cancellable, error))
     return FALSE;
 
   *out_new_deployment = g_steal_pointer (&deployment);
@@ -3761,8 +4484,8 @@ ostree_sysroot_stage_tree_with_options (OstreeSysroot *self, const char *osname,
     return glnx_prefix_error (error, "Cannot stage deployment");
 
   g_autoptr (OstreeDeployment) deployment = NULL;
-  if (!sysroot_initialize_deployment (self, osname, revision, origin, opts, &deployment,
-                                      cancellable, error))
+  if (!sysroot_initialize_deployment (self, osname, revision, origin, merge_deployment, opts,
+                                      &deployment, cancellable, error))
     return FALSE;
 
   /* Write out the origin file using the sepolicy from the non-merged root for
@@ -3904,8 +4627,8 @@ _ostree_sysroot_finalize_staged_inner (OstreeSysroot *self, GCancellable *cancel
   if (!glnx_unlinkat (AT_FDCWD, _OSTREE_SYSROOT_RUNSTATE_STAGED, 0, error))
     return FALSE;
 
-  if (!sysroot_finalize_deployment (self, self->staged_deployment, merge_deployment, cancellable,
-                                    error))
+  if (!sysroot_finalize_deployment (self, self->staged_deployment, merge_deployment, NULL,
+                                    cancellable, error))
     return FALSE;
 
   /* Now, take ownership of the staged state, as normally the API below strips
@@ -45,6 +45,11 @@ typedef enum
   OSTREE_SYSROOT_GLOBAL_OPT_SKIP_SYNC = 1 << 0,
   /* See https://github.com/ostreedev/ostree/pull/2847 */
   OSTREE_SYSROOT_GLOBAL_OPT_EARLY_PRUNE = 1 << 1,
+  /* Start filesystem writeback of a new deployment checkout on a background
+   * thread as soon as it lands, so the syncfs() barrier at finalize time only
+   * covers the tail of writeback.
+   */
+  OSTREE_SYSROOT_GLOBAL_OPT_EARLY_SYNC = 1 << 2,
 } OstreeSysrootGlobalOptFlags;
 
 typedef enum
@@ -52,6 +52,7 @@ struct OstreeSysrootUpgrader
   char *origin_ref;
   char *override_csum;
 
+  char *checked_revision;
   char *new_revision;
 };
 
@@ -162,6 +163,7 @@ ostree_sysroot_upgrader_finalize (GObject *object)
   g_free (self->origin_remote);
   g_free (self->origin_ref);
   g_free (self->override_csum);
+  g_free (self->checked_revision);
   g_free (self->new_revision);
 
   G_OBJECT_CLASS (ostree_sysroot_upgrader_parent_class)->finalize (object);
@@ -411,6 +413,170 @@ ostree_sysroot_upgrader_check_timestamps (OstreeRepo *repo, const char *from_rev
   return TRUE;
 }
 
+/**
+ * ostree_sysroot_upgrader_check:
+ * @self: Upgrader
+ * @out_changed: (out): Whether an update is available
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Check whether the origin has a newer commit available, without
+ * downloading any objects.  For remote origins this fetches (at most)
+ * the summary file and compares the recorded head of the origin ref
+ * against the merge deployment; local origins just resolve the ref.
+ *
+ * The revision found here is remembered and pinned by a subsequent
+ * ostree_sysroot_upgrader_download(), so a check/download/deploy
+ * sequence operates on a consistent target even if the remote moves on
+ * in between.
+ *
+ * Since: 2023.6
+ */
+gboolean
+ostree_sysroot_upgrader_check (OstreeSysrootUpgrader *self, gboolean *out_changed,
+                               GCancellable *cancellable, GError **error)
+{
+  g_assert (self->merge_deployment);
+  const char *from_revision = ostree_deployment_get_csum (self->merge_deployment);
+  OstreeRepo *repo = ostree_sysroot_repo (self->sysroot);
+
+  g_clear_pointer (&self->checked_revision, g_free);
+
+  if (self->override_csum != NULL)
+    {
+      self->checked_revision = g_strdup (self->override_csum);
+    }
+  else if (self->origin_remote != NULL)
+    {
+      g_autoptr (GBytes) summary_bytes = NULL;
+      if (!ostree_repo_remote_fetch_summary (repo, self->origin_remote, &summary_bytes, NULL,
+                                             cancellable, error))
+        return FALSE;
+      if (summary_bytes == NULL)
+        return glnx_throw (error, "Remote '%s' has no summary file; cannot check for updates",
+                           self->origin_remote);
+
+      g_autoptr (GVariant) summary = g_variant_ref_sink (
+          g_variant_new_from_bytes (OSTREE_SUMMARY_GVARIANT_FORMAT, summary_bytes, FALSE));
+      g_autoptr (GVariant) refs = g_variant_get_child_value (summary, 0);
+
+      int pos;
+      if (!ot_variant_bsearch_str (refs, self->origin_ref, &pos))
+        return glnx_throw (error, "Ref '%s' not found in summary of remote '%s'", self->origin_ref,
+                           self->origin_remote);
+
+      g_autoptr (GVariant) ref_entry = g_variant_get_child_value (refs, pos);
+      g_autoptr (GVariant) ref_target = g_variant_get_child_value (ref_entry, 1);
+      g_autoptr (GVariant) csum_v = g_variant_get_child_value (ref_target, 1);
+      const guchar *csum_bytes = ostree_checksum_bytes_peek_validate (csum_v, error);
+      if (csum_bytes == NULL)
+        return FALSE;
+      self->checked_revision = ostree_checksum_from_bytes (csum_bytes);
+    }
+  else
+    {
+      if (!ostree_repo_resolve_rev (repo, self->origin_ref, FALSE, &self->checked_revision, error))
+        return FALSE;
+    }
+
+  if (out_changed)
+    *out_changed = g_strcmp0 (from_revision, self->checked_revision) != 0;
+
+  return TRUE;
+}
+
+/**
+ * ostree_sysroot_upgrader_download:
+ * @self: Upgrader
+ * @flags: Flags controlling pull behavior
+ * @upgrader_flags: Flags controlling upgrader behavior
+ * @progress: (allow-none): Progress
+ * @out_changed: (out): Whether or not an update was found
+ * @cancellable: Cancellable
+ * @error: Error
+ *
+ * Download the objects for the revision found by
+ * ostree_sysroot_upgrader_check(), running the check first if none was
+ * done yet.  Unlike ostree_sysroot_upgrader_pull() this pulls the
+ * pinned revision rather than the ref head, so the eventual
+ * ostree_sysroot_upgrader_deploy() matches what the check reported.
+ *
+ * The pull is resumable: objects already present locally are not
+ * fetched again, so this can be called repeatedly (e.g. rate-limited in
+ * the background) until it succeeds, followed by a fast deploy.
+ * End-of-life ref redirects are not processed here; use
+ * ostree_sysroot_upgrader_pull() for that.
+ *
+ * Since: 2023.6
+ */
+gboolean
+ostree_sysroot_upgrader_download (OstreeSysrootUpgrader *self, OstreeRepoPullFlags flags,
+                                  OstreeSysrootUpgraderPullFlags upgrader_flags,
+                                  OstreeAsyncProgress *progress, gboolean *out_changed,
+                                  GCancellable *cancellable, GError **error)
+{
+  g_assert (self->merge_deployment);
+  const char *from_revision = ostree_deployment_get_csum (self->merge_deployment);
+  OstreeRepo *repo = ostree_sysroot_repo (self->sysroot);
+
+  if (self->checked_revision == NULL)
+    {
+      if (!ostree_sysroot_upgrader_check (self, NULL, cancellable, error))
+        return FALSE;
+    }
+
+  if (self->origin_remote != NULL && (upgrader_flags & OSTREE_SYSROOT_UPGRADER_PULL_FLAGS_SYNTHETIC) == 0
+      && g_strcmp0 (from_revision, self->checked_revision) != 0)
+    {
+      char *refs_to_fetch[] = { self->checked_revision, NULL };
+      g_autoptr (GVariantBuilder) optbuilder = g_variant_builder_new (G_VARIANT_TYPE ("a{sv}"));
+      g_variant_builder_add (optbuilder, "{s@v}", "flags",
+                             g_variant_new_variant (g_variant_new_int32 (flags)));
+      if ((upgrader_flags & OSTREE_SYSROOT_UPGRADER_PULL_FLAGS_ALLOW_OLDER) == 0)
+        g_variant_builder_add (optbuilder, "{s@v}", "timestamp-check-from-rev",
+                               g_variant_new_variant (g_variant_new_string (from_revision)));
+      g_variant_builder_add (
+          optbuilder, "{s@v}", "refs",
+          g_variant_new_variant (g_variant_new_strv ((const char *const *)refs_to_fetch, -1)));
+      g_autoptr (GVariant) opts = g_variant_ref_sink (g_variant_builder_end (optbuilder));
+      if (!ostree_repo_pull_with_options (repo, self->origin_remote, opts, progress, cancellable,
+                                          error))
+        return FALSE;
+
+      if (progress)
+        ostree_async_progress_finish (progress);
+
+      /* Record the pinned revision as the local ref head, as a ref-based
+       * pull would have, so repeated downloads and the deploy agree.
+       */
+      if (!ostree_repo_set_ref_immediate (repo, self->origin_remote, self->origin_ref,
+                                          self->checked_revision, cancellable, error))
+        return FALSE;
+    }
+
+  g_clear_pointer (&self->new_revision, g_free);
+  self->new_revision = g_strdup (self->checked_revision);
+
+  if (g_strcmp0 (from_revision, self->new_revision) == 0)
+    {
+      *out_changed = FALSE;
+    }
+  else
+    {
+      *out_changed = TRUE;
+
+      if (from_revision != NULL
+          && (upgrader_flags & OSTREE_SYSROOT_UPGRADER_PULL_FLAGS_ALLOW_OLDER) == 0)
+        {
+          if (!ostree_sysroot_upgrader_check_timestamps (repo, from_revision, self->new_revision,
+                                                         error))
+            return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
 /**
  * ostree_sysroot_upgrader_pull:
  * @self: Upgrader
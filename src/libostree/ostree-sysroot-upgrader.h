@@ -91,6 +91,16 @@ typedef enum
   = (1 << 1) /* Don't actually do a pull, just check timestamps/changed */
 } OstreeSysrootUpgraderPullFlags;
 
+_OSTREE_PUBLIC
+gboolean ostree_sysroot_upgrader_check (OstreeSysrootUpgrader *self, gboolean *out_changed,
+                                        GCancellable *cancellable, GError **error);
+
+_OSTREE_PUBLIC
+gboolean ostree_sysroot_upgrader_download (OstreeSysrootUpgrader *self, OstreeRepoPullFlags flags,
+                                           OstreeSysrootUpgraderPullFlags upgrader_flags,
+                                           OstreeAsyncProgress *progress, gboolean *out_changed,
+                                           GCancellable *cancellable, GError **error);
+
 _OSTREE_PUBLIC
 gboolean ostree_sysroot_upgrader_pull (OstreeSysrootUpgrader *self, OstreeRepoPullFlags flags,
                                        OstreeSysrootUpgraderPullFlags upgrader_flags,
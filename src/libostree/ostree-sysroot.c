@@ -26,6 +26,7 @@
 #include <sys/mount.h>
 #include <sys/wait.h>
 
+#include "ostree-bootconfig-parser-private.h"
 #include "ostree-bootloader-aboot.h"
 #include "ostree-bootloader-grub2.h"
 #include "ostree-bootloader-syslinux.h"
@@ -180,6 +181,7 @@ ostree_sysroot_init (OstreeSysroot *self)
   const GDebugKey globalopt_keys[] = {
     { "skip-sync", OSTREE_SYSROOT_GLOBAL_OPT_SKIP_SYNC },
     { "early-prune", OSTREE_SYSROOT_GLOBAL_OPT_EARLY_PRUNE },
+    { "early-sync", OSTREE_SYSROOT_GLOBAL_OPT_EARLY_SYNC },
   };
   const GDebugKey keys[] = {
     { "mutable-deployments", OSTREE_SYSROOT_DEBUG_MUTABLE_DEPLOYMENTS },
@@ -761,6 +763,37 @@ _ostree_sysroot_get_runstate_path (OstreeDeployment *deployment, const char *key
                           ostree_deployment_get_deployserial (deployment), key);
 }
 
+/* Determine the unlock state from the runstate flag files and the origin. */
+static void
+load_deployment_unlocked_state (OstreeDeployment *deployment)
+{
+  deployment->unlocked = OSTREE_DEPLOYMENT_UNLOCKED_NONE;
+  g_autofree char *unlocked_development_path = _ostree_sysroot_get_runstate_path (
+      deployment, _OSTREE_SYSROOT_DEPLOYMENT_RUNSTATE_FLAG_DEVELOPMENT);
+  g_autofree char *unlocked_transient_path = _ostree_sysroot_get_runstate_path (
+      deployment, _OSTREE_SYSROOT_DEPLOYMENT_RUNSTATE_FLAG_TRANSIENT);
+  struct stat stbuf;
+  if (lstat (unlocked_development_path, &stbuf) == 0)
+    deployment->unlocked = OSTREE_DEPLOYMENT_UNLOCKED_DEVELOPMENT;
+  else if (lstat (unlocked_transient_path, &stbuf) == 0)
+    deployment->unlocked = OSTREE_DEPLOYMENT_UNLOCKED_TRANSIENT;
+  else
+    {
+      GKeyFile *origin = ostree_deployment_get_origin (deployment);
+      g_autofree char *existing_unlocked_state
+          = origin ? g_key_file_get_string (origin, "origin", "unlocked", NULL) : NULL;
+
+      if (g_strcmp0 (existing_unlocked_state, "hotfix") == 0)
+        {
+          deployment->unlocked = OSTREE_DEPLOYMENT_UNLOCKED_HOTFIX;
+        }
+      /* TODO: warn on unknown unlock types? */
+    }
+
+  g_debug ("Deployment %s.%d unlocked=%d", ostree_deployment_get_csum (deployment),
+           ostree_deployment_get_deployserial (deployment), deployment->unlocked);
+}
+
 static gboolean
 parse_deployment (OstreeSysroot *self, const char *boot_link, OstreeDeployment **out_deployment,
                   GCancellable *cancellable, GError **error)
@@ -832,30 +865,7 @@ parse_deployment (OstreeSysroot *self, const char *boot_link, OstreeDeployment *
   if (!load_origin (self, ret_deployment, cancellable, error))
     return FALSE;
 
-  ret_deployment->unlocked = OSTREE_DEPLOYMENT_UNLOCKED_NONE;
-  g_autofree char *unlocked_development_path = _ostree_sysroot_get_runstate_path (
-      ret_deployment, _OSTREE_SYSROOT_DEPLOYMENT_RUNSTATE_FLAG_DEVELOPMENT);
-  g_autofree char *unlocked_transient_path = _ostree_sysroot_get_runstate_path (
-      ret_deployment, _OSTREE_SYSROOT_DEPLOYMENT_RUNSTATE_FLAG_TRANSIENT);
-  struct stat stbuf;
-  if (lstat (unlocked_development_path, &stbuf) == 0)
-    ret_deployment->unlocked = OSTREE_DEPLOYMENT_UNLOCKED_DEVELOPMENT;
-  else if (lstat (unlocked_transient_path, &stbuf) == 0)
-    ret_deployment->unlocked = OSTREE_DEPLOYMENT_UNLOCKED_TRANSIENT;
-  else
-    {
-      GKeyFile *origin = ostree_deployment_get_origin (ret_deployment);
-      g_autofree char *existing_unlocked_state
-          = origin ? g_key_file_get_string (origin, "origin", "unlocked", NULL) : NULL;
-
-      if (g_strcmp0 (existing_unlocked_state, "hotfix") == 0)
-        {
-          ret_deployment->unlocked = OSTREE_DEPLOYMENT_UNLOCKED_HOTFIX;
-        }
-      /* TODO: warn on unknown unlock types? */
-    }
-
-  g_debug ("Deployment %s.%d unlocked=%d", treecsum, deployserial, ret_deployment->unlocked);
+  load_deployment_unlocked_state (ret_deployment);
 
   if (is_booted_deployment)
     self->booted_deployment = g_object_ref (ret_deployment);
@@ -885,21 +895,12 @@ get_ostree_kernel_arg_from_config (OstreeBootconfigParser *config)
   return NULL;
 }
 
-/* From a BLS config, use its ostree= karg to find the deployment it points to and add it to
- * the inout_deployments array. */
+/* Attach @config to @deployment, extracting the overlay initrd checksums
+ * from its additional initrd keys. */
 static gboolean
-list_deployments_process_one_boot_entry (OstreeSysroot *self, OstreeBootconfigParser *config,
-                                         GPtrArray *inout_deployments, GCancellable *cancellable,
-                                         GError **error)
+deployment_set_bootconfig_and_initrds (OstreeDeployment *deployment,
+                                       OstreeBootconfigParser *config, GError **error)
 {
-  g_autofree char *ostree_arg = get_ostree_kernel_arg_from_config (config);
-  if (ostree_arg == NULL)
-    return glnx_throw (error, "No ostree= kernel argument found");
-
-  g_autoptr (OstreeDeployment) deployment = NULL;
-  if (!parse_deployment (self, ostree_arg, &deployment, cancellable, error))
-    return FALSE;
-
   ostree_deployment_set_bootconfig (deployment, config);
   char **overlay_initrds = ostree_bootconfig_parser_get_overlay_initrds (config);
   g_autoptr (GPtrArray) initrds_chksums = NULL;
@@ -920,6 +921,27 @@ list_deployments_process_one_boot_entry (OstreeSysroot *self, OstreeBootconfigPa
       _ostree_deployment_set_overlay_initrds (deployment, (char **)initrds_chksums->pdata);
     }
 
+  return TRUE;
+}
+
+/* From a BLS config, use its ostree= karg to find the deployment it points to and add it to
+ * the inout_deployments array. */
+static gboolean
+list_deployments_process_one_boot_entry (OstreeSysroot *self, OstreeBootconfigParser *config,
+                                         GPtrArray *inout_deployments, GCancellable *cancellable,
+                                         GError **error)
+{
+  g_autofree char *ostree_arg = get_ostree_kernel_arg_from_config (config);
+  if (ostree_arg == NULL)
+    return glnx_throw (error, "No ostree= kernel argument found");
+
+  g_autoptr (OstreeDeployment) deployment = NULL;
+  if (!parse_deployment (self, ostree_arg, &deployment, cancellable, error))
+    return FALSE;
+
+  if (!deployment_set_bootconfig_and_initrds (deployment, config, error))
+    return FALSE;
+
   g_ptr_array_add (inout_deployments, g_object_ref (deployment));
   return TRUE;
 }
@@ -1105,45 +1127,14 @@ _ostree_sysroot_reload_staged (OstreeSysroot *self, GError **error)
   return TRUE;
 }
 
-/* Loads the current bootversion, subbootversion, and deployments, starting from the
- * bootloader configs which are the source of truth.
+/* Shared tail of deployment loading: verify the booted deployment was found,
+ * pick up the staged deployment, sort and index the list, and commit the
+ * result to @self.
  */
 static gboolean
-sysroot_load_from_bootloader_configs (OstreeSysroot *self, GCancellable *cancellable,
-                                      GError **error)
+sysroot_finish_load (OstreeSysroot *self, int bootversion, int subbootversion,
+                     GPtrArray *deployments, GCancellable *cancellable, GError **error)
 {
-  struct stat stbuf;
-
-  int bootversion = 0;
-  if (!read_current_bootversion (self, &bootversion, cancellable, error))
-    return FALSE;
-
-  int subbootversion = 0;
-  if (!_ostree_sysroot_read_current_subbootversion (self, bootversion, &subbootversion, cancellable,
-                                                    error))
-    return FALSE;
-
-  g_autoptr (GPtrArray) boot_loader_configs = NULL;
-  if (!_ostree_sysroot_read_boot_loader_configs (self, bootversion, &boot_loader_configs,
-                                                 cancellable, error))
-    return FALSE;
-
-  g_autoptr (GPtrArray) deployments
-      = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
-
-  g_assert (boot_loader_configs); /* Pacify static analysis */
-  for (guint i = 0; i < boot_loader_configs->len; i++)
-    {
-      OstreeBootconfigParser *config = boot_loader_configs->pdata[i];
-
-      /* Note this also sets self->booted_deployment */
-      if (!list_deployments_process_one_boot_entry (self, config, deployments, cancellable, error))
-        {
-          g_clear_object (&self->booted_deployment);
-          return FALSE;
-        }
-    }
-
   if (self->root_is_ostree_booted && !self->booted_deployment)
     {
       if (!glnx_fstatat_allow_noent (self->sysroot_fd, "boot/loader", NULL, AT_SYMLINK_NOFOLLOW,
@@ -1192,6 +1183,7 @@ sysroot_load_from_bootloader_configs (OstreeSysroot *self, GCancellable *cancell
        */
       else
         {
+          struct stat stbuf;
           if (!glnx_fstatat_allow_noent (self->sysroot_fd, "sysroot", &stbuf, 0, error))
             return FALSE;
           if (errno == ENOENT)
@@ -1204,11 +1196,246 @@ sysroot_load_from_bootloader_configs (OstreeSysroot *self, GCancellable *cancell
 
   self->bootversion = bootversion;
   self->subbootversion = subbootversion;
-  self->deployments = g_steal_pointer (&deployments);
+  self->deployments = g_ptr_array_ref (deployments);
 
   return TRUE;
 }
 
+/* Loads the current bootversion, subbootversion, and deployments, starting from the
+ * bootloader configs which are the source of truth.
+ */
+static gboolean
+sysroot_load_from_bootloader_configs (OstreeSysroot *self, GCancellable *cancellable,
+                                      GError **error)
+{
+  int bootversion = 0;
+  if (!read_current_bootversion (self, &bootversion, cancellable, error))
+    return FALSE;
+
+  int subbootversion = 0;
+  if (!_ostree_sysroot_read_current_subbootversion (self, bootversion, &subbootversion, cancellable,
+                                                    error))
+    return FALSE;
+
+  g_autoptr (GPtrArray) boot_loader_configs = NULL;
+  if (!_ostree_sysroot_read_boot_loader_configs (self, bootversion, &boot_loader_configs,
+                                                 cancellable, error))
+    return FALSE;
+
+  g_autoptr (GPtrArray) deployments
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
+
+  g_assert (boot_loader_configs); /* Pacify static analysis */
+  for (guint i = 0; i < boot_loader_configs->len; i++)
+    {
+      OstreeBootconfigParser *config = boot_loader_configs->pdata[i];
+
+      /* Note this also sets self->booted_deployment */
+      if (!list_deployments_process_one_boot_entry (self, config, deployments, cancellable, error))
+        {
+          g_clear_object (&self->booted_deployment);
+          return FALSE;
+        }
+    }
+
+  return sysroot_finish_load (self, bootversion, subbootversion, deployments, cancellable, error);
+}
+
+/* Deployment state cache: the full load above re-parses every deployment's
+ * origin file and bootloader config on each invocation, which adds up for
+ * tools that poll `ostree admin status`.  After a successful load we
+ * serialize the parsed list into the repository cache directory, keyed by
+ * the bootversion, subbootversion, and the mtime of ostree/deploy; an
+ * unchanged sysroot then reloads from the cache with a single read.  The
+ * staged deployment, unlock state, and booted-deployment detection are
+ * always recomputed, since those live in runtime state.
+ */
+#define SYSROOT_STATE_CACHE_NAME "sysroot-state"
+#define SYSROOT_STATE_CACHE_VERSION 1
+/* version, bootversion, subbootversion, deploy dir mtime (sec, nsec), deployments */
+#define SYSROOT_STATE_CACHE_GVARIANT_STRING "(uiittaa{sv})"
+#define SYSROOT_STATE_CACHE_GVARIANT_FORMAT G_VARIANT_TYPE (SYSROOT_STATE_CACHE_GVARIANT_STRING)
+
+/* Try to load the deployment list from the state cache; any mismatch or
+ * parse problem just means the cache isn't used.  Only errors from
+ * committing a successfully validated cache are propagated. */
+static gboolean
+sysroot_load_from_state_cache (OstreeSysroot *self, const struct stat *deploy_stbuf,
+                               gboolean *out_loaded, GCancellable *cancellable, GError **error)
+{
+  *out_loaded = FALSE;
+
+  if (self->repo == NULL || self->repo->cache_dir_fd == -1)
+    return TRUE;
+
+  glnx_autofd int fd = -1;
+  if (!ot_openat_ignore_enoent (self->repo->cache_dir_fd, SYSROOT_STATE_CACHE_NAME, &fd, NULL)
+      || fd == -1)
+    return TRUE;
+
+  g_autoptr (GVariant) cache = NULL;
+  if (!ot_variant_read_fd (fd, 0, SYSROOT_STATE_CACHE_GVARIANT_FORMAT, TRUE, &cache, NULL))
+    return TRUE;
+
+  guint32 version;
+  gint32 bootversion, subbootversion;
+  guint64 mtime_sec, mtime_nsec;
+  g_autoptr (GVariant) deployments_v = NULL;
+  g_variant_get (cache, "(uiitt@aa{sv})", &version, &bootversion, &subbootversion, &mtime_sec,
+                 &mtime_nsec, &deployments_v);
+  if (version != SYSROOT_STATE_CACHE_VERSION || mtime_sec != (guint64)deploy_stbuf->st_mtim.tv_sec
+      || mtime_nsec != (guint64)deploy_stbuf->st_mtim.tv_nsec)
+    return TRUE;
+
+  /* The bootloader state is part of the key */
+  int current_bootversion = 0;
+  if (!read_current_bootversion (self, &current_bootversion, cancellable, NULL)
+      || current_bootversion != bootversion)
+    return TRUE;
+  int current_subbootversion = 0;
+  if (!_ostree_sysroot_read_current_subbootversion (self, bootversion, &current_subbootversion,
+                                                    cancellable, NULL)
+      || current_subbootversion != subbootversion)
+    return TRUE;
+
+  const gboolean looking_for_booted_deployment
+      = (self->root_is_ostree_booted && !self->booted_deployment);
+  g_autoptr (OstreeDeployment) booted_deployment = NULL;
+  g_autoptr (GPtrArray) deployments
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
+  const gsize n_deployments = g_variant_n_children (deployments_v);
+  for (gsize i = 0; i < n_deployments; i++)
+    {
+      g_autoptr (GVariant) child = g_variant_get_child_value (deployments_v, i);
+      g_autoptr (GVariantDict) dict = g_variant_dict_new (child);
+      const char *name = NULL;
+      const char *osname = NULL;
+      const char *bootcsum = NULL;
+      const char *bootconfig_contents = NULL;
+      gint32 treebootserial = -1;
+      if (!g_variant_dict_lookup (dict, "name", "&s", &name)
+          || !g_variant_dict_lookup (dict, "osname", "&s", &osname)
+          || !g_variant_dict_lookup (dict, "bootcsum", "&s", &bootcsum)
+          || !g_variant_dict_lookup (dict, "treebootserial", "i", &treebootserial)
+          || !g_variant_dict_lookup (dict, "bootconfig", "&s", &bootconfig_contents))
+        return TRUE;
+
+      g_autofree char *treecsum = NULL;
+      int deployserial = -1;
+      if (!_ostree_sysroot_parse_deploy_path_name (name, &treecsum, &deployserial, NULL))
+        return TRUE;
+
+      g_autoptr (OstreeDeployment) deployment
+          = ostree_deployment_new (-1, osname, treecsum, deployserial, bootcsum, treebootserial);
+
+      g_autoptr (OstreeBootconfigParser) bootconfig = ostree_bootconfig_parser_new ();
+      _ostree_bootconfig_parser_parse_data (bootconfig, bootconfig_contents);
+      if (!deployment_set_bootconfig_and_initrds (deployment, bootconfig, NULL))
+        return TRUE;
+
+      const char *origin_contents = NULL;
+      if (g_variant_dict_lookup (dict, "origin", "&s", &origin_contents))
+        {
+          g_autoptr (GKeyFile) origin = g_key_file_new ();
+          if (!g_key_file_load_from_data (origin, origin_contents, -1, 0, NULL))
+            return TRUE;
+          ostree_deployment_set_origin (deployment, origin);
+        }
+
+      load_deployment_unlocked_state (deployment);
+
+      if (looking_for_booted_deployment && !booted_deployment)
+        {
+          /* Same logic as parse_deployment(): the deployment root, or its
+           * etc subdir in the composefs case, is what's mounted at /. */
+          g_autofree char *deploy_path = ostree_sysroot_get_deployment_dirpath (self, deployment);
+          glnx_autofd int deployment_dfd = -1;
+          if (!glnx_opendirat (self->sysroot_fd, deploy_path, TRUE, &deployment_dfd, NULL))
+            return TRUE; /* Stale cache */
+          struct stat stbuf;
+          struct stat etc_stbuf = {};
+          if (!glnx_fstat (deployment_dfd, &stbuf, NULL)
+              || !glnx_fstatat_allow_noent (deployment_dfd, "etc", &etc_stbuf, 0, NULL))
+            return TRUE;
+          if ((stbuf.st_dev == self->root_device && stbuf.st_ino == self->root_inode)
+              || (etc_stbuf.st_dev == self->etc_device && etc_stbuf.st_ino == self->etc_inode))
+            booted_deployment = g_object_ref (deployment);
+        }
+
+      g_ptr_array_add (deployments, g_steal_pointer (&deployment));
+    }
+
+  /* Let the full load produce its proper error message for this state */
+  if (looking_for_booted_deployment && booted_deployment == NULL)
+    return TRUE;
+
+  self->booted_deployment = g_steal_pointer (&booted_deployment);
+  if (!sysroot_finish_load (self, bootversion, subbootversion, deployments, cancellable, error))
+    return FALSE;
+
+  g_debug ("Loaded sysroot state from cache");
+  *out_loaded = TRUE;
+  return TRUE;
+}
+
+/* Refresh the state cache from the just-loaded deployment list.  Best
+ * effort; this is purely a cache. */
+static void
+sysroot_state_cache_save (OstreeSysroot *self, const struct stat *deploy_stbuf)
+{
+  if (self->repo == NULL || self->repo->cache_dir_fd == -1)
+    return;
+
+  g_auto (GVariantBuilder) deployments_builder = OT_VARIANT_BUILDER_INITIALIZER;
+  g_variant_builder_init (&deployments_builder, G_VARIANT_TYPE ("aa{sv}"));
+  for (guint i = 0; i < self->deployments->len; i++)
+    {
+      OstreeDeployment *deployment = self->deployments->pdata[i];
+      /* The staged deployment is reloaded from its runstate file on every load */
+      if (ostree_deployment_is_staged (deployment))
+        continue;
+
+      OstreeBootconfigParser *bootconfig = ostree_deployment_get_bootconfig (deployment);
+      if (bootconfig == NULL)
+        return;
+      g_autofree char *bootconfig_contents = _ostree_bootconfig_parser_to_string (bootconfig);
+
+      g_auto (GVariantBuilder) entry_builder = OT_VARIANT_BUILDER_INITIALIZER;
+      g_variant_builder_init (&entry_builder, G_VARIANT_TYPE ("a{sv}"));
+      g_autofree char *name = g_strdup_printf ("%s.%d", ostree_deployment_get_csum (deployment),
+                                               ostree_deployment_get_deployserial (deployment));
+      g_variant_builder_add (&entry_builder, "{sv}", "name", g_variant_new_string (name));
+      g_variant_builder_add (&entry_builder, "{sv}", "osname",
+                             g_variant_new_string (ostree_deployment_get_osname (deployment)));
+      g_variant_builder_add (&entry_builder, "{sv}", "bootcsum",
+                             g_variant_new_string (ostree_deployment_get_bootcsum (deployment)));
+      g_variant_builder_add (&entry_builder, "{sv}", "treebootserial",
+                             g_variant_new_int32 (ostree_deployment_get_bootserial (deployment)));
+      g_variant_builder_add (&entry_builder, "{sv}", "bootconfig",
+                             g_variant_new_string (bootconfig_contents));
+
+      GKeyFile *origin = ostree_deployment_get_origin (deployment);
+      if (origin != NULL)
+        {
+          g_autofree char *origin_contents = g_key_file_to_data (origin, NULL, NULL);
+          if (origin_contents != NULL)
+            g_variant_builder_add (&entry_builder, "{sv}", "origin",
+                                   g_variant_new_string (origin_contents));
+        }
+
+      g_variant_builder_add_value (&deployments_builder, g_variant_builder_end (&entry_builder));
+    }
+
+  g_autoptr (GVariant) cache = g_variant_ref_sink (g_variant_new (
+      "(uiitt@aa{sv})", (guint32)SYSROOT_STATE_CACHE_VERSION, (gint32)self->bootversion,
+      (gint32)self->subbootversion, (guint64)deploy_stbuf->st_mtim.tv_sec,
+      (guint64)deploy_stbuf->st_mtim.tv_nsec, g_variant_builder_end (&deployments_builder)));
+
+  (void)glnx_file_replace_contents_at (self->repo->cache_dir_fd, SYSROOT_STATE_CACHE_NAME,
+                                       g_variant_get_data (cache), g_variant_get_size (cache),
+                                       GLNX_FILE_REPLACE_NODATASYNC, NULL, NULL);
+}
+
 /**
  * ostree_sysroot_load_if_changed:
  * @self: #OstreeSysroot
@@ -1253,8 +1480,17 @@ ostree_sysroot_load_if_changed (OstreeSysroot *self, gboolean *out_changed,
   self->bootversion = -1;
   self->subbootversion = -1;
 
-  if (!sysroot_load_from_bootloader_configs (self, cancellable, error))
+  /* Try the deployment state cache first; fall back to the full parse of
+   * the bootloader configs, and refresh the cache from its result. */
+  gboolean loaded_from_cache = FALSE;
+  if (!sysroot_load_from_state_cache (self, &stbuf, &loaded_from_cache, cancellable, error))
     return FALSE;
+  if (!loaded_from_cache)
+    {
+      if (!sysroot_load_from_bootloader_configs (self, cancellable, error))
+        return FALSE;
+      sysroot_state_cache_save (self, &stbuf);
+    }
 
   self->loaded_ts = stbuf.st_mtim;
 
@@ -178,7 +178,9 @@ gboolean ostree_sysroot_stage_overlay_initrd (OstreeSysroot *self, int fd, char
 
 typedef struct
 {
-  gboolean unused_bools[8];
+  gboolean enable_fast_rollback; /* Since: 2023.6; seed the new deployment from the merge
+                                    deployment's checkout plus a commit diff */
+  gboolean unused_bools[7];
   int unused_ints[8];
   char **override_kernel_argv;
   char **overlay_initrds;
@@ -96,6 +96,67 @@ _ostree_read_varuint64 (const guint8 *buf, gsize buflen, guint64 *out_value, gsi
   return TRUE;
 }
 
+/**
+ * _ostree_read_varuint64_multi:
+ * @buf: (array length=buflen): Byte buffer
+ * @buflen: Length of bytes in @buf
+ * @out_values: (array length=n_values): Decoded values
+ * @n_values: Number of consecutive varints to decode
+ * @bytes_read: (out): Total number of bytes read
+ *
+ * Decode @n_values consecutive varints from @buf in one call.  When the
+ * buffer is long enough for worst-case encodings (the common case for
+ * opcode streams) the inner loop runs without per-byte bounds checks,
+ * which is substantially cheaper than one _ostree_read_varuint64() call
+ * per value on small cores.
+ *
+ * Returns: %TRUE on success, %FALSE on end of stream or overlong varint
+ */
+gboolean
+_ostree_read_varuint64_multi (const guint8 *buf, gsize buflen, guint64 *out_values, guint n_values,
+                              gsize *bytes_read)
+{
+  const guint8 *p = buf;
+
+  if (G_LIKELY (buflen >= (gsize)n_values * max_varint_bytes))
+    {
+      for (guint i = 0; i < n_values; i++)
+        {
+          guint64 result = 0;
+          int count = 0;
+          guint8 b;
+
+          do
+            {
+              b = *p++;
+              result |= ((guint64)(b & 0x7F)) << (7 * count);
+              count++;
+            }
+          while ((b & 0x80) && count < max_varint_bytes);
+          if (b & 0x80)
+            return FALSE;
+
+          out_values[i] = result;
+        }
+    }
+  else
+    {
+      gsize remaining = buflen;
+
+      for (guint i = 0; i < n_values; i++)
+        {
+          gsize n;
+          if (!_ostree_read_varuint64 (p, remaining, &out_values[i], &n))
+            return FALSE;
+          p += n;
+          remaining -= n;
+        }
+    }
+
+  *bytes_read = p - buf;
+  return TRUE;
+}
+
 /**
  * _ostree_write_varuint64:
  * @buf: Target buffer (will contain binary data)
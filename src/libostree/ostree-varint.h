@@ -26,6 +26,9 @@ G_BEGIN_DECLS
 gboolean _ostree_read_varuint64 (const guint8 *buf, gsize buflen, guint64 *out_value,
                                  gsize *bytes_read);
 
+gboolean _ostree_read_varuint64_multi (const guint8 *buf, gsize buflen, guint64 *out_values,
+                                       guint n_values, gsize *bytes_read);
+
 void _ostree_write_varuint64 (GString *buf, guint64 n);
 
 G_END_DECLS
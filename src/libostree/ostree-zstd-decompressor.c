@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ostree-zstd-decompressor.h"
+
+#include <string.h>
+#include <zstd.h>
+
+/**
+ * SECTION:ostree-zstd-decompressor
+ * @title: zstd decompressor
+ *
+ * An implementation of #GConverter that decompresses data compressed
+ * with zstd.
+ */
+
+static void _ostree_zstd_decompressor_iface_init (GConverterIface *iface);
+
+struct _OstreeZstdDecompressor
+{
+  GObject parent_instance;
+
+  ZSTD_DCtx *dctx;
+};
+
+G_DEFINE_TYPE_WITH_CODE (OstreeZstdDecompressor, _ostree_zstd_decompressor, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER,
+                                                _ostree_zstd_decompressor_iface_init))
+
+static void
+_ostree_zstd_decompressor_finalize (GObject *object)
+{
+  OstreeZstdDecompressor *self = OSTREE_ZSTD_DECOMPRESSOR (object);
+
+  ZSTD_freeDCtx (self->dctx);
+
+  G_OBJECT_CLASS (_ostree_zstd_decompressor_parent_class)->finalize (object);
+}
+
+static void
+_ostree_zstd_decompressor_init (OstreeZstdDecompressor *self)
+{
+}
+
+static void
+_ostree_zstd_decompressor_class_init (OstreeZstdDecompressorClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = _ostree_zstd_decompressor_finalize;
+}
+
+OstreeZstdDecompressor *
+_ostree_zstd_decompressor_new (void)
+{
+  return g_object_new (OSTREE_TYPE_ZSTD_DECOMPRESSOR, NULL);
+}
+
+static void
+_ostree_zstd_decompressor_reset (GConverter *converter)
+{
+  OstreeZstdDecompressor *self = OSTREE_ZSTD_DECOMPRESSOR (converter);
+
+  if (self->dctx != NULL)
+    ZSTD_DCtx_reset (self->dctx, ZSTD_reset_session_only);
+}
+
+static GConverterResult
+_ostree_zstd_decompressor_convert (GConverter *converter, const void *inbuf, gsize inbuf_size,
+                                   void *outbuf, gsize outbuf_size, GConverterFlags flags,
+                                   gsize *bytes_read, gsize *bytes_written, GError **error)
+{
+  OstreeZstdDecompressor *self = OSTREE_ZSTD_DECOMPRESSOR (converter);
+
+  if (inbuf_size != 0 && outbuf_size == 0)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, "Output buffer too small");
+      return G_CONVERTER_ERROR;
+    }
+
+  if (self->dctx == NULL)
+    {
+      self->dctx = ZSTD_createDCtx ();
+      if (self->dctx == NULL)
+        {
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Out of memory");
+          return G_CONVERTER_ERROR;
+        }
+    }
+
+  ZSTD_inBuffer in = { inbuf, inbuf_size, 0 };
+  ZSTD_outBuffer out = { outbuf, outbuf_size, 0 };
+
+  size_t remaining = ZSTD_decompressStream (self->dctx, &out, &in);
+  if (ZSTD_isError (remaining))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "zstd: %s",
+                   ZSTD_getErrorName (remaining));
+      return G_CONVERTER_ERROR;
+    }
+
+  *bytes_read = in.pos;
+  *bytes_written = out.pos;
+
+  if (remaining == 0)
+    return G_CONVERTER_FINISHED;
+  if (in.pos == 0 && out.pos == 0)
+    {
+      if (flags & G_CONVERTER_INPUT_AT_END)
+        {
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                               "Unexpected end of zstd stream");
+          return G_CONVERTER_ERROR;
+        }
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Input buffer too small");
+      return G_CONVERTER_ERROR;
+    }
+  return G_CONVERTER_CONVERTED;
+}
+
+static void
+_ostree_zstd_decompressor_iface_init (GConverterIface *iface)
+{
+  iface->convert = _ostree_zstd_decompressor_convert;
+  iface->reset = _ostree_zstd_decompressor_reset;
+}
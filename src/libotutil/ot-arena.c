@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ot-arena.h"
+
+/* Records per block; with the pull structs around 64-96 bytes this
+ * keeps blocks in the tens of kilobytes, small enough that a mostly
+ * idle arena wastes little and large enough to amortize the malloc.
+ */
+#define OT_ARENA_BLOCK_N_ELTS 512
+
+typedef struct OtArenaBlock
+{
+  struct OtArenaBlock *next;
+  /* Followed by OT_ARENA_BLOCK_N_ELTS records */
+} OtArenaBlock;
+
+/* Freed records are threaded through their own storage */
+typedef struct OtArenaFreeNode
+{
+  struct OtArenaFreeNode *next;
+} OtArenaFreeNode;
+
+struct OtArena
+{
+  char *name;
+  gsize elt_size;
+
+  GMutex lock;
+  OtArenaBlock *blocks;
+  guint8 *block_next;     /* Bump pointer into the newest block */
+  guint8 *block_end;      /* End of the newest block's storage */
+  OtArenaFreeNode *freelist;
+
+  guint64 n_allocated; /* Total ot_arena_alloc0() calls */
+  guint64 n_live;
+  guint64 n_live_peak;
+  guint64 n_blocks;
+};
+
+/**
+ * ot_arena_new:
+ * @name: Short identifier used in debug output
+ * @elt_size: Size of each record; all allocations return this size
+ *
+ * Create an arena handing out zero-filled records of @elt_size bytes.
+ * The arena is thread-safe.
+ */
+OtArena *
+ot_arena_new (const char *name, gsize elt_size)
+{
+  OtArena *arena = g_new0 (OtArena, 1);
+
+  arena->name = g_strdup (name);
+  /* Each record must be able to hold a free-list node, and keep
+   * natural alignment for whatever struct it backs. */
+  arena->elt_size = MAX (elt_size, sizeof (OtArenaFreeNode));
+  arena->elt_size = (arena->elt_size + (G_MEM_ALIGN - 1)) & ~(gsize)(G_MEM_ALIGN - 1);
+  g_mutex_init (&arena->lock);
+  return arena;
+}
+
+gpointer
+ot_arena_alloc0 (OtArena *arena)
+{
+  g_mutex_lock (&arena->lock);
+
+  gpointer ret;
+  if (arena->freelist != NULL)
+    {
+      ret = arena->freelist;
+      arena->freelist = arena->freelist->next;
+    }
+  else
+    {
+      if (arena->block_next == arena->block_end)
+        {
+          OtArenaBlock *block
+              = g_malloc (sizeof (OtArenaBlock) + OT_ARENA_BLOCK_N_ELTS * arena->elt_size);
+          block->next = arena->blocks;
+          arena->blocks = block;
+          arena->block_next = (guint8 *)(block + 1);
+          arena->block_end = arena->block_next + OT_ARENA_BLOCK_N_ELTS * arena->elt_size;
+          arena->n_blocks++;
+        }
+      ret = arena->block_next;
+      arena->block_next += arena->elt_size;
+    }
+
+  arena->n_allocated++;
+  arena->n_live++;
+  if (arena->n_live > arena->n_live_peak)
+    arena->n_live_peak = arena->n_live;
+
+  g_mutex_unlock (&arena->lock);
+
+  return memset (ret, 0, arena->elt_size);
+}
+
+/* Return @elt to the arena for reuse; the storage is only released to
+ * the system by ot_arena_free().
+ */
+void
+ot_arena_free_one (OtArena *arena, gpointer elt)
+{
+  OtArenaFreeNode *node = elt;
+
+  g_mutex_lock (&arena->lock);
+  node->next = arena->freelist;
+  arena->freelist = node;
+  g_assert (arena->n_live > 0);
+  arena->n_live--;
+  g_mutex_unlock (&arena->lock);
+}
+
+void
+ot_arena_get_stats (OtArena *arena, guint64 *out_n_allocated, guint64 *out_n_live,
+                    guint64 *out_n_live_peak, guint64 *out_bytes_retained)
+{
+  g_mutex_lock (&arena->lock);
+  if (out_n_allocated != NULL)
+    *out_n_allocated = arena->n_allocated;
+  if (out_n_live != NULL)
+    *out_n_live = arena->n_live;
+  if (out_n_live_peak != NULL)
+    *out_n_live_peak = arena->n_live_peak;
+  if (out_bytes_retained != NULL)
+    *out_bytes_retained
+        = arena->n_blocks * (sizeof (OtArenaBlock) + OT_ARENA_BLOCK_N_ELTS * arena->elt_size);
+  g_mutex_unlock (&arena->lock);
+}
+
+/* Frees all blocks wholesale; any record still handed out becomes
+ * invalid, so this must run after the last ot_arena_free_one().
+ */
+void
+ot_arena_free (OtArena *arena)
+{
+  if (arena == NULL)
+    return;
+
+  g_debug ("arena %s: %" G_GUINT64_FORMAT " allocations, peak %" G_GUINT64_FORMAT
+           " live, %" G_GUINT64_FORMAT " blocks of %" G_GSIZE_FORMAT " records",
+           arena->name, arena->n_allocated, arena->n_live_peak, arena->n_blocks,
+           (gsize)OT_ARENA_BLOCK_N_ELTS);
+
+  OtArenaBlock *block = arena->blocks;
+  while (block != NULL)
+    {
+      OtArenaBlock *next = block->next;
+      g_free (block);
+      block = next;
+    }
+  g_mutex_clear (&arena->lock);
+  g_free (arena->name);
+  g_free (arena);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "libglnx.h"
+
+G_BEGIN_DECLS
+
+/* A slab allocator for fixed-size records with a bounded lifetime, such
+ * as the per-object bookkeeping structs of a pull.  Records are carved
+ * out of large blocks, individual frees go onto a free list for reuse,
+ * and the blocks themselves are only returned to the system when the
+ * arena is freed.  Compared to malloc/free per record this avoids
+ * allocator lock traffic on hot paths and keeps peak memory use
+ * predictable; allocation statistics are logged via g_debug() when the
+ * arena is freed and available through ot_arena_get_stats().
+ */
+typedef struct OtArena OtArena;
+
+OtArena *ot_arena_new (const char *name, gsize elt_size);
+
+gpointer ot_arena_alloc0 (OtArena *arena);
+
+void ot_arena_free_one (OtArena *arena, gpointer elt);
+
+void ot_arena_get_stats (OtArena *arena, guint64 *out_n_allocated, guint64 *out_n_live,
+                         guint64 *out_n_live_peak, guint64 *out_bytes_retained);
+
+void ot_arena_free (OtArena *arena);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (OtArena, ot_arena_free)
+
+G_END_DECLS
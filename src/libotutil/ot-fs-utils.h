@@ -78,4 +78,7 @@ gboolean ot_parse_file_by_line (const char *path, gboolean (*cb) (const char *,
 gboolean ot_get_dir_size (int dfd, const char *path, guint64 *out_size, GCancellable *cancellable,
                           GError **error);
 
+gboolean ot_rm_rf_parallel_at (int dfd, const char *path, GCancellable *cancellable,
+                               GError **error);
+
 G_END_DECLS
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "ot-object-status-table.h"
+
+/* One slot: the binary checksum, the object type, and the status byte. A slot
+ * with objtype 0 is empty — valid OSTree object types start at 1. Slots are
+ * probed linearly; since SHA256 output is uniformly distributed, the first
+ * bytes of the checksum make a perfectly good hash with no further mixing. */
+typedef struct
+{
+  guint8 csum[_OSTREE_SHA256_DIGEST_LEN];
+  guint8 objtype;
+  guint8 status;
+} OtObjectStatusEntry;
+
+struct OtObjectStatusTable
+{
+  OtObjectStatusEntry *entries;
+  gsize capacity; /* Always a power of two */
+  gsize n_occupied;
+};
+
+/* Sized for a small pull out of the gate; one resize doubles it. */
+#define OBJECT_STATUS_TABLE_INITIAL_CAPACITY 1024
+
+OtObjectStatusTable *
+ot_object_status_table_new (void)
+{
+  OtObjectStatusTable *table = g_new0 (OtObjectStatusTable, 1);
+  table->capacity = OBJECT_STATUS_TABLE_INITIAL_CAPACITY;
+  table->entries = g_new0 (OtObjectStatusEntry, table->capacity);
+  return table;
+}
+
+void
+ot_object_status_table_free (OtObjectStatusTable *table)
+{
+  g_free (table->entries);
+  g_free (table);
+}
+
+static inline gsize
+entry_hash (const guint8 *csum)
+{
+  gsize h;
+  memcpy (&h, csum, sizeof (h));
+  return h;
+}
+
+/* Find the slot for (@csum, @objtype): either the occupied slot holding it, or
+ * the empty slot where it would be inserted. */
+static OtObjectStatusEntry *
+lookup_slot (OtObjectStatusTable *table, const guint8 *csum, guint8 objtype)
+{
+  gsize mask = table->capacity - 1;
+  gsize i = (entry_hash (csum) ^ objtype) & mask;
+
+  while (TRUE)
+    {
+      OtObjectStatusEntry *entry = &table->entries[i];
+      if (entry->objtype == 0
+          || (entry->objtype == objtype
+              && memcmp (entry->csum, csum, _OSTREE_SHA256_DIGEST_LEN) == 0))
+        return entry;
+      i = (i + 1) & mask;
+    }
+}
+
+static void
+maybe_grow (OtObjectStatusTable *table)
+{
+  /* Resize at 3/4 load to keep probe sequences short. */
+  if (table->n_occupied < table->capacity - table->capacity / 4)
+    return;
+
+  OtObjectStatusEntry *old_entries = table->entries;
+  gsize old_capacity = table->capacity;
+
+  table->capacity *= 2;
+  table->entries = g_new0 (OtObjectStatusEntry, table->capacity);
+
+  for (gsize i = 0; i < old_capacity; i++)
+    {
+      const OtObjectStatusEntry *old_entry = &old_entries[i];
+      if (old_entry->objtype == 0)
+        continue;
+      *lookup_slot (table, old_entry->csum, old_entry->objtype) = *old_entry;
+    }
+
+  g_free (old_entries);
+}
+
+/* Return the status bits recorded for the object, or 0 if it has none. */
+guint8
+ot_object_status_table_get (OtObjectStatusTable *table,
+                            const guint8 csum[_OSTREE_SHA256_DIGEST_LEN], guint8 objtype)
+{
+  return lookup_slot (table, csum, objtype)->status;
+}
+
+/* OR @status_bits into the object's status, inserting it if necessary.
+ * @status_bits must be nonzero, and @objtype must be a valid (nonzero)
+ * object type. */
+void
+ot_object_status_table_set (OtObjectStatusTable *table,
+                            const guint8 csum[_OSTREE_SHA256_DIGEST_LEN], guint8 objtype,
+                            guint8 status_bits)
+{
+  g_assert (objtype != 0);
+  g_assert (status_bits != 0);
+
+  OtObjectStatusEntry *entry = lookup_slot (table, csum, objtype);
+  if (entry->objtype == 0)
+    {
+      memcpy (entry->csum, csum, _OSTREE_SHA256_DIGEST_LEN);
+      entry->objtype = objtype;
+      table->n_occupied++;
+      entry->status = status_bits;
+      maybe_grow (table);
+      return;
+    }
+  entry->status |= status_bits;
+}
+
+/* Clear @status_bits from the object's status. Returns %TRUE if any of the
+ * bits were previously set. The entry is kept even if its status drops to
+ * zero, so the slot stays valid for probing. */
+gboolean
+ot_object_status_table_clear (OtObjectStatusTable *table,
+                              const guint8 csum[_OSTREE_SHA256_DIGEST_LEN], guint8 objtype,
+                              guint8 status_bits)
+{
+  OtObjectStatusEntry *entry = lookup_slot (table, csum, objtype);
+  gboolean was_set = (entry->status & status_bits) != 0;
+  entry->status &= ~status_bits;
+  return was_set;
+}
+
+/* Number of distinct objects with an entry in the table. */
+guint
+ot_object_status_table_size (OtObjectStatusTable *table)
+{
+  return table->n_occupied;
+}
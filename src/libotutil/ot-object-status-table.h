@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ot-checksum-utils.h"
+#include "libglnx.h"
+
+G_BEGIN_DECLS
+
+/* A compact open-addressing table mapping (binary SHA256 checksum, object
+ * type) to a byte of caller-defined status bits. Compared to a GHashTable
+ * keyed by checksum strings or object-name variants, entries are stored
+ * inline in one flat allocation — no per-entry heap objects — which both
+ * shrinks memory use several-fold for large object sets and keeps probes
+ * cache-friendly. */
+typedef struct OtObjectStatusTable OtObjectStatusTable;
+
+OtObjectStatusTable *ot_object_status_table_new (void);
+
+void ot_object_status_table_free (OtObjectStatusTable *table);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (OtObjectStatusTable, ot_object_status_table_free)
+
+guint8 ot_object_status_table_get (OtObjectStatusTable *table,
+                                   const guint8 csum[_OSTREE_SHA256_DIGEST_LEN], guint8 objtype);
+
+void ot_object_status_table_set (OtObjectStatusTable *table,
+                                 const guint8 csum[_OSTREE_SHA256_DIGEST_LEN], guint8 objtype,
+                                 guint8 status_bits);
+
+gboolean ot_object_status_table_clear (OtObjectStatusTable *table,
+                                       const guint8 csum[_OSTREE_SHA256_DIGEST_LEN],
+                                       guint8 objtype, guint8 status_bits);
+
+guint ot_object_status_table_size (OtObjectStatusTable *table);
+
+G_END_DECLS
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "ot-thread-pool.h"
+
+struct OtThreadPool
+{
+  char *name;
+  GThreadPool *pool;
+  GFunc func;
+  gpointer user_data;
+
+  GMutex lock;
+  guint64 n_dispatched;
+  guint64 busy_usec;
+};
+
+/* The default affinity mask applies to every pool in the process; it is
+ * normally configured once from the repository config before any pools
+ * exist.  Each worker thread applies it at most once, tracked by the
+ * thread-local flag below (worker threads are created unpinned, inheriting
+ * the main thread's mask).
+ */
+static GMutex default_affinity_lock;
+static gboolean default_affinity_set;
+static cpu_set_t default_affinity;
+
+static GPrivate affinity_applied = G_PRIVATE_INIT (NULL);
+
+/**
+ * ot_thread_pool_set_default_affinity:
+ * @cpuspec: A CPU list such as "0-7" or "0-3,16-19", or %NULL/"" to clear
+ * @error: Error
+ *
+ * Parse @cpuspec (same syntax as taskset(1) lists) and use it as the CPU
+ * affinity mask for the worker threads of every subsequently used pool.
+ * Threads that already applied an earlier mask are unaffected.
+ */
+gboolean
+ot_thread_pool_set_default_affinity (const char *cpuspec, GError **error)
+{
+  cpu_set_t mask;
+  CPU_ZERO (&mask);
+
+  if (cpuspec != NULL && *cpuspec != '\0')
+    {
+      g_auto (GStrv) ranges = g_strsplit (cpuspec, ",", -1);
+      for (char **iter = ranges; *iter != NULL; iter++)
+        {
+          const char *range = *iter;
+          char *endptr = NULL;
+          guint64 first = g_ascii_strtoull (range, &endptr, 10);
+          guint64 last = first;
+
+          if (endptr == range)
+            return glnx_throw (error, "Invalid CPU list entry '%s'", range);
+          if (*endptr == '-')
+            {
+              const char *lastptr = endptr + 1;
+              last = g_ascii_strtoull (lastptr, &endptr, 10);
+              if (endptr == lastptr)
+                return glnx_throw (error, "Invalid CPU range '%s'", range);
+            }
+          if (*endptr != '\0' || last < first || last >= CPU_SETSIZE)
+            return glnx_throw (error, "Invalid CPU list entry '%s'", range);
+
+          for (guint64 cpu = first; cpu <= last; cpu++)
+            CPU_SET (cpu, &mask);
+        }
+    }
+
+  g_mutex_lock (&default_affinity_lock);
+  default_affinity_set = (CPU_COUNT (&mask) > 0);
+  memcpy (&default_affinity, &mask, sizeof (mask));
+  g_mutex_unlock (&default_affinity_lock);
+  return TRUE;
+}
+
+static void
+maybe_apply_affinity (const char *pool_name)
+{
+  if (g_private_get (&affinity_applied) != NULL)
+    return;
+  g_private_set (&affinity_applied, GUINT_TO_POINTER (1));
+
+  g_mutex_lock (&default_affinity_lock);
+  const gboolean have_mask = default_affinity_set;
+  cpu_set_t mask;
+  memcpy (&mask, &default_affinity, sizeof (mask));
+  g_mutex_unlock (&default_affinity_lock);
+
+  if (!have_mask)
+    return;
+
+  /* Best-effort; the mask may reference CPUs outside our cgroup */
+  int r = pthread_setaffinity_np (pthread_self (), sizeof (mask), &mask);
+  if (r != 0)
+    g_debug ("%s: failed to apply worker CPU affinity: %s", pool_name, g_strerror (r));
+}
+
+static void
+thread_pool_dispatch (gpointer item, gpointer user_data)
+{
+  OtThreadPool *pool = user_data;
+
+  maybe_apply_affinity (pool->name);
+
+  const gint64 start_usec = g_get_monotonic_time ();
+  pool->func (item, pool->user_data);
+  const gint64 end_usec = g_get_monotonic_time ();
+
+  g_mutex_lock (&pool->lock);
+  pool->n_dispatched++;
+  pool->busy_usec += end_usec - start_usec;
+  g_mutex_unlock (&pool->lock);
+}
+
+/**
+ * ot_thread_pool_new:
+ * @name: Short identifier used in debug output
+ * @func: Worker function, invoked once per pushed item
+ * @user_data: Passed as the second argument of @func
+ * @n_threads: Number of worker threads
+ *
+ * Like g_thread_pool_new(), but the workers honor the process-wide
+ * affinity mask and the pool records dispatch statistics.
+ */
+OtThreadPool *
+ot_thread_pool_new (const char *name, GFunc func, gpointer user_data, guint n_threads)
+{
+  OtThreadPool *pool = g_new0 (OtThreadPool, 1);
+
+  pool->name = g_strdup (name);
+  pool->func = func;
+  pool->user_data = user_data;
+  g_mutex_init (&pool->lock);
+  pool->pool = g_thread_pool_new (thread_pool_dispatch, pool, n_threads, FALSE, NULL);
+  return pool;
+}
+
+void
+ot_thread_pool_push (OtThreadPool *pool, gpointer item)
+{
+  g_thread_pool_push (pool->pool, item, NULL);
+}
+
+/* Number of items pushed but not yet picked up by a worker */
+guint
+ot_thread_pool_unprocessed (OtThreadPool *pool)
+{
+  return g_thread_pool_unprocessed (pool->pool);
+}
+
+void
+ot_thread_pool_get_stats (OtThreadPool *pool, guint64 *out_n_dispatched, guint64 *out_busy_usec)
+{
+  g_mutex_lock (&pool->lock);
+  if (out_n_dispatched != NULL)
+    *out_n_dispatched = pool->n_dispatched;
+  if (out_busy_usec != NULL)
+    *out_busy_usec = pool->busy_usec;
+  g_mutex_unlock (&pool->lock);
+}
+
+/* Waits for all queued items to be processed, then frees the pool */
+void
+ot_thread_pool_free (OtThreadPool *pool)
+{
+  if (pool == NULL)
+    return;
+
+  g_thread_pool_free (pool->pool, FALSE, TRUE);
+  g_debug ("thread pool %s: %" G_GUINT64_FORMAT " items dispatched, %" G_GUINT64_FORMAT
+           "ms busy",
+           pool->name, pool->n_dispatched, pool->busy_usec / 1000);
+  g_mutex_clear (&pool->lock);
+  g_free (pool->name);
+  g_free (pool);
+}
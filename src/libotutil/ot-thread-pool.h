@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "libglnx.h"
+
+G_BEGIN_DECLS
+
+/* A thin wrapper around GThreadPool shared by all of our parallel code
+ * paths (commit prehashing, checkout, diff, prune traversal, archive
+ * import).  On top of GThreadPool it provides:
+ *
+ *  - an optional process-wide CPU affinity mask, applied lazily to each
+ *    worker thread.  On multi-socket machines pinning the workers keeps
+ *    the kernel's first-touch policy allocating their memory on the
+ *    local NUMA node, avoiding cross-socket traffic;
+ *  - per-pool dispatch statistics, logged via g_debug() when the pool
+ *    is freed.
+ */
+typedef struct OtThreadPool OtThreadPool;
+
+OtThreadPool *ot_thread_pool_new (const char *name, GFunc func, gpointer user_data,
+                                  guint n_threads);
+
+void ot_thread_pool_push (OtThreadPool *pool, gpointer item);
+
+guint ot_thread_pool_unprocessed (OtThreadPool *pool);
+
+void ot_thread_pool_get_stats (OtThreadPool *pool, guint64 *out_n_dispatched,
+                               guint64 *out_busy_usec);
+
+void ot_thread_pool_free (OtThreadPool *pool);
+
+gboolean ot_thread_pool_set_default_affinity (const char *cpuspec, GError **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (OtThreadPool, ot_thread_pool_free)
+
+G_END_DECLS
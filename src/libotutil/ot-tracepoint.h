@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* USDT static tracepoints for the hot paths, so tools like bpftrace and
+ * perf can attach to production binaries without rebuilding, e.g.:
+ *
+ *   bpftrace -e 'usdt:/usr/lib/libostree-1.so.1:ostree:fetcher_request_start { ... }'
+ *
+ * Probes are in the "ostree" provider.  The probe names and their
+ * argument lists are stable interfaces; extend the argument list only at
+ * the end, and never rename an existing probe.  Current probes:
+ *
+ *   fetcher_request_start (url)            - HTTP request handed to curl
+ *   fetcher_request_done (url, curl_code)  - HTTP request completed
+ *   pull_scan_metadata (checksum, objtype) - pull scanning one metadata object
+ *   commit_write_content_object (checksum, size) - content object written
+ *   delta_part_apply (size)                - static delta part execution start
+ *   checkout_file (checksum)               - checking out one content file
+ *
+ * Compiled to no-ops when <sys/sdt.h> (systemtap-sdt-devel) isn't
+ * available at build time.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define ot_tracepoint(name) DTRACE_PROBE (ostree, name)
+#define ot_tracepoint1(name, a1) DTRACE_PROBE1 (ostree, name, a1)
+#define ot_tracepoint2(name, a1, a2) DTRACE_PROBE2 (ostree, name, a1, a2)
+#define ot_tracepoint3(name, a1, a2, a3) DTRACE_PROBE3 (ostree, name, a1, a2, a3)
+
+#else
+
+/* The casts keep "set but only used for tracing" variables warning-free
+ * without evaluating anything at runtime.
+ */
+#define ot_tracepoint(name) \
+  do \
+    { \
+    } \
+  while (0)
+#define ot_tracepoint1(name, a1) \
+  do \
+    { \
+      (void)(a1); \
+    } \
+  while (0)
+#define ot_tracepoint2(name, a1, a2) \
+  do \
+    { \
+      (void)(a1); \
+      (void)(a2); \
+    } \
+  while (0)
+#define ot_tracepoint3(name, a1, a2, a3) \
+  do \
+    { \
+      (void)(a1); \
+      (void)(a2); \
+      (void)(a3); \
+    } \
+  while (0)
+
+#endif
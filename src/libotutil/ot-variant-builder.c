@@ -724,6 +724,16 @@ struct _OtVariantBuilderInfo
   guint uniform_item_types : 1;
 };
 
+/* A fixed-size child whose bytes were written as zeros, to be patched
+ * with the real value later via pwrite(); see ot_variant_builder_reserve().
+ */
+typedef struct
+{
+  guint64 fd_offset; /* absolute offset of the slot's bytes in the fd */
+  GVariantType *type;
+  gsize size;
+} OtVariantBuilderReservedSlot;
+
 struct _OtVariantBuilder
 {
   gint ref_count;
@@ -733,6 +743,8 @@ struct _OtVariantBuilder
    * of the builder stack. Public APIs take the topmost builder reference
    * and use this to find the currently active builder */
   OtVariantBuilderInfo *head;
+
+  GArray *reserved_slots; /* of OtVariantBuilderReservedSlot */
 };
 
 static OtVariantBuilderInfo *
@@ -823,6 +835,7 @@ ot_variant_builder_new (const GVariantType *type, int fd)
   builder->head = ot_variant_builder_info_new (builder, type);
   builder->ref_count = 1;
   builder->fd = fd;
+  builder->reserved_slots = g_array_new (FALSE, TRUE, sizeof (OtVariantBuilderReservedSlot));
 
   return builder;
 }
@@ -834,6 +847,10 @@ ot_variant_builder_unref (OtVariantBuilder *builder)
     return;
 
   ot_variant_builder_info_free (builder->head);
+  for (guint i = 0; i < builder->reserved_slots->len; i++)
+    g_variant_type_free (
+        g_array_index (builder->reserved_slots, OtVariantBuilderReservedSlot, i).type);
+  g_array_unref (builder->reserved_slots);
 
   g_slice_free (OtVariantBuilder, builder);
 }
@@ -1008,6 +1025,92 @@ ot_variant_builder_add_value (OtVariantBuilder *builder, GVariant *value, GError
   return TRUE;
 }
 
+/* Reserve space for a fixed-size child of @type, writing zeros for now, and
+ * return its slot index in @out_slot.  Streaming then continues normally;
+ * the real value is patched in later with
+ * ot_variant_builder_write_reserved(), which may happen at any point up to
+ * unref, including after ot_variant_builder_end().  This enables
+ * single-pass streaming of containers with leading size or count fields
+ * that are only known once the rest of the data has been written.
+ *
+ * The fd must be seekable and writable via pwrite().
+ */
+gboolean
+ot_variant_builder_reserve (OtVariantBuilder *builder, const GVariantType *type, guint *out_slot,
+                            GError **error)
+{
+  OtVariantBuilderInfo *info = builder->head;
+
+  g_return_val_if_fail (info->n_children < info->max_items, FALSE);
+  g_return_val_if_fail (
+      !info->expected_type || g_variant_type_is_subtype_of (type, info->expected_type), FALSE);
+  g_return_val_if_fail (
+      !info->prev_item_type || g_variant_type_is_subtype_of (info->prev_item_type, type), FALSE);
+
+  GVariantTypeInfo *type_info = g_variant_type_info_get (type);
+  const gsize fixed_size = type_info->fixed_size;
+  g_variant_type_info_unref (type_info);
+  if (fixed_size == 0)
+    return glnx_throw (error, "can only reserve fixed-size types, not %s", (char *)type);
+
+  if (!ot_variant_builder_pre_add (info, type, error))
+    return FALSE;
+
+  /* Alignment padding is done; this is where the slot's bytes live */
+  const off_t fd_offset = lseek (builder->fd, 0, SEEK_CUR);
+  if (fd_offset < 0)
+    return glnx_throw_errno_prefix (error, "lseek");
+
+  g_autofree guchar *zeros = g_malloc0 (fixed_size);
+  if (glnx_loop_write (builder->fd, zeros, fixed_size) < 0)
+    return glnx_throw_errno (error);
+
+  if (!ot_variant_builder_post_add (info, type, fixed_size, error))
+    return FALSE;
+
+  OtVariantBuilderReservedSlot slot
+      = { (guint64)fd_offset, g_variant_type_copy (type), fixed_size };
+  g_array_append_val (builder->reserved_slots, slot);
+  if (out_slot)
+    *out_slot = builder->reserved_slots->len - 1;
+
+  return TRUE;
+}
+
+/* Patch the final value of a slot from ot_variant_builder_reserve().
+ * @value must be of the exact type the slot was reserved with; as with
+ * ot_variant_builder_add_value(), byte order is the caller's concern.
+ */
+gboolean
+ot_variant_builder_write_reserved (OtVariantBuilder *builder, guint slot_index, GVariant *value,
+                                   GError **error)
+{
+  /* We ref-sink value, just like g_variant_builder_add_value does */
+  g_autoptr (GVariant) keep_around_until_return G_GNUC_UNUSED = g_variant_ref_sink (value);
+
+  g_return_val_if_fail (slot_index < builder->reserved_slots->len, FALSE);
+  OtVariantBuilderReservedSlot *slot
+      = &g_array_index (builder->reserved_slots, OtVariantBuilderReservedSlot, slot_index);
+  g_return_val_if_fail (g_variant_is_of_type (value, slot->type), FALSE);
+  g_assert_cmpuint (g_variant_get_size (value), ==, slot->size);
+
+  const guchar *data = g_variant_get_data (value);
+  gsize remaining = slot->size;
+  guint64 offset = slot->fd_offset;
+  while (remaining > 0)
+    {
+      const gssize bytes_written
+          = TEMP_FAILURE_RETRY (pwrite (builder->fd, data, remaining, (off_t)offset));
+      if (bytes_written < 0)
+        return glnx_throw_errno_prefix (error, "pwrite");
+      data += bytes_written;
+      offset += bytes_written;
+      remaining -= bytes_written;
+    }
+
+  return TRUE;
+}
+
 gboolean
 ot_variant_builder_add (OtVariantBuilder *builder, GError **error, const gchar *format_string, ...)
 {
@@ -41,6 +41,10 @@ gboolean ot_variant_builder_add_from_fd (OtVariantBuilder *builder, const GVaria
 gboolean ot_variant_builder_add_value (OtVariantBuilder *builder, GVariant *value, GError **error);
 gboolean ot_variant_builder_add (OtVariantBuilder *builder, GError **error,
                                  const gchar *format_string, ...);
+gboolean ot_variant_builder_reserve (OtVariantBuilder *builder, const GVariantType *type,
+                                     guint *out_slot, GError **error);
+gboolean ot_variant_builder_write_reserved (OtVariantBuilder *builder, guint slot_index,
+                                            GVariant *value, GError **error);
 void ot_variant_builder_add_parsed (OtVariantBuilder *builder, const gchar *format, ...);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (OtVariantBuilder, ot_variant_builder_unref)
@@ -104,13 +104,17 @@ _ostree_main_context_new_default (void)
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (GMainContextPopDefault, _ostree_main_context_pop_default_destroy)
 
+#include <ot-arena.h>
 #include <ot-checksum-instream.h>
 #include <ot-checksum-utils.h>
 #include <ot-fs-utils.h>
 #include <ot-gio-utils.h>
 #include <ot-keyfile-utils.h>
+#include <ot-object-status-table.h>
 #include <ot-opt-utils.h>
+#include <ot-thread-pool.h>
 #include <ot-tool-util.h>
+#include <ot-tracepoint.h>
 #include <ot-unix-utils.h>
 #include <ot-variant-builder.h>
 #include <ot-variant-utils.h>
@@ -42,9 +42,13 @@ static OstreeCommand commands[] = {
     "Check out a commit into a filesystem tree" },
   { "checksum", OSTREE_BUILTIN_FLAG_NO_REPO, ostree_builtin_checksum,
     "Checksum a file or directory" },
+  { "chunk", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_chunk,
+    "Split large content objects into content-defined chunks" },
   { "commit", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_commit, "Commit a new revision" },
   { "config", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_config,
     "Change repo configuration settings" },
+  { "defrag", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_defrag,
+    "Rewrite fragmented loose objects" },
   { "diff", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_diff,
     "Compare directory TARGETDIR against revision REV" },
   { "export", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_export,
@@ -61,12 +65,16 @@ static OstreeCommand commands[] = {
     "Initialize a new empty repository" },
   { "log", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_log, "Show log starting at commit or ref" },
   { "ls", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_ls, "List file paths" },
+  { "migrate-fanout", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_migrate_fanout,
+    "Move loose objects to the configured fanout layout" },
   { "prune", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_prune, "Search for unreachable objects" },
   { "pull-local", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_pull_local, "Copy data from SRC_REPO" },
 #ifdef HAVE_LIBCURL_OR_LIBSOUP
   { "pull", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_pull, "Download data from remote repository" },
 #endif
   { "refs", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_refs, "List refs" },
+  { "repack", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_repack,
+    "Consolidate loose objects into pack files" },
   { "remote", OSTREE_BUILTIN_FLAG_NO_REPO, ostree_builtin_remote,
     "Remote commands that may involve internet access" },
   { "reset", OSTREE_BUILTIN_FLAG_NONE, ostree_builtin_reset, "Reset a REF to a previous COMMIT" },
@@ -62,18 +62,20 @@ static int opt_random_500s_max = 100;
 static int opt_random_408s_percentage;
 static int opt_random_408s_max = 100;
 static gint opt_port = 0;
+static gint opt_threads = 1;
 static gchar **opt_expected_cookies;
 static gchar **opt_expected_headers;
 static gboolean opt_require_basic_auth;
 
-static guint emitted_random_500s_count = 0;
-static guint emitted_random_408s_count = 0;
+static gint emitted_random_500s_count = 0;
+static gint emitted_random_408s_count = 0;
 
 typedef struct
 {
   int root_dfd;
   gboolean running;
   GOutputStream *log;
+  GMutex log_lock; /* Serializes log writes from server threads */
 } OtTrivialHttpd;
 
 /* ATTENTION:
@@ -87,6 +89,8 @@ static GOptionEntry options[]
         { "autoexit", 0, 0, G_OPTION_ARG_NONE, &opt_autoexit,
           "Automatically exit when directory is deleted", NULL },
         { "port", 'P', 0, G_OPTION_ARG_INT, &opt_port, "Use the specified TCP port", "PORT" },
+        { "threads", 0, 0, G_OPTION_ARG_INT, &opt_threads,
+          "Accept connections on N server threads (-1 for one per processor; default 1)", "N" },
         { "port-file", 'p', 0, G_OPTION_ARG_FILENAME, &opt_port_file,
           "Write port number to PATH (- for standard output)", "PATH" },
         { "force-range-requests", 0, 0, G_OPTION_ARG_NONE, &opt_force_ranges,
@@ -133,7 +137,9 @@ httpd_log (OtTrivialHttpd *httpd, const gchar *format, ...)
   g_string_append_vprintf (str, format, args);
   va_end (args);
 
+  g_mutex_lock (&httpd->log_lock);
   (void)g_output_stream_write_all (httpd->log, str->str, str->len, &written, NULL, NULL);
+  g_mutex_unlock (&httpd->log_lock);
 }
 
 static int
@@ -360,17 +366,19 @@ do_get (OtTrivialHttpd *self, SoupServer *server, SoupServerMessage *msg, const
       goto out;
     }
 
-  if (opt_random_500s_percentage > 0 && emitted_random_500s_count < opt_random_500s_max
+  if (opt_random_500s_percentage > 0
+      && g_atomic_int_get (&emitted_random_500s_count) < opt_random_500s_max
       && g_random_int_range (0, 100) < opt_random_500s_percentage)
     {
-      emitted_random_500s_count++;
+      g_atomic_int_inc (&emitted_random_500s_count);
       soup_server_message_set_status (msg, SOUP_STATUS_INTERNAL_SERVER_ERROR);
       goto out;
     }
-  else if (opt_random_408s_percentage > 0 && emitted_random_408s_count < opt_random_408s_max
+  else if (opt_random_408s_percentage > 0
+           && g_atomic_int_get (&emitted_random_408s_count) < opt_random_408s_max
            && g_random_int_range (0, 100) < opt_random_408s_percentage)
     {
-      emitted_random_408s_count++;
+      g_atomic_int_inc (&emitted_random_408s_count);
       soup_server_message_set_status (msg, SOUP_STATUS_REQUEST_TIMEOUT);
       goto out;
     }
@@ -538,9 +546,13 @@ do_get (OtTrivialHttpd *self, SoupServer *server, SoupServerMessage *msg, const
             }
           else if (buffer_length > 0)
             {
-              gchar *contents = g_mapped_file_get_contents (mapping);
-              soup_message_body_append (soup_server_message_get_response_body (msg),
-                                        SOUP_MEMORY_COPY, contents, buffer_length);
+              /* Slice the mapping rather than copying it into the heap; the
+               * response then references the page cache directly.
+               */
+              g_autoptr (GBytes) mapped = g_mapped_file_get_bytes (mapping);
+              GBytes *bytes = g_bytes_new_from_bytes (mapped, 0, buffer_length);
+              soup_message_body_append_bytes (soup_server_message_get_response_body (msg), bytes);
+              g_bytes_unref (bytes);
             }
 #endif
         }
@@ -650,6 +662,88 @@ basic_auth_callback (SoupAuthDomain *auth_domain, SoupServerMessage *msg, const
   return g_str_equal (username, "foouser") && g_str_equal (password, "barpw");
 }
 
+/* Add the auth domain and request handler shared by every server instance */
+static void
+setup_server (OtTrivialHttpd *app, SoupServer *server)
+{
+  if (opt_require_basic_auth)
+    {
+#if !SOUP_CHECK_VERSION(3, 0, 0)
+      glnx_unref_object SoupAuthDomain *auth_domain = soup_auth_domain_basic_new (
+          SOUP_AUTH_DOMAIN_REALM, "auth-test", SOUP_AUTH_DOMAIN_ADD_PATH, "/",
+          SOUP_AUTH_DOMAIN_BASIC_AUTH_CALLBACK, basic_auth_callback, NULL);
+#else
+      glnx_unref_object SoupAuthDomain *auth_domain
+          = soup_auth_domain_basic_new ("realm", "auth-test", NULL);
+      soup_auth_domain_add_path (auth_domain, "/");
+      soup_auth_domain_basic_set_auth_callback (auth_domain, basic_auth_callback, NULL, NULL);
+#endif
+      soup_server_add_auth_domain (server, auth_domain);
+    }
+
+  soup_server_add_handler (server, NULL, httpd_callback, app, NULL);
+}
+
+#if SOUP_CHECK_VERSION(2, 48, 0)
+/* Create a TCP listener bound with SO_REUSEPORT, so that every server
+ * thread can own an identical listening socket and the kernel distributes
+ * incoming connections across them.
+ */
+static GSocket *
+create_reuseport_listener (guint16 port, GError **error)
+{
+  g_autoptr (GSocket) sock
+      = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, error);
+  if (sock == NULL)
+    return NULL;
+
+  int one = 1;
+  if (setsockopt (g_socket_get_fd (sock), SOL_SOCKET, SO_REUSEPORT, &one, sizeof one) < 0)
+    return glnx_null_throw_errno_prefix (error, "setsockopt(SO_REUSEPORT)");
+
+  g_autoptr (GInetAddress) anyaddr = g_inet_address_new_any (G_SOCKET_FAMILY_IPV4);
+  g_autoptr (GSocketAddress) bindaddr = g_inet_socket_address_new (anyaddr, port);
+  if (!g_socket_bind (sock, bindaddr, TRUE, error))
+    return NULL;
+  if (!g_socket_listen (sock, error))
+    return NULL;
+
+  return g_steal_pointer (&sock);
+}
+
+typedef struct
+{
+  OtTrivialHttpd *app; /* unowned */
+  guint16 port;
+} HttpdWorker;
+
+/* Each worker owns a private SoupServer and GMainContext; the only state
+ * shared with other threads is the root dirfd (read-only), the log stream
+ * (serialized by log_lock), and the error-injection counters (atomic).
+ */
+static gpointer
+httpd_worker_thread (gpointer data)
+{
+  g_autofree HttpdWorker *worker = data;
+  g_autoptr (GError) local_error = NULL;
+  g_autoptr (GMainContext) context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+
+  glnx_unref_object SoupServer *server = soup_server_new ("server-header", "ostree-httpd ", NULL);
+  setup_server (worker->app, server);
+
+  g_autoptr (GSocket) listener = create_reuseport_listener (worker->port, &local_error);
+  if (listener == NULL || !soup_server_listen_socket (server, listener, 0, &local_error))
+    errx (1, "worker failed to listen: %s", local_error->message);
+
+  /* Runs until the process exits */
+  while (TRUE)
+    g_main_context_iteration (context, TRUE);
+
+  return NULL;
+}
+#endif
+
 static void
 on_dir_changed (GFileMonitor *mon, GFile *file, GFile *other, GFileMonitorEvent event,
                 gpointer user_data)
@@ -682,6 +776,7 @@ run (int argc, char **argv, GCancellable *cancellable, GError **error)
   g_option_context_add_main_entries (context, options, NULL);
 
   app->root_dfd = -1;
+  g_mutex_init (&app->log_lock);
 
   if (!g_option_context_parse (context, &argc, &argv, error))
     goto out;
@@ -708,6 +803,9 @@ run (int argc, char **argv, GCancellable *cancellable, GError **error)
       goto out;
     }
 
+  if (opt_threads < 0)
+    opt_threads = g_get_num_processors ();
+
   if (opt_daemonize && (g_strcmp0 (opt_log, "-") == 0))
     {
       ot_util_usage_error (context, "Cannot use --log-file=- and --daemonize at the same time",
@@ -807,30 +905,48 @@ run (int argc, char **argv, GCancellable *cancellable, GError **error)
     }
 
 #if SOUP_CHECK_VERSION(2, 48, 0)
+  guint16 bound_port = 0;
   server = soup_server_new ("server-header", "ostree-httpd ", NULL);
-  if (!soup_server_listen_all (server, opt_port, 0, error))
+  if (opt_threads > 1)
+    {
+      /* Every server thread owns an identical SO_REUSEPORT listener, so the
+       * primary needs one too rather than soup_server_listen_all().
+       */
+      g_autoptr (GSocket) listener = create_reuseport_listener (opt_port, error);
+      if (listener == NULL)
+        goto out;
+      if (!soup_server_listen_socket (server, listener, 0, error))
+        goto out;
+      g_autoptr (GSocketAddress) bound_addr = g_socket_get_local_address (listener, error);
+      if (bound_addr == NULL)
+        goto out;
+      g_assert (G_IS_INET_SOCKET_ADDRESS (bound_addr));
+      bound_port = g_inet_socket_address_get_port ((GInetSocketAddress *)bound_addr);
+    }
+  else if (!soup_server_listen_all (server, opt_port, 0, error))
     goto out;
 #else
   server = soup_server_new (SOUP_SERVER_PORT, opt_port, SOUP_SERVER_SERVER_HEADER, "ostree-httpd ",
                             NULL);
 #endif
 
-  if (opt_require_basic_auth)
+  setup_server (app, server);
+
+#if SOUP_CHECK_VERSION(2, 48, 0)
+  if (opt_threads > 1)
     {
-#if !SOUP_CHECK_VERSION(3, 0, 0)
-      glnx_unref_object SoupAuthDomain *auth_domain = soup_auth_domain_basic_new (
-          SOUP_AUTH_DOMAIN_REALM, "auth-test", SOUP_AUTH_DOMAIN_ADD_PATH, "/",
-          SOUP_AUTH_DOMAIN_BASIC_AUTH_CALLBACK, basic_auth_callback, NULL);
-#else
-      glnx_unref_object SoupAuthDomain *auth_domain
-          = soup_auth_domain_basic_new ("realm", "auth-test", NULL);
-      soup_auth_domain_add_path (auth_domain, "/");
-      soup_auth_domain_basic_set_auth_callback (auth_domain, basic_auth_callback, NULL, NULL);
-#endif
-      soup_server_add_auth_domain (server, auth_domain);
+      for (int i = 1; i < opt_threads; i++)
+        {
+          HttpdWorker *worker = g_new0 (HttpdWorker, 1);
+          worker->app = app;
+          worker->port = bound_port;
+          /* Workers run until the process exits; no join needed */
+          g_thread_unref (g_thread_new ("httpd-worker", httpd_worker_thread, worker));
+        }
+      httpd_log (app, "serving with %d threads\n", opt_threads);
     }
+#endif
 
-  soup_server_add_handler (server, NULL, httpd_callback, app, NULL);
   if (opt_port_file)
     {
       g_autofree char *portstr = NULL;
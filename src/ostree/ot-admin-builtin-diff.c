@@ -72,8 +72,10 @@ ot_admin_builtin_diff (int argc, char **argv, OstreeCommandInvocation *invocatio
       = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_diff_item_unref);
   g_autoptr (GPtrArray) removed = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
   g_autoptr (GPtrArray) added = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
-  if (!ostree_diff_dirs (OSTREE_DIFF_FLAGS_IGNORE_XATTRS, orig_etc_path, new_etc_path, modified,
-                         removed, added, cancellable, error))
+  OstreeDiffDirsOptions diff_opts = OSTREE_DIFF_DIRS_OPTIONS_INIT;
+  diff_opts.diff_threads = -1;
+  if (!ostree_diff_dirs_with_options (OSTREE_DIFF_FLAGS_IGNORE_XATTRS, orig_etc_path, new_etc_path,
+                                      modified, removed, added, &diff_opts, cancellable, error))
     return FALSE;
 
   ostree_diff_print (orig_etc_path, new_etc_path, modified, removed, added);
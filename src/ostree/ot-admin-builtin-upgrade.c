@@ -33,6 +33,7 @@
 
 static gboolean opt_reboot;
 static gboolean opt_allow_downgrade;
+static gboolean opt_check;
 static gboolean opt_pull_only;
 static gboolean opt_deploy_only;
 static gboolean opt_stage;
@@ -47,6 +48,8 @@ static GOptionEntry options[] = {
     "Permit deployment of chronologically older trees", NULL },
   { "override-commit", 0, 0, G_OPTION_ARG_STRING, &opt_override_commit,
     "Deploy CHECKSUM instead of the latest tree", "CHECKSUM" },
+  { "check", 0, 0, G_OPTION_ARG_NONE, &opt_check,
+    "Check whether an update is available without downloading it", NULL },
   { "pull-only", 0, 0, G_OPTION_ARG_NONE, &opt_pull_only,
     "Do not create a deployment, just download", NULL },
   { "deploy-only", 0, 0, G_OPTION_ARG_NONE, &opt_deploy_only, "Do not pull, only deploy", NULL },
@@ -79,6 +82,12 @@ ot_admin_builtin_upgrade (int argc, char **argv, OstreeCommandInvocation *invoca
                    "Cannot simultaneously specify --pull-only and --reboot");
       return FALSE;
     }
+  else if (opt_check && (opt_pull_only || opt_deploy_only || opt_reboot))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Cannot combine --check with --pull-only, --deploy-only or --reboot");
+      return FALSE;
+    }
 
   OstreeSysrootUpgraderFlags flags = 0;
   if (opt_stage)
@@ -104,6 +113,18 @@ ot_admin_builtin_upgrade (int argc, char **argv, OstreeCommandInvocation *invoca
         return FALSE;
     }
 
+  if (opt_check)
+    {
+      gboolean check_changed;
+      if (!ostree_sysroot_upgrader_check (upgrader, &check_changed, cancellable, error))
+        return FALSE;
+      if (check_changed)
+        g_print ("Update available.\n");
+      else
+        g_print ("No update available.\n");
+      return TRUE;
+    }
+
   gboolean changed;
   OstreeSysrootUpgraderPullFlags upgraderpullflags = 0;
   if (opt_deploy_only)
@@ -24,6 +24,7 @@
 #include <gio/gunixinputstream.h>
 #include <string.h>
 
+#include "ostree-cmd-private.h"
 #include "ostree.h"
 #include "ot-builtins.h"
 #include "ot-main.h"
@@ -44,10 +45,12 @@ static gboolean opt_disable_fsync;
 static gboolean opt_require_hardlinks;
 static gboolean opt_force_copy;
 static gboolean opt_force_copy_zerosized;
+static gboolean opt_reflink;
 static gboolean opt_bareuseronly_dirs;
 static char *opt_skiplist_file;
 static char *opt_selinux_policy;
 static char *opt_selinux_prefix;
+static int opt_threads;
 
 static gboolean
 parse_fsync_cb (const char *option_name, const char *value, gpointer data, GError **error)
@@ -99,6 +102,8 @@ static GOptionEntry options[] = {
     "Do not hardlink zero-sized files", NULL },
   { "force-copy", 'C', 0, G_OPTION_ARG_NONE, &opt_force_copy,
     "Never hardlink (but may reflink if available)", NULL },
+  { "reflink", 0, 0, G_OPTION_ARG_NONE, &opt_reflink,
+    "Attempt to reflink (FICLONE) file content instead of copying", NULL },
   { "bareuseronly-dirs", 'M', 0, G_OPTION_ARG_NONE, &opt_bareuseronly_dirs,
     "Suppress mode bits outside of 0775 for directories (suid, world writable, etc.)", NULL },
   { "skip-list", 0, 0, G_OPTION_ARG_FILENAME, &opt_skiplist_file,
@@ -108,6 +113,8 @@ static GOptionEntry options[] = {
     "PATH" },
   { "selinux-prefix", 0, 0, G_OPTION_ARG_STRING, &opt_selinux_prefix,
     "When setting SELinux labels, prefix all paths by PREFIX", "PREFIX" },
+  { "threads", 'j', 0, G_OPTION_ARG_INT, &opt_threads,
+    "Check out subtrees using N worker threads; -1 means one per processor", "N" },
   { NULL }
 };
 
@@ -130,8 +137,11 @@ checkout_filter (OstreeRepo *self, const char *path, struct stat *st_buf, gpoint
 
 static gboolean
 process_one_checkout (OstreeRepo *repo, const char *resolved_commit, const char *subpath,
-                      const char *destination, GCancellable *cancellable, GError **error)
+                      const char *const *destinations, GCancellable *cancellable, GError **error)
 {
+  const char *destination = destinations[0];
+  const gboolean multiple_destinations = destinations[1] != NULL;
+
   /* This strange code structure is to preserve testing
    * coverage of both `ostree_repo_checkout_tree` and
    * `ostree_repo_checkout_at` until such time as we have a more
@@ -140,7 +150,8 @@ process_one_checkout (OstreeRepo *repo, const char *resolved_commit, const char
   if (opt_disable_cache || opt_whiteouts || opt_require_hardlinks || opt_union_add || opt_force_copy
       || opt_force_copy_zerosized || opt_bareuseronly_dirs || opt_union_identical
       || opt_skiplist_file || opt_selinux_policy || opt_selinux_prefix
-      || opt_process_passthrough_whiteouts)
+      || opt_process_passthrough_whiteouts || opt_threads != 0 || opt_reflink
+      || multiple_destinations)
     {
       OstreeRepoCheckoutAtOptions checkout_options = {
         0,
@@ -204,13 +215,24 @@ process_one_checkout (OstreeRepo *repo, const char *resolved_commit, const char
           checkout_options.filter_user_data = skip_list;
         }
 
+      if (opt_threads < 0)
+        checkout_options.checkout_threads = g_get_num_processors ();
+      else
+        checkout_options.checkout_threads = opt_threads;
+
       checkout_options.no_copy_fallback = opt_require_hardlinks;
       checkout_options.force_copy = opt_force_copy;
       checkout_options.force_copy_zerosized = opt_force_copy_zerosized;
+      checkout_options.enable_reflink = opt_reflink;
       checkout_options.bareuseronly_dirs = opt_bareuseronly_dirs;
 
-      if (!ostree_repo_checkout_at (repo, &checkout_options, AT_FDCWD, destination, resolved_commit,
-                                    cancellable, error))
+      /* Checks out once, then fans the result out to any additional
+       * destinations by hardlinking (or copying) from the first checkout.
+       */
+      if (!ostree_cmd__private__ ()->ostree_repo_checkout_at_fanout (repo, &checkout_options,
+                                                                     AT_FDCWD, destinations,
+                                                                     resolved_commit, cancellable,
+                                                                     error))
         return FALSE;
     }
   else
@@ -307,7 +329,8 @@ process_many_checkouts (OstreeRepo *repo, const char *target, GCancellable *canc
       if (!ostree_repo_resolve_rev (repo, revision, FALSE, &resolved_commit, error))
         goto out;
 
-      if (!process_one_checkout (repo, resolved_commit, subpath, target, cancellable, error))
+      const char *const destinations[] = { target, NULL };
+      if (!process_one_checkout (repo, resolved_commit, subpath, destinations, cancellable, error))
         {
           g_prefix_error (error, "Processing tree %s: ", resolved_commit);
           goto out;
@@ -330,7 +353,7 @@ gboolean
 ostree_builtin_checkout (int argc, char **argv, OstreeCommandInvocation *invocation,
                          GCancellable *cancellable, GError **error)
 {
-  g_autoptr (GOptionContext) context = g_option_context_new ("COMMIT [DESTINATION]");
+  g_autoptr (GOptionContext) context = g_option_context_new ("COMMIT [DESTINATION...]");
   g_autoptr (OstreeRepo) repo = NULL;
   if (!ostree_option_context_parse (context, options, &argc, &argv, invocation, &repo, cancellable,
                                     error))
@@ -356,18 +379,25 @@ ostree_builtin_checkout (int argc, char **argv, OstreeCommandInvocation *invocat
   else
     {
       const char *commit = argv[1];
-      const char *destination;
+      /* Multiple destinations check out once and replicate; see
+       * _ostree_repo_checkout_at_fanout().
+       */
+      g_autoptr (GPtrArray) destinations = g_ptr_array_new ();
       if (argc < 3)
-        destination = commit;
+        g_ptr_array_add (destinations, (char *)commit);
       else
-        destination = argv[2];
+        {
+          for (int i = 2; i < argc; i++)
+            g_ptr_array_add (destinations, argv[i]);
+        }
+      g_ptr_array_add (destinations, NULL);
 
       g_autofree char *resolved_commit = NULL;
       if (!ostree_repo_resolve_rev (repo, commit, FALSE, &resolved_commit, error))
         return FALSE;
 
-      if (!process_one_checkout (repo, resolved_commit, opt_subpath, destination, cancellable,
-                                 error))
+      if (!process_one_checkout (repo, resolved_commit, opt_subpath,
+                                 (const char *const *)destinations->pdata, cancellable, error))
         return FALSE;
     }
 
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ostree-cmd-private.h"
+#include "ostree.h"
+#include "ot-builtins.h"
+#include "ot-main.h"
+#include "otutil.h"
+
+static gboolean opt_quiet;
+static int opt_min_size_kb = 1024;
+
+/* ATTENTION:
+ * Please remember to update the bash-completion script (bash/ostree) and
+ * man page (man/ostree-chunk.xml) when changing the option list.
+ */
+
+static GOptionEntry options[]
+    = { { "min-size", 0, 0, G_OPTION_ARG_INT, &opt_min_size_kb,
+          "Only chunk objects at least this size (in kilobytes; default 1024)", "KB" },
+        { "quiet", 'q', 0, G_OPTION_ARG_NONE, &opt_quiet, "Only print error messages", NULL },
+        { NULL } };
+
+gboolean
+ostree_builtin_chunk (int argc, char **argv, OstreeCommandInvocation *invocation,
+                      GCancellable *cancellable, GError **error)
+{
+  g_autoptr (OstreeRepo) repo = NULL;
+
+  g_autoptr (GOptionContext) context = g_option_context_new ("");
+  if (!ostree_option_context_parse (context, options, &argc, &argv, invocation, &repo, cancellable,
+                                    error))
+    return FALSE;
+
+  if (ostree_repo_get_mode (repo) != OSTREE_REPO_MODE_ARCHIVE)
+    return glnx_throw (error, "Chunked storage is only supported in archive mode repositories");
+
+  if (opt_min_size_kb < 0)
+    return glnx_throw (error, "Invalid --min-size value %d", opt_min_size_kb);
+
+  /* Hold the exclusive lock for the whole operation; we're rewriting the
+   * object store layout underneath any concurrent reader.
+   */
+  if (!ostree_repo_lock_push (repo, OSTREE_REPO_LOCK_EXCLUSIVE, cancellable, error))
+    return FALSE;
+
+  g_autoptr (GHashTable) objects = NULL;
+  if (!ostree_repo_list_objects (repo,
+                                 OSTREE_REPO_LIST_OBJECTS_LOOSE | OSTREE_REPO_LIST_OBJECTS_NO_PARENTS,
+                                 &objects, cancellable, error))
+    return FALSE;
+
+  g_autoptr (GPtrArray) to_chunk
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+
+  GLNX_HASH_TABLE_FOREACH (objects, GVariant *, serialized_key)
+    {
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+
+      /* Only content objects are chunked; metadata is better served by
+       * pack files (ostree repack).
+       */
+      if (objtype != OSTREE_OBJECT_TYPE_FILE)
+        continue;
+
+      g_ptr_array_add (to_chunk, g_variant_ref (serialized_key));
+    }
+
+  guint n_chunked = 0;
+  if (to_chunk->len > 0)
+    {
+      if (!ostree_cmd__private__ ()->ostree_repo_chunked_create (
+              repo, to_chunk, (guint64)opt_min_size_kb * 1024, &n_chunked, cancellable, error))
+        return FALSE;
+    }
+
+  if (!ostree_repo_lock_pop (repo, OSTREE_REPO_LOCK_EXCLUSIVE, cancellable, error))
+    return FALSE;
+
+  if (!opt_quiet)
+    g_print ("Chunked %u objects\n", n_chunked);
+
+  return TRUE;
+}
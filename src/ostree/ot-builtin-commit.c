@@ -26,6 +26,7 @@
 #include "ostree-sign.h"
 #include "ostree.h"
 #include "ot-builtins.h"
+#include "ot-dump.h"
 #include "ot-editor.h"
 #include "ot-main.h"
 #include "otutil.h"
@@ -70,6 +71,7 @@ static char *opt_gpg_homedir;
 static char **opt_key_ids;
 static char *opt_sign_name;
 static gboolean opt_generate_sizes;
+static gboolean opt_generate_changelog_stats;
 static gboolean opt_composefs_metadata;
 static gboolean opt_disable_fsync;
 static char *opt_timestamp;
@@ -164,6 +166,8 @@ static GOptionEntry options[] = {
     "Generate size information along with commit metadata", NULL },
   { "generate-composefs-metadata", 0, 0, G_OPTION_ARG_NONE, &opt_composefs_metadata,
     "Generate composefs commit metadata", NULL },
+  { "generate-changelog-stats", 0, 0, G_OPTION_ARG_NONE, &opt_generate_changelog_stats,
+    "Record files added/changed/removed vs the parent as detached commit metadata", NULL },
   { "disable-fsync", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &opt_disable_fsync,
     "Do not invoke fsync()", NULL },
   { "fsync", 0, 0, G_OPTION_ARG_CALLBACK, parse_fsync_cb, "Specify how to invoke fsync()",
@@ -422,6 +426,62 @@ fill_bindings (OstreeRepo *repo, GVariant *metadata, GVariant **out_metadata)
   *out_metadata = g_variant_ref_sink (g_variant_builder_end (metadata_builder));
 }
 
+/* Collect the canonical object streams of content objects up to @max_bytes
+ * each (serialized size, so this includes symlinks) into an
+ * %OSTREE_COMMIT_META_KEY_INLINE_CONTENT variant.  Entries are sorted by
+ * checksum so the result is reproducible.
+ */
+static gboolean
+build_inline_content_metadata (OstreeRepo *repo, const char *commit_checksum, guint64 max_bytes,
+                               GVariant **out_inline_content, GCancellable *cancellable,
+                               GError **error)
+{
+  g_autoptr (GHashTable) reachable = NULL;
+  if (!ostree_repo_traverse_commit (repo, commit_checksum, 0, &reachable, cancellable, error))
+    return FALSE;
+
+  g_autoptr (GPtrArray) file_checksums = g_ptr_array_new_with_free_func (g_free);
+  GLNX_HASH_TABLE_FOREACH (reachable, GVariant *, object)
+    {
+      const char *checksum;
+      OstreeObjectType objtype;
+      ostree_object_name_deserialize (object, &checksum, &objtype);
+      if (objtype == OSTREE_OBJECT_TYPE_FILE)
+        g_ptr_array_add (file_checksums, g_strdup (checksum));
+    }
+  g_ptr_array_sort (file_checksums, compare_strings);
+
+  GVariantBuilder inline_builder;
+  g_variant_builder_init (&inline_builder, G_VARIANT_TYPE ("a(ayay)"));
+  for (guint i = 0; i < file_checksums->len; i++)
+    {
+      const char *checksum = file_checksums->pdata[i];
+      g_autoptr (GInputStream) object_stream = NULL;
+      guint64 size;
+
+      if (!ostree_repo_load_object_stream (repo, OSTREE_OBJECT_TYPE_FILE, checksum, &object_stream,
+                                           &size, cancellable, error))
+        return FALSE;
+      if (size > max_bytes)
+        continue;
+
+      g_autoptr (GOutputStream) buf = g_memory_output_stream_new_resizable ();
+      if (g_output_stream_splice (
+              buf, object_stream,
+              G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+              cancellable, error)
+          < 0)
+        return FALSE;
+      g_autoptr (GBytes) bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (buf));
+
+      g_variant_builder_add (&inline_builder, "(@ay@ay)", ostree_checksum_to_bytes_v (checksum),
+                             g_variant_new_from_bytes (G_VARIANT_TYPE ("ay"), bytes, TRUE));
+    }
+
+  *out_inline_content = g_variant_ref_sink (g_variant_builder_end (&inline_builder));
+  return TRUE;
+}
+
 gboolean
 ostree_builtin_commit (int argc, char **argv, OstreeCommandInvocation *invocation,
                        GCancellable *cancellable, GError **error)
@@ -609,7 +669,14 @@ ostree_builtin_commit (int argc, char **argv, OstreeCommandInvocation *invocatio
     {
       filter_data.mode_adds = mode_adds;
       filter_data.skip_list = skip_list;
-      modifier = ostree_repo_commit_modifier_new (flags, commit_filter, &filter_data, NULL);
+      /* Only install the filter callback when an option it implements is in
+       * use; a filter-less modifier lets the library graft unchanged subtrees
+       * by dirtree checksum when composing from existing refs.
+       */
+      const gboolean need_filter = opt_owner_uid >= 0 || opt_owner_gid >= 0 || opt_ro_executables
+                                   || opt_statoverride_file != NULL || opt_skiplist_file != NULL;
+      modifier = ostree_repo_commit_modifier_new (flags, need_filter ? commit_filter : NULL,
+                                                  need_filter ? &filter_data : NULL, NULL);
 
       if (opt_selinux_policy)
         {
@@ -911,6 +978,52 @@ ostree_builtin_commit (int argc, char **argv, OstreeCommandInvocation *invocatio
             goto out;
         }
 
+      if (opt_generate_changelog_stats && parent)
+        {
+          g_autoptr (GFile) parent_root = NULL;
+          guint n_added, n_changed, n_removed;
+          guint64 bytes_added, bytes_removed;
+
+          if (!ostree_repo_read_commit (repo, parent, &parent_root, NULL, cancellable, error))
+            goto out;
+
+          if (!ot_compute_changelog_stats (parent_root, root, &n_added, &n_changed, &n_removed,
+                                           &bytes_added, &bytes_removed, cancellable, error))
+            goto out;
+
+          g_autoptr (GVariant) old_detached_metadata = g_steal_pointer (&detached_metadata);
+          g_auto (GVariantDict) statsmeta;
+          g_variant_dict_init (&statsmeta, old_detached_metadata);
+          /* Big endian, matching the other numeric values in commit objects */
+          g_variant_dict_insert (&statsmeta, OSTREE_COMMIT_META_KEY_CHANGELOG_STATS, "(uuutt)",
+                                 GUINT32_TO_BE (n_added), GUINT32_TO_BE (n_changed),
+                                 GUINT32_TO_BE (n_removed), GUINT64_TO_BE (bytes_added),
+                                 GUINT64_TO_BE (bytes_removed));
+          detached_metadata = g_variant_ref_sink (g_variant_dict_end (&statsmeta));
+        }
+
+      GKeyFile *repo_config = ostree_repo_get_config (repo);
+      guint64 inline_content_max_bytes
+          = g_key_file_get_uint64 (repo_config, "core", "inline-content-max-bytes", NULL);
+      if (inline_content_max_bytes > 0)
+        {
+          g_autoptr (GVariant) inline_content = NULL;
+
+          if (!build_inline_content_metadata (repo, commit_checksum, inline_content_max_bytes,
+                                              &inline_content, cancellable, error))
+            goto out;
+
+          if (g_variant_n_children (inline_content) > 0)
+            {
+              g_autoptr (GVariant) old_detached_metadata = g_steal_pointer (&detached_metadata);
+              g_auto (GVariantDict) inlinemeta;
+              g_variant_dict_init (&inlinemeta, old_detached_metadata);
+              g_variant_dict_insert_value (&inlinemeta, OSTREE_COMMIT_META_KEY_INLINE_CONTENT,
+                                           inline_content);
+              detached_metadata = g_variant_ref_sink (g_variant_dict_end (&inlinemeta));
+            }
+        }
+
       if (detached_metadata)
         {
           if (!ostree_repo_write_commit_detached_metadata (repo, commit_checksum, detached_metadata,
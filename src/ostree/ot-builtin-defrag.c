@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ostree-cmd-private.h"
+#include "ostree.h"
+#include "ot-builtins.h"
+#include "ot-main.h"
+#include "otutil.h"
+
+static gboolean opt_quiet;
+
+/* ATTENTION:
+ * Please remember to update the bash-completion script (bash/ostree) and
+ * man page (man/ostree-defrag.xml) when changing the option list.
+ */
+
+static GOptionEntry options[]
+    = { { "quiet", 'q', 0, G_OPTION_ARG_NONE, &opt_quiet, "Only print error messages", NULL },
+        { NULL } };
+
+gboolean
+ostree_builtin_defrag (int argc, char **argv, OstreeCommandInvocation *invocation,
+                       GCancellable *cancellable, GError **error)
+{
+  g_autoptr (OstreeRepo) repo = NULL;
+
+  g_autoptr (GOptionContext) context = g_option_context_new ("");
+  if (!ostree_option_context_parse (context, options, &argc, &argv, invocation, &repo, cancellable,
+                                    error))
+    return FALSE;
+
+  /* Hold the exclusive lock for the whole operation; loose objects are
+   * replaced in place underneath any concurrent reader.
+   */
+  if (!ostree_repo_lock_push (repo, OSTREE_REPO_LOCK_EXCLUSIVE, cancellable, error))
+    return FALSE;
+
+  guint n_rewritten = 0;
+  if (!ostree_cmd__private__ ()->ostree_repo_defrag (repo, &n_rewritten, cancellable, error))
+    return FALSE;
+
+  if (!ostree_repo_lock_pop (repo, OSTREE_REPO_LOCK_EXCLUSIVE, cancellable, error))
+    return FALSE;
+
+  if (!opt_quiet)
+    g_print ("Rewrote %u loose objects\n", n_rewritten);
+
+  return TRUE;
+}
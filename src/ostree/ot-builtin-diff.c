@@ -172,7 +172,8 @@ ostree_builtin_diff (int argc, char **argv, OstreeCommandInvocation *invocation,
       removed = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
       added = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
 
-      OstreeDiffDirsOptions diff_opts = { opt_owner_uid, opt_owner_gid };
+      OstreeDiffDirsOptions diff_opts
+          = { .owner_uid = opt_owner_uid, .owner_gid = opt_owner_gid, .diff_threads = -1 };
       if (!ostree_diff_dirs_with_options (diff_flags, srcf, targetf, modified, removed, added,
                                           &diff_opts, cancellable, error))
         return FALSE;
@@ -34,6 +34,7 @@
 static char *opt_output_path;
 static char *opt_subpath;
 static char *opt_prefix;
+static char *opt_compression;
 static gboolean opt_no_xattrs;
 
 /* ATTENTION:
@@ -49,6 +50,8 @@ static GOptionEntry options[]
         { "prefix", 0, 0, G_OPTION_ARG_FILENAME, &opt_prefix,
           "Add PATH as prefix to archive pathnames", "PATH" },
         { "output", 'o', 0, G_OPTION_ARG_FILENAME, &opt_output_path, "Output to PATH ", "PATH" },
+        { "compress", 0, 0, G_OPTION_ARG_STRING, &opt_compression,
+          "Compress the archive with TYPE (e.g. gzip, zstd; default is none)", "TYPE" },
         { NULL } };
 
 #ifdef HAVE_LIBARCHIVE
@@ -107,10 +110,25 @@ ostree_builtin_export (int argc, char **argv, OstreeCommandInvocation *invocatio
       propagate_libarchive_error (error, a);
       goto out;
     }
-  if (archive_write_add_filter_none (a) != ARCHIVE_OK)
+  if (opt_compression == NULL || strcmp (opt_compression, "none") == 0)
     {
-      propagate_libarchive_error (error, a);
-      goto out;
+      if (archive_write_add_filter_none (a) != ARCHIVE_OK)
+        {
+          propagate_libarchive_error (error, a);
+          goto out;
+        }
+    }
+  else
+    {
+      /* Accept whatever filters this libarchive was built with; notably
+       * "zstd" requires libarchive >= 3.3.3 built against libzstd.
+       */
+      if (archive_write_add_filter_by_name (a, opt_compression) != ARCHIVE_OK)
+        {
+          propagate_libarchive_error (error, a);
+          g_prefix_error (error, "Compression '%s': ", opt_compression);
+          goto out;
+        }
     }
   if (opt_output_path)
     {
@@ -146,6 +164,7 @@ ostree_builtin_export (int argc, char **argv, OstreeCommandInvocation *invocatio
     subtree = g_object_ref (root);
 
   opts.path_prefix = opt_prefix;
+  opts.n_reader_threads = g_get_num_processors ();
 
   if (!ostree_repo_export_tree_to_archive (repo, &opts, (OstreeRepoFile *)subtree, a, cancellable,
                                            error))
@@ -34,6 +34,8 @@ static gboolean opt_all;
 static gboolean opt_add_tombstones;
 static gboolean opt_verify_bindings;
 static gboolean opt_verify_back_refs;
+static gboolean opt_deltas;
+static int opt_parallel;
 
 /* ATTENTION:
  * Please remember to update the bash-completion script (bash/ostree) and
@@ -50,11 +52,59 @@ static GOptionEntry options[]
           NULL },
         { "verify-back-refs", 0, 0, G_OPTION_ARG_NONE, &opt_verify_back_refs,
           "Verify back-references (implies --verify-bindings)", NULL },
+        { "deltas", 0, 0, G_OPTION_ARG_NONE, &opt_deltas,
+          "Verify static delta superblocks and part checksums", NULL },
+        { "parallel", 0, 0, G_OPTION_ARG_INT, &opt_parallel,
+          "Verify objects using N worker threads; -1 means one per processor", "N" },
         { NULL } };
 
+/* Parent tracking for corruption reports.  Recording every object's parent
+ * during the main traversal costs memory proportional to the whole object
+ * graph even on a healthy repository, so the parent map is only built (by
+ * re-walking the commits) once the first corrupt object is found.
+ */
+typedef struct
+{
+  GHashTable *commits;        /* borrowed set of commits being verified */
+  GHashTable *object_parents; /* built lazily on first corruption */
+} FsckParentState;
+
+static GHashTable *
+fsck_parent_state_get (OstreeRepo *repo, FsckParentState *parents_state, GCancellable *cancellable)
+{
+  if (parents_state == NULL)
+    return NULL;
+
+  if (parents_state->object_parents == NULL)
+    {
+      parents_state->object_parents = ostree_repo_traverse_new_parents ();
+      g_autoptr (GHashTable) reachable = ostree_repo_traverse_new_reachable ();
+
+      /* Ignore traversal errors here: we already know the repository is
+       * damaged, and a partial parent map is still better than none. */
+      GLNX_HASH_TABLE_FOREACH (parents_state->commits, GVariant *, serialized_key)
+        {
+          const char *checksum;
+          OstreeObjectType objtype;
+          ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+          (void)ostree_repo_traverse_commit_union_with_parents (
+              repo, checksum, 0, reachable, parents_state->object_parents, cancellable, NULL);
+        }
+    }
+
+  return parents_state->object_parents;
+}
+
+static void
+fsck_parent_state_clear (FsckParentState *parents_state)
+{
+  g_clear_pointer (&parents_state->object_parents, g_hash_table_unref);
+}
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (FsckParentState, fsck_parent_state_clear)
+
 static gboolean
 fsck_one_object (OstreeRepo *repo, const char *checksum, OstreeObjectType objtype,
-                 GHashTable *object_parents, GVariant *key, gboolean *out_found_corruption,
+                 FsckParentState *parents_state, GVariant *key, gboolean *out_found_corruption,
                  GCancellable *cancellable, GError **error)
 {
   g_autoptr (GError) temp_error = NULL;
@@ -64,6 +114,7 @@ fsck_one_object (OstreeRepo *repo, const char *checksum, OstreeObjectType objtyp
       g_auto (GStrv) parent_commits = NULL;
       g_autofree char *parent_commits_str = NULL;
 
+      GHashTable *object_parents = fsck_parent_state_get (repo, parents_state, cancellable);
       if (object_parents)
         {
           parent_commits = ostree_repo_traverse_parents_get_commits (object_parents, key);
@@ -135,13 +186,122 @@ fsck_one_object (OstreeRepo *repo, const char *checksum, OstreeObjectType objtyp
   return TRUE;
 }
 
+/* State shared with the --parallel verification workers.  Workers only
+ * recompute checksums via ostree_repo_fsck_object(); objects that fail are
+ * collected and re-handled serially afterwards, so all error classification,
+ * deletion and partial-marking stays on the main thread.
+ */
+typedef struct
+{
+  OstreeRepo *repo;
+  GCancellable *cancellable;
+  GMutex lock;
+  GCond cond;
+  guint outstanding;
+  guint n_processed; /* protected by lock */
+  GPtrArray *failed; /* Array<GVariant>, protected by lock */
+} FsckObjectsParallel;
+
+static void
+fsck_object_worker (gpointer data, gpointer user_data)
+{
+  g_autoptr (GVariant) serialized_key = data;
+  FsckObjectsParallel *fp = user_data;
+  const char *checksum;
+  OstreeObjectType objtype;
+
+  ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+
+  gboolean ok = TRUE;
+  if (!g_cancellable_is_cancelled (fp->cancellable))
+    {
+      g_autoptr (GError) local_error = NULL;
+      /* The error is regenerated during the serial re-check below */
+      ok = ostree_repo_fsck_object (fp->repo, objtype, checksum, fp->cancellable, &local_error);
+    }
+
+  g_mutex_lock (&fp->lock);
+  if (!ok)
+    g_ptr_array_add (fp->failed, g_variant_ref (serialized_key));
+  fp->n_processed++;
+  fp->outstanding--;
+  g_cond_signal (&fp->cond);
+  g_mutex_unlock (&fp->lock);
+}
+
+/* Loose objects get visited in physical (inode) order, so telling the kernel
+ * about the next batch ahead of the reader keeps a rotating disk streaming
+ * instead of seeking.  The window is in objects, not bytes; fsck reads
+ * everything anyway, this just bounds how far ahead of consumption we ask.
+ */
+#define FSCK_PREFETCH_WINDOW 64
+
+static void
+fsck_advise_window (OstreeRepo *repo, GPtrArray *ordered_objects, guint *inout_advised,
+                    guint target)
+{
+  target = MIN (target, ordered_objects->len);
+  for (; *inout_advised < target; (*inout_advised)++)
+    {
+      GVariant *serialized_key = ordered_objects->pdata[*inout_advised];
+      const char *checksum;
+      OstreeObjectType objtype;
+
+      ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+      ostree_cmd__private__ ()->ostree_repo_advise_object_read (repo, objtype, checksum);
+    }
+}
+
+/* Verify all objects using a worker pool, keeping the progress output on the
+ * calling thread.  Returns the set of objects that failed verification.
+ */
+static gboolean
+fsck_objects_parallel (OstreeRepo *repo, GPtrArray *ordered_objects, guint n_threads,
+                       GPtrArray **out_failed, GCancellable *cancellable, GError **error)
+{
+  FsckObjectsParallel fp = {
+    0,
+  };
+  fp.repo = repo;
+  fp.cancellable = cancellable;
+  g_mutex_init (&fp.lock);
+  g_cond_init (&fp.cond);
+  fp.failed = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+
+  OtThreadPool *pool = ot_thread_pool_new ("fsck", fsck_object_worker, &fp, n_threads);
+
+  const guint count = ordered_objects->len;
+  g_mutex_lock (&fp.lock);
+  for (guint i = 0; i < ordered_objects->len; i++)
+    {
+      fp.outstanding++;
+      ot_thread_pool_push (pool, g_variant_ref (ordered_objects->pdata[i]));
+    }
+  guint advised = 0;
+  fsck_advise_window (repo, ordered_objects, &advised, FSCK_PREFETCH_WINDOW);
+  while (fp.outstanding > 0)
+    {
+      g_cond_wait (&fp.cond, &fp.lock);
+      fsck_advise_window (repo, ordered_objects, &advised, fp.n_processed + FSCK_PREFETCH_WINDOW);
+      glnx_console_progress_n_items ("fsck objects", fp.n_processed, count);
+    }
+  g_mutex_unlock (&fp.lock);
+
+  ot_thread_pool_free (pool);
+  g_mutex_clear (&fp.lock);
+  g_cond_clear (&fp.cond);
+
+  *out_failed = fp.failed;
+  return !g_cancellable_set_error_if_cancelled (cancellable, error);
+}
+
 static gboolean
 fsck_reachable_objects_from_commits (OstreeRepo *repo, GHashTable *commits,
                                      gboolean *out_found_corruption, GCancellable *cancellable,
                                      GError **error)
 {
   g_autoptr (GHashTable) reachable_objects = ostree_repo_traverse_new_reachable ();
-  g_autoptr (GHashTable) object_parents = ostree_repo_traverse_new_parents ();
+  g_auto (FsckParentState) parents_state = { commits, NULL };
 
   GHashTableIter hash_iter;
   gpointer key, value;
@@ -156,33 +316,76 @@ fsck_reachable_objects_from_commits (OstreeRepo *repo, GHashTable *commits,
 
       g_assert (objtype == OSTREE_OBJECT_TYPE_COMMIT);
 
-      if (!ostree_repo_traverse_commit_union_with_parents (repo, checksum, 0, reachable_objects,
-                                                           object_parents, cancellable, error))
+      if (!ostree_repo_traverse_commit_union (repo, checksum, 0, reachable_objects, cancellable,
+                                              error))
         return FALSE;
     }
 
+  /* Visit objects in physical order rather than hash order, and keep a
+   * readahead window queued ahead of the reader; see fsck_advise_window().
+   */
+  g_autoptr (GPtrArray) ordered_objects
+      = g_ptr_array_new_full (g_hash_table_size (reachable_objects), (GDestroyNotify)g_variant_unref);
+  GLNX_HASH_TABLE_FOREACH (reachable_objects, GVariant *, serialized_key)
+    g_ptr_array_add (ordered_objects, g_variant_ref (serialized_key));
+  ostree_cmd__private__ ()->ostree_repo_physical_order_objects (repo, ordered_objects);
+  /* The array owns the objects from here; drop the set's per-entry overhead
+   * before the verification pass. */
+  g_clear_pointer (&reachable_objects, g_hash_table_unref);
+
   g_auto (GLnxConsoleRef) console = {
     0,
   };
   glnx_console_lock (&console);
 
-  const guint count = g_hash_table_size (reachable_objects);
-  guint i = 0;
-  g_hash_table_iter_init (&hash_iter, reachable_objects);
-  while (g_hash_table_iter_next (&hash_iter, &key, &value))
+  guint n_threads = 1;
+  if (opt_parallel < 0)
+    n_threads = g_get_num_processors ();
+  else if (opt_parallel > 0)
+    n_threads = opt_parallel;
+
+  if (n_threads > 1)
     {
-      GVariant *serialized_key = key;
+      g_autoptr (GPtrArray) failed = NULL;
+      if (!fsck_objects_parallel (repo, ordered_objects, n_threads, &failed, cancellable, error))
+        return FALSE;
+
+      /* Re-handle failures serially; this re-verifies to regenerate the
+       * error, which is cheap since corruption is the rare case.
+       */
+      for (guint j = 0; j < failed->len; j++)
+        {
+          GVariant *serialized_key = failed->pdata[j];
+          const char *checksum;
+          OstreeObjectType objtype;
+
+          ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
+
+          if (!fsck_one_object (repo, checksum, objtype, &parents_state, serialized_key,
+                                out_found_corruption, cancellable, error))
+            return FALSE;
+        }
+
+      return TRUE;
+    }
+
+  const guint count = ordered_objects->len;
+  guint advised = 0;
+  for (guint i = 0; i < count; i++)
+    {
+      GVariant *serialized_key = ordered_objects->pdata[i];
       const char *checksum;
       OstreeObjectType objtype;
 
+      fsck_advise_window (repo, ordered_objects, &advised, i + FSCK_PREFETCH_WINDOW);
+
       ostree_object_name_deserialize (serialized_key, &checksum, &objtype);
 
-      if (!fsck_one_object (repo, checksum, objtype, object_parents, serialized_key,
+      if (!fsck_one_object (repo, checksum, objtype, &parents_state, serialized_key,
                             out_found_corruption, cancellable, error))
         return FALSE;
 
-      i++;
-      glnx_console_progress_n_items ("fsck objects", i, count);
+      glnx_console_progress_n_items ("fsck objects", i + 1, count);
     }
 
   return TRUE;
@@ -408,6 +611,44 @@ ostree_builtin_fsck (int argc, char **argv, OstreeCommandInvocation *invocation,
   if (!fsck_reachable_objects_from_commits (repo, commits, &found_corruption, cancellable, error))
     return FALSE;
 
+  if (opt_deltas)
+    {
+      g_autoptr (GPtrArray) delta_names = NULL;
+      if (!ostree_repo_list_static_delta_names (repo, &delta_names, cancellable, error))
+        return FALSE;
+
+      if (!opt_quiet)
+        g_print ("Verifying %u static deltas...\n", delta_names->len);
+
+      guint n_threads = 1;
+      if (opt_parallel < 0)
+        n_threads = g_get_num_processors ();
+      else if (opt_parallel > 0)
+        n_threads = opt_parallel;
+
+      for (guint i = 0; i < delta_names->len; i++)
+        {
+          const char *delta_name = delta_names->pdata[i];
+          g_autoptr (GError) temp_error = NULL;
+
+          if (!ostree_cmd__private__ ()->ostree_static_delta_fsck (repo, delta_name, n_threads,
+                                                                   cancellable, &temp_error))
+            {
+              g_prefix_error (&temp_error, "Delta %s: ", delta_name);
+              if (opt_all)
+                {
+                  found_corruption = TRUE;
+                  g_printerr ("%s\n", temp_error->message);
+                }
+              else
+                {
+                  g_propagate_error (error, g_steal_pointer (&temp_error));
+                  return FALSE;
+                }
+            }
+        }
+    }
+
   if (opt_add_tombstones)
     {
       guint i;
@@ -28,6 +28,7 @@
 #include "otutil.h"
 
 static gboolean opt_raw;
+static gboolean opt_stat;
 
 /* ATTENTION:
  * Please remember to update the bash-completion script (bash/ostree) and
@@ -35,7 +36,10 @@ static gboolean opt_raw;
  */
 
 static GOptionEntry options[]
-    = { { "raw", 0, 0, G_OPTION_ARG_NONE, &opt_raw, "Show raw variant data" }, { NULL } };
+    = { { "raw", 0, 0, G_OPTION_ARG_NONE, &opt_raw, "Show raw variant data" },
+        { "stat", 0, 0, G_OPTION_ARG_NONE, &opt_stat,
+          "Show files added/changed/removed relative to each parent commit" },
+        { NULL } };
 
 static gboolean
 log_commit (OstreeRepo *repo, const gchar *checksum, gboolean is_recurse, OstreeDumpFlags flags,
@@ -65,6 +69,66 @@ log_commit (OstreeRepo *repo, const gchar *checksum, gboolean is_recurse, Ostree
 
   /* Get the parent of this commit */
   parent = ostree_commit_get_parent (variant);
+
+  if (opt_stat)
+    {
+      g_autoptr (GVariant) detached = NULL;
+      g_autoptr (GVariant) stats = NULL;
+
+      /* Prefer the changelog sidecar recorded at commit time; it saves
+       * diffing the full trees of every commit pair.
+       */
+      if (!ostree_repo_read_commit_detached_metadata (repo, checksum, &detached, NULL, error))
+        goto out;
+      if (detached)
+        stats = g_variant_lookup_value (detached, OSTREE_COMMIT_META_KEY_CHANGELOG_STATS,
+                                        G_VARIANT_TYPE ("(uuutt)"));
+
+      if (stats)
+        {
+          guint32 n_added, n_changed, n_removed;
+          guint64 bytes_added, bytes_removed;
+
+          g_variant_get (stats, "(uuutt)", &n_added, &n_changed, &n_removed, &bytes_added,
+                         &bytes_removed);
+          ot_dump_changelog_stats (GUINT32_FROM_BE (n_added), GUINT32_FROM_BE (n_changed),
+                                   GUINT32_FROM_BE (n_removed), GUINT64_FROM_BE (bytes_added),
+                                   GUINT64_FROM_BE (bytes_removed));
+          g_print ("\n");
+        }
+      else if (parent)
+        {
+          g_autoptr (GFile) parent_root = NULL;
+          g_autoptr (GFile) root = NULL;
+          guint n_added, n_changed, n_removed;
+          guint64 bytes_added, bytes_removed;
+
+          if (!ostree_repo_read_commit (repo, parent, &parent_root, NULL, NULL, &local_error))
+            {
+              /* Partial history; just skip the stats for this commit */
+              if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+                g_clear_error (&local_error);
+              else
+                {
+                  g_propagate_error (error, local_error);
+                  goto out;
+                }
+            }
+
+          if (parent_root)
+            {
+              if (!ostree_repo_read_commit (repo, checksum, &root, NULL, NULL, error))
+                goto out;
+
+              if (!ot_compute_changelog_stats (parent_root, root, &n_added, &n_changed, &n_removed,
+                                               &bytes_added, &bytes_removed, NULL, error))
+                goto out;
+              ot_dump_changelog_stats (n_added, n_changed, n_removed, bytes_added, bytes_removed);
+              g_print ("\n");
+            }
+        }
+    }
+
   if (parent && !log_commit (repo, parent, TRUE, flags, error))
     goto out;
 
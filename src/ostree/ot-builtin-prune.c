@@ -37,6 +37,9 @@ static char *opt_keep_younger_than;
 static char **opt_retain_branch_depth;
 static char **opt_only_branches;
 static gboolean opt_commit_only;
+static gboolean opt_parallel;
+static gboolean opt_indexed;
+static gboolean opt_refcount;
 
 /* ATTENTION:
  * Please remember to update the bash-completion script (bash/ostree) and
@@ -62,6 +65,12 @@ static GOptionEntry options[] = {
     "Only prune BRANCH (may be specified multiple times)", "BRANCH" },
   { "commit-only", 0, 0, G_OPTION_ARG_NONE, &opt_commit_only,
     "Only traverse and delete commit objects.", NULL },
+  { "parallel", 0, 0, G_OPTION_ARG_NONE, &opt_parallel,
+    "Compute reachability using multiple worker threads", NULL },
+  { "indexed", 0, 0, G_OPTION_ARG_NONE, &opt_indexed,
+    "Cache per-commit reachability so repeated prunes only traverse new commits", NULL },
+  { "refcount", 0, 0, G_OPTION_ARG_NONE, &opt_refcount,
+    "Maintain per-object reference counts so repeated prunes avoid traversal entirely", NULL },
   { NULL }
 };
 
@@ -204,6 +213,12 @@ ostree_builtin_prune (int argc, char **argv, OstreeCommandInvocation *invocation
     pruneflags |= OSTREE_REPO_PRUNE_FLAGS_NO_PRUNE;
   if (opt_commit_only)
     pruneflags |= OSTREE_REPO_PRUNE_FLAGS_COMMIT_ONLY;
+  if (opt_parallel)
+    pruneflags |= OSTREE_REPO_PRUNE_FLAGS_PARALLEL_TRAVERSAL;
+  if (opt_indexed)
+    pruneflags |= OSTREE_REPO_PRUNE_FLAGS_INDEXED_TRAVERSAL;
+  if (opt_refcount)
+    pruneflags |= OSTREE_REPO_PRUNE_FLAGS_REFCOUNT;
 
   /* If no newer more complex options are specified, drop down to the original
    * prune API - both to avoid code duplication, and to keep it run from the
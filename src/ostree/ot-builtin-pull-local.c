@@ -34,6 +34,7 @@ static gboolean opt_commit_only;
 static gboolean opt_disable_fsync;
 static gboolean opt_per_object_fsync;
 static gboolean opt_untrusted;
+static gboolean opt_sample_verify;
 static gboolean opt_bareuseronly_files;
 static gboolean opt_require_static_deltas;
 static gboolean opt_gpg_verify;
@@ -56,6 +57,8 @@ static GOptionEntry options[]
           "Perform writes in such a way that avoids stalling concurrent processes", NULL },
         { "untrusted", 0, 0, G_OPTION_ARG_NONE, &opt_untrusted,
           "Verify checksums of local sources (always enabled for HTTP pulls)", NULL },
+        { "sample-verify", 0, 0, G_OPTION_ARG_NONE, &opt_sample_verify,
+          "With --untrusted, fully checksum only a sample of content objects", NULL },
         { "bareuseronly-files", 0, 0, G_OPTION_ARG_NONE, &opt_bareuseronly_files,
           "Reject regular files with mode outside of 0775 (world writable, suid, etc.)", NULL },
         { "require-static-deltas", 0, 0, G_OPTION_ARG_NONE, &opt_require_static_deltas,
@@ -119,6 +122,13 @@ ostree_builtin_pull_local (int argc, char **argv, OstreeCommandInvocation *invoc
       src_repo_uri = g_strconcat ("file://", cwd, "/", src_repo_arg, NULL);
     }
 
+  if (opt_sample_verify && !opt_untrusted)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                           "--sample-verify requires --untrusted");
+      goto out;
+    }
+
   if (opt_untrusted)
     pullflags |= OSTREE_REPO_PULL_FLAGS_UNTRUSTED;
   if (opt_bareuseronly_files)
@@ -198,6 +208,9 @@ ostree_builtin_pull_local (int argc, char **argv, OstreeCommandInvocation *invoc
     g_variant_builder_add (
         &builder, "{s@v}", "disable-verify-bindings",
         g_variant_new_variant (g_variant_new_boolean (opt_disable_verify_bindings)));
+    if (opt_sample_verify)
+      g_variant_builder_add (&builder, "{s@v}", "local-verify-sample",
+                             g_variant_new_variant (g_variant_new_boolean (TRUE)));
     g_variant_builder_add (&builder, "{s@v}", "depth",
                            g_variant_new_variant (g_variant_new_int32 (opt_depth)));
     /* local pulls always disable signapi verification.  If you don't want this, use
@@ -47,6 +47,7 @@ static int opt_depth = 0;
 static int opt_frequency = 0;
 static int opt_network_retries = -1;
 static char *opt_url;
+static char *opt_limit_rate;
 static char **opt_localcache_repos;
 
 /* ATTENTION:
@@ -88,6 +89,8 @@ static GOptionEntry options[]
           "Sets the update frequency, in milliseconds (0=1000ms) (default: 0)", "FREQUENCY" },
         { "network-retries", 0, 0, G_OPTION_ARG_INT, &opt_network_retries,
           "Specifies how many times each download should be retried upon error (default: 5)", "N" },
+        { "limit-rate", 0, 0, G_OPTION_ARG_STRING, &opt_limit_rate,
+          "Limit the aggregate download rate to RATE bytes per second", "RATE" },
         { "localcache-repo", 'L', 0, G_OPTION_ARG_FILENAME_ARRAY, &opt_localcache_repos,
           "Add REPO as local cache source for objects during this pull", "REPO" },
         { "timestamp-check", 'T', 0, G_OPTION_ARG_NONE, &opt_timestamp_check,
@@ -323,6 +326,11 @@ ostree_builtin_pull (int argc, char **argv, OstreeCommandInvocation *invocation,
       g_variant_builder_add (&builder, "{s@v}", "n-network-retries",
                              g_variant_new_variant (g_variant_new_uint32 (opt_network_retries)));
 
+    if (opt_limit_rate)
+      g_variant_builder_add (&builder, "{s@v}", "limit-rate",
+                             g_variant_new_variant (g_variant_new_uint64 (
+                                 g_ascii_strtoull (opt_limit_rate, NULL, 10))));
+
     g_variant_builder_add (
         &builder, "{s@v}", "disable-static-deltas",
         g_variant_new_variant (g_variant_new_boolean (opt_disable_static_deltas)));
@@ -21,17 +21,20 @@
 
 #include "config.h"
 
+#include "ostree-cmd-private.h"
 #include "ostree.h"
 #include "ot-builtins.h"
 #include "ot-main.h"
 
 static gboolean opt_delete;
+static gboolean opt_pack;
 static gboolean opt_list;
 static gboolean opt_revision;
 static gboolean opt_alias;
 static char *opt_create;
 static gboolean opt_collections;
 static gboolean opt_force;
+static char *opt_contains;
 
 /* ATTENTION:
  * Please remember to update the bash-completion script (bash/ostree) and
@@ -50,6 +53,10 @@ static GOptionEntry options[] = {
   { "collections", 'c', 0, G_OPTION_ARG_NONE, &opt_collections,
     "Enable listing collection IDs for refs", NULL },
   { "force", 0, 0, G_OPTION_ARG_NONE, &opt_force, "Overwrite existing refs when creating", NULL },
+  { "pack", 0, 0, G_OPTION_ARG_NONE, &opt_pack,
+    "Consolidate local refs into a packed-refs index", NULL },
+  { "contains", 0, 0, G_OPTION_ARG_STRING, &opt_contains,
+    "List only refs whose history contains COMMIT", "COMMIT" },
   { NULL }
 };
 
@@ -324,6 +331,51 @@ ostree_builtin_refs (int argc, char **argv, OstreeCommandInvocation *invocation,
                                     error))
     goto out;
 
+  if (opt_pack)
+    {
+      if (opt_delete || opt_create || opt_alias || argc >= 2)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "--pack cannot be combined with other operations");
+          goto out;
+        }
+
+      if (!ostree_cmd__private__ ()->ostree_repo_pack_refs (repo, cancellable, error))
+        goto out;
+
+      ret = TRUE;
+      goto out;
+    }
+
+  if (opt_contains)
+    {
+      if (opt_delete || opt_create || opt_alias || opt_pack || opt_collections)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "--contains cannot be combined with other operations");
+          goto out;
+        }
+
+      g_autofree char *checksum = NULL;
+      if (!ostree_repo_resolve_rev (repo, opt_contains, FALSE, &checksum, error))
+        goto out;
+
+      g_auto (GStrv) containing_refs = NULL;
+      if (!ostree_repo_list_refs_containing (repo, checksum, &containing_refs, cancellable, error))
+        goto out;
+
+      for (char **iter = containing_refs; *iter != NULL; iter++)
+        {
+          /* An optional PREFIX filters the output, matching the listing case */
+          if (argc >= 2 && !g_str_has_prefix (*iter, argv[1]))
+            continue;
+          g_print ("%s\n", *iter);
+        }
+
+      ret = TRUE;
+      goto out;
+    }
+
   if (argc >= 2)
     {
       if (opt_create && argc > 2)
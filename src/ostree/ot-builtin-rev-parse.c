@@ -21,6 +21,8 @@
 
 #include "config.h"
 
+#include <gio/gunixinputstream.h>
+
 #include "ostree.h"
 #include "ot-builtins.h"
 #include "ot-main.h"
@@ -33,11 +35,14 @@
  */
 
 static gboolean opt_single;
+static gboolean opt_stdin;
 
 static GOptionEntry options[] = { { "single", 'S', 0, G_OPTION_ARG_NONE, &opt_single,
                                     "If the repository has exactly one commit, then print it; any "
                                     "other case will result in an error",
                                     NULL },
+                                  { "stdin", 0, 0, G_OPTION_ARG_NONE, &opt_stdin,
+                                    "Read revisions from standard input, one per line", NULL },
                                   { NULL } };
 
 gboolean
@@ -50,6 +55,12 @@ ostree_builtin_rev_parse (int argc, char **argv, OstreeCommandInvocation *invoca
                                     error))
     return FALSE;
 
+  if (opt_single && opt_stdin)
+    {
+      ot_util_usage_error (context, "--single and --stdin are mutually exclusive", error);
+      return FALSE;
+    }
+
   if (opt_single)
     {
       if (argc >= 2)
@@ -81,6 +92,44 @@ ostree_builtin_rev_parse (int argc, char **argv, OstreeCommandInvocation *invoca
       return TRUE; /* Note early return */
     }
 
+  if (opt_stdin)
+    {
+      if (argc >= 2)
+        {
+          ot_util_usage_error (context, "Cannot specify REV arguments with --stdin", error);
+          return FALSE;
+        }
+
+      /* Batch mode: resolve revisions over one repository handle rather
+       * than paying process startup and repo open per revision.  Results
+       * are flushed per line so callers can stream requests interactively.
+       */
+      g_autoptr (GInputStream) instream = g_unix_input_stream_new (0, FALSE);
+      g_autoptr (GDataInputStream) datastream = g_data_input_stream_new (instream);
+
+      while (TRUE)
+        {
+          g_autofree char *line
+              = g_data_input_stream_read_line (datastream, NULL, cancellable, error);
+          if (line == NULL)
+            {
+              if (error != NULL && *error != NULL)
+                return FALSE;
+              break;
+            }
+          if (line[0] == '\0')
+            continue;
+
+          g_autofree char *resolved_rev = NULL;
+          if (!ostree_repo_resolve_rev (repo, line, FALSE, &resolved_rev, error))
+            return FALSE;
+          g_print ("%s\n", resolved_rev);
+          fflush (stdout);
+        }
+
+      return TRUE;
+    }
+
   if (argc < 2)
     {
       ot_util_usage_error (context, "REV must be specified", error);
@@ -21,12 +21,15 @@
 
 #include "config.h"
 
+#include <gio/gunixinputstream.h>
+
 #include "ostree.h"
 #include "ot-builtins.h"
 #include "ot-dump.h"
 #include "ot-main.h"
 #include "otutil.h"
 
+static gboolean opt_stdin;
 static gboolean opt_print_related;
 static char *opt_print_variant_type;
 static char *opt_print_metadata_key;
@@ -45,7 +48,9 @@ static char *opt_gpg_verify_remote;
  */
 
 static GOptionEntry options[]
-    = { { "print-related", 0, 0, G_OPTION_ARG_NONE, &opt_print_related,
+    = { { "stdin", 0, 0, G_OPTION_ARG_NONE, &opt_stdin,
+          "Read objects from standard input, one per line", NULL },
+        { "print-related", 0, 0, G_OPTION_ARG_NONE, &opt_print_related,
           "Show the \"related\" commits", NULL },
         { "print-variant-type", 0, 0, G_OPTION_ARG_STRING, &opt_print_variant_type,
           "Memory map OBJECT (in this case a filename) to the GVariant type string", "TYPE" },
@@ -333,24 +338,9 @@ print_if_found (OstreeRepo *repo, OstreeObjectType objtype, const char *checksum
   return TRUE;
 }
 
-gboolean
-ostree_builtin_show (int argc, char **argv, OstreeCommandInvocation *invocation,
-                     GCancellable *cancellable, GError **error)
+static gboolean
+show_one_object (OstreeRepo *repo, const char *rev, GCancellable *cancellable, GError **error)
 {
-  g_autoptr (GOptionContext) context = g_option_context_new ("OBJECT");
-
-  g_autoptr (OstreeRepo) repo = NULL;
-  if (!ostree_option_context_parse (context, options, &argc, &argv, invocation, &repo, cancellable,
-                                    error))
-    return FALSE;
-
-  if (argc <= 1)
-    {
-      ot_util_usage_error (context, "An object argument is required", error);
-      return FALSE;
-    }
-  const char *rev = argv[1];
-
   g_autofree char *resolved_rev = NULL;
   if (opt_print_metadata_key || opt_print_detached_metadata_key)
     {
@@ -376,11 +366,6 @@ ostree_builtin_show (int argc, char **argv, OstreeCommandInvocation *invocation,
       if (!do_print_related (repo, rev, resolved_rev, error))
         return FALSE;
     }
-  else if (opt_print_variant_type)
-    {
-      if (!do_print_variant_generic (G_VARIANT_TYPE (opt_print_variant_type), rev, error))
-        return FALSE;
-    }
   else if (opt_print_sizes)
     {
       if (!ostree_repo_resolve_rev (repo, rev, FALSE, &resolved_rev, error))
@@ -453,3 +438,69 @@ ostree_builtin_show (int argc, char **argv, OstreeCommandInvocation *invocation,
 
   return TRUE;
 }
+
+gboolean
+ostree_builtin_show (int argc, char **argv, OstreeCommandInvocation *invocation,
+                     GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GOptionContext) context = g_option_context_new ("OBJECT");
+
+  g_autoptr (OstreeRepo) repo = NULL;
+  if (!ostree_option_context_parse (context, options, &argc, &argv, invocation, &repo, cancellable,
+                                    error))
+    return FALSE;
+
+  if (opt_stdin)
+    {
+      if (argc >= 2)
+        {
+          ot_util_usage_error (context, "Cannot specify OBJECT arguments with --stdin", error);
+          return FALSE;
+        }
+      if (opt_print_variant_type)
+        {
+          ot_util_usage_error (context, "--print-variant-type is not supported with --stdin",
+                               error);
+          return FALSE;
+        }
+
+      /* Batch mode: process objects over one repository handle rather than
+       * paying process startup and repo open per object.  Results are
+       * flushed per object so callers can stream requests interactively.
+       */
+      g_autoptr (GInputStream) instream = g_unix_input_stream_new (0, FALSE);
+      g_autoptr (GDataInputStream) datastream = g_data_input_stream_new (instream);
+
+      while (TRUE)
+        {
+          g_autofree char *line
+              = g_data_input_stream_read_line (datastream, NULL, cancellable, error);
+          if (line == NULL)
+            {
+              if (error != NULL && *error != NULL)
+                return FALSE;
+              break;
+            }
+          if (line[0] == '\0')
+            continue;
+
+          if (!show_one_object (repo, line, cancellable, error))
+            return FALSE;
+          fflush (stdout);
+        }
+
+      return TRUE;
+    }
+
+  if (argc <= 1)
+    {
+      ot_util_usage_error (context, "An object argument is required", error);
+      return FALSE;
+    }
+  const char *rev = argv[1];
+
+  if (opt_print_variant_type)
+    return do_print_variant_generic (G_VARIANT_TYPE (opt_print_variant_type), rev, error);
+
+  return show_one_object (repo, rev, cancellable, error);
+}
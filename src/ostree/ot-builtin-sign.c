@@ -33,6 +33,7 @@
 
 static gboolean opt_delete;
 static gboolean opt_verify;
+static gboolean opt_dirtrees;
 static char *opt_sign_name;
 static char *opt_filename;
 static char *opt_keysdir;
@@ -46,6 +47,9 @@ static GOptionEntry options[]
     = { { "delete", 'd', 0, G_OPTION_ARG_NONE, &opt_delete,
           "Delete signatures having any of the KEY-IDs", NULL },
         { "verify", 0, 0, G_OPTION_ARG_NONE, &opt_verify, "Verify signatures", NULL },
+        { "dirtrees", 0, 0, G_OPTION_ARG_NONE, &opt_dirtrees,
+          "Also sign each dirtree object of the commit, enabling verification of partial pulls",
+          NULL },
         { "sign-type", 's', 0, G_OPTION_ARG_STRING, &opt_sign_name,
           "Signature type to use (defaults to 'ed25519')", "NAME" },
 #if defined(HAVE_LIBSODIUM)
@@ -149,6 +153,13 @@ ostree_builtin_sign (int argc, char **argv, OstreeCommandInvocation *invocation,
           ret = ostree_sign_commit (sign, repo, resolved_commit, cancellable, error);
           if (ret != TRUE)
             goto out;
+
+          if (opt_dirtrees)
+            {
+              ret = ostree_sign_commit_dirtrees (sign, repo, resolved_commit, cancellable, error);
+              if (ret != TRUE)
+                goto out;
+            }
         }
     }
 
@@ -232,6 +243,14 @@ ostree_builtin_sign (int argc, char **argv, OstreeCommandInvocation *invocation,
               ret = ostree_sign_commit (sign, repo, resolved_commit, cancellable, error);
               if (ret != TRUE)
                 goto out;
+
+              if (opt_dirtrees)
+                {
+                  ret = ostree_sign_commit_dirtrees (sign, repo, resolved_commit, cancellable,
+                                                     error);
+                  if (ret != TRUE)
+                    goto out;
+                }
             }
         }
     }
@@ -29,7 +29,13 @@ static char *opt_from_rev;
 static char *opt_to_rev;
 static char *opt_min_fallback_size;
 static char *opt_max_bsdiff_size;
+static char *opt_bsdiff_memory_budget;
 static char *opt_max_chunk_size;
+static char *opt_target_parts;
+static char *opt_threads;
+static char *opt_compress_threads;
+static char *opt_compression;
+static char *opt_compression_level;
 static char *opt_endianness;
 static char *opt_filename;
 static gboolean opt_empty;
@@ -96,8 +102,21 @@ static GOptionEntry generate_options[] = {
     "Minimum uncompressed size in megabytes for individual HTTP request", NULL },
   { "max-bsdiff-size", 0, 0, G_OPTION_ARG_STRING, &opt_max_bsdiff_size,
     "Maximum size in megabytes to consider bsdiff compression for input files", NULL },
+  { "bsdiff-memory-budget", 0, 0, G_OPTION_ARG_STRING, &opt_bsdiff_memory_budget,
+    "Cap bsdiff memory per object at N megabytes, diffing larger files in windows (0 disables)",
+    "N" },
   { "max-chunk-size", 0, 0, G_OPTION_ARG_STRING, &opt_max_chunk_size,
     "Maximum size of delta chunks in megabytes", NULL },
+  { "target-parts", 0, 0, G_OPTION_ARG_STRING, &opt_target_parts,
+    "Balance estimated apply cost across N delta parts (0 disables)", "N" },
+  { "threads", 0, 0, G_OPTION_ARG_STRING, &opt_threads,
+    "Compress delta parts using N threads (0 means one per processor)", "N" },
+  { "compress-threads", 0, 0, G_OPTION_ARG_STRING, &opt_compress_threads,
+    "Use N threads in the xz encoder for each delta part (0 means one per processor)", "N" },
+  { "compression", 0, 0, G_OPTION_ARG_STRING, &opt_compression,
+    "Compress delta parts with TYPE: 'x' (lzma, default) or 'z' (zstd)", "TYPE" },
+  { "compression-level", 0, 0, G_OPTION_ARG_STRING, &opt_compression_level,
+    "Compression level for zstd (0 means the built-in default)", "LEVEL" },
   { "filename", 0, 0, G_OPTION_ARG_FILENAME, &opt_filename,
     "Write the delta content to PATH (a directory).  If not specified, the OSTree repository is "
     "used",
@@ -400,10 +419,40 @@ ot_static_delta_builtin_generate (int argc, char **argv, OstreeCommandInvocation
         g_variant_builder_add (
             parambuilder, "{sv}", "max-bsdiff-size",
             g_variant_new_uint32 (g_ascii_strtoull (opt_max_bsdiff_size, NULL, 10)));
+      if (opt_bsdiff_memory_budget)
+        g_variant_builder_add (
+            parambuilder, "{sv}", "bsdiff-memory-budget",
+            g_variant_new_uint32 (g_ascii_strtoull (opt_bsdiff_memory_budget, NULL, 10)));
       if (opt_max_chunk_size)
         g_variant_builder_add (
             parambuilder, "{sv}", "max-chunk-size",
             g_variant_new_uint32 (g_ascii_strtoull (opt_max_chunk_size, NULL, 10)));
+      if (opt_target_parts)
+        g_variant_builder_add (
+            parambuilder, "{sv}", "target-parts",
+            g_variant_new_uint32 (g_ascii_strtoull (opt_target_parts, NULL, 10)));
+      if (opt_threads)
+        g_variant_builder_add (parambuilder, "{sv}", "n-threads",
+                               g_variant_new_uint32 (g_ascii_strtoull (opt_threads, NULL, 10)));
+      if (opt_compress_threads)
+        g_variant_builder_add (
+            parambuilder, "{sv}", "compress-threads",
+            g_variant_new_uint32 (g_ascii_strtoull (opt_compress_threads, NULL, 10)));
+      if (opt_compression)
+        {
+          if (strlen (opt_compression) != 1)
+            {
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Invalid compression type '%s'",
+                           opt_compression);
+              return FALSE;
+            }
+          g_variant_builder_add (parambuilder, "{sv}", "compression",
+                                 g_variant_new_byte ((guchar)opt_compression[0]));
+        }
+      if (opt_compression_level)
+        g_variant_builder_add (
+            parambuilder, "{sv}", "compression-level",
+            g_variant_new_int32 (g_ascii_strtoll (opt_compression_level, NULL, 10)));
       if (opt_disable_bsdiff)
         g_variant_builder_add (parambuilder, "{sv}", "bsdiff-enabled",
                                g_variant_new_boolean (FALSE));
@@ -28,6 +28,7 @@
 #include "otutil.h"
 
 static gboolean opt_update, opt_view, opt_raw;
+static gboolean opt_bitmaps;
 static gboolean opt_list_metadata_keys;
 static char *opt_print_metadata_key;
 static char **opt_gpg_key_ids;
@@ -43,6 +44,8 @@ static char **opt_metadata;
 
 static GOptionEntry options[]
     = { { "update", 'u', 0, G_OPTION_ARG_NONE, &opt_update, "Update the summary", NULL },
+        { "bitmaps", 0, 0, G_OPTION_ARG_NONE, &opt_bitmaps,
+          "Also regenerate per-commit object reachability bitmaps (requires --update)", NULL },
         { "view", 'v', 0, G_OPTION_ARG_NONE, &opt_view, "View the local summary file", NULL },
         { "raw", 0, 0, G_OPTION_ARG_NONE, &opt_raw, "View the raw bytes of the summary file",
           NULL },
@@ -137,6 +140,9 @@ ostree_builtin_summary (int argc, char **argv, OstreeCommandInvocation *invocati
         return FALSE;
     }
 
+  if (opt_bitmaps && !opt_update)
+    return glnx_throw (error, "--bitmaps requires --update");
+
   if (opt_update)
     {
       g_autoptr (GVariant) additional_metadata = NULL;
@@ -186,6 +192,9 @@ ostree_builtin_summary (int argc, char **argv, OstreeCommandInvocation *invocati
       if (!ostree_repo_regenerate_metadata (repo, additional_metadata, metadata_opts, cancellable,
                                             error))
         return FALSE;
+
+      if (opt_bitmaps && !_ostree_repo_regenerate_object_bitmaps (repo, cancellable, error))
+        return FALSE;
     }
   else if (opt_view || opt_raw)
     {
@@ -37,7 +37,9 @@ BUILTINPROTO (cat);
 BUILTINPROTO (config);
 BUILTINPROTO (checkout);
 BUILTINPROTO (checksum);
+BUILTINPROTO (chunk);
 BUILTINPROTO (commit);
+BUILTINPROTO (defrag);
 BUILTINPROTO (diff);
 BUILTINPROTO (export);
 BUILTINPROTO (find_remotes);
@@ -50,8 +52,10 @@ BUILTINPROTO (log);
 BUILTINPROTO (pull);
 BUILTINPROTO (pull_local);
 BUILTINPROTO (ls);
+BUILTINPROTO (migrate_fanout);
 BUILTINPROTO (prune);
 BUILTINPROTO (refs);
+BUILTINPROTO (repack);
 BUILTINPROTO (reset);
 BUILTINPROTO (fsck);
 BUILTINPROTO (sign);
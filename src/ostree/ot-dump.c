@@ -27,6 +27,7 @@
 
 #include "ostree-repo-private.h"
 #include "ostree-repo-static-delta-private.h"
+#include "ostree.h"
 #include "ot-admin-functions.h"
 #include "ot-dump.h"
 #include "otutil.h"
@@ -536,3 +537,106 @@ ot_dump_gpg_key (GVariant *key, GError **error)
 
   return TRUE;
 }
+
+/* Recursively tally regular files (count and bytes) below @root; used for
+ * whole directories appearing in the added/removed sets of a tree diff.
+ */
+static gboolean
+changelog_stats_tally (GFile *root, guint *inout_n_files, guint64 *inout_bytes,
+                       GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GFileInfo) info
+      = g_file_query_info (root, OSTREE_GIO_FAST_QUERYINFO, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                           cancellable, error);
+  if (!info)
+    return FALSE;
+
+  switch (g_file_info_get_file_type (info))
+    {
+    case G_FILE_TYPE_REGULAR:
+      (*inout_n_files)++;
+      *inout_bytes += g_file_info_get_size (info);
+      break;
+    case G_FILE_TYPE_DIRECTORY:
+      {
+        g_autoptr (GFileEnumerator) dir_enum
+            = g_file_enumerate_children (root, OSTREE_GIO_FAST_QUERYINFO,
+                                         G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, cancellable, error);
+        if (!dir_enum)
+          return FALSE;
+        while (TRUE)
+          {
+            GFileInfo *child_info;
+            GFile *child;
+            if (!g_file_enumerator_iterate (dir_enum, &child_info, &child, cancellable, error))
+              return FALSE;
+            if (child_info == NULL)
+              break;
+            if (!changelog_stats_tally (child, inout_n_files, inout_bytes, cancellable, error))
+              return FALSE;
+          }
+      }
+      break;
+    default:
+      break;
+    }
+
+  return TRUE;
+}
+
+gboolean
+ot_compute_changelog_stats (GFile *parent_root, GFile *root, guint *out_n_added,
+                            guint *out_n_changed, guint *out_n_removed, guint64 *out_bytes_added,
+                            guint64 *out_bytes_removed, GCancellable *cancellable, GError **error)
+{
+  g_autoptr (GPtrArray) modified
+      = g_ptr_array_new_with_free_func ((GDestroyNotify)ostree_diff_item_unref);
+  g_autoptr (GPtrArray) removed = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
+  g_autoptr (GPtrArray) added = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
+  guint n_added = 0, n_changed = 0, n_removed = 0;
+  guint64 bytes_added = 0, bytes_removed = 0;
+
+  if (!ostree_diff_dirs (OSTREE_DIFF_FLAGS_NONE, parent_root, root, modified, removed, added,
+                         cancellable, error))
+    return FALSE;
+
+  for (guint i = 0; i < modified->len; i++)
+    {
+      OstreeDiffItem *diff = modified->pdata[i];
+      n_changed++;
+      if (g_file_info_get_file_type (diff->src_info) == G_FILE_TYPE_REGULAR)
+        bytes_removed += g_file_info_get_size (diff->src_info);
+      if (g_file_info_get_file_type (diff->target_info) == G_FILE_TYPE_REGULAR)
+        bytes_added += g_file_info_get_size (diff->target_info);
+    }
+
+  /* Removed/added entries may be whole subtrees; count every file below. */
+  for (guint i = 0; i < removed->len; i++)
+    {
+      if (!changelog_stats_tally (removed->pdata[i], &n_removed, &bytes_removed, cancellable,
+                                  error))
+        return FALSE;
+    }
+  for (guint i = 0; i < added->len; i++)
+    {
+      if (!changelog_stats_tally (added->pdata[i], &n_added, &bytes_added, cancellable, error))
+        return FALSE;
+    }
+
+  *out_n_added = n_added;
+  *out_n_changed = n_changed;
+  *out_n_removed = n_removed;
+  *out_bytes_added = bytes_added;
+  *out_bytes_removed = bytes_removed;
+  return TRUE;
+}
+
+void
+ot_dump_changelog_stats (guint n_added, guint n_changed, guint n_removed, guint64 bytes_added,
+                         guint64 bytes_removed)
+{
+  g_autofree char *added_str = g_format_size (bytes_added);
+  g_autofree char *removed_str = g_format_size (bytes_removed);
+  g_print ("Stats:  %u added, %u changed, %u removed; %s added, %s removed\n", n_added, n_changed,
+           n_removed, added_str, removed_str);
+}
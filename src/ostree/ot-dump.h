@@ -44,3 +44,11 @@ void ot_dump_summary_metadata_keys (GBytes *summary_bytes);
 gboolean ot_dump_summary_metadata_key (GBytes *summary_bytes, const char *key, GError **error);
 
 gboolean ot_dump_gpg_key (GVariant *key, GError **error);
+
+gboolean ot_compute_changelog_stats (GFile *parent_root, GFile *root, guint *out_n_added,
+                                     guint *out_n_changed, guint *out_n_removed,
+                                     guint64 *out_bytes_added, guint64 *out_bytes_removed,
+                                     GCancellable *cancellable, GError **error);
+
+void ot_dump_changelog_stats (guint n_added, guint n_changed, guint n_removed, guint64 bytes_added,
+                              guint64 bytes_removed);
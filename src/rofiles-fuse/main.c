@@ -275,26 +275,41 @@ gioerror_to_errno (GIOErrorEnum e)
     }
 }
 
+/* The FUSE loop is multithreaded, and breaking a hardlink is not atomic
+ * (stat, copy to a temporary, rename over), so two concurrent writers to
+ * the same path must not race through it.  Serialize copyups on a small
+ * array of stripe locks keyed by path hash; unrelated paths proceed in
+ * parallel.  Statically-allocated GMutexes need no explicit init.
+ */
+#define COPYUP_N_STRIPES 16
+static GMutex copyup_locks[COPYUP_N_STRIPES];
+
+/* Whether the kernel writeback cache was negotiated; see do_open() */
+static gboolean opt_writeback_enabled;
+
 static int
-verify_write_or_copyup (const char *path, const struct stat *stbuf, gboolean *out_did_copyup)
+verify_write_or_copyup (const char *path, gboolean *out_did_copyup)
 {
   struct stat stbuf_local;
+  const struct stat *stbuf;
 
   if (out_did_copyup)
     *out_did_copyup = FALSE;
 
-  /* If a stbuf wasn't provided, gather it now */
-  if (!stbuf)
+  g_autoptr (GMutexLocker) locker
+      = g_mutex_locker_new (&copyup_locks[g_str_hash (path) % COPYUP_N_STRIPES]);
+
+  /* Gather the stat under the lock; a caller-provided stbuf from before we
+   * took the lock could race with another thread's copyup of the same path.
+   */
+  if (fstatat (basefd, path, &stbuf_local, AT_SYMLINK_NOFOLLOW) == -1)
     {
-      if (fstatat (basefd, path, &stbuf_local, AT_SYMLINK_NOFOLLOW) == -1)
-        {
-          if (errno == ENOENT)
-            return 0;
-          else
-            return -errno;
-        }
-      stbuf = &stbuf_local;
+      if (errno == ENOENT)
+        return 0;
+      else
+        return -errno;
     }
+  stbuf = &stbuf_local;
 
   /* Verify writability, if that fails, perform copy-up if enabled */
   if (!can_write_stbuf (stbuf))
@@ -304,6 +319,22 @@ verify_write_or_copyup (const char *path, const struct stat *stbuf, gboolean *ou
           g_autoptr (GError) tmp_error = NULL;
           if (!ostree_break_hardlink (basefd, path, FALSE, NULL, &tmp_error))
             return -gioerror_to_errno ((GIOErrorEnum)tmp_error->code);
+#if FUSE_USE_VERSION >= 31
+#if FUSE_VERSION >= FUSE_MAKE_VERSION(3, 2)
+          /* The copyup gave the path a new inode; drop the kernel's cached
+           * attrs/entry for it so stat doesn't keep reporting the old
+           * hardlink count.  The inode had no dirty pages (it was immutable
+           * until now), so this won't trigger a writeback from this thread.
+           */
+          struct fuse_context *ctx = fuse_get_context ();
+          if (ctx != NULL && ctx->fuse != NULL)
+            {
+              g_autofree char *abspath
+                  = strcmp (path, ".") == 0 ? g_strdup ("/") : g_strconcat ("/", path, NULL);
+              (void)fuse_invalidate_path (ctx->fuse, abspath);
+            }
+#endif
+#endif
           if (out_did_copyup)
             *out_did_copyup = TRUE;
         }
@@ -322,7 +353,7 @@ verify_write_or_copyup (const char *path, const struct stat *stbuf, gboolean *ou
   do \
     { \
       path = ENSURE_RELPATH (path); \
-      int r = verify_write_or_copyup (path, NULL, NULL); \
+      int r = verify_write_or_copyup (path, NULL); \
       if (r != 0) \
         return r; \
     } \
@@ -401,10 +432,15 @@ static int
 do_open (const char *path, mode_t mode, struct fuse_file_info *finfo)
 {
   int fd;
-  struct stat stbuf;
 
   path = ENSURE_RELPATH (path);
 
+  /* With the kernel writeback cache, read requests can arrive even for
+   * files the application opened write-only, so upgrade to O_RDWR.
+   */
+  if (opt_writeback_enabled && (finfo->flags & O_ACCMODE) == O_WRONLY)
+    finfo->flags = (finfo->flags & ~O_ACCMODE) | O_RDWR;
+
   if ((finfo->flags & O_ACCMODE) == O_RDONLY)
     {
       /* Read */
@@ -421,14 +457,8 @@ do_open (const char *path, mode_t mode, struct fuse_file_info *finfo)
       if (fd == -1)
         return -errno;
 
-      if (fstat (fd, &stbuf) == -1)
-        {
-          (void)close (fd);
-          return -errno;
-        }
-
       gboolean did_copyup;
-      int r = verify_write_or_copyup (path, &stbuf, &did_copyup);
+      int r = verify_write_or_copyup (path, &did_copyup);
       if (r != 0)
         {
           (void)close (fd);
@@ -632,6 +662,55 @@ callback_removexattr (const char *path, const char *name)
   return 0;
 }
 
+#if FUSE_USE_VERSION >= 31
+static void *
+callback_init (struct fuse_conn_info *conn, struct fuse_config *cfg)
+{
+  /* Let the kernel cache attrs and dentries instead of calling up to us
+   * for every stat; build systems hammer those.  All changes flow through
+   * this mount while it's active (that's the rofiles contract), so the
+   * kernel keeps its own cache coherent for operations it performs, and
+   * copyup - the one case where an inode changes identity underneath the
+   * kernel - explicitly invalidates the path.
+   */
+  cfg->entry_timeout = 60.0;
+  cfg->attr_timeout = 60.0;
+  cfg->negative_timeout = 1.0;
+
+  /* Batch small writes in the page cache rather than a kernel round trip
+   * per write(), and allow parallel lookups/readdir in the same directory.
+   */
+  if (conn->capable & FUSE_CAP_WRITEBACK_CACHE)
+    {
+      conn->want |= FUSE_CAP_WRITEBACK_CACHE;
+      opt_writeback_enabled = TRUE;
+    }
+  if (conn->capable & FUSE_CAP_PARALLEL_DIROPS)
+    conn->want |= FUSE_CAP_PARALLEL_DIROPS;
+
+  /* True FUSE passthrough (fuse_file_info.backing_id, kernel 6.9+) would
+   * take this daemon out of the read path entirely for un-copied-up files,
+   * but libfuse only exposes it through the low-level API and this daemon
+   * is written against the high-level path API.  The next best thing is
+   * zero-copy splice I/O: read_buf()/write_buf() already hand the kernel
+   * fd-backed buffers, and with the splice capabilities negotiated the
+   * data moves file -> FUSE device without a round trip through a
+   * userspace buffer.  Revisit passthrough if this ever moves to the
+   * low-level API.
+   */
+#ifdef FUSE_CAP_SPLICE_READ
+  if (conn->capable & FUSE_CAP_SPLICE_READ)
+    conn->want |= FUSE_CAP_SPLICE_READ;
+  if (conn->capable & FUSE_CAP_SPLICE_WRITE)
+    conn->want |= FUSE_CAP_SPLICE_WRITE;
+  if (conn->capable & FUSE_CAP_SPLICE_MOVE)
+    conn->want |= FUSE_CAP_SPLICE_MOVE;
+#endif
+
+  return NULL;
+}
+#endif
+
 struct fuse_operations callback_oper = { .getattr = callback_getattr,
                                          .readlink = callback_readlink,
                                          .readdir = callback_readdir,
@@ -661,7 +740,12 @@ struct fuse_operations callback_oper = { .getattr = callback_getattr,
                                          .setxattr = callback_setxattr,
                                          .getxattr = callback_getxattr,
                                          .listxattr = callback_listxattr,
-                                         .removexattr = callback_removexattr };
+                                         .removexattr = callback_removexattr,
+
+#if FUSE_USE_VERSION >= 31
+                                         .init = callback_init,
+#endif
+};
 
 enum
 {
@@ -39,6 +39,7 @@
 #define INITRAMFS_MOUNT_VAR "/run/ostree/initramfs-mount-var"
 #define _OSTREE_SYSROOT_READONLY_STAMP "/run/ostree-sysroot-ro.stamp"
 #define _OSTREE_COMPOSEFS_ROOT_STAMP "/run/ostree-composefs-root.stamp"
+#define _OSTREE_PREPARE_ROOT_TIMINGS "/run/ostree-prepare-root-timings"
 
 #define autofree __attribute__ ((cleanup (cleanup_free)))
 #define steal_pointer(pp) steal_pointer_impl ((void **)pp)
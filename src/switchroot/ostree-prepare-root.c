@@ -61,6 +61,7 @@
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -72,6 +73,7 @@
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 /* We can't include both linux/fs.h and sys/mount.h, so define these directly */
@@ -110,6 +112,62 @@ typedef enum
   OSTREE_COMPOSEFS_MODE_DIGEST, /* Always use and require specific digest */
 } OstreeComposefsMode;
 
+static uint64_t
+monotonic_usec (void)
+{
+  struct timespec ts;
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) < 0)
+    err (EXIT_FAILURE, "clock_gettime(CLOCK_MONOTONIC) failed");
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* Record how long a phase of root preparation took.  Boot time is a hard
+ * requirement for many ostree users; this makes the cost of each phase
+ * visible in the journal (or the kernel log when statically linked) and in
+ * a machine-parseable file under /run for post-boot analysis.
+ */
+static void
+record_timing (const char *phase, uint64_t start_usec)
+{
+  uint64_t elapsed_usec = monotonic_usec () - start_usec;
+
+#ifdef USE_LIBSYSTEMD
+  sd_journal_send ("MESSAGE=phase %s completed in %" PRIu64 " microseconds", phase, elapsed_usec,
+                   "PREPARE_ROOT_PHASE=%s", phase, "PREPARE_ROOT_USEC=%" PRIu64, elapsed_usec,
+                   NULL);
+#else
+  /* No journal; write to the kernel log so the data still ends up
+   * somewhere inspectable.  Failures here are not fatal. */
+  int kmsg_fd = open ("/dev/kmsg", O_WRONLY | O_CLOEXEC);
+  if (kmsg_fd >= 0)
+    {
+      char buf[256];
+      int n = snprintf (buf, sizeof (buf),
+                        "<6>ostree-prepare-root: phase %s completed in %" PRIu64
+                        " microseconds\n",
+                        phase, elapsed_usec);
+      if (n > 0)
+        (void)(write (kmsg_fd, buf, n) < 0);
+      (void)close (kmsg_fd);
+    }
+#endif
+
+  /* Also append to a timestamped file in /run; tooling running after boot
+   * can aggregate this without scraping logs.  /run may not be mounted in
+   * the pid1 case, so like touch_run_ostree() we ignore failures.
+   */
+  int fd = open (_OSTREE_PREPARE_ROOT_TIMINGS, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (fd >= 0)
+    {
+      char buf[256];
+      int n = snprintf (buf, sizeof (buf), "%" PRIu64 " %s %" PRIu64 "\n", monotonic_usec (),
+                        phase, elapsed_usec);
+      if (n > 0)
+        (void)(write (fd, buf, n) < 0);
+      (void)close (fd);
+    }
+}
+
 static inline bool
 sysroot_is_configured_ro (const char *sysroot)
 {
@@ -193,6 +251,7 @@ int
 main (int argc, char *argv[])
 {
   char srcpath[PATH_MAX];
+  const uint64_t start_usec = monotonic_usec ();
 
   /* If we're pid 1, that means there's no initramfs; in this situation
    * various defaults change:
@@ -239,7 +298,9 @@ main (int argc, char *argv[])
   const char *root_mountpoint = realpath (root_arg, NULL);
   if (root_mountpoint == NULL)
     err (EXIT_FAILURE, "realpath(\"%s\")", root_arg);
+  uint64_t phase_usec = monotonic_usec ();
   char *deploy_path = resolve_deploy_path (root_mountpoint);
+  record_timing ("resolve-deployment", phase_usec);
 
   if (we_mounted_proc)
     {
@@ -309,6 +370,7 @@ main (int argc, char *argv[])
      mount or a bind mount of the deploy-dir */
   if (composefs_mode != OSTREE_COMPOSEFS_MODE_OFF)
     {
+      phase_usec = monotonic_usec ();
 #ifdef HAVE_COMPOSEFS
       const char *objdirs[] = { "/sysroot/ostree/repo/objects" };
       struct lcfs_mount_options_s cfs_options = {
@@ -366,8 +428,10 @@ main (int argc, char *argv[])
 #else
       err (EXIT_FAILURE, "Composefs not supported");
 #endif
+      record_timing ("composefs-mount", phase_usec);
     }
 
+  phase_usec = monotonic_usec ();
   if (!using_composefs)
     {
       if (composefs_mode > OSTREE_COMPOSEFS_MODE_MAYBE)
@@ -512,6 +576,8 @@ main (int argc, char *argv[])
   if (!running_as_pid1)
     touch_run_ostree ();
 
+  record_timing ("setup-mounts", phase_usec);
+
   if (chdir (TMP_SYSROOT) < 0)
     err (EXIT_FAILURE, "failed to chdir to " TMP_SYSROOT);
 
@@ -561,6 +627,8 @@ main (int argc, char *argv[])
         }
     }
 
+  record_timing ("total", start_usec);
+
   if (running_as_pid1)
     {
       execl ("/sbin/init", "/sbin/init", NULL);
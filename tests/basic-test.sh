@@ -19,7 +19,7 @@
 
 set -euo pipefail
 
-echo "1..$((90 + ${extra_basic_tests:-0}))"
+echo "1..$((91 + ${extra_basic_tests:-0}))"
 
 CHECKOUT_U_ARG=""
 CHECKOUT_H_ARGS="-H"
@@ -746,6 +746,13 @@ done
 # now checkout the first pkg in force copy mode to make sure we can checksum
 rm union-identical-test -rf
 $OSTREE checkout --force-copy union-identical-pkg1 union-identical-test
+# --reflink falls back to a plain copy on filesystems without clone support,
+# so this must succeed (and match) everywhere.
+rm union-identical-test-reflink -rf
+$OSTREE checkout --force-copy --reflink union-identical-pkg1 union-identical-test-reflink
+assert_file_has_content union-identical-test-reflink/usr/bin/pkg1 "binary for pkg1"
+rm union-identical-test-reflink -rf
+echo "ok checkout --reflink fallback"
 for x in 2 3; do
     $OSTREE checkout ${CHECKOUT_H_ARGS} --union-identical union-identical-pkg${x} union-identical-test
 done
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Microbenchmarks for the core repository operations: commit, checkout,
+ * pull from a local trivial-httpd, static delta generate/apply, and
+ * prune.  Run via `make benchmarks` (not part of `make check`); each
+ * result is printed as one JSON object per line on stdout so the numbers
+ * can be tracked per release:
+ *
+ *   {"benchmark": "commit", "seconds": 1.2345, "items": 2048, "rate": 1659.2, "unit": "files/sec"}
+ *
+ * Absolute numbers depend entirely on the machine and filesystem; only
+ * compare runs from the same environment.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "libglnx.h"
+#include "libostreetest.h"
+#include "otutil.h"
+
+/* Files per synthetic commit; big enough that per-object costs dominate
+ * setup costs, small enough to keep a full run in the tens of seconds.
+ */
+#define BENCH_N_DIRS 32
+#define BENCH_FILES_PER_DIR 64
+#define BENCH_N_FILES (BENCH_N_DIRS * BENCH_FILES_PER_DIR)
+#define BENCH_FILE_SIZE 4096
+
+static void
+emit_result (const char *benchmark, gdouble seconds, guint64 items, const char *unit)
+{
+  char secbuf[G_ASCII_DTOSTR_BUF_SIZE];
+  char ratebuf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_ascii_formatd (secbuf, sizeof (secbuf), "%.4f", seconds);
+  g_ascii_formatd (ratebuf, sizeof (ratebuf), "%.1f", seconds > 0 ? items / seconds : 0);
+  g_print ("{\"benchmark\": \"%s\", \"seconds\": %s, \"items\": %" G_GUINT64_FORMAT
+           ", \"rate\": %s, \"unit\": \"%s\"}\n",
+           benchmark, secbuf, items, ratebuf, unit);
+}
+
+/* Write a deterministic pseudo-random source tree under @path.  @seed
+ * varies the content so successive trees are mostly-but-not-entirely
+ * different, which keeps the delta benchmarks honest.
+ */
+static gboolean
+write_bench_tree (const char *path, guint32 seed, GError **error)
+{
+  g_autoptr (GRand) rand = g_rand_new_with_seed (seed);
+  guint8 buf[BENCH_FILE_SIZE];
+
+  for (guint d = 0; d < BENCH_N_DIRS; d++)
+    {
+      g_autofree char *dirpath = g_strdup_printf ("%s/dir%02u", path, d);
+      if (!glnx_shutil_mkdir_p_at (AT_FDCWD, dirpath, 0755, NULL, error))
+        return FALSE;
+
+      for (guint f = 0; f < BENCH_FILES_PER_DIR; f++)
+        {
+          for (guint i = 0; i < sizeof (buf); i++)
+            buf[i] = (guint8)g_rand_int (rand);
+
+          g_autofree char *filepath = g_strdup_printf ("%s/file%02u", dirpath, f);
+          if (!g_file_set_contents (filepath, (const char *)buf, sizeof (buf), error))
+            return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+static gboolean
+bench_commit_tree (OstreeRepo *repo, const char *path, const char *parent, const char *ref,
+                   char **out_checksum, GCancellable *cancellable, GError **error)
+{
+  if (!ostree_repo_prepare_transaction (repo, NULL, cancellable, error))
+    return FALSE;
+
+  g_autoptr (OstreeMutableTree) mtree = ostree_mutable_tree_new ();
+  if (!ostree_repo_write_dfd_to_mtree (repo, AT_FDCWD, path, mtree, NULL, cancellable, error))
+    return FALSE;
+
+  g_autoptr (GFile) root = NULL;
+  if (!ostree_repo_write_mtree (repo, mtree, &root, cancellable, error))
+    return FALSE;
+
+  g_autofree char *checksum = NULL;
+  if (!ostree_repo_write_commit (repo, parent, "benchmark", NULL, NULL, OSTREE_REPO_FILE (root),
+                                 &checksum, cancellable, error))
+    return FALSE;
+
+  ostree_repo_transaction_set_ref (repo, NULL, ref, checksum);
+
+  if (!ostree_repo_commit_transaction (repo, NULL, cancellable, error))
+    return FALSE;
+
+  ot_transfer_out_value (out_checksum, &checksum);
+  return TRUE;
+}
+
+/* Find the one delta under repo/deltas whose name has no '-', i.e. the
+ * delta from the empty commit; see bench_delta below.
+ */
+static char *
+find_scratch_delta_path (GError **error)
+{
+  g_auto (GLnxDirFdIterator) dfd_iter = {
+    0,
+  };
+  if (!glnx_dirfd_iterator_init_at (AT_FDCWD, "repo/deltas", FALSE, &dfd_iter, error))
+    return NULL;
+
+  while (TRUE)
+    {
+      struct dirent *dent;
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&dfd_iter, &dent, NULL, error))
+        return NULL;
+      if (dent == NULL)
+        break;
+      if (dent->d_type != DT_DIR)
+        continue;
+
+      g_auto (GLnxDirFdIterator) subdfd_iter = {
+        0,
+      };
+      if (!glnx_dirfd_iterator_init_at (dfd_iter.fd, dent->d_name, FALSE, &subdfd_iter, error))
+        return NULL;
+
+      while (TRUE)
+        {
+          struct dirent *subdent;
+          if (!glnx_dirfd_iterator_next_dent (&subdfd_iter, &subdent, NULL, error))
+            return NULL;
+          if (subdent == NULL)
+            break;
+          if (strchr (subdent->d_name, '-') != NULL)
+            continue;
+
+          return g_strdup_printf ("repo/deltas/%s/%s", dent->d_name, subdent->d_name);
+        }
+    }
+
+  return glnx_null_throw (error, "No from-empty delta found under repo/deltas");
+}
+
+static void
+bench_commit_and_checkout (OstreeRepo *repo, char **out_commit1, char **out_commit2,
+                           GError **error)
+{
+  if (!write_bench_tree ("bench-tree1", 42, error))
+    return;
+
+  gint64 start = g_get_monotonic_time ();
+  g_autofree char *commit1 = NULL;
+  if (!bench_commit_tree (repo, "bench-tree1", NULL, "bench", &commit1, NULL, error))
+    return;
+  emit_result ("commit", (g_get_monotonic_time () - start) / (gdouble)G_USEC_PER_SEC,
+               BENCH_N_FILES, "files/sec");
+
+  OstreeRepoCheckoutAtOptions opts = {
+    0,
+  };
+  opts.mode = OSTREE_REPO_CHECKOUT_MODE_USER;
+  start = g_get_monotonic_time ();
+  if (!ostree_repo_checkout_at (repo, &opts, AT_FDCWD, "bench-co", commit1, NULL, error))
+    return;
+  emit_result ("checkout", (g_get_monotonic_time () - start) / (gdouble)G_USEC_PER_SEC,
+               BENCH_N_FILES, "files/sec");
+
+  /* A second, mostly-different tree on top for the delta and prune
+   * benchmarks below.
+   */
+  if (!write_bench_tree ("bench-tree2", 43, error))
+    return;
+  g_autofree char *commit2 = NULL;
+  if (!bench_commit_tree (repo, "bench-tree2", commit1, "bench", &commit2, NULL, error))
+    return;
+
+  *out_commit1 = g_steal_pointer (&commit1);
+  *out_commit2 = g_steal_pointer (&commit2);
+}
+
+static void
+bench_pull (OstreeRepo *repo, GError **error)
+{
+  /* Serve a repository over the local trivial-httpd, like the pull tests */
+  if (!ot_test_run_libtest ("setup_fake_remote_repo1 archive", error))
+    return;
+
+  g_autofree char *http_address = NULL;
+  if (!g_file_get_contents ("httpd-address", &http_address, NULL, error))
+    return;
+  g_strstrip (http_address);
+
+  g_autofree char *repo_url = g_strconcat (http_address, "/ostree/gnomerepo", NULL);
+  g_autoptr (GVariantBuilder) builder = g_variant_builder_new (G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (builder, "{s@v}", "gpg-verify",
+                         g_variant_new_variant (g_variant_new_boolean (FALSE)));
+  g_autoptr (GVariant) remote_opts = g_variant_ref_sink (g_variant_builder_end (builder));
+  if (!ostree_repo_remote_change (repo, NULL, OSTREE_REPO_REMOTE_CHANGE_ADD, "benchorigin",
+                                  repo_url, remote_opts, NULL, error))
+    return;
+
+  char *refs[] = { "main", NULL };
+  gint64 start = g_get_monotonic_time ();
+  if (!ostree_repo_pull (repo, "benchorigin", (char **)&refs, 0, NULL, NULL, error))
+    return;
+  gdouble seconds = (g_get_monotonic_time () - start) / (gdouble)G_USEC_PER_SEC;
+
+  g_autofree char *rev = NULL;
+  if (!ostree_repo_resolve_rev (repo, "benchorigin:main", FALSE, &rev, error))
+    return;
+  guint64 n_objects = 0;
+  g_autoptr (GHashTable) reachable = NULL;
+  if (!ostree_repo_traverse_commit (repo, rev, 0, &reachable, NULL, error))
+    return;
+  n_objects = g_hash_table_size (reachable);
+
+  emit_result ("pull", seconds, n_objects, "objects/sec");
+}
+
+static void
+bench_delta (OstreeRepo *repo, const char *commit1, const char *commit2, GError **error)
+{
+  gint64 start = g_get_monotonic_time ();
+  if (!ostree_repo_static_delta_generate (repo, OSTREE_STATIC_DELTA_GENERATE_OPT_MAJOR, commit1,
+                                          commit2, NULL, NULL, NULL, error))
+    return;
+  emit_result ("delta-generate", (g_get_monotonic_time () - start) / (gdouble)G_USEC_PER_SEC,
+               BENCH_N_FILES, "files/sec");
+
+  /* Applying the commit1..commit2 delta in place would be a no-op (the
+   * objects already exist), so apply a from-empty delta into a scratch
+   * repository instead.
+   */
+  if (!ostree_repo_static_delta_generate (repo, OSTREE_STATIC_DELTA_GENERATE_OPT_MAJOR, NULL,
+                                          commit1, NULL, NULL, NULL, error))
+    return;
+  g_autofree char *delta_path = find_scratch_delta_path (error);
+  if (delta_path == NULL)
+    return;
+
+  g_autoptr (OstreeRepo) scratch_repo
+      = ostree_repo_create_at (AT_FDCWD, "bench-delta-repo", OSTREE_REPO_MODE_BARE_USER, NULL,
+                               NULL, error);
+  if (scratch_repo == NULL)
+    return;
+
+  g_autoptr (GFile) delta_file = g_file_new_for_path (delta_path);
+  start = g_get_monotonic_time ();
+  if (!ostree_repo_static_delta_execute_offline (scratch_repo, delta_file, FALSE, NULL, error))
+    return;
+  emit_result ("delta-apply", (g_get_monotonic_time () - start) / (gdouble)G_USEC_PER_SEC,
+               BENCH_N_FILES, "files/sec");
+}
+
+static void
+bench_prune (OstreeRepo *repo, GError **error)
+{
+  /* Depth 0 discards commit1's unshared objects (half the bench tree) */
+  gint total, pruned;
+  guint64 pruned_size;
+  gint64 start = g_get_monotonic_time ();
+  if (!ostree_repo_prune (repo, OSTREE_REPO_PRUNE_FLAGS_REFS_ONLY, 0, &total, &pruned,
+                          &pruned_size, NULL, error))
+    return;
+  emit_result ("prune", (g_get_monotonic_time () - start) / (gdouble)G_USEC_PER_SEC,
+               (guint64)total, "objects/sec");
+}
+
+int
+main (int argc, char **argv)
+{
+  g_autoptr (GError) error = NULL;
+
+  g_autoptr (OstreeRepo) repo = ot_test_setup_repo (NULL, &error);
+  if (repo == NULL)
+    goto out;
+
+  g_autofree char *commit1 = NULL;
+  g_autofree char *commit2 = NULL;
+  bench_commit_and_checkout (repo, &commit1, &commit2, &error);
+  if (error != NULL)
+    goto out;
+
+  bench_pull (repo, &error);
+  if (error != NULL)
+    goto out;
+
+  bench_delta (repo, commit1, commit2, &error);
+  if (error != NULL)
+    goto out;
+
+  bench_prune (repo, &error);
+
+out:
+  if (error != NULL)
+    {
+      g_printerr ("benchmark-core: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2023 Endless OS Foundation LLC
+ *
+ * SPDX-License-Identifier: LGPL-2.0+
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* End-to-end pull benchmark over the local trivial-httpd, with a
+ * parameterizable synthetic repository generator.  Where benchmark-core
+ * measures each core operation on a small fixed tree, this program is
+ * meant for pull regression testing at scale: generate a server
+ * repository with a chosen object count, size distribution and tree
+ * depth, serve it over HTTP on localhost, and time a pull into a fresh
+ * client repository.
+ *
+ * Run via `make benchmarks`.  The shape of the synthetic repository is
+ * controlled by environment variables (the tap-test harness does not
+ * forward command line arguments):
+ *
+ *   OSTREE_BENCHMARK_PULL_FILES        total content objects (default 4096)
+ *   OSTREE_BENCHMARK_PULL_DEPTH       directory tree depth (default 4)
+ *   OSTREE_BENCHMARK_PULL_MEAN_SIZE   mean file size in bytes (default 8192)
+ *   OSTREE_BENCHMARK_PULL_SIZE_SPREAD log-uniform spread factor (default 8)
+ *   OSTREE_BENCHMARK_PULL_SEED        PRNG seed (default 42)
+ *
+ * As in benchmark-core, results are one JSON object per line on stdout.
+ * In addition to the overall wall clock, the per-phase timings that the
+ * pull code publishes through the extended OstreeAsyncProgress keys
+ * (summary fetch, metadata scan, delta apply, request latencies) are
+ * reported so a regression can be attributed to a phase; time not
+ * covered by those keys is dominated by object fetch and commit.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "libglnx.h"
+#include "libostreetest.h"
+#include "otutil.h"
+
+/* Tree shape constants; the parameters above control the totals, these
+ * control how the files are spread out.  With 8-way fanout and 16 files
+ * per directory a depth-4 tree holds ~75k files before the leaves start
+ * absorbing the overflow.
+ */
+#define BENCH_DIR_FANOUT 8
+#define BENCH_FILES_PER_DIR 16
+
+typedef struct
+{
+  guint64 n_files;
+  guint depth;
+  guint64 mean_size;
+  guint size_spread;
+  guint32 seed;
+} BenchParams;
+
+static guint64
+param_from_env (const char *name, guint64 default_value)
+{
+  const char *value = g_getenv (name);
+  if (value == NULL || *value == '\0')
+    return default_value;
+  return g_ascii_strtoull (value, NULL, 10);
+}
+
+static void
+emit_result (const char *benchmark, gdouble seconds, guint64 items, const char *unit)
+{
+  char secbuf[G_ASCII_DTOSTR_BUF_SIZE];
+  char ratebuf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_ascii_formatd (secbuf, sizeof (secbuf), "%.4f", seconds);
+  g_ascii_formatd (ratebuf, sizeof (ratebuf), "%.1f", seconds > 0 ? items / seconds : 0);
+  g_print ("{\"benchmark\": \"%s\", \"seconds\": %s, \"items\": %" G_GUINT64_FORMAT
+           ", \"rate\": %s, \"unit\": \"%s\"}\n",
+           benchmark, secbuf, items, ratebuf, unit);
+}
+
+/* Draw a file size roughly log-uniformly from [mean/spread, mean*spread]
+ * (spread rounded down to a power of two), so a spread of 1 gives
+ * fixed-size files and larger spreads approximate the heavy tail of a
+ * real OS tree.  Octave selection plus uniform jitter within the octave
+ * avoids needing libm.
+ */
+static gsize
+draw_file_size (GRand *rand, const BenchParams *params)
+{
+  guint octaves = 0;
+  for (guint s = params->size_spread; s > 1; s >>= 1)
+    octaves++;
+  if (octaves == 0)
+    return MAX (params->mean_size, 1);
+
+  gint32 shift = g_rand_int_range (rand, -(gint32)octaves, (gint32)octaves + 1);
+  guint64 size = (shift >= 0) ? params->mean_size << shift : params->mean_size >> (-shift);
+  size = MAX (size, 2);
+  /* Spread uniformly across [size/2, size) so sizes don't cluster on
+   * exact powers of two of the mean. */
+  return (gsize)(size / 2 + g_rand_int_range (rand, 0, (gint32)MIN (size / 2, G_MAXINT32 / 2)));
+}
+
+static gboolean
+write_synthetic_file (OstreeRepo *repo, OstreeMutableTree *mtree, const char *name, GRand *rand,
+                      const BenchParams *params, GCancellable *cancellable, GError **error)
+{
+  const gsize size = draw_file_size (rand, params);
+  g_autofree guint8 *buf = g_malloc (size);
+  for (gsize i = 0; i < size; i++)
+    buf[i] = (guint8)g_rand_int (rand);
+
+  g_autofree char *checksum = ostree_repo_write_regfile_inline (
+      repo, NULL, 0, 0, S_IFREG | 0644, NULL, buf, size, cancellable, error);
+  if (checksum == NULL)
+    return FALSE;
+
+  return ostree_mutable_tree_replace_file (mtree, name, checksum, error);
+}
+
+/* Recursively fill @mtree with synthetic content.  Each directory holds
+ * up to BENCH_FILES_PER_DIR files and BENCH_DIR_FANOUT subdirectories;
+ * directories at the maximum depth absorb whatever files remain so the
+ * requested total is always reached.
+ */
+static gboolean
+populate_dir (OstreeRepo *repo, OstreeMutableTree *mtree, const char *dirmeta_checksum,
+              GRand *rand, guint depth, guint64 *files_remaining, const BenchParams *params,
+              GCancellable *cancellable, GError **error)
+{
+  ostree_mutable_tree_set_metadata_checksum (mtree, dirmeta_checksum);
+
+  const guint64 quota = (depth == 0) ? *files_remaining : BENCH_FILES_PER_DIR;
+  for (guint64 f = 0; f < quota && *files_remaining > 0; f++, (*files_remaining)--)
+    {
+      g_autofree char *name = g_strdup_printf ("file%" G_GUINT64_FORMAT, f);
+      if (!write_synthetic_file (repo, mtree, name, rand, params, cancellable, error))
+        return FALSE;
+    }
+
+  if (depth == 0)
+    return TRUE;
+
+  for (guint d = 0; d < BENCH_DIR_FANOUT && *files_remaining > 0; d++)
+    {
+      g_autofree char *name = g_strdup_printf ("dir%02u", d);
+      g_autoptr (OstreeMutableTree) subdir = NULL;
+      if (!ostree_mutable_tree_ensure_dir (mtree, name, &subdir, error))
+        return FALSE;
+      if (!populate_dir (repo, subdir, dirmeta_checksum, rand, depth - 1, files_remaining, params,
+                         cancellable, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+generate_synthetic_commit (OstreeRepo *repo, const BenchParams *params, GCancellable *cancellable,
+                           GError **error)
+{
+  g_autoptr (GRand) rand = g_rand_new_with_seed (params->seed);
+
+  if (!ostree_repo_prepare_transaction (repo, NULL, cancellable, error))
+    return FALSE;
+
+  /* One shared 0755 root-owned dirmeta for every directory */
+  glnx_unref_object GFileInfo *fi = g_file_info_new ();
+  g_file_info_set_attribute_uint32 (fi, "unix::uid", 0);
+  g_file_info_set_attribute_uint32 (fi, "unix::gid", 0);
+  g_file_info_set_attribute_uint32 (fi, "unix::mode", (0755 | S_IFDIR));
+  g_autoptr (GVariant) dirmeta = ostree_create_directory_metadata (fi, NULL /* xattrs */);
+
+  g_autofree guchar *dirmeta_csum_raw = NULL;
+  if (!ostree_repo_write_metadata (repo, OSTREE_OBJECT_TYPE_DIR_META, NULL, dirmeta,
+                                   &dirmeta_csum_raw, cancellable, error))
+    return FALSE;
+  g_autofree char *dirmeta_checksum = ostree_checksum_from_bytes (dirmeta_csum_raw);
+
+  g_autoptr (OstreeMutableTree) mtree = ostree_mutable_tree_new ();
+  guint64 files_remaining = params->n_files;
+  if (!populate_dir (repo, mtree, dirmeta_checksum, rand, params->depth, &files_remaining, params,
+                     cancellable, error))
+    return FALSE;
+
+  g_autoptr (GFile) root = NULL;
+  if (!ostree_repo_write_mtree (repo, mtree, &root, cancellable, error))
+    return FALSE;
+
+  g_autofree char *checksum = NULL;
+  if (!ostree_repo_write_commit (repo, NULL, "benchmark", NULL, NULL, OSTREE_REPO_FILE (root),
+                                 &checksum, cancellable, error))
+    return FALSE;
+
+  ostree_repo_transaction_set_ref (repo, NULL, "bench", checksum);
+
+  return ostree_repo_commit_transaction (repo, NULL, cancellable, error);
+}
+
+/* Symlink the server repository into an httpd docroot and daemonize the
+ * trivial-httpd on a dynamic port, the same way setup_fake_remote_repo1
+ * does; the base URL ends up in the httpd-address file.
+ */
+static gboolean
+start_httpd (GError **error)
+{
+  return ot_test_run_libtest ("mkdir httpd && cd httpd && ln -s ${test_tmpdir}/ostree-srv ostree "
+                              "&& ${OSTREE_HTTPD} --autoexit --log-file $(pwd)/httpd.log "
+                              "--daemonize -p ${test_tmpdir}/httpd-port "
+                              "&& echo \"http://127.0.0.1:$(cat ${test_tmpdir}/httpd-port)\" "
+                              "> ${test_tmpdir}/httpd-address",
+                              error);
+}
+
+/* Report the phase breakdown the pull published through the extended
+ * progress keys; see update_progress() in ostree-repo-pull.c.
+ */
+static void
+emit_pull_phases (OstreeAsyncProgress *progress, gdouble total_seconds)
+{
+  char totalbuf[G_ASCII_DTOSTR_BUF_SIZE];
+  g_ascii_formatd (totalbuf, sizeof (totalbuf), "%.4f", total_seconds);
+  g_print ("{\"benchmark\": \"pull-phases\", \"total-seconds\": %s"
+           ", \"summary-fetch-usecs\": %" G_GUINT64_FORMAT
+           ", \"metadata-scan-usecs\": %" G_GUINT64_FORMAT
+           ", \"delta-apply-usecs\": %" G_GUINT64_FORMAT
+           ", \"bytes-transferred\": %" G_GUINT64_FORMAT ", \"request-count\": %u"
+           ", \"request-latency-p50-usecs\": %" G_GUINT64_FORMAT
+           ", \"request-latency-p99-usecs\": %" G_GUINT64_FORMAT "}\n",
+           totalbuf, ostree_async_progress_get_uint64 (progress, "summary-fetch-usecs"),
+           ostree_async_progress_get_uint64 (progress, "metadata-scan-usecs"),
+           ostree_async_progress_get_uint64 (progress, "delta-apply-usecs"),
+           ostree_async_progress_get_uint64 (progress, "bytes-transferred"),
+           ostree_async_progress_get_uint (progress, "request-count"),
+           ostree_async_progress_get_uint64 (progress, "request-latency-p50-usecs"),
+           ostree_async_progress_get_uint64 (progress, "request-latency-p99-usecs"));
+}
+
+static gboolean
+bench_pull (OstreeRepo *repo, GError **error)
+{
+  g_autofree char *http_address = NULL;
+  if (!g_file_get_contents ("httpd-address", &http_address, NULL, error))
+    return FALSE;
+  g_strstrip (http_address);
+
+  g_autofree char *repo_url = g_strconcat (http_address, "/ostree/benchrepo", NULL);
+  g_autoptr (GVariantBuilder) builder = g_variant_builder_new (G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (builder, "{s@v}", "gpg-verify",
+                         g_variant_new_variant (g_variant_new_boolean (FALSE)));
+  g_autoptr (GVariant) remote_opts = g_variant_ref_sink (g_variant_builder_end (builder));
+  if (!ostree_repo_remote_change (repo, NULL, OSTREE_REPO_REMOTE_CHANGE_ADD, "benchorigin",
+                                  repo_url, remote_opts, NULL, error))
+    return FALSE;
+
+  g_autoptr (OstreeAsyncProgress) progress = ostree_async_progress_new ();
+  char *refs[] = { "bench", NULL };
+  gint64 start = g_get_monotonic_time ();
+  if (!ostree_repo_pull (repo, "benchorigin", (char **)&refs, 0, progress, NULL, error))
+    return FALSE;
+  gdouble seconds = (g_get_monotonic_time () - start) / (gdouble)G_USEC_PER_SEC;
+
+  g_autofree char *rev = NULL;
+  if (!ostree_repo_resolve_rev (repo, "benchorigin:bench", FALSE, &rev, error))
+    return FALSE;
+  g_autoptr (GHashTable) reachable = NULL;
+  if (!ostree_repo_traverse_commit (repo, rev, 0, &reachable, NULL, error))
+    return FALSE;
+
+  emit_result ("pull", seconds, g_hash_table_size (reachable), "objects/sec");
+  emit_pull_phases (progress, seconds);
+  return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  g_autoptr (GError) error = NULL;
+
+  BenchParams params = {
+    .n_files = param_from_env ("OSTREE_BENCHMARK_PULL_FILES", 4096),
+    .depth = (guint)param_from_env ("OSTREE_BENCHMARK_PULL_DEPTH", 4),
+    .mean_size = param_from_env ("OSTREE_BENCHMARK_PULL_MEAN_SIZE", 8192),
+    .size_spread = (guint)param_from_env ("OSTREE_BENCHMARK_PULL_SIZE_SPREAD", 8),
+    .seed = (guint32)param_from_env ("OSTREE_BENCHMARK_PULL_SEED", 42),
+  };
+
+  if (!glnx_shutil_mkdir_p_at (AT_FDCWD, "ostree-srv", 0755, NULL, &error))
+    goto out;
+
+  g_autoptr (OstreeRepo) srv_repo = ostree_repo_create_at (
+      AT_FDCWD, "ostree-srv/benchrepo", OSTREE_REPO_MODE_ARCHIVE, NULL, NULL, &error);
+  if (srv_repo == NULL)
+    goto out;
+
+  gint64 start = g_get_monotonic_time ();
+  if (!generate_synthetic_commit (srv_repo, &params, NULL, &error))
+    goto out;
+  emit_result ("generate", (g_get_monotonic_time () - start) / (gdouble)G_USEC_PER_SEC,
+               params.n_files, "files/sec");
+
+  if (!ostree_repo_regenerate_summary (srv_repo, NULL, NULL, &error))
+    goto out;
+
+  if (!start_httpd (&error))
+    goto out;
+
+  g_autoptr (OstreeRepo) client_repo
+      = ostree_repo_create_at (AT_FDCWD, "repo", OSTREE_REPO_MODE_BARE_USER, NULL, NULL, &error);
+  if (client_repo == NULL)
+    goto out;
+
+  bench_pull (client_repo, &error);
+
+out:
+  if (error != NULL)
+    {
+      g_printerr ("benchmark-pull: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
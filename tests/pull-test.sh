@@ -52,7 +52,7 @@ function verify_initial_contents() {
     assert_file_has_content baz/cow '^moo$'
 }
 
-n_base_tests=35
+n_base_tests=36
 gpg_tests=3
 if has_gpgme; then
     echo "1..$(($n_base_tests+$gpg_tests))"
@@ -491,6 +491,16 @@ assert_not_has_file baz/saucer
 
 echo "ok static delta"
 
+# A tiny in-flight window still pulls correctly, just with less pipelining
+cd ${test_tmpdir}
+repo_init --no-sign-verify
+${CMD_PREFIX} ostree --repo=repo config set 'remote "origin"'.deltapart-inflight-mb 1
+${CMD_PREFIX} ostree --repo=repo pull origin main@${prev_rev}
+${CMD_PREFIX} ostree --repo=repo pull --require-static-deltas origin main
+${CMD_PREFIX} ostree --repo=repo fsck
+
+echo "ok static delta small inflight window"
+
 cd ${test_tmpdir}
 ${CMD_PREFIX} ostree --repo=ostree-srv/gnomerepo static-delta generate --swap-endianness main
 ${CMD_PREFIX} ostree --repo=ostree-srv/gnomerepo summary -u
@@ -24,7 +24,7 @@ set -euo pipefail
 # Exports OSTREE_SYSROOT so --sysroot not needed.
 setup_os_repository "archive" "syslinux"
 
-echo "1..8"
+echo "1..9"
 
 ${CMD_PREFIX} ostree --repo=sysroot/ostree/repo pull-local --remote=testos testos-repo testos/buildmain/x86_64-runtime
 rev=$(${CMD_PREFIX} ostree --repo=sysroot/ostree/repo rev-parse testos/buildmain/x86_64-runtime)
@@ -127,3 +127,16 @@ assert_n_pinned 1
 assert_n_deployments 3
 
 echo "ok pinning"
+
+# The deployment state cache built by the first status invocation must give
+# byte-identical output on the second, and an upgrade must invalidate it
+${CMD_PREFIX} ostree admin status > status-cold.txt
+assert_has_file sysroot/ostree/repo/tmp/cache/sysroot-state
+${CMD_PREFIX} ostree admin status > status-cached.txt
+assert_streq "$(cat status-cold.txt)" "$(cat status-cached.txt)"
+os_repository_new_commit
+${CMD_PREFIX} ostree admin upgrade --os=testos
+${CMD_PREFIX} ostree admin status > status-upgraded.txt
+assert_not_streq "$(cat status-cold.txt)" "$(cat status-upgraded.txt)"
+
+echo "ok status state cache"
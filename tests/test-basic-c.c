@@ -433,6 +433,61 @@ test_big_metadata (void)
   g_assert (ret);
 }
 
+static void
+test_skip_patterns (void)
+{
+  g_autoptr (GError) error = NULL;
+  gboolean ret = FALSE;
+
+  g_autoptr (GFile) repo_path = g_file_new_for_path ("repo");
+
+  /* init as bare-user-only so we run everywhere */
+  ret = ot_test_run_libtest ("setup_test_repository bare-user-only", &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  g_autoptr (OstreeRepo) repo = ostree_repo_new (repo_path);
+  ret = ostree_repo_open (repo, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  g_autoptr (OstreeRepoCommitModifier) modifier
+      = ostree_repo_commit_modifier_new (0, NULL, NULL, NULL);
+  ostree_repo_commit_modifier_add_skip_pattern (modifier, "/baz/cow*");
+  ostree_repo_commit_modifier_add_skip_pattern (modifier, "/baz/deeper");
+
+  ret = ostree_repo_prepare_transaction (repo, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  g_autoptr (OstreeMutableTree) mtree = ostree_mutable_tree_new ();
+  ret = ostree_repo_write_dfd_to_mtree (repo, AT_FDCWD, "files", mtree, modifier, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  g_autoptr (GFile) root = NULL;
+  ret = ostree_repo_write_mtree (repo, mtree, &root, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  ret = ostree_repo_abort_transaction (repo, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  /* Unmatched paths are untouched, matched files and directories are gone */
+  g_autoptr (GFile) firstfile = g_file_get_child (root, "firstfile");
+  g_assert (g_file_query_exists (firstfile, NULL));
+  g_autoptr (GFile) baz = g_file_get_child (root, "baz");
+  g_autoptr (GFile) saucer = g_file_get_child (baz, "saucer");
+  g_assert (g_file_query_exists (saucer, NULL));
+  g_autoptr (GFile) cow = g_file_get_child (baz, "cow");
+  g_assert (!g_file_query_exists (cow, NULL));
+  g_autoptr (GFile) cowro = g_file_get_child (baz, "cowro");
+  g_assert (!g_file_query_exists (cowro, NULL));
+  g_autoptr (GFile) deeper = g_file_get_child (baz, "deeper");
+  g_assert (!g_file_query_exists (deeper, NULL));
+}
+
 static void
 compare_xattrs (GVariant *orig, GVariant *new)
 {
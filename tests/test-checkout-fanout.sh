@@ -0,0 +1,39 @@
+#!/usr/bin/env bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+setup_test_repository "bare-user"
+
+echo "1..3"
+
+cd ${test_tmpdir}
+mkdir -p files/sub1 files/sub2
+for d in files/sub1 files/sub2; do
+    for i in $(seq 1 10); do
+        echo "${d} content ${i}" > ${d}/file-${i}
+    done
+done
+ln -s file-1 files/sub1/link-1
+$OSTREE commit -b fanout-test --tree=dir=files
+
+$OSTREE checkout fanout-test co-1 co-2 co-3
+diff -r co-1 co-2
+diff -r co-1 co-3
+echo "ok fanout checkouts match"
+
+# Replicas hardlink from the first checkout by default
+assert_files_hardlinked co-1/sub1/file-1 co-2/sub1/file-1
+assert_files_hardlinked co-1/sub1/file-1 co-3/sub1/file-1
+echo "ok fanout replicas hardlink"
+
+# Force-copy fanout must not share inodes
+$OSTREE checkout --force-copy fanout-test copy-1 copy-2
+diff -r copy-1 copy-2
+if files_are_hardlinked copy-1/sub1/file-1 copy-2/sub1/file-1; then
+    fatal "force-copy fanout hardlinked files"
+fi
+echo "ok fanout force-copy"
@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+setup_test_repository "bare-user"
+
+echo "1..2"
+
+cd ${test_tmpdir}
+mkdir -p files/sub1/a files/sub1/b files/sub2/c
+for d in files/sub1/a files/sub1/b files/sub2/c; do
+    for i in $(seq 1 20); do
+        echo "${d} content ${i}" > ${d}/file-${i}
+    done
+done
+$OSTREE commit -b parallel-test --tree=dir=files
+
+$OSTREE checkout --threads=-1 parallel-test checkout-parallel
+$OSTREE checkout parallel-test checkout-serial
+diff -r checkout-parallel checkout-serial
+echo "ok parallel checkout matches serial"
+
+# Also exercise an explicit small thread count with union mode
+echo "changed" > files/sub1/a/file-1
+$OSTREE commit -b parallel-test --tree=dir=files
+$OSTREE checkout --threads=2 --union parallel-test checkout-parallel
+assert_file_has_content checkout-parallel/sub1/a/file-1 changed
+echo "ok parallel checkout union"
@@ -21,6 +21,7 @@
 
 #include "libglnx.h"
 #include "ostree-core-private.h"
+#include "otutil.h"
 #include <gio/gio.h>
 #include <glib.h>
 #include <stdlib.h>
@@ -86,10 +87,42 @@ test_ostree_parse_delta_name (void)
   }
 }
 
+/* Batch hashing must agree with the one-shot path for any mix of buffer
+ * sizes, both below and above the internal threading threshold.
+ */
+static void
+test_checksum_many (void)
+{
+  /* Large enough that multiple lanes are used on multi-processor machines */
+  const guint n = 300;
+  g_autoptr (GPtrArray) buffers = g_ptr_array_new_with_free_func ((GDestroyNotify)g_bytes_unref);
+
+  for (guint i = 0; i < n; i++)
+    {
+      const gsize len = (i * 37) % 4096;
+      g_autofree guint8 *data = g_malloc (len ? len : 1);
+      for (gsize j = 0; j < len; j++)
+        data[j] = (guint8)(i + j);
+      g_ptr_array_add (buffers, g_bytes_new (data, len));
+    }
+
+  g_autofree guint8 *digests = g_malloc ((gsize)n * OSTREE_SHA256_DIGEST_LEN);
+  ot_checksum_many ((GBytes **)buffers->pdata, n, digests);
+
+  for (guint i = 0; i < n; i++)
+    {
+      guint8 expected[OSTREE_SHA256_DIGEST_LEN];
+      ot_checksum_bytes (buffers->pdata[i], expected);
+      g_assert_cmpmem (digests + (gsize)i * OSTREE_SHA256_DIGEST_LEN, OSTREE_SHA256_DIGEST_LEN,
+                       expected, sizeof (expected));
+    }
+}
+
 int
 main (int argc, char **argv)
 {
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/ostree_parse_delta_name", test_ostree_parse_delta_name);
+  g_test_add_func ("/checksum_many", test_checksum_many);
   return g_test_run ();
 }
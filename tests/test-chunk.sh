@@ -0,0 +1,70 @@
+#!/usr/bin/env bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+echo '1..5'
+
+cd ${test_tmpdir}
+
+mkdir repo
+ostree_repo_init repo --mode=archive
+mkdir files
+seq 1 300000 > files/bigfile
+echo "small" > files/smallfile
+${CMD_PREFIX} ostree --repo=repo commit -b test -s "initial" files
+
+${CMD_PREFIX} ostree --repo=repo chunk --min-size=100 > chunk.txt
+assert_file_has_content chunk.txt "^Chunked 1 objects$"
+assert_streq "$(find repo/objects/chunk -name '*.recipe' | wc -l)" "1"
+n_chunks=$(find repo/objects/chunk -name '*.chunk' | wc -l)
+if [ "${n_chunks}" -lt 3 ]; then
+    assert_not_reached "expected at least 3 chunks, got ${n_chunks}"
+fi
+# The small file stays loose
+assert_streq "$(find repo/objects -name '*.filez' -size +100k | wc -l)" "0"
+echo "ok 1 chunk splits large objects"
+
+# Chunked objects must be readable through the normal APIs.
+${CMD_PREFIX} ostree --repo=repo fsck
+${CMD_PREFIX} ostree --repo=repo cat test /bigfile > out.txt
+cmp out.txt files/bigfile
+mkdir co
+${CMD_PREFIX} ostree --repo=repo checkout -U test co/test
+cmp co/test/bigfile files/bigfile
+assert_file_has_content co/test/smallfile "^small$"
+echo "ok 2 chunked objects readable"
+
+# A mostly-identical file should share most chunks with the first one.
+seq 1 300000 > files/bigfile2
+echo "trailing change" >> files/bigfile2
+${CMD_PREFIX} ostree --repo=repo commit -b test -s "second" files
+${CMD_PREFIX} ostree --repo=repo chunk --min-size=100 -q
+assert_streq "$(find repo/objects/chunk -name '*.recipe' | wc -l)" "2"
+n_chunks2=$(find repo/objects/chunk -name '*.chunk' | wc -l)
+if [ "${n_chunks2}" -ge "$((n_chunks * 2))" ]; then
+    assert_not_reached "no deduplication: ${n_chunks} chunks grew to ${n_chunks2}"
+fi
+${CMD_PREFIX} ostree --repo=repo fsck
+${CMD_PREFIX} ostree --repo=repo cat test /bigfile2 > out2.txt
+cmp out2.txt files/bigfile2
+echo "ok 3 near-identical objects share chunks"
+
+# A chunked repo can serve pull-local.
+mkdir repo2
+ostree_repo_init repo2 --mode=archive
+${CMD_PREFIX} ostree --repo=repo2 pull-local repo test
+${CMD_PREFIX} ostree --repo=repo2 fsck
+echo "ok 4 pull-local from chunked repo"
+
+# Chunking is restricted to archive mode.
+mkdir barerepo
+ostree_repo_init barerepo --mode=bare-user
+if ${CMD_PREFIX} ostree --repo=barerepo chunk 2>err.txt; then
+    assert_not_reached "chunk of bare repo succeeded"
+fi
+assert_file_has_content err.txt "archive mode"
+echo "ok 5 chunk requires archive mode"
@@ -0,0 +1,55 @@
+#!/usr/bin/env bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+echo '1..4'
+
+cd ${test_tmpdir}
+
+mkdir repo
+ostree_repo_init repo
+mkdir files
+echo one > files/a
+
+${CMD_PREFIX} ostree --repo=repo commit -b test -s "c1" files
+c1=$(${CMD_PREFIX} ostree --repo=repo rev-parse test)
+echo two > files/a
+${CMD_PREFIX} ostree --repo=repo commit -b test -s "c2" files
+c2=$(${CMD_PREFIX} ostree --repo=repo rev-parse test)
+echo three > files/a
+${CMD_PREFIX} ostree --repo=repo commit -b test -s "c3" files
+c3=$(${CMD_PREFIX} ostree --repo=repo rev-parse test)
+
+assert_has_file repo/objects/commit-graph
+echo "ok 1 commit-graph created on commit"
+
+# Ancestry resolution through the graph
+assert_streq "$(${CMD_PREFIX} ostree --repo=repo rev-parse test^)" "${c2}"
+assert_streq "$(${CMD_PREFIX} ostree --repo=repo rev-parse test^^)" "${c1}"
+${CMD_PREFIX} ostree --repo=repo log test > log.txt
+assert_file_has_content log.txt "${c1}"
+assert_file_has_content log.txt "${c3}"
+echo "ok 2 ancestry resolution"
+
+# After pruning, the parent pointer still resolves (it lives in the commit
+# metadata and the graph), but the pruned object itself must stay gone
+${CMD_PREFIX} ostree --repo=repo prune --refs-only --depth=0 > /dev/null
+assert_streq "$(${CMD_PREFIX} ostree --repo=repo rev-parse test^)" "${c2}"
+if ${CMD_PREFIX} ostree --repo=repo show ${c2} 2>err.txt; then
+    assert_not_reached "pruned commit resurrected"
+fi
+${CMD_PREFIX} ostree --repo=repo fsck
+echo "ok 3 pruned commits stay pruned"
+
+# The graph is extended incrementally by later commits
+echo four > files/a
+${CMD_PREFIX} ostree --repo=repo commit -b test -s "c4" files
+assert_streq "$(${CMD_PREFIX} ostree --repo=repo rev-parse test^)" "${c3}"
+# And commit-only traversal (prune --commit-only) works via the graph
+${CMD_PREFIX} ostree --repo=repo prune --commit-only --refs-only --depth=1 > /dev/null
+${CMD_PREFIX} ostree --repo=repo fsck
+echo "ok 4 incremental updates"
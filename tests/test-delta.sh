@@ -116,6 +116,16 @@ ${CMD_PREFIX} ostree --repo=repo static-delta generate --from=${origrev} --to=${
 assert_has_file repo/deltas/${deltaprefix}/${deltadir}/superblock
 assert_has_file repo/deltas/${deltaprefix}/${deltadir}/0
 
+${CMD_PREFIX} ostree --repo=repo static-delta generate --threads=4 --from=${origrev} --to=${newrev}
+
+assert_has_file repo/deltas/${deltaprefix}/${deltadir}/superblock
+assert_has_file repo/deltas/${deltaprefix}/${deltadir}/0
+
+${CMD_PREFIX} ostree --repo=repo static-delta generate --compress-threads=4 --from=${origrev} --to=${newrev}
+
+assert_has_file repo/deltas/${deltaprefix}/${deltadir}/superblock
+assert_has_file repo/deltas/${deltaprefix}/${deltadir}/0
+
 ${CMD_PREFIX} ostree --repo=repo static-delta generate --disable-bsdiff --from=${origrev} --to=${newrev} 2>&1 | grep "bsdiff=0 objects"
 ${CMD_PREFIX} ostree --repo=repo static-delta generate --max-bsdiff-size=0 --from=${origrev} --to=${newrev} 2>&1 | grep "bsdiff=0 objects"
 ${CMD_PREFIX} ostree --repo=repo static-delta generate --max-bsdiff-size=10000 --from=${origrev} --to=${newrev} 2>&1 | grep "bsdiff=[1-9]"
@@ -187,6 +197,17 @@ ${CMD_PREFIX} ostree --repo=repo2 pull-local --require-static-deltas repo ${orig
 ${CMD_PREFIX} ostree --repo=repo2 fsck
 ${CMD_PREFIX} ostree --repo=repo2 ls ${origrev} >/dev/null
 
+# The verified superblock should have been cached for later update checks,
+# named after its digest from the summary.
+assert_streq "$(ls repo2/tmp/cache/delta-superblocks | wc -l)" "1"
+cachedsb=$(get_assert_one_direntry_matching repo2/tmp/cache/delta-superblocks '.')
+assert_streq "${cachedsb}" "$(sha256sum < repo2/tmp/cache/delta-superblocks/${cachedsb} | cut -d' ' -f1)"
+# A repeat pull must succeed with the cached copy.
+${CMD_PREFIX} ostree --repo=repo2 pull-local --require-static-deltas repo ${origrev}
+# The cache is regenerable state; prune clears it.
+${CMD_PREFIX} ostree --repo=repo2 prune
+assert_not_has_dir repo2/tmp/cache/delta-superblocks
+
 echo 'ok pull delta'
 
 rm repo2 -rf
@@ -0,0 +1,28 @@
+#!/usr/bin/env bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+setup_test_repository "bare-user"
+
+echo "1..2"
+
+cd ${test_tmpdir}
+$OSTREE checkout test2 checkout-test2
+$OSTREE commit -b test2 --link-checkout-speedup checkout-test2
+assert_has_file repo/tmp/cache/devino-cache
+echo "ok devino cache written"
+
+# A second commit should be able to reuse the cache; contents must be
+# unaffected either way.
+rm -rf checkout-test2
+$OSTREE checkout test2 checkout-test2
+echo new-content > checkout-test2/new-file
+$OSTREE commit -b test2 --link-checkout-speedup checkout-test2
+$OSTREE fsck
+$OSTREE ls test2 new-file > ls.txt
+assert_file_has_content ls.txt new-file
+echo "ok devino cache reused"
@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+echo '1..3'
+
+cd ${test_tmpdir}
+
+mkdir repo
+ostree_repo_init repo --mode=archive-z2
+mkdir files
+for i in $(seq 1 30); do
+    echo "content ${i}" > files/file-${i}
+done
+${CMD_PREFIX} ostree --repo=repo commit -b test -s "initial" files
+
+${CMD_PREFIX} ostree --repo=repo fsck --parallel=-1
+echo "ok 1 parallel fsck clean"
+
+# Corrupt one content object; parallel fsck must still catch it.
+file=$(find repo/objects -name '*.file' | head -1)
+echo whoops > ${file}
+if ${CMD_PREFIX} ostree --repo=repo fsck --parallel=2 --all > fsck 2> fsck-error; then
+    assert_not_reached "parallel fsck did not fail"
+fi
+assert_file_has_content fsck-error "In commits"
+echo "ok 2 parallel fsck detects corruption"
+
+# --delete works the same way under --parallel.
+if ${CMD_PREFIX} ostree --repo=repo fsck --parallel=2 --delete > fsck 2> fsck-error; then
+    assert_not_reached "parallel fsck did not fail"
+fi
+assert_not_has_file ${file}
+echo "ok 3 parallel fsck --delete"
@@ -0,0 +1,29 @@
+#!/usr/bin/env bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+echo "1..2"
+
+mkdir testrepo
+ostree_repo_init testrepo --mode="bare-user"
+${CMD_PREFIX} ostree --repo=testrepo config set core.fsync-barrier batch
+
+mkdir testrepo-files
+for i in $(seq 1 20); do
+    echo "content ${i}" > testrepo-files/file-${i}
+done
+${CMD_PREFIX} ostree --repo=testrepo commit -b test -s "initial" testrepo-files
+${CMD_PREFIX} ostree --repo=testrepo fsck
+echo "ok batch fsync barrier commit"
+
+# An invalid value must be rejected at repo open time.
+${CMD_PREFIX} ostree --repo=testrepo config set core.fsync-barrier bogus
+if ${CMD_PREFIX} ostree --repo=testrepo refs 2>err.txt; then
+    fatal "opened repo with invalid fsync-barrier"
+fi
+assert_file_has_content err.txt "Invalid fsync-barrier"
+echo "ok invalid fsync-barrier rejected"
@@ -0,0 +1,62 @@
+#!/bin/bash
+#
+# Copyright (C) 2023 Colin Walters <walters@verbum.org>
+#
+# SPDX-License-Identifier: LGPL-2.0+
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library. If not, see <https://www.gnu.org/licenses/>.
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+echo '1..3'
+
+setup_test_repository "archive"
+
+cd ${test_tmpdir}
+
+# Two pool repos with distinct content, and a child consulting both
+mkdir pool1-files
+echo pool1 > pool1-files/from-pool1
+ostree_repo_init pool1 --mode=archive
+${CMD_PREFIX} ostree --repo=pool1 commit -b pool1ref --tree=dir=pool1-files
+
+mkdir pool2-files
+echo pool2 > pool2-files/from-pool2
+ostree_repo_init pool2 --mode=archive
+${CMD_PREFIX} ostree --repo=pool2 commit -b pool2ref --tree=dir=pool2-files
+
+ostree_repo_init child --mode=archive
+${CMD_PREFIX} ostree config --repo=child set core.object-pools "$(pwd)/pool1;$(pwd)/pool2"
+
+# Objects in either pool are visible from the child
+pool1rev=$(${CMD_PREFIX} ostree --repo=pool1 rev-parse pool1ref)
+pool2rev=$(${CMD_PREFIX} ostree --repo=pool2 rev-parse pool2ref)
+${CMD_PREFIX} ostree --repo=child show ${pool1rev} > /dev/null
+${CMD_PREFIX} ostree --repo=child show ${pool2rev} > /dev/null
+echo "ok object pool metadata visible"
+
+${CMD_PREFIX} ostree --repo=child checkout -U ${pool1rev} co1
+assert_file_has_content co1/from-pool1 pool1
+${CMD_PREFIX} ostree --repo=child checkout -U ${pool2rev} co2
+assert_file_has_content co2/from-pool2 pool2
+echo "ok object pool content visible"
+
+# A local pull into the child doesn't duplicate pooled objects
+${CMD_PREFIX} ostree --repo=child pull-local pool1 pool1ref
+assert_has_file child/refs/heads/pool1ref
+find child/objects -name '*.filez' > pulled-objects.txt
+assert_file_empty pulled-objects.txt
+echo "ok pull dedups against object pools"
@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+echo '1..6'
+
+cd ${test_tmpdir}
+
+mkdir repo
+ostree_repo_init repo
+
+mkdir -p tree/root
+touch tree/root/a
+
+seq 5 | while read i; do
+    echo a >> tree/root/a
+    ${CMD_PREFIX} ostree --repo=repo commit --branch=test-$i -m test -s test tree
+    ${CMD_PREFIX} ostree --repo=repo commit --branch=foo/test-$i -m test -s test tree
+done
+
+${CMD_PREFIX} ostree --repo=repo refs -r | sort > refs-before.txt
+
+${CMD_PREFIX} ostree --repo=repo refs --pack
+assert_has_file repo/packed-refs
+assert_streq "$(find repo/refs/heads -type f | wc -l)" "0"
+echo "ok 1 refs --pack removes loose refs"
+
+# Listing must be unchanged, including prefix listing
+${CMD_PREFIX} ostree --repo=repo refs -r | sort > refs-after.txt
+assert_files_equal refs-before.txt refs-after.txt
+${CMD_PREFIX} ostree --repo=repo refs foo > refs-foo.txt
+assert_file_has_content refs-foo.txt '^test-3$'
+assert_streq "$(wc -l < refs-foo.txt)" "5"
+echo "ok 2 listing packed refs"
+
+# Resolving packed refs must work
+for v in test-2 foo/test-4; do
+    ${CMD_PREFIX} ostree --repo=repo rev-parse $v > /dev/null
+done
+${CMD_PREFIX} ostree --repo=repo log test-1 > /dev/null
+echo "ok 3 resolving packed refs"
+
+# A new commit writes the ref loose again and updates the index
+oldrev=$(${CMD_PREFIX} ostree --repo=repo rev-parse test-1)
+echo b >> tree/root/a
+${CMD_PREFIX} ostree --repo=repo commit --branch=test-1 -m test2 -s test2 tree
+newrev=$(${CMD_PREFIX} ostree --repo=repo rev-parse test-1)
+assert_not_streq "${oldrev}" "${newrev}"
+assert_has_file repo/refs/heads/test-1
+echo "ok 4 updating a packed ref"
+
+# Deleting a packed ref must drop it from the index, not resurrect it
+${CMD_PREFIX} ostree --repo=repo refs --delete test-2
+if ${CMD_PREFIX} ostree --repo=repo rev-parse test-2 2>err.txt; then
+    assert_not_reached "deleted packed ref still resolves"
+fi
+${CMD_PREFIX} ostree --repo=repo refs > refs-deleted.txt
+assert_not_file_has_content refs-deleted.txt '^test-2$'
+echo "ok 5 deleting a packed ref"
+
+# Repacking folds the loose updates back in; summary generation works
+${CMD_PREFIX} ostree --repo=repo refs --pack
+assert_streq "$(find repo/refs/heads -type f | wc -l)" "0"
+assert_streq "$(${CMD_PREFIX} ostree --repo=repo rev-parse test-1)" "${newrev}"
+${CMD_PREFIX} ostree --repo=repo summary -u
+${CMD_PREFIX} ostree --repo=repo summary -v | grep -q 'test-1'
+echo "ok 6 repack and summary"
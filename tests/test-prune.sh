@@ -61,6 +61,29 @@ assert_file_has_content noprune.txt 'Would delete: [1-9][0-9]* objects, freeing
 objectcount_new=$(find repo/objects | wc -l)
 assert_streq "${objectcount_orig}" "${objectcount_new}"
 
+# The parallel traversal must compute the identical reachable set
+${CMD_PREFIX} ostree prune --repo=repo --refs-only --depth=0 --no-prune --parallel | tee noprune-parallel.txt
+assert_streq "$(cat noprune.txt)" "$(cat noprune-parallel.txt)"
+
+# So must the indexed traversal, which also populates the persistent index...
+${CMD_PREFIX} ostree prune --repo=repo --refs-only --depth=0 --no-prune --indexed | tee noprune-indexed.txt
+assert_streq "$(cat noprune.txt)" "$(cat noprune-indexed.txt)"
+assert_streq "$(find repo/tmp/cache/prune-index -name '*.reachable' | wc -l)" "1"
+# ...so a second run is answered from the index
+${CMD_PREFIX} ostree prune --repo=repo --refs-only --depth=0 --no-prune --indexed | tee noprune-indexed2.txt
+assert_streq "$(cat noprune.txt)" "$(cat noprune-indexed2.txt)"
+
+# The refcount ledger must agree as well; the first run builds the ledger...
+${CMD_PREFIX} ostree prune --repo=repo --refs-only --depth=0 --refcount --no-prune | tee noprune-refcount.txt
+assert_streq "$(cat noprune.txt)" "$(cat noprune-refcount.txt)"
+# ...(--no-prune doesn't persist it; a real prune does, here with nothing to delete)
+assert_not_has_file repo/tmp/cache/refcounts/counts
+${CMD_PREFIX} ostree prune --repo=repo --refcount
+assert_has_file repo/tmp/cache/refcounts/counts
+# ...after which the ledger answers reconciled prunes without traversal
+${CMD_PREFIX} ostree prune --repo=repo --refs-only --depth=0 --refcount --no-prune | tee noprune-refcount2.txt
+assert_streq "$(cat noprune.txt)" "$(cat noprune-refcount2.txt)"
+
 ${CMD_PREFIX} ostree prune --repo=repo --refs-only --depth=2 -v
 assert_repo_has_n_commits repo 3
 find repo/objects -name '*.tombstone-commit' | wc -l > tombstonecommitcount
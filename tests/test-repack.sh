@@ -0,0 +1,84 @@
+#!/usr/bin/env bash
+#
+# SPDX-License-Identifier: LGPL-2.0+
+
+set -euo pipefail
+
+. $(dirname $0)/libtest.sh
+
+echo '1..6'
+
+cd ${test_tmpdir}
+
+mkdir repo
+ostree_repo_init repo --mode=archive
+mkdir files
+for i in $(seq 1 20); do
+    echo "content ${i}" > files/file-${i}
+done
+${CMD_PREFIX} ostree --repo=repo commit -b test -s "initial" files
+
+${CMD_PREFIX} ostree --repo=repo repack > repack.txt
+assert_file_has_content repack.txt "^Packed [1-9][0-9]* loose objects$"
+assert_streq "$(ls repo/objects/pack/*.idx | wc -l)" "1"
+assert_streq "$(ls repo/objects/pack/*.data | wc -l)" "1"
+# Only the commit object stays loose
+assert_streq "$(find repo/objects -name '*.filez' -o -name '*.dirtree' -o -name '*.dirmeta' | wc -l)" "0"
+assert_streq "$(find repo/objects -name '*.commit' | wc -l)" "1"
+echo "ok 1 repack consolidates loose objects"
+
+# Packed objects must be readable through the normal APIs.
+${CMD_PREFIX} ostree --repo=repo fsck
+${CMD_PREFIX} ostree --repo=repo ls test >/dev/null
+${CMD_PREFIX} ostree --repo=repo cat test /file-1 > out.txt
+assert_file_has_content out.txt "^content 1$"
+mkdir co
+${CMD_PREFIX} ostree --repo=repo checkout -U test co/test
+assert_file_has_content co/test/file-3 "^content 3$"
+echo "ok 2 packed objects readable"
+
+# A packed repo can serve pull-local.
+mkdir repo2
+ostree_repo_init repo2 --mode=archive
+${CMD_PREFIX} ostree --repo=repo2 pull-local repo test
+${CMD_PREFIX} ostree --repo=repo2 fsck
+echo "ok 3 pull-local from packed repo"
+
+# New loose objects from a later commit repack into a second pack.
+echo "new content" > files/file-new
+${CMD_PREFIX} ostree --repo=repo commit -b test -s "second" files
+${CMD_PREFIX} ostree --repo=repo repack -q
+assert_streq "$(ls repo/objects/pack/*.idx | wc -l)" "2"
+${CMD_PREFIX} ostree --repo=repo fsck
+${CMD_PREFIX} ostree --repo=repo cat test /file-new > out.txt
+assert_file_has_content out.txt "^new content$"
+echo "ok 4 incremental repack"
+
+# Repack is restricted to archive mode.
+mkdir barerepo
+ostree_repo_init barerepo --mode=bare-user
+if ${CMD_PREFIX} ostree --repo=barerepo repack 2>err.txt; then
+    assert_not_reached "repack of bare repo succeeded"
+fi
+assert_file_has_content err.txt "archive mode"
+echo "ok 5 repack requires archive mode"
+
+# Pulling over HTTP discovers the packs via the manifest and fetches the
+# packed metadata with byte-range requests.
+cd ${test_tmpdir}
+assert_streq "$(wc -l < repo/objects/pack/manifest)" "2"
+mkdir httpd
+cd httpd
+ln -s ${test_tmpdir} ostree
+${OSTREE_HTTPD} --autoexit --daemonize -p ${test_tmpdir}/httpd-port
+port=$(cat ${test_tmpdir}/httpd-port)
+cd ${test_tmpdir}
+mkdir repo3
+ostree_repo_init repo3 --mode=archive
+${CMD_PREFIX} ostree --repo=repo3 remote add --set=gpg-verify=false origin http://127.0.0.1:${port}/ostree/repo
+${CMD_PREFIX} ostree --repo=repo3 pull origin test
+${CMD_PREFIX} ostree --repo=repo3 fsck
+mkdir co2
+${CMD_PREFIX} ostree --repo=repo3 checkout -U test co2/test
+assert_file_has_content co2/test/file-new "^new content$"
+echo "ok 6 pull over http from packed repo"
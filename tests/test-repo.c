@@ -157,6 +157,35 @@ test_repo_equal (Fixture *fixture, gconstpointer test_data)
   g_assert_false (ostree_repo_equal (closed_repo, closed_repo));
 }
 
+/* Test that instances of the same repository share one parsed config, and that
+ * rewriting the config is picked up by instances opened afterwards. */
+static void
+test_repo_config_cache (Fixture *fixture, gconstpointer test_data)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (OstreeRepo) repo1 = ostree_repo_create_at (
+      fixture->tmpdir.fd, ".", OSTREE_REPO_MODE_ARCHIVE, NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  /* A second instance should reuse the cached keyfile rather than re-parsing. */
+  g_autoptr (OstreeRepo) repo2 = ostree_repo_open_at (fixture->tmpdir.fd, ".", NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (ostree_repo_get_config (repo1) == ostree_repo_get_config (repo2));
+
+  /* Rewriting the config replaces the cache entry for later instances. */
+  g_autoptr (GKeyFile) config = ostree_repo_copy_config (repo1);
+  g_key_file_set_integer (config, "core", "lock-timeout-secs", 5);
+  ostree_repo_write_config (repo1, config, &error);
+  g_assert_no_error (error);
+
+  g_autoptr (OstreeRepo) repo3 = ostree_repo_open_at (fixture->tmpdir.fd, ".", NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (
+      g_key_file_get_integer (ostree_repo_get_config (repo3), "core", "lock-timeout-secs", NULL),
+      ==, 5);
+  g_assert_true (ostree_repo_get_config (repo1) == ostree_repo_get_config (repo3));
+}
+
 static void
 test_repo_get_min_free_space (Fixture *fixture, gconstpointer test_data)
 {
@@ -550,6 +579,7 @@ main (int argc, char **argv)
   g_test_add ("/repo/hash", Fixture, NULL, setup, test_repo_hash, teardown);
   g_test_add ("/repo/hash/closed", Fixture, NULL, setup, test_repo_hash_closed, teardown);
   g_test_add ("/repo/equal", Fixture, NULL, setup, test_repo_equal, teardown);
+  g_test_add ("/repo/config-cache", Fixture, NULL, setup, test_repo_config_cache, teardown);
   g_test_add ("/repo/get_min_free_space", Fixture, NULL, setup, test_repo_get_min_free_space,
               teardown);
   g_test_add ("/repo/write_regfile_api", Fixture, NULL, setup, test_write_regfile_api, teardown);
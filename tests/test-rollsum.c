@@ -180,11 +180,72 @@ test_bupsplit_sum (void)
   g_assert_cmpint (sum3a, ==, sum3b);
 }
 
+/* Cross-check bupsplit_find_ofs() (which may use a vectorized kernel)
+ * against the scalar bupsplit_sum(): every split offset it reports must
+ * satisfy the defining property that the rolling checksum over the
+ * trailing window has its BUP_BLOBBITS low bits set, and no split may
+ * depend on the alignment of the input buffer.
+ */
+static void
+test_bupsplit_find_ofs (void)
+{
+  g_autofree uint8_t *buf = g_malloc (BUP_SELFTEST_SIZE);
+  g_autofree uint8_t *shifted = g_malloc (BUP_SELFTEST_SIZE + 16);
+  unsigned count;
+  int align;
+
+  for (count = 0; count < BUP_SELFTEST_SIZE; count++)
+    buf[count] = g_random_int_range (0, 256);
+
+  int first_ofs = -1;
+  for (align = 0; align < 16; align++)
+    {
+      uint8_t *start = shifted + align;
+      memcpy (start, buf, BUP_SELFTEST_SIZE);
+      gsize pos = 0;
+      gsize remaining = BUP_SELFTEST_SIZE;
+
+      while (remaining > 0)
+        {
+          int bits = 0;
+          int ofs = bupsplit_find_ofs (start + pos, remaining, &bits);
+          if (ofs == 0)
+            break;
+
+          g_assert_cmpint (ofs, <=, remaining);
+          g_assert_cmpint (bits, >=, BUP_BLOBBITS);
+
+          /* The rollsum state only depends on the trailing window, but
+           * each bupsplit_find_ofs() call starts from a fresh state at
+           * start + pos, so only verify splits at least a full window
+           * into the scanned region.
+           */
+          if (ofs >= BUP_WINDOWSIZE)
+            {
+              uint32_t sum = bupsplit_sum (start, pos + ofs - BUP_WINDOWSIZE, pos + ofs);
+              g_assert_cmpint (sum & (BUP_BLOBSIZE - 1), ==, BUP_BLOBSIZE - 1);
+            }
+
+          pos += ofs;
+          remaining -= ofs;
+        }
+
+      /* The split positions are content-defined, so they must not vary
+       * with buffer alignment.
+       */
+      if (align == 0)
+        first_ofs = (int)pos;
+      else
+        g_assert_cmpint ((int)pos, ==, first_ofs);
+    }
+}
+
 int
 main (int argc, char **argv)
 {
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/rollsum", test_rollsum);
   g_test_add_func ("/bupsum", test_bupsplit_sum);
+  g_test_add_func ("/bupsplit-find-ofs", test_bupsplit_find_ofs);
   return g_test_run ();
 }
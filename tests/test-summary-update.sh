@@ -24,7 +24,7 @@ set -euo pipefail
 
 . $(dirname $0)/libtest.sh
 
-echo "1..2"
+echo "1..4"
 
 COMMIT_SIGN=""
 if has_gpgme; then
@@ -116,3 +116,54 @@ cat files | wc -l > files-count
 assert_file_has_content files-count "^1$"
 
 echo "ok 2 update summary with collections"
+
+# Test the sharded summary format.
+cd ${test_tmpdir}
+rm -rf repo client-repo
+ostree_repo_init repo
+${CMD_PREFIX} ostree --repo=repo config set core.summary-shards 4
+
+seq 5 | while read i; do
+    echo a >> tree/root/a
+    ${CMD_PREFIX} ostree --repo=repo commit --branch=test-$i -m test -s test tree
+done
+
+${CMD_PREFIX} ostree --repo=repo summary --update
+assert_streq "$(ls repo/summary.d | wc -l)" "4"
+
+# The summary's own ref list must be empty; the refs live in the shards.
+${CMD_PREFIX} ostree --repo=repo summary --view > summary
+assert_not_file_has_content summary "^\* test-1$"
+
+# A client can still resolve refs, both singly and as a mirror.
+ostree_repo_init client-repo
+${CMD_PREFIX} ostree --repo=client-repo remote add --no-sign-verify origin file://$(pwd)/repo
+${CMD_PREFIX} ostree --repo=client-repo pull origin test-1
+${CMD_PREFIX} ostree --repo=client-repo pull --mirror origin
+for i in $(seq 5); do
+    ${CMD_PREFIX} ostree --repo=client-repo rev-parse test-$i
+done
+
+# Updating one ref must leave the other shards untouched.
+sha256sum repo/summary.d/* | sort > shards-before
+echo a >> tree/root/a
+${CMD_PREFIX} ostree --repo=repo commit --branch=test-1 -m test -s test tree
+${CMD_PREFIX} ostree --repo=repo summary --update
+sha256sum repo/summary.d/* | sort > shards-after
+comm -13 shards-before shards-after | wc -l > changed-shards
+assert_file_has_content changed-shards "^1$"
+
+echo "ok 3 sharded summary"
+
+# The summary must carry a bloom filter over its ref names, and a client
+# resolving a ref that's definitely absent still gets the usual error.
+cd ${test_tmpdir}
+${CMD_PREFIX} ostree --repo=repo summary --list-metadata-keys > metadata
+assert_file_has_content metadata "^ostree\.summary\.ref-bloom$"
+
+if ${CMD_PREFIX} ostree --repo=client-repo pull origin no-such-ref 2>err.txt; then
+    fatal "pulled a nonexistent ref"
+fi
+assert_file_has_content err.txt "No such branch"
+
+echo "ok 4 summary ref bloom"